@@ -2,22 +2,19 @@
 // Common.hlsl by Frank Luna (C) 2015 All Rights Reserved.
 //***************************************************************************************
 
-// Defaults for number of lights.
+// Default for number of lights.
 #ifndef NUM_DIR_LIGHTS
     #define NUM_DIR_LIGHTS 3
 #endif
 
-#ifndef NUM_POINT_LIGHTS
-    #define NUM_POINT_LIGHTS 0
-#endif
-
-#ifndef NUM_SPOT_LIGHTS
-    #define NUM_SPOT_LIGHTS 0
-#endif
-
 // Include structures and functions for lighting.
 #include "LightingUtil.hlsl"
 
+// Directional lights with shadows and the cascades of each, the same
+// numbers as in d3dUtil.h.
+#define MaxShadowLights 3
+#define ShadowCascadeCount 3
+
 struct MaterialData
 {
 	float4   DiffuseAlbedo;
@@ -27,8 +24,22 @@ struct MaterialData
 	uint     DiffuseMapIndex;
 };
 
+struct InstanceData
+{
+	float4x4 World;
+	float4x4 TexTransform;
+	uint     MaterialIndex;
+	uint     InstPad0;
+	uint     InstPad1;
+	uint     InstPad2;
+	float4   InstPad3;
+};
+
 TextureCube gCubeMap : register(t1);
 
+// Cascaded shadow maps, slice light * ShadowCascadeCount + cascade.
+Texture2DArray gShadowMap : register(t2);
+
 // An array of textures, which is only supported in shader model 5.1+.  Unlike Texture2DArray, the textures
 // in this array can be different sizes and formats, making it more flexible than texture arrays.
 Texture2D gDiffuseMap[1] : register(t0);
@@ -37,6 +48,17 @@ Texture2D gDiffuseMap[1] : register(t0);
 // The texture array will occupy registers t0, t1, ..., t3 in space0. 
 StructuredBuffer<MaterialData> gMaterialData : register(t0, space1);
 
+// Per-object data, indexed by the object slots of the current batch.
+StructuredBuffer<InstanceData> gInstanceData : register(t1, space1);
+StructuredBuffer<uint> gInstanceIndices : register(t2, space1);
+
+// Clustered point and spot lights.  The lights of cluster c are
+// gClusterLights[gClusterLightIndices[gClusterRanges[c].x + i]] for i below
+// gClusterRanges[c].y.
+StructuredBuffer<Light> gClusterLights : register(t3, space1);
+StructuredBuffer<uint2> gClusterRanges : register(t4, space1);
+StructuredBuffer<uint> gClusterLightIndices : register(t5, space1);
+
 
 SamplerState gsamPointWrap        : register(s0);
 SamplerState gsamPointClamp       : register(s1);
@@ -44,15 +66,31 @@ SamplerState gsamLinearWrap       : register(s2);
 SamplerState gsamLinearClamp      : register(s3);
 SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
+SamplerComparisonState gsamShadow : register(s6);
 
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
+// Constant data that varies per draw.
+cbuffer cbPerDraw : register(b0)
 {
-    float4x4 gWorld;
-	float4x4 gTexTransform;
-    uint gMaterialIndex;
+    // Offset of the batch's first instance in gInstanceIndices.  SV_InstanceID
+    // always starts at 0, whatever StartInstanceLocation the draw used.
+    uint gBaseInstance;
 };
 
+// The low 24 bits of an entry of gInstanceIndices are the instance, the top
+// 8 bits how far it has faded out, 0 for fully opaque.
+#define InstanceIndexMask 0xFFFFFF
+
+InstanceData LoadInstance(uint instanceID)
+{
+    return gInstanceData[gInstanceIndices[gBaseInstance + instanceID] & InstanceIndexMask];
+}
+
+// Opacity of the instance as small feature culling fades it out.
+float LoadInstanceFade(uint instanceID)
+{
+    return 1.0f - (gInstanceIndices[gBaseInstance + instanceID] >> 24) / 255.0f;
+}
+
 // Constant data that varies per material.
 cbuffer cbPass : register(b1)
 {
@@ -72,11 +110,105 @@ cbuffer cbPass : register(b1)
     float gDeltaTime;
     float4 gAmbientLight;
 
-    // Indices [0, NUM_DIR_LIGHTS) are directional lights;
-    // indices [NUM_DIR_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHTS) are point lights;
-    // indices [NUM_DIR_LIGHTS+NUM_POINT_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHT+NUM_SPOT_LIGHTS)
-    // are spot lights for a maximum of MaxLights per object.
+    // Indices [0, NUM_DIR_LIGHTS) are directional lights; point and spot
+    // lights are in gClusterLights.
     Light gLights[MaxLights];
+
+    // World to shadow map texture space of every slice, and the view depth
+    // each cascade ends at; past the last one nothing is shadowed.
+    float4x4 gShadowTransforms[MaxShadowLights * ShadowCascadeCount];
+    float4 gCascadeEnds;
+
+    // Tiles x, y, depth slices and the number of point lights, which come
+    // before the spot lights in gClusterLights; the slice of view depth z
+    // is log(z) * gClusterDepth.x + gClusterDepth.y.
+    uint4 gClusterDims;
+    float4 gClusterDepth;
+
+    // Diffuse light from the sky in spherical harmonics, rgb.
+    float4 gSkyIrradiance[9];
 };
 
+// Diffuse light from the sky a white surface facing unit normal n reflects.
+// The basis constants are folded into the coefficients on the CPU.
+float3 SkyIrradiance(float3 n)
+{
+    float3 result = gSkyIrradiance[0].rgb;
+    result += gSkyIrradiance[1].rgb * n.y;
+    result += gSkyIrradiance[2].rgb * n.z;
+    result += gSkyIrradiance[3].rgb * n.x;
+    result += gSkyIrradiance[4].rgb * (n.x * n.y);
+    result += gSkyIrradiance[5].rgb * (n.y * n.z);
+    result += gSkyIrradiance[6].rgb * (3.0f * n.z * n.z - 1.0f);
+    result += gSkyIrradiance[7].rgb * (n.x * n.z);
+    result += gSkyIrradiance[8].rgb * (n.x * n.x - n.y * n.y);
+    return max(result, 0.0f);
+}
+
+// 3x3 PCF in one slice of the shadow map; 1 is fully lit.
+float CalcShadowFactor(float3 posW, uint slice)
+{
+    // Orthographic, so w stays 1.
+    float4 shadowPosH = mul(float4(posW, 1.0f), gShadowTransforms[slice]);
+    float depth = shadowPosH.z;
+
+    uint width, height, elements, numMips;
+    gShadowMap.GetDimensions(0, width, height, elements, numMips);
+    float dx = 1.0f / (float)width;
+
+    const float2 offsets[9] =
+    {
+        float2(-dx, -dx), float2(0.0f, -dx), float2(dx, -dx),
+        float2(-dx, 0.0f), float2(0.0f, 0.0f), float2(dx, 0.0f),
+        float2(-dx, +dx), float2(0.0f, +dx), float2(dx, +dx)
+    };
+
+    float percentLit = 0.0f;
+    [unroll]
+    for(int i = 0; i < 9; ++i)
+    {
+        percentLit += gShadowMap.SampleCmpLevelZero(gsamShadow,
+            float3(shadowPosH.xy + offsets[i], slice), depth).r;
+    }
+    return percentLit / 9.0f;
+}
+
+// Shadow factor of each directional light at posW, for ComputeLighting.
+float3 CalcShadowFactors(float3 posW)
+{
+    float3 shadowFactor = 1.0f;
+    float viewDepth = mul(float4(posW, 1.0f), gView).z;
+    if(viewDepth > gCascadeEnds[ShadowCascadeCount - 1])
+        return shadowFactor;
+
+    uint cascade = 0;
+    [unroll]
+    for(uint c = 0; c < ShadowCascadeCount - 1; ++c)
+        cascade += viewDepth > gCascadeEnds[c] ? 1 : 0;
+
+    [unroll]
+    for(uint i = 0; i < min(NUM_DIR_LIGHTS, MaxShadowLights); ++i)
+        shadowFactor[i] = CalcShadowFactor(posW, i * ShadowCascadeCount + cascade);
+    return shadowFactor;
+}
+
+// Point and spot lights of the cluster the pixel at posH is in.
+float3 ComputeClusteredLighting(Material mat, float4 posH, float3 posW, float3 normal, float3 toEye)
+{
+    float viewDepth = mul(float4(posW, 1.0f), gView).z;
+    uint x = min((uint)(posH.x * gInvRenderTargetSize.x * gClusterDims.x), gClusterDims.x - 1);
+    uint y = min((uint)(posH.y * gInvRenderTargetSize.y * gClusterDims.y), gClusterDims.y - 1);
+    uint z = (uint)clamp(floor(log(viewDepth) * gClusterDepth.x + gClusterDepth.y), 0.0f, gClusterDims.z - 1.0f);
+    uint2 range = gClusterRanges[(z * gClusterDims.y + y) * gClusterDims.x + x];
 
+    float3 result = 0.0f;
+    for(uint i = 0; i < range.y; ++i)
+    {
+        uint index = gClusterLightIndices[range.x + i];
+        if(index < gClusterDims.w)
+            result += ComputePointLight(gClusterLights[index], mat, posW, normal, toEye);
+        else
+            result += ComputeSpotLight(gClusterLights[index], mat, posW, normal, toEye);
+    }
+    return result;
+}
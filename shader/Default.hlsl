@@ -2,19 +2,11 @@
 // Default.hlsl by Frank Luna (C) 2015 All Rights Reserved.
 //***************************************************************************************
 
-// Defaults for number of lights.
+// Default for number of lights.
 #ifndef NUM_DIR_LIGHTS
     #define NUM_DIR_LIGHTS 3
 #endif
 
-#ifndef NUM_POINT_LIGHTS
-    #define NUM_POINT_LIGHTS 0
-#endif
-
-#ifndef NUM_SPOT_LIGHTS
-    #define NUM_SPOT_LIGHTS 0
-#endif
-
 // Include common HLSL code.
 #include "Common.hlsl"
 
@@ -23,6 +15,8 @@ struct VertexIn
 	float3 PosL    : POSITION;
     float3 NormalL : NORMAL;
 	float2 TexC    : TEXCOORD;
+	// Baked ambient occlusion, a second vertex stream.
+	float Occlusion : OCCLUSION;
 };
 
 struct VertexOut
@@ -31,36 +25,66 @@ struct VertexOut
     float3 PosW    : POSITION;
     float3 NormalW : NORMAL;
 	float2 TexC    : TEXCOORD;
+	float Occlusion : OCCLUSION;
+
+	// Index of the material of this instance.
+	nointerpolation uint MatIndex : MATINDEX;
+	nointerpolation float Fade : FADE;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout = (VertexOut)0.0f;
 
+	// Fetch the instance data.
+	InstanceData instData = LoadInstance(instanceID);
+	float4x4 world = instData.World;
+	float4x4 texTransform = instData.TexTransform;
+	uint matIndex = instData.MaterialIndex;
+
+	vout.MatIndex = matIndex;
+	vout.Fade = LoadInstanceFade(instanceID);
+
 	// Fetch the material data.
-	MaterialData matData = gMaterialData[gMaterialIndex];
+	MaterialData matData = gMaterialData[matIndex];
 	
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(vin.PosL, 1.0f), world);
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
+    vout.NormalW = mul(vin.NormalL, (float3x3)world);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
 	
 	// Output vertex attributes for interpolation across triangle.
-	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
+	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), texTransform);
 	vout.TexC = mul(texC, matData.MatTransform).xy;
+	vout.Occlusion = vin.Occlusion;
 	
     return vout;
 }
 
 float4 PS(VertexOut pin) : SV_Target
 {
+#ifdef FADE
+	// Fading instances drop a growing share of their pixels in a 4x4
+	// ordered dither, so they thin out instead of popping.  Only their own
+	// pipeline has this clip; it would cost every opaque pixel early depth.
+	static const float ditherThresholds[16] =
+	{
+		 0.5f,  8.5f,  2.5f, 10.5f,
+		12.5f,  4.5f, 14.5f,  6.5f,
+		 3.5f, 11.5f,  1.5f,  9.5f,
+		15.5f,  7.5f, 13.5f,  5.5f
+	};
+	uint2 ditherPixel = uint2(pin.PosH.xy) & 3;
+	clip(pin.Fade - ditherThresholds[ditherPixel.y * 4 + ditherPixel.x] / 16.0f);
+#endif
+
 	// Fetch the material data.
-	MaterialData matData = gMaterialData[gMaterialIndex];
+	MaterialData matData = gMaterialData[pin.MatIndex];
 	float4 diffuseAlbedo = matData.DiffuseAlbedo;
 	float3 fresnelR0 = matData.FresnelR0;
 	float  roughness = matData.Roughness;
@@ -68,6 +92,13 @@ float4 PS(VertexOut pin) : SV_Target
 
 	// Dynamically look up the texture in the array.
 	diffuseAlbedo *= gDiffuseMap[diffuseTexIndex].Sample(gsamAnisotropicWrap, pin.TexC);
+
+#ifdef ALPHA_TEST
+	// Discard pixel if texture alpha < 0.1.  We do this test as soon 
+	// as possible in the shader so that we can potentially exit the
+	// shader early, thereby skipping the rest of the shader code.
+	clip(diffuseAlbedo.a - 0.1f);
+#endif
 	
     // Interpolating normal can unnormalize it, so renormalize it.
     pin.NormalW = normalize(pin.NormalW);
@@ -76,21 +107,25 @@ float4 PS(VertexOut pin) : SV_Target
     float3 toEyeW = normalize(gEyePosW - pin.PosW);
 
     // Light terms.
-    float4 ambient = gAmbientLight*diffuseAlbedo;
+    float4 ambient = float4(SkyIrradiance(pin.NormalW) * pin.Occlusion, 1.0f)*diffuseAlbedo;
 
 	const float shininess = 1.0f - roughness;
     Material mat = { diffuseAlbedo, fresnelR0, shininess };
-    float3 shadowFactor = 1.0f;
+    float3 shadowFactor = CalcShadowFactors(pin.PosW);
     float4 directLight = ComputeLighting(gLights, mat, pin.PosW,
         pin.NormalW, toEyeW, shadowFactor);
+    directLight.rgb += ComputeClusteredLighting(mat, pin.PosH, pin.PosW, pin.NormalW, toEyeW);
 
     float4 litColor = ambient + directLight;
 
-	// Add in specular reflections.
+	// Add in specular reflections.  The sky's mips are prefiltered with GGX
+	// lobes of growing roughness, so the blur already dims rough surfaces.
 	float3 r = reflect(-toEyeW, pin.NormalW);
-	float4 reflectionColor = gCubeMap.Sample(gsamLinearWrap, r);
+	uint cubeWidth, cubeHeight, cubeLevels;
+	gCubeMap.GetDimensions(0, cubeWidth, cubeHeight, cubeLevels);
+	float4 reflectionColor = gCubeMap.SampleLevel(gsamLinearWrap, r, roughness * (cubeLevels - 1));
 	float3 fresnelFactor = SchlickFresnel(fresnelR0, pin.NormalW, r);
-	litColor.rgb += shininess * fresnelFactor * reflectionColor.rgb;
+	litColor.rgb += fresnelFactor * reflectionColor.rgb;
 
     // Common convention to take alpha from diffuse albedo.
     litColor.a = diffuseAlbedo.a;
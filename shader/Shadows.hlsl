@@ -0,0 +1,31 @@
+//***************************************************************************************
+// Shadows.hlsl
+//
+// Depth only pass of the shadow map slices; gViewProj is the slice's light
+// view projection.
+//***************************************************************************************
+
+// Include common HLSL code.
+#include "Common.hlsl"
+
+struct VertexIn
+{
+	float3 PosL    : POSITION;
+	float3 NormalL : NORMAL;
+	float2 TexC    : TEXCOORD;
+};
+
+struct VertexOut
+{
+	float4 PosH : SV_POSITION;
+};
+
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
+{
+	VertexOut vout;
+
+	float4 posW = mul(float4(vin.PosL, 1.0f), LoadInstance(instanceID).World);
+	vout.PosH = mul(posW, gViewProj);
+
+	return vout;
+}
@@ -18,7 +18,7 @@ struct VertexOut
     float3 PosL : POSITION;
 };
  
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout;
 
@@ -26,7 +26,7 @@ VertexOut VS(VertexIn vin)
 	vout.PosL = vin.PosL;
 	
 	// Transform to world space.
-	float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+	float4 posW = mul(float4(vin.PosL, 1.0f), LoadInstance(instanceID).World);
 
 	// Always center sky about camera.
 	posW.xyz += gEyePosW;
@@ -39,6 +39,7 @@ VertexOut VS(VertexIn vin)
 
 float4 PS(VertexOut pin) : SV_Target
 {
-	return gCubeMap.Sample(gsamLinearWrap, pin.PosL);
+	// Mip 0 is the unfiltered sky, the others are blurred for reflections.
+	return gCubeMap.SampleLevel(gsamLinearWrap, pin.PosL, 0.0f);
 }
 
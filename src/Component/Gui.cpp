@@ -2,4 +2,14 @@
 
 unordered_map<int,wstring> Gui::modelFilePath;
 int Gui::currentModelIndex = 0;
-int Gui::currentCameraIndex = 0;
\ No newline at end of file
+int Gui::currentCameraIndex = 0;
+int Gui::framesInFlight = 3;
+bool Gui::lowLatency = false;
+int Gui::clusteredPointLights = 0;
+int Gui::clusteredSpotLights = 0;
+int Gui::pickedTriangle = -1;
+float Gui::pickedPoint[3] = {};
+float Gui::minPixelArea[2] = { 4.0f, 0.0f };
+float Gui::fadePixelArea[2] = { 64.0f, 0.0f };
+int Gui::culledDraws = 0;
+int Gui::culledTriangles = 0;
\ No newline at end of file
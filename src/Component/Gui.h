@@ -18,6 +18,17 @@ class Gui
     static unordered_map<int,wstring> modelFilePath;
     static int currentModelIndex;
     static int currentCameraIndex;
+    static int framesInFlight;
+    static bool lowLatency;
+    static int clusteredPointLights;
+    static int clusteredSpotLights;
+    static int pickedTriangle;
+    static float pickedPoint[3];
+    //按渲染层（Opaque, Sky）的小物体剔除阈值，单位为像素面积
+    static float minPixelArea[2];
+    static float fadePixelArea[2];
+    static int culledDraws;
+    static int culledTriangles;
     static void GetModel()
     {
         int index = 0;
@@ -76,6 +87,32 @@ class Gui
         const char* cameraItems[] = {"Common Camera","FPS Camera"};
         ImGui::Combo("Camera Type", &currentCameraIndex, cameraItems, IM_ARRAYSIZE(cameraItems));
 
+        //修改后在下一帧开始时重建帧资源和交换链
+        ImGui::SliderInt("Frames In Flight", &framesInFlight, 1, 4);
+        ImGui::Checkbox("Low Latency", &lowLatency);
+
+        //分簇的点光源和聚光灯数量
+        ImGui::SliderInt("Point Lights", &clusteredPointLights, 0, 4096);
+        ImGui::SliderInt("Spot Lights", &clusteredSpotLights, 0, 1024);
+
+        //中键拾取的模型三角形和世界坐标
+        if (pickedTriangle >= 0)
+            ImGui::Text("Picked triangle %d at (%.3f, %.3f, %.3f)", pickedTriangle, pickedPoint[0], pickedPoint[1], pickedPoint[2]);
+        else
+            ImGui::Text("Middle click the model to pick a point");
+
+        //屏幕上过小的物体被剔除，接近阈值的淡出
+        const char* layerNames[] = {"Opaque","Sky"};
+        for (int layer = 0; layer < IM_ARRAYSIZE(layerNames); layer++)
+        {
+            ImGui::PushID(layer);
+            ImGui::Text("%s", layerNames[layer]);
+            ImGui::SliderFloat("Min Pixel Area", &minPixelArea[layer], 0.0f, 1024.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Fade Pixel Area", &fadePixelArea[layer], 0.0f, 4096.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+            ImGui::PopID();
+        }
+        ImGui::Text("Small feature culled: %d draws, %d triangles", culledDraws, culledTriangles);
+
         ImGui::End();
     }
     ~Gui()
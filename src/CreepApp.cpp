@@ -15,38 +15,55 @@
 #include <winuser.h>
 #include "Component/Camera.h"
 #include "Utility/GeometryGenerator.h"
+#include "Utility/InstanceBatcher.h"
+#include "Utility/DrawKey.h"
+#include "Utility/RadixSort.h"
+#include "Utility/FrustumCull.h"
+#include "Utility/ContributionCull.h"
+#include "Utility/SceneBvh.h"
+#include "Utility/OcclusionBuffer.h"
+#include "Utility/ShadowCascades.h"
+#include "Utility/LightClusters.h"
+#include "Utility/CubeMapImage.h"
+#include "Utility/SphericalHarmonics.h"
+#include "Utility/SpecularPrefilter.h"
+#include "Utility/TriangleBvh.h"
+#include "Utility/AoBaker.h"
+#include "Structure/ChangeTracker.h"
+#include "Structure/ParallelRecorder.h"
+#include "Structure/D3D12CommandSink.h"
+#include "Structure/RenderGraphD3D12.h"
+#include "Structure/PipelineStateCache.h"
+#include "Structure/AsyncPipelineQueue.h"
+#include "Structure/FileWatcher.h"
+#include "Structure/ShaderReloadTracker.h"
+#include <future>
+#include <algorithm>
+#include <functional>
+#include "Structure/ShaderPermutations.h"
+#include "Utility/ThreadPool.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 using namespace DirectX::PackedVector;
 
-const int gNumFrameResources = 3;
-
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
 {
 	RenderItem() = default;
 
-    // World matrix of the shape that describes the object's local space
-    // relative to the world space, which defines the position, orientation,
-    // and scale of the object in the world.
-    XMFLOAT4X4 World = MathHelper::Identity4x4();
-
-	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
-
-	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
-	// Because we have an object cbuffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify obect data we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
-
-	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
-	UINT ObjCBIndex = -1;
+	// Id of the object's world and texture transforms in mTransforms, which is
+	// also its index into the per-object instance buffer.  Transforms are
+	// changed through mTransforms so it can track what needs uploading.
+	UINT ObjIndex = -1;
 
 	Material* Mat = nullptr;
 	MeshGeometry* Geo = nullptr;
 
+	// Local space bounds of the submesh, culled against the camera frustum.
+	BoundingBox Bounds;
+
     // Primitive topology.
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
@@ -63,7 +80,101 @@ enum class RenderLayer : int
 	Count
 };
 
-class CreepApp : public D3DApp
+// Pipelines of the main pass, indexed by BatchItem::PipelineState: one per
+// layer, and one for fading opaque items, so that only their pixel shader
+// clips and the plain opaque one keeps early depth testing.
+enum class DrawPipeline : int
+{
+	Opaque = (int)RenderLayer::Opaque,
+	Sky = (int)RenderLayer::Sky,
+	OpaqueFade,
+	Count
+};
+
+// Directional lights UpdateMainPassCB fills in.  The shader variants are
+// compiled for this count only, so the -bakeshaders step needs it as well.
+constexpr UINT NumDirLights = 3;
+
+// Every shader the app compiles, with the keywords it has variants for.
+// Light count values are ordered cheapest first.  Point and spot lights go
+// through the light clusters, so only directional lights have a keyword.
+void DeclareShaders(ShaderPermutationSet& defaultShaders, ShaderPermutationSet& skyShaders,
+	ShaderPermutationSet& shadowShaders)
+{
+	const UINT dirLights = defaultShaders.AddKeyword("NUM_DIR_LIGHTS", { "1", "3" });
+	const UINT alphaTest = defaultShaders.AddKeyword("ALPHA_TEST", { "", "1" });
+	// Dithered fade of items about to be culled for their size.
+	const UINT fade = defaultShaders.AddKeyword("FADE", { "", "1" });
+	defaultShaders.AddStage("VS", "VS", "vs_5_1");
+	defaultShaders.AddStage("PS", "PS", "ps_5_1", { dirLights, alphaTest, fade });
+	// Only what SelectShaderVariants can pick is compiled: the scene's light
+	// count, and no alpha test until a material needs it.  That leaves the
+	// pixel shader with and without FADE.
+	defaultShaders.SetFilter([=](const ShaderPermutationSet& set, ShaderPermutationSet::Permutation p)
+	{
+		return set.ValueIndex(p, dirLights) == set.ValueAtLeast(dirLights, NumDirLights)
+			&& set.ValueIndex(p, alphaTest) == 0;
+	});
+
+	skyShaders.AddStage("VS", "VS", "vs_5_1");
+	skyShaders.AddStage("PS", "PS", "ps_5_1");
+
+	// Depth only, no pixel shader.
+	shadowShaders.AddStage("VS", "VS", "vs_5_1");
+}
+
+ComPtr<ID3DBlob> CompileShaderJob(const ShaderCompileJob& job)
+{
+	std::vector<D3D_SHADER_MACRO> macros;
+	for(const ShaderDefine& define : job.Defines)
+		macros.push_back({ define.Name.c_str(), define.Value.c_str() });
+	macros.push_back({ nullptr, nullptr });
+
+	const std::string& file = job.Set->File();
+	return d3dUtil::CompileShaderCached(std::wstring(file.begin(), file.end()), macros.data(),
+		job.Set->StageEntryPoint(job.Stage), job.Set->StageTarget(job.Stage));
+}
+
+// Compiles every job of compiler on pool through the bytecode cache.
+std::vector<ComPtr<ID3DBlob>> CompileShaderJobs(const ShaderPermutationCompiler& compiler, ThreadPool& pool)
+{
+	std::vector<ComPtr<ID3DBlob>> blobs(compiler.Jobs().size());
+	compiler.Run(pool, [&blobs](const ShaderCompileJob& job, std::uint32_t jobIndex)
+	{
+		blobs[jobIndex] = CompileShaderJob(job);
+	});
+	return blobs;
+}
+
+// Compiles every reachable permutation into the bytecode cache.  Run by the
+// build with -bakeshaders; returns the process exit code, failures go to
+// stderr for the build log.
+int BakeShaders()
+{
+	try
+	{
+		ShaderPermutationSet defaultShaders("Shader/Default.hlsl");
+		ShaderPermutationSet skyShaders("Shader/Sky.hlsl");
+		ShaderPermutationSet shadowShaders("Shader/Shadows.hlsl");
+		DeclareShaders(defaultShaders, skyShaders, shadowShaders);
+
+		ShaderPermutationCompiler compiler;
+		compiler.Add(defaultShaders);
+		compiler.Add(skyShaders);
+		compiler.Add(shadowShaders);
+
+		ThreadPool pool;
+		CompileShaderJobs(compiler, pool);
+	}
+	catch(DxException& e)
+	{
+		std::wcerr << e.ToString() << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+class CreepApp : public D3DApp, private CommandRecordBackend
 {
 public:
     CreepApp(HINSTANCE hInstance);
@@ -85,25 +196,82 @@ private:
     void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
-	void UpdateObjectCBs(const GameTimer& gt);
+	void UpdateInstanceData(const GameTimer& gt);
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void UpdateShadowCascades();
+	void UpdateShadowPassCBs();
+	void UpdateClusteredLights(const GameTimer& gt);
+	void UploadClusteredLights();
+	bool DecodeSky(const Texture& sky, CubeMapImage& image);
+	bool PrefilterSky(const CubeMapImage& sky, const std::string& cachePath);
+	std::vector<std::uint8_t> BakeVertexOcclusion(const std::vector<Vertex>& vertices,
+		const std::vector<std::uint32_t>& indices, const std::string& cachePath);
+	void PickModel(int x, int y);
 
 	void LoadTexAndGeo(int modelIndex);
+	void ApplyFramePacing();
     void BuildRootSignature();
+	void BuildShadowMap();
+	void BuildUnoccludedStream();
 	void BuildDescriptorHeaps();
     void BuildShadersAndInputLayout();
+	void SelectShaderVariants();
+	void UpdateShaderReload();
     //void BuildShapeGeometry();
     void BuildPSOs();
+	void RequestPSO(const std::string& name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+		ComPtr<ID3DBlob> vs, ComPtr<ID3DBlob> ps);
     void BuildFrameResources();
     void BuildMaterials();
     void BuildRenderItems();
-    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
-
-	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
+    void CullRenderItems();
+	void CullOccludedItems(const Float4x4& viewProj, const Float4x4& invViewProj);
+    void BuildInstanceBatches();
+	void BuildFrameGraph();
+
+	// Submits cmdList after a list with the barriers tracker's pending
+	// states need, see ResourceStateTracker::ResolvePending.
+	void ExecuteTracked(ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker);
+	void UntrackResources();
+    void DrawBatches(CommandStateCache& state, const InstanceBatcher& batcher,
+		ID3D12PipelineState* const* pipelineStates, UINT first, UINT count);
+	void DrawShadowSlices();
+
+	// Parallel recording of the batches, see ParallelRecorder.
+	void RecordItems(UINT chunkIndex, const RecordChunk& chunk, UINT executor)override;
+	void SubmitChunks(UINT chunkCount)override;
+	void SetPassState(ID3D12GraphicsCommandList* cmdList, CommandStateCache& state);
+	void EnsureChunkCommandLists(UINT count);
+
+	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> GetStaticSamplers();
 
 private:
 
+	// Worker threads, created before the frame resources that keep an
+	// allocator per thread.
+	std::unique_ptr<ThreadPool> mThreadPool;
+	std::unique_ptr<ParallelRecorder> mRecorder;
+
+	// mCommandList clears, one list per chunk draws, mPostCommandList
+	// draws the GUI and presents; all go to the queue in one call.
+	std::vector<ComPtr<ID3D12GraphicsCommandList>> mChunkCommandLists;
+	ComPtr<ID3D12GraphicsCommandList> mPostCommandList;
+	std::vector<ID3D12CommandList*> mSubmitLists;
+
+	// Bound by every chunk list, set at the start of Draw.
+	D3D12_CPU_DESCRIPTOR_HANDLE mPassRtv = {};
+	D3D12_CPU_DESCRIPTOR_HANDLE mPassDsv = {};
+	ID3D12PipelineState* mDrawPSOs[(int)DrawPipeline::Count] = {};
+
+	// Upload pages shared by the constant allocators of all frame resources.
+	// Declared before mFrameResources so the pages outlive their allocators.
+	std::unique_ptr<UploadPageProvider> mUploadPageProvider;
+	std::unique_ptr<LinearPagePool> mConstantPagePool;
+
+    // Frames in flight and latency mode, can be changed at runtime from the GUI.
+    FramePacing mFramePacing;
+
     std::vector<std::unique_ptr<FrameResource>> mFrameResources;
     FrameResource* mCurrFrameResource = nullptr;
     int mCurrFrameResourceIndex = 0;
@@ -119,17 +287,157 @@ private:
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 
+	// Shader variants, mShaderBlobs holds the bytecode of every compile job.
+	ShaderPermutationSet mDefaultShaders{ "Shader/Default.hlsl" };
+	ShaderPermutationSet mSkyShaders{ "Shader/Sky.hlsl" };
+	ShaderPermutationSet mShadowShaders{ "Shader/Shadows.hlsl" };
+	ShaderPermutationCompiler mShaderCompiler;
+	std::vector<ComPtr<ID3DBlob>> mShaderBlobs;
+	UINT mDefaultShaderSet = 0;
+	UINT mSkyShaderSet = 0;
+	UINT mShadowShaderSet = 0;
+
+	// Shader hot reload.  Edits in the shader directories are mapped to the
+	// files including them; once they settle, the affected jobs recompile
+	// on a background thread and the PSOs are rebuilt at the start of the
+	// next frame.  Declared after the shader sets the reload reads.
+	struct ShaderReload
+	{
+		std::vector<std::pair<UINT, ComPtr<ID3DBlob>>> Blobs;
+		std::vector<std::pair<std::string, std::vector<std::string>>> Dependencies;
+		bool Failed = false;
+	};
+	FileWatcher mShaderWatcher;
+	ShaderReloadTracker mShaderReloads;
+	std::vector<std::string> mChangedShaderFiles;
+	std::future<ShaderReload> mShaderReload;
+
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
+	// mInputLayout plus the baked occlusion stream, for the lit passes.
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mOpaqueInputLayout;
+	// A single fully open occlusion value, bound with stride 0 in slot 1 for
+	// meshes without a baked stream, so every vertex reads it.
+	ComPtr<ID3D12Resource> mUnoccludedStream;
+	ComPtr<ID3D12Resource> mUnoccludedStreamUploader;
 
     //ComPtr<ID3D12PipelineState> mOpaquePSO = nullptr;
- 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
+	// Pipelines by name.  They are created on the worker threads and may
+	// not be ready yet, layers without one skip their draws.
+ 	std::unordered_map<std::string, AsyncPipelineQueue::Handle> mPSOs;
+	// Where mPSOs come from; saved to disk on exit so the next launch loads them.
+	PipelineStateCache mPipelineCache;
+	std::unique_ptr<AsyncPipelineQueue> mPipelineQueue;
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+	// Transforms of all render items, indexed by RenderItem::ObjIndex.
+	TransformStore mTransforms;
+
+	// World bounds of each layer's items, a BVH over them refitted as they
+	// move, and the indices into mRitemLayer of those inside the camera
+	// frustum, found again every frame.
+	BoundsSoA mLayerBounds[(int)RenderLayer::Count];
+	SceneBvh mLayerBvh[(int)RenderLayer::Count];
+	std::vector<std::uint32_t> mVisibleItems[(int)RenderLayer::Count];
+
+	// Items too small on screen are taken out of mVisibleItems with the
+	// thresholds the Gui sets per layer; those close to it fade out.  The
+	// fade goes to the shaders in the top byte of the item's entry in
+	// InstanceIndexBuffer, stored as 255 - fade so plain indices are opaque.
+	static constexpr std::uint32_t InstanceFadeShift = 24;
+	ContributionCuller mContributionCullers[(int)RenderLayer::Count];
+	std::vector<std::uint32_t> mSmallItems;
+
+	// Occlusion culling of the visible opaque items on the CPU.  The biggest
+	// of them on screen are rasterized into mOccluderDepth, which is merged
+	// with the previous frame's occluders reprojected into mOcclusionBuffer;
+	// only fresh occluders are kept for the next frame, so stale depth never
+	// lives longer than one frame.
+	static constexpr float OccluderMinScreenFraction = 1.0f / 64.0f;
+	static constexpr UINT OccluderTriangleBudget = 32768;
+	MaskedOcclusionBuffer mOcclusionBuffer;
+	MaskedOcclusionBuffer mOccluderDepth;
+	MaskedOcclusionBuffer mPrevOccluderDepth;
+	Float4x4 mPrevInvViewProj;
+	bool mHasPrevOccluders = false;
+	std::vector<std::pair<float, std::uint32_t>> mOccluders;
+	std::vector<Float4> mOccluderVertices;
+	std::vector<std::uint8_t> mOccludeeVisible;
+
+	// Cascaded shadow maps of the directional lights, one slice of
+	// mShadowMap per light and cascade.  Casters are the opaque items inside
+	// a cascade's volume, found with the opaque layer's BVH; a slice is only
+	// drawn again when its matrix or its casters changed, see ShadowCache.
+	static constexpr UINT ShadowMapSize = 1024;
+	static constexpr UINT ShadowSliceCount = MaxShadowLights * ShadowCascadeCount;
+	static constexpr float ShadowDistance = 150.0f;
+	static constexpr float ShadowSplitLambda = 0.75f;
+	ComPtr<ID3D12Resource> mShadowMap;
+	ComPtr<ID3D12DescriptorHeap> mShadowDsvHeap;
+	ShadowCascade mShadowCascades[ShadowSliceCount];
+	ShadowCache mShadowCache;
+	InstanceBatcher mShadowBatchers[ShadowSliceCount];
+	std::vector<std::uint32_t> mShadowCasters;
+	std::vector<BatchItem> mShadowBatchItems;
+	// Slices drawn this frame.
+	std::vector<UINT> mShadowSlices;
+
+	// Point and spot lights moving through the opaque scene, as many as the
+	// Gui asks for, point lights first.  They are assigned to the clusters
+	// of the camera every frame and a pixel only shades with its cluster's.
+	static constexpr UINT ClusterTilesX = 16;
+	static constexpr UINT ClusterTilesY = 9;
+	static constexpr UINT ClusterSlices = 24;
+	LightClusters mLightClusters;
+	// CPU copy of the model's triangles for picking and baking, in object space.
+	TriangleBvh mModelBvh;
+	RenderItem* mModelRitem = nullptr;
+	std::vector<Light> mClusterLights;
+
+	// Diffuse light from the sky cube map in spherical harmonics; the flat
+	// ambient light until a sky has been decoded.
+	SH9Color mSkyIrradiance = SphericalHarmonics::Constant({ 0.25f, 0.25f, 0.35f });
+
+	// Materials by MatCBIndex and which of them each frame resource still has to upload.
+	std::vector<Material*> mMaterialSlots;
+	DirtyTracker mMaterialDirty;
+
+	// Visible items as draw packets: a sort key and the item it belongs to.
+	// Sorted before batching so batches and their instances come out in key order.
+	std::vector<BatchItem> mBatchItems;
+	std::vector<std::uint64_t> mDrawKeys;
+	std::vector<std::uint32_t> mDrawOrder;
+	std::vector<BatchItem> mSortedBatchItems;
+	RadixSorter mDrawSorter;
+
+	// Visible items grouped into one instanced draw per geometry/material/PSO.
+	InstanceBatcher mInstanceBatcher;
+
     PassConstants mMainPassCB;
+	TrackedBlock mMainPassData{ sizeof(PassConstants) };
+
+	// Bytes written to upload memory by the last Update.
+	UploadStats mUploadStats;
+
+	// Calls the state caches let through or dropped in the last Draw; every
+	// chunk list fills its own entry and SubmitChunks adds them up.
+	std::vector<StateCacheStats> mChunkStateStats;
+	StateCacheStats mStateStats;
+
+	// Passes of the frame, rebuilt and compiled every Draw; the D3D12 side
+	// keeps the transient targets alive while the layout stays the same.
+	RenderGraph mFrameGraph;
+	RenderGraphD3D12 mGraphResources;
+
+	// States of the textures and buffers between submissions, and the
+	// tracker the upload list records its transitions through.
+	GlobalResourceStates mResourceStates;
+	ResourceStateTracker mUploadStates{ &mResourceStates };
+	ComPtr<ID3D12GraphicsCommandList> mFixupCommandList;
+	std::vector<ResourceBarrierDesc> mFixupBarriers;
 
 	// XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	// XMFLOAT4X4 mView = MathHelper::Identity4x4();
@@ -161,6 +469,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+    if(strstr(cmdLine, "-bakeshaders") != nullptr)
+        return BakeShaders();
+
     try
     {
         CreepApp theApp(hInstance);
@@ -179,6 +490,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 CreepApp::CreepApp(HINSTANCE hInstance)
     : D3DApp(hInstance)
 {
+	mFramePacing.Request({ (UINT)Gui::framesInFlight, Gui::lowLatency ? LatencyMode::LowLatency : LatencyMode::Throughput });
+	mFramePacing.ApplyPending();
+	mSwapChainBufferCount = mFramePacing.SwapChainBufferCount();
+	mMaxFrameLatency = mFramePacing.MaxFrameLatency();
 }
 
 CreepApp::~CreepApp()
@@ -186,6 +501,9 @@ CreepApp::~CreepApp()
 
     if(md3dDevice != nullptr)
         FlushCommandQueue();
+	if(mPipelineQueue)
+		mPipelineQueue->WaitIdle();
+	mPipelineCache.Save();
 	 // Cleanup
     ImGui_ImplDX12_Shutdown();
     ImGui_ImplWin32_Shutdown();
@@ -193,10 +511,6 @@ CreepApp::~CreepApp()
 	
 	if(mRootSignature){mRootSignature->Release();mRootSignature.Detach();}
 	if(mSrvDescriptorHeap){mSrvDescriptorHeap->Release();mSrvDescriptorHeap.Detach();}
-	for(auto& i : mPSOs)
-	{
-		if(i.second){i.second->Release();i.second.Detach();}
-	}
 	
 	for(auto& i:mTextures)
 	{
@@ -220,13 +534,27 @@ bool CreepApp::Initialize()
 	Gui::GetModel();
 
 	//LoadTexAndGeo(Gui::currentModelIndex);
+	mPipelineCache.Open(md3dDevice.Get(), "cache/PipelineLibrary.bin");
     BuildRootSignature();
 	BuildDescriptorHeaps();
+	BuildShadowMap();
+	BuildUnoccludedStream();
+	mThreadPool = std::make_unique<ThreadPool>();
+	mPipelineQueue = std::make_unique<AsyncPipelineQueue>(mThreadPool.get());
     BuildShadersAndInputLayout();
     //BuildShapeGeometry();
 	BuildMaterials();
     //BuildRenderItems();
-    //BuildFrameResources();
+	mRecorder = std::make_unique<ParallelRecorder>(mThreadPool.get());
+    BuildFrameResources();
+
+	ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+		mFrameResources[0]->PostCmdListAlloc.Get(), nullptr, IID_PPV_ARGS(mPostCommandList.GetAddressOf())));
+	ThrowIfFailed(mPostCommandList->Close());
+	ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+		mDirectCmdListAlloc.Get(), nullptr, IID_PPV_ARGS(mFixupCommandList.GetAddressOf())));
+	ThrowIfFailed(mFixupCommandList->Close());
+	mGraphResources.SetDevice(md3dDevice.Get());
     BuildPSOs();
 
     // Execute the initialization commands.
@@ -236,6 +564,7 @@ bool CreepApp::Initialize()
 
     // Wait until initialization is complete.
     FlushCommandQueue();
+	mUnoccludedStreamUploader = nullptr;
 
     return true;
 }
@@ -258,6 +587,8 @@ void CreepApp::LoadTexAndGeo(int modelIndex)
 		FlushCommandQueue();
 
     	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
+		mUploadStates.Reset();
+		D3D12CommandSink uploadSink(mCommandList.Get());
 	
 		auto modelTex = std::make_unique<Texture>();
 		
@@ -275,10 +606,12 @@ void CreepApp::LoadTexAndGeo(int modelIndex)
 		loadModel(modelPath, mesh);
 		if(mesh.vertices.size() != 0)
 		{
+			//旧资源释放前从状态表中移除
+			UntrackResources();
 			//模型也加载成功了再上传
 			mTextures[modelTex->Name] = std::move(modelTex);
 			//uploadtex
-			mTextures["modelTex"]->uploadTex(md3dDevice.Get(), mCommandList.Get());
+			mTextures["modelTex"]->uploadTex(md3dDevice.Get(), mCommandList.Get(), mUploadStates, uploadSink);
 			SubmeshGeometry modelSubmesh;
 			modelSubmesh.IndexCount = mesh.indices.size();
 			modelSubmesh.StartIndexLocation = 0;
@@ -290,8 +623,18 @@ void CreepApp::LoadTexAndGeo(int modelIndex)
 				vertices[i].Normal = mesh.vertices[i].normal;
 				vertices[i].TexC = mesh.vertices[i].uv;
 			}
+			BoundingBox::CreateFromPoints(modelSubmesh.Bounds, vertices.size(), &vertices[0].Pos, sizeof(Vertex));
 			std::vector<std::uint16_t> indices;
 			indices.assign(mesh.indices.begin(),mesh.indices.end());
+			//CPU端的三角形BVH，用于鼠标拾取和烘焙
+			{
+				std::vector<Float3> positions(vertices.size());
+				for(size_t i = 0; i < vertices.size(); ++i)
+					positions[i] = { vertices[i].Pos.x, vertices[i].Pos.y, vertices[i].Pos.z };
+				mModelBvh.Build(positions.data(), mesh.indices.data(), (std::uint32_t)(mesh.indices.size() / 3), mThreadPool.get());
+			}
+			//逐顶点环境光遮蔽，烘焙结果缓存在模型旁边
+			std::vector<std::uint8_t> occlusion = BakeVertexOcclusion(vertices, mesh.indices, modelPath + ".ao");
 			
 			const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 			const UINT ibByteSize = (UINT)indices.size()  * sizeof(std::uint16_t);
@@ -306,10 +649,14 @@ void CreepApp::LoadTexAndGeo(int modelIndex)
 			CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
 			geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-				mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+				mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader, mUploadStates, uploadSink);
 
 			geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-				mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+				mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader, mUploadStates, uploadSink);
+
+			geo->OcclusionBufferByteSize = (UINT)occlusion.size();
+			geo->OcclusionBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+				mCommandList.Get(), occlusion.data(), geo->OcclusionBufferByteSize, geo->OcclusionBufferUploader, mUploadStates, uploadSink);
 
 			geo->VertexByteStride = sizeof(Vertex);
 			geo->VertexBufferByteSize = vbByteSize;
@@ -341,10 +688,29 @@ void CreepApp::LoadTexAndGeo(int modelIndex)
 			cubeMap->Name = "skyTex";
 			cubeMap->Filename = L"./texture/cubemap.dds";
 			cubeMap->createTexture(md3dDevice.Get());
+			{
+				CubeMapImage skyImage;
+				if(DecodeSky(*cubeMap, skyImage))
+				{
+					//天空盒投影到球谐，作为漫反射环境光
+					mSkyIrradiance = SphericalHarmonics::IrradianceFromRadiance(SphericalHarmonics::ProjectCubeMap(skyImage, mThreadPool.get()));
+					//按粗糙度预过滤的mip链，缓存在源文件旁边
+					const std::string cachePath = "./texture/cubemap.ggx.dds";
+					if(PrefilterSky(skyImage, cachePath))
+					{
+						cubeMap->Filename = L"./texture/cubemap.ggx.dds";
+						cubeMap->createTexture(md3dDevice.Get());
+					}
+				}
+				else
+				{
+					OutputDebugStringA("Sky cube map format not supported, keeping the previous ambient light and unfiltered reflections.\n");
+				}
+			}
 			//模型也加载成功了再上传
 			mTextures[cubeMap->Name] = std::move(cubeMap);
 			//uploadtex，上传到gpu memory
-			mTextures["skyTex"]->uploadTex(md3dDevice.Get(), mCommandList.Get());
+			mTextures["skyTex"]->uploadTex(md3dDevice.Get(), mCommandList.Get(), mUploadStates, uploadSink);
 
 			//CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 			hDescriptor.Offset(1,mCbvSrvDescriptorSize);//gui，modeltex
@@ -377,6 +743,7 @@ void CreepApp::LoadTexAndGeo(int modelIndex)
 				cube_vertices[i].Normal = sphere.Vertices[i].Normal;
 				cube_vertices[i].TexC = sphere.Vertices[i].TexC;
 			}
+			BoundingBox::CreateFromPoints(sphereSubmesh.Bounds, cube_vertices.size(), &cube_vertices[0].Pos, sizeof(Vertex));
 
 			std::vector<std::uint16_t> cube_indices;
 			cube_indices.insert(cube_indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
@@ -394,10 +761,10 @@ void CreepApp::LoadTexAndGeo(int modelIndex)
 			CopyMemory(cube_geo->IndexBufferCPU->GetBufferPointer(), cube_indices.data(), cube_ibByteSize);
 
 			cube_geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-				mCommandList.Get(), cube_vertices.data(), cube_vbByteSize, cube_geo->VertexBufferUploader);
+				mCommandList.Get(), cube_vertices.data(), cube_vbByteSize, cube_geo->VertexBufferUploader, mUploadStates, uploadSink);
 
 			cube_geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-				mCommandList.Get(), cube_indices.data(), cube_ibByteSize, cube_geo->IndexBufferUploader);
+				mCommandList.Get(), cube_indices.data(), cube_ibByteSize, cube_geo->IndexBufferUploader, mUploadStates, uploadSink);
 
 			cube_geo->VertexByteStride = sizeof(Vertex);
 			cube_geo->VertexBufferByteSize = cube_vbByteSize;
@@ -409,11 +776,11 @@ void CreepApp::LoadTexAndGeo(int modelIndex)
 			mGeometries[cube_geo->Name] = std::move(cube_geo);
 			//重新创建renderitem
 			mAllRitems.clear();
+			mTransforms.Clear();
 			mRitemLayer[(int)RenderLayer::Opaque].clear();
 			mRitemLayer[(int)RenderLayer::Sky].clear();
+			//帧资源的常量从线性分配器中分配，物体数量变化不需要重建帧资源
 			BuildRenderItems();
-			//重新创建帧资源
-			BuildFrameResources();
 			//成功了换模型下标
 			lastModelIndex = modelIndex;
 		}else {
@@ -423,35 +790,74 @@ void CreepApp::LoadTexAndGeo(int modelIndex)
 		
 
 		// Execute the initialization commands.
+		mUploadStates.Close(uploadSink);
 		ThrowIfFailed(mCommandList->Close());
-		ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-		mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+		ExecuteTracked(mCommandList.Get(), mUploadStates);
+
+	}
+
+}
+
+void CreepApp::ExecuteTracked(ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker)
+{
+	mFixupBarriers.clear();
+	tracker.ResolvePending(mFixupBarriers);
 
+	mSubmitLists.clear();
+	if(!mFixupBarriers.empty())
+	{
+		// cmdList is closed, so its allocator is free for another list.
+		ThrowIfFailed(mFixupCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
+		D3D12CommandSink fixupSink(mFixupCommandList.Get());
+		fixupSink.ResourceBarrier((UINT)mFixupBarriers.size(), mFixupBarriers.data());
+		ThrowIfFailed(mFixupCommandList->Close());
+		mSubmitLists.push_back(mFixupCommandList.Get());
 	}
+	mSubmitLists.push_back(cmdList);
+	mCommandQueue->ExecuteCommandLists((UINT)mSubmitLists.size(), mSubmitLists.data());
+}
 
+void CreepApp::UntrackResources()
+{
+	for(auto& tex : mTextures)
+		mResourceStates.Unregister(tex.second->Resource.Get());
+	for(auto& geo : mGeometries)
+	{
+		mResourceStates.Unregister(geo.second->VertexBufferGPU.Get());
+		mResourceStates.Unregister(geo.second->IndexBufferGPU.Get());
+		// Only baked meshes have an occlusion stream.
+		if(geo.second->OcclusionBufferGPU != nullptr)
+			mResourceStates.Unregister(geo.second->OcclusionBufferGPU.Get());
+	}
 }
 
 void CreepApp::BuildRootSignature()
 {
-	CD3DX12_DESCRIPTOR_RANGE texTable[2];
-	// 一个模型srv，一个cubemap srv
+	CD3DX12_DESCRIPTOR_RANGE texTable[3];
+	// 一个模型srv，一个cubemap srv，一个阴影图srv
 	texTable[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0,0);
 	texTable[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV,1,1,0);
+	texTable[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2, 0);
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[9];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
 	
-	slotRootParameter[0].InitAsConstantBufferView(0);//b0
+	slotRootParameter[0].InitAsConstants(1, 0);//b0，批次在实例索引中的起始位置
     slotRootParameter[1].InitAsConstantBufferView(1);//b1
     slotRootParameter[2].InitAsShaderResourceView(0, 1);//t0 space1
-	slotRootParameter[3].InitAsDescriptorTable(2, texTable, D3D12_SHADER_VISIBILITY_PIXEL);//t0
+	slotRootParameter[3].InitAsDescriptorTable(3, texTable, D3D12_SHADER_VISIBILITY_PIXEL);//t0
+	slotRootParameter[4].InitAsShaderResourceView(1, 1);//t1 space1，每个物体的实例数据
+	slotRootParameter[5].InitAsShaderResourceView(2, 1, D3D12_SHADER_VISIBILITY_VERTEX);//t2 space1，实例索引
+	slotRootParameter[6].InitAsShaderResourceView(3, 1, D3D12_SHADER_VISIBILITY_PIXEL);//t3 space1，分簇光源
+	slotRootParameter[7].InitAsShaderResourceView(4, 1, D3D12_SHADER_VISIBILITY_PIXEL);//t4 space1，每个簇的光源范围
+	slotRootParameter[8].InitAsShaderResourceView(5, 1, D3D12_SHADER_VISIBILITY_PIXEL);//t5 space1，簇的光源索引
 	
 
 	auto staticSamplers = GetStaticSamplers();
 
     // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(_countof(slotRootParameter), slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -472,6 +878,9 @@ void CreepApp::BuildRootSignature()
         serializedRootSig->GetBufferPointer(),
         serializedRootSig->GetBufferSize(),
         IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+
+	mPipelineCache.RegisterRootSignature(mRootSignature.Get(),
+		serializedRootSig->GetBufferPointer(), serializedRootSig->GetBufferSize());
 }
 
 void CreepApp::BuildDescriptorHeaps()
@@ -480,7 +889,7 @@ void CreepApp::BuildDescriptorHeaps()
 	// Create the SRV heap. imgui还有一个
 	//
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 3;//imgui,model,sky
+	srvHeapDesc.NumDescriptors = 4;//imgui,model,sky,shadow
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
@@ -497,27 +906,114 @@ void CreepApp::BuildDescriptorHeaps()
     //ImGui::StyleColorsLight();
 
     // Setup Platform/Renderer backends
+    // imgui的顶点缓冲按最大帧数创建，修改帧数时不用重新初始化
     ImGui_ImplWin32_Init(mhMainWnd);
-    ImGui_ImplDX12_Init(md3dDevice.Get(), SwapChainBufferCount,
+    ImGui_ImplDX12_Init(md3dDevice.Get(), FramePacing::MaxFramesInFlight,
         mBackBufferFormat, mSrvDescriptorHeap.Get(),
         mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(),
         mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
 	
 }
 
-void CreepApp::BuildShadersAndInputLayout()
+void CreepApp::BuildShadowMap()
 {
-	const D3D_SHADER_MACRO alphaTestDefines[] =
+	// One typeless array so the slices can be drawn with depth views and
+	// read with a single shader resource view.
+	D3D12_RESOURCE_DESC texDesc = {};
+	texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	texDesc.Alignment = 0;
+	texDesc.Width = ShadowMapSize;
+	texDesc.Height = ShadowMapSize;
+	texDesc.DepthOrArraySize = ShadowSliceCount;
+	texDesc.MipLevels = 1;
+	texDesc.Format = DXGI_FORMAT_R24G8_TYPELESS;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	texDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+
+	D3D12_CLEAR_VALUE optClear;
+	optClear.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	optClear.DepthStencil.Depth = 1.0f;
+	optClear.DepthStencil.Stencil = 0;
+
+	// Created in the state the frame graph expects between frames.  Nothing
+	// is read before ShadowCache asks for every slice to be drawn.
+	auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&heapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&texDesc,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+		&optClear,
+		IID_PPV_ARGS(&mShadowMap)));
+
+	D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
+	dsvHeapDesc.NumDescriptors = ShadowSliceCount;
+	dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+	dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&mShadowDsvHeap)));
+
+	for(UINT slice = 0; slice < ShadowSliceCount; ++slice)
 	{
-		"ALPHA_TEST", "1",
-		NULL, NULL
-	};
+		D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
+		dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+		dsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+		dsvDesc.Texture2DArray.MipSlice = 0;
+		dsvDesc.Texture2DArray.FirstArraySlice = slice;
+		dsvDesc.Texture2DArray.ArraySize = 1;
+		CD3DX12_CPU_DESCRIPTOR_HANDLE dsv(mShadowDsvHeap->GetCPUDescriptorHandleForHeapStart(), slice, mDsvDescriptorSize);
+		md3dDevice->CreateDepthStencilView(mShadowMap.Get(), &dsvDesc, dsv);
+	}
 
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shader/Default.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shader/Default.hlsl", nullptr, "PS", "ps_5_1");
-	
-	mShaders["skyVS"] = d3dUtil::CompileShader(L"Shader/Sky.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["skyPS"] = d3dUtil::CompileShader(L"Shader/Sky.hlsl", nullptr, "PS", "ps_5_1");
+	//阴影图在imgui，modeltex，cubetex之后
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = ShadowSliceCount;
+	srvDesc.Texture2DArray.ResourceMinLODClamp = 0.0f;
+	CD3DX12_CPU_DESCRIPTOR_HANDLE srv(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), 3, mCbvSrvDescriptorSize);
+	md3dDevice->CreateShaderResourceView(mShadowMap.Get(), &srvDesc, srv);
+
+	mShadowCache.Reset(ShadowSliceCount);
+}
+
+void CreepApp::BuildUnoccludedStream()
+{
+	// Outlives every model, so it is not in the state tables UntrackResources
+	// clears; the plain upload leaves it in a readable state.
+	const std::uint8_t open = 255;
+	mUnoccludedStream = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(),
+		&open, sizeof(open), mUnoccludedStreamUploader);
+}
+
+void CreepApp::BuildShadersAndInputLayout()
+{
+	// All reachable variants are compiled up front on the worker threads;
+	// SelectShaderVariants picks the ones the PSOs are built from.
+	DeclareShaders(mDefaultShaders, mSkyShaders, mShadowShaders);
+	mShaderCompiler.Clear();
+	mDefaultShaderSet = mShaderCompiler.Add(mDefaultShaders);
+	mSkyShaderSet = mShaderCompiler.Add(mSkyShaders);
+	mShadowShaderSet = mShaderCompiler.Add(mShadowShaders);
+	mShaderBlobs = CompileShaderJobs(mShaderCompiler, *mThreadPool);
+	SelectShaderVariants();
+
+	// Hot reload watches every directory a shader pulls files from.
+	for(const ShaderPermutationSet* set : { &mDefaultShaders, &mSkyShaders, &mShadowShaders })
+	{
+		ShaderSource source;
+		std::string error;
+		if(ShaderCache::ExpandIncludes(set->File(), source, error))
+			mShaderReloads.SetDependencies(set->File(), source.Files);
+	}
+	for(const std::string& dir : mShaderReloads.Directories())
+		mShaderWatcher.Watch(dir);
 
     mInputLayout =
     {
@@ -525,8 +1021,116 @@ void CreepApp::BuildShadersAndInputLayout()
         { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
     };
+	mOpaqueInputLayout = mInputLayout;
+	mOpaqueInputLayout.push_back({ "OCCLUSION", 0, DXGI_FORMAT_R8_UNORM, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+}
+
+
+void CreepApp::UpdateShaderReload()
+{
+	const auto now = ShaderReloadTracker::Clock::now();
+	mChangedShaderFiles.clear();
+	mShaderWatcher.Poll(mChangedShaderFiles);
+	for(const std::string& file : mChangedShaderFiles)
+		mShaderReloads.OnFileChanged(file, now);
+
+	// Swap in a finished reload.  Replaced PSOs stay alive in the pipeline
+	// cache, so frames still in flight keep theirs and the GPU is not flushed.
+	if(mShaderReload.valid() && mShaderReload.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		ShaderReload reload = mShaderReload.get();
+		for(auto& [root, files] : reload.Dependencies)
+			mShaderReloads.SetDependencies(root, files);
+
+		// A shader that fails to compile keeps the old bytecode, the errors
+		// are in the debug output.
+		if(!reload.Failed)
+		{
+			for(auto& [job, blob] : reload.Blobs)
+				mShaderBlobs[job] = blob;
+			SelectShaderVariants();
+			BuildPSOs();
+		}
+	}
+
+	// One reload at a time, edits made meanwhile stay pending.
+	if(mShaderReload.valid() || !mShaderReloads.HasPending())
+		return;
+
+	const std::vector<std::string> roots = mShaderReloads.TakeReady(now);
+	if(roots.empty())
+		return;
+
+	std::vector<std::pair<UINT, ShaderCompileJob>> jobs;
+	const auto& allJobs = mShaderCompiler.Jobs();
+	for(UINT i = 0; i < (UINT)allJobs.size(); ++i)
+	{
+		if(std::find(roots.begin(), roots.end(), allJobs[i].Set->File()) != roots.end())
+			jobs.push_back({ i, allJobs[i] });
+	}
+
+	mShaderReload = std::async(std::launch::async, [roots, jobs]()
+	{
+		ShaderReload reload;
+		for(const std::string& root : roots)
+		{
+			ShaderSource source;
+			std::string error;
+			if(ShaderCache::ExpandIncludes(root, source, error))
+				reload.Dependencies.push_back({ root, source.Files });
+		}
+
+		try
+		{
+			for(auto& [index, job] : jobs)
+				reload.Blobs.push_back({ index, CompileShaderJob(job) });
+		}
+		catch(DxException& e)
+		{
+			OutputDebugStringW(e.ToString().c_str());
+			reload.Failed = true;
+		}
+		return reload;
+	});
 }
 
+void CreepApp::SelectShaderVariants()
+{
+	// Cheapest variant with room for the lights the pass constants fill in.
+	// ALPHA_TEST stays at its first value, the only one DeclareShaders
+	// compiles; FADE is only on for the pipeline of fading items.
+	std::vector<UINT> minimum(mDefaultShaders.KeywordCount(), 0);
+	auto require = [&](const char* keyword, UINT count)
+	{
+		const UINT k = mDefaultShaders.FindKeyword(keyword);
+		minimum[k] = mDefaultShaders.ValueAtLeast(k, count);
+	};
+	require("NUM_DIR_LIGHTS", NumDirLights);
+
+	ShaderPermutationSet::Permutation opaque = 0;
+	if(!mDefaultShaders.Select(minimum.data(), opaque))
+	{
+		throw std::runtime_error("No shader variant supports the scene's lights.");
+	}
+
+	require("FADE", 1);
+	ShaderPermutationSet::Permutation opaqueFade = 0;
+	if(!mDefaultShaders.Select(minimum.data(), opaqueFade))
+	{
+		throw std::runtime_error("No fading shader variant supports the scene's lights.");
+	}
+
+	auto blob = [this](UINT set, ShaderPermutationSet::Permutation p, const ShaderPermutationSet& shaders, const char* stage)
+	{
+		return mShaderBlobs[mShaderCompiler.JobIndex(set, p, shaders.FindStage(stage))];
+	};
+	mShaders["standardVS"] = blob(mDefaultShaderSet, opaque, mDefaultShaders, "VS");
+	mShaders["opaquePS"] = blob(mDefaultShaderSet, opaque, mDefaultShaders, "PS");
+	mShaders["opaqueFadePS"] = blob(mDefaultShaderSet, opaqueFade, mDefaultShaders, "PS");
+	mShaders["skyVS"] = blob(mSkyShaderSet, 0, mSkyShaders, "VS");
+	mShaders["skyPS"] = blob(mSkyShaderSet, 0, mSkyShaders, "PS");
+	mShaders["shadowVS"] = blob(mShadowShaderSet, 0, mShadowShaders, "VS");
+}
 
 void CreepApp::BuildPSOs()
 {
@@ -536,7 +1140,7 @@ void CreepApp::BuildPSOs()
 	// PSO for opaque objects.
 	//
     ZeroMemory(&opaquePsoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
-	opaquePsoDesc.InputLayout = { mInputLayout.data(), (UINT)mInputLayout.size() };
+	opaquePsoDesc.InputLayout = { mOpaqueInputLayout.data(), (UINT)mOpaqueInputLayout.size() };
 	opaquePsoDesc.pRootSignature = mRootSignature.Get();
 	opaquePsoDesc.VS = 
 	{ 
@@ -559,17 +1163,52 @@ void CreepApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Quality = 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
 
-    ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+    RequestPSO("opaque", opaquePsoDesc, mShaders["standardVS"], mShaders["opaquePS"]);
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC msaaPsoDesc = opaquePsoDesc;
 	msaaPsoDesc.SampleDesc.Count = 4;
 	
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&msaaPsoDesc, IID_PPV_ARGS(&mPSOs["msaa4x"])));
+	RequestPSO("msaa4x", msaaPsoDesc, mShaders["standardVS"], mShaders["opaquePS"]);
+
+	//
+	// PSOs for fading opaque objects, the same with the dithering pixel shader.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC fadePsoDesc = opaquePsoDesc;
+	fadePsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["opaqueFadePS"]->GetBufferPointer()),
+		mShaders["opaqueFadePS"]->GetBufferSize()
+	};
+	RequestPSO("opaque_fade", fadePsoDesc, mShaders["standardVS"], mShaders["opaqueFadePS"]);
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC msaaFadePsoDesc = fadePsoDesc;
+	msaaFadePsoDesc.SampleDesc.Count = 4;
+	RequestPSO("msaa_fade", msaaFadePsoDesc, mShaders["standardVS"], mShaders["opaqueFadePS"]);
+
+	//
+	// PSO for the shadow map slices, depth only.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC shadowPsoDesc = opaquePsoDesc;
+	shadowPsoDesc.InputLayout = { mInputLayout.data(), (UINT)mInputLayout.size() };
+	shadowPsoDesc.RasterizerState.DepthBias = 100000;
+	shadowPsoDesc.RasterizerState.DepthBiasClamp = 0.0f;
+	shadowPsoDesc.RasterizerState.SlopeScaledDepthBias = 1.0f;
+	shadowPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["shadowVS"]->GetBufferPointer()),
+		mShaders["shadowVS"]->GetBufferSize()
+	};
+	shadowPsoDesc.PS = { nullptr, 0 };
+	shadowPsoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+	shadowPsoDesc.NumRenderTargets = 0;
+	shadowPsoDesc.DSVFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	RequestPSO("shadow", shadowPsoDesc, mShaders["shadowVS"], nullptr);
 
 	//
 	// PSO for sky.
 	//
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC skyPsoDesc = opaquePsoDesc;
+	skyPsoDesc.InputLayout = { mInputLayout.data(), (UINT)mInputLayout.size() };
 
 	// The camera is inside the sky sphere, so just turn off culling.
 	skyPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
@@ -589,23 +1228,72 @@ void CreepApp::BuildPSOs()
 		reinterpret_cast<BYTE*>(mShaders["skyPS"]->GetBufferPointer()),
 		mShaders["skyPS"]->GetBufferSize()
 	};
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&skyPsoDesc, IID_PPV_ARGS(&mPSOs["sky"])));
+	RequestPSO("sky", skyPsoDesc, mShaders["skyVS"], mShaders["skyPS"]);
 	
 	//msaa_sky
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC msaa_skyPsoDesc = skyPsoDesc;
 	msaa_skyPsoDesc.SampleDesc.Count = 4;
 	
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&msaa_skyPsoDesc, IID_PPV_ARGS(&mPSOs["msaa_sky"])));
+	RequestPSO("msaa_sky", msaa_skyPsoDesc, mShaders["skyVS"], mShaders["skyPS"]);
 
 }
 
+void CreepApp::RequestPSO(const std::string& name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+	ComPtr<ID3DBlob> vs, ComPtr<ID3DBlob> ps)
+{
+	// The task holds the shader blobs desc points into, so they can be
+	// replaced while it is queued; input layout and root signature live
+	// as long as the app.
+	auto create = [this, desc, vs, ps]() -> void*
+	{
+		return mPipelineCache.GetOrCreate(desc);
+	};
+
+	// Asking again for a known name rebuilds it, the old pipeline is drawn
+	// with until the new one is ready.
+	auto it = mPSOs.find(name);
+	if(it == mPSOs.end())
+		mPSOs[name] = mPipelineQueue->Request(create);
+	else
+		mPipelineQueue->Rebuild(it->second, create);
+}
+
 void CreepApp::BuildFrameResources()
 {
-    for(int i = 0; i < gNumFrameResources; ++i)
+	if(mConstantPagePool == nullptr)
+	{
+		mUploadPageProvider = std::make_unique<UploadPageProvider>(md3dDevice.Get());
+		mConstantPagePool = std::make_unique<LinearPagePool>(mUploadPageProvider.get());
+	}
+
+	mFrameResources.clear();
+	mCurrFrameResource = nullptr;
+	mCurrFrameResourceIndex = mFramePacing.CurrentFrame();
+
+	const UINT numFrameResources = mFramePacing.FrameResourceCount();
+    for(UINT i = 0; i < numFrameResources; ++i)
     {
-        mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-            1, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
+        mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(), mConstantPagePool.get(), mThreadPool->ExecutorCount()));
     }
+
+	// The dirty state is kept per frame resource, start over with all of it dirty.
+	mTransforms.SetNumFrameResources(numFrameResources);
+	mMaterialDirty.SetNumFrameResources(numFrameResources);
+	mMainPassData.SetNumFrameResources(numFrameResources);
+}
+
+void CreepApp::ApplyFramePacing()
+{
+	mFramePacing.Request({ (UINT)Gui::framesInFlight, Gui::lowLatency ? LatencyMode::LowLatency : LatencyMode::Throughput });
+	if(!mFramePacing.HasPendingChange())
+		return;
+
+	// Nothing recorded with the old ring may still be in flight.
+	FlushCommandQueue();
+	mFramePacing.ApplyPending();
+
+	SetSwapChainLatency(mFramePacing.SwapChainBufferCount(), mFramePacing.MaxFrameLatency());
+	BuildFrameResources();
 }
 
 void CreepApp::BuildMaterials()
@@ -629,40 +1317,50 @@ void CreepApp::BuildMaterials()
     sky->Roughness = 1.0f;
 
 	mMaterials["sky"] = std::move(sky);
+
+	mMaterialSlots.assign(mMaterials.size(), nullptr);
+	for(auto& e : mMaterials)
+		mMaterialSlots[e.second->MatCBIndex] = e.second.get();
+	mMaterialDirty.Resize((UINT)mMaterialSlots.size());
+	mMaterialDirty.MarkAllDirty();
 }
 
 void CreepApp::BuildRenderItems()
 {
+	// Last frame's occluders and the shadow slices belong to the old scene.
+	mHasPrevOccluders = false;
+	mShadowCache.Reset(ShadowSliceCount);
+
 	auto skyRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&skyRitem->World, XMMatrixScaling(5000.0f, 5000.0f, 5000.0f));
-	skyRitem->TexTransform = MathHelper::Identity4x4();
-	skyRitem->ObjCBIndex = 0;
 	skyRitem->Mat = mMaterials["sky"].get();
+	skyRitem->ObjIndex = mTransforms.Add(MathHelper::ToFloat4x4(XMMatrixScaling(5000.0f, 5000.0f, 5000.0f)),
+		Float4x4::Identity(), skyRitem->Mat->MatCBIndex);
 	skyRitem->Geo = mGeometries["skyGeo"].get();
 	skyRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	skyRitem->IndexCount = skyRitem->Geo->DrawArgs["sky"].IndexCount;
 	skyRitem->StartIndexLocation = skyRitem->Geo->DrawArgs["sky"].StartIndexLocation;
 	skyRitem->BaseVertexLocation = skyRitem->Geo->DrawArgs["sky"].BaseVertexLocation;
+	skyRitem->Bounds = skyRitem->Geo->DrawArgs["sky"].Bounds;
 
 	mRitemLayer[(int)RenderLayer::Sky].push_back(skyRitem.get());
 	mAllRitems.push_back(std::move(skyRitem));
 
 	auto modelRitem = std::make_unique<RenderItem>();
-	modelRitem->World = MathHelper::Identity4x4();
-	modelRitem->TexTransform = MathHelper::Identity4x4();
-	modelRitem->ObjCBIndex = 0;
 	modelRitem->Mat = mMaterials["woodCrate"].get();
+	modelRitem->ObjIndex = mTransforms.Add(Float4x4::Identity(), Float4x4::Identity(), modelRitem->Mat->MatCBIndex);
 	modelRitem->Geo = mGeometries["modelGeo"].get();
 	modelRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	modelRitem->IndexCount = modelRitem->Geo->DrawArgs["model"].IndexCount;
 	modelRitem->StartIndexLocation = modelRitem->Geo->DrawArgs["model"].StartIndexLocation;
 	modelRitem->BaseVertexLocation = modelRitem->Geo->DrawArgs["model"].BaseVertexLocation;
+	modelRitem->Bounds = modelRitem->Geo->DrawArgs["model"].Bounds;
 	
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(modelRitem.get());
+	mModelRitem = modelRitem.get();
 	mAllRitems.push_back(std::move(modelRitem));
 }
 
-std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> CreepApp::GetStaticSamplers()
+std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> CreepApp::GetStaticSamplers()
 {
 	// Applications usually only need a handful of samplers.  So just define them all up front
 	// and keep them available as part of the root signature.  
@@ -713,21 +1411,36 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> CreepApp::GetStaticSamplers()
 		0.0f,                              // mipLODBias
 		8);                                // maxAnisotropy
 
+	// Outside the shadow map counts as lit.
+	const CD3DX12_STATIC_SAMPLER_DESC shadow(
+		6, // shaderRegister
+		D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT, // filter
+		D3D12_TEXTURE_ADDRESS_MODE_BORDER,  // addressU
+		D3D12_TEXTURE_ADDRESS_MODE_BORDER,  // addressV
+		D3D12_TEXTURE_ADDRESS_MODE_BORDER,  // addressW
+		0.0f,                               // mipLODBias
+		16,                                 // maxAnisotropy
+		D3D12_COMPARISON_FUNC_LESS_EQUAL,
+		D3D12_STATIC_BORDER_COLOR_OPAQUE_WHITE);
+
 	return { 
 		pointWrap, pointClamp,
 		linearWrap, linearClamp, 
-		anisotropicWrap, anisotropicClamp };
+		anisotropicWrap, anisotropicClamp,
+		shadow };
 }
 
 void CreepApp::Update(const GameTimer& gt)
 {
 	//加载模型和贴图，为了实时更换
 	LoadTexAndGeo(Gui::currentModelIndex);
+	ApplyFramePacing();
+	UpdateShaderReload();
     OnKeyboardInput(gt);
 	UpdateCamera(gt);
 
     // Cycle through the circular frame resource array.
-    mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
+    mCurrFrameResourceIndex = mFramePacing.Advance();
     mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
     // Has the GPU finished processing the commands of the current frame resource?
@@ -739,61 +1452,162 @@ void CreepApp::Update(const GameTimer& gt)
         WaitForSingleObject(eventHandle, INFINITE);
         CloseHandle(eventHandle);
     }
+
+	// The GPU is done with this frame resource, so its constant pages can be rewound.
+	UINT64 completedFence = mFence->GetCompletedValue();
+	mCurrFrameResource->ConstantAlloc->Reset(completedFence);
+	mConstantPagePool->Trim(completedFence, mFramePacing.FrameResourceCount());
+	mUploadStats = UploadStats();
 	
 	AnimateMaterials(gt);
-	UpdateObjectCBs(gt);
+	UpdateInstanceData(gt);
 	UpdateMaterialCBs(gt);
+	// Before the pass constants, which carry the shadow cascades fitted to
+	// the culled scene.
+	CullRenderItems();
+	UpdateClusteredLights(gt);
 	UpdateMainPassCB(gt);
+	// Allocated last, their sizes change with the visible set.
+	BuildInstanceBatches();
+	UpdateShadowPassCBs();
+	UploadClusteredLights();
 
 }
 
 void CreepApp::Draw(const GameTimer& gt)
 {
     auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
+	auto postCmdListAlloc = mCurrFrameResource->PostCmdListAlloc;
 	
     // Reuse the memory associated with command recording.
     // We can only reset when the associated command lists have finished execution on the GPU.
     ThrowIfFailed(cmdListAlloc->Reset());
+	ThrowIfFailed(postCmdListAlloc->Reset());
+	for(auto& workerAlloc : mCurrFrameResource->WorkerCmdListAllocs)
+		ThrowIfFailed(workerAlloc->Reset());
+
+	// Render targets and pipeline states the chunk lists bind; worked out
+	// here so the workers only read them.
+	BuildFrameGraph();
+	if(m4xMsaaState)
+	{
+		mDrawPSOs[(int)DrawPipeline::Opaque] = static_cast<ID3D12PipelineState*>(mPipelineQueue->Get(mPSOs["msaa4x"]));
+		mDrawPSOs[(int)DrawPipeline::Sky] = static_cast<ID3D12PipelineState*>(mPipelineQueue->Get(mPSOs["msaa_sky"]));
+		mDrawPSOs[(int)DrawPipeline::OpaqueFade] = static_cast<ID3D12PipelineState*>(mPipelineQueue->Get(mPSOs["msaa_fade"]));
+	}else {
+		mDrawPSOs[(int)DrawPipeline::Opaque] = static_cast<ID3D12PipelineState*>(mPipelineQueue->Get(mPSOs["opaque"]));
+		mDrawPSOs[(int)DrawPipeline::Sky] = static_cast<ID3D12PipelineState*>(mPipelineQueue->Get(mPSOs["sky"]));
+		mDrawPSOs[(int)DrawPipeline::OpaqueFade] = static_cast<ID3D12PipelineState*>(mPipelineQueue->Get(mPSOs["opaque_fade"]));
+	}
 
 	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
 	// Reusing the command list reuses memory.
-	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
+	//第一个命令列表：转换状态和清屏；最后一个命令列表：imgui和resolve，imgui不是线程安全的，在主线程录制
+	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), nullptr));
+	ThrowIfFailed(mPostCommandList->Reset(postCmdListAlloc.Get(), nullptr));
 
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
-	if(m4xMsaaState)
-	{
-		ImGui_ImplDX12_SetPipelineSamplesCount(4);
-		m_msaaHelper->Prepare(mCommandList.Get());
-		
-		auto rtvDescriptor = m_msaaHelper->GetMSAARenderTargetView();
-		auto dsvDescriptor = m_msaaHelper->GetMSAADepthStencilView();
-		mCommandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, &dsvDescriptor);
-		mCommandList->ClearRenderTargetView(rtvDescriptor, Colors::LightSteelBlue, 0, nullptr);
-		mCommandList->ClearDepthStencilView(dsvDescriptor, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+	// The passes record themselves and their barriers into the two lists.
+	mFrameGraph.Execute();
+	auto& finalBarriers = mFrameGraph.FinalBarriers();
+	mGraphResources.Barriers(mPostCommandList.Get(), finalBarriers.data(), (UINT)finalBarriers.size());
 
-		//设置根签名和常量缓冲区
-		ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
-		mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-		mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
-		//RootParameterIndex对应根签名参数下标
-		//先绑定cbv
-		auto passCB = mCurrFrameResource->PassCB->Resource();
-		mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+	ThrowIfFailed(mCommandList->Close());
+	ThrowIfFailed(mPostCommandList->Close());
 
-		auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
-		mCommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
+	// The batches are recorded by the workers into one list per chunk and
+	// everything is submitted in order by SubmitChunks.
+	UINT chunkCount = mRecorder->Split((UINT)mInstanceBatcher.Batches().size(), mRecorder->MaxUsefulChunks());
+	EnsureChunkCommandLists(chunkCount);
+	mChunkStateStats.assign(chunkCount, StateCacheStats());
+	mRecorder->Record(*this);
 
-		CD3DX12_GPU_DESCRIPTOR_HANDLE texDescriptor(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-		texDescriptor.Offset(1, mCbvSrvDescriptorSize);//0是ui的srv然后modeltex，cubetex
-		mCommandList->SetGraphicsRootDescriptorTable(3, texDescriptor);
+    // Swap the back and front buffers
+    ThrowIfFailed(mSwapChain->Present(0, 0));
+	mCurrBackBuffer = (mCurrBackBuffer + 1) % mSwapChainBufferCount;
 
+    // Advance the fence value to mark commands up to this fence point.
+    mCurrFrameResource->Fence = ++mCurrentFence;
 
-		mCommandList->SetPipelineState(mPSOs["msaa4x"].Get());
-		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+    // Add an instruction to the command queue to set a new fence point. 
+    // Because we are on the GPU timeline, the new fence point won't be 
+    // set until the GPU finishes processing all the commands prior to this Signal().
+    mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+}
+
+void CreepApp::BuildFrameGraph()
+{
+	mFrameGraph.Reset();
 
-		mCommandList->SetPipelineState(mPSOs["sky"].Get());
-		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Sky]);
+	RenderGraphResource backBuffer = mFrameGraph.Import("BackBuffer", ResourceState::Present, ResourceState::Present);
+	mGraphResources.BindImport(mFrameGraph.ResourceOf(backBuffer), CurrentBackBuffer(), CurrentBackBufferView());
+
+	//MSAA目标只在开启时声明，由图分配在共用的堆里，关闭时不占显存
+	RenderGraphResource color = backBuffer;
+	RenderGraphResource depth;
+	if(m4xMsaaState)
+	{
+		RenderGraphTextureDesc colorDesc;
+		colorDesc.Width = (std::uint32_t)mClientWidth;
+		colorDesc.Height = (std::uint32_t)mClientHeight;
+		colorDesc.Format = mBackBufferFormat;
+		colorDesc.SampleCount = 4;
+		colorDesc.Flags = RenderGraphTextureRenderTarget;
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(colorDesc.ClearColor), Colors::LightSteelBlue);
+		mGraphResources.Describe(colorDesc);
+		color = mFrameGraph.CreateTexture("MSAAColor", colorDesc);
+
+		RenderGraphTextureDesc depthDesc = colorDesc;
+		depthDesc.Format = mDepthStencilFormat;
+		depthDesc.Flags = RenderGraphTextureDepthStencil;
+		mGraphResources.Describe(depthDesc);
+		depth = mFrameGraph.CreateTexture("MSAADepth", depthDesc);
+	}else {
+		depth = mFrameGraph.Import("DepthStencil", ResourceState::DepthWrite, ResourceState::DepthWrite);
+		mGraphResources.BindImport(mFrameGraph.ResourceOf(depth), mDepthStencilBuffer.Get(), {}, DepthStencilView());
+	}
+
+	// Only the slices whose content changed are drawn, the others keep
+	// what earlier frames drew; with nothing to draw the map is only read.
+	RenderGraphResource shadowMap = mFrameGraph.Import("ShadowMap", ResourceState::PixelShaderResource, ResourceState::PixelShaderResource);
+	mGraphResources.BindImport(mFrameGraph.ResourceOf(shadowMap), mShadowMap.Get());
+	if(!mShadowSlices.empty())
+	{
+		RenderGraphPass shadowPass = mFrameGraph.AddPass("Shadow", [this](const RenderGraphBarrier* barriers, UINT count)
+		{
+			mGraphResources.Barriers(mCommandList.Get(), barriers, count);
+			DrawShadowSlices();
+		});
+		shadowMap = mFrameGraph.Write(shadowPass, shadowMap, ResourceState::DepthWrite);
+	}
+
+	RenderGraphPass clearPass = mFrameGraph.AddPass("Clear", [this](const RenderGraphBarrier* barriers, UINT count)
+	{
+		mGraphResources.Barriers(mCommandList.Get(), barriers, count);
+		mCommandList->ClearRenderTargetView(mPassRtv, Colors::LightSteelBlue, 0, nullptr);
+		mCommandList->ClearDepthStencilView(mPassDsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+	});
+	color = mFrameGraph.Write(clearPass, color, ResourceState::RenderTarget);
+	depth = mFrameGraph.Write(clearPass, depth, ResourceState::DepthWrite);
+
+	// The draws go into the chunk lists, which are submitted right after
+	// mCommandList, so the barriers before them can go at its end.
+	RenderGraphPass scenePass = mFrameGraph.AddPass("Scene", [this](const RenderGraphBarrier* barriers, UINT count)
+	{
+		mGraphResources.Barriers(mCommandList.Get(), barriers, count);
+	});
+	mFrameGraph.Read(scenePass, shadowMap, ResourceState::PixelShaderResource);
+	color = mFrameGraph.Write(scenePass, color, ResourceState::RenderTarget);
+	depth = mFrameGraph.Write(scenePass, depth, ResourceState::DepthWrite);
+
+	RenderGraphPass guiPass = mFrameGraph.AddPass("Gui", [this](const RenderGraphBarrier* barriers, UINT count)
+	{
+		mGraphResources.Barriers(mPostCommandList.Get(), barriers, count);
+
+		D3D12CommandSink postSink(mPostCommandList.Get());
+		CommandStateCache postState(&postSink);
+		SetPassState(mPostCommandList.Get(), postState);
+		mStateStats = postState.Stats();
+		ImGui_ImplDX12_SetPipelineSamplesCount(m4xMsaaState ? 4 : 1);
 
 		// Start the Dear ImGui frame
 		ImGui_ImplDX12_NewFrame();
@@ -801,99 +1615,395 @@ void CreepApp::Draw(const GameTimer& gt)
 		ImGui::NewFrame();
 		Gui::setGUI();
 		ImGui::Render();
-		ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), mCommandList.Get());
-		
-		m_msaaHelper->Resolve(mCommandList.Get(), CurrentBackBuffer(),D3D12_RESOURCE_STATE_PRESENT);
+		ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), mPostCommandList.Get());
+	});
+	color = mFrameGraph.Write(guiPass, color, ResourceState::RenderTarget);
+	depth = mFrameGraph.Write(guiPass, depth, ResourceState::DepthWrite);
 
-	}else {
-		ImGui_ImplDX12_SetPipelineSamplesCount(1);
+	if(m4xMsaaState)
+	{
+		std::uint32_t msaaColor = mFrameGraph.ResourceOf(color);
+		RenderGraphPass resolvePass = mFrameGraph.AddPass("Resolve", [this, msaaColor](const RenderGraphBarrier* barriers, UINT count)
+		{
+			mGraphResources.Barriers(mPostCommandList.Get(), barriers, count);
+			mPostCommandList->ResolveSubresource(CurrentBackBuffer(), 0, mGraphResources.Resource(msaaColor), 0, mBackBufferFormat);
+		});
+		mFrameGraph.Read(resolvePass, color, ResourceState::ResolveSource);
+		backBuffer = mFrameGraph.Write(resolvePass, backBuffer, ResourceState::ResolveDest);
+	}
 
-		// Indicate a state transition on the resource usage.
-		mCommandList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-			D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET)));
+	mFrameGraph.Compile();
 
-		// Clear the back buffer and depth buffer.
-		mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
-		mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+	// Only happens when the size or MSAA setting changes.
+	if(mGraphResources.NeedsRealize(mFrameGraph))
+	{
+		FlushCommandQueue();
+		mGraphResources.Realize(mFrameGraph);
+	}
 
-		// Specify the buffers we are going to render to.
-		mCommandList->OMSetRenderTargets(1, get_rvalue_ptr(CurrentBackBufferView()), true, get_rvalue_ptr(DepthStencilView()));
+	mPassRtv = mGraphResources.Rtv(mFrameGraph.ResourceOf(color));
+	mPassDsv = mGraphResources.Dsv(mFrameGraph.ResourceOf(depth));
+}
 
-		ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
-		mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+void CreepApp::RecordItems(UINT chunkIndex, const RecordChunk& chunk, UINT executor)
+{
+	// Each executor has its own allocator, so lists recorded at the same time never share one.
+	auto cmdList = mChunkCommandLists[chunkIndex].Get();
+	ThrowIfFailed(cmdList->Reset(mCurrFrameResource->WorkerCmdListAllocs[executor].Get(), nullptr));
 
-		mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
+	D3D12CommandSink sink(cmdList);
+	CommandStateCache state(&sink);
+	SetPassState(cmdList, state);
+	DrawBatches(state, mInstanceBatcher, mDrawPSOs, chunk.First, chunk.Count);
+	mChunkStateStats[chunkIndex] = state.Stats();
 
-		auto passCB = mCurrFrameResource->PassCB->Resource();
-		mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+	ThrowIfFailed(cmdList->Close());
+}
 
-		auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
-		mCommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
+void CreepApp::SubmitChunks(UINT chunkCount)
+{
+	mSubmitLists.clear();
+	mSubmitLists.push_back(mCommandList.Get());
+	for(UINT i = 0; i < chunkCount; ++i)
+		mSubmitLists.push_back(mChunkCommandLists[i].Get());
+	mSubmitLists.push_back(mPostCommandList.Get());
 
-		CD3DX12_GPU_DESCRIPTOR_HANDLE texDescriptor(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-		texDescriptor.Offset(1, mCbvSrvDescriptorSize);//0是ui的srv然后modeltex，cubetex
-		mCommandList->SetGraphicsRootDescriptorTable(3, texDescriptor);
+	for(UINT i = 0; i < chunkCount; ++i)
+		mStateStats += mChunkStateStats[i];
 
-		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+    // Add the command lists to the queue for execution.
+	mCommandQueue->ExecuteCommandLists((UINT)mSubmitLists.size(), mSubmitLists.data());
+}
 
-		mCommandList->SetPipelineState(mPSOs["sky"].Get());
-		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Sky]);
-		
-		// Start the Dear ImGui frame
-		ImGui_ImplDX12_NewFrame();
-		ImGui_ImplWin32_NewFrame();
-		ImGui::NewFrame();
+void CreepApp::SetPassState(ID3D12GraphicsCommandList* cmdList, CommandStateCache& state)
+{
+	// Command lists do not inherit state from each other, every chunk sets it up again.
+	cmdList->RSSetViewports(1, &mScreenViewport);
+	cmdList->RSSetScissorRects(1, &mScissorRect);
+	cmdList->OMSetRenderTargets(1, &mPassRtv, true, &mPassDsv);
+
+	void* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	state.SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	state.SetGraphicsRootSignature(mRootSignature.Get());
+
+	//RootParameterIndex对应根签名参数下标
+	state.SetGraphicsRootConstantBufferView(1, mCurrFrameResource->PassCB.GpuAddress);
+	state.SetGraphicsRootShaderResourceView(2, mCurrFrameResource->MaterialBuffer.GpuAddress);
+	state.SetGraphicsRootShaderResourceView(4, mCurrFrameResource->InstanceBuffer.GpuAddress);
+	state.SetGraphicsRootShaderResourceView(5, mCurrFrameResource->InstanceIndexBuffer.GpuAddress);
+	state.SetGraphicsRootShaderResourceView(6, mCurrFrameResource->ClusterLightBuffer.GpuAddress);
+	state.SetGraphicsRootShaderResourceView(7, mCurrFrameResource->ClusterRangeBuffer.GpuAddress);
+	state.SetGraphicsRootShaderResourceView(8, mCurrFrameResource->ClusterIndexBuffer.GpuAddress);
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE texDescriptor(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	texDescriptor.Offset(1, mCbvSrvDescriptorSize);//0是ui的srv然后modeltex，cubetex
+	state.SetGraphicsRootDescriptorTable(3, texDescriptor.ptr);
+}
 
-		Gui::setGUI();
+void CreepApp::EnsureChunkCommandLists(UINT count)
+{
+	while(mChunkCommandLists.size() < count)
+	{
+		ComPtr<ID3D12GraphicsCommandList> cmdList;
+		ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+			mCurrFrameResource->CmdListAlloc.Get(), nullptr, IID_PPV_ARGS(cmdList.GetAddressOf())));
+		// Created open; closed so the first Reset in RecordItems is valid.
+		ThrowIfFailed(cmdList->Close());
+		mChunkCommandLists.push_back(cmdList);
+	}
+}
 
-		ImGui::Render();
-		ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), mCommandList.Get());
+void CreepApp::CullRenderItems()
+{
+	XMMATRIX viewProj = XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj());
+	Frustum frustum = FrustumCull::ExtractFrustum(MathHelper::ToFloat4x4(viewProj));
 
-		// Indicate a state transition on the resource usage.
-		mCommandList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT)));
+	XMFLOAT3 eye = mCamera.GetPosition3f();
+	ContributionLens lens = ContributionCull::MakeLens({ eye.x, eye.y, eye.z }, mCamera.GetFovY(), mCamera.GetNearZ(), (float)mClientHeight);
+	UINT culledDraws = 0;
+	UINT culledTriangles = 0;
+
+	for(int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		auto& items = mRitemLayer[layer];
+		auto& bounds = mLayerBounds[layer];
+		bounds.Resize((std::uint32_t)items.size());
+
+		// Items move through mTransforms, so world bounds are redone every frame.
+		mThreadPool->ParallelForRange((std::uint32_t)items.size(), FrustumCuller::GrainSize,
+			[&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+		{
+			for(std::uint32_t i = begin; i < end; ++i)
+			{
+				const BoundingBox& local = items[i]->Bounds;
+				Float3 center, extents;
+				FrustumCull::TransformBox({ local.Center.x, local.Center.y, local.Center.z },
+					{ local.Extents.x, local.Extents.y, local.Extents.z },
+					mTransforms.GetWorld(items[i]->ObjIndex), center, extents);
+				bounds.Set(i, center, extents);
+			}
+		});
+
+		// A changed item list is a new scene, otherwise only what moved is refitted.
+		auto& bvh = mLayerBvh[layer];
+		if(bvh.ItemCount() != bounds.Count())
+			bvh.Build(bounds, mThreadPool.get());
+		else
+		{
+			for(std::uint32_t i = 0; i < bounds.Count(); ++i)
+				bvh.SetBounds(i, bounds.Center(i), bounds.Extents(i));
+			bvh.Refit(mThreadPool.get());
+		}
+
+		mVisibleItems[layer].clear();
+		bvh.Query(frustum, mVisibleItems[layer]);
+
+		// Before the occlusion test, which then has fewer items to test.
+		ContributionCuller::Settings settings;
+		settings.MinPixelArea = Gui::minPixelArea[layer];
+		settings.FadePixelArea = Gui::fadePixelArea[layer];
+		mSmallItems.clear();
+		mContributionCullers[layer].Cull(lens, bounds, settings, mThreadPool.get(), mVisibleItems[layer], mSmallItems);
+		culledDraws += (UINT)mSmallItems.size();
+		for(auto index : mSmallItems)
+			culledTriangles += items[index]->IndexCount / 3;
 	}
-	
-    // Done recording commands.
-    ThrowIfFailed(mCommandList->Close());
+	Gui::culledDraws = (int)culledDraws;
+	Gui::culledTriangles = (int)culledTriangles;
 
-    // Add the command list to the queue for execution.
-    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-    mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	CullOccludedItems(MathHelper::ToFloat4x4(viewProj), MathHelper::ToFloat4x4(XMMatrixInverse(nullptr, viewProj)));
+}
 
-    // Swap the back and front buffers
-    ThrowIfFailed(mSwapChain->Present(0, 0));
-	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
+void CreepApp::CullOccludedItems(const Float4x4& viewProj, const Float4x4& invViewProj)
+{
+	const int opaque = (int)RenderLayer::Opaque;
+	auto& items = mRitemLayer[opaque];
+	auto& bounds = mLayerBounds[opaque];
+	auto& visible = mVisibleItems[opaque];
+
+	// Occluders are the items covering the most of the screen; one crossing
+	// the near plane may cover all of it.
+	const float width = (float)mOccluderDepth.Width();
+	const float height = (float)mOccluderDepth.Height();
+	mOccluders.clear();
+	for(std::uint32_t v = 0; v < visible.size(); ++v)
+	{
+		MaskedOcclusionBuffer::ScreenRect rect;
+		float area = width * height;
+		if(mOccluderDepth.ProjectBox(bounds.Center(visible[v]), bounds.Extents(visible[v]), viewProj, rect))
+		{
+			area = std::max(0.0f, std::min(rect.MaxX, width) - std::max(rect.MinX, 0.0f)) *
+				std::max(0.0f, std::min(rect.MaxY, height) - std::max(rect.MinY, 0.0f));
+		}
+		if(area >= OccluderMinScreenFraction * width * height)
+			mOccluders.push_back({ area, v });
+	}
+	std::sort(mOccluders.begin(), mOccluders.end(), std::greater<>());
 
-    // Advance the fence value to mark commands up to this fence point.
-    mCurrFrameResource->Fence = ++mCurrentFence;
+	XMFLOAT4X4 viewProjRows = MathHelper::ToXMFLOAT4X4(viewProj);
+	XMMATRIX viewProjMatrix = XMLoadFloat4x4(&viewProjRows);
 
-    // Add an instruction to the command queue to set a new fence point. 
-    // Because we are on the GPU timeline, the new fence point won't be 
-    // set until the GPU finishes processing all the commands prior to this Signal().
-    mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+	mOccluderDepth.Clear();
+	mOccludeeVisible.assign(visible.size(), 0);
+	UINT triangles = 0;
+	for(const auto& occluder : mOccluders)
+	{
+		const RenderItem* ri = items[visible[occluder.second]];
+		const MeshGeometry* geo = ri->Geo;
+		const UINT triangleCount = ri->IndexCount / 3;
+		if(ri->PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST || geo->VertexBufferCPU == nullptr ||
+			geo->IndexBufferCPU == nullptr || triangles + triangleCount > OccluderTriangleBudget)
+			continue;
+		triangles += triangleCount;
+		// An occluder is drawn, whatever else hides it.
+		mOccludeeVisible[occluder.second] = 1;
+
+		XMFLOAT4X4 world = MathHelper::ToXMFLOAT4X4(mTransforms.GetWorld(ri->ObjIndex));
+		XMMATRIX worldViewProj = XMMatrixMultiply(XMLoadFloat4x4(&world), viewProjMatrix);
+
+		// Only the vertices the submesh can index are transformed.
+		const UINT vertexCount = geo->VertexBufferByteSize / geo->VertexByteStride - ri->BaseVertexLocation;
+		const auto* positions = static_cast<const std::uint8_t*>(geo->VertexBufferCPU->GetBufferPointer()) +
+			(size_t)ri->BaseVertexLocation * geo->VertexByteStride;
+		mOccluderVertices.resize(vertexCount);
+		MaskedOcclusionBuffer::TransformVertices(positions, geo->VertexByteStride, vertexCount,
+			MathHelper::ToFloat4x4(worldViewProj), mOccluderVertices.data());
+
+		const void* indices = geo->IndexBufferCPU->GetBufferPointer();
+		if(geo->IndexFormat == DXGI_FORMAT_R16_UINT)
+			mOccluderDepth.RenderTriangles(mOccluderVertices.data(),
+				static_cast<const std::uint16_t*>(indices) + ri->StartIndexLocation, triangleCount);
+		else
+			mOccluderDepth.RenderTriangles(mOccluderVertices.data(),
+				static_cast<const std::uint32_t*>(indices) + ri->StartIndexLocation, triangleCount);
+	}
+
+	mOcclusionBuffer = mOccluderDepth;
+	if(mHasPrevOccluders)
+		mOcclusionBuffer.Reproject(mPrevOccluderDepth, mPrevInvViewProj, viewProj);
+	std::swap(mOccluderDepth, mPrevOccluderDepth);
+	mPrevInvViewProj = invViewProj;
+	mHasPrevOccluders = true;
+
+	mThreadPool->ParallelForRange((std::uint32_t)visible.size(), 256,
+		[&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+	{
+		for(std::uint32_t v = begin; v < end; ++v)
+		{
+			if(!mOccludeeVisible[v])
+				mOccludeeVisible[v] = mOcclusionBuffer.IsBoxVisible(bounds.Center(visible[v]), bounds.Extents(visible[v]), viewProj);
+		}
+	});
+
+	std::size_t kept = 0;
+	for(std::size_t v = 0; v < visible.size(); ++v)
+	{
+		if(mOccludeeVisible[v])
+			visible[kept++] = visible[v];
+	}
+	visible.resize(kept);
 }
-void CreepApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+
+void CreepApp::BuildInstanceBatches()
 {
-	//绑定帧资源
-    UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-    
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-	
-    // For each render item...
-    for(size_t i = 0; i < ritems.size(); ++i)
-    {
-        auto ri = ritems[i];
+	mBatchItems.clear();
+	mDrawKeys.clear();
+	mDrawOrder.clear();
 
-        cmdList->IASetVertexBuffers(0, 1, get_rvalue_ptr(ri->Geo->VertexBufferView()));
-        cmdList->IASetIndexBuffer(get_rvalue_ptr(ri->Geo->IndexBufferView()));
-        cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+	XMFLOAT3 eye = mCamera.GetPosition3f();
+	XMFLOAT3 look = mCamera.GetLook3f();
 
-        D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
-		
-		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
-    }
+	for(int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		for(auto visible : mVisibleItems[layer])
+		{
+			auto ri = mRitemLayer[layer][visible];
+
+			// Fading opaque items draw with the pipeline that dithers, after
+			// the plain ones of their layer.  The sky shader does not fade.
+			const float fade = mContributionCullers[layer].Fade(visible);
+			const std::uint32_t fadeByte = (std::uint32_t)((1.0f - fade) * 255.0f + 0.5f);
+			const std::uint32_t pipeline = fadeByte != 0 && layer == (int)RenderLayer::Opaque ?
+				(std::uint32_t)DrawPipeline::OpaqueFade : (std::uint32_t)layer;
+
+			// All current layers are opaque; a blended layer would use
+			// DrawKey::MakeTransparent to go back to front.
+			Float3 pos = mTransforms.GetTranslation(ri->ObjIndex);
+			float viewDepth = (pos.x - eye.x)*look.x + (pos.y - eye.y)*look.y + (pos.z - eye.z)*look.z;
+			mDrawKeys.push_back(DrawKey::MakeOpaque((std::uint32_t)layer, 0, pipeline,
+				(std::uint32_t)ri->Mat->MatCBIndex, DrawKey::MeshId(ri->Geo, ri->StartIndexLocation),
+				DrawKey::QuantizeDepth(viewDepth, mCamera.GetNearZ(), mCamera.GetFarZ())));
+			mDrawOrder.push_back((std::uint32_t)mBatchItems.size());
+
+			BatchItem item;
+			item.Geometry = ri->Geo;
+			item.Material = ri->Mat;
+			item.PipelineState = pipeline;
+			item.PrimitiveTopology = (std::uint32_t)ri->PrimitiveType;
+			item.IndexCount = ri->IndexCount;
+			item.StartIndexLocation = ri->StartIndexLocation;
+			item.BaseVertexLocation = ri->BaseVertexLocation;
+			item.InstanceIndex = ri->ObjIndex | (fadeByte << InstanceFadeShift);
+			mBatchItems.push_back(item);
+		}
+	}
+
+	mDrawSorter.Sort(mDrawKeys.data(), mDrawOrder.data(), mDrawKeys.size(), mThreadPool.get());
+
+	mSortedBatchItems.resize(mBatchItems.size());
+	for(size_t i = 0; i < mDrawOrder.size(); ++i)
+		mSortedBatchItems[i] = mBatchItems[mDrawOrder[i]];
+
+	mInstanceBatcher.Build(mSortedBatchItems.data(), mSortedBatchItems.size());
+
+	//每帧可见物体不同，索引每帧重新写入
+	auto& indices = mInstanceBatcher.InstanceIndices();
+	auto indexBuffer = mCurrFrameResource->ConstantAlloc->Allocate(sizeof(std::uint32_t) * indices.size());
+	if(indexBuffer)
+		memcpy(indexBuffer.CpuAddress, indices.data(), sizeof(std::uint32_t) * indices.size());
+	mCurrFrameResource->InstanceIndexBuffer = indexBuffer;
+}
+
+void CreepApp::DrawBatches(CommandStateCache& state, const InstanceBatcher& batcher,
+	ID3D12PipelineState* const* pipelineStates, UINT first, UINT count)
+{
+	auto& batches = batcher.Batches();
+
+	// The state cache drops everything that repeats from the previous batch:
+	// batches are sorted by layer, material and mesh, so neighbours mostly
+	// share the pipeline state and buffers.
+	for(UINT i = first; i < first + count; ++i)
+	{
+		auto& batch = batches[i];
+
+		// Pipeline still being created on a worker.
+		if(pipelineStates[batch.PipelineState] == nullptr)
+			continue;
+		state.SetPipelineState(pipelineStates[batch.PipelineState]);
+
+		auto geo = static_cast<const MeshGeometry*>(batch.Geometry);
+		D3D12_VERTEX_BUFFER_VIEW vbv = geo->VertexBufferView();
+		D3D12_INDEX_BUFFER_VIEW ibv = geo->IndexBufferView();
+
+		state.SetVertexBuffer(0, { vbv.BufferLocation, vbv.SizeInBytes, vbv.StrideInBytes });
+		// The lit pipelines read OCCLUSION for every mesh.  Leaving slot 1 as
+		// it was would give an unbaked mesh black ambient, or the occlusion
+		// of the mesh drawn before it.
+		if(geo->OcclusionBufferGPU != nullptr)
+		{
+			D3D12_VERTEX_BUFFER_VIEW occlusion = geo->OcclusionBufferView();
+			state.SetVertexBuffer(1, { occlusion.BufferLocation, occlusion.SizeInBytes, occlusion.StrideInBytes });
+		}else {
+			state.SetVertexBuffer(1, { mUnoccludedStream->GetGPUVirtualAddress(), sizeof(std::uint8_t), 0 });
+		}
+		state.SetIndexBuffer({ ibv.BufferLocation, ibv.SizeInBytes, (std::uint32_t)ibv.Format });
+		state.SetPrimitiveTopology(batch.PrimitiveTopology);
+
+		// The shaders add SV_InstanceID to this to find their object slot.
+		state.SetGraphicsRoot32BitConstant(0, batch.FirstInstance, 0);
+		state.DrawIndexedInstanced(batch.IndexCount, batch.InstanceCount,
+			batch.StartIndexLocation, batch.BaseVertexLocation, 0);
+	}
+}
+
+void CreepApp::DrawShadowSlices()
+{
+	ID3D12PipelineState* shadowPSO = static_cast<ID3D12PipelineState*>(mPipelineQueue->Get(mPSOs["shadow"]));
+
+	D3D12CommandSink sink(mCommandList.Get());
+	CommandStateCache state(&sink);
+
+	D3D12_VIEWPORT viewport = { 0.0f, 0.0f, (float)ShadowMapSize, (float)ShadowMapSize, 0.0f, 1.0f };
+	D3D12_RECT scissorRect = { 0, 0, (LONG)ShadowMapSize, (LONG)ShadowMapSize };
+	mCommandList->RSSetViewports(1, &viewport);
+	mCommandList->RSSetScissorRects(1, &scissorRect);
+
+	state.SetGraphicsRootSignature(mRootSignature.Get());
+	state.SetGraphicsRootShaderResourceView(2, mCurrFrameResource->MaterialBuffer.GpuAddress);
+	state.SetGraphicsRootShaderResourceView(4, mCurrFrameResource->InstanceBuffer.GpuAddress);
+
+	for(UINT slice : mShadowSlices)
+	{
+		CD3DX12_CPU_DESCRIPTOR_HANDLE dsv(mShadowDsvHeap->GetCPUDescriptorHandleForHeapStart(), slice, mDsvDescriptorSize);
+		mCommandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+
+		const InstanceBatcher& batcher = mShadowBatchers[slice];
+		if(batcher.Batches().empty())
+			continue;
+
+		// Without its pipeline or constants the slice stays cleared and is
+		// drawn again next frame.
+		if(shadowPSO == nullptr || !mCurrFrameResource->ShadowPassCB[slice] || !mCurrFrameResource->ShadowIndexBuffer[slice])
+		{
+			mShadowCache.Invalidate(slice);
+			continue;
+		}
+
+		mCommandList->OMSetRenderTargets(0, nullptr, false, &dsv);
+		state.SetGraphicsRootConstantBufferView(1, mCurrFrameResource->ShadowPassCB[slice].GpuAddress);
+		state.SetGraphicsRootShaderResourceView(5, mCurrFrameResource->ShadowIndexBuffer[slice].GpuAddress);
+		DrawBatches(state, batcher, &shadowPSO, 0, (UINT)batcher.Batches().size());
+	}
 }
 
 void CreepApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -902,6 +2012,10 @@ void CreepApp::OnMouseDown(WPARAM btnState, int x, int y)
     mLastMousePos.x = x;
     mLastMousePos.y = y;
 
+	//中键拾取模型上的点
+	if((btnState & MK_MBUTTON) != 0 && !ImGui::GetIO().WantCaptureMouse)
+		PickModel(x, y);
+
     SetCapture(mhMainWnd);
 }
 
@@ -1006,42 +2120,34 @@ void CreepApp::AnimateMaterials(const GameTimer& gt)
 	
 }
 
-void CreepApp::UpdateObjectCBs(const GameTimer& gt)
+void CreepApp::UpdateInstanceData(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-	for(auto& e : mAllRitems)
-	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if(e->NumFramesDirty > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
-			
-			XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
-
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-			objConstants.MaterialIndex = e->Mat->MatCBIndex;
-
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
-
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
-		}
-	}
+	// 32-byte aligned for the streaming stores of the upload kernel.
+	auto instanceBuffer = mCurrFrameResource->ConstantAlloc->Allocate(sizeof(InstanceData) * mTransforms.Count());
+
+	// Last frame's data is only still there if the block landed on the
+	// same retained spot; otherwise every object has to be written again.
+	bool relocated = !instanceBuffer.Retained || instanceBuffer.CpuAddress != mCurrFrameResource->InstanceBuffer.CpuAddress;
+	mCurrFrameResource->InstanceBuffer = instanceBuffer;
+
+	// Only objects this frame resource has not seen yet are written,
+	// straight from the SoA store.
+	if(instanceBuffer)
+		mUploadStats.InstanceBytes = mTransforms.Upload(mCurrFrameResourceIndex, instanceBuffer.CpuAddress, relocated);
 }
 
 void CreepApp::UpdateMaterialCBs(const GameTimer& gt)
 {
-	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
-	for(auto& e : mMaterials)
+	auto matBuffer = mCurrFrameResource->ConstantAlloc->Allocate(sizeof(MaterialData) * mMaterials.size());
+	bool relocated = !matBuffer.Retained || matBuffer.CpuAddress != mCurrFrameResource->MaterialBuffer.CpuAddress;
+	mCurrFrameResource->MaterialBuffer = matBuffer;
+
+	// Only update the material data this frame resource has not seen yet.
+	mMaterialDirty.ConsumeRanges(mCurrFrameResourceIndex, relocated, [&](UINT first, UINT count)
 	{
-		// Only update the cbuffer data if the constants have changed.  If the cbuffer
-		// data changes, it needs to be updated for each FrameResource.
-		Material* mat = e.second.get();
-		if(mat->NumFramesDirty > 0)
+		for(UINT i = first; i < first + count; ++i)
 		{
+			Material* mat = mMaterialSlots[i];
 			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
 
 			MaterialData matData;
@@ -1050,12 +2156,10 @@ void CreepApp::UpdateMaterialCBs(const GameTimer& gt)
 			matData.Roughness = mat->Roughness;
 			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
 			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
-			currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
-
-			// Next FrameResource need to be updated too.
-			mat->NumFramesDirty--;
+			memcpy(matBuffer.CpuAddress + sizeof(MaterialData)*mat->MatCBIndex, &matData, sizeof(MaterialData));
 		}
-	}
+		mUploadStats.MaterialBytes += sizeof(MaterialData) * count;
+	});
 }
 
 void CreepApp::UpdateMainPassCB(const GameTimer& gt)
@@ -1082,16 +2186,335 @@ void CreepApp::UpdateMainPassCB(const GameTimer& gt)
 	mMainPassCB.TotalTime = gt.TotalTime();
 	mMainPassCB.DeltaTime = gt.DeltaTime();
 	mMainPassCB.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
+	Float4 skyIrradiance[9];
+	SphericalHarmonics::ToShaderConstants(mSkyIrradiance, skyIrradiance);
+	for(int i = 0; i < 9; ++i)
+		mMainPassCB.SkyIrradiance[i] = { skyIrradiance[i].x, skyIrradiance[i].y, skyIrradiance[i].z, skyIrradiance[i].w };
 	mMainPassCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
 	mMainPassCB.Lights[0].Strength = { 0.6f, 0.6f, 0.6f };
 	mMainPassCB.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
 	mMainPassCB.Lights[1].Strength = { 0.3f, 0.3f, 0.3f };
 	mMainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
 	mMainPassCB.Lights[2].Strength = { 0.15f, 0.15f, 0.15f };
+	UpdateShadowCascades();
+
+	// The generation only moves if some 16 byte chunk changed, and then only
+	// the changed chunks are copied into this frame resource's copy.
+	mMainPassData.Update(&mMainPassCB);
+
+	auto passCB = mCurrFrameResource->ConstantAlloc->Allocate(sizeof(PassConstants));
+	bool relocated = !passCB.Retained || passCB.CpuAddress != mCurrFrameResource->PassCB.CpuAddress;
+	mCurrFrameResource->PassCB = passCB;
+	mUploadStats.PassBytes = mMainPassData.Upload(mCurrFrameResourceIndex, passCB.CpuAddress, relocated);
+}
+
+
+
+
+void CreepApp::UpdateShadowCascades()
+{
+	auto& bvh = mLayerBvh[(int)RenderLayer::Opaque];
+	auto& items = mRitemLayer[(int)RenderLayer::Opaque];
+	auto& bounds = mLayerBounds[(int)RenderLayer::Opaque];
+
+	// An empty scene leaves the depth range to the cascades.
+	Float3 sceneMin = { 1.0f, 1.0f, 1.0f }, sceneMax = { -1.0f, -1.0f, -1.0f };
+	bvh.Bounds(sceneMin, sceneMax);
+
+	ShadowCamera camera;
+	camera.InvView = MathHelper::ToFloat4x4(XMMatrixInverse(nullptr, mCamera.GetView()));
+	camera.TanHalfFovX = tanf(0.5f * mCamera.GetFovX());
+	camera.TanHalfFovY = tanf(0.5f * mCamera.GetFovY());
+
+	float splitFar[ShadowCascadeCount];
+	ShadowCascades::SplitDistances(mCamera.GetNearZ(), std::min(ShadowDistance, mCamera.GetFarZ()),
+		ShadowCascadeCount, ShadowSplitLambda, splitFar);
+	for(UINT cascade = 0; cascade < ShadowCascadeCount; ++cascade)
+		mMainPassCB.CascadeEnds[cascade] = splitFar[cascade];
+
+	mShadowSlices.clear();
+	for(UINT light = 0; light < MaxShadowLights; ++light)
+	{
+		float splitNear = mCamera.GetNearZ();
+		for(UINT cascade = 0; cascade < ShadowCascadeCount; ++cascade)
+		{
+			const UINT slice = light * ShadowCascadeCount + cascade;
+			if(light >= NumDirLights)
+			{
+				mMainPassCB.ShadowTransforms[slice] = MathHelper::Identity4x4();
+				continue;
+			}
+
+			const XMFLOAT3& direction = mMainPassCB.Lights[light].Direction;
+			ShadowCascade& shadowCascade = mShadowCascades[slice];
+			shadowCascade = ShadowCascades::FitCascade(camera, splitNear, splitFar[cascade],
+				{ direction.x, direction.y, direction.z }, ShadowMapSize, sceneMin, sceneMax);
+			splitNear = splitFar[cascade];
+
+			XMFLOAT4X4 shadowTransform = MathHelper::ToXMFLOAT4X4(shadowCascade.ShadowTransform);
+			XMStoreFloat4x4(&mMainPassCB.ShadowTransforms[slice], XMMatrixTranspose(XMLoadFloat4x4(&shadowTransform)));
+
+			// Occluded items still cast shadows, so casters come from the BVH
+			// and not from the camera's visible list.
+			mShadowCasters.clear();
+			bvh.Query(shadowCascade.CasterVolume, mShadowCasters);
+			if(!mShadowCache.NeedsRender(slice, shadowCascade, mShadowCasters.data(), (UINT)mShadowCasters.size(), bounds))
+				continue;
+
+			mShadowBatchItems.clear();
+			for(auto caster : mShadowCasters)
+			{
+				auto ri = items[caster];
+
+				BatchItem item;
+				item.Geometry = ri->Geo;
+				item.Material = ri->Mat;
+				item.PipelineState = 0;
+				item.PrimitiveTopology = (std::uint32_t)ri->PrimitiveType;
+				item.IndexCount = ri->IndexCount;
+				item.StartIndexLocation = ri->StartIndexLocation;
+				item.BaseVertexLocation = ri->BaseVertexLocation;
+				item.InstanceIndex = ri->ObjIndex;
+				mShadowBatchItems.push_back(item);
+			}
+			mShadowBatchers[slice].Build(mShadowBatchItems.data(), mShadowBatchItems.size());
+			mShadowSlices.push_back(slice);
+		}
+	}
+}
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
-	currPassCB->CopyData(0, mMainPassCB);
+void CreepApp::UpdateShadowPassCBs()
+{
+	for(UINT slice : mShadowSlices)
+	{
+		const ShadowCascade& cascade = mShadowCascades[slice];
+		XMFLOAT4X4 view = MathHelper::ToXMFLOAT4X4(cascade.View);
+		XMFLOAT4X4 proj = MathHelper::ToXMFLOAT4X4(cascade.Proj);
+		XMFLOAT4X4 viewProj = MathHelper::ToXMFLOAT4X4(cascade.ViewProj);
+
+		// The shadow shaders only read the matrices, everything else is the main pass's.
+		PassConstants shadowPassCB = mMainPassCB;
+		XMStoreFloat4x4(&shadowPassCB.View, XMMatrixTranspose(XMLoadFloat4x4(&view)));
+		XMStoreFloat4x4(&shadowPassCB.Proj, XMMatrixTranspose(XMLoadFloat4x4(&proj)));
+		XMStoreFloat4x4(&shadowPassCB.ViewProj, XMMatrixTranspose(XMLoadFloat4x4(&viewProj)));
+		shadowPassCB.RenderTargetSize = XMFLOAT2((float)ShadowMapSize, (float)ShadowMapSize);
+		shadowPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / ShadowMapSize, 1.0f / ShadowMapSize);
+
+		auto passCB = mCurrFrameResource->ConstantAlloc->Allocate(sizeof(PassConstants));
+		if(passCB)
+			memcpy(passCB.CpuAddress, &shadowPassCB, sizeof(PassConstants));
+		mCurrFrameResource->ShadowPassCB[slice] = passCB;
+
+		auto& indices = mShadowBatchers[slice].InstanceIndices();
+		auto indexBuffer = mCurrFrameResource->ConstantAlloc->Allocate(sizeof(std::uint32_t) * indices.size());
+		if(indexBuffer)
+			memcpy(indexBuffer.CpuAddress, indices.data(), sizeof(std::uint32_t) * indices.size());
+		mCurrFrameResource->ShadowIndexBuffer[slice] = indexBuffer;
+	}
 }
 
+void CreepApp::UpdateClusteredLights(const GameTimer& gt)
+{
+	UINT pointCount = (UINT)std::max(Gui::clusteredPointLights, 0);
+	UINT spotCount = (UINT)std::max(Gui::clusteredSpotLights, 0);
+
+	// The lights stay inside the opaque scene, without one there are none.
+	Float3 sceneMin = { 0.0f, 0.0f, 0.0f }, sceneMax = { 0.0f, 0.0f, 0.0f };
+	if(!mLayerBvh[(int)RenderLayer::Opaque].Bounds(sceneMin, sceneMax))
+		pointCount = spotCount = 0;
+
+	const UINT count = pointCount + spotCount;
+	const Float3 center = { 0.5f * (sceneMin.x + sceneMax.x), 0.5f * (sceneMin.y + sceneMax.y), 0.5f * (sceneMin.z + sceneMax.z) };
+	const Float3 extents = { 0.5f * (sceneMax.x - sceneMin.x), 0.5f * (sceneMax.y - sceneMin.y), 0.5f * (sceneMax.z - sceneMin.z) };
+	// About a dozen lights overlap anywhere in the scene, however many there are.
+	const float range = count > 0 ? 4.0f * sqrtf(std::max(extents.x * extents.z, 1.0f) / (float)count) : 0.0f;
+
+	// Where Luna's spot factor drops below 1/256.
+	const float spotPower = 8.0f;
+	const float spotCosAngle = powf(1.0f / 256.0f, 1.0f / spotPower);
+
+	mClusterLights.resize(count);
+	mLightClusters.ClearLights();
+	const float t = gt.TotalTime();
+	for(UINT i = 0; i < count; ++i)
+	{
+		// Spread over the scene on a golden angle spiral, each light
+		// circling at its own speed.
+		const float spread = sqrtf(((float)i + 0.5f) / (float)count);
+		const float speed = 0.1f + 0.3f * (i * 0.618034f - floorf(i * 0.618034f));
+		const float angle = (float)i * 2.399963f + t * speed;
+		const float height = i * 0.754878f - floorf(i * 0.754878f);
+		const float hue = (float)i * 0.381966f * XM_2PI;
+
+		Light& light = mClusterLights[i];
+		light.Position = { center.x + extents.x * spread * cosf(angle),
+			sceneMin.y + (sceneMax.y - sceneMin.y) * height,
+			center.z + extents.z * spread * sinf(angle) };
+		light.Strength = { 0.5f + 0.5f * cosf(hue), 0.5f + 0.5f * cosf(hue + 2.094395f), 0.5f + 0.5f * cosf(hue + 4.188790f) };
+		light.FalloffStart = 0.2f * range;
+		light.FalloffEnd = range;
+
+		if(i < pointCount)
+		{
+			mLightClusters.AddPointLight({ light.Position.x, light.Position.y, light.Position.z }, range);
+			continue;
+		}
 
+		// Spot lights hang from the top of the scene, reach down to its
+		// bottom and sway.
+		light.Position.y = sceneMax.y;
+		light.FalloffEnd = range + (sceneMax.y - sceneMin.y);
+		light.Direction = { 0.3f * cosf(angle * 3.0f), -1.0f, 0.3f * sinf(angle * 3.0f) };
+		XMStoreFloat3(&light.Direction, XMVector3Normalize(XMLoadFloat3(&light.Direction)));
+		light.SpotPower = spotPower;
+		mLightClusters.AddSpotLight({ light.Position.x, light.Position.y, light.Position.z }, light.FalloffEnd,
+			{ light.Direction.x, light.Direction.y, light.Direction.z }, spotCosAngle);
+	}
+
+	LightClusters::Config config;
+	config.TilesX = ClusterTilesX;
+	config.TilesY = ClusterTilesY;
+	config.Slices = ClusterSlices;
+	config.TanHalfFovX = tanf(0.5f * mCamera.GetFovX());
+	config.TanHalfFovY = tanf(0.5f * mCamera.GetFovY());
+	config.NearZ = mCamera.GetNearZ();
+	config.FarZ = mCamera.GetFarZ();
+	mLightClusters.Configure(config);
+	mLightClusters.Assign(MathHelper::ToFloat4x4(mCamera.GetView()), mThreadPool.get());
+
+	mMainPassCB.ClusterDims[0] = ClusterTilesX;
+	mMainPassCB.ClusterDims[1] = ClusterTilesY;
+	mMainPassCB.ClusterDims[2] = ClusterSlices;
+	mMainPassCB.ClusterDims[3] = pointCount;
+	mMainPassCB.ClusterDepth[0] = mLightClusters.SliceScale();
+	mMainPassCB.ClusterDepth[1] = mLightClusters.SliceBias();
+}
 
+void CreepApp::UploadClusteredLights()
+{
+	// Never empty, so the root descriptors always point at a buffer.
+	auto lightBuffer = mCurrFrameResource->ConstantAlloc->Allocate(sizeof(Light) * std::max<size_t>(mClusterLights.size(), 1));
+	if(lightBuffer)
+		memcpy(lightBuffer.CpuAddress, mClusterLights.data(), sizeof(Light) * mClusterLights.size());
+	mCurrFrameResource->ClusterLightBuffer = lightBuffer;
+
+	auto& ranges = mLightClusters.Ranges();
+	auto rangeBuffer = mCurrFrameResource->ConstantAlloc->Allocate(sizeof(LightClusters::Range) * ranges.size());
+	if(rangeBuffer)
+		memcpy(rangeBuffer.CpuAddress, ranges.data(), sizeof(LightClusters::Range) * ranges.size());
+	mCurrFrameResource->ClusterRangeBuffer = rangeBuffer;
+
+	auto& indices = mLightClusters.Indices();
+	auto indexBuffer = mCurrFrameResource->ConstantAlloc->Allocate(sizeof(std::uint32_t) * std::max<size_t>(indices.size(), 1));
+	if(indexBuffer)
+		memcpy(indexBuffer.CpuAddress, indices.data(), sizeof(std::uint32_t) * indices.size());
+	mCurrFrameResource->ClusterIndexBuffer = indexBuffer;
+}
+
+bool CreepApp::DecodeSky(const Texture& sky, CubeMapImage& image)
+{
+	// Mip 0 of every face, straight from the loader's CPU copy of the file;
+	// subresources go face by face, all mips of a face in a row.
+	const D3D12_RESOURCE_DESC desc = sky.Resource->GetDesc();
+	const UINT mipLevels = desc.MipLevels;
+	bool decoded = desc.DepthOrArraySize == 6 && desc.Width == desc.Height && sky.subresources.size() >= 6 * mipLevels;
+
+	image.Resize(decoded ? (std::uint32_t)desc.Width : 0);
+	for(UINT face = 0; decoded && face < 6; ++face)
+	{
+		const D3D12_SUBRESOURCE_DATA& mip0 = sky.subresources[face * mipLevels];
+		decoded = image.DecodeFace(face, (std::uint32_t)desc.Format, mip0.pData, (std::size_t)mip0.RowPitch);
+	}
+	return decoded;
+}
+
+void CreepApp::PickModel(int x, int y)
+{
+	Gui::pickedTriangle = -1;
+	if(mModelRitem == nullptr || mModelBvh.TriangleCount() == 0)
+		return;
+
+	// Ray through the pixel in view space, from the eye.
+	XMFLOAT4X4 P = mCamera.GetProj4x4f();
+	float vx = (+2.0f*x / mClientWidth - 1.0f) / P(0, 0);
+	float vy = (-2.0f*y / mClientHeight + 1.0f) / P(1, 1);
+	XMVECTOR rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	XMVECTOR rayDir = XMVectorSet(vx, vy, 1.0f, 0.0f);
+
+	// The BVH is in the model's object space.
+	XMMATRIX V = mCamera.GetView();
+	XMVECTOR viewDet = XMMatrixDeterminant(V);
+	XMMATRIX invView = XMMatrixInverse(&viewDet, V);
+	XMFLOAT4X4 world = MathHelper::ToXMFLOAT4X4(mTransforms.GetWorld(mModelRitem->ObjIndex));
+	XMMATRIX W = XMLoadFloat4x4(&world);
+	XMVECTOR worldDet = XMMatrixDeterminant(W);
+	XMMATRIX invWorld = XMMatrixInverse(&worldDet, W);
+	XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+
+	rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
+	rayDir = XMVector3Normalize(XMVector3TransformNormal(rayDir, toLocal));
+
+	XMFLOAT3 origin, dir;
+	XMStoreFloat3(&origin, rayOrigin);
+	XMStoreFloat3(&dir, rayDir);
+	TriangleBvh::Hit hit;
+	if(!mModelBvh.Intersect({ origin.x, origin.y, origin.z }, { dir.x, dir.y, dir.z }, MathHelper::Infinity, hit))
+		return;
+
+	XMVECTOR pointW = XMVector3TransformCoord(XMVectorAdd(rayOrigin, XMVectorScale(rayDir, hit.T)), W);
+	XMFLOAT3 point;
+	XMStoreFloat3(&point, pointW);
+	Gui::pickedTriangle = (int)hit.Triangle;
+	Gui::pickedPoint[0] = point.x;
+	Gui::pickedPoint[1] = point.y;
+	Gui::pickedPoint[2] = point.z;
+}
+
+std::vector<std::uint8_t> CreepApp::BakeVertexOcclusion(const std::vector<Vertex>& vertices,
+	const std::vector<std::uint32_t>& indices, const std::string& cachePath)
+{
+	std::vector<Float3> positions(vertices.size()), normals(vertices.size());
+	for(size_t i = 0; i < vertices.size(); ++i)
+	{
+		positions[i] = { vertices[i].Pos.x, vertices[i].Pos.y, vertices[i].Pos.z };
+		normals[i] = { vertices[i].Normal.x, vertices[i].Normal.y, vertices[i].Normal.z };
+	}
+
+	// Baked once per mesh and settings, later loads read the file.
+	const AoBaker::Settings settings;
+	const Hash128 key = AoBaker::Key(positions.data(), normals.data(), (std::uint32_t)positions.size(),
+		indices.data(), (std::uint32_t)indices.size(), settings);
+	std::vector<std::uint8_t> occlusion;
+	if(AoBaker::Load(cachePath, key, occlusion) && occlusion.size() == vertices.size())
+		return occlusion;
+
+	AoBaker::Stats stats;
+	occlusion = AoBaker::Bake(mModelBvh, positions.data(), normals.data(), (std::uint32_t)positions.size(), settings, mThreadPool.get(), &stats);
+
+	char message[160];
+	snprintf(message, sizeof(message), "Baked occlusion of %u vertices: %llu rays in %.1f ms, %.2f Mrays/s\n",
+		(unsigned)positions.size(), (unsigned long long)stats.Rays, stats.Seconds * 1000.0, stats.RaysPerSecond() * 1e-6);
+	OutputDebugStringA(message);
+	if(!AoBaker::Save(cachePath, key, occlusion))
+		OutputDebugStringA("Could not write the baked occlusion, it is baked again next time.\n");
+	return occlusion;
+}
+
+bool CreepApp::PrefilterSky(const CubeMapImage& sky, const std::string& cachePath)
+{
+	// The file keeps the key of the sky and settings it was made from, so it
+	// is only filtered again when either changes.
+	const SpecularPrefilter::Settings settings;
+	const Hash128 key = SpecularPrefilter::Key(sky, settings);
+	Hash128 cachedKey;
+	if(CubeMapImage::ReadDdsKey(cachePath, cachedKey) && cachedKey == key)
+		return true;
+
+	const std::vector<CubeMapImage> mips = SpecularPrefilter::Prefilter(sky, settings, mThreadPool.get());
+	if(!CubeMapImage::SaveDds(cachePath, mips, key))
+	{
+		OutputDebugStringA("Could not write the prefiltered sky, reflections stay unfiltered.\n");
+		return false;
+	}
+	return true;
+}
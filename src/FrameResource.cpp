@@ -1,18 +1,27 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, LinearPagePool* constantPool, UINT workerCount)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
+    ThrowIfFailed(device->CreateCommandAllocator(
+        D3D12_COMMAND_LIST_TYPE_DIRECT,
+        IID_PPV_ARGS(PostCmdListAlloc.GetAddressOf())));
 
-  //  FrameCB = std::make_unique<UploadBuffer<FrameConstants>>(device, 1, true);
-    PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-    MaterialBuffer = std::make_unique<UploadBuffer<MaterialData>>(device, materialCount, true);
-    ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+    WorkerCmdListAllocs.resize(workerCount);
+    for(auto& alloc : WorkerCmdListAllocs)
+    {
+        ThrowIfFailed(device->CreateCommandAllocator(
+            D3D12_COMMAND_LIST_TYPE_DIRECT,
+            IID_PPV_ARGS(alloc.GetAddressOf())));
+    }
+
+    ConstantAlloc = std::make_unique<LinearAllocator>(constantPool);
 }
 
 FrameResource::~FrameResource()
 {
-
+    // Pages may still be referenced by the last frame submitted with this resource.
+    ConstantAlloc->Release(Fence);
 }
\ No newline at end of file
@@ -2,13 +2,23 @@
 
 #include "Utility/MathHelper.h"
 #include "Structure/UploadBuffer.h"
+#include "Utility/TransformStore.h"
 
-struct ObjectConstants
+// Per-object data read by the shaders from a structured buffer, so it is
+// tightly packed instead of padded to 256 bytes like a constant buffer.
+// Written by TransformStore::Upload; 160 bytes keeps every element 32-byte
+// aligned for its streaming stores.
+struct InstanceData
 {
     DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
-    UINT     MaterialIndex;
+    UINT     MaterialIndex = 0;
+    UINT     InstancePad0 = 0;
+    UINT     InstancePad1 = 0;
+    UINT     InstancePad2 = 0;
+    DirectX::XMFLOAT4 InstancePad3 = { 0.0f, 0.0f, 0.0f, 0.0f };
 };
+static_assert(sizeof(InstanceData) == TransformStore::InstanceByteSize, "InstanceData must match TransformStore");
 
 struct PassConstants
 {
@@ -29,11 +39,23 @@ struct PassConstants
 
     DirectX::XMFLOAT4 AmbientLight = { 0.0f, 0.0f, 0.0f, 1.0f };
 
-    // Indices [0, NUM_DIR_LIGHTS) are directional lights;
-    // indices [NUM_DIR_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHTS) are point lights;
-    // indices [NUM_DIR_LIGHTS+NUM_POINT_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHT+NUM_SPOT_LIGHTS)
-    // are spot lights for a maximum of MaxLights per object.
+    // Indices [0, NUM_DIR_LIGHTS) are directional lights; point and spot
+    // lights are in the cluster light buffer.
     Light Lights[MaxLights];
+
+    // World to shadow map texture space of every slice, light *
+    // ShadowCascadeCount + cascade, and the view depth each cascade ends at.
+    DirectX::XMFLOAT4X4 ShadowTransforms[MaxShadowLights * ShadowCascadeCount];
+    float CascadeEnds[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    // Clustered lights: tiles x, y, depth slices and the number of point
+    // lights, which come before the spot lights; the slice of view depth z
+    // is log(z) * ClusterDepth[0] + ClusterDepth[1].
+    UINT ClusterDims[4] = { 0, 0, 0, 0 };
+    float ClusterDepth[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    // Diffuse light from the sky, see SphericalHarmonics::ToShaderConstants.
+    DirectX::XMFLOAT4 SkyIrradiance[9];
 };
 struct MaterialData
 {
@@ -59,7 +81,7 @@ struct FrameResource
 {
 public:
     
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D12Device* device, LinearPagePool* constantPool, UINT workerCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -68,12 +90,37 @@ public:
     // So each frame needs their own allocator.
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
+    // The post list records while the pre list is still open (the frame
+    // graph writes into both), and an allocator takes one open list at a time.
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> PostCmdListAlloc;
+
+    // One allocator per recording thread for the parallel chunk lists,
+    // indexed by ThreadPool executor.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> WorkerCmdListAllocs;
+
     // We cannot update a cbuffer until the GPU is done processing the commands
-    // that reference it.  So each frame needs their own cbuffers.
-   // std::unique_ptr<UploadBuffer<FrameConstants>> FrameCB = nullptr;
-    std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-    std::unique_ptr<UploadBuffer<MaterialData>> MaterialBuffer = nullptr;
-    std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
+    // that reference it.  So each frame carves its constant data out of its own
+    // pages, which are only rewound once Fence has been reached.
+    std::unique_ptr<LinearAllocator> ConstantAlloc = nullptr;
+
+    // Sub-allocations made from ConstantAlloc for the frame being recorded.
+    LinearAllocation PassCB;
+    LinearAllocation MaterialBuffer;
+    LinearAllocation InstanceBuffer;
+
+    // Object slots of the instances of every batch, see InstanceBatcher.
+    LinearAllocation InstanceIndexBuffer;
+
+    // Pass constants and instance indices of the shadow map slices drawn
+    // this frame; the others keep what an earlier frame drew.
+    LinearAllocation ShadowPassCB[MaxShadowLights * ShadowCascadeCount];
+    LinearAllocation ShadowIndexBuffer[MaxShadowLights * ShadowCascadeCount];
+
+    // Clustered lights, the (offset, count) of every cluster and the light
+    // indices the offsets point into, see LightClusters.
+    LinearAllocation ClusterLightBuffer;
+    LinearAllocation ClusterRangeBuffer;
+    LinearAllocation ClusterIndexBuffer;
     
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
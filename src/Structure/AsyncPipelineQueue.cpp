@@ -0,0 +1,104 @@
+#include "AsyncPipelineQueue.h"
+
+#include <stdexcept>
+
+#include "Utility/ThreadPool.h"
+
+AsyncPipelineQueue::AsyncPipelineQueue(ThreadPool* pool) :
+    mPool(pool)
+{
+}
+
+AsyncPipelineQueue::~AsyncPipelineQueue()
+{
+    WaitIdle();
+}
+
+AsyncPipelineQueue::Handle AsyncPipelineQueue::Request(CreateFn create, Handle fallback)
+{
+    const Handle h = (Handle)mSlots.size();
+    if (fallback != NoPipeline && fallback >= h)
+    {
+        throw std::invalid_argument("A pipeline can only fall back to an earlier one.");
+    }
+
+    Slot& slot = mSlots.emplace_back();
+    slot.Fallback = fallback;
+    Schedule(slot, std::move(create));
+    return h;
+}
+
+void AsyncPipelineQueue::Rebuild(Handle h, CreateFn create)
+{
+    Schedule(mSlots[h], std::move(create));
+}
+
+void* AsyncPipelineQueue::Get(Handle h)const
+{
+    // Fallbacks always point to earlier slots, so this ends.
+    while (h != NoPipeline)
+    {
+        const Slot& slot = mSlots[h];
+        if (void* pipeline = slot.Pipeline.load(std::memory_order_acquire))
+            return pipeline;
+        h = slot.Fallback;
+    }
+    return nullptr;
+}
+
+bool AsyncPipelineQueue::IsReady(Handle h)const
+{
+    return mSlots[h].Pipeline.load(std::memory_order_acquire) != nullptr;
+}
+
+bool AsyncPipelineQueue::Failed(Handle h)const
+{
+    return mSlots[h].Failed.load(std::memory_order_acquire);
+}
+
+void AsyncPipelineQueue::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mIdleMutex);
+    mIdle.wait(lock, [this]() { return mPending.load(std::memory_order_acquire) == 0; });
+}
+
+void AsyncPipelineQueue::Schedule(Slot& slot, CreateFn create)
+{
+    std::uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mPublishMutex);
+        generation = ++slot.Requested;
+    }
+    mPending.fetch_add(1, std::memory_order_acq_rel);
+
+    mPool->Submit([this, &slot, generation, create = std::move(create)]()
+    {
+        void* pipeline = nullptr;
+        bool failed = false;
+        try
+        {
+            pipeline = create();
+            failed = pipeline == nullptr;
+        }
+        catch (...)
+        {
+            failed = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mPublishMutex);
+            if (generation > slot.Published)
+            {
+                slot.Published = generation;
+                slot.Failed.store(failed, std::memory_order_release);
+                if (!failed)
+                    slot.Pipeline.store(pipeline, std::memory_order_release);
+            }
+        }
+
+        // Taking the lock orders the decrement against WaitIdle's check.
+        std::lock_guard<std::mutex> lock(mIdleMutex);
+        if (mPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            mIdle.notify_all();
+    });
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+class ThreadPool;
+
+// Pipeline states created on worker threads.  Request returns a handle at
+// once; Get returns null until a worker finished the pipeline and published
+// it, so the renderer never waits on a driver compile.  A slot can name a
+// fallback to use meanwhile, which must be an earlier handle drawing into
+// the same kind of target.  Rebuild keeps the published pipeline in place
+// until its replacement is ready.
+//
+// Pipelines are opaque pointers (see CommandSink) owned by whatever the
+// create functions got them from.  Request, Rebuild and Get are called
+// from one thread; the create functions run on the pool.
+class AsyncPipelineQueue
+{
+public:
+    using Handle = std::uint32_t;
+    using CreateFn = std::function<void*()>;
+
+    static constexpr Handle NoPipeline = ~0u;
+
+    explicit AsyncPipelineQueue(ThreadPool* pool);
+    AsyncPipelineQueue(const AsyncPipelineQueue& rhs) = delete;
+    AsyncPipelineQueue& operator=(const AsyncPipelineQueue& rhs) = delete;
+
+    // Waits for the pipelines still being created.
+    ~AsyncPipelineQueue();
+
+    Handle Request(CreateFn create, Handle fallback = NoPipeline);
+
+    // Queues create for h again; Get keeps returning the old pipeline
+    // until the new one is published.
+    void Rebuild(Handle h, CreateFn create);
+
+    // h's pipeline, else its fallback's, else null and the draw is skipped.
+    void* Get(Handle h)const;
+
+    bool IsReady(Handle h)const;
+
+    // A create function threw; the slot keeps what it had before.
+    bool Failed(Handle h)const;
+
+    std::uint32_t PendingCount()const { return mPending.load(std::memory_order_acquire); }
+
+    // Blocks until nothing is pending, for shutdown and tests.
+    void WaitIdle();
+
+private:
+    struct Slot
+    {
+        std::atomic<void*> Pipeline{ nullptr };
+        std::atomic<bool> Failed{ false };
+        Handle Fallback = NoPipeline;
+
+        // Newest request and newest published result, guarded by
+        // mPublishMutex, so a slow old build never replaces a newer one.
+        std::uint32_t Requested = 0;
+        std::uint32_t Published = 0;
+    };
+
+    void Schedule(Slot& slot, CreateFn create);
+
+    ThreadPool* mPool;
+
+    // Deque so slots stay put while workers write to them.
+    std::deque<Slot> mSlots;
+
+    std::mutex mPublishMutex;
+    std::atomic<std::uint32_t> mPending{ 0 };
+    std::mutex mIdleMutex;
+    std::condition_variable mIdle;
+};
@@ -0,0 +1,145 @@
+#include "ChangeTracker.h"
+
+#include <cstring>
+#include <stdexcept>
+
+DirtyTracker::DirtyTracker(std::uint32_t numFrameResources)
+{
+    SetNumFrameResources(numFrameResources);
+}
+
+void DirtyTracker::Resize(std::uint32_t slotCount)
+{
+    const std::uint32_t oldCount = mSlotCount;
+    const std::uint32_t wordCount = (slotCount + 63) / 64;
+    mSlotCount = slotCount;
+
+    for (auto& f : mFrames)
+    {
+        f.Bits.resize(wordCount, 0);
+        f.Summary.resize((wordCount + 63) / 64, 0);
+
+        // Shrinking must not leave bits past the end behind.
+        if (slotCount < oldCount && wordCount > 0)
+        {
+            f.Bits[wordCount - 1] &= ValidBits(wordCount - 1);
+            if (wordCount % 64 != 0)
+                f.Summary.back() &= (1ull << (wordCount % 64)) - 1;
+        }
+    }
+
+    for (std::uint32_t slot = oldCount; slot < slotCount; ++slot)
+        MarkDirty(slot);
+}
+
+void DirtyTracker::SetNumFrameResources(std::uint32_t numFrameResources)
+{
+    if (numFrameResources == 0)
+    {
+        throw std::invalid_argument("DirtyTracker needs at least one frame resource.");
+    }
+
+    mFrames.assign(numFrameResources, FrameBits{});
+    const std::uint32_t slotCount = mSlotCount;
+    mSlotCount = 0;
+    Resize(slotCount);
+}
+
+void DirtyTracker::MarkDirty(std::uint32_t slot)
+{
+    const std::uint32_t word = slot / 64;
+    for (auto& f : mFrames)
+    {
+        f.Bits[word] |= 1ull << (slot % 64);
+        f.Summary[word / 64] |= 1ull << (word % 64);
+    }
+}
+
+void DirtyTracker::MarkAllDirty()
+{
+    for (auto& f : mFrames)
+    {
+        for (std::uint32_t word = 0; word < (std::uint32_t)f.Bits.size(); ++word)
+        {
+            f.Bits[word] = ValidBits(word);
+            f.Summary[word / 64] |= 1ull << (word % 64);
+        }
+    }
+}
+
+bool DirtyTracker::IsDirty(std::uint32_t frame, std::uint32_t slot)const
+{
+    return (mFrames[frame].Bits[slot / 64] >> (slot % 64)) & 1;
+}
+
+std::uint32_t DirtyTracker::DirtyCount(std::uint32_t frame)const
+{
+    std::uint32_t count = 0;
+    for (std::uint64_t bits : mFrames[frame].Bits)
+        count += (std::uint32_t)std::popcount(bits);
+    return count;
+}
+
+std::uint64_t DirtyTracker::ValidBits(std::uint32_t word)const
+{
+    const std::uint32_t remaining = mSlotCount - word * 64;
+    return remaining >= 64 ? ~0ull : (1ull << remaining) - 1;
+}
+
+TrackedBlock::TrackedBlock(std::size_t byteSize, std::uint32_t numFrameResources) :
+    mData(byteSize, 0),
+    mDirty(numFrameResources),
+    mFrameGeneration(numFrameResources, 0)
+{
+    mDirty.Resize((std::uint32_t)((byteSize + ChunkSize - 1) / ChunkSize));
+}
+
+bool TrackedBlock::Update(const void* data)
+{
+    auto src = static_cast<const std::uint8_t*>(data);
+    bool changed = false;
+
+    for (std::size_t offset = 0; offset < mData.size(); offset += ChunkSize)
+    {
+        const std::size_t size = mData.size() - offset < ChunkSize ? mData.size() - offset : ChunkSize;
+        if (std::memcmp(&mData[offset], src + offset, size) != 0)
+        {
+            std::memcpy(&mData[offset], src + offset, size);
+            mDirty.MarkDirty((std::uint32_t)(offset / ChunkSize));
+            changed = true;
+        }
+    }
+
+    if (changed)
+        ++mGeneration;
+    return changed;
+}
+
+std::size_t TrackedBlock::Upload(std::uint32_t frame, std::uint8_t* dst, bool writeAll)
+{
+    // A frame resource that never saw a generation has garbage in dst.
+    writeAll = writeAll || mFrameGeneration[frame] == 0;
+    if (!writeAll && mFrameGeneration[frame] == mGeneration)
+        return 0;
+
+    std::size_t written = 0;
+    mDirty.ConsumeRanges(frame, writeAll, [&](std::uint32_t first, std::uint32_t count)
+    {
+        const std::size_t offset = first * ChunkSize;
+        std::size_t size = count * ChunkSize;
+        if (offset + size > mData.size())
+            size = mData.size() - offset;
+
+        std::memcpy(dst + offset, &mData[offset], size);
+        written += size;
+    });
+
+    mFrameGeneration[frame] = mGeneration;
+    return written;
+}
+
+void TrackedBlock::SetNumFrameResources(std::uint32_t numFrameResources)
+{
+    mDirty.SetNumFrameResources(numFrameResources);
+    mFrameGeneration.assign(numFrameResources, 0);
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bytes written to upload memory in one frame, split by what was uploaded.
+struct UploadStats
+{
+    std::uint64_t InstanceBytes = 0;
+    std::uint64_t MaterialBytes = 0;
+    std::uint64_t PassBytes = 0;
+
+    std::uint64_t TotalBytes()const { return InstanceBytes + MaterialBytes + PassBytes; }
+};
+
+// Which slots of a per-frame-resource buffer are out of date.  Every frame
+// resource has its own bitset: a change sets the slot's bit in all of them
+// and uploading for one frame resource clears only that frame's bits, so a
+// slot is written exactly once per frame resource after it changed.
+class DirtyTracker
+{
+public:
+    explicit DirtyTracker(std::uint32_t numFrameResources = 3);
+
+    // Slots added by growing start out dirty for every frame resource.
+    void Resize(std::uint32_t slotCount);
+    void Clear() { Resize(0); }
+
+    // Forgets which frame resource saw what, so everything is dirty again.
+    void SetNumFrameResources(std::uint32_t numFrameResources);
+
+    void MarkDirty(std::uint32_t slot);
+    void MarkAllDirty();
+
+    std::uint32_t SlotCount()const { return mSlotCount; }
+    std::uint32_t NumFrameResources()const { return (std::uint32_t)mFrames.size(); }
+    bool IsDirty(std::uint32_t frame, std::uint32_t slot)const;
+    std::uint32_t DirtyCount(std::uint32_t frame)const;
+
+    // Calls fn(wordIndex, bits) for every 64 slot word of frame with a dirty
+    // slot, or for every word if writeAll, and clears those bits.
+    template<typename Fn>
+    void ConsumeWords(std::uint32_t frame, bool writeAll, Fn&& fn);
+
+    // Calls fn(firstSlot, slotCount) for every run of dirty slots of frame,
+    // or once for all slots if writeAll, and clears those bits.
+    template<typename Fn>
+    void ConsumeRanges(std::uint32_t frame, bool writeAll, Fn&& fn);
+
+private:
+    // Summary has one bit per word of Bits, so clean stretches of 4096 slots
+    // cost a single test.
+    struct FrameBits
+    {
+        std::vector<std::uint64_t> Bits;
+        std::vector<std::uint64_t> Summary;
+    };
+
+    std::uint64_t ValidBits(std::uint32_t word)const;
+
+    std::vector<FrameBits> mFrames;
+    std::uint32_t mSlotCount = 0;
+};
+
+// A block of CPU data mirrored into every frame resource, like the pass
+// constants.  Update diffs the new contents in 16 byte chunks; the
+// generation only moves when something changed, so a frame resource that
+// already has the current generation uploads nothing.
+class TrackedBlock
+{
+public:
+    static constexpr std::size_t ChunkSize = 16;
+
+    TrackedBlock(std::size_t byteSize, std::uint32_t numFrameResources = 3);
+
+    // Returns true if data differs from the previous contents.
+    bool Update(const void* data);
+
+    // Writes the chunks frame has not seen yet (or all of them) to dst,
+    // which holds frame's copy of the block.  Returns the bytes written.
+    std::size_t Upload(std::uint32_t frame, std::uint8_t* dst, bool writeAll);
+
+    void SetNumFrameResources(std::uint32_t numFrameResources);
+
+    std::uint64_t Generation()const { return mGeneration; }
+    std::size_t ByteSize()const { return mData.size(); }
+
+private:
+    std::vector<std::uint8_t> mData;
+    DirtyTracker mDirty;
+
+    // Generation 0 is never uploaded, so a fresh frame resource always
+    // gets the first contents.
+    std::uint64_t mGeneration = 1;
+    std::vector<std::uint64_t> mFrameGeneration;
+};
+
+template<typename Fn>
+void DirtyTracker::ConsumeWords(std::uint32_t frame, bool writeAll, Fn&& fn)
+{
+    FrameBits& f = mFrames[frame];
+    const std::uint32_t wordCount = (std::uint32_t)f.Bits.size();
+
+    if (writeAll)
+    {
+        for (std::uint32_t word = 0; word < wordCount; ++word)
+        {
+            fn(word, ValidBits(word));
+            f.Bits[word] = 0;
+        }
+        for (auto& summary : f.Summary)
+            summary = 0;
+        return;
+    }
+
+    for (std::uint32_t s = 0; s < (std::uint32_t)f.Summary.size(); ++s)
+    {
+        for (std::uint64_t summary = f.Summary[s]; summary != 0; summary &= summary - 1)
+        {
+            const std::uint32_t word = s * 64 + (std::uint32_t)std::countr_zero(summary);
+            fn(word, f.Bits[word]);
+            f.Bits[word] = 0;
+        }
+        f.Summary[s] = 0;
+    }
+}
+
+template<typename Fn>
+void DirtyTracker::ConsumeRanges(std::uint32_t frame, bool writeAll, Fn&& fn)
+{
+    if (writeAll)
+    {
+        ConsumeWords(frame, true, [](std::uint32_t, std::uint64_t) {});
+        if (mSlotCount > 0)
+            fn(0u, mSlotCount);
+        return;
+    }
+
+    // Runs that end on a word boundary are held back in case the next word
+    // continues them.
+    std::uint32_t runFirst = 0;
+    std::uint32_t runCount = 0;
+    ConsumeWords(frame, false, [&](std::uint32_t word, std::uint64_t bits)
+    {
+        while (bits != 0)
+        {
+            const std::uint32_t start = (std::uint32_t)std::countr_zero(bits);
+            const std::uint32_t length = (std::uint32_t)std::countr_one(bits >> start);
+            const std::uint32_t first = word * 64 + start;
+
+            if (runCount > 0 && runFirst + runCount == first)
+            {
+                runCount += length;
+            }
+            else
+            {
+                if (runCount > 0)
+                    fn(runFirst, runCount);
+                runFirst = first;
+                runCount = length;
+            }
+
+            bits = start + length < 64 ? bits & ~((~0ull >> (64 - length)) << start) : 0;
+        }
+    });
+
+    if (runCount > 0)
+        fn(runFirst, runCount);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "StateCache.h"
+#include "ResourceStateTracker.h"
+
+// Forwards CommandSink calls to a D3D12 graphics command list.
+class D3D12CommandSink : public CommandSink
+{
+public:
+    explicit D3D12CommandSink(ID3D12GraphicsCommandList* cmdList) : mCmdList(cmdList) {}
+
+    void SetPipelineState(void* pipelineState)override
+    {
+        mCmdList->SetPipelineState(static_cast<ID3D12PipelineState*>(pipelineState));
+    }
+
+    void SetGraphicsRootSignature(void* rootSignature)override
+    {
+        mCmdList->SetGraphicsRootSignature(static_cast<ID3D12RootSignature*>(rootSignature));
+    }
+
+    void SetDescriptorHeaps(std::uint32_t count, void* const* heaps)override
+    {
+        // At most one CBV/SRV/UAV and one sampler heap can be bound.
+        ID3D12DescriptorHeap* d3dHeaps[2] = {};
+        for (std::uint32_t i = 0; i < count && i < 2; ++i)
+            d3dHeaps[i] = static_cast<ID3D12DescriptorHeap*>(heaps[i]);
+        mCmdList->SetDescriptorHeaps(count < 2 ? count : 2, d3dHeaps);
+    }
+
+    void SetVertexBuffer(std::uint32_t slot, const VertexBufferBinding& view)override
+    {
+        D3D12_VERTEX_BUFFER_VIEW vbv = { view.BufferLocation, view.SizeInBytes, view.StrideInBytes };
+        mCmdList->IASetVertexBuffers(slot, 1, &vbv);
+    }
+
+    void SetIndexBuffer(const IndexBufferBinding& view)override
+    {
+        D3D12_INDEX_BUFFER_VIEW ibv = { view.BufferLocation, view.SizeInBytes, (DXGI_FORMAT)view.Format };
+        mCmdList->IASetIndexBuffer(&ibv);
+    }
+
+    void SetPrimitiveTopology(std::uint32_t topology)override
+    {
+        mCmdList->IASetPrimitiveTopology((D3D12_PRIMITIVE_TOPOLOGY)topology);
+    }
+
+    void SetGraphicsRoot32BitConstant(std::uint32_t parameter, std::uint32_t value, std::uint32_t offset)override
+    {
+        mCmdList->SetGraphicsRoot32BitConstant(parameter, value, offset);
+    }
+
+    void SetGraphicsRootConstantBufferView(std::uint32_t parameter, std::uint64_t address)override
+    {
+        mCmdList->SetGraphicsRootConstantBufferView(parameter, address);
+    }
+
+    void SetGraphicsRootShaderResourceView(std::uint32_t parameter, std::uint64_t address)override
+    {
+        mCmdList->SetGraphicsRootShaderResourceView(parameter, address);
+    }
+
+    void SetGraphicsRootDescriptorTable(std::uint32_t parameter, std::uint64_t baseDescriptor)override
+    {
+        mCmdList->SetGraphicsRootDescriptorTable(parameter, D3D12_GPU_DESCRIPTOR_HANDLE{ baseDescriptor });
+    }
+
+    void DrawIndexedInstanced(std::uint32_t indexCount, std::uint32_t instanceCount,
+        std::uint32_t startIndex, std::int32_t baseVertex, std::uint32_t startInstance)override
+    {
+        mCmdList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+    }
+
+    void ResourceBarrier(std::uint32_t count, const ResourceBarrierDesc* barriers)override
+    {
+        mBarriers.resize(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            const ResourceBarrierDesc& b = barriers[i];
+            auto resource = static_cast<ID3D12Resource*>(const_cast<void*>(b.Resource));
+            if (b.Kind == ResourceBarrierDesc::Type::UnorderedAccess)
+            {
+                mBarriers[i] = CD3DX12_RESOURCE_BARRIER::UAV(resource);
+                continue;
+            }
+
+            D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+            if (b.Flags == ResourceBarrierDesc::Split::BeginOnly)
+                flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+            else if (b.Flags == ResourceBarrierDesc::Split::EndOnly)
+                flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+
+            mBarriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(resource,
+                (D3D12_RESOURCE_STATES)b.Before, (D3D12_RESOURCE_STATES)b.After, b.Subresource, flags);
+        }
+        mCmdList->ResourceBarrier(count, mBarriers.data());
+    }
+
+private:
+    ID3D12GraphicsCommandList* mCmdList = nullptr;
+    std::vector<D3D12_RESOURCE_BARRIER> mBarriers;
+};
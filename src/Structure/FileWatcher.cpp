@@ -0,0 +1,214 @@
+#include "FileWatcher.h"
+
+#include <cstdint>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <unordered_map>
+#endif
+
+namespace
+{
+    // Same spelling as ShaderCache::ExpandIncludes uses for file names.
+    std::string JoinPath(const std::string& dir, const std::filesystem::path& name)
+    {
+        return (std::filesystem::path(dir) / name).lexically_normal().generic_string();
+    }
+}
+
+#if defined(_WIN32)
+
+struct FileWatcher::Impl
+{
+    struct Directory
+    {
+        std::string Path;
+        HANDLE Handle = INVALID_HANDLE_VALUE;
+        OVERLAPPED Overlapped = {};
+        bool Pending = false;
+        alignas(DWORD) std::uint8_t Buffer[16 * 1024];
+    };
+
+    // Pointers, the system writes into Overlapped and Buffer.
+    std::vector<std::unique_ptr<Directory>> Directories;
+
+    static void Issue(Directory& d)
+    {
+        ResetEvent(d.Overlapped.hEvent);
+        d.Pending = ReadDirectoryChangesW(d.Handle, d.Buffer, sizeof(d.Buffer), FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+            nullptr, &d.Overlapped, nullptr) != FALSE;
+    }
+
+    ~Impl()
+    {
+        for (auto& d : Directories)
+        {
+            if (d->Pending)
+            {
+                DWORD bytes = 0;
+                CancelIoEx(d->Handle, &d->Overlapped);
+                GetOverlappedResult(d->Handle, &d->Overlapped, &bytes, TRUE);
+            }
+            CloseHandle(d->Overlapped.hEvent);
+            CloseHandle(d->Handle);
+        }
+    }
+};
+
+bool FileWatcher::Watch(const std::string& dir)
+{
+    const std::string path = std::filesystem::path(dir).lexically_normal().generic_string();
+    for (auto& d : mImpl->Directories)
+    {
+        if (d->Path == path)
+            return true;
+    }
+
+    HANDLE handle = CreateFileW(std::filesystem::path(dir).c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    auto d = std::make_unique<Impl::Directory>();
+    d->Path = path;
+    d->Handle = handle;
+    d->Overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    Impl::Issue(*d);
+    if (!d->Pending)
+    {
+        CloseHandle(d->Overlapped.hEvent);
+        CloseHandle(handle);
+        return false;
+    }
+
+    mImpl->Directories.push_back(std::move(d));
+    return true;
+}
+
+void FileWatcher::Poll(std::vector<std::string>& changed)
+{
+    for (auto& d : mImpl->Directories)
+    {
+        // A read that failed to start or finished with an error is
+        // simply started again.
+        if (!d->Pending)
+        {
+            Impl::Issue(*d);
+            continue;
+        }
+
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(d->Handle, &d->Overlapped, &bytes, FALSE))
+        {
+            if (GetLastError() != ERROR_IO_INCOMPLETE)
+                Impl::Issue(*d);
+            continue;
+        }
+
+        // Zero bytes means the buffer overflowed and the changes are lost.
+        for (std::uint32_t offset = 0; bytes != 0;)
+        {
+            auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(d->Buffer + offset);
+            if (info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_ADDED ||
+                info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+            {
+                const std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+                changed.push_back(JoinPath(d->Path, name));
+            }
+
+            if (info->NextEntryOffset == 0)
+                break;
+            offset += info->NextEntryOffset;
+        }
+
+        Impl::Issue(*d);
+    }
+}
+
+#elif defined(__linux__)
+
+struct FileWatcher::Impl
+{
+    int Fd = -1;
+    std::unordered_map<int, std::string> Directories;
+
+    ~Impl()
+    {
+        if (Fd >= 0)
+            close(Fd);
+    }
+};
+
+bool FileWatcher::Watch(const std::string& dir)
+{
+    if (mImpl->Fd < 0)
+    {
+        mImpl->Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (mImpl->Fd < 0)
+            return false;
+    }
+
+    // Saving in place closes a written file, saving through a temporary
+    // renames it over the old one.
+    const int wd = inotify_add_watch(mImpl->Fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0)
+        return false;
+
+    mImpl->Directories[wd] = std::filesystem::path(dir).lexically_normal().generic_string();
+    return true;
+}
+
+void FileWatcher::Poll(std::vector<std::string>& changed)
+{
+    if (mImpl->Fd < 0)
+        return;
+
+    alignas(inotify_event) char buffer[4096];
+    while (true)
+    {
+        const ssize_t size = read(mImpl->Fd, buffer, sizeof(buffer));
+        if (size <= 0)
+            break;
+
+        for (ssize_t offset = 0; offset < size;)
+        {
+            auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            auto dir = mImpl->Directories.find(event->wd);
+            if (event->len == 0 || (event->mask & IN_ISDIR) || dir == mImpl->Directories.end())
+                continue;
+            changed.push_back(JoinPath(dir->second, event->name));
+        }
+    }
+}
+
+#else
+
+struct FileWatcher::Impl
+{
+};
+
+bool FileWatcher::Watch(const std::string& dir)
+{
+    return false;
+}
+
+void FileWatcher::Poll(std::vector<std::string>& changed)
+{
+}
+
+#endif
+
+FileWatcher::FileWatcher() :
+    mImpl(std::make_unique<Impl>())
+{
+}
+
+FileWatcher::~FileWatcher() = default;
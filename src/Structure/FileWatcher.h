@@ -0,0 +1,30 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reports files written in a set of directories, without blocking.  Uses
+// ReadDirectoryChangesW on Windows and inotify on Linux; subdirectories
+// are not watched.  Editors save in bursts (truncate, write, rename), so
+// one save can show up as several changes and callers should debounce.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    FileWatcher(const FileWatcher& rhs) = delete;
+    FileWatcher& operator=(const FileWatcher& rhs) = delete;
+    ~FileWatcher();
+
+    // Returns false if dir cannot be watched.  Watching a directory twice
+    // is harmless.
+    bool Watch(const std::string& dir);
+
+    // Appends dir/name for every file changed since the last call, in the
+    // order the system reported them; duplicates are possible.
+    void Poll(std::vector<std::string>& changed);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> mImpl;
+};
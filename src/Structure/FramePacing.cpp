@@ -0,0 +1,59 @@
+#include "FramePacing.h"
+
+namespace
+{
+    FramePacingSettings Clamp(FramePacingSettings settings)
+    {
+        if (settings.FramesInFlight < FramePacing::MinFramesInFlight)
+            settings.FramesInFlight = FramePacing::MinFramesInFlight;
+        if (settings.FramesInFlight > FramePacing::MaxFramesInFlight)
+            settings.FramesInFlight = FramePacing::MaxFramesInFlight;
+        return settings;
+    }
+}
+
+FramePacing::FramePacing(FramePacingSettings settings) :
+    mSettings(Clamp(settings)),
+    mPending(mSettings),
+    mCurrentFrame(FrameResourceCount() - 1)
+{
+}
+
+void FramePacing::Request(FramePacingSettings settings)
+{
+    mPending = Clamp(settings);
+}
+
+void FramePacing::ApplyPending()
+{
+    mSettings = mPending;
+
+    // The next Advance lands on frame resource 0.
+    mCurrentFrame = FrameResourceCount() - 1;
+    mFrameCount = 0;
+}
+
+std::uint32_t FramePacing::FrameResourceCount()const
+{
+    if (mSettings.Mode == LatencyMode::LowLatency && mSettings.FramesInFlight > 2)
+        return 2;
+    return mSettings.FramesInFlight;
+}
+
+std::uint32_t FramePacing::SwapChainBufferCount()const
+{
+    const std::uint32_t count = MaxFrameLatency() + 1;
+    return count < 2 ? 2 : count;
+}
+
+std::uint32_t FramePacing::MaxFrameLatency()const
+{
+    return mSettings.Mode == LatencyMode::LowLatency ? 1 : mSettings.FramesInFlight;
+}
+
+std::uint32_t FramePacing::Advance()
+{
+    mCurrentFrame = (mCurrentFrame + 1) % FrameResourceCount();
+    ++mFrameCount;
+    return mCurrentFrame;
+}
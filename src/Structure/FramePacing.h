@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+enum class LatencyMode
+{
+    // Let the CPU run up to FramesInFlight frames ahead of the display.
+    Throughput,
+    // Keep a single frame queued for presentation and wait for it before
+    // reading input, trading GPU overlap for input-to-photon time.
+    LowLatency
+};
+
+struct FramePacingSettings
+{
+    std::uint32_t FramesInFlight = 3;
+    LatencyMode Mode = LatencyMode::Throughput;
+
+    bool operator==(const FramePacingSettings& rhs)const = default;
+};
+
+// Frames-in-flight bookkeeping: which frame resource is being recorded and
+// how many frame resources, swap chain buffers and queued presents the
+// current settings call for.  New settings are only requested here; the
+// owner idles the GPU, calls ApplyPending and rebuilds to match.
+class FramePacing
+{
+public:
+    static constexpr std::uint32_t MinFramesInFlight = 1;
+    static constexpr std::uint32_t MaxFramesInFlight = 4;
+    static constexpr std::uint32_t MaxSwapChainBufferCount = MaxFramesInFlight + 1;
+
+    explicit FramePacing(FramePacingSettings settings = {});
+
+    // FramesInFlight is clamped to [MinFramesInFlight, MaxFramesInFlight].
+    void Request(FramePacingSettings settings);
+    bool HasPendingChange()const { return !(mPending == mSettings); }
+
+    // Switches to the requested settings and restarts the ring.  Only valid
+    // once nothing recorded with the old frame resources is in flight.
+    void ApplyPending();
+
+    const FramePacingSettings& Settings()const { return mSettings; }
+
+    // Low latency mode records at most one frame while the GPU works on the
+    // previous one, more frame resources would only sit idle.
+    std::uint32_t FrameResourceCount()const;
+
+    // Flip model needs two buffers, one more than the frames that can be
+    // queued keeps the CPU from blocking on Present.
+    std::uint32_t SwapChainBufferCount()const;
+
+    // Value for IDXGISwapChain2::SetMaximumFrameLatency.
+    std::uint32_t MaxFrameLatency()const;
+
+    // Index of the frame resource being recorded.
+    std::uint32_t CurrentFrame()const { return mCurrentFrame; }
+
+    // Moves to the next frame resource in the ring and returns its index.
+    std::uint32_t Advance();
+
+    // Total frames started since the last ApplyPending.
+    std::uint64_t FrameCount()const { return mFrameCount; }
+
+private:
+    FramePacingSettings mSettings;
+    FramePacingSettings mPending;
+
+    std::uint32_t mCurrentFrame = 0;
+    std::uint64_t mFrameCount = 0;
+};
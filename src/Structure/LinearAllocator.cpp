@@ -0,0 +1,215 @@
+#include "LinearAllocator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+    std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+LinearPagePool::LinearPagePool(LinearPageProvider* provider, std::uint64_t pageSize) :
+    mProvider(provider),
+    mPageSize(AlignUp(pageSize, LinearAllocator::ConstantBufferAlignment))
+{
+    if (mProvider == nullptr || pageSize == 0)
+    {
+        throw std::invalid_argument("LinearPagePool needs a provider and a non-zero page size.");
+    }
+}
+
+LinearPagePool::~LinearPagePool()
+{
+    // Destroying the pool means the device is idle, fences no longer matter.
+    for (auto& retired : mRetiredPages)
+        DestroyPage(retired.Page);
+    for (auto& retired : mRetiredLargePages)
+        DestroyPage(retired.Page);
+}
+
+LinearAllocPage LinearPagePool::RequestPage(std::uint64_t byteSize, std::uint64_t completedFence)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (byteSize <= mPageSize)
+    {
+        if (!mRetiredPages.empty() && mRetiredPages.front().Fence <= completedFence)
+        {
+            LinearAllocPage page = mRetiredPages.front().Page;
+            mRetiredPages.pop_front();
+            return page;
+        }
+        byteSize = mPageSize;
+    }
+    else
+    {
+        byteSize = AlignUp(byteSize, mPageSize);
+    }
+
+    LinearAllocPage page = mProvider->CreatePage(byteSize);
+    ++mPageCount;
+    mResidentBytes += page.Size;
+    return page;
+}
+
+void LinearPagePool::DiscardPages(std::uint64_t fenceValue, const LinearAllocPage* pages, std::size_t count)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto& queue = pages[i].Size == mPageSize ? mRetiredPages : mRetiredLargePages;
+
+        // Frame resources retire in fence order, but a resize can hand back
+        // pages out of order.  Keep the queue sorted so the front check holds.
+        auto it = queue.end();
+        while (it != queue.begin() && std::prev(it)->Fence > fenceValue)
+            --it;
+        queue.insert(it, RetiredPage{ fenceValue, pages[i] });
+    }
+}
+
+void LinearPagePool::Trim(std::uint64_t completedFence, std::size_t maxFreePages)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    while (!mRetiredLargePages.empty() && mRetiredLargePages.front().Fence <= completedFence)
+    {
+        DestroyPage(mRetiredLargePages.front().Page);
+        mRetiredLargePages.pop_front();
+    }
+
+    // Oldest first, those are the ones the GPU is certainly done with.
+    while (mRetiredPages.size() > maxFreePages && mRetiredPages.front().Fence <= completedFence)
+    {
+        DestroyPage(mRetiredPages.front().Page);
+        mRetiredPages.pop_front();
+    }
+}
+
+std::size_t LinearPagePool::PageCount()const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPageCount;
+}
+
+std::size_t LinearPagePool::FreePageCount()const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRetiredPages.size() + mRetiredLargePages.size();
+}
+
+std::uint64_t LinearPagePool::ResidentBytes()const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mResidentBytes;
+}
+
+void LinearPagePool::DestroyPage(LinearAllocPage& page)
+{
+    --mPageCount;
+    mResidentBytes -= page.Size;
+    mProvider->DestroyPage(page);
+}
+
+LinearAllocator::LinearAllocator(LinearPagePool* pool) :
+    mPool(pool)
+{
+}
+
+LinearAllocator::~LinearAllocator()
+{
+    // The owner is expected to call Release with the last fence it signaled,
+    // falling back to the last completed one keeps the pages from leaking.
+    Release(mCompletedFence);
+}
+
+LinearAllocation LinearAllocator::Allocate(std::uint64_t byteSize, std::uint64_t alignment)
+{
+    if (byteSize == 0)
+        return {};
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        throw std::invalid_argument("LinearAllocator alignment must be a power of two.");
+    }
+
+    const std::uint64_t size = AlignUp(byteSize, alignment);
+    std::uint64_t offset = 0;
+
+    if (mPages.empty())
+    {
+        mPages.push_back({ mPool->RequestPage(size, mCompletedFence), false });
+        mCurrentPage = 0;
+    }
+    else
+    {
+        offset = AlignUp(mOffset, alignment);
+        if (offset + size > mPages[mCurrentPage].Page.Size)
+        {
+            // Move on to the next page kept from the last frame, if it is big enough.
+            ++mCurrentPage;
+            offset = 0;
+            if (mCurrentPage == mPages.size() || mPages[mCurrentPage].Page.Size < size)
+            {
+                mPages.insert(mPages.begin() + mCurrentPage, { mPool->RequestPage(size, mCompletedFence), false });
+            }
+        }
+    }
+
+    OwnedPage& owned = mPages[mCurrentPage];
+    mOffset = offset + size;
+    mBytesAllocated += size;
+    return { owned.Page.CpuAddress + offset, owned.Page.GpuAddress + offset, size, owned.Retained };
+}
+
+void LinearAllocator::Reset(std::uint64_t completedFence)
+{
+    mCompletedFence = completedFence;
+
+    // Pages past the last one used are surplus now, the pool can hand them
+    // to another frame resource or free them.
+    DiscardOwnedPages(completedFence, mBytesAllocated == 0 ? 0 : mCurrentPage + 1);
+
+    for (auto& owned : mPages)
+        owned.Retained = true;
+
+    mCurrentPage = 0;
+    mOffset = 0;
+    mBytesAllocated = 0;
+}
+
+void LinearAllocator::Release(std::uint64_t fenceValue)
+{
+    DiscardOwnedPages(fenceValue, 0);
+
+    mCurrentPage = 0;
+    mOffset = 0;
+    mBytesAllocated = 0;
+}
+
+std::uint64_t LinearAllocator::BytesReserved()const
+{
+    std::uint64_t bytes = 0;
+    for (auto& owned : mPages)
+        bytes += owned.Page.Size;
+    return bytes;
+}
+
+void LinearAllocator::DiscardOwnedPages(std::uint64_t fenceValue, std::size_t first)
+{
+    if (first >= mPages.size())
+        return;
+
+    std::vector<LinearAllocPage> pages;
+    pages.reserve(mPages.size() - first);
+    for (std::size_t i = first; i < mPages.size(); ++i)
+        pages.push_back(mPages[i].Page);
+
+    mPool->DiscardPages(fenceValue, pages.data(), pages.size());
+    mPages.resize(first);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// A page of persistently mapped memory handed out by a LinearPageProvider.
+// Handle is opaque to the allocator and only interpreted by the provider.
+struct LinearAllocPage
+{
+    std::uint8_t* CpuAddress = nullptr;
+    std::uint64_t GpuAddress = 0;
+    std::uint64_t Size = 0;
+    void* Handle = nullptr;
+};
+
+// Creates and destroys the backing memory of the pages.  The D3D12 version
+// lives in UploadBuffer.h, the paging logic below does not depend on it.
+class LinearPageProvider
+{
+public:
+    virtual ~LinearPageProvider() = default;
+
+    virtual LinearAllocPage CreatePage(std::uint64_t byteSize) = 0;
+    virtual void DestroyPage(LinearAllocPage& page) = 0;
+};
+
+struct LinearAllocation
+{
+    std::uint8_t* CpuAddress = nullptr;
+    std::uint64_t GpuAddress = 0;
+    std::uint64_t Size = 0;
+
+    // True if the page was kept over from the previous frame of the same
+    // allocator, so bytes written there last time are still in place.
+    bool Retained = false;
+
+    explicit operator bool()const { return CpuAddress != nullptr; }
+};
+
+// Pages shared by all frame resources.  A page that is handed back together
+// with a fence value is only reused once the GPU has reached that fence.
+class LinearPagePool
+{
+public:
+    static constexpr std::uint64_t DefaultPageSize = 64 * 1024;
+
+    LinearPagePool(LinearPageProvider* provider, std::uint64_t pageSize = DefaultPageSize);
+    LinearPagePool(const LinearPagePool& rhs) = delete;
+    LinearPagePool& operator=(const LinearPagePool& rhs) = delete;
+    ~LinearPagePool();
+
+    // Returns a page of at least byteSize bytes.  Standard sized pages are
+    // recycled when their fence has completed, larger ones are always new.
+    LinearAllocPage RequestPage(std::uint64_t byteSize, std::uint64_t completedFence);
+
+    // The pages may still be referenced by commands up to fenceValue.
+    void DiscardPages(std::uint64_t fenceValue, const LinearAllocPage* pages, std::size_t count);
+
+    // Destroys retired pages above maxFreePages and every retired oversized page.
+    void Trim(std::uint64_t completedFence, std::size_t maxFreePages);
+
+    std::uint64_t PageSize()const { return mPageSize; }
+    std::size_t PageCount()const;
+    std::size_t FreePageCount()const;
+    std::uint64_t ResidentBytes()const;
+
+private:
+    struct RetiredPage
+    {
+        std::uint64_t Fence = 0;
+        LinearAllocPage Page;
+    };
+
+    void DestroyPage(LinearAllocPage& page);
+
+    LinearPageProvider* mProvider = nullptr;
+    std::uint64_t mPageSize = DefaultPageSize;
+
+    // Kept in fence order so only the front has to be checked.
+    std::deque<RetiredPage> mRetiredPages;
+    std::deque<RetiredPage> mRetiredLargePages;
+
+    std::size_t mPageCount = 0;
+    std::uint64_t mResidentBytes = 0;
+
+    mutable std::mutex mMutex;
+};
+
+// Bump allocator over a list of pages owned by one frame resource.  Reset
+// rewinds to the first page without giving the pages back, so a frame that
+// makes the same sequence of allocations as last time lands on the same
+// addresses and finds its previous contents still there.
+class LinearAllocator
+{
+public:
+    static constexpr std::uint64_t ConstantBufferAlignment = 256;
+
+    explicit LinearAllocator(LinearPagePool* pool);
+    LinearAllocator(const LinearAllocator& rhs) = delete;
+    LinearAllocator& operator=(const LinearAllocator& rhs) = delete;
+    ~LinearAllocator();
+
+    LinearAllocation Allocate(std::uint64_t byteSize, std::uint64_t alignment = ConstantBufferAlignment);
+
+    // Must only be called once the GPU is done with everything allocated
+    // since the last Reset.  Pages the last frame did not touch go back to the pool.
+    void Reset(std::uint64_t completedFence);
+
+    // Hands every page back to the pool; they stay alive until fenceValue.
+    void Release(std::uint64_t fenceValue);
+
+    std::size_t PageCount()const { return mPages.size(); }
+    std::uint64_t BytesAllocated()const { return mBytesAllocated; }
+    std::uint64_t BytesReserved()const;
+
+private:
+    struct OwnedPage
+    {
+        LinearAllocPage Page;
+        bool Retained = false;
+    };
+
+    void DiscardOwnedPages(std::uint64_t fenceValue, std::size_t first);
+
+    LinearPagePool* mPool = nullptr;
+
+    std::vector<OwnedPage> mPages;
+    std::size_t mCurrentPage = 0;
+    std::uint64_t mOffset = 0;
+    std::uint64_t mCompletedFence = 0;
+    std::uint64_t mBytesAllocated = 0;
+};
@@ -0,0 +1,57 @@
+#include "ParallelRecorder.h"
+
+#include "Utility/ThreadPool.h"
+
+ParallelRecorder::ParallelRecorder(ThreadPool* pool, std::uint32_t minItemsPerChunk) :
+    mPool(pool),
+    mMinItemsPerChunk(minItemsPerChunk == 0 ? 1 : minItemsPerChunk)
+{
+}
+
+std::uint32_t ParallelRecorder::Split(std::uint32_t itemCount, std::uint32_t maxChunks)
+{
+    std::uint32_t chunkCount = itemCount / mMinItemsPerChunk;
+    if (chunkCount > maxChunks)
+        chunkCount = maxChunks;
+    if (chunkCount == 0)
+        chunkCount = 1;
+
+    // The first itemCount % chunkCount chunks take one extra item.
+    mChunks.resize(chunkCount);
+    const std::uint32_t base = itemCount / chunkCount;
+    const std::uint32_t extra = itemCount % chunkCount;
+
+    std::uint32_t first = 0;
+    for (std::uint32_t i = 0; i < chunkCount; ++i)
+    {
+        mChunks[i].First = first;
+        mChunks[i].Count = base + (i < extra ? 1 : 0);
+        first += mChunks[i].Count;
+    }
+    return chunkCount;
+}
+
+void ParallelRecorder::Record(CommandRecordBackend& backend)
+{
+    const std::uint32_t chunkCount = (std::uint32_t)mChunks.size();
+
+    if (mPool == nullptr || chunkCount == 1)
+    {
+        for (std::uint32_t i = 0; i < chunkCount; ++i)
+            backend.RecordItems(i, mChunks[i], mPool ? mPool->CurrentExecutor() : 0);
+    }
+    else
+    {
+        mPool->ParallelFor(chunkCount, [&](std::uint32_t index, std::uint32_t executor)
+        {
+            backend.RecordItems(index, mChunks[index], executor);
+        });
+    }
+
+    backend.SubmitChunks(chunkCount);
+}
+
+std::uint32_t ParallelRecorder::MaxUsefulChunks()const
+{
+    return mPool ? mPool->ExecutorCount() : 1;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Contiguous range of the draw list recorded into one command list.
+struct RecordChunk
+{
+    std::uint32_t First = 0;
+    std::uint32_t Count = 0;
+};
+
+// What ParallelRecorder drives.  The D3D12 version is CreepApp; anything
+// that records per chunk and submits in order will do.
+class CommandRecordBackend
+{
+public:
+    virtual ~CommandRecordBackend() = default;
+
+    // Called on a worker thread.  executor identifies the thread, so a
+    // backend can keep one command allocator per executor.  Different
+    // chunks run concurrently and must only touch their own command list.
+    virtual void RecordItems(std::uint32_t chunkIndex, const RecordChunk& chunk, std::uint32_t executor) = 0;
+
+    // Called on the recording thread once every chunk is done.  The lists
+    // of chunks [0, chunkCount) go to the queue in this order, in one call.
+    virtual void SubmitChunks(std::uint32_t chunkCount) = 0;
+};
+
+// Splits an ordered draw list into chunks and records them in parallel.
+class ParallelRecorder
+{
+public:
+    static constexpr std::uint32_t DefaultMinItemsPerChunk = 256;
+
+    // pool may be null, everything is then recorded on the calling thread.
+    explicit ParallelRecorder(ThreadPool* pool, std::uint32_t minItemsPerChunk = DefaultMinItemsPerChunk);
+
+    // Cuts itemCount items into at most maxChunks equal contiguous chunks
+    // of at least minItemsPerChunk items, and at least one chunk so the
+    // frame always has a list to record into.  Returns the chunk count.
+    std::uint32_t Split(std::uint32_t itemCount, std::uint32_t maxChunks);
+
+    // Records the chunks of the last Split through backend, then submits.
+    void Record(CommandRecordBackend& backend);
+
+    const std::vector<RecordChunk>& Chunks()const { return mChunks; }
+
+    // Chunks one executor per core can keep busy.
+    std::uint32_t MaxUsefulChunks()const;
+
+private:
+    ThreadPool* mPool = nullptr;
+    std::uint32_t mMinItemsPerChunk = DefaultMinItemsPerChunk;
+    std::vector<RecordChunk> mChunks;
+};
@@ -0,0 +1,83 @@
+#include "PipelineCacheFile.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "Utility/StableHash.h"
+#include "Utility/TempFile.h"
+
+namespace
+{
+    struct Header
+    {
+        std::uint32_t Magic;
+        std::uint32_t Version;
+        std::uint64_t ContentKey;
+        std::uint64_t BlobSize;
+    };
+    static_assert(sizeof(Header) == 24);
+}
+
+bool PipelineCacheFile::Read(const std::string& path, std::uint64_t contentKey, std::vector<std::uint8_t>& blob)
+{
+    blob.clear();
+
+    std::ifstream fin(path, std::ios::binary);
+    if (!fin)
+        return false;
+
+    Header header = {};
+    fin.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!fin || header.Magic != Magic || header.Version != FormatVersion || header.ContentKey != contentKey)
+        return false;
+
+    // Checked against the file size first, so a damaged header cannot ask
+    // for an absurd allocation.
+    std::error_code ec;
+    const std::uintmax_t fileSize = std::filesystem::file_size(path, ec);
+    if (ec || fileSize != sizeof(Header) + header.BlobSize + sizeof(Hash128))
+        return false;
+
+    blob.resize((std::size_t)header.BlobSize);
+    Hash128 stored;
+    fin.read(reinterpret_cast<char*>(blob.data()), (std::streamsize)blob.size());
+    fin.read(reinterpret_cast<char*>(&stored), sizeof(stored));
+    if (!fin || !(HashBytes(blob.data(), blob.size()) == stored))
+    {
+        blob.clear();
+        return false;
+    }
+    return true;
+}
+
+bool PipelineCacheFile::Write(const std::string& path, std::uint64_t contentKey, const void* blob, std::size_t size)
+{
+    std::error_code ec;
+    const std::filesystem::path target(path);
+    if (target.has_parent_path())
+        std::filesystem::create_directories(target.parent_path(), ec);
+
+    const std::string temp = TempFile::UniquePath(path);
+    {
+        std::ofstream fout(temp, std::ios::binary | std::ios::trunc);
+        if (!fout)
+            return false;
+
+        const Header header = { Magic, FormatVersion, contentKey, size };
+        const Hash128 hash = HashBytes(blob, size);
+        fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        fout.write(static_cast<const char*>(blob), (std::streamsize)size);
+        fout.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+        if (!fout)
+            return false;
+    }
+
+    std::filesystem::rename(temp, target, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
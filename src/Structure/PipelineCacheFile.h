@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// File holding a serialized pipeline library.  Layout, little endian:
+//
+//   u32 magic 'PSOC' | u32 format version | u64 content key
+//   u64 blob size    | blob               | 128-bit hash of the blob
+//
+// The content key is whatever the owner wants to invalidate on, such as
+// the layout of what was hashed into the pipeline names; a file with a
+// different key, version or a bad hash is treated as missing.
+namespace PipelineCacheFile
+{
+    constexpr std::uint32_t Magic = 0x434f5350; // "PSOC"
+    constexpr std::uint32_t FormatVersion = 1;
+
+    // Returns false and leaves blob empty if the file is missing, stale
+    // or damaged.
+    bool Read(const std::string& path, std::uint64_t contentKey, std::vector<std::uint8_t>& blob);
+
+    // Writes through a temporary file, so a crash never leaves half a
+    // cache behind.  Returns false if the file could not be written.
+    bool Write(const std::string& path, std::uint64_t contentKey, const void* blob, std::size_t size);
+}
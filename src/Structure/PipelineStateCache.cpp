@@ -0,0 +1,236 @@
+#include "PipelineStateCache.h"
+
+#include <bit>
+#include <stdexcept>
+
+#include "PipelineCacheFile.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // Bump when HashDesc changes, so libraries named by the old hashes are
+    // dropped instead of never matching again.
+    constexpr std::uint64_t HashLayoutVersion = 1;
+
+    // D3D12 descriptions mix BOOL, enums and bytes, so every field goes in
+    // widened to 32 bits rather than as raw structs with padding.
+    template<typename T>
+    void AddField(StableHasher& h, T value)
+    {
+        static_assert(sizeof(T) <= sizeof(std::uint32_t));
+        h.Add((std::uint32_t)value);
+    }
+
+    void AddField(StableHasher& h, float value)
+    {
+        h.Add(std::bit_cast<std::uint32_t>(value));
+    }
+
+    void AddBytecode(StableHasher& h, const D3D12_SHADER_BYTECODE& shader)
+    {
+        const std::uint64_t size = shader.pShaderBytecode != nullptr ? shader.BytecodeLength : 0;
+        h.Add(size);
+        h.AddBytes(shader.pShaderBytecode, (std::size_t)size);
+    }
+
+    void AddStencilOp(StableHasher& h, const D3D12_DEPTH_STENCILOP_DESC& op)
+    {
+        AddField(h, op.StencilFailOp);
+        AddField(h, op.StencilDepthFailOp);
+        AddField(h, op.StencilPassOp);
+        AddField(h, op.StencilFunc);
+    }
+}
+
+void PipelineStateCache::Open(ID3D12Device* device, const std::string& path)
+{
+    mDevice = device;
+    mPath = path;
+    mLibrary.Reset();
+    mLibraryBlob.clear();
+    mPipelines.clear();
+    mDirty = false;
+    mStats = {};
+
+    ComPtr<ID3D12Device1> device1;
+    if (FAILED(device->QueryInterface(IID_PPV_ARGS(device1.GetAddressOf()))))
+        return;
+
+    if (PipelineCacheFile::Read(mPath, HashLayoutVersion, mLibraryBlob) &&
+        SUCCEEDED(device1->CreatePipelineLibrary(mLibraryBlob.data(), mLibraryBlob.size(),
+            IID_PPV_ARGS(mLibrary.GetAddressOf()))))
+    {
+        return;
+    }
+
+    mLibraryBlob.clear();
+    if (FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(mLibrary.GetAddressOf()))))
+        mLibrary.Reset();
+}
+
+void PipelineStateCache::Save()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mDirty || mLibrary == nullptr)
+        return;
+
+    std::vector<std::uint8_t> blob(mLibrary->GetSerializedSize());
+    if (FAILED(mLibrary->Serialize(blob.data(), blob.size())))
+        return;
+
+    if (PipelineCacheFile::Write(mPath, HashLayoutVersion, blob.data(), blob.size()))
+        mDirty = false;
+}
+
+void PipelineStateCache::RegisterRootSignature(ID3D12RootSignature* rootSignature, const void* serialized, std::size_t size)
+{
+    mRootSignatures[rootSignature] = HashBytes(serialized, size);
+}
+
+ID3D12PipelineState* PipelineStateCache::GetOrCreate(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    const Hash128 hash = HashDesc(desc);
+    const std::string hex = hash.ToHex();
+    const std::wstring name(hex.begin(), hex.end());
+
+    ComPtr<ID3D12PipelineState> pso;
+    {
+        // Loading the same pipeline from two threads is not safe, so
+        // library loads stay under the lock.
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mPipelines.find(hash);
+        if (it != mPipelines.end())
+        {
+            ++mStats.MemoryHits;
+            return it->second.Get();
+        }
+
+        if (mLibrary != nullptr &&
+            SUCCEEDED(mLibrary->LoadGraphicsPipeline(name.c_str(), &desc, IID_PPV_ARGS(pso.GetAddressOf()))))
+        {
+            ++mStats.LibraryHits;
+            return mPipelines.emplace(hash, pso).first->second.Get();
+        }
+    }
+
+    ThrowIfFailed(mDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(pso.GetAddressOf())));
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mStats.Created;
+
+    // Another thread may have created the same pipeline meanwhile; the
+    // first one in is kept.
+    auto inserted = mPipelines.emplace(hash, pso);
+    if (!inserted.second)
+        return inserted.first->second.Get();
+
+    // Fails only if the name is taken, which means a library entry the
+    // driver would not load back; the PSO is still good to use.
+    if (mLibrary != nullptr && SUCCEEDED(mLibrary->StorePipeline(name.c_str(), pso.Get())))
+        mDirty = true;
+    return pso.Get();
+}
+
+Hash128 PipelineStateCache::HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)const
+{
+    StableHasher h(HashLayoutVersion);
+
+    auto rootSignature = mRootSignatures.find(desc.pRootSignature);
+    if (rootSignature == mRootSignatures.end())
+    {
+        throw std::invalid_argument("PipelineStateCache: root signature was not registered.");
+    }
+    h.Add(rootSignature->second.Lo);
+    h.Add(rootSignature->second.Hi);
+
+    AddBytecode(h, desc.VS);
+    AddBytecode(h, desc.PS);
+    AddBytecode(h, desc.DS);
+    AddBytecode(h, desc.HS);
+    AddBytecode(h, desc.GS);
+
+    const D3D12_STREAM_OUTPUT_DESC& so = desc.StreamOutput;
+    AddField(h, so.NumEntries);
+    for (UINT i = 0; i < so.NumEntries; ++i)
+    {
+        const D3D12_SO_DECLARATION_ENTRY& e = so.pSODeclaration[i];
+        AddField(h, e.Stream);
+        h.AddString(e.SemanticName);
+        AddField(h, e.SemanticIndex);
+        AddField(h, e.StartComponent);
+        AddField(h, e.ComponentCount);
+        AddField(h, e.OutputSlot);
+    }
+    AddField(h, so.NumStrides);
+    for (UINT i = 0; i < so.NumStrides; ++i)
+        AddField(h, so.pBufferStrides[i]);
+    AddField(h, so.RasterizedStream);
+
+    const D3D12_BLEND_DESC& blend = desc.BlendState;
+    AddField(h, blend.AlphaToCoverageEnable);
+    AddField(h, blend.IndependentBlendEnable);
+    for (const D3D12_RENDER_TARGET_BLEND_DESC& rt : blend.RenderTarget)
+    {
+        AddField(h, rt.BlendEnable);
+        AddField(h, rt.LogicOpEnable);
+        AddField(h, rt.SrcBlend);
+        AddField(h, rt.DestBlend);
+        AddField(h, rt.BlendOp);
+        AddField(h, rt.SrcBlendAlpha);
+        AddField(h, rt.DestBlendAlpha);
+        AddField(h, rt.BlendOpAlpha);
+        AddField(h, rt.LogicOp);
+        AddField(h, rt.RenderTargetWriteMask);
+    }
+    AddField(h, desc.SampleMask);
+
+    const D3D12_RASTERIZER_DESC& raster = desc.RasterizerState;
+    AddField(h, raster.FillMode);
+    AddField(h, raster.CullMode);
+    AddField(h, raster.FrontCounterClockwise);
+    AddField(h, raster.DepthBias);
+    AddField(h, raster.DepthBiasClamp);
+    AddField(h, raster.SlopeScaledDepthBias);
+    AddField(h, raster.DepthClipEnable);
+    AddField(h, raster.MultisampleEnable);
+    AddField(h, raster.AntialiasedLineEnable);
+    AddField(h, raster.ForcedSampleCount);
+    AddField(h, raster.ConservativeRaster);
+
+    const D3D12_DEPTH_STENCIL_DESC& depth = desc.DepthStencilState;
+    AddField(h, depth.DepthEnable);
+    AddField(h, depth.DepthWriteMask);
+    AddField(h, depth.DepthFunc);
+    AddField(h, depth.StencilEnable);
+    AddField(h, depth.StencilReadMask);
+    AddField(h, depth.StencilWriteMask);
+    AddStencilOp(h, depth.FrontFace);
+    AddStencilOp(h, depth.BackFace);
+
+    AddField(h, desc.InputLayout.NumElements);
+    for (UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& e = desc.InputLayout.pInputElementDescs[i];
+        h.AddString(e.SemanticName);
+        AddField(h, e.SemanticIndex);
+        AddField(h, e.Format);
+        AddField(h, e.InputSlot);
+        AddField(h, e.AlignedByteOffset);
+        AddField(h, e.InputSlotClass);
+        AddField(h, e.InstanceDataStepRate);
+    }
+
+    AddField(h, desc.IBStripCutValue);
+    AddField(h, desc.PrimitiveTopologyType);
+    AddField(h, desc.NumRenderTargets);
+    for (DXGI_FORMAT format : desc.RTVFormats)
+        AddField(h, format);
+    AddField(h, desc.DSVFormat);
+    AddField(h, desc.SampleDesc.Count);
+    AddField(h, desc.SampleDesc.Quality);
+    AddField(h, desc.NodeMask);
+    AddField(h, desc.Flags);
+
+    return h.Finish();
+}
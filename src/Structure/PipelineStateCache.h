@@ -0,0 +1,66 @@
+#pragma once
+
+#include <mutex>
+
+#include "d3dUtil.h"
+#include "Utility/StableHash.h"
+
+// Graphics pipeline states keyed by a stable hash of their description.
+// Lookups go to the in-memory map first, then to an ID3D12PipelineLibrary
+// loaded from disk, and only then create the PSO and store it in the
+// library.  Save writes the library back if anything new was stored, so
+// the next launch skips shader compilation in the driver.
+//
+// Root signatures are hashed by their serialized blob, so every root
+// signature a description uses has to be registered first.  After that,
+// GetOrCreate may be called from several threads at once.
+class PipelineStateCache
+{
+public:
+    struct Stats
+    {
+        std::uint32_t MemoryHits = 0;
+        std::uint32_t LibraryHits = 0;
+        std::uint32_t Created = 0;
+    };
+
+    // Loads the library at path.  A missing, stale or rejected file (the
+    // driver refuses libraries from another driver version) starts an
+    // empty one; without ID3D12Device1 only the in-memory map is used.
+    void Open(ID3D12Device* device, const std::string& path);
+
+    // Writes the library if pipelines were added since it was loaded.
+    void Save();
+
+    void RegisterRootSignature(ID3D12RootSignature* rootSignature, const void* serialized, std::size_t size);
+
+    ID3D12PipelineState* GetOrCreate(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+    // Every field that affects the pipeline, pointers followed to what they
+    // point at.  CachedPSO is ignored.
+    Hash128 HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)const;
+
+    Stats GetStats()const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+    Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> mLibrary;
+
+    // The library reads from this blob for as long as it lives.
+    std::vector<std::uint8_t> mLibraryBlob;
+
+    std::unordered_map<Hash128, Microsoft::WRL::ComPtr<ID3D12PipelineState>, Hash128Hasher> mPipelines;
+    std::unordered_map<ID3D12RootSignature*, Hash128> mRootSignatures;
+
+    // Guards the map, the library and the stats; creating the pipeline
+    // itself happens outside it.
+    mutable std::mutex mMutex;
+
+    std::string mPath;
+    bool mDirty = false;
+    Stats mStats;
+};
@@ -0,0 +1,446 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool MemoryOverlaps(std::uint64_t aOffset, std::uint64_t aSize, std::uint64_t bOffset, std::uint64_t bSize)
+    {
+        return aOffset < bOffset + bSize && bOffset < aOffset + aSize;
+    }
+}
+
+void RenderGraph::Reset()
+{
+    mResources.clear();
+    mVersions.clear();
+    mPasses.clear();
+    mFinalBarriers.clear();
+    mPlacements.clear();
+    mHandedOver.clear();
+    mHeapSize = 0;
+    mHeapAlignment = 64 * 1024;
+}
+
+RenderGraphResource RenderGraph::CreateTexture(const std::string& name, const RenderGraphTextureDesc& desc)
+{
+    if (desc.SizeInBytes == 0 || desc.Alignment == 0)
+    {
+        throw std::invalid_argument("RenderGraph texture " + name + " has no size.");
+    }
+
+    Resource resource;
+    resource.Name = name;
+    resource.Desc = desc;
+    resource.LastVersion = (RenderGraphResource)mVersions.size();
+    mResources.push_back(resource);
+
+    mVersions.push_back({ (std::uint32_t)mResources.size() - 1, RenderGraphInvalid, 0 });
+    return mResources.back().LastVersion;
+}
+
+RenderGraphResource RenderGraph::Import(const std::string& name, ResourceState initialState, ResourceState finalState)
+{
+    Resource resource;
+    resource.Name = name;
+    resource.Imported = true;
+    resource.InitialState = initialState;
+    resource.FinalState = finalState;
+    resource.LastVersion = (RenderGraphResource)mVersions.size();
+    mResources.push_back(resource);
+
+    mVersions.push_back({ (std::uint32_t)mResources.size() - 1, RenderGraphInvalid, 0 });
+    return mResources.back().LastVersion;
+}
+
+RenderGraphPass RenderGraph::AddPass(const std::string& name, ExecuteFn execute)
+{
+    Pass pass;
+    pass.Name = name;
+    pass.Execute = std::move(execute);
+    mPasses.push_back(std::move(pass));
+    return (RenderGraphPass)mPasses.size() - 1;
+}
+
+void RenderGraph::SetSideEffect(RenderGraphPass pass)
+{
+    mPasses.at(pass).SideEffect = true;
+}
+
+void RenderGraph::Read(RenderGraphPass pass, RenderGraphResource resource, ResourceState state)
+{
+    if (resource >= mVersions.size())
+    {
+        throw std::out_of_range("RenderGraph::Read of an unknown resource.");
+    }
+
+    Pass& p = mPasses.at(pass);
+    p.Accesses.push_back({ resource, state, false });
+    p.Inputs.push_back(resource);
+}
+
+RenderGraphResource RenderGraph::Write(RenderGraphPass pass, RenderGraphResource resource, ResourceState state)
+{
+    if (resource >= mVersions.size())
+    {
+        throw std::out_of_range("RenderGraph::Write of an unknown resource.");
+    }
+
+    Resource& r = mResources[mVersions[resource].Resource];
+    if (r.LastVersion != resource)
+    {
+        throw std::logic_error("RenderGraph::Write of " + r.Name + " must use its latest version.");
+    }
+
+    Pass& p = mPasses.at(pass);
+    RenderGraphResource version = (RenderGraphResource)mVersions.size();
+    mVersions.push_back({ mVersions[resource].Resource, pass, 0 });
+    r.LastVersion = version;
+
+    p.Accesses.push_back({ version, state, true });
+    p.Inputs.push_back(resource);
+    return version;
+}
+
+void RenderGraph::Compile()
+{
+    CullPasses();
+    PlaceTransients();
+    BuildBarriers();
+}
+
+void RenderGraph::Execute()const
+{
+    for (const Pass& pass : mPasses)
+    {
+        if (!pass.Culled && pass.Execute)
+            pass.Execute(pass.Barriers.data(), (std::uint32_t)pass.Barriers.size());
+    }
+}
+
+void RenderGraph::CullPasses()
+{
+    for (Version& v : mVersions)
+        v.ReadCount = 0;
+
+    for (Pass& pass : mPasses)
+    {
+        pass.Culled = false;
+        pass.RefCount = 0;
+        for (const Access& access : pass.Accesses)
+            pass.RefCount += access.Write ? 1 : 0;
+        for (RenderGraphResource input : pass.Inputs)
+            ++mVersions[input].ReadCount;
+    }
+
+    // The outside world reads the final contents of imported resources.
+    for (const Resource& r : mResources)
+    {
+        if (r.Imported)
+            ++mVersions[r.LastVersion].ReadCount;
+    }
+
+    std::vector<RenderGraphResource> unread;
+    auto cull = [&](Pass& pass)
+    {
+        pass.Culled = true;
+        for (RenderGraphResource input : pass.Inputs)
+        {
+            if (--mVersions[input].ReadCount == 0 && mVersions[input].Producer != RenderGraphInvalid)
+                unread.push_back(input);
+        }
+    };
+
+    for (Pass& pass : mPasses)
+    {
+        if (pass.RefCount == 0 && !pass.SideEffect)
+            cull(pass);
+    }
+    for (RenderGraphResource v = 0; v < (RenderGraphResource)mVersions.size(); ++v)
+    {
+        if (mVersions[v].ReadCount == 0 && mVersions[v].Producer != RenderGraphInvalid)
+            unread.push_back(v);
+    }
+
+    while (!unread.empty())
+    {
+        RenderGraphResource v = unread.back();
+        unread.pop_back();
+
+        Pass& producer = mPasses[mVersions[v].Producer];
+        if (producer.Culled)
+            continue;
+        if (--producer.RefCount == 0 && !producer.SideEffect)
+            cull(producer);
+    }
+}
+
+void RenderGraph::PlaceTransients()
+{
+    mPlacements.clear();
+    mHeapSize = 0;
+    mHeapAlignment = 64 * 1024;
+
+    std::vector<RenderGraphPlacement> lifetimes(mResources.size());
+    for (RenderGraphPass p = 0; p < (RenderGraphPass)mPasses.size(); ++p)
+    {
+        if (mPasses[p].Culled)
+            continue;
+
+        for (const Access& access : mPasses[p].Accesses)
+        {
+            std::uint32_t r = mVersions[access.Version].Resource;
+            if (mResources[r].Imported)
+                continue;
+
+            RenderGraphPlacement& life = lifetimes[r];
+            life.Resource = r;
+            if (life.FirstPass == RenderGraphInvalid)
+                life.FirstPass = p;
+            life.LastPass = p;
+        }
+    }
+
+    for (const RenderGraphPlacement& life : lifetimes)
+    {
+        if (life.Resource != RenderGraphInvalid)
+            mPlacements.push_back(life);
+    }
+
+    // Biggest first packs better; ties go by first use so the result does
+    // not depend on sort stability.
+    std::vector<std::uint32_t> order(mPlacements.size());
+    for (std::uint32_t i = 0; i < (std::uint32_t)order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b)
+    {
+        const std::uint64_t sizeA = mResources[mPlacements[a].Resource].Desc.SizeInBytes;
+        const std::uint64_t sizeB = mResources[mPlacements[b].Resource].Desc.SizeInBytes;
+        if (sizeA != sizeB)
+            return sizeA > sizeB;
+        return mPlacements[a].FirstPass < mPlacements[b].FirstPass;
+    });
+
+    std::vector<std::uint32_t> placed;
+    std::vector<std::uint64_t> candidates;
+    for (std::uint32_t i : order)
+    {
+        RenderGraphPlacement& p = mPlacements[i];
+        const RenderGraphTextureDesc& desc = mResources[p.Resource].Desc;
+        mHeapAlignment = std::max(mHeapAlignment, desc.Alignment);
+
+        // Only resources alive at the same time constrain the offset, and
+        // the lowest free offset is either 0 or the end of one of them.
+        candidates.assign(1, 0);
+        for (std::uint32_t j : placed)
+        {
+            const RenderGraphPlacement& q = mPlacements[j];
+            if (q.FirstPass <= p.LastPass && p.FirstPass <= q.LastPass)
+                candidates.push_back(q.Offset + mResources[q.Resource].Desc.SizeInBytes);
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        for (std::uint64_t candidate : candidates)
+        {
+            const std::uint64_t offset = AlignUp(candidate, desc.Alignment);
+            bool fits = true;
+            for (std::uint32_t j : placed)
+            {
+                const RenderGraphPlacement& q = mPlacements[j];
+                if (q.FirstPass <= p.LastPass && p.FirstPass <= q.LastPass &&
+                    MemoryOverlaps(offset, desc.SizeInBytes, q.Offset, mResources[q.Resource].Desc.SizeInBytes))
+                {
+                    fits = false;
+                    break;
+                }
+            }
+
+            if (fits)
+            {
+                p.Offset = offset;
+                break;
+            }
+        }
+
+        mHeapSize = std::max(mHeapSize, p.Offset + desc.SizeInBytes);
+        placed.push_back(i);
+    }
+
+    mHeapSize = AlignUp(mHeapSize, mHeapAlignment);
+}
+
+void RenderGraph::BuildBarriers()
+{
+    struct Use
+    {
+        RenderGraphPass Pass;
+        ResourceState State;
+        ResourceState Target;
+    };
+
+    // Uses of every resource by live passes, one per pass with the states
+    // of all its accesses combined.
+    std::vector<std::vector<Use>> uses(mResources.size());
+    mHandedOver.assign(mResources.size(), false);
+    for (RenderGraphPass p = 0; p < (RenderGraphPass)mPasses.size(); ++p)
+    {
+        mPasses[p].Barriers.clear();
+        mPasses[p].Discards.clear();
+        if (mPasses[p].Culled)
+            continue;
+
+        for (const Access& access : mPasses[p].Accesses)
+        {
+            auto& list = uses[mVersions[access.Version].Resource];
+            if (!list.empty() && list.back().Pass == p)
+                list.back().State = list.back().State | access.State;
+            else
+                list.push_back({ p, access.State, access.State });
+        }
+    }
+
+    // A run of read-only uses transitions once, to every state the run
+    // needs, instead of once per pass.
+    for (auto& list : uses)
+    {
+        for (std::size_t i = list.size(); i-- > 1;)
+        {
+            if (IsReadOnlyState(list[i - 1].State) && IsReadOnlyState(list[i].Target))
+                list[i - 1].Target = list[i - 1].State | list[i].Target;
+        }
+    }
+
+    std::vector<ResourceState> current(mResources.size());
+    for (std::uint32_t r = 0; r < (std::uint32_t)mResources.size(); ++r)
+        current[r] = mResources[r].Imported ? mResources[r].InitialState : ResourceState::Common;
+
+    for (RenderGraphPlacement& p : mPlacements)
+    {
+        p.InitialState = uses[p.Resource].front().Target;
+        current[p.Resource] = p.InitialState;
+    }
+
+    // A transient whose memory goes to a later resource is inactive by the
+    // end of the frame and cannot take a final barrier, so it goes back to
+    // InitialState in the batch that hands its memory over, ahead of the
+    // aliasing barrier.
+    for (const RenderGraphPlacement& p : mPlacements)
+    {
+        RenderGraphPass handOver = RenderGraphInvalid;
+        for (const RenderGraphPlacement& q : mPlacements)
+        {
+            if (q.FirstPass > p.LastPass && q.FirstPass < handOver && MemoryOverlaps(p.Offset,
+                mResources[p.Resource].Desc.SizeInBytes, q.Offset, mResources[q.Resource].Desc.SizeInBytes))
+                handOver = q.FirstPass;
+        }
+        if (handOver == RenderGraphInvalid)
+            continue;
+
+        ResourceState last = p.InitialState;
+        for (const Use& use : uses[p.Resource])
+        {
+            if (!StateCovers(last, use.State))
+                last = use.Target;
+        }
+        if (last != p.InitialState)
+        {
+            RenderGraphBarrier barrier;
+            barrier.Resource = p.Resource;
+            barrier.Before = last;
+            barrier.After = p.InitialState;
+            mPasses[handOver].Barriers.push_back(barrier);
+        }
+        mHandedOver[p.Resource] = true;
+    }
+
+    for (const RenderGraphPlacement& p : mPlacements)
+    {
+        // Memory shared with another transient changes hands at first use
+        // every frame, even when the other user comes later in the frame.
+        std::uint32_t sharers = 0;
+        const RenderGraphPlacement* previous = nullptr;
+        for (const RenderGraphPlacement& q : mPlacements)
+        {
+            if (&q == &p || !MemoryOverlaps(p.Offset, mResources[p.Resource].Desc.SizeInBytes,
+                q.Offset, mResources[q.Resource].Desc.SizeInBytes))
+                continue;
+
+            ++sharers;
+            previous = &q;
+        }
+
+        if (sharers > 0)
+        {
+            RenderGraphBarrier barrier;
+            barrier.Kind = RenderGraphBarrier::Type::Aliasing;
+            barrier.Resource = p.Resource;
+            barrier.AliasBefore = sharers == 1 ? previous->Resource : RenderGraphInvalid;
+            mPasses[p.FirstPass].Barriers.push_back(barrier);
+            mPasses[p.FirstPass].Discards.push_back(p.Resource);
+        }
+    }
+
+    // Hand-overs and aliasing barriers went in first; transitions follow,
+    // pass by pass.
+    std::vector<std::size_t> next(mResources.size(), 0);
+    for (RenderGraphPass p = 0; p < (RenderGraphPass)mPasses.size(); ++p)
+    {
+        if (mPasses[p].Culled)
+            continue;
+
+        for (std::uint32_t r = 0; r < (std::uint32_t)mResources.size(); ++r)
+        {
+            auto& list = uses[r];
+            if (next[r] >= list.size() || list[next[r]].Pass != p)
+                continue;
+
+            const Use& use = list[next[r]++];
+            if (StateCovers(current[r], use.State))
+            {
+                // Back to back unordered access writes still need to be ordered.
+                if (use.State == ResourceState::UnorderedAccess && current[r] == ResourceState::UnorderedAccess && next[r] > 1)
+                {
+                    RenderGraphBarrier barrier;
+                    barrier.Kind = RenderGraphBarrier::Type::UnorderedAccess;
+                    barrier.Resource = r;
+                    mPasses[p].Barriers.push_back(barrier);
+                }
+                continue;
+            }
+
+            RenderGraphBarrier barrier;
+            barrier.Resource = r;
+            barrier.Before = current[r];
+            barrier.After = use.Target;
+            mPasses[p].Barriers.push_back(barrier);
+            current[r] = use.Target;
+        }
+    }
+
+    mFinalBarriers.clear();
+    for (std::uint32_t r = 0; r < (std::uint32_t)mResources.size(); ++r)
+    {
+        ResourceState wanted = mResources[r].FinalState;
+        if (!mResources[r].Imported)
+        {
+            if (uses[r].empty() || mHandedOver[r])
+                continue;
+            wanted = uses[r].front().Target;
+        }
+
+        if (current[r] != wanted)
+        {
+            RenderGraphBarrier barrier;
+            barrier.Resource = r;
+            barrier.Before = current[r];
+            barrier.After = wanted;
+            mFinalBarriers.push_back(barrier);
+        }
+    }
+}
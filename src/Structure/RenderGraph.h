@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ResourceState.h"
+
+using RenderGraphResource = std::uint32_t;
+using RenderGraphPass = std::uint32_t;
+constexpr std::uint32_t RenderGraphInvalid = ~0u;
+
+enum RenderGraphTextureFlags : std::uint32_t
+{
+    RenderGraphTextureNone = 0,
+    RenderGraphTextureRenderTarget = 0x1,
+    RenderGraphTextureDepthStencil = 0x2,
+    RenderGraphTextureUnorderedAccess = 0x4
+};
+
+// A texture the graph owns for one frame.  SizeInBytes and Alignment are
+// what the device reports for it (GetResourceAllocationInfo on D3D12) and
+// are all the compiler needs to place it; the rest is passed through to
+// whoever creates the resource.
+struct RenderGraphTextureDesc
+{
+    std::uint32_t Width = 0;
+    std::uint32_t Height = 0;
+    std::uint32_t Format = 0;
+    std::uint32_t SampleCount = 1;
+    std::uint32_t Flags = RenderGraphTextureNone;
+
+    float ClearColor[4] = {};
+    float ClearDepth = 1.0f;
+    std::uint8_t ClearStencil = 0;
+
+    std::uint64_t SizeInBytes = 0;
+    std::uint64_t Alignment = 64 * 1024;
+
+    bool operator==(const RenderGraphTextureDesc& rhs)const = default;
+};
+
+struct RenderGraphBarrier
+{
+    enum class Type : std::uint8_t
+    {
+        Transition,
+        // Resource starts using heap memory last used by AliasBefore, or by
+        // any resource if AliasBefore is RenderGraphInvalid.
+        Aliasing,
+        UnorderedAccess
+    };
+
+    Type Kind = Type::Transition;
+    std::uint32_t Resource = RenderGraphInvalid;
+    std::uint32_t AliasBefore = RenderGraphInvalid;
+    ResourceState Before = ResourceState::Common;
+    ResourceState After = ResourceState::Common;
+
+    bool operator==(const RenderGraphBarrier& rhs)const = default;
+};
+
+// Where the compiler put a transient texture.  The texture is created in
+// InitialState, the state of its first use, and is brought back there every
+// frame so the next one finds it the same way: by the final barriers, or,
+// when a later resource takes over its memory, by a barrier just before
+// that hand-over.
+struct RenderGraphPlacement
+{
+    std::uint32_t Resource = RenderGraphInvalid;
+    std::uint64_t Offset = 0;
+    ResourceState InitialState = ResourceState::Common;
+
+    // First and last live pass using it, inclusive.
+    std::uint32_t FirstPass = RenderGraphInvalid;
+    std::uint32_t LastPass = RenderGraphInvalid;
+};
+
+// A frame graph.  Passes are added in submission order and declare the
+// resources they read and write; Compile drops passes whose results nobody
+// consumes, works out the barriers each pass needs as one batch, and packs
+// transient textures with disjoint lifetimes into shared heap memory.
+//
+// Handles returned for resources are versions: every Write returns a new
+// handle and later readers should use it.  A write also depends on the
+// version it replaces, so a pass drawing over a cleared target keeps the
+// clear alive.  Imported resources are always consumed by the outside
+// world, so the last pass writing one is never culled.
+//
+// Nothing here touches a graphics API; barriers and placements refer to
+// resources by index and the owner turns them into real calls.
+class RenderGraph
+{
+public:
+    // Receives the barriers to record before the pass's work.
+    using ExecuteFn = std::function<void(const RenderGraphBarrier* barriers, std::uint32_t count)>;
+
+    void Reset();
+
+    RenderGraphResource CreateTexture(const std::string& name, const RenderGraphTextureDesc& desc);
+    RenderGraphResource Import(const std::string& name, ResourceState initialState, ResourceState finalState);
+
+    RenderGraphPass AddPass(const std::string& name, ExecuteFn execute = {});
+    // Keeps pass even when nothing reads what it writes.
+    void SetSideEffect(RenderGraphPass pass);
+
+    void Read(RenderGraphPass pass, RenderGraphResource resource, ResourceState state);
+    RenderGraphResource Write(RenderGraphPass pass, RenderGraphResource resource, ResourceState state);
+
+    void Compile();
+
+    // Runs the live passes in order.  The final barriers are left to the
+    // caller, they usually go at the end of the last command list.
+    void Execute()const;
+
+    std::uint32_t PassCount()const { return (std::uint32_t)mPasses.size(); }
+    std::uint32_t ResourceCount()const { return (std::uint32_t)mResources.size(); }
+    const std::string& PassName(RenderGraphPass pass)const { return mPasses[pass].Name; }
+    const std::string& ResourceName(std::uint32_t resource)const { return mResources[resource].Name; }
+    bool IsCulled(RenderGraphPass pass)const { return mPasses[pass].Culled; }
+    bool IsImported(std::uint32_t resource)const { return mResources[resource].Imported; }
+    const RenderGraphTextureDesc& TextureDesc(std::uint32_t resource)const { return mResources[resource].Desc; }
+
+    // Physical resource index of a handle.
+    std::uint32_t ResourceOf(RenderGraphResource handle)const { return mVersions[handle].Resource; }
+
+    const std::vector<RenderGraphBarrier>& Barriers(RenderGraphPass pass)const { return mPasses[pass].Barriers; }
+    const std::vector<RenderGraphBarrier>& FinalBarriers()const { return mFinalBarriers; }
+
+    // Transients pass takes over from heap memory another resource used.
+    // Their contents are garbage, so the pass has to clear, discard or
+    // completely overwrite them before anything reads them.
+    const std::vector<std::uint32_t>& Discards(RenderGraphPass pass)const { return mPasses[pass].Discards; }
+    bool NeedsDiscard(RenderGraphPass pass, std::uint32_t resource)const
+    {
+        const std::vector<std::uint32_t>& discards = mPasses[pass].Discards;
+        return std::find(discards.begin(), discards.end(), resource) != discards.end();
+    }
+
+    // Transient textures used by live passes; culled ones are left out.
+    const std::vector<RenderGraphPlacement>& Placements()const { return mPlacements; }
+    std::uint64_t HeapSize()const { return mHeapSize; }
+    std::uint64_t HeapAlignment()const { return mHeapAlignment; }
+
+private:
+    struct Resource
+    {
+        std::string Name;
+        bool Imported = false;
+        RenderGraphTextureDesc Desc;
+        ResourceState InitialState = ResourceState::Common;
+        ResourceState FinalState = ResourceState::Common;
+        RenderGraphResource LastVersion = RenderGraphInvalid;
+    };
+
+    struct Version
+    {
+        std::uint32_t Resource = RenderGraphInvalid;
+        RenderGraphPass Producer = RenderGraphInvalid;
+        std::uint32_t ReadCount = 0;
+    };
+
+    struct Access
+    {
+        RenderGraphResource Version = RenderGraphInvalid;
+        ResourceState State = ResourceState::Common;
+        bool Write = false;
+    };
+
+    struct Pass
+    {
+        std::string Name;
+        ExecuteFn Execute;
+        bool SideEffect = false;
+        bool Culled = false;
+        std::uint32_t RefCount = 0;
+        std::vector<Access> Accesses;
+        // Versions this pass depends on: reads plus the versions its writes replace.
+        std::vector<RenderGraphResource> Inputs;
+        std::vector<RenderGraphBarrier> Barriers;
+        std::vector<std::uint32_t> Discards;
+    };
+
+    void CullPasses();
+    void PlaceTransients();
+    void BuildBarriers();
+
+    std::vector<Resource> mResources;
+    std::vector<Version> mVersions;
+    std::vector<Pass> mPasses;
+
+    std::vector<RenderGraphBarrier> mFinalBarriers;
+    // Per resource: its memory goes to a later transient within the frame.
+    std::vector<bool> mHandedOver;
+    std::vector<RenderGraphPlacement> mPlacements;
+    std::uint64_t mHeapSize = 0;
+    std::uint64_t mHeapAlignment = 64 * 1024;
+};
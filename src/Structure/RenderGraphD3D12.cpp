@@ -0,0 +1,182 @@
+#include "RenderGraphD3D12.h"
+
+using Microsoft::WRL::ComPtr;
+
+static_assert((UINT)ResourceState::RenderTarget == D3D12_RESOURCE_STATE_RENDER_TARGET);
+static_assert((UINT)ResourceState::DepthWrite == D3D12_RESOURCE_STATE_DEPTH_WRITE);
+static_assert((UINT)ResourceState::PixelShaderResource == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+static_assert((UINT)ResourceState::ResolveSource == D3D12_RESOURCE_STATE_RESOLVE_SOURCE);
+static_assert((UINT)ResourceState::ResolveDest == D3D12_RESOURCE_STATE_RESOLVE_DEST);
+static_assert((UINT)ResourceState::Present == D3D12_RESOURCE_STATE_PRESENT);
+
+void RenderGraphD3D12::SetDevice(ID3D12Device* device)
+{
+    mDevice = device;
+    mHeap.Reset();
+    mHeapSize = 0;
+    mLayout.clear();
+    mTransients.clear();
+    mEntries.clear();
+}
+
+void RenderGraphD3D12::Describe(RenderGraphTextureDesc& desc)const
+{
+    D3D12_RESOURCE_DESC resourceDesc = ResourceDesc(desc);
+    D3D12_RESOURCE_ALLOCATION_INFO info = mDevice->GetResourceAllocationInfo(0, 1, &resourceDesc);
+    desc.SizeInBytes = info.SizeInBytes;
+    desc.Alignment = info.Alignment;
+}
+
+void RenderGraphD3D12::BindImport(std::uint32_t resource, ID3D12Resource* d3dResource,
+    D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv)
+{
+    if (mEntries.size() <= resource)
+        mEntries.resize(resource + 1);
+    mEntries[resource] = { d3dResource, rtv, dsv };
+}
+
+bool RenderGraphD3D12::NeedsRealize(const RenderGraph& graph)const
+{
+    return graph.HeapSize() > mHeapSize || LayoutOf(graph) != mLayout;
+}
+
+void RenderGraphD3D12::Realize(const RenderGraph& graph)
+{
+    if (mEntries.size() < graph.ResourceCount())
+        mEntries.resize(graph.ResourceCount());
+
+    std::vector<Layout> layout = LayoutOf(graph);
+    if (graph.HeapSize() <= mHeapSize && layout == mLayout)
+        return;
+
+    mTransients.clear();
+
+    // The heap only grows, so toggling MSAA back on does not reallocate.
+    if (graph.HeapSize() > mHeapSize)
+    {
+        mHeap.Reset();
+        D3D12_HEAP_DESC heapDesc = {};
+        heapDesc.SizeInBytes = graph.HeapSize();
+        heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+        heapDesc.Alignment = graph.HeapAlignment();
+        heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+        ThrowIfFailed(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(mHeap.GetAddressOf())));
+        mHeapSize = graph.HeapSize();
+    }
+
+    D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
+    rtvHeapDesc.NumDescriptors = std::max<UINT>(1, (UINT)layout.size());
+    rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+    ThrowIfFailed(mDevice->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(mRtvHeap.ReleaseAndGetAddressOf())));
+
+    D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = rtvHeapDesc;
+    dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+    ThrowIfFailed(mDevice->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(mDsvHeap.ReleaseAndGetAddressOf())));
+
+    const UINT rtvSize = mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+    const UINT dsvSize = mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+
+    for (UINT i = 0; i < (UINT)layout.size(); ++i)
+    {
+        const Layout& l = layout[i];
+        const RenderGraphTextureDesc& desc = l.Desc;
+        if ((desc.Flags & (RenderGraphTextureRenderTarget | RenderGraphTextureDepthStencil)) == 0)
+        {
+            throw std::invalid_argument("RenderGraph transient " + graph.ResourceName(l.Resource) +
+                " is not a render target or depth stencil.");
+        }
+        D3D12_RESOURCE_DESC resourceDesc = ResourceDesc(desc);
+
+        D3D12_CLEAR_VALUE clearValue = {};
+        clearValue.Format = (DXGI_FORMAT)desc.Format;
+        if (desc.Flags & RenderGraphTextureDepthStencil)
+        {
+            clearValue.DepthStencil.Depth = desc.ClearDepth;
+            clearValue.DepthStencil.Stencil = desc.ClearStencil;
+        }
+        else
+        {
+            memcpy(clearValue.Color, desc.ClearColor, sizeof(clearValue.Color));
+        }
+
+        ComPtr<ID3D12Resource> resource;
+        ThrowIfFailed(mDevice->CreatePlacedResource(mHeap.Get(), l.Offset, &resourceDesc,
+            (D3D12_RESOURCE_STATES)l.InitialState, &clearValue, IID_PPV_ARGS(resource.GetAddressOf())));
+
+        Entry& entry = mEntries[l.Resource];
+        entry = {};
+        entry.Resource = resource.Get();
+
+        if (desc.Flags & RenderGraphTextureRenderTarget)
+        {
+            D3D12_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+            rtvDesc.Format = (DXGI_FORMAT)desc.Format;
+            rtvDesc.ViewDimension = desc.SampleCount > 1 ? D3D12_RTV_DIMENSION_TEXTURE2DMS : D3D12_RTV_DIMENSION_TEXTURE2D;
+            entry.Rtv = CD3DX12_CPU_DESCRIPTOR_HANDLE(mRtvHeap->GetCPUDescriptorHandleForHeapStart(), i, rtvSize);
+            mDevice->CreateRenderTargetView(resource.Get(), &rtvDesc, entry.Rtv);
+        }
+        if (desc.Flags & RenderGraphTextureDepthStencil)
+        {
+            D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+            dsvDesc.Format = (DXGI_FORMAT)desc.Format;
+            dsvDesc.ViewDimension = desc.SampleCount > 1 ? D3D12_DSV_DIMENSION_TEXTURE2DMS : D3D12_DSV_DIMENSION_TEXTURE2D;
+            entry.Dsv = CD3DX12_CPU_DESCRIPTOR_HANDLE(mDsvHeap->GetCPUDescriptorHandleForHeapStart(), i, dsvSize);
+            mDevice->CreateDepthStencilView(resource.Get(), &dsvDesc, entry.Dsv);
+        }
+
+        mTransients.push_back(resource);
+    }
+
+    mLayout = std::move(layout);
+}
+
+void RenderGraphD3D12::Barriers(ID3D12GraphicsCommandList* cmdList, const RenderGraphBarrier* barriers, std::uint32_t count)
+{
+    if (count == 0)
+        return;
+
+    mBarrierScratch.clear();
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        const RenderGraphBarrier& b = barriers[i];
+        ID3D12Resource* resource = mEntries[b.Resource].Resource;
+
+        switch (b.Kind)
+        {
+        case RenderGraphBarrier::Type::Aliasing:
+            mBarrierScratch.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(
+                b.AliasBefore == RenderGraphInvalid ? nullptr : mEntries[b.AliasBefore].Resource, resource));
+            break;
+        case RenderGraphBarrier::Type::UnorderedAccess:
+            mBarrierScratch.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+            break;
+        default:
+            mBarrierScratch.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource,
+                (D3D12_RESOURCE_STATES)b.Before, (D3D12_RESOURCE_STATES)b.After));
+            break;
+        }
+    }
+
+    cmdList->ResourceBarrier((UINT)mBarrierScratch.size(), mBarrierScratch.data());
+}
+
+D3D12_RESOURCE_DESC RenderGraphD3D12::ResourceDesc(const RenderGraphTextureDesc& desc)
+{
+    D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Tex2D((DXGI_FORMAT)desc.Format,
+        desc.Width, desc.Height, 1, 1, desc.SampleCount);
+    if (desc.Flags & RenderGraphTextureRenderTarget)
+        resourceDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+    if (desc.Flags & RenderGraphTextureDepthStencil)
+        resourceDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+    if (desc.Flags & RenderGraphTextureUnorderedAccess)
+        resourceDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    return resourceDesc;
+}
+
+std::vector<RenderGraphD3D12::Layout> RenderGraphD3D12::LayoutOf(const RenderGraph& graph)const
+{
+    std::vector<Layout> layout;
+    for (const RenderGraphPlacement& p : graph.Placements())
+        layout.push_back({ p.Resource, graph.TextureDesc(p.Resource), p.Offset, p.InitialState });
+    return layout;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "RenderGraph.h"
+
+// D3D12 side of RenderGraph: creates the transient textures as placed
+// resources in one heap, keeps RTV/DSV descriptors for them, holds the
+// resources imported from the app, and records graph barriers.  The heap
+// is created for render target and depth stencil textures only, which is
+// what every resource heap tier supports.
+class RenderGraphD3D12
+{
+public:
+    void SetDevice(ID3D12Device* device);
+
+    // Fills in SizeInBytes and Alignment of a texture description.
+    void Describe(RenderGraphTextureDesc& desc)const;
+
+    // Imported resources have to be bound every time the graph is rebuilt.
+    void BindImport(std::uint32_t resource, ID3D12Resource* d3dResource,
+        D3D12_CPU_DESCRIPTOR_HANDLE rtv = {}, D3D12_CPU_DESCRIPTOR_HANDLE dsv = {});
+
+    // True if the compiled graph wants a different heap or different
+    // transient textures than the ones we have.  Realize releases the old
+    // ones, so the GPU must be done with them first.
+    bool NeedsRealize(const RenderGraph& graph)const;
+    void Realize(const RenderGraph& graph);
+
+    ID3D12Resource* Resource(std::uint32_t resource)const { return mEntries[resource].Resource; }
+    D3D12_CPU_DESCRIPTOR_HANDLE Rtv(std::uint32_t resource)const { return mEntries[resource].Rtv; }
+    D3D12_CPU_DESCRIPTOR_HANDLE Dsv(std::uint32_t resource)const { return mEntries[resource].Dsv; }
+
+    // Records a batch of graph barriers with a single ResourceBarrier call.
+    void Barriers(ID3D12GraphicsCommandList* cmdList, const RenderGraphBarrier* barriers, std::uint32_t count);
+
+    std::uint64_t HeapSize()const { return mHeapSize; }
+
+private:
+    struct Entry
+    {
+        ID3D12Resource* Resource = nullptr;
+        D3D12_CPU_DESCRIPTOR_HANDLE Rtv = {};
+        D3D12_CPU_DESCRIPTOR_HANDLE Dsv = {};
+    };
+
+    // What a transient was created from; a change means recreating it.
+    struct Layout
+    {
+        std::uint32_t Resource = 0;
+        RenderGraphTextureDesc Desc;
+        std::uint64_t Offset = 0;
+        ResourceState InitialState = ResourceState::Common;
+
+        bool operator==(const Layout& rhs)const = default;
+    };
+
+    static D3D12_RESOURCE_DESC ResourceDesc(const RenderGraphTextureDesc& desc);
+    std::vector<Layout> LayoutOf(const RenderGraph& graph)const;
+
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+    Microsoft::WRL::ComPtr<ID3D12Heap> mHeap;
+    std::uint64_t mHeapSize = 0;
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mRtvHeap;
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mDsvHeap;
+
+    std::vector<Layout> mLayout;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mTransients;
+    std::vector<Entry> mEntries;
+    std::vector<D3D12_RESOURCE_BARRIER> mBarrierScratch;
+};
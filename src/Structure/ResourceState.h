@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+// Resource states with the values of D3D12_RESOURCE_STATES, so the CPU side
+// libraries can reason about barriers without the D3D12 headers and the
+// D3D12 glue can cast straight across.
+enum class ResourceState : std::uint32_t
+{
+    Common = 0,
+    VertexAndConstantBuffer = 0x1,
+    IndexBuffer = 0x2,
+    RenderTarget = 0x4,
+    UnorderedAccess = 0x8,
+    DepthWrite = 0x10,
+    DepthRead = 0x20,
+    NonPixelShaderResource = 0x40,
+    PixelShaderResource = 0x80,
+    IndirectArgument = 0x200,
+    CopyDest = 0x400,
+    CopySource = 0x800,
+    ResolveDest = 0x1000,
+    ResolveSource = 0x2000,
+    Present = 0
+};
+
+constexpr ResourceState operator|(ResourceState a, ResourceState b)
+{
+    return ResourceState(std::uint32_t(a) | std::uint32_t(b));
+}
+
+constexpr ResourceState operator&(ResourceState a, ResourceState b)
+{
+    return ResourceState(std::uint32_t(a) & std::uint32_t(b));
+}
+
+// States that only read.  Any combination of them can be held at once; a
+// write state has to be held on its own.
+constexpr ResourceState ReadOnlyStates =
+    ResourceState::VertexAndConstantBuffer | ResourceState::IndexBuffer |
+    ResourceState::DepthRead | ResourceState::NonPixelShaderResource |
+    ResourceState::PixelShaderResource | ResourceState::IndirectArgument |
+    ResourceState::CopySource | ResourceState::ResolveSource;
+
+constexpr bool IsReadOnlyState(ResourceState state)
+{
+    return state != ResourceState::Common && (std::uint32_t(state) & ~std::uint32_t(ReadOnlyStates)) == 0;
+}
+
+// True if being in current already allows every use in wanted.
+constexpr bool StateCovers(ResourceState current, ResourceState wanted)
+{
+    return current == wanted ||
+        (IsReadOnlyState(current) && IsReadOnlyState(wanted) &&
+         (std::uint32_t(wanted) & ~std::uint32_t(current)) == 0);
+}
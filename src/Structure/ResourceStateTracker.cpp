@@ -0,0 +1,358 @@
+#include "ResourceStateTracker.h"
+
+#include <stdexcept>
+
+#include "StateCache.h"
+
+namespace
+{
+    // States a texture in Common reaches on first use without a barrier.
+    bool TexturePromotesTo(ResourceState state)
+    {
+        const ResourceState promotable = ResourceState::NonPixelShaderResource |
+            ResourceState::PixelShaderResource | ResourceState::CopyDest | ResourceState::CopySource;
+        if ((std::uint32_t(state) & ~std::uint32_t(promotable)) != 0 || state == ResourceState::Common)
+            return false;
+        // Only one write state at a time, and never a write mixed with reads.
+        return IsReadOnlyState(state) || state == ResourceState::CopyDest;
+    }
+
+    ResourceState CombinedState(ResourceState current, ResourceState after)
+    {
+        return IsReadOnlyState(current) && IsReadOnlyState(after) ? current | after : after;
+    }
+}
+
+void GlobalResourceStates::Register(const void* resource, std::uint32_t subresourceCount, ResourceState state, bool isBuffer)
+{
+    if (subresourceCount == 0)
+    {
+        throw std::invalid_argument("GlobalResourceStates::Register needs at least one subresource.");
+    }
+
+    Entry& entry = mEntries[resource];
+    entry.IsBuffer = isBuffer;
+    entry.States.assign(subresourceCount, state);
+}
+
+void GlobalResourceStates::Unregister(const void* resource)
+{
+    mEntries.erase(resource);
+}
+
+std::uint32_t GlobalResourceStates::SubresourceCount(const void* resource)const
+{
+    return (std::uint32_t)Find(resource).States.size();
+}
+
+ResourceState GlobalResourceStates::State(const void* resource, std::uint32_t subresource)const
+{
+    return Find(resource).States.at(subresource);
+}
+
+const GlobalResourceStates::Entry& GlobalResourceStates::Find(const void* resource)const
+{
+    auto it = mEntries.find(resource);
+    if (it == mEntries.end())
+    {
+        throw std::invalid_argument("Resource is not registered with GlobalResourceStates.");
+    }
+    return it->second;
+}
+
+ResourceStateTracker::ResourceStateTracker(GlobalResourceStates* global) :
+    mGlobal(global)
+{
+}
+
+void ResourceStateTracker::Reset()
+{
+    mLocals.clear();
+    mQueued.clear();
+    mQueuedLive.clear();
+    mStats = ResourceStateTrackerStats();
+}
+
+void ResourceStateTracker::Transition(const void* resource, ResourceState after, std::uint32_t subresource)
+{
+    ++mStats.Requested;
+    const std::size_t queued = mQueued.size();
+    const std::uint32_t merged = mStats.Merged;
+
+    Local& local = Get(resource);
+    if (subresource != AllSubresources)
+    {
+        TransitionOne(resource, local, subresource, after);
+    }
+    else if (IsUniform(local) && local.States[0] != Unknown)
+    {
+        // One barrier for the whole resource instead of one per subresource.
+        const ResourceState current = local.States[0];
+        if (!StateCovers(current, after))
+        {
+            const ResourceState target = CombinedState(current, after);
+            Queue({ ResourceBarrierDesc::Type::Transition, ResourceBarrierDesc::Split::None,
+                resource, AllSubresources, current, target });
+            local.States.assign(local.States.size(), target);
+        }
+    }
+    else
+    {
+        for (std::uint32_t s = 0; s < (std::uint32_t)local.States.size(); ++s)
+            TransitionOne(resource, local, s, after);
+    }
+
+    if (mQueued.size() == queued && mStats.Merged == merged)
+        ++mStats.Elided;
+}
+
+void ResourceStateTracker::BeginTransition(const void* resource, ResourceState after, std::uint32_t subresource)
+{
+    ++mStats.Requested;
+    Local& local = Get(resource);
+
+    const std::uint32_t first = subresource == AllSubresources ? 0 : subresource;
+    const std::uint32_t last = subresource == AllSubresources ? (std::uint32_t)local.States.size() - 1 : subresource;
+    for (std::uint32_t s = first; s <= last; ++s)
+    {
+        if (local.States.at(s) == Unknown)
+        {
+            throw std::logic_error("BeginTransition of a resource not used on this command list yet.");
+        }
+        if (local.SplitOpen[s])
+            EndSplit(resource, local, s);
+    }
+
+    if (subresource == AllSubresources && IsUniform(local))
+    {
+        const ResourceState current = local.States[0];
+        if (current == after)
+        {
+            ++mStats.Elided;
+            return;
+        }
+
+        Queue({ ResourceBarrierDesc::Type::Transition, ResourceBarrierDesc::Split::BeginOnly,
+            resource, AllSubresources, current, after });
+        local.States.assign(local.States.size(), after);
+        local.SplitOpen.assign(local.States.size(), 1);
+        local.SplitBefore.assign(local.States.size(), current);
+        local.SplitSubresource.assign(local.States.size(), AllSubresources);
+        return;
+    }
+
+    for (std::uint32_t s = first; s <= last; ++s)
+    {
+        const ResourceState current = local.States[s];
+        if (current == after)
+            continue;
+
+        Queue({ ResourceBarrierDesc::Type::Transition, ResourceBarrierDesc::Split::BeginOnly,
+            resource, s, current, after });
+        local.States[s] = after;
+        local.SplitOpen[s] = 1;
+        local.SplitBefore[s] = current;
+        local.SplitSubresource[s] = s;
+    }
+}
+
+void ResourceStateTracker::UAVBarrier(const void* resource)
+{
+    ++mStats.Requested;
+    Queue({ ResourceBarrierDesc::Type::UnorderedAccess, ResourceBarrierDesc::Split::None, resource });
+}
+
+void ResourceStateTracker::Flush(CommandSink& sink)
+{
+    std::size_t live = 0;
+    for (std::size_t i = 0; i < mQueued.size(); ++i)
+    {
+        if (mQueuedLive[i])
+            mQueued[live++] = mQueued[i];
+    }
+
+    if (live > 0)
+    {
+        sink.ResourceBarrier((std::uint32_t)live, mQueued.data());
+        mStats.Barriers += (std::uint32_t)live;
+        ++mStats.Flushes;
+    }
+
+    mQueued.clear();
+    mQueuedLive.clear();
+}
+
+void ResourceStateTracker::Close(CommandSink& sink)
+{
+    for (auto& [resource, local] : mLocals)
+    {
+        for (std::uint32_t s = 0; s < (std::uint32_t)local.SplitOpen.size(); ++s)
+        {
+            if (local.SplitOpen[s])
+                EndSplit(resource, local, s);
+        }
+    }
+    Flush(sink);
+}
+
+void ResourceStateTracker::ResolvePending(std::vector<ResourceBarrierDesc>& fixups)
+{
+    std::vector<ResourceBarrierDesc> resourceFixups;
+    std::vector<std::uint8_t> promoted;
+
+    for (auto& [resource, local] : mLocals)
+    {
+        GlobalResourceStates::Entry& global = mGlobal->mEntries.at(resource);
+        const std::uint32_t count = (std::uint32_t)local.States.size();
+
+        resourceFixups.clear();
+        promoted.assign(count, 0);
+        for (std::uint32_t s = 0; s < count; ++s)
+        {
+            const ResourceState wanted = local.Pending[s];
+            if (wanted == Unknown)
+                continue;
+
+            const ResourceState current = global.States[s];
+            if (current == ResourceState::Common && (global.IsBuffer || TexturePromotesTo(wanted)))
+            {
+                promoted[s] = 1;
+            }
+            else if (current != wanted)
+            {
+                resourceFixups.push_back({ ResourceBarrierDesc::Type::Transition, ResourceBarrierDesc::Split::None,
+                    resource, s, current, wanted });
+            }
+        }
+
+        // Every subresource making the same move is one barrier.
+        bool whole = resourceFixups.size() == count && count > 1;
+        for (std::size_t i = 1; whole && i < resourceFixups.size(); ++i)
+        {
+            whole = resourceFixups[i].Before == resourceFixups[0].Before &&
+                resourceFixups[i].After == resourceFixups[0].After;
+        }
+        if (whole)
+        {
+            resourceFixups.resize(1);
+            resourceFixups[0].Subresource = AllSubresources;
+        }
+        fixups.insert(fixups.end(), resourceFixups.begin(), resourceFixups.end());
+        mStats.Fixups += (std::uint32_t)resourceFixups.size();
+
+        // Buffers, and textures only promoted to a read state, decay back
+        // to Common once the list has run.
+        for (std::uint32_t s = 0; s < count; ++s)
+        {
+            ResourceState final = local.States[s];
+            if (final == Unknown)
+                continue;
+
+            if (global.IsBuffer || (promoted[s] && final == local.Pending[s] && IsReadOnlyState(final)))
+                final = ResourceState::Common;
+            global.States[s] = final;
+        }
+    }
+}
+
+std::uint32_t ResourceStateTracker::QueuedCount()const
+{
+    std::uint32_t count = 0;
+    for (std::uint8_t live : mQueuedLive)
+        count += live;
+    return count;
+}
+
+ResourceStateTracker::Local& ResourceStateTracker::Get(const void* resource)
+{
+    auto it = mLocals.find(resource);
+    if (it != mLocals.end())
+        return it->second;
+
+    const GlobalResourceStates::Entry& global = mGlobal->Find(resource);
+    const std::size_t count = global.States.size();
+
+    Local& local = mLocals[resource];
+    local.States.assign(count, Unknown);
+    local.Pending.assign(count, Unknown);
+    local.SplitOpen.assign(count, 0);
+    local.SplitBefore.assign(count, ResourceState::Common);
+    local.SplitSubresource.assign(count, AllSubresources);
+    return local;
+}
+
+void ResourceStateTracker::TransitionOne(const void* resource, Local& local, std::uint32_t subresource, ResourceState after)
+{
+    const ResourceState current = local.States.at(subresource);
+    if (current == Unknown)
+    {
+        local.Pending[subresource] = after;
+        local.States[subresource] = after;
+        return;
+    }
+
+    if (local.SplitOpen[subresource])
+        EndSplit(resource, local, subresource);
+
+    if (StateCovers(current, after))
+        return;
+
+    const ResourceState target = CombinedState(current, after);
+    Queue({ ResourceBarrierDesc::Type::Transition, ResourceBarrierDesc::Split::None,
+        resource, subresource, current, target });
+    local.States[subresource] = target;
+}
+
+void ResourceStateTracker::EndSplit(const void* resource, Local& local, std::uint32_t subresource)
+{
+    const std::uint32_t begun = local.SplitSubresource[subresource];
+    Queue({ ResourceBarrierDesc::Type::Transition, ResourceBarrierDesc::Split::EndOnly,
+        resource, begun, local.SplitBefore[subresource], local.States[subresource] });
+
+    if (begun == AllSubresources)
+        local.SplitOpen.assign(local.SplitOpen.size(), 0);
+    else
+        local.SplitOpen[subresource] = 0;
+}
+
+void ResourceStateTracker::Queue(const ResourceBarrierDesc& barrier)
+{
+    // Only the last queued barrier touching the resource can be folded
+    // into; anything in between has to keep its order.
+    for (std::size_t i = mQueued.size(); i-- > 0;)
+    {
+        if (!mQueuedLive[i] || mQueued[i].Resource != barrier.Resource)
+            continue;
+
+        ResourceBarrierDesc& last = mQueued[i];
+        if (barrier.Kind == ResourceBarrierDesc::Type::UnorderedAccess && last.Kind == barrier.Kind)
+        {
+            ++mStats.Merged;
+            return;
+        }
+
+        if (barrier.Kind == ResourceBarrierDesc::Type::Transition && barrier.Flags == ResourceBarrierDesc::Split::None &&
+            last.Kind == barrier.Kind && last.Flags == barrier.Flags && last.Subresource == barrier.Subresource)
+        {
+            ++mStats.Merged;
+            last.After = barrier.After;
+            if (last.Before == last.After)
+                mQueuedLive[i] = 0;
+            return;
+        }
+        break;
+    }
+
+    mQueued.push_back(barrier);
+    mQueuedLive.push_back(1);
+}
+
+bool ResourceStateTracker::IsUniform(const Local& local)const
+{
+    for (std::size_t s = 0; s < local.States.size(); ++s)
+    {
+        if (local.States[s] != local.States[0] || local.SplitOpen[s])
+            return false;
+    }
+    return true;
+}
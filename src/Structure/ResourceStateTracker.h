@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ResourceState.h"
+
+class CommandSink;
+
+// Same value as D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES.
+constexpr std::uint32_t AllSubresources = 0xffffffff;
+
+// One barrier as the trackers hand it to a CommandSink.  Resource is the
+// API object (an ID3D12Resource on D3D12), only compared here.
+struct ResourceBarrierDesc
+{
+    enum class Type : std::uint8_t
+    {
+        Transition,
+        UnorderedAccess
+    };
+
+    // Split barriers: BeginOnly starts a transition the GPU can work on
+    // while other commands run, the matching EndOnly waits for it.
+    enum class Split : std::uint8_t
+    {
+        None,
+        BeginOnly,
+        EndOnly
+    };
+
+    Type Kind = Type::Transition;
+    Split Flags = Split::None;
+    const void* Resource = nullptr;
+    std::uint32_t Subresource = AllSubresources;
+    ResourceState Before = ResourceState::Common;
+    ResourceState After = ResourceState::Common;
+
+    bool operator==(const ResourceBarrierDesc& rhs)const = default;
+};
+
+// The state of every tracked resource between command lists, that is as of
+// the last list resolved against it.  Register resources when they are
+// created, from the thread that submits.
+class GlobalResourceStates
+{
+public:
+    // Buffers can go from Common to any state without a barrier and fall
+    // back to Common after every ExecuteCommandLists.
+    void Register(const void* resource, std::uint32_t subresourceCount, ResourceState state, bool isBuffer);
+    void Unregister(const void* resource);
+
+    bool IsRegistered(const void* resource)const { return mEntries.count(resource) != 0; }
+    std::uint32_t SubresourceCount(const void* resource)const;
+    ResourceState State(const void* resource, std::uint32_t subresource)const;
+
+private:
+    friend class ResourceStateTracker;
+
+    struct Entry
+    {
+        bool IsBuffer = false;
+        std::vector<ResourceState> States;
+    };
+
+    const Entry& Find(const void* resource)const;
+
+    std::unordered_map<const void*, Entry> mEntries;
+};
+
+struct ResourceStateTrackerStats
+{
+    // Transition calls made, and those that needed no barrier at all.
+    std::uint32_t Requested = 0;
+    std::uint32_t Elided = 0;
+    // Queued barriers folded into a later one for the same subresource.
+    std::uint32_t Merged = 0;
+    std::uint32_t Barriers = 0;
+    std::uint32_t Flushes = 0;
+    std::uint32_t Fixups = 0;
+};
+
+// The states resources are in on one command list.  Transitions are only
+// queued; Flush records everything queued with one ResourceBarrier call
+// and belongs right before the next draw, dispatch or copy.  A queued
+// transition that is changed again before the flush is updated in place,
+// and one that ends where it started is dropped.
+//
+// The first use of a resource on the list cannot know the state it will
+// be in when the list runs, so it is kept as pending and nothing is
+// recorded.  ResolvePending, called at submit time in submission order,
+// returns the barriers that bring the resources from their global state
+// into what the list expects (to be recorded into a list submitted just
+// before) and stores the states the list leaves behind.
+class ResourceStateTracker
+{
+public:
+    explicit ResourceStateTracker(GlobalResourceStates* global);
+
+    GlobalResourceStates* Global()const { return mGlobal; }
+
+    // Forgets everything, call when the command list is reset.
+    void Reset();
+
+    void Transition(const void* resource, ResourceState after, std::uint32_t subresource = AllSubresources);
+
+    // Starts a split transition.  The state is reached at the next
+    // Transition to it, or at Close.  Only for resources already used on
+    // this list, as the begin and end have to be on the same list.
+    void BeginTransition(const void* resource, ResourceState after, std::uint32_t subresource = AllSubresources);
+
+    void UAVBarrier(const void* resource);
+
+    void Flush(CommandSink& sink);
+
+    // Ends open split transitions and flushes.  Call before closing the list.
+    void Close(CommandSink& sink);
+
+    void ResolvePending(std::vector<ResourceBarrierDesc>& fixups);
+
+    std::uint32_t QueuedCount()const;
+    const ResourceStateTrackerStats& Stats()const { return mStats; }
+
+private:
+    static constexpr ResourceState Unknown = ResourceState(0xffffffffu);
+
+    struct Local
+    {
+        std::vector<ResourceState> States;
+        // First state the list wants, per subresource, while Unknown.
+        std::vector<ResourceState> Pending;
+        // Subresources with a BeginOnly recorded or queued and no EndOnly
+        // yet; the end has to repeat the begin's subresource and states.
+        std::vector<std::uint8_t> SplitOpen;
+        std::vector<ResourceState> SplitBefore;
+        std::vector<std::uint32_t> SplitSubresource;
+    };
+
+    Local& Get(const void* resource);
+    void TransitionOne(const void* resource, Local& local, std::uint32_t subresource, ResourceState after);
+    void EndSplit(const void* resource, Local& local, std::uint32_t subresource);
+    void Queue(const ResourceBarrierDesc& barrier);
+    bool IsUniform(const Local& local)const;
+
+    GlobalResourceStates* mGlobal = nullptr;
+    std::unordered_map<const void*, Local> mLocals;
+    std::vector<ResourceBarrierDesc> mQueued;
+    std::vector<std::uint8_t> mQueuedLive;
+    ResourceStateTrackerStats mStats;
+};
@@ -0,0 +1,136 @@
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "Utility/TempFile.h"
+
+namespace
+{
+    // Far more than any real shader, low enough to stop include cycles.
+    constexpr int MaxIncludeDepth = 32;
+
+    // Returns true and the included name if line is #include "name" or
+    // #include <name>.
+    bool ParseInclude(const std::string& line, std::string& name)
+    {
+        std::size_t i = line.find_first_not_of(" \t");
+        if (i == std::string::npos || line[i] != '#')
+            return false;
+
+        i = line.find_first_not_of(" \t", i + 1);
+        if (i == std::string::npos || line.compare(i, 7, "include") != 0)
+            return false;
+
+        i = line.find_first_not_of(" \t", i + 7);
+        if (i == std::string::npos || (line[i] != '"' && line[i] != '<'))
+            return false;
+
+        const char close = line[i] == '"' ? '"' : '>';
+        const std::size_t end = line.find(close, i + 1);
+        if (end == std::string::npos)
+            return false;
+
+        name = line.substr(i + 1, end - i - 1);
+        return true;
+    }
+
+    bool Expand(const std::filesystem::path& path, int depth, ShaderSource& source, std::string& error)
+    {
+        if (depth > MaxIncludeDepth)
+        {
+            error = "Includes nest too deep at " + path.generic_string();
+            return false;
+        }
+
+        std::ifstream fin(path, std::ios::binary);
+        if (!fin)
+        {
+            error = "Cannot open " + path.generic_string();
+            return false;
+        }
+
+        const std::string name = path.generic_string();
+        if (std::find(source.Files.begin(), source.Files.end(), name) == source.Files.end())
+            source.Files.push_back(name);
+
+        source.Text += "#line 1 \"" + name + "\"\n";
+
+        std::string line;
+        std::string include;
+        for (int lineNumber = 1; std::getline(fin, line); ++lineNumber)
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            if (!ParseInclude(line, include))
+            {
+                source.Text += line;
+                source.Text += '\n';
+                continue;
+            }
+
+            if (!Expand((path.parent_path() / include).lexically_normal(), depth + 1, source, error))
+                return false;
+            source.Text += "#line " + std::to_string(lineNumber + 1) + " \"" + name + "\"\n";
+        }
+        return true;
+    }
+}
+
+bool ShaderCache::ExpandIncludes(const std::string& path, ShaderSource& source, std::string& error)
+{
+    source.Text.clear();
+    source.Files.clear();
+    error.clear();
+    return Expand(std::filesystem::path(path).lexically_normal(), 0, source, error);
+}
+
+Hash128 ShaderCache::Key(const ShaderSource& source, const std::vector<ShaderDefine>& defines,
+    const std::string& entryPoint, const std::string& target, std::uint32_t compileFlags)
+{
+    StableHasher h(KeyVersion);
+    h.AddString(source.Text);
+    h.Add((std::uint64_t)defines.size());
+    for (const ShaderDefine& define : defines)
+    {
+        h.AddString(define.Name);
+        h.AddString(define.Value);
+    }
+    h.AddString(entryPoint);
+    h.AddString(target);
+    h.Add(compileFlags);
+    return h.Finish();
+}
+
+std::string ShaderCache::CachePath(const std::string& dir, const Hash128& key)
+{
+    return (std::filesystem::path(dir) / (key.ToHex() + ".cso")).generic_string();
+}
+
+bool ShaderCache::WriteFile(const std::string& path, const void* data, std::size_t size)
+{
+    std::error_code ec;
+    const std::filesystem::path target(path);
+    if (target.has_parent_path())
+        std::filesystem::create_directories(target.parent_path(), ec);
+
+    const std::string temp = TempFile::UniquePath(path);
+    {
+        std::ofstream fout(temp, std::ios::binary | std::ios::trunc);
+        if (!fout)
+            return false;
+        fout.write(static_cast<const char*>(data), (std::streamsize)size);
+        if (!fout)
+            return false;
+    }
+
+    std::filesystem::rename(temp, target, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Utility/StableHash.h"
+
+struct ShaderDefine
+{
+    std::string Name;
+    std::string Value;
+};
+
+// A shader file with every #include pasted in, which is what the compiler
+// sees before macro expansion.  #line directives keep error messages
+// pointing at the original files.
+struct ShaderSource
+{
+    std::string Text;
+
+    // The file itself first, then its includes in the order they were met.
+    std::vector<std::string> Files;
+};
+
+// Compiled shaders stored by a hash of everything that goes into the
+// compiler: the expanded source, the defines in order, entry point, target
+// and flags.  Editing any included file changes the expanded source, so
+// stale bytecode is never picked up, and identical inputs from different
+// shaders share one file.
+namespace ShaderCache
+{
+    // Bump when the key layout or the include expansion changes.
+    constexpr std::uint64_t KeyVersion = 1;
+
+    // Includes are looked up next to the including file.  Returns false and
+    // sets error if a file is missing or includes nest too deep.
+    bool ExpandIncludes(const std::string& path, ShaderSource& source, std::string& error);
+
+    Hash128 Key(const ShaderSource& source, const std::vector<ShaderDefine>& defines,
+        const std::string& entryPoint, const std::string& target, std::uint32_t compileFlags);
+
+    // dir/<32 hex digits>.cso
+    std::string CachePath(const std::string& dir, const Hash128& key);
+
+    // Writes through a temporary file, so a reader never sees half of it.
+    bool WriteFile(const std::string& path, const void* data, std::size_t size);
+}
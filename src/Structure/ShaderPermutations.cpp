@@ -0,0 +1,227 @@
+#include "ShaderPermutations.h"
+
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+
+#include "Utility/ThreadPool.h"
+
+ShaderPermutationSet::ShaderPermutationSet(std::string file) :
+    mFile(std::move(file))
+{
+}
+
+std::uint32_t ShaderPermutationSet::AddKeyword(std::string name, std::vector<std::string> values)
+{
+    if (values.empty())
+    {
+        throw std::invalid_argument("Shader keyword " + name + " needs at least one value.");
+    }
+
+    mKeywords.push_back({ std::move(name), std::move(values) });
+    return (std::uint32_t)mKeywords.size() - 1;
+}
+
+std::uint32_t ShaderPermutationSet::AddStage(std::string name, std::string entryPoint, std::string target,
+    std::vector<std::uint32_t> keywords)
+{
+    for (std::uint32_t keyword : keywords)
+    {
+        if (keyword >= mKeywords.size())
+        {
+            throw std::out_of_range("Shader stage " + name + " uses an unknown keyword.");
+        }
+    }
+
+    mStages.push_back({ std::move(name), std::move(entryPoint), std::move(target), std::move(keywords) });
+    return (std::uint32_t)mStages.size() - 1;
+}
+
+void ShaderPermutationSet::SetFilter(std::function<bool(const ShaderPermutationSet& set, Permutation p)> filter)
+{
+    mFilter = std::move(filter);
+}
+
+std::uint32_t ShaderPermutationSet::PermutationCount()const
+{
+    std::uint32_t count = 1;
+    for (const Keyword& keyword : mKeywords)
+        count *= (std::uint32_t)keyword.Values.size();
+    return count;
+}
+
+std::uint32_t ShaderPermutationSet::FindKeyword(const std::string& name)const
+{
+    for (std::uint32_t k = 0; k < mKeywords.size(); ++k)
+    {
+        if (mKeywords[k].Name == name)
+            return k;
+    }
+    throw std::out_of_range("Unknown shader keyword " + name);
+}
+
+std::uint32_t ShaderPermutationSet::FindStage(const std::string& name)const
+{
+    for (std::uint32_t s = 0; s < mStages.size(); ++s)
+    {
+        if (mStages[s].Name == name)
+            return s;
+    }
+    throw std::out_of_range("Unknown shader stage " + name);
+}
+
+std::uint32_t ShaderPermutationSet::ValueIndex(Permutation p, std::uint32_t keyword)const
+{
+    for (std::uint32_t k = 0; k < keyword; ++k)
+        p /= (std::uint32_t)mKeywords[k].Values.size();
+    return p % (std::uint32_t)mKeywords[keyword].Values.size();
+}
+
+const std::string& ShaderPermutationSet::Value(Permutation p, std::uint32_t keyword)const
+{
+    return mKeywords[keyword].Values[ValueIndex(p, keyword)];
+}
+
+std::uint32_t ShaderPermutationSet::ValueAtLeast(std::uint32_t keyword, std::uint32_t count)const
+{
+    const std::vector<std::string>& values = mKeywords[keyword].Values;
+    for (std::uint32_t v = 0; v < values.size(); ++v)
+    {
+        const std::uint32_t number = values[v].empty() ? 0 : (std::uint32_t)std::stoul(values[v]);
+        if (number >= count)
+            return v;
+    }
+    return (std::uint32_t)values.size();
+}
+
+ShaderPermutationSet::Permutation ShaderPermutationSet::Compose(const std::uint32_t* valueIndices)const
+{
+    Permutation p = 0;
+    for (std::uint32_t k = KeywordCount(); k-- > 0;)
+        p = p * (std::uint32_t)mKeywords[k].Values.size() + valueIndices[k];
+    return p;
+}
+
+bool ShaderPermutationSet::IsReachable(Permutation p)const
+{
+    return p < PermutationCount() && (!mFilter || mFilter(*this, p));
+}
+
+std::vector<ShaderPermutationSet::Permutation> ShaderPermutationSet::Enumerate()const
+{
+    std::vector<Permutation> result;
+    const std::uint32_t count = PermutationCount();
+    for (Permutation p = 0; p < count; ++p)
+    {
+        if (IsReachable(p))
+            result.push_back(p);
+    }
+    return result;
+}
+
+bool ShaderPermutationSet::Select(const std::uint32_t* minimumValues, Permutation& result)const
+{
+    std::uint32_t bestCost = ~0u;
+    for (Permutation p : Enumerate())
+    {
+        std::uint32_t cost = 0;
+        bool satisfies = true;
+        for (std::uint32_t k = 0; k < KeywordCount() && satisfies; ++k)
+        {
+            const std::uint32_t value = ValueIndex(p, k);
+            satisfies = value >= minimumValues[k];
+            cost += value;
+        }
+
+        if (satisfies && cost < bestCost)
+        {
+            bestCost = cost;
+            result = p;
+        }
+    }
+    return bestCost != ~0u;
+}
+
+std::vector<ShaderDefine> ShaderPermutationSet::Defines(Permutation p, std::uint32_t stage)const
+{
+    std::vector<ShaderDefine> defines;
+    for (std::uint32_t keyword : mStages[stage].Keywords)
+    {
+        const std::string& value = Value(p, keyword);
+        if (!value.empty())
+            defines.push_back({ mKeywords[keyword].Name, value });
+    }
+    return defines;
+}
+
+std::uint32_t ShaderPermutationCompiler::Add(const ShaderPermutationSet& set)
+{
+    SetEntry entry = { &set, {} };
+    entry.Jobs.assign((std::size_t)set.PermutationCount() * set.StageCount(), NoJob);
+
+    for (ShaderPermutationSet::Permutation p : set.Enumerate())
+    {
+        for (std::uint32_t stage = 0; stage < set.StageCount(); ++stage)
+        {
+            ShaderCompileJob job = { &set, stage, set.Defines(p, stage) };
+
+            StableHasher h;
+            h.AddString(set.File());
+            h.AddString(set.StageEntryPoint(stage));
+            h.AddString(set.StageTarget(stage));
+            for (const ShaderDefine& define : job.Defines)
+            {
+                h.AddString(define.Name);
+                h.AddString(define.Value);
+            }
+
+            auto found = mJobByKey.try_emplace(h.Finish(), (std::uint32_t)mJobs.size());
+            if (found.second)
+                mJobs.push_back(std::move(job));
+            entry.Jobs[(std::size_t)p * set.StageCount() + stage] = found.first->second;
+        }
+    }
+
+    mSets.push_back(std::move(entry));
+    return (std::uint32_t)mSets.size() - 1;
+}
+
+void ShaderPermutationCompiler::Clear()
+{
+    mSets.clear();
+    mJobs.clear();
+    mJobByKey.clear();
+}
+
+std::uint32_t ShaderPermutationCompiler::JobIndex(std::uint32_t setIndex, ShaderPermutationSet::Permutation p, std::uint32_t stage)const
+{
+    const SetEntry& entry = mSets[setIndex];
+    if (p >= entry.Set->PermutationCount())
+        return NoJob;
+    return entry.Jobs[(std::size_t)p * entry.Set->StageCount() + stage];
+}
+
+void ShaderPermutationCompiler::Run(ThreadPool& pool,
+    const std::function<void(const ShaderCompileJob& job, std::uint32_t jobIndex)>& compile)const
+{
+    // An exception must not escape into a worker thread.
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    pool.ParallelFor((std::uint32_t)mJobs.size(), [&](std::uint32_t index, std::uint32_t)
+    {
+        try
+        {
+            compile(mJobs[index], index);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+                error = std::current_exception();
+        }
+    });
+
+    if (error)
+        std::rethrow_exception(error);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ShaderCache.h"
+
+class ThreadPool;
+
+// Feature keywords of one shader file and the stages compiled from it.  A
+// permutation picks one value per keyword; it is stored as a mixed radix
+// number with the first keyword in the lowest digit.  Stages only see the
+// keywords they declare, so permutations that differ in keywords a stage
+// ignores compile to the same job for that stage.
+class ShaderPermutationSet
+{
+public:
+    using Permutation = std::uint32_t;
+
+    explicit ShaderPermutationSet(std::string file);
+
+    // Values are ordered cheapest first, value 0 is the default.  An empty
+    // value leaves the macro undefined, for #ifdef style switches.
+    std::uint32_t AddKeyword(std::string name, std::vector<std::string> values);
+
+    // keywords are indices returned by AddKeyword.
+    std::uint32_t AddStage(std::string name, std::string entryPoint, std::string target,
+        std::vector<std::uint32_t> keywords = {});
+
+    // Permutations the filter rejects are never enumerated or selected,
+    // for combinations the shader cannot handle or the app never asks for.
+    void SetFilter(std::function<bool(const ShaderPermutationSet& set, Permutation p)> filter);
+
+    const std::string& File()const { return mFile; }
+    std::uint32_t KeywordCount()const { return (std::uint32_t)mKeywords.size(); }
+    std::uint32_t StageCount()const { return (std::uint32_t)mStages.size(); }
+    std::uint32_t PermutationCount()const;
+
+    std::uint32_t FindKeyword(const std::string& name)const;
+    std::uint32_t FindStage(const std::string& name)const;
+    const std::string& StageName(std::uint32_t stage)const { return mStages[stage].Name; }
+    const std::string& StageEntryPoint(std::uint32_t stage)const { return mStages[stage].EntryPoint; }
+    const std::string& StageTarget(std::uint32_t stage)const { return mStages[stage].Target; }
+
+    std::uint32_t ValueIndex(Permutation p, std::uint32_t keyword)const;
+    const std::string& Value(Permutation p, std::uint32_t keyword)const;
+
+    // Index of the first value whose number is at least count, for keywords
+    // like light counts.  Empty values count as 0.  Returns the value count
+    // if none is large enough.
+    std::uint32_t ValueAtLeast(std::uint32_t keyword, std::uint32_t count)const;
+
+    Permutation Compose(const std::uint32_t* valueIndices)const;
+    bool IsReachable(Permutation p)const;
+
+    // Every permutation that passes the filter, in increasing order.
+    std::vector<Permutation> Enumerate()const;
+
+    // Cheapest reachable permutation with at least minimumValues[k] for
+    // every keyword k, where the cost is the sum of the value indices.
+    // Returns false if there is none.
+    bool Select(const std::uint32_t* minimumValues, Permutation& result)const;
+
+    // The defines stage is compiled with for p: its keywords with a value,
+    // in declaration order.
+    std::vector<ShaderDefine> Defines(Permutation p, std::uint32_t stage)const;
+
+private:
+    struct Keyword
+    {
+        std::string Name;
+        std::vector<std::string> Values;
+    };
+
+    struct Stage
+    {
+        std::string Name;
+        std::string EntryPoint;
+        std::string Target;
+        std::vector<std::uint32_t> Keywords;
+    };
+
+    std::string mFile;
+    std::vector<Keyword> mKeywords;
+    std::vector<Stage> mStages;
+    std::function<bool(const ShaderPermutationSet&, Permutation)> mFilter;
+};
+
+struct ShaderCompileJob
+{
+    const ShaderPermutationSet* Set = nullptr;
+    std::uint32_t Stage = 0;
+    std::vector<ShaderDefine> Defines;
+};
+
+// Turns the reachable permutations of several sets into compile jobs, one
+// per distinct file, stage and defines, and runs them on a thread pool.
+class ShaderPermutationCompiler
+{
+public:
+    static constexpr std::uint32_t NoJob = ~0u;
+
+    // set must outlive the compiler.  Returns the index used for JobIndex.
+    std::uint32_t Add(const ShaderPermutationSet& set);
+    void Clear();
+
+    const std::vector<ShaderCompileJob>& Jobs()const { return mJobs; }
+
+    // Job that compiles stage of permutation p, or NoJob if p is unreachable.
+    std::uint32_t JobIndex(std::uint32_t setIndex, ShaderPermutationSet::Permutation p, std::uint32_t stage)const;
+
+    // Calls compile(job, jobIndex) for every job, spread over the pool, and
+    // returns once all are done.  The first exception thrown by a job is
+    // rethrown here after the rest finished.
+    void Run(ThreadPool& pool, const std::function<void(const ShaderCompileJob& job, std::uint32_t jobIndex)>& compile)const;
+
+private:
+    struct SetEntry
+    {
+        const ShaderPermutationSet* Set;
+
+        // Job per permutation * StageCount + stage.
+        std::vector<std::uint32_t> Jobs;
+    };
+
+    std::vector<SetEntry> mSets;
+    std::vector<ShaderCompileJob> mJobs;
+    std::unordered_map<Hash128, std::uint32_t, Hash128Hasher> mJobByKey;
+};
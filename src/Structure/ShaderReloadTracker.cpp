@@ -0,0 +1,75 @@
+#include "ShaderReloadTracker.h"
+
+#include <algorithm>
+#include <filesystem>
+
+ShaderReloadTracker::ShaderReloadTracker(Clock::duration debounce) :
+    mDebounce(debounce)
+{
+}
+
+void ShaderReloadTracker::SetDependencies(const std::string& root, const std::vector<std::string>& files)
+{
+    for (const std::string& file : mFiles[root])
+    {
+        auto& roots = mDependents[file];
+        roots.erase(std::remove(roots.begin(), roots.end(), root), roots.end());
+        if (roots.empty())
+            mDependents.erase(file);
+    }
+
+    mFiles[root] = files;
+    for (const std::string& file : files)
+    {
+        auto& roots = mDependents[file];
+        if (std::find(roots.begin(), roots.end(), root) == roots.end())
+            roots.push_back(root);
+    }
+}
+
+bool ShaderReloadTracker::OnFileChanged(const std::string& file, Clock::time_point now)
+{
+    auto dependents = mDependents.find(file);
+    if (dependents == mDependents.end())
+        return false;
+
+    for (const std::string& root : dependents->second)
+    {
+        auto pending = std::find_if(mPending.begin(), mPending.end(),
+            [&](const Pending& p) { return p.Root == root; });
+        if (pending == mPending.end())
+            mPending.push_back({ root, now });
+        else
+            pending->LastChange = now;
+    }
+    return true;
+}
+
+std::vector<std::string> ShaderReloadTracker::TakeReady(Clock::time_point now)
+{
+    std::vector<std::string> ready;
+    auto settled = [&](const Pending& p) { return now - p.LastChange >= mDebounce; };
+
+    for (const Pending& p : mPending)
+    {
+        if (settled(p))
+            ready.push_back(p.Root);
+    }
+    mPending.erase(std::remove_if(mPending.begin(), mPending.end(), settled), mPending.end());
+    return ready;
+}
+
+std::vector<std::string> ShaderReloadTracker::Directories()const
+{
+    std::vector<std::string> dirs;
+    for (const auto& entry : mDependents)
+    {
+        std::string dir = std::filesystem::path(entry.first).parent_path().generic_string();
+        if (dir.empty())
+            dir = ".";
+        if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end())
+            dirs.push_back(dir);
+    }
+    std::sort(dirs.begin(), dirs.end());
+    return dirs;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Maps changed files to the shader files that include them and waits for
+// edits to settle.  A root (a file shaders are compiled from) becomes
+// ready once none of its files changed for the debounce interval, so one
+// save that the watcher reports several times recompiles once.  Times are
+// passed in, which keeps the logic independent of the clock.
+class ShaderReloadTracker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ShaderReloadTracker(Clock::duration debounce = std::chrono::milliseconds(200));
+
+    // files is the root followed by everything it includes, as in
+    // ShaderSource::Files.  Replaces what root depended on before.
+    void SetDependencies(const std::string& root, const std::vector<std::string>& files);
+
+    // Returns true if file is a dependency of some root.
+    bool OnFileChanged(const std::string& file, Clock::time_point now);
+
+    // Roots whose files stopped changing at least the debounce interval
+    // before now, in the order they were first changed.  They are no
+    // longer pending afterwards.
+    std::vector<std::string> TakeReady(Clock::time_point now);
+
+    bool HasPending()const { return !mPending.empty(); }
+
+    // Directories holding any dependency, for the file watcher.
+    std::vector<std::string> Directories()const;
+
+private:
+    struct Pending
+    {
+        std::string Root;
+        Clock::time_point LastChange;
+    };
+
+    Clock::duration mDebounce;
+
+    // File to the roots that include it, and root to its files.
+    std::unordered_map<std::string, std::vector<std::string>> mDependents;
+    std::unordered_map<std::string, std::vector<std::string>> mFiles;
+
+    std::vector<Pending> mPending;
+};
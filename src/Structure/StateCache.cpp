@@ -0,0 +1,214 @@
+#include "StateCache.h"
+
+#include "ResourceStateTracker.h"
+
+std::uint32_t StateCacheStats::TotalIssued()const
+{
+    std::uint32_t total = 0;
+    for (std::uint32_t n : Issued)
+        total += n;
+    return total;
+}
+
+std::uint32_t StateCacheStats::TotalElided()const
+{
+    std::uint32_t total = 0;
+    for (std::uint32_t n : Elided)
+        total += n;
+    return total;
+}
+
+StateCacheStats& StateCacheStats::operator+=(const StateCacheStats& rhs)
+{
+    for (int i = 0; i < (int)StateCall::Count; ++i)
+    {
+        Issued[i] += rhs.Issued[i];
+        Elided[i] += rhs.Elided[i];
+    }
+    return *this;
+}
+
+CommandStateCache::CommandStateCache(CommandSink* sink) :
+    mSink(sink)
+{
+}
+
+void CommandStateCache::Reset()
+{
+    mPipelineState = nullptr;
+    mRootSignature = nullptr;
+    mHeapCount = 0;
+    mHeapsKnown = false;
+    mVertexBufferMask = 0;
+    mIndexBufferKnown = false;
+    mTopologyKnown = false;
+    InvalidateRootArguments();
+}
+
+void CommandStateCache::SetPipelineState(void* pipelineState)
+{
+    if (Issue(StateCall::PipelineState, pipelineState != nullptr && pipelineState == mPipelineState))
+    {
+        mPipelineState = pipelineState;
+        mSink->SetPipelineState(pipelineState);
+    }
+}
+
+void CommandStateCache::SetGraphicsRootSignature(void* rootSignature)
+{
+    if (Issue(StateCall::RootSignature, rootSignature != nullptr && rootSignature == mRootSignature))
+    {
+        mRootSignature = rootSignature;
+        InvalidateRootArguments();
+        mSink->SetGraphicsRootSignature(rootSignature);
+    }
+}
+
+void CommandStateCache::SetDescriptorHeaps(std::uint32_t count, void* const* heaps)
+{
+    bool same = mHeapsKnown && count == mHeapCount && count <= 2;
+    for (std::uint32_t i = 0; same && i < count; ++i)
+        same = heaps[i] == mHeaps[i];
+
+    if (Issue(StateCall::DescriptorHeaps, same))
+    {
+        mHeapCount = count;
+        mHeapsKnown = count <= 2;
+        for (std::uint32_t i = 0; i < count && i < 2; ++i)
+            mHeaps[i] = heaps[i];
+
+        // Tables point into the old heaps.
+        for (auto& argument : mRootArguments)
+        {
+            if (argument.Kind == RootKind::DescriptorTable)
+                argument.Kind = RootKind::Unknown;
+        }
+        mSink->SetDescriptorHeaps(count, heaps);
+    }
+}
+
+void CommandStateCache::SetVertexBuffer(std::uint32_t slot, const VertexBufferBinding& view)
+{
+    const bool cached = slot < MaxVertexBuffers;
+    const bool same = cached && (mVertexBufferMask & (1u << slot)) != 0 && mVertexBuffers[slot] == view;
+
+    if (Issue(StateCall::VertexBuffer, same))
+    {
+        if (cached)
+        {
+            mVertexBuffers[slot] = view;
+            mVertexBufferMask |= 1u << slot;
+        }
+        mSink->SetVertexBuffer(slot, view);
+    }
+}
+
+void CommandStateCache::SetIndexBuffer(const IndexBufferBinding& view)
+{
+    if (Issue(StateCall::IndexBuffer, mIndexBufferKnown && mIndexBuffer == view))
+    {
+        mIndexBuffer = view;
+        mIndexBufferKnown = true;
+        mSink->SetIndexBuffer(view);
+    }
+}
+
+void CommandStateCache::SetPrimitiveTopology(std::uint32_t topology)
+{
+    if (Issue(StateCall::PrimitiveTopology, mTopologyKnown && mTopology == topology))
+    {
+        mTopology = topology;
+        mTopologyKnown = true;
+        mSink->SetPrimitiveTopology(topology);
+    }
+}
+
+void CommandStateCache::SetGraphicsRoot32BitConstant(std::uint32_t parameter, std::uint32_t value, std::uint32_t offset)
+{
+    const bool cached = parameter < MaxRootParameters && offset < MaxCachedRootConstants;
+    bool same = false;
+    if (cached)
+    {
+        const RootArgument& argument = mRootArguments[parameter];
+        same = (argument.ConstantMask & (1u << offset)) != 0 && argument.Constants[offset] == value;
+    }
+
+    if (Issue(StateCall::RootConstant, same))
+    {
+        if (cached)
+        {
+            RootArgument& argument = mRootArguments[parameter];
+            argument.Constants[offset] = value;
+            argument.ConstantMask |= 1u << offset;
+        }
+        mSink->SetGraphicsRoot32BitConstant(parameter, value, offset);
+    }
+}
+
+void CommandStateCache::SetGraphicsRootConstantBufferView(std::uint32_t parameter, std::uint64_t address)
+{
+    SetRootArgument(StateCall::RootConstantBufferView, RootKind::ConstantBufferView, parameter, address);
+}
+
+void CommandStateCache::SetGraphicsRootShaderResourceView(std::uint32_t parameter, std::uint64_t address)
+{
+    SetRootArgument(StateCall::RootShaderResourceView, RootKind::ShaderResourceView, parameter, address);
+}
+
+void CommandStateCache::SetGraphicsRootDescriptorTable(std::uint32_t parameter, std::uint64_t baseDescriptor)
+{
+    SetRootArgument(StateCall::RootDescriptorTable, RootKind::DescriptorTable, parameter, baseDescriptor);
+}
+
+void CommandStateCache::DrawIndexedInstanced(std::uint32_t indexCount, std::uint32_t instanceCount,
+    std::uint32_t startIndex, std::int32_t baseVertex, std::uint32_t startInstance)
+{
+    if (mTracker)
+        mTracker->Flush(*mSink);
+
+    Issue(StateCall::Draw, false);
+    mSink->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+bool CommandStateCache::Issue(StateCall call, bool redundant)
+{
+    if (redundant)
+    {
+        ++mStats.Elided[(int)call];
+        return false;
+    }
+
+    ++mStats.Issued[(int)call];
+    return true;
+}
+
+void CommandStateCache::InvalidateRootArguments()
+{
+    for (auto& argument : mRootArguments)
+    {
+        argument.Kind = RootKind::Unknown;
+        argument.ConstantMask = 0;
+    }
+}
+
+void CommandStateCache::SetRootArgument(StateCall call, RootKind kind, std::uint32_t parameter, std::uint64_t value)
+{
+    const bool cached = parameter < MaxRootParameters;
+    const bool same = cached && mRootArguments[parameter].Kind == kind && mRootArguments[parameter].Value == value;
+
+    if (Issue(call, same))
+    {
+        if (cached)
+        {
+            mRootArguments[parameter].Kind = kind;
+            mRootArguments[parameter].Value = value;
+        }
+
+        switch (kind)
+        {
+        case RootKind::ConstantBufferView: mSink->SetGraphicsRootConstantBufferView(parameter, value); break;
+        case RootKind::ShaderResourceView: mSink->SetGraphicsRootShaderResourceView(parameter, value); break;
+        default: mSink->SetGraphicsRootDescriptorTable(parameter, value); break;
+        }
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+
+struct ResourceBarrierDesc;
+class ResourceStateTracker;
+
+// API-neutral copies of the binding structs, so the cache and its tests do
+// not need the D3D12 headers.  Same members as the D3D12 views.
+struct VertexBufferBinding
+{
+    std::uint64_t BufferLocation = 0;
+    std::uint32_t SizeInBytes = 0;
+    std::uint32_t StrideInBytes = 0;
+
+    bool operator==(const VertexBufferBinding& rhs)const = default;
+};
+
+struct IndexBufferBinding
+{
+    std::uint64_t BufferLocation = 0;
+    std::uint32_t SizeInBytes = 0;
+    std::uint32_t Format = 0;
+
+    bool operator==(const IndexBufferBinding& rhs)const = default;
+};
+
+// The subset of ID3D12GraphicsCommandList the renderer records through.
+// Objects are passed as opaque pointers; D3D12CommandSink.h forwards them
+// to a real command list.
+class CommandSink
+{
+public:
+    virtual ~CommandSink() = default;
+
+    virtual void SetPipelineState(void* pipelineState) = 0;
+    virtual void SetGraphicsRootSignature(void* rootSignature) = 0;
+    virtual void SetDescriptorHeaps(std::uint32_t count, void* const* heaps) = 0;
+    virtual void SetVertexBuffer(std::uint32_t slot, const VertexBufferBinding& view) = 0;
+    virtual void SetIndexBuffer(const IndexBufferBinding& view) = 0;
+    virtual void SetPrimitiveTopology(std::uint32_t topology) = 0;
+    virtual void SetGraphicsRoot32BitConstant(std::uint32_t parameter, std::uint32_t value, std::uint32_t offset) = 0;
+    virtual void SetGraphicsRootConstantBufferView(std::uint32_t parameter, std::uint64_t address) = 0;
+    virtual void SetGraphicsRootShaderResourceView(std::uint32_t parameter, std::uint64_t address) = 0;
+    virtual void SetGraphicsRootDescriptorTable(std::uint32_t parameter, std::uint64_t baseDescriptor) = 0;
+    virtual void DrawIndexedInstanced(std::uint32_t indexCount, std::uint32_t instanceCount,
+        std::uint32_t startIndex, std::int32_t baseVertex, std::uint32_t startInstance) = 0;
+    virtual void ResourceBarrier(std::uint32_t count, const ResourceBarrierDesc* barriers) = 0;
+};
+
+enum class StateCall : int
+{
+    PipelineState = 0,
+    RootSignature,
+    DescriptorHeaps,
+    VertexBuffer,
+    IndexBuffer,
+    PrimitiveTopology,
+    RootConstant,
+    RootConstantBufferView,
+    RootShaderResourceView,
+    RootDescriptorTable,
+    Draw,
+    Count
+};
+
+struct StateCacheStats
+{
+    std::uint32_t Issued[(int)StateCall::Count] = {};
+    std::uint32_t Elided[(int)StateCall::Count] = {};
+
+    std::uint32_t TotalIssued()const;
+    std::uint32_t TotalElided()const;
+    StateCacheStats& operator+=(const StateCacheStats& rhs);
+};
+
+// Shadows what is bound on one command list and drops calls that would set
+// the same value again.  A new root signature makes every root argument
+// unknown and new descriptor heaps make the descriptor tables unknown, as
+// in D3D12.  Use one cache per command list and Reset it with the list.
+class CommandStateCache
+{
+public:
+    static constexpr std::uint32_t MaxRootParameters = 16;
+    static constexpr std::uint32_t MaxCachedRootConstants = 4;
+    static constexpr std::uint32_t MaxVertexBuffers = 4;
+
+    explicit CommandStateCache(CommandSink* sink);
+
+    // Barriers queued on tracker are flushed before every draw.
+    void SetStateTracker(ResourceStateTracker* tracker) { mTracker = tracker; }
+
+    // Forgets all bound state, call after resetting the command list or
+    // after recording through it directly.
+    void Reset();
+
+    void SetPipelineState(void* pipelineState);
+    void SetGraphicsRootSignature(void* rootSignature);
+    void SetDescriptorHeaps(std::uint32_t count, void* const* heaps);
+    void SetVertexBuffer(std::uint32_t slot, const VertexBufferBinding& view);
+    void SetIndexBuffer(const IndexBufferBinding& view);
+    void SetPrimitiveTopology(std::uint32_t topology);
+    void SetGraphicsRoot32BitConstant(std::uint32_t parameter, std::uint32_t value, std::uint32_t offset);
+    void SetGraphicsRootConstantBufferView(std::uint32_t parameter, std::uint64_t address);
+    void SetGraphicsRootShaderResourceView(std::uint32_t parameter, std::uint64_t address);
+    void SetGraphicsRootDescriptorTable(std::uint32_t parameter, std::uint64_t baseDescriptor);
+    void DrawIndexedInstanced(std::uint32_t indexCount, std::uint32_t instanceCount,
+        std::uint32_t startIndex, std::int32_t baseVertex, std::uint32_t startInstance);
+
+    const StateCacheStats& Stats()const { return mStats; }
+    void ResetStats() { mStats = StateCacheStats(); }
+
+private:
+    enum class RootKind : std::uint8_t
+    {
+        Unknown = 0,
+        ConstantBufferView,
+        ShaderResourceView,
+        DescriptorTable
+    };
+
+    struct RootArgument
+    {
+        RootKind Kind = RootKind::Unknown;
+        std::uint64_t Value = 0;
+
+        // One bit per cached 32-bit constant that is known.
+        std::uint32_t ConstantMask = 0;
+        std::uint32_t Constants[MaxCachedRootConstants] = {};
+    };
+
+    bool Issue(StateCall call, bool redundant);
+    void InvalidateRootArguments();
+    void SetRootArgument(StateCall call, RootKind kind, std::uint32_t parameter, std::uint64_t value);
+
+    CommandSink* mSink = nullptr;
+    ResourceStateTracker* mTracker = nullptr;
+
+    void* mPipelineState = nullptr;
+    void* mRootSignature = nullptr;
+    void* mHeaps[2] = {};
+    std::uint32_t mHeapCount = 0;
+    bool mHeapsKnown = false;
+
+    VertexBufferBinding mVertexBuffers[MaxVertexBuffers];
+    std::uint32_t mVertexBufferMask = 0;
+    IndexBufferBinding mIndexBuffer;
+    bool mIndexBufferKnown = false;
+    std::uint32_t mTopology = 0;
+    bool mTopologyKnown = false;
+
+    RootArgument mRootArguments[MaxRootParameters];
+
+    StateCacheStats mStats;
+};
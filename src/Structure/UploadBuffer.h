@@ -1,6 +1,7 @@
 #pragma once
 
 #include "d3dUtil.h"
+#include "LinearAllocator.h"
 
 template<typename T>
 class UploadBuffer
@@ -61,4 +62,46 @@ private:
 
     UINT mElementByteSize = 0;
     bool mIsConstantBuffer = false;
-};
\ No newline at end of file
+};
+
+// Backs LinearAllocator pages with persistently mapped upload heap buffers.
+class UploadPageProvider : public LinearPageProvider
+{
+public:
+    explicit UploadPageProvider(ID3D12Device* device) : mDevice(device)
+    {
+    }
+
+    LinearAllocPage CreatePage(std::uint64_t byteSize) override
+    {
+        Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+        ThrowIfFailed(mDevice->CreateCommittedResource(
+            get_rvalue_ptr(CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD)),
+            D3D12_HEAP_FLAG_NONE,
+            get_rvalue_ptr(CD3DX12_RESOURCE_DESC::Buffer(byteSize)),
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&resource)));
+
+        LinearAllocPage page;
+        ThrowIfFailed(resource->Map(0, nullptr, reinterpret_cast<void**>(&page.CpuAddress)));
+        page.GpuAddress = resource->GetGPUVirtualAddress();
+        page.Size = byteSize;
+        page.Handle = resource.Detach();
+        return page;
+    }
+
+    void DestroyPage(LinearAllocPage& page) override
+    {
+        auto resource = static_cast<ID3D12Resource*>(page.Handle);
+        if(resource != nullptr)
+        {
+            resource->Unmap(0, nullptr);
+            resource->Release();
+        }
+        page = {};
+    }
+
+private:
+    ID3D12Device* mDevice = nullptr;
+};
@@ -40,8 +40,9 @@ D3DApp::~D3DApp()
 	if(md3dDevice != nullptr)
 		FlushCommandQueue();
 	
-	for (UINT i = 0; i < SwapChainBufferCount; i++)
+	for (UINT i = 0; i < MaxSwapChainBufferCount; i++)
         if (mSwapChainBuffer[i]) { mSwapChainBuffer[i]->Release(); mSwapChainBuffer[i].Detach(); }
+	if (mFrameLatencyWaitableObject) { CloseHandle(mFrameLatencyWaitableObject); mFrameLatencyWaitableObject = nullptr; }
 	if (mSwapChain) { mSwapChain->SetFullscreenState(false, NULL); mSwapChain->Release(); mSwapChain.Detach(); }
     if(mDepthStencilBuffer){mDepthStencilBuffer->Release();mDepthStencilBuffer.Detach();}
    	if (mDirectCmdListAlloc) { mDirectCmdListAlloc->Release(); mDirectCmdListAlloc.Detach(); }
@@ -52,7 +53,6 @@ D3DApp::~D3DApp()
     if (mFence) { mFence->Release(); mFence.Detach(); }
 	 //if (md3dDevice) { md3dDevice->Release(); md3dDevice->Release(); }
 
-	m_msaaHelper->ReleaseDevice();
 	DestroyWindow(mhMainWnd);
     UnregisterClassW(L"MainWnd", mhAppInst);
 }
@@ -110,6 +110,7 @@ int D3DApp::Run()
 
 			if( !mAppPaused )
 			{
+				WaitForFrameLatency();
 				CalculateFrameStats();
 				Update(mTimer);	
                 Draw(mTimer);
@@ -146,8 +147,6 @@ void D3DApp::OnResize()
 	assert(mSwapChain);
     assert(mDirectCmdListAlloc);
 
-	//msaa交换链更改大小
-	m_msaaHelper->SizeResources(mClientWidth, mClientHeight);
 	// Flush before changing any resources.
 	FlushCommandQueue();
 
@@ -155,21 +154,21 @@ void D3DApp::OnResize()
 
 	
 	// Release the previous resources we will be recreating.
-	for (int i = 0; i < SwapChainBufferCount; ++i)
+	for (int i = 0; i < MaxSwapChainBufferCount; ++i)
 		mSwapChainBuffer[i].Reset();
     mDepthStencilBuffer.Reset();
 	
 	// Resize the swap chain.
     ThrowIfFailed(mSwapChain->ResizeBuffers(
-		SwapChainBufferCount, 
+		mSwapChainBufferCount, 
 		mClientWidth, mClientHeight, 
 		mBackBufferFormat, 
-		DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH));
+		DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH | DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT));
 
 	mCurrBackBuffer = 0;
  
 	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHeapHandle(mRtvHeap->GetCPUDescriptorHandleForHeapStart());
-	for (UINT i = 0; i < SwapChainBufferCount; i++)
+	for (UINT i = 0; i < mSwapChainBufferCount; i++)
 	{
 		ThrowIfFailed(mSwapChain->GetBuffer(i, IID_PPV_ARGS(&mSwapChainBuffer[i])));
 		md3dDevice->CreateRenderTargetView(mSwapChainBuffer[i].Get(), nullptr, rtvHeapHandle);
@@ -456,17 +455,6 @@ bool D3DApp::InitDirect3D()
 	CreateCommandObjects();
     CreateSwapChain();
     CreateRtvAndDsvDescriptorHeaps();
-
-	//创建MSAA
-	m_msaaHelper = std::make_unique<MSAAHelper>(
-    mBackBufferFormat,
-    mDepthStencilFormat,
-    4);
-
-	m_msaaHelper->SetClearColor(Colors::LightSteelBlue);
-	m_msaaHelper->SetDevice(md3dDevice.Get());
-	//设置rtv，dsv
-	m_msaaHelper->SizeResources(mClientWidth,mClientHeight);
 	return true;
 }
 
@@ -498,6 +486,7 @@ void D3DApp::CreateSwapChain()
 {
     // Release the previous swapchain we will be recreating.
     mSwapChain.Reset();
+    if (mFrameLatencyWaitableObject) { CloseHandle(mFrameLatencyWaitableObject); mFrameLatencyWaitableObject = nullptr; }
 
     DXGI_SWAP_CHAIN_DESC sd;
     sd.BufferDesc.Width = mClientWidth;
@@ -510,23 +499,49 @@ void D3DApp::CreateSwapChain()
     sd.SampleDesc.Count = 1;
     sd.SampleDesc.Quality = 0;
     sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    sd.BufferCount = SwapChainBufferCount;
+    sd.BufferCount = mSwapChainBufferCount;
     sd.OutputWindow = mhMainWnd;
     sd.Windowed = true;
 	sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-    sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+    // The waitable object lets the frame start wait for the display instead of Present.
+    sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH | DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 
 	// Note: Swap chain uses queue to perform flush.
+    Microsoft::WRL::ComPtr<IDXGISwapChain> swapChain;
     ThrowIfFailed(mdxgiFactory->CreateSwapChain(
 		mCommandQueue.Get(),
 		&sd, 
-		mSwapChain.GetAddressOf()));
-	
+		swapChain.GetAddressOf()));
+    ThrowIfFailed(swapChain.As(&mSwapChain));
+
+    ThrowIfFailed(mSwapChain->SetMaximumFrameLatency(mMaxFrameLatency));
+    mFrameLatencyWaitableObject = mSwapChain->GetFrameLatencyWaitableObject();
+}
+
+void D3DApp::SetSwapChainLatency(UINT bufferCount, UINT maxFrameLatency)
+{
+	assert(bufferCount >= 2 && bufferCount <= MaxSwapChainBufferCount);
+
+	mSwapChainBufferCount = bufferCount;
+	mMaxFrameLatency = maxFrameLatency;
+
+	// OnResize flushes the queue and recreates the buffers with the new count.
+	OnResize();
+	ThrowIfFailed(mSwapChain->SetMaximumFrameLatency(mMaxFrameLatency));
+}
+
+void D3DApp::WaitForFrameLatency()
+{
+	if (mFrameLatencyWaitableObject)
+	{
+		// Time out rather than hang if the window stopped presenting.
+		WaitForSingleObjectEx(mFrameLatencyWaitableObject, 1000, true);
+	}
 }
 void D3DApp::CreateRtvAndDsvDescriptorHeaps()
 {
     D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc;
-    rtvHeapDesc.NumDescriptors = SwapChainBufferCount;
+    rtvHeapDesc.NumDescriptors = MaxSwapChainBufferCount;
     rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
     rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 	rtvHeapDesc.NodeMask = 0;
@@ -7,7 +7,7 @@
 #include "d3dUtil.h"
 #include "Utility/GameTimer.h"
 #include "Component/Gui.h"
-#include "MSAAHelper.h"
+#include "FramePacing.h"
 class D3DApp
 {
 protected:
@@ -53,6 +53,12 @@ protected:
 
 	void FlushCommandQueue();
 
+	// Rebuilds the swap chain buffers for the given count and queue depth.
+	void SetSwapChainLatency(UINT bufferCount, UINT maxFrameLatency);
+	// Blocks until the swap chain can take another frame, called before
+	// input is read so the frame starts as late as possible.
+	void WaitForFrameLatency();
+
 	ID3D12Resource* CurrentBackBuffer()const;
 	D3D12_CPU_DESCRIPTOR_HANDLE CurrentBackBufferView()const;
 	D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView()const;
@@ -75,7 +81,6 @@ protected:
 	bool      mResizing = false;   // are the resize bars being dragged?
     bool      mFullscreenState = false;// fullscreen enabled
 
-    std::unique_ptr<MSAAHelper> m_msaaHelper;
 	// Set true to use 4X MSAA (?.1.8).  The default is false.
     bool      m4xMsaaState = false;    // 4X MSAA enabled
     UINT      m4xMsaaQuality = 0;      // quality level of 4X MSAA
@@ -84,7 +89,8 @@ protected:
 	GameTimer mTimer;
 	
     Microsoft::WRL::ComPtr<IDXGIFactory4> mdxgiFactory;
-    Microsoft::WRL::ComPtr<IDXGISwapChain> mSwapChain;
+    Microsoft::WRL::ComPtr<IDXGISwapChain2> mSwapChain;
+    HANDLE mFrameLatencyWaitableObject = nullptr;
     Microsoft::WRL::ComPtr<ID3D12Device> md3dDevice;
 
     Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
@@ -94,9 +100,12 @@ protected:
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mDirectCmdListAlloc;
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCommandList;
     //交换链个数为2，imgui有撕裂现象，来不及渲染完成就显示
-	static const int SwapChainBufferCount = 3;
+	//缓冲区个数由FramePacing决定，运行时可以修改
+	static const int MaxSwapChainBufferCount = FramePacing::MaxSwapChainBufferCount;
+	UINT mSwapChainBufferCount = 3;
+	UINT mMaxFrameLatency = 2;
 	int mCurrBackBuffer = 0;
-    Microsoft::WRL::ComPtr<ID3D12Resource> mSwapChainBuffer[SwapChainBufferCount];
+    Microsoft::WRL::ComPtr<ID3D12Resource> mSwapChainBuffer[MaxSwapChainBufferCount];
     Microsoft::WRL::ComPtr<ID3D12Resource> mDepthStencilBuffer;
 
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mRtvHeap;
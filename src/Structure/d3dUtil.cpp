@@ -1,10 +1,26 @@
 
 #include "d3dUtil.h"
+#include "ResourceStateTracker.h"
+#include "ShaderCache.h"
 #include <comdef.h>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+    UINT ShaderCompileFlags()
+    {
+#if defined(DEBUG) || defined(_DEBUG)  
+        return D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+        return 0;
+#endif
+    }
+}
+
 DxException::DxException(HRESULT hr, const std::wstring& functionName, const std::wstring& filename, int lineNumber) :
     ErrorCode(hr),
     FunctionName(functionName),
@@ -87,16 +103,74 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     return defaultBuffer;
 }
 
+Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
+    ID3D12Device* device,
+    ID3D12GraphicsCommandList* cmdList,
+    const void* initData,
+    UINT64 byteSize,
+    Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer,
+    ResourceStateTracker& tracker,
+    CommandSink& sink)
+{
+    ComPtr<ID3D12Resource> defaultBuffer;
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        get_rvalue_ptr(CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT)),
+        D3D12_HEAP_FLAG_NONE,
+        get_rvalue_ptr(CD3DX12_RESOURCE_DESC::Buffer(byteSize)),
+		D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        get_rvalue_ptr(CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD)),
+		D3D12_HEAP_FLAG_NONE,
+        get_rvalue_ptr(CD3DX12_RESOURCE_DESC::Buffer(byteSize)),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(uploadBuffer.GetAddressOf())));
+
+    D3D12_SUBRESOURCE_DATA subResourceData = {};
+    subResourceData.pData = initData;
+    subResourceData.RowPitch = byteSize;
+    subResourceData.SlicePitch = subResourceData.RowPitch;
+
+    // A buffer in Common is promoted to CopyDest by the copy and decays back
+    // to Common once the list has run, so the tracker records no barrier and
+    // the buffer needs no transition to a read state afterwards.
+    tracker.Global()->Register(defaultBuffer.Get(), 1, ResourceState::Common, true);
+    tracker.Transition(defaultBuffer.Get(), ResourceState::CopyDest);
+    tracker.Flush(sink);
+    UpdateSubresources<1>(cmdList, defaultBuffer.Get(), uploadBuffer.Get(), 0, 0, 1, &subResourceData);
+
+    return defaultBuffer;
+}
+
+void Texture::uploadTex(ID3D12Device* md3dDevice, ID3D12GraphicsCommandList* cmdList,
+    ResourceStateTracker& tracker, CommandSink& sink)
+{
+    createUploadHeap(md3dDevice);
+
+    // The DDS loader creates textures as copy destinations.
+    tracker.Global()->Register(Resource.Get(), static_cast<UINT>(subresources.size()), ResourceState::CopyDest, false);
+    tracker.Transition(Resource.Get(), ResourceState::CopyDest);
+    tracker.Flush(sink);
+
+    UpdateSubresources(cmdList, Resource.Get(), UploadHeap.Get(),
+        0, 0, static_cast<UINT>(subresources.size()), subresources.data());
+
+    // Nothing samples it before the list ends; the following copies can
+    // overlap the transition.
+    tracker.BeginTransition(Resource.Get(), ResourceState::PixelShaderResource);
+}
+
 ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	const std::wstring& filename,
 	const D3D_SHADER_MACRO* defines,
 	const std::string& entrypoint,
 	const std::string& target)
 {
-	UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)  
-	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
+	UINT compileFlags = ShaderCompileFlags();
 
 	HRESULT hr = S_OK;
 
@@ -113,6 +187,57 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	return byteCode;
 }
 
+ComPtr<ID3DBlob> d3dUtil::CompileShaderCached(
+	const std::wstring& filename,
+	const D3D_SHADER_MACRO* defines,
+	const std::string& entrypoint,
+	const std::string& target,
+	const std::string& cacheDir)
+{
+	const std::string path = std::filesystem::path(filename).generic_string();
+
+	// Without the expanded source there is no key; the plain compile
+	// reports what is missing.
+	ShaderSource source;
+	std::string error;
+	if(!ShaderCache::ExpandIncludes(path, source, error))
+	{
+		OutputDebugStringA((error + "\n").c_str());
+		return CompileShader(filename, defines, entrypoint, target);
+	}
+
+	std::vector<ShaderDefine> defineList;
+	for(const D3D_SHADER_MACRO* define = defines; define != nullptr && define->Name != nullptr; ++define)
+		defineList.push_back({ define->Name, define->Definition != nullptr ? define->Definition : "" });
+
+	const UINT compileFlags = ShaderCompileFlags();
+	const std::string cachePath = ShaderCache::CachePath(cacheDir,
+		ShaderCache::Key(source, defineList, entrypoint, target, compileFlags));
+
+	// A damaged file fails the DXBC check and is compiled over.
+	std::error_code ec;
+	if(std::filesystem::file_size(cachePath, ec) >= 4 && !ec)
+	{
+		ComPtr<ID3DBlob> cached = LoadBinary(std::filesystem::path(cachePath).wstring());
+		if(std::memcmp(cached->GetBufferPointer(), "DXBC", 4) == 0)
+			return cached;
+	}
+
+	// Includes are already pasted in, so no include handler.
+	ComPtr<ID3DBlob> byteCode = nullptr;
+	ComPtr<ID3DBlob> errors;
+	HRESULT hr = D3DCompile(source.Text.data(), source.Text.size(), path.c_str(), defines, nullptr,
+		entrypoint.c_str(), target.c_str(), compileFlags, 0, &byteCode, &errors);
+
+	if(errors != nullptr)
+		OutputDebugStringA((char*)errors->GetBufferPointer());
+
+	ThrowIfFailed(hr);
+
+	ShaderCache::WriteFile(cachePath, byteCode->GetBufferPointer(), byteCode->GetBufferSize());
+	return byteCode;
+}
+
 std::wstring DxException::ToString()const
 {
     // Get the string description of the error code.
@@ -30,7 +30,9 @@
 #include "Metalib.h"
 #include "Utility/DDSTextureLoader12.h"
 #include <iostream>
-extern const int gNumFrameResources;
+
+class CommandSink;
+class ResourceStateTracker;
 
 #ifndef ReleaseCom
 #define ReleaseCom(x) { if(x){ x->Release(); x = 0; } }
@@ -127,11 +129,32 @@ public:
         UINT64 byteSize,
         Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
 
+    // Same, with the buffer registered in the tracker's global states and
+    // its transitions going through tracker.  Barriers are recorded via sink.
+    static Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
+        ID3D12Device* device,
+        ID3D12GraphicsCommandList* cmdList,
+        const void* initData,
+        UINT64 byteSize,
+        Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer,
+        ResourceStateTracker& tracker,
+        CommandSink& sink);
+
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
 		const std::string& entrypoint,
 		const std::string& target);
+
+	// Same, but first looks in cacheDir for bytecode built from the same
+	// expanded source, defines, entry point and target (see ShaderCache),
+	// and stores anything it had to compile there.
+	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShaderCached(
+		const std::wstring& filename,
+		const D3D_SHADER_MACRO* defines,
+		const std::string& entrypoint,
+		const std::string& target,
+		const std::string& cacheDir = "shader/cache");
 };
 
 class DxException
@@ -179,6 +202,13 @@ struct MeshGeometry
 	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferUploader = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferUploader = nullptr;
 
+	// Baked ambient occlusion, one R8_UNORM per vertex in its own stream.
+	// Optional; for meshes without it DrawBatches binds a shared stream that
+	// reads as fully open.
+	Microsoft::WRL::ComPtr<ID3D12Resource> OcclusionBufferGPU = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> OcclusionBufferUploader = nullptr;
+	UINT OcclusionBufferByteSize = 0;
+
     // Data about the buffers.
 	UINT VertexByteStride = 0;
 	UINT VertexBufferByteSize = 0;
@@ -210,11 +240,22 @@ struct MeshGeometry
 		return ibv;
 	}
 
+	D3D12_VERTEX_BUFFER_VIEW OcclusionBufferView()const
+	{
+		D3D12_VERTEX_BUFFER_VIEW vbv;
+		vbv.BufferLocation = OcclusionBufferGPU->GetGPUVirtualAddress();
+		vbv.StrideInBytes = sizeof(std::uint8_t);
+		vbv.SizeInBytes = OcclusionBufferByteSize;
+
+		return vbv;
+	}
+
 	// We can free this memory after we finish upload to the GPU.
 	void DisposeUploaders()
 	{
 		VertexBufferUploader = nullptr;
 		IndexBufferUploader = nullptr;
+		OcclusionBufferUploader = nullptr;
 	}
 };
 
@@ -230,6 +271,11 @@ struct Light
 
 #define MaxLights 16
 
+// Directional lights that cast shadows and the cascades each has, the
+// same numbers as in Common.hlsl.
+#define MaxShadowLights 3
+#define ShadowCascadeCount 3
+
 
 // Simple struct to represent a material for our demos.  A production 3D engine
 // would likely create a class hierarchy of Materials.
@@ -247,11 +293,9 @@ struct Material
 	// Index into SRV heap for normal texture.
 	int NormalSrvHeapIndex = -1;
 
-	// Dirty flag indicating the material has changed and we need to update the constant buffer.
-	// Because we have a material constant buffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify a material we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
+	// There is a material buffer in each FrameResource, so changes have to be
+	// reported to the owner's DirtyTracker with MatCBIndex as the slot for
+	// every frame resource to pick them up.
 
 	// Material constant buffer data used for shading.
 	DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
@@ -288,9 +332,8 @@ public:
         ThrowIfFailed(DirectX::LoadDDSTextureFromFile(md3dDevice, Filename.c_str(), Resource.ReleaseAndGetAddressOf(), ddsData, subresources));
     }
 
-    void uploadTex(ID3D12Device* md3dDevice, ID3D12GraphicsCommandList* cmdList)
+    void createUploadHeap(ID3D12Device* md3dDevice)
     {
-        //upload texture
         const UINT64 uploadBufferSize = GetRequiredIntermediateSize(Resource.Get(), 0,
             static_cast<UINT>(subresources.size()));
 
@@ -307,6 +350,18 @@ public:
                 D3D12_RESOURCE_STATE_GENERIC_READ,
                 nullptr,
                 IID_PPV_ARGS(UploadHeap.GetAddressOf())));
+    }
+
+    // Tracked upload: registers the texture with the tracker's global
+    // states and leaves it in a split transition to pixel shader resource,
+    // finished when the tracker is closed.
+    void uploadTex(ID3D12Device* md3dDevice, ID3D12GraphicsCommandList* cmdList,
+        ResourceStateTracker& tracker, CommandSink& sink);
+
+    void uploadTex(ID3D12Device* md3dDevice, ID3D12GraphicsCommandList* cmdList)
+    {
+        //upload texture
+        createUploadHeap(md3dDevice);
 
         UpdateSubresources(cmdList, Resource.Get(), UploadHeap.Get(),
             0, 0, static_cast<UINT>(subresources.size()), subresources.data());
@@ -0,0 +1,247 @@
+#include "AoBaker.h"
+
+#include "TempFile.h"
+#include "ThreadPool.h"
+#include "TriangleBvh.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+    constexpr float Pi = 3.14159265358979f;
+
+    // Vertices handed to a worker at a time.
+    constexpr std::uint32_t GrainSize = 64;
+
+    constexpr std::uint32_t Magic = 0x314f4143;    // 'CAO1'
+
+    struct FileHeader
+    {
+        std::uint32_t Magic;
+        std::uint32_t Count;
+        Hash128 Key;
+    };
+
+    float RadicalInverse(std::uint32_t bits)
+    {
+        bits = (bits << 16) | (bits >> 16);
+        bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+        bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+        bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+        bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+        return (float)bits * 2.3283064365386963e-10f;
+    }
+
+    // Rotation of a vertex's sample pattern around its normal, so
+    // neighbouring vertices do not all miss the same gaps.
+    float VertexRotation(std::uint32_t vertex)
+    {
+        std::uint32_t h = vertex * 0x9E3779B9u;
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        return (float)(h >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Frame around the normal; false for a zero normal.
+    bool Frame(const Float3& normal, Float3& n, Float3& tangentX, Float3& tangentY)
+    {
+        const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (!(length > 0.0f))
+            return false;
+        n = { normal.x / length, normal.y / length, normal.z / length };
+
+        const Float3 up = std::fabs(n.z) < 0.999f ? Float3{ 0.0f, 0.0f, 1.0f } : Float3{ 1.0f, 0.0f, 0.0f };
+        const Float3 x = { up.y * n.z - up.z * n.y, up.z * n.x - up.x * n.z, up.x * n.y - up.y * n.x };
+        const float xLength = std::sqrt(x.x * x.x + x.y * x.y + x.z * x.z);
+        tangentX = { x.x / xLength, x.y / xLength, x.z / xLength };
+        tangentY = { n.y * tangentX.z - n.z * tangentX.y, n.z * tangentX.x - n.x * tangentX.z, n.x * tangentX.y - n.y * tangentX.x };
+        return true;
+    }
+
+    // Ray i of a vertex, cosine distributed over the hemisphere.
+    Float3 RayDirection(std::uint32_t i, std::uint32_t count, float rotation, const Float3& n, const Float3& tx, const Float3& ty)
+    {
+        float turn = (float)i / (float)count + rotation;
+        turn -= std::floor(turn);
+        const float xi = RadicalInverse(i);
+        const float r = std::sqrt(xi);
+        const float phi = 2.0f * Pi * turn;
+        const float lx = r * std::cos(phi), ly = r * std::sin(phi), lz = std::sqrt(std::max(1.0f - xi, 0.0f));
+        return { tx.x * lx + ty.x * ly + n.x * lz, tx.y * lx + ty.y * ly + n.y * lz, tx.z * lx + ty.z * ly + n.z * lz };
+    }
+
+    std::uint8_t Quantize(float visibility)
+    {
+        return (std::uint8_t)std::lround(std::clamp(visibility, 0.0f, 1.0f) * 255.0f);
+    }
+}
+
+void AoBaker::RayExtents(const Float3* positions, std::uint32_t vertexCount, const Settings& settings, float& maxDistance, float& bias)
+{
+    constexpr float Infinity = std::numeric_limits<float>::infinity();
+    Float3 min = { Infinity, Infinity, Infinity }, max = { -Infinity, -Infinity, -Infinity };
+    for (std::uint32_t i = 0; i < vertexCount; ++i)
+    {
+        min = { std::min(min.x, positions[i].x), std::min(min.y, positions[i].y), std::min(min.z, positions[i].z) };
+        max = { std::max(max.x, positions[i].x), std::max(max.y, positions[i].y), std::max(max.z, positions[i].z) };
+    }
+    const float dx = max.x - min.x, dy = max.y - min.y, dz = max.z - min.z;
+    const float diagonal = vertexCount > 0 ? std::sqrt(dx * dx + dy * dy + dz * dz) : 0.0f;
+    maxDistance = diagonal * settings.MaxDistance;
+    bias = diagonal * settings.Bias;
+}
+
+float AoBaker::BakeVertex(const TriangleBvh& bvh, const Float3& position, const Float3& normal, std::uint32_t vertex,
+    float maxDistance, float bias, const Settings& settings)
+{
+    Float3 n, tx, ty;
+    if (!Frame(normal, n, tx, ty) || settings.RayCount == 0)
+        return 1.0f;
+
+    const Float3 origin = { position.x + n.x * bias, position.y + n.y * bias, position.z + n.z * bias };
+    const float rotation = VertexRotation(vertex);
+    std::uint32_t open = 0;
+    for (std::uint32_t i = 0; i < settings.RayCount; ++i)
+    {
+        if (!bvh.Occluded(origin, RayDirection(i, settings.RayCount, rotation, n, tx, ty), maxDistance))
+            ++open;
+    }
+    return (float)open / (float)settings.RayCount;
+}
+
+std::vector<std::uint8_t> AoBaker::Bake(const TriangleBvh& bvh, const Float3* positions, const Float3* normals,
+    std::uint32_t vertexCount, const Settings& settings, ThreadPool* pool, Stats* stats)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    float maxDistance, bias;
+    RayExtents(positions, vertexCount, settings, maxDistance, bias);
+
+    std::vector<std::uint8_t> occlusion(vertexCount, 255);
+    auto bakeRange = [&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+    {
+        TriangleBvh::RayPacket packet;
+        std::fill_n(packet.TMax, 8, maxDistance);
+        for (std::uint32_t vertex = begin; vertex < end; ++vertex)
+        {
+            Float3 n, tx, ty;
+            if (!Frame(normals[vertex], n, tx, ty) || settings.RayCount == 0)
+                continue;
+
+            const Float3& p = positions[vertex];
+            std::fill_n(packet.OriginX, 8, p.x + n.x * bias);
+            std::fill_n(packet.OriginY, 8, p.y + n.y * bias);
+            std::fill_n(packet.OriginZ, 8, p.z + n.z * bias);
+
+            // Rays of one vertex share an origin and a hemisphere, so a
+            // packet of them mostly visits the same nodes.
+            const float rotation = VertexRotation(vertex);
+            std::uint32_t blocked = 0;
+            for (std::uint32_t i = 0; i < settings.RayCount; i += 8)
+            {
+                const std::uint32_t lanes = std::min(8u, settings.RayCount - i);
+                for (std::uint32_t lane = 0; lane < lanes; ++lane)
+                {
+                    const Float3 d = RayDirection(i + lane, settings.RayCount, rotation, n, tx, ty);
+                    packet.DirX[lane] = d.x;
+                    packet.DirY[lane] = d.y;
+                    packet.DirZ[lane] = d.z;
+                }
+                blocked += (std::uint32_t)std::popcount(bvh.Occluded(packet, (1u << lanes) - 1));
+            }
+            occlusion[vertex] = Quantize((float)(settings.RayCount - blocked) / (float)settings.RayCount);
+        }
+    };
+
+    if (pool == nullptr)
+        bakeRange(0, vertexCount, 0);
+    else
+        pool->ParallelForRange(vertexCount, GrainSize, bakeRange);
+
+    if (stats != nullptr)
+    {
+        std::uint64_t rays = 0;
+        for (std::uint32_t i = 0; i < vertexCount; ++i)
+        {
+            const Float3& n = normals[i];
+            if (n.x != 0.0f || n.y != 0.0f || n.z != 0.0f)
+                rays += settings.RayCount;
+        }
+        stats->Rays = rays;
+        stats->Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return occlusion;
+}
+
+Hash128 AoBaker::Key(const Float3* positions, const Float3* normals, std::uint32_t vertexCount,
+    const std::uint32_t* indices, std::uint32_t indexCount, const Settings& settings)
+{
+    StableHasher hasher;
+    hasher.AddString("Vertex AO 1");
+    hasher.Add(settings.RayCount);
+    hasher.AddBytes(&settings.MaxDistance, sizeof(float));
+    hasher.AddBytes(&settings.Bias, sizeof(float));
+    hasher.Add(vertexCount);
+    hasher.AddBytes(positions, vertexCount * sizeof(Float3));
+    hasher.AddBytes(normals, vertexCount * sizeof(Float3));
+    hasher.Add(indexCount);
+    hasher.AddBytes(indices, indexCount * sizeof(std::uint32_t));
+    return hasher.Finish();
+}
+
+bool AoBaker::Save(const std::string& path, const Hash128& key, const std::vector<std::uint8_t>& occlusion)
+{
+    std::error_code ec;
+    const std::filesystem::path target(path);
+    if (target.has_parent_path())
+        std::filesystem::create_directories(target.parent_path(), ec);
+
+    const std::string temp = TempFile::UniquePath(path);
+    {
+        std::ofstream fout(temp, std::ios::binary | std::ios::trunc);
+        if (!fout)
+            return false;
+
+        const FileHeader header = { Magic, (std::uint32_t)occlusion.size(), key };
+        fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        fout.write(reinterpret_cast<const char*>(occlusion.data()), (std::streamsize)occlusion.size());
+        if (!fout)
+            return false;
+    }
+
+    std::filesystem::rename(temp, target, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+bool AoBaker::Load(const std::string& path, const Hash128& key, std::vector<std::uint8_t>& occlusion)
+{
+    std::ifstream fin(path, std::ios::binary);
+    if (!fin)
+        return false;
+
+    FileHeader header = {};
+    fin.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!fin || header.Magic != Magic || !(header.Key == key))
+        return false;
+
+    occlusion.resize(header.Count);
+    fin.read(reinterpret_cast<char*>(occlusion.data()), (std::streamsize)occlusion.size());
+    if (!fin)
+    {
+        occlusion.clear();
+        return false;
+    }
+    return true;
+}
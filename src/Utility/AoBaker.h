@@ -0,0 +1,56 @@
+#pragma once
+
+#include "SimdMath.h"
+#include "StableHash.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+class TriangleBvh;
+
+// Ambient occlusion baked per vertex: the share of cosine weighted rays
+// from a vertex around its normal that leave the mesh, one byte each.
+// Rays go out in packets of eight through TriangleBvh, vertices are
+// spread over the thread pool.
+namespace AoBaker
+{
+    struct Settings
+    {
+        std::uint32_t RayCount = 64;
+        // Ray length and the offset of ray origins off the surface, as
+        // fractions of the diagonal of the mesh's box.
+        float MaxDistance = 0.25f;
+        float Bias = 1e-4f;
+    };
+
+    struct Stats
+    {
+        std::uint64_t Rays = 0;
+        double Seconds = 0.0;
+
+        double RaysPerSecond()const { return Seconds > 0.0 ? Rays / Seconds : 0.0; }
+    };
+
+    // 255 for a vertex nothing occludes.  Vertices with a zero normal are
+    // left unoccluded.  pool may be null.
+    std::vector<std::uint8_t> Bake(const TriangleBvh& bvh, const Float3* positions, const Float3* normals,
+        std::uint32_t vertexCount, const Settings& settings, ThreadPool* pool, Stats* stats = nullptr);
+
+    // Unoccluded fraction of one vertex with one ray at a time, the
+    // reference for Bake.
+    float BakeVertex(const TriangleBvh& bvh, const Float3& position, const Float3& normal, std::uint32_t vertex,
+        float maxDistance, float bias, const Settings& settings);
+
+    // Absolute ray length and bias for a mesh, from the fractions in settings.
+    void RayExtents(const Float3* positions, std::uint32_t vertexCount, const Settings& settings, float& maxDistance, float& bias);
+
+    // Cache key of the bake of a mesh with settings.
+    Hash128 Key(const Float3* positions, const Float3* normals, std::uint32_t vertexCount,
+        const std::uint32_t* indices, std::uint32_t indexCount, const Settings& settings);
+
+    // A bake on disk, tagged with its key; Load fails if the key differs.
+    bool Save(const std::string& path, const Hash128& key, const std::vector<std::uint8_t>& occlusion);
+    bool Load(const std::string& path, const Hash128& key, std::vector<std::uint8_t>& occlusion);
+}
@@ -0,0 +1,125 @@
+#include "ContributionCull.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr float Pi = 3.14159265358979f;
+}
+
+ContributionLens ContributionCull::MakeLens(const Float3& eye, float fovY, float nearZ, float viewportHeight)
+{
+    ContributionLens lens;
+    lens.Eye = eye;
+    lens.PixelScale = 0.5f * viewportHeight / std::tan(0.5f * fovY);
+    lens.NearZ = nearZ;
+    return lens;
+}
+
+float ContributionCull::ProjectedArea(const ContributionLens& lens, const Float3& center, const Float3& extents)
+{
+    // A sphere of radius r at distance d spans tan(angle) = r / sqrt(d^2 - r^2)
+    // from its center, so its disc covers pi * (scale * r)^2 / (d^2 - r^2).
+    const float dx = center.x - lens.Eye.x, dy = center.y - lens.Eye.y, dz = center.z - lens.Eye.z;
+    const float radiusSq = extents.x * extents.x + extents.y * extents.y + extents.z * extents.z;
+    const float distanceSq = dx * dx + dy * dy + dz * dz;
+    const float scaledSq = (Pi * lens.PixelScale * lens.PixelScale) * radiusSq;
+    return scaledSq / std::max(distanceSq - radiusSq, lens.NearZ * lens.NearZ);
+}
+
+void ContributionCull::ProjectedAreaRangeScalar(const ContributionLens& lens, const BoundsSoA& bounds,
+    std::uint32_t begin, std::uint32_t end, float* out)
+{
+    for (std::uint32_t i = begin; i < end; ++i)
+        out[i - begin] = ProjectedArea(lens, bounds.Center(i), bounds.Extents(i));
+}
+
+void ContributionCull::ProjectedAreaRange(const ContributionLens& lens, const BoundsSoA& bounds,
+    std::uint32_t begin, std::uint32_t end, float* out)
+{
+#if defined(__AVX2__)
+    const __m256 eyeX = _mm256_set1_ps(lens.Eye.x);
+    const __m256 eyeY = _mm256_set1_ps(lens.Eye.y);
+    const __m256 eyeZ = _mm256_set1_ps(lens.Eye.z);
+    const __m256 scale = _mm256_set1_ps(Pi * lens.PixelScale * lens.PixelScale);
+    const __m256 nearSq = _mm256_set1_ps(lens.NearZ * lens.NearZ);
+
+    // Loads past end stay inside the padding, the store of the last step
+    // is masked to the boxes asked for.
+    for (std::uint32_t i = begin; i < end; i += 8)
+    {
+        const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(bounds.CenterX() + i), eyeX);
+        const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(bounds.CenterY() + i), eyeY);
+        const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(bounds.CenterZ() + i), eyeZ);
+        const __m256 ex = _mm256_loadu_ps(bounds.ExtentX() + i);
+        const __m256 ey = _mm256_loadu_ps(bounds.ExtentY() + i);
+        const __m256 ez = _mm256_loadu_ps(bounds.ExtentZ() + i);
+
+        const __m256 radiusSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)), _mm256_mul_ps(ez, ez));
+        const __m256 distanceSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        const __m256 area = _mm256_div_ps(_mm256_mul_ps(scale, radiusSq),
+            _mm256_max_ps(_mm256_sub_ps(distanceSq, radiusSq), nearSq));
+
+        if (end - i >= 8)
+            _mm256_storeu_ps(out + (i - begin), area);
+        else
+        {
+            const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(end - i)), lane);
+            _mm256_maskstore_ps(out + (i - begin), mask, area);
+        }
+    }
+#else
+    ProjectedAreaRangeScalar(lens, bounds, begin, end, out);
+#endif
+}
+
+void ContributionCuller::Cull(const ContributionLens& lens, const BoundsSoA& bounds, const Settings& settings, ThreadPool* pool,
+    std::vector<std::uint32_t>& visible, std::vector<std::uint32_t>& culled)
+{
+    const std::uint32_t count = bounds.Count();
+    if (mCulled.size() != count)
+        mCulled.assign(count, 0);
+    mAreas.resize(count);
+    mFades.resize(count);
+
+    const float minArea = settings.MinPixelArea;
+    const float returnArea = minArea * (1.0f + settings.Hysteresis);
+    const float fadeRange = settings.FadePixelArea - minArea;
+
+    auto cullRange = [&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+    {
+        ContributionCull::ProjectedAreaRange(lens, bounds, begin, end, mAreas.data() + begin);
+        for (std::uint32_t i = begin; i < end; ++i)
+        {
+            const float area = mAreas[i];
+            mCulled[i] = mCulled[i] ? area < returnArea : area < minArea;
+            if (mCulled[i])
+                mFades[i] = 0.0f;
+            else
+                mFades[i] = fadeRange > 0.0f ? std::clamp((area - minArea) / fadeRange, 0.0f, 1.0f) : 1.0f;
+        }
+    };
+
+    if (pool == nullptr)
+        cullRange(0, count, 0);
+    else
+        pool->ParallelForRange(count, GrainSize, cullRange);
+
+    std::size_t kept = 0;
+    for (std::size_t v = 0; v < visible.size(); ++v)
+    {
+        if (mCulled[visible[v]])
+            culled.push_back(visible[v]);
+        else
+            visible[kept++] = visible[v];
+    }
+    visible.resize(kept);
+}
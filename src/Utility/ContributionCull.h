@@ -0,0 +1,77 @@
+#pragma once
+
+#include "FrustumCull.h"
+#include "SimdMath.h"
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// What the contribution test needs of the camera: the eye, pixels per unit
+// of tan(angle) off the view axis, and the near plane.
+struct ContributionLens
+{
+    Float3 Eye;
+    float PixelScale = 1.0f;
+    float NearZ = 1.0f;
+};
+
+namespace ContributionCull
+{
+    // Lens of a perspective camera with vertical field of view fovY
+    // (radians) drawing viewportHeight pixels high.
+    ContributionLens MakeLens(const Float3& eye, float fovY, float nearZ, float viewportHeight);
+
+    // Screen area in pixels of the bounding sphere of a box (center,
+    // extents), as if it were in the middle of the screen.  The distance to
+    // the sphere's silhouette is clamped to the near plane, so an eye inside
+    // the sphere gives a large area rather than a negative one.
+    float ProjectedArea(const ContributionLens& lens, const Float3& center, const Float3& extents);
+
+    // ProjectedArea of the boxes [begin, end) to out[0, end - begin).
+    // Eight boxes per step with AVX2, so as for FrustumCull::CullRange begin
+    // has to be a multiple of eight.
+    void ProjectedAreaRange(const ContributionLens& lens, const BoundsSoA& bounds,
+        std::uint32_t begin, std::uint32_t end, float* out);
+
+    // Same with the scalar test, the reference for ProjectedAreaRange.
+    void ProjectedAreaRangeScalar(const ContributionLens& lens, const BoundsSoA& bounds,
+        std::uint32_t begin, std::uint32_t end, float* out);
+}
+
+// Drops items too small on screen to matter.  An item fades out as its area
+// shrinks from FadePixelArea to MinPixelArea and is culled below that; once
+// culled it only comes back above MinPixelArea * (1 + Hysteresis), so an
+// item sitting on the threshold does not flicker.  The culled state is
+// kept per item of one BoundsSoA, an item count change starts over.
+class ContributionCuller
+{
+public:
+    static constexpr std::uint32_t GrainSize = 1024;
+
+    struct Settings
+    {
+        // 0 turns culling off.
+        float MinPixelArea = 0.0f;
+        // Items smaller than this fade toward MinPixelArea.  At or under
+        // MinPixelArea items stay opaque until they are culled.
+        float FadePixelArea = 0.0f;
+        float Hysteresis = 0.25f;
+    };
+
+    // Updates the state of every box in bounds, then removes the culled
+    // items from visible, in place and keeping the order, and appends them
+    // to culled.  pool may be null.
+    void Cull(const ContributionLens& lens, const BoundsSoA& bounds, const Settings& settings, ThreadPool* pool,
+        std::vector<std::uint32_t>& visible, std::vector<std::uint32_t>& culled);
+
+    // Opacity of item after the last Cull, 0 for a culled item.
+    float Fade(std::uint32_t item)const { return mFades[item]; }
+    bool IsCulled(std::uint32_t item)const { return mCulled[item] != 0; }
+
+private:
+    std::vector<float> mAreas;
+    std::vector<float> mFades;
+    std::vector<std::uint8_t> mCulled;
+};
@@ -0,0 +1,533 @@
+#include "CubeMapImage.h"
+
+#include "TempFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    float SrgbToLinear(float c)
+    {
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    struct ByteTables
+    {
+        float Unorm[256];
+        float Srgb[256];
+
+        ByteTables()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                Unorm[i] = (float)i / 255.0f;
+                Srgb[i] = SrgbToLinear(Unorm[i]);
+            }
+        }
+    };
+
+    const ByteTables& Tables()
+    {
+        static const ByteTables tables;
+        return tables;
+    }
+
+    float HalfToFloat(std::uint16_t h)
+    {
+        const std::uint32_t sign = (std::uint32_t)(h & 0x8000) << 16;
+        const std::uint32_t exponent = (h >> 10) & 0x1f;
+        std::uint32_t mantissa = h & 0x3ff;
+
+        std::uint32_t bits;
+        if (exponent == 0x1f)
+        {
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        }
+        else if (exponent != 0)
+        {
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        }
+        else if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // Denormal, normalized for float.
+            std::uint32_t e = 113;
+            while ((mantissa & 0x400) == 0)
+            {
+                mantissa <<= 1;
+                --e;
+            }
+            bits = sign | (e << 23) | ((mantissa & 0x3ff) << 13);
+        }
+
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    // Rounds to nearest even, overflows to infinity (Giesen).
+    std::uint16_t FloatToHalf(float value)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        const std::uint32_t sign = bits & 0x80000000u;
+        bits ^= sign;
+
+        std::uint16_t h;
+        if (bits >= (143u << 23))
+        {
+            h = bits > (255u << 23) ? 0x7e00 : 0x7c00;
+        }
+        else if (bits < (113u << 23))
+        {
+            // Lands in the half denormals; adding the magic number lets the
+            // float adder do the rounding.
+            const std::uint32_t magicBits = 126u << 23;
+            float magic, f;
+            std::memcpy(&magic, &magicBits, sizeof(magic));
+            std::memcpy(&f, &bits, sizeof(f));
+            f += magic;
+            std::memcpy(&bits, &f, sizeof(bits));
+            h = (std::uint16_t)(bits - magicBits);
+        }
+        else
+        {
+            const std::uint32_t mantissaOdd = (bits >> 13) & 1;
+            bits -= 112u << 23;
+            bits += 0xfff + mantissaOdd;
+            h = (std::uint16_t)(bits >> 13);
+        }
+        return (std::uint16_t)(h | (sign >> 16));
+    }
+
+    // DDS header words SaveDds writes, after the magic number.
+    constexpr std::uint32_t FourCC(char a, char b, char c, char d)
+    {
+        return (std::uint32_t)(std::uint8_t)a | ((std::uint32_t)(std::uint8_t)b << 8) |
+            ((std::uint32_t)(std::uint8_t)c << 16) | ((std::uint32_t)(std::uint8_t)d << 24);
+    }
+    constexpr std::uint32_t DdsMagic = FourCC('D', 'D', 'S', ' ');
+    constexpr std::uint32_t DdsHeaderWords = 31;
+    constexpr std::uint32_t Dx10HeaderWords = 5;
+    // Index of the key in the header, in its reserved words, and a tag
+    // after it that says the key is there.
+    constexpr std::uint32_t KeyWord = 7;
+    constexpr std::uint32_t KeyTagWord = 11;
+    constexpr std::uint32_t KeyTag = FourCC('C', 'K', 'E', 'Y');
+
+    bool IsSrgb(std::uint32_t format)
+    {
+        switch (format)
+        {
+        case CubeMapImage::R8G8B8A8UnormSrgb:
+        case CubeMapImage::BC1UnormSrgb:
+        case CubeMapImage::BC2UnormSrgb:
+        case CubeMapImage::BC3UnormSrgb:
+        case CubeMapImage::B8G8R8A8UnormSrgb:
+        case CubeMapImage::B8G8R8X8UnormSrgb:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Colors of a BC1 color block, which BC2 and BC3 share after their
+    // alpha.  Only BC1 has the three color mode with black.
+    void DecodeColorBlock(const std::uint8_t* block, bool allowThreeColor, bool srgb, float rgb[16][3])
+    {
+        const std::uint16_t c0 = (std::uint16_t)(block[0] | (block[1] << 8));
+        const std::uint16_t c1 = (std::uint16_t)(block[2] | (block[3] << 8));
+
+        float palette[4][3];
+        const std::uint16_t endpoints[2] = { c0, c1 };
+        for (int i = 0; i < 2; ++i)
+        {
+            palette[i][0] = (float)((endpoints[i] >> 11) & 0x1f) / 31.0f;
+            palette[i][1] = (float)((endpoints[i] >> 5) & 0x3f) / 63.0f;
+            palette[i][2] = (float)(endpoints[i] & 0x1f) / 31.0f;
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            if (c0 > c1 || !allowThreeColor)
+            {
+                palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+                palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+            }
+            else
+            {
+                palette[2][c] = 0.5f * (palette[0][c] + palette[1][c]);
+                palette[3][c] = 0.0f;
+            }
+        }
+        if (srgb)
+        {
+            for (auto& color : palette)
+            {
+                for (float& c : color)
+                    c = SrgbToLinear(c);
+            }
+        }
+
+        const std::uint32_t indices = (std::uint32_t)block[4] | ((std::uint32_t)block[5] << 8) |
+            ((std::uint32_t)block[6] << 16) | ((std::uint32_t)block[7] << 24);
+        for (int i = 0; i < 16; ++i)
+        {
+            const float* color = palette[(indices >> (2 * i)) & 3];
+            rgb[i][0] = color[0];
+            rgb[i][1] = color[1];
+            rgb[i][2] = color[2];
+        }
+    }
+}
+
+void CubeMapImage::Resize(std::uint32_t size)
+{
+    mSize = size;
+    for (Face& face : mFaces)
+    {
+        face.R.assign((std::size_t)size * size, 0.0f);
+        face.G.assign((std::size_t)size * size, 0.0f);
+        face.B.assign((std::size_t)size * size, 0.0f);
+    }
+}
+
+bool CubeMapImage::IsSupported(std::uint32_t format)
+{
+    switch (format)
+    {
+    case R32G32B32A32Float:
+    case R16G16B16A16Float:
+    case R8G8B8A8Unorm:
+    case R8G8B8A8UnormSrgb:
+    case BC1Unorm:
+    case BC1UnormSrgb:
+    case BC2Unorm:
+    case BC2UnormSrgb:
+    case BC3Unorm:
+    case BC3UnormSrgb:
+    case B8G8R8A8Unorm:
+    case B8G8R8X8Unorm:
+    case B8G8R8A8UnormSrgb:
+    case B8G8R8X8UnormSrgb:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool CubeMapImage::DecodeFace(std::uint32_t face, std::uint32_t format, const void* data, std::size_t rowPitch)
+{
+    if (!IsSupported(format))
+        return false;
+
+    Face& out = mFaces[face];
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+    const std::uint32_t size = mSize;
+    const bool srgb = IsSrgb(format);
+
+    switch (format)
+    {
+    case R32G32B32A32Float:
+        for (std::uint32_t y = 0; y < size; ++y)
+        {
+            const std::uint8_t* row = bytes + y * rowPitch;
+            for (std::uint32_t x = 0; x < size; ++x)
+            {
+                float texel[4];
+                std::memcpy(texel, row + x * sizeof(texel), sizeof(texel));
+                const std::size_t i = (std::size_t)y * size + x;
+                out.R[i] = texel[0];
+                out.G[i] = texel[1];
+                out.B[i] = texel[2];
+            }
+        }
+        return true;
+
+    case R16G16B16A16Float:
+        for (std::uint32_t y = 0; y < size; ++y)
+        {
+            const std::uint8_t* row = bytes + y * rowPitch;
+            for (std::uint32_t x = 0; x < size; ++x)
+            {
+                std::uint16_t texel[4];
+                std::memcpy(texel, row + x * sizeof(texel), sizeof(texel));
+                const std::size_t i = (std::size_t)y * size + x;
+                out.R[i] = HalfToFloat(texel[0]);
+                out.G[i] = HalfToFloat(texel[1]);
+                out.B[i] = HalfToFloat(texel[2]);
+            }
+        }
+        return true;
+
+    case R8G8B8A8Unorm:
+    case R8G8B8A8UnormSrgb:
+    case B8G8R8A8Unorm:
+    case B8G8R8X8Unorm:
+    case B8G8R8A8UnormSrgb:
+    case B8G8R8X8UnormSrgb:
+    {
+        const float* table = srgb ? Tables().Srgb : Tables().Unorm;
+        const bool bgr = format != R8G8B8A8Unorm && format != R8G8B8A8UnormSrgb;
+        for (std::uint32_t y = 0; y < size; ++y)
+        {
+            const std::uint8_t* row = bytes + y * rowPitch;
+            for (std::uint32_t x = 0; x < size; ++x)
+            {
+                const std::uint8_t* texel = row + 4 * x;
+                const std::size_t i = (std::size_t)y * size + x;
+                out.R[i] = table[texel[bgr ? 2 : 0]];
+                out.G[i] = table[texel[1]];
+                out.B[i] = table[texel[bgr ? 0 : 2]];
+            }
+        }
+        return true;
+    }
+
+    default:
+    {
+        // BC1 blocks are 8 bytes; BC2 and BC3 put 8 bytes of alpha first.
+        const bool bc1 = format == BC1Unorm || format == BC1UnormSrgb;
+        const std::size_t blockBytes = bc1 ? 8 : 16;
+        const std::size_t colorOffset = bc1 ? 0 : 8;
+        const std::uint32_t blocks = (size + 3) / 4;
+        for (std::uint32_t by = 0; by < blocks; ++by)
+        {
+            const std::uint8_t* row = bytes + by * rowPitch;
+            for (std::uint32_t bx = 0; bx < blocks; ++bx)
+            {
+                float rgb[16][3];
+                DecodeColorBlock(row + bx * blockBytes + colorOffset, bc1, srgb, rgb);
+                for (std::uint32_t py = 0; py < 4; ++py)
+                {
+                    for (std::uint32_t px = 0; px < 4; ++px)
+                    {
+                        const std::uint32_t x = bx * 4 + px, y = by * 4 + py;
+                        if (x >= size || y >= size)
+                            continue;
+                        const std::size_t i = (std::size_t)y * size + x;
+                        out.R[i] = rgb[py * 4 + px][0];
+                        out.G[i] = rgb[py * 4 + px][1];
+                        out.B[i] = rgb[py * 4 + px][2];
+                    }
+                }
+            }
+        }
+        return true;
+    }
+    }
+}
+
+const CubeMapImage::FaceBasis& CubeMapImage::Basis(std::uint32_t face)
+{
+    static const FaceBasis bases[6] =
+    {
+        { { 0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+        { { 0.0f, 0.0f, 1.0f }, { 0.0f, -1.0f, 0.0f }, { -1.0f, 0.0f, 0.0f } },
+        { { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+        { { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f, 0.0f } },
+        { { 1.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+        { { -1.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } },
+    };
+    return bases[face];
+}
+
+Float3 CubeMapImage::Direction(std::uint32_t face, float u, float v)
+{
+    const FaceBasis& b = Basis(face);
+    return { b.U.x * u + b.V.x * v + b.Normal.x, b.U.y * u + b.V.y * v + b.Normal.y, b.U.z * u + b.V.z * v + b.Normal.z };
+}
+
+void CubeMapImage::FaceCoordinates(const Float3& dir, std::uint32_t& face, float& u, float& v)
+{
+    const float ax = std::fabs(dir.x), ay = std::fabs(dir.y), az = std::fabs(dir.z);
+    if (ax >= ay && ax >= az)
+    {
+        face = dir.x > 0.0f ? 0 : 1;
+        u = (dir.x > 0.0f ? -dir.z : dir.z) / ax;
+        v = -dir.y / ax;
+    }
+    else if (ay >= az)
+    {
+        face = dir.y > 0.0f ? 2 : 3;
+        u = dir.x / ay;
+        v = (dir.y > 0.0f ? dir.z : -dir.z) / ay;
+    }
+    else
+    {
+        face = dir.z > 0.0f ? 4 : 5;
+        u = (dir.z > 0.0f ? dir.x : -dir.x) / az;
+        v = -dir.y / az;
+    }
+}
+
+Float3 CubeMapImage::Sample(std::uint32_t face, float u, float v)const
+{
+    const float s = (u + 1.0f) * 0.5f * (float)mSize - 0.5f;
+    const float t = (v + 1.0f) * 0.5f * (float)mSize - 0.5f;
+    const float fs = std::floor(s), ft = std::floor(t);
+    const float wx = s - fs, wy = t - ft;
+
+    const int last = (int)mSize - 1;
+    const int x0 = std::clamp((int)fs, 0, last), x1 = std::clamp((int)fs + 1, 0, last);
+    const int y0 = std::clamp((int)ft, 0, last), y1 = std::clamp((int)ft + 1, 0, last);
+    const std::size_t i00 = (std::size_t)y0 * mSize + x0, i01 = (std::size_t)y0 * mSize + x1;
+    const std::size_t i10 = (std::size_t)y1 * mSize + x0, i11 = (std::size_t)y1 * mSize + x1;
+
+    const Face& f = mFaces[face];
+    auto filter = [&](const std::vector<float>& c)
+    {
+        const float top = c[i00] + (c[i01] - c[i00]) * wx;
+        const float bottom = c[i10] + (c[i11] - c[i10]) * wx;
+        return top + (bottom - top) * wy;
+    };
+    return { filter(f.R), filter(f.G), filter(f.B) };
+}
+
+Float3 CubeMapImage::Sample(const Float3& dir)const
+{
+    std::uint32_t face;
+    float u, v;
+    FaceCoordinates(dir, face, u, v);
+    return Sample(face, u, v);
+}
+
+CubeMapImage CubeMapImage::Downsample()const
+{
+    if (mSize <= 1)
+        return *this;
+
+    CubeMapImage half(mSize / 2);
+    const std::uint32_t size = half.mSize;
+    for (std::uint32_t face = 0; face < 6; ++face)
+    {
+        const Face& from = mFaces[face];
+        Face& to = half.mFaces[face];
+        for (std::uint32_t y = 0; y < size; ++y)
+        {
+            for (std::uint32_t x = 0; x < size; ++x)
+            {
+                const std::size_t i = (std::size_t)(2 * y) * mSize + 2 * x;
+                const std::size_t j = i + mSize;
+                const std::size_t o = (std::size_t)y * size + x;
+                to.R[o] = 0.25f * (from.R[i] + from.R[i + 1] + from.R[j] + from.R[j + 1]);
+                to.G[o] = 0.25f * (from.G[i] + from.G[i + 1] + from.G[j] + from.G[j + 1]);
+                to.B[o] = 0.25f * (from.B[i] + from.B[i + 1] + from.B[j] + from.B[j + 1]);
+            }
+        }
+    }
+    return half;
+}
+
+std::vector<CubeMapImage> CubeMapImage::MipChain()const
+{
+    std::vector<CubeMapImage> chain;
+    chain.push_back(*this);
+    while (chain.back().Size() > 1)
+        chain.push_back(chain.back().Downsample());
+    return chain;
+}
+
+bool CubeMapImage::SaveDds(const std::string& path, const std::vector<CubeMapImage>& mips, const Hash128& key)
+{
+    if (mips.empty() || mips[0].Size() == 0)
+        return false;
+
+    std::uint32_t header[DdsHeaderWords] = {};
+    header[0] = 124;
+    header[1] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x20000;    // caps, height, width, pitch, pixel format, mip count
+    header[2] = mips[0].Size();
+    header[3] = mips[0].Size();
+    header[4] = mips[0].Size() * 8;
+    header[6] = (std::uint32_t)mips.size();
+    header[KeyWord + 0] = (std::uint32_t)key.Lo;
+    header[KeyWord + 1] = (std::uint32_t)(key.Lo >> 32);
+    header[KeyWord + 2] = (std::uint32_t)key.Hi;
+    header[KeyWord + 3] = (std::uint32_t)(key.Hi >> 32);
+    header[KeyTagWord] = KeyTag;
+    header[18] = 32;                                         // pixel format size
+    header[19] = 0x4;                                        // four cc
+    header[20] = FourCC('D', 'X', '1', '0');
+    header[26] = 0x8 | 0x1000 | 0x400000;                    // complex, texture, mip map
+    header[27] = 0x200 | 0xfc00;                             // cube map with all six faces
+
+    // R16G16B16A16_FLOAT, 2D, texture cube, one cube.
+    const std::uint32_t dx10[Dx10HeaderWords] = { R16G16B16A16Float, 3, 0x4, 1, 0 };
+
+    std::error_code ec;
+    const std::filesystem::path target(path);
+    if (target.has_parent_path())
+        std::filesystem::create_directories(target.parent_path(), ec);
+
+    const std::string temp = TempFile::UniquePath(path);
+    {
+        std::ofstream fout(temp, std::ios::binary | std::ios::trunc);
+        if (!fout)
+            return false;
+
+        fout.write(reinterpret_cast<const char*>(&DdsMagic), sizeof(DdsMagic));
+        fout.write(reinterpret_cast<const char*>(header), sizeof(header));
+        fout.write(reinterpret_cast<const char*>(dx10), sizeof(dx10));
+
+        // Face by face, every face with all its mips.
+        std::vector<std::uint16_t> row;
+        for (std::uint32_t face = 0; face < 6; ++face)
+        {
+            for (const CubeMapImage& mip : mips)
+            {
+                const Face& f = mip.mFaces[face];
+                const std::uint32_t size = mip.mSize;
+                row.resize(4 * (std::size_t)size);
+                for (std::uint32_t y = 0; y < size; ++y)
+                {
+                    for (std::uint32_t x = 0; x < size; ++x)
+                    {
+                        const std::size_t i = (std::size_t)y * size + x;
+                        row[4 * x + 0] = FloatToHalf(f.R[i]);
+                        row[4 * x + 1] = FloatToHalf(f.G[i]);
+                        row[4 * x + 2] = FloatToHalf(f.B[i]);
+                        row[4 * x + 3] = FloatToHalf(1.0f);
+                    }
+                    fout.write(reinterpret_cast<const char*>(row.data()), (std::streamsize)(row.size() * sizeof(std::uint16_t)));
+                }
+            }
+        }
+        if (!fout)
+            return false;
+    }
+
+    std::filesystem::rename(temp, target, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+bool CubeMapImage::ReadDdsKey(const std::string& path, Hash128& key)
+{
+    std::ifstream fin(path, std::ios::binary);
+    if (!fin)
+        return false;
+
+    std::uint32_t magic = 0;
+    std::uint32_t header[DdsHeaderWords] = {};
+    std::uint32_t dx10[Dx10HeaderWords] = {};
+    fin.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    fin.read(reinterpret_cast<char*>(header), sizeof(header));
+    fin.read(reinterpret_cast<char*>(dx10), sizeof(dx10));
+    if (!fin || magic != DdsMagic || header[0] != 124 || header[KeyTagWord] != KeyTag ||
+        header[20] != FourCC('D', 'X', '1', '0') || dx10[0] != R16G16B16A16Float)
+        return false;
+
+    key.Lo = (std::uint64_t)header[KeyWord + 0] | ((std::uint64_t)header[KeyWord + 1] << 32);
+    key.Hi = (std::uint64_t)header[KeyWord + 2] | ((std::uint64_t)header[KeyWord + 3] << 32);
+    return true;
+}
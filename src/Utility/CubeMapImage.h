@@ -0,0 +1,90 @@
+#pragma once
+
+#include "SimdMath.h"
+#include "StableHash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Linear RGB texels of the six faces of a square cube map, one float plane
+// per channel so rows can be read eight texels at a time.  Faces are in
+// D3D order +X, -X, +Y, -Y, +Z, -Z and rows go from the top of a face.
+class CubeMapImage
+{
+public:
+    // The DXGI_FORMAT values DecodeFace understands, spelled out so this
+    // file builds without the Windows headers.  UNORM texels are taken as
+    // they are, like the sampler returns them; SRGB ones are linearized.
+    enum Format : std::uint32_t
+    {
+        R32G32B32A32Float = 2,
+        R16G16B16A16Float = 10,
+        R8G8B8A8Unorm = 28,
+        R8G8B8A8UnormSrgb = 29,
+        BC1Unorm = 71,
+        BC1UnormSrgb = 72,
+        BC2Unorm = 74,
+        BC2UnormSrgb = 75,
+        BC3Unorm = 77,
+        BC3UnormSrgb = 78,
+        B8G8R8A8Unorm = 87,
+        B8G8R8X8Unorm = 88,
+        B8G8R8A8UnormSrgb = 91,
+        B8G8R8X8UnormSrgb = 93,
+    };
+
+    struct Face
+    {
+        std::vector<float> R, G, B;
+    };
+
+    explicit CubeMapImage(std::uint32_t size = 0) { Resize(size); }
+
+    void Resize(std::uint32_t size);
+    std::uint32_t Size()const { return mSize; }
+
+    Face& GetFace(std::uint32_t face) { return mFaces[face]; }
+    const Face& GetFace(std::uint32_t face)const { return mFaces[face]; }
+
+    static bool IsSupported(std::uint32_t format);
+
+    // Decodes one Size() x Size() face of the given DXGI format; rowPitch
+    // is the distance between rows, of 4x4 blocks for the BC formats, as
+    // in D3D12_SUBRESOURCE_DATA.  False if the format is not supported.
+    bool DecodeFace(std::uint32_t face, std::uint32_t format, const void* data, std::size_t rowPitch);
+
+    // Direction, not normalized, through the point (u, v) of a face, both
+    // in [-1, 1] with v down: dir = U * u + V * v + Normal.
+    struct FaceBasis
+    {
+        Float3 U, V, Normal;
+    };
+    static const FaceBasis& Basis(std::uint32_t face);
+    static Float3 Direction(std::uint32_t face, float u, float v);
+    // The face a direction, which need not be normalized, points into and
+    // where on it, the inverse of Direction.
+    static void FaceCoordinates(const Float3& dir, std::uint32_t& face, float& u, float& v);
+
+    // Bilinear lookup on one face; texels past its edges are clamped
+    // instead of taken from the neighbouring face.
+    Float3 Sample(std::uint32_t face, float u, float v)const;
+    Float3 Sample(const Float3& dir)const;
+
+    // Half the size, every texel the mean of four.
+    CubeMapImage Downsample()const;
+    // This image and its downsampled copies down to 1 x 1.
+    std::vector<CubeMapImage> MipChain()const;
+
+    // Writes mips, largest first, as an R16G16B16A16_FLOAT cube map DDS the
+    // DDS loader reads.  key is kept in reserved header words, so a cache
+    // can tell what the file was made from, see ReadDdsKey.
+    static bool SaveDds(const std::string& path, const std::vector<CubeMapImage>& mips, const Hash128& key);
+    // The key SaveDds wrote; false if path is missing or not such a file.
+    static bool ReadDdsKey(const std::string& path, Hash128& key);
+
+private:
+    std::uint32_t mSize = 0;
+    Face mFaces[6];
+};
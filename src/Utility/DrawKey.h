@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// 64-bit sort keys for draw packets, compared as plain integers.
+//
+// Opaque:      layer:4 | rootSig:4 | pso:10 | material:14 | mesh:16 | depth:16
+// Transparent: layer:4 | ~depth:16 | rootSig:4 | pso:10 | material:14 | mesh:16
+//
+// Opaque keys group by state first, which decides how many state changes
+// and batches there are, and go front to back inside a group.  Transparent
+// keys must blend in order, so far to near comes right after the layer.
+namespace DrawKey
+{
+    constexpr int LayerBits = 4;
+    constexpr int RootSignatureBits = 4;
+    constexpr int PipelineStateBits = 10;
+    constexpr int MaterialBits = 14;
+    constexpr int MeshBits = 16;
+    constexpr int DepthBits = 16;
+
+    constexpr std::uint64_t Field(std::uint64_t value, int bits)
+    {
+        return value & ((1ull << bits) - 1);
+    }
+
+    // Maps view depth to 16 bits on a log scale, so precision follows the
+    // depth buffer's and near objects are ordered more finely.
+    inline std::uint32_t QuantizeDepth(float viewDepth, float nearZ, float farZ)
+    {
+        if (viewDepth <= nearZ)
+            return 0;
+        if (viewDepth >= farZ)
+            return (1u << DepthBits) - 1;
+
+        const float t = std::log2(viewDepth / nearZ) / std::log2(farZ / nearZ);
+        return (std::uint32_t)(t * float((1u << DepthBits) - 1));
+    }
+
+    inline std::uint64_t MakeOpaque(std::uint32_t layer, std::uint32_t rootSignature, std::uint32_t pipelineState,
+        std::uint32_t material, std::uint32_t mesh, std::uint32_t depth)
+    {
+        std::uint64_t key = Field(layer, LayerBits);
+        key = (key << RootSignatureBits) | Field(rootSignature, RootSignatureBits);
+        key = (key << PipelineStateBits) | Field(pipelineState, PipelineStateBits);
+        key = (key << MaterialBits) | Field(material, MaterialBits);
+        key = (key << MeshBits) | Field(mesh, MeshBits);
+        key = (key << DepthBits) | Field(depth, DepthBits);
+        return key;
+    }
+
+    inline std::uint64_t MakeTransparent(std::uint32_t layer, std::uint32_t rootSignature, std::uint32_t pipelineState,
+        std::uint32_t material, std::uint32_t mesh, std::uint32_t depth)
+    {
+        std::uint64_t key = Field(layer, LayerBits);
+        key = (key << DepthBits) | Field(~depth, DepthBits);
+        key = (key << RootSignatureBits) | Field(rootSignature, RootSignatureBits);
+        key = (key << PipelineStateBits) | Field(pipelineState, PipelineStateBits);
+        key = (key << MaterialBits) | Field(material, MaterialBits);
+        key = (key << MeshBits) | Field(mesh, MeshBits);
+        return key;
+    }
+
+    constexpr std::uint32_t Layer(std::uint64_t key)
+    {
+        return std::uint32_t(key >> (64 - LayerBits));
+    }
+
+    // Small id for a mesh, the pointer and submesh offset folded to MeshBits.
+    // Equal meshes always get equal ids; different ones rarely collide and
+    // then only interleave in the order, batching still compares exactly.
+    inline std::uint32_t MeshId(const void* geometry, std::uint32_t startIndexLocation)
+    {
+        std::uint64_t h = reinterpret_cast<std::uintptr_t>(geometry) ^ (std::uint64_t(startIndexLocation) << 32);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return std::uint32_t(h);
+    }
+}
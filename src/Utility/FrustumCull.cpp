@@ -0,0 +1,182 @@
+#include "FrustumCull.h"
+
+#include "ThreadPool.h"
+
+#include <bit>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+void BoundsSoA::Resize(std::uint32_t count)
+{
+    mCount = count;
+    const std::size_t padded = (count + 7) & ~7u;
+    for (auto* v : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+        v->resize(padded, 0.0f);
+}
+
+void BoundsSoA::Set(std::uint32_t i, const Float3& center, const Float3& extents)
+{
+    mCenterX[i] = center.x;
+    mCenterY[i] = center.y;
+    mCenterZ[i] = center.z;
+    mExtentX[i] = extents.x;
+    mExtentY[i] = extents.y;
+    mExtentZ[i] = extents.z;
+}
+
+Frustum FrustumCull::ExtractFrustum(const Float4x4& viewProj)
+{
+    // Clip coordinate j of a row vector is its dot product with column j.
+    auto column = [&](int j) { return Float4{ viewProj.m[0][j], viewProj.m[1][j], viewProj.m[2][j], viewProj.m[3][j] }; };
+    auto add = [](const Float4& a, const Float4& b) { return Float4{ a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w }; };
+    auto sub = [](const Float4& a, const Float4& b) { return Float4{ a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w }; };
+
+    const Float4 x = column(0), y = column(1), z = column(2), w = column(3);
+
+    Frustum f;
+    f.Planes[0] = add(w, x);
+    f.Planes[1] = sub(w, x);
+    f.Planes[2] = add(w, y);
+    f.Planes[3] = sub(w, y);
+    f.Planes[4] = z;
+    f.Planes[5] = sub(w, z);
+
+    for (Float4& p : f.Planes)
+    {
+        const float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+        const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        p = { p.x * scale, p.y * scale, p.z * scale, p.w * scale };
+    }
+    return f;
+}
+
+void FrustumCull::TransformBox(const Float3& center, const Float3& extents, const Float4x4& world,
+    Float3& worldCenter, Float3& worldExtents)
+{
+    // Arvo: the new extents are the local extents through |world|.
+    const float c[3] = { center.x, center.y, center.z };
+    const float e[3] = { extents.x, extents.y, extents.z };
+    float oc[3], oe[3];
+    for (int j = 0; j < 3; ++j)
+    {
+        oc[j] = world.m[3][j];
+        oe[j] = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            oc[j] += c[i] * world.m[i][j];
+            oe[j] += e[i] * std::fabs(world.m[i][j]);
+        }
+    }
+    worldCenter = { oc[0], oc[1], oc[2] };
+    worldExtents = { oe[0], oe[1], oe[2] };
+}
+
+bool FrustumCull::IsVisible(const Frustum& frustum, const Float3& center, const Float3& extents)
+{
+    for (const Float4& p : frustum.Planes)
+    {
+        const float distance = center.x * p.x + center.y * p.y + center.z * p.z + p.w;
+        const float radius = extents.x * std::fabs(p.x) + extents.y * std::fabs(p.y) + extents.z * std::fabs(p.z);
+        if (!(distance + radius >= 0.0f))
+            return false;
+    }
+    return true;
+}
+
+std::uint32_t FrustumCull::CullRangeScalar(const Frustum& frustum, const BoundsSoA& bounds,
+    std::uint32_t begin, std::uint32_t end, std::uint32_t* out)
+{
+    std::uint32_t count = 0;
+    for (std::uint32_t i = begin; i < end; ++i)
+    {
+        if (IsVisible(frustum, bounds.Center(i), bounds.Extents(i)))
+            out[count++] = i;
+    }
+    return count;
+}
+
+std::uint32_t FrustumCull::CullRange(const Frustum& frustum, const BoundsSoA& bounds,
+    std::uint32_t begin, std::uint32_t end, std::uint32_t* out)
+{
+#if defined(__AVX2__)
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    __m256 absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        const Float4& plane = frustum.Planes[p];
+        planeX[p] = _mm256_set1_ps(plane.x);
+        planeY[p] = _mm256_set1_ps(plane.y);
+        planeZ[p] = _mm256_set1_ps(plane.z);
+        planeW[p] = _mm256_set1_ps(plane.w);
+        absX[p] = _mm256_set1_ps(std::fabs(plane.x));
+        absY[p] = _mm256_set1_ps(std::fabs(plane.y));
+        absZ[p] = _mm256_set1_ps(std::fabs(plane.z));
+    }
+
+    // Loads past end stay inside the padding, the lanes are masked off.
+    std::uint32_t count = 0;
+    for (std::uint32_t i = begin; i < end; i += 8)
+    {
+        const __m256 cx = _mm256_loadu_ps(bounds.CenterX() + i);
+        const __m256 cy = _mm256_loadu_ps(bounds.CenterY() + i);
+        const __m256 cz = _mm256_loadu_ps(bounds.CenterZ() + i);
+        const __m256 ex = _mm256_loadu_ps(bounds.ExtentX() + i);
+        const __m256 ey = _mm256_loadu_ps(bounds.ExtentY() + i);
+        const __m256 ez = _mm256_loadu_ps(bounds.ExtentZ() + i);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, planeX[p]), _mm256_mul_ps(cy, planeY[p])),
+                _mm256_add_ps(_mm256_mul_ps(cz, planeZ[p]), planeW[p]));
+            __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, absX[p]), _mm256_mul_ps(ey, absY[p])),
+                _mm256_mul_ps(ez, absZ[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        std::uint32_t mask = (std::uint32_t)_mm256_movemask_ps(inside);
+        if (end - i < 8)
+            mask &= (1u << (end - i)) - 1;
+
+        for (; mask != 0; mask &= mask - 1)
+            out[count++] = i + (std::uint32_t)std::countr_zero(mask);
+    }
+    return count;
+#else
+    return CullRangeScalar(frustum, bounds, begin, end, out);
+#endif
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, const BoundsSoA& bounds, ThreadPool* pool, std::vector<std::uint32_t>& visible)
+{
+    const std::uint32_t count = bounds.Count();
+    const std::uint32_t rangeCount = (count + GrainSize - 1) / GrainSize;
+
+    visible.resize(count);
+    if (pool == nullptr || rangeCount <= 1)
+    {
+        visible.resize(FrustumCull::CullRange(frustum, bounds, 0, count, visible.data()));
+        return;
+    }
+
+    mScratch.resize(count);
+    mRangeCounts.resize(rangeCount);
+    pool->ParallelFor(rangeCount, [&](std::uint32_t range, std::uint32_t)
+    {
+        const std::uint32_t begin = range * GrainSize;
+        const std::uint32_t end = begin + GrainSize < count ? begin + GrainSize : count;
+        mRangeCounts[range] = FrustumCull::CullRange(frustum, bounds, begin, end, mScratch.data() + begin);
+    });
+
+    std::uint32_t total = 0;
+    for (std::uint32_t range = 0; range < rangeCount; ++range)
+    {
+        const std::uint32_t* src = mScratch.data() + range * GrainSize;
+        for (std::uint32_t k = 0; k < mRangeCounts[range]; ++k)
+            visible[total++] = src[k];
+    }
+    visible.resize(total);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "SimdMath.h"
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Six planes (x, y, z, w) with the normal pointing inside, so a point p is
+// inside a plane when dot(p, xyz) + w >= 0.  Order: left, right, bottom,
+// top, near, far.
+struct Frustum
+{
+    Float4 Planes[6];
+};
+
+// World space axis aligned boxes as centers and half extents, structure of
+// arrays so eight boxes load with one instruction per component.  Storage
+// is padded to a multiple of eight.
+class BoundsSoA
+{
+public:
+    void Resize(std::uint32_t count);
+    std::uint32_t Count()const { return mCount; }
+
+    void Set(std::uint32_t i, const Float3& center, const Float3& extents);
+    Float3 Center(std::uint32_t i)const { return { mCenterX[i], mCenterY[i], mCenterZ[i] }; }
+    Float3 Extents(std::uint32_t i)const { return { mExtentX[i], mExtentY[i], mExtentZ[i] }; }
+
+    const float* CenterX()const { return mCenterX.data(); }
+    const float* CenterY()const { return mCenterY.data(); }
+    const float* CenterZ()const { return mCenterZ.data(); }
+    const float* ExtentX()const { return mExtentX.data(); }
+    const float* ExtentY()const { return mExtentY.data(); }
+    const float* ExtentZ()const { return mExtentZ.data(); }
+
+private:
+    std::uint32_t mCount = 0;
+    std::vector<float> mCenterX, mCenterY, mCenterZ;
+    std::vector<float> mExtentX, mExtentY, mExtentZ;
+};
+
+namespace FrustumCull
+{
+    // Planes of a row-vector view * projection matrix with D3D clip space
+    // (0 <= z <= w), normalized.
+    Frustum ExtractFrustum(const Float4x4& viewProj);
+
+    // Box around the local box (center, extents) after world, which is a
+    // row-vector affine matrix.
+    void TransformBox(const Float3& center, const Float3& extents, const Float4x4& world,
+        Float3& worldCenter, Float3& worldExtents);
+
+    // A box is culled when it lies entirely outside one plane.  Boxes near
+    // the frustum corners can pass without touching it, a box touching the
+    // frustum is never culled.
+    bool IsVisible(const Frustum& frustum, const Float3& center, const Float3& extents);
+
+    // Writes the indices in [begin, end) of the visible boxes to out, in
+    // increasing order, and returns how many.  out needs room for
+    // end - begin indices.  Eight boxes per step with AVX2, so begin has to
+    // be a multiple of eight for the last step to stay inside the padding.
+    std::uint32_t CullRange(const Frustum& frustum, const BoundsSoA& bounds,
+        std::uint32_t begin, std::uint32_t end, std::uint32_t* out);
+
+    // Same with the scalar test, the reference for CullRange.
+    std::uint32_t CullRangeScalar(const Frustum& frustum, const BoundsSoA& bounds,
+        std::uint32_t begin, std::uint32_t end, std::uint32_t* out);
+}
+
+// Culls a whole BoundsSoA on a thread pool.  Every range of GrainSize
+// boxes compacts into its own slice of a scratch list; the slices are then
+// joined, so the visible list comes out in index order.
+class FrustumCuller
+{
+public:
+    static constexpr std::uint32_t GrainSize = 1024;
+
+    // pool may be null to cull on the calling thread.
+    void Cull(const Frustum& frustum, const BoundsSoA& bounds, ThreadPool* pool, std::vector<std::uint32_t>& visible);
+
+private:
+    std::vector<std::uint32_t> mScratch;
+    std::vector<std::uint32_t> mRangeCounts;
+};
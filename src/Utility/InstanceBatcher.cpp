@@ -0,0 +1,121 @@
+#include "InstanceBatcher.h"
+
+namespace
+{
+    std::uint64_t Mix(std::uint64_t h, std::uint64_t v)
+    {
+        h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        return h;
+    }
+
+    std::uint64_t HashItem(const BatchItem& item)
+    {
+        std::uint64_t h = reinterpret_cast<std::uintptr_t>(item.Geometry);
+        h = Mix(h, reinterpret_cast<std::uintptr_t>(item.Material));
+        h = Mix(h, (std::uint64_t(item.PipelineState) << 32) | item.PrimitiveTopology);
+        h = Mix(h, (std::uint64_t(item.IndexCount) << 32) | item.StartIndexLocation);
+        h = Mix(h, std::uint32_t(item.BaseVertexLocation));
+        // Finalizer so the low bits used for the table index are well spread.
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    bool SameBatch(const InstanceBatch& batch, const BatchItem& item)
+    {
+        return batch.Geometry == item.Geometry &&
+            batch.Material == item.Material &&
+            batch.PipelineState == item.PipelineState &&
+            batch.PrimitiveTopology == item.PrimitiveTopology &&
+            batch.IndexCount == item.IndexCount &&
+            batch.StartIndexLocation == item.StartIndexLocation &&
+            batch.BaseVertexLocation == item.BaseVertexLocation;
+    }
+}
+
+void InstanceBatcher::Build(const BatchItem* items, std::size_t count)
+{
+    mBatches.clear();
+    mBatchHashes.clear();
+    mTable.assign(mTable.empty() ? 64 : mTable.size(), 0u);
+    mItemBatch.resize(count);
+    mInstanceIndices.resize(count);
+
+    // Counting pass.  Runs of identical items are common, so check the
+    // previous item's batch before going to the table.
+    std::uint32_t lastBatch = ~0u;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const BatchItem& item = items[i];
+        if (lastBatch == ~0u || !SameBatch(mBatches[lastBatch], item))
+            lastBatch = FindOrAddBatch(item);
+
+        mItemBatch[i] = lastBatch;
+        ++mBatches[lastBatch].InstanceCount;
+    }
+
+    std::uint32_t first = 0;
+    for (auto& batch : mBatches)
+    {
+        batch.FirstInstance = first;
+        first += batch.InstanceCount;
+        batch.InstanceCount = 0;
+    }
+
+    // Scatter pass, InstanceCount is rebuilt as the write cursor.
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        InstanceBatch& batch = mBatches[mItemBatch[i]];
+        mInstanceIndices[batch.FirstInstance + batch.InstanceCount++] = items[i].InstanceIndex;
+    }
+}
+
+std::uint32_t InstanceBatcher::FindOrAddBatch(const BatchItem& item)
+{
+    const std::uint64_t hash = HashItem(item);
+    const std::size_t mask = mTable.size() - 1;
+
+    for (std::size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+    {
+        std::uint32_t entry = mTable[slot];
+        if (entry == 0)
+        {
+            InstanceBatch batch;
+            batch.Geometry = item.Geometry;
+            batch.Material = item.Material;
+            batch.PipelineState = item.PipelineState;
+            batch.PrimitiveTopology = item.PrimitiveTopology;
+            batch.IndexCount = item.IndexCount;
+            batch.StartIndexLocation = item.StartIndexLocation;
+            batch.BaseVertexLocation = item.BaseVertexLocation;
+
+            std::uint32_t index = (std::uint32_t)mBatches.size();
+            mBatches.push_back(batch);
+            mBatchHashes.push_back(hash);
+            mTable[slot] = index + 1;
+
+            // Keep the load factor under one half.
+            if (mBatches.size() * 2 > mTable.size())
+                GrowTable();
+            return index;
+        }
+
+        if (mBatchHashes[entry - 1] == hash && SameBatch(mBatches[entry - 1], item))
+            return entry - 1;
+    }
+}
+
+void InstanceBatcher::GrowTable()
+{
+    mTable.assign(mTable.size() * 2, 0u);
+    const std::size_t mask = mTable.size() - 1;
+
+    for (std::size_t i = 0; i < mBatches.size(); ++i)
+    {
+        std::size_t slot = mBatchHashes[i] & mask;
+        while (mTable[slot] != 0)
+            slot = (slot + 1) & mask;
+        mTable[slot] = (std::uint32_t)i + 1;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One visible item as seen by the batcher.  Geometry and Material are only
+// compared, never dereferenced, so the batcher does not depend on D3D types.
+struct BatchItem
+{
+    const void* Geometry = nullptr;
+    const void* Material = nullptr;
+    std::uint32_t PipelineState = 0;
+    std::uint32_t PrimitiveTopology = 0;
+
+    // Submesh range inside Geometry.
+    std::uint32_t IndexCount = 0;
+    std::uint32_t StartIndexLocation = 0;
+    std::int32_t BaseVertexLocation = 0;
+
+    // Slot of the item in the per-object instance buffer, copied to
+    // InstanceIndices() as is.
+    std::uint32_t InstanceIndex = 0;
+};
+
+// Items sharing geometry, submesh, material and pipeline state.  Their
+// instance indices are InstanceIndices()[FirstInstance, FirstInstance + InstanceCount).
+struct InstanceBatch
+{
+    const void* Geometry = nullptr;
+    const void* Material = nullptr;
+    std::uint32_t PipelineState = 0;
+    std::uint32_t PrimitiveTopology = 0;
+    std::uint32_t IndexCount = 0;
+    std::uint32_t StartIndexLocation = 0;
+    std::int32_t BaseVertexLocation = 0;
+
+    std::uint32_t FirstInstance = 0;
+    std::uint32_t InstanceCount = 0;
+};
+
+// Groups items into instanced draws.  Batches come out in the order their
+// first item was seen and keep the item order inside each batch, so callers
+// that sort their input get sorted batches back.  Storage is reused between
+// Build calls.
+class InstanceBatcher
+{
+public:
+    void Build(const BatchItem* items, std::size_t count);
+
+    const std::vector<InstanceBatch>& Batches()const { return mBatches; }
+    const std::vector<std::uint32_t>& InstanceIndices()const { return mInstanceIndices; }
+
+private:
+    std::uint32_t FindOrAddBatch(const BatchItem& item);
+    void GrowTable();
+
+    std::vector<InstanceBatch> mBatches;
+    std::vector<std::uint32_t> mInstanceIndices;
+
+    // Batch of every input item, filled by the counting pass.
+    std::vector<std::uint32_t> mItemBatch;
+
+    // Open addressing table of batch index + 1, 0 marks an empty slot.
+    std::vector<std::uint32_t> mTable;
+    std::vector<std::uint64_t> mBatchHashes;
+};
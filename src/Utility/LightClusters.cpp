@@ -0,0 +1,359 @@
+#include "LightClusters.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    LightClusters::Bounds MakeBounds(const Float3& min, const Float3& max)
+    {
+        LightClusters::Bounds bounds;
+        bounds.Min = min;
+        bounds.Max = max;
+        bounds.Center = { 0.5f * (min.x + max.x), 0.5f * (min.y + max.y), 0.5f * (min.z + max.z) };
+        const float ex = 0.5f * (max.x - min.x), ey = 0.5f * (max.y - min.y), ez = 0.5f * (max.z - min.z);
+        bounds.Radius = std::sqrt(ex * ex + ey * ey + ez * ez);
+        return bounds;
+    }
+
+    // Box around members whose sphere holds every member's sphere, not just
+    // its box, so a light that passes for a member passes for the union.
+    LightClusters::Bounds Union(const LightClusters::Bounds* members, std::uint32_t count, std::uint32_t stride)
+    {
+        Float3 min = members[0].Min, max = members[0].Max;
+        for (std::uint32_t i = 1; i < count; ++i)
+        {
+            const LightClusters::Bounds& member = members[i * stride];
+            min = { std::min(min.x, member.Min.x), std::min(min.y, member.Min.y), std::min(min.z, member.Min.z) };
+            max = { std::max(max.x, member.Max.x), std::max(max.y, member.Max.y), std::max(max.z, member.Max.z) };
+        }
+
+        LightClusters::Bounds bounds = MakeBounds(min, max);
+        bounds.Radius = 0.0f;
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            const LightClusters::Bounds& member = members[i * stride];
+            const float dx = member.Center.x - bounds.Center.x;
+            const float dy = member.Center.y - bounds.Center.y;
+            const float dz = member.Center.z - bounds.Center.z;
+            bounds.Radius = std::max(bounds.Radius, std::sqrt(dx * dx + dy * dy + dz * dz) + member.Radius);
+        }
+        // Rounding must not make the union the stricter test.
+        bounds.Radius *= 1.0001f;
+        return bounds;
+    }
+
+    // Sphere against box, then cone against the bounding sphere of the box
+    // (Wronski, "Cull that cone"): the sphere is culled when it is outside
+    // the cone's sides, past its range or behind its apex.
+    bool TouchesBounds(const LightClusters::Bounds& b, float x, float y, float z, float radius,
+        float dirX, float dirY, float dirZ, float cosAngle, float sinAngle)
+    {
+        const float dx = std::max(std::max(b.Min.x - x, x - b.Max.x), 0.0f);
+        const float dy = std::max(std::max(b.Min.y - y, y - b.Max.y), 0.0f);
+        const float dz = std::max(std::max(b.Min.z - z, z - b.Max.z), 0.0f);
+        const bool sphere = dx * dx + dy * dy + dz * dz <= radius * radius;
+
+        const float vx = b.Center.x - x, vy = b.Center.y - y, vz = b.Center.z - z;
+        const float lengthSq = vx * vx + vy * vy + vz * vz;
+        const float axial = vx * dirX + vy * dirY + vz * dirZ;
+        const float closest = cosAngle * std::sqrt(std::max(lengthSq - axial * axial, 0.0f)) - axial * sinAngle;
+        const bool cone = closest <= b.Radius && axial <= b.Radius + radius && axial >= -b.Radius;
+        return sphere && cone;
+    }
+}
+
+void LightClusters::LightSoA::Resize(std::uint32_t count)
+{
+    const std::size_t padded = ((std::size_t)count + 7) & ~(std::size_t)7;
+    for (std::vector<float>* v : { &X, &Y, &Z, &Radius, &DirX, &DirY, &DirZ, &Cos, &Sin })
+        v->resize(padded);
+    Id.resize(padded);
+}
+
+void LightClusters::Configure(const Config& config)
+{
+    if (mConfigured && config.TilesX == mConfig.TilesX && config.TilesY == mConfig.TilesY && config.Slices == mConfig.Slices &&
+        config.TanHalfFovX == mConfig.TanHalfFovX && config.TanHalfFovY == mConfig.TanHalfFovY &&
+        config.NearZ == mConfig.NearZ && config.FarZ == mConfig.FarZ)
+        return;
+    mConfig = config;
+    mConfigured = true;
+
+    const std::uint32_t tilesX = config.TilesX, tilesY = config.TilesY, slices = config.Slices;
+    const float logRatio = std::log(config.FarZ / config.NearZ);
+    mSliceScale = (float)slices / logRatio;
+    mSliceBias = -(float)slices * std::log(config.NearZ) / logRatio;
+
+    mClusters.resize(ClusterCount());
+    mRows.resize(slices * tilesY);
+    mSlices.resize(slices);
+    for (std::uint32_t s = 0; s < slices; ++s)
+    {
+        // Slices overlap a little, so the shader computing a pixel's slice
+        // in a different order of operations cannot step out of it.
+        const float zNear = config.NearZ * std::pow(config.FarZ / config.NearZ, (float)s / (float)slices) * 0.999f;
+        const float zFar = config.NearZ * std::pow(config.FarZ / config.NearZ, (float)(s + 1) / (float)slices) * 1.001f;
+        for (std::uint32_t y = 0; y < tilesY; ++y)
+        {
+            const float ndcTop = 1.0f - 2.0f * (float)y / (float)tilesY;
+            const float ndcBottom = 1.0f - 2.0f * (float)(y + 1) / (float)tilesY;
+            const float minY = std::min(ndcBottom * zNear, ndcBottom * zFar) * config.TanHalfFovY;
+            const float maxY = std::max(ndcTop * zNear, ndcTop * zFar) * config.TanHalfFovY;
+            for (std::uint32_t x = 0; x < tilesX; ++x)
+            {
+                const float ndcLeft = -1.0f + 2.0f * (float)x / (float)tilesX;
+                const float ndcRight = -1.0f + 2.0f * (float)(x + 1) / (float)tilesX;
+                const float minX = std::min(ndcLeft * zNear, ndcLeft * zFar) * config.TanHalfFovX;
+                const float maxX = std::max(ndcRight * zNear, ndcRight * zFar) * config.TanHalfFovX;
+                mClusters[ClusterIndex(x, y, s)] = MakeBounds({ minX, minY, zNear }, { maxX, maxY, zFar });
+            }
+            mRows[s * tilesY + y] = Union(&mClusters[ClusterIndex(0, y, s)], tilesX, 1);
+        }
+        mSlices[s] = Union(&mRows[s * tilesY], tilesY, 1);
+    }
+}
+
+void LightClusters::ClearLights()
+{
+    mWorldLights.clear();
+}
+
+std::uint32_t LightClusters::AddPointLight(const Float3& position, float range)
+{
+    mWorldLights.push_back({ position, range, { 0.0f, 0.0f, 0.0f }, -1.0f });
+    return (std::uint32_t)mWorldLights.size() - 1;
+}
+
+std::uint32_t LightClusters::AddSpotLight(const Float3& position, float range, const Float3& direction, float cosAngle)
+{
+    mWorldLights.push_back({ position, range, direction, cosAngle });
+    return (std::uint32_t)mWorldLights.size() - 1;
+}
+
+void LightClusters::TransformLights(const Float4x4& view)
+{
+    const std::uint32_t count = LightCount();
+    mViewLights.Resize(count);
+
+    const auto& m = view.m;
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        const WorldLight& light = mWorldLights[i];
+        const Float3& p = light.Position;
+        mViewLights.X[i] = p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0];
+        mViewLights.Y[i] = p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1];
+        mViewLights.Z[i] = p.x * m[0][2] + p.y * m[1][2] + p.z * m[2][2] + m[3][2];
+        mViewLights.Radius[i] = light.Range;
+        mViewLights.Id[i] = i;
+
+        Float3 dir = { 0.0f, 0.0f, 0.0f };
+        float sinAngle = 0.0f;
+        if (light.CosAngle > -1.0f)
+        {
+            const Float3& d = light.Direction;
+            dir = { d.x * m[0][0] + d.y * m[1][0] + d.z * m[2][0],
+                    d.x * m[0][1] + d.y * m[1][1] + d.z * m[2][1],
+                    d.x * m[0][2] + d.y * m[1][2] + d.z * m[2][2] };
+            const float length = std::sqrt(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+            dir = { dir.x / length, dir.y / length, dir.z / length };
+            sinAngle = std::sqrt(std::max(1.0f - light.CosAngle * light.CosAngle, 0.0f));
+        }
+        mViewLights.DirX[i] = dir.x;
+        mViewLights.DirY[i] = dir.y;
+        mViewLights.DirZ[i] = dir.z;
+        mViewLights.Cos[i] = light.CosAngle;
+        mViewLights.Sin[i] = sinAngle;
+    }
+}
+
+void LightClusters::Gather(const LightSoA& from, const std::uint32_t* positions, std::uint32_t count, LightSoA& to)
+{
+    to.Resize(count);
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        const std::uint32_t k = positions[i];
+        to.X[i] = from.X[k];
+        to.Y[i] = from.Y[k];
+        to.Z[i] = from.Z[k];
+        to.Radius[i] = from.Radius[k];
+        to.DirX[i] = from.DirX[k];
+        to.DirY[i] = from.DirY[k];
+        to.DirZ[i] = from.DirZ[k];
+        to.Cos[i] = from.Cos[k];
+        to.Sin[i] = from.Sin[k];
+        to.Id[i] = from.Id[k];
+    }
+}
+
+void LightClusters::Assign(const Float4x4& view, ThreadPool* pool)
+{
+    TransformLights(view);
+
+    const std::uint32_t slices = mConfig.Slices;
+    mRanges.resize(ClusterCount());
+    mSliceIndices.resize(slices);
+    if (pool == nullptr)
+    {
+        mScratch.resize(1);
+        for (std::uint32_t s = 0; s < slices; ++s)
+            AssignSlice(s, mScratch[0]);
+    }
+    else
+    {
+        mScratch.resize(pool->ExecutorCount());
+        pool->ParallelFor(slices, [this](std::uint32_t s, std::uint32_t executor)
+        {
+            AssignSlice(s, mScratch[executor]);
+        });
+    }
+    BuildIndices();
+}
+
+void LightClusters::AssignSlice(std::uint32_t slice, Scratch& scratch)
+{
+    // Lights are narrowed down from the slice to each row to each cluster,
+    // so a cluster only tests lights that are already close.
+    std::vector<std::uint32_t>& positions = scratch.Positions;
+    positions.resize(LightCount());
+    const std::uint32_t sliceCount = CullLights(mSlices[slice], mViewLights, LightCount(), positions.data());
+    Gather(mViewLights, positions.data(), sliceCount, scratch.SliceLights);
+
+    std::vector<std::uint32_t>& out = mSliceIndices[slice];
+    out.clear();
+    for (std::uint32_t y = 0; y < mConfig.TilesY; ++y)
+    {
+        const std::uint32_t rowCount = CullLights(mRows[slice * mConfig.TilesY + y], scratch.SliceLights, sliceCount, positions.data());
+        Gather(scratch.SliceLights, positions.data(), rowCount, scratch.RowLights);
+        for (std::uint32_t x = 0; x < mConfig.TilesX; ++x)
+        {
+            const std::uint32_t cluster = ClusterIndex(x, y, slice);
+            const std::uint32_t count = CullLights(mClusters[cluster], scratch.RowLights, rowCount, positions.data());
+            for (std::uint32_t i = 0; i < count; ++i)
+                out.push_back(scratch.RowLights.Id[positions[i]]);
+            mRanges[cluster].Count = count;
+        }
+    }
+}
+
+void LightClusters::AssignReference(const Float4x4& view)
+{
+    TransformLights(view);
+
+    mRanges.resize(ClusterCount());
+    mSliceIndices.resize(mConfig.Slices);
+    for (std::uint32_t s = 0; s < mConfig.Slices; ++s)
+    {
+        std::vector<std::uint32_t>& out = mSliceIndices[s];
+        out.clear();
+        for (std::uint32_t y = 0; y < mConfig.TilesY; ++y)
+        {
+            for (std::uint32_t x = 0; x < mConfig.TilesX; ++x)
+            {
+                const std::uint32_t cluster = ClusterIndex(x, y, s);
+                const Bounds& b = mClusters[cluster];
+                std::uint32_t count = 0;
+                for (std::uint32_t i = 0; i < LightCount(); ++i)
+                {
+                    if (TouchesBounds(b, mViewLights.X[i], mViewLights.Y[i], mViewLights.Z[i], mViewLights.Radius[i],
+                        mViewLights.DirX[i], mViewLights.DirY[i], mViewLights.DirZ[i], mViewLights.Cos[i], mViewLights.Sin[i]))
+                    {
+                        out.push_back(i);
+                        ++count;
+                    }
+                }
+                mRanges[cluster].Count = count;
+            }
+        }
+    }
+    BuildIndices();
+}
+
+void LightClusters::BuildIndices()
+{
+    // Slices hold their clusters in order, so the offsets are a running sum
+    // and the slice lists are copied back to back.
+    std::uint32_t offset = 0;
+    for (Range& range : mRanges)
+    {
+        range.Offset = offset;
+        offset += range.Count;
+    }
+
+    mIndices.resize(offset);
+    std::uint32_t* out = mIndices.data();
+    for (const std::vector<std::uint32_t>& slice : mSliceIndices)
+        out = std::copy(slice.begin(), slice.end(), out);
+}
+
+std::uint32_t LightClusters::CullLightsScalar(const Bounds& bounds, const LightSoA& lights, std::uint32_t count, std::uint32_t* out)
+{
+    std::uint32_t visible = 0;
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        if (TouchesBounds(bounds, lights.X[i], lights.Y[i], lights.Z[i], lights.Radius[i],
+            lights.DirX[i], lights.DirY[i], lights.DirZ[i], lights.Cos[i], lights.Sin[i]))
+            out[visible++] = i;
+    }
+    return visible;
+}
+
+std::uint32_t LightClusters::CullLights(const Bounds& bounds, const LightSoA& lights, std::uint32_t count, std::uint32_t* out)
+{
+#if defined(__AVX2__)
+    const __m256 minX = _mm256_set1_ps(bounds.Min.x), minY = _mm256_set1_ps(bounds.Min.y), minZ = _mm256_set1_ps(bounds.Min.z);
+    const __m256 maxX = _mm256_set1_ps(bounds.Max.x), maxY = _mm256_set1_ps(bounds.Max.y), maxZ = _mm256_set1_ps(bounds.Max.z);
+    const __m256 centerX = _mm256_set1_ps(bounds.Center.x), centerY = _mm256_set1_ps(bounds.Center.y), centerZ = _mm256_set1_ps(bounds.Center.z);
+    const __m256 sphereRadius = _mm256_set1_ps(bounds.Radius);
+    const __m256 negSphereRadius = _mm256_set1_ps(-bounds.Radius);
+    const __m256 zero = _mm256_setzero_ps();
+
+    // Same operations in the same order as TouchesBounds, so both agree to
+    // the bit.  Loads past count stay inside the padding, the lanes are
+    // masked off.
+    std::uint32_t visible = 0;
+    for (std::uint32_t i = 0; i < count; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(lights.X.data() + i);
+        const __m256 y = _mm256_loadu_ps(lights.Y.data() + i);
+        const __m256 z = _mm256_loadu_ps(lights.Z.data() + i);
+        const __m256 radius = _mm256_loadu_ps(lights.Radius.data() + i);
+
+        const __m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minX, x), _mm256_sub_ps(x, maxX)), zero);
+        const __m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minY, y), _mm256_sub_ps(y, maxY)), zero);
+        const __m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minZ, z), _mm256_sub_ps(z, maxZ)), zero);
+        const __m256 distanceSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        __m256 pass = _mm256_cmp_ps(distanceSq, _mm256_mul_ps(radius, radius), _CMP_LE_OQ);
+
+        const __m256 vx = _mm256_sub_ps(centerX, x);
+        const __m256 vy = _mm256_sub_ps(centerY, y);
+        const __m256 vz = _mm256_sub_ps(centerZ, z);
+        const __m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz));
+        const __m256 axial = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, _mm256_loadu_ps(lights.DirX.data() + i)),
+            _mm256_mul_ps(vy, _mm256_loadu_ps(lights.DirY.data() + i))), _mm256_mul_ps(vz, _mm256_loadu_ps(lights.DirZ.data() + i)));
+        const __m256 radial = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(lengthSq, _mm256_mul_ps(axial, axial)), zero));
+        const __m256 closest = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(lights.Cos.data() + i), radial),
+            _mm256_mul_ps(axial, _mm256_loadu_ps(lights.Sin.data() + i)));
+        pass = _mm256_and_ps(pass, _mm256_cmp_ps(closest, sphereRadius, _CMP_LE_OQ));
+        pass = _mm256_and_ps(pass, _mm256_cmp_ps(axial, _mm256_add_ps(sphereRadius, radius), _CMP_LE_OQ));
+        pass = _mm256_and_ps(pass, _mm256_cmp_ps(axial, negSphereRadius, _CMP_GE_OQ));
+
+        std::uint32_t mask = (std::uint32_t)_mm256_movemask_ps(pass);
+        if (count - i < 8)
+            mask &= (1u << (count - i)) - 1;
+
+        for (; mask != 0; mask &= mask - 1)
+            out[visible++] = i + (std::uint32_t)std::countr_zero(mask);
+    }
+    return visible;
+#else
+    return CullLightsScalar(bounds, lights, count, out);
+#endif
+}
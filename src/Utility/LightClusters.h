@@ -0,0 +1,133 @@
+#pragma once
+
+#include "SimdMath.h"
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Clustered light assignment.  The view frustum is cut into TilesX x TilesY
+// screen tiles and Slices depth slices, exponentially spaced between the
+// near and far plane, and every point and spot light is listed in each
+// cluster its volume touches; a pixel then only shades with the lights of
+// its cluster.  Point lights are tested as spheres against the view space
+// box of a cluster, spot lights additionally as cones against the
+// cluster's bounding sphere, eight lights per instruction with AVX2.
+class LightClusters
+{
+public:
+    struct Config
+    {
+        std::uint32_t TilesX = 16;
+        std::uint32_t TilesY = 9;
+        std::uint32_t Slices = 24;
+        float TanHalfFovX = 1.0f;
+        float TanHalfFovY = 1.0f;
+        float NearZ = 1.0f;
+        float FarZ = 1000.0f;
+    };
+
+    // Lights of a cluster are Indices()[Offset, Offset + Count).
+    struct Range
+    {
+        std::uint32_t Offset;
+        std::uint32_t Count;
+    };
+
+    // Lights in view space, padded to a multiple of eight.  Point lights
+    // have a zero direction, a cosine of -1 and a sine of 0, which no
+    // cluster fails the cone test for.
+    struct LightSoA
+    {
+        std::vector<float> X, Y, Z, Radius;
+        std::vector<float> DirX, DirY, DirZ, Cos, Sin;
+        std::vector<std::uint32_t> Id;
+
+        void Resize(std::uint32_t count);
+    };
+
+    // View space box of a cluster and its bounding sphere.
+    struct Bounds
+    {
+        Float3 Min, Max;
+        Float3 Center;
+        float Radius = 0.0f;
+    };
+
+    // Recomputes the cluster bounds when config differs from the current one.
+    void Configure(const Config& config);
+    const Config& GetConfig()const { return mConfig; }
+
+    std::uint32_t ClusterCount()const { return mConfig.TilesX * mConfig.TilesY * mConfig.Slices; }
+    // Tile y 0 is the top row of the screen.
+    std::uint32_t ClusterIndex(std::uint32_t x, std::uint32_t y, std::uint32_t slice)const
+    {
+        return (slice * mConfig.TilesY + y) * mConfig.TilesX + x;
+    }
+    // The slice of view depth z is floor(log(z) * SliceScale() + SliceBias()).
+    float SliceScale()const { return mSliceScale; }
+    float SliceBias()const { return mSliceBias; }
+    const Bounds& ClusterBounds(std::uint32_t cluster)const { return mClusters[cluster]; }
+
+    void ClearLights();
+    // World space lights; a light's index is the number of lights added
+    // before it.  cosAngle is the cosine of the cone's half angle, in
+    // (0, 1], and direction need not be normalized.
+    std::uint32_t AddPointLight(const Float3& position, float range);
+    std::uint32_t AddSpotLight(const Float3& position, float range, const Float3& direction, float cosAngle);
+    std::uint32_t LightCount()const { return (std::uint32_t)mWorldLights.size(); }
+
+    // Assigns the lights to clusters for a camera with the world to view
+    // matrix view (row vector).  Slices are binned in parallel on pool.
+    void Assign(const Float4x4& view, ThreadPool* pool);
+    // Same, one cluster and one light at a time; the reference for Assign.
+    void AssignReference(const Float4x4& view);
+
+    const std::vector<Range>& Ranges()const { return mRanges; }
+    const std::vector<std::uint32_t>& Indices()const { return mIndices; }
+
+    // Writes the positions of those of the first count lights that touch
+    // bounds to out and returns how many there are.
+    static std::uint32_t CullLights(const Bounds& bounds, const LightSoA& lights, std::uint32_t count, std::uint32_t* out);
+    static std::uint32_t CullLightsScalar(const Bounds& bounds, const LightSoA& lights, std::uint32_t count, std::uint32_t* out);
+
+private:
+    struct WorldLight
+    {
+        Float3 Position;
+        float Range;
+        Float3 Direction;
+        float CosAngle;
+    };
+
+    struct Scratch
+    {
+        LightSoA SliceLights;
+        LightSoA RowLights;
+        std::vector<std::uint32_t> Positions;
+    };
+
+    void TransformLights(const Float4x4& view);
+    void AssignSlice(std::uint32_t slice, Scratch& scratch);
+    static void Gather(const LightSoA& from, const std::uint32_t* positions, std::uint32_t count, LightSoA& to);
+    void BuildIndices();
+
+    Config mConfig;
+    bool mConfigured = false;
+    float mSliceScale = 0.0f;
+    float mSliceBias = 0.0f;
+    std::vector<Bounds> mClusters;
+    // Unions of the clusters of a slice and of a tile row of a slice, which
+    // narrow down the lights before the clusters are tested.
+    std::vector<Bounds> mSlices;
+    std::vector<Bounds> mRows;
+
+    std::vector<WorldLight> mWorldLights;
+    LightSoA mViewLights;
+
+    std::vector<Scratch> mScratch;
+    std::vector<std::vector<std::uint32_t>> mSliceIndices;
+    std::vector<Range> mRanges;
+    std::vector<std::uint32_t> mIndices;
+};
@@ -9,6 +9,8 @@
 #include <Windows.h>
 #include <DirectXMath.h>
 #include <cstdint>
+#include <cstring>
+#include "SimdMath.h"
 
 class MathHelper
 {
@@ -89,6 +91,29 @@ public:
         return I;
     }
 
+    // Float4x4 is what the DirectX-free systems use, same layout as XMFLOAT4X4.
+    static Float4x4 ToFloat4x4(const DirectX::XMFLOAT4X4& m)
+    {
+        static_assert(sizeof(Float4x4) == sizeof(DirectX::XMFLOAT4X4), "Float4x4 layout mismatch");
+        Float4x4 r;
+        std::memcpy(&r, &m, sizeof(r));
+        return r;
+    }
+
+    static Float4x4 ToFloat4x4(DirectX::FXMMATRIX M)
+    {
+        DirectX::XMFLOAT4X4 m;
+        DirectX::XMStoreFloat4x4(&m, M);
+        return ToFloat4x4(m);
+    }
+
+    static DirectX::XMFLOAT4X4 ToXMFLOAT4X4(const Float4x4& m)
+    {
+        DirectX::XMFLOAT4X4 r;
+        std::memcpy(&r, &m, sizeof(r));
+        return r;
+    }
+
     static DirectX::XMVECTOR RandUnitVec3();
     static DirectX::XMVECTOR RandHemisphereUnitVec3(DirectX::XMVECTOR n);
 
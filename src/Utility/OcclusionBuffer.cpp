@@ -0,0 +1,342 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    Float4 Transform(const Float4& v, const Float4x4& m)
+    {
+        Float4 r;
+        r.x = v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + v.w * m.m[3][0];
+        r.y = v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + v.w * m.m[3][1];
+        r.z = v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + v.w * m.m[3][2];
+        r.w = v.x * m.m[0][3] + v.y * m.m[1][3] + v.z * m.m[2][3] + v.w * m.m[3][3];
+        return r;
+    }
+
+    constexpr std::uint32_t FullMask = 0xffffffffu;
+}
+
+MaskedOcclusionBuffer::MaskedOcclusionBuffer(std::uint32_t width, std::uint32_t height) :
+    mWidth(width),
+    mHeight(height),
+    mTilesX(width / TileWidth),
+    mTilesY(height / TileHeight),
+    mTileStride((width / TileWidth + 7) & ~7u)
+{
+    // Eight more so a test starting at any tile can load a full register.
+    const std::size_t size = (std::size_t)mTileStride * mTilesY + 8;
+    mDepth0.resize(size);
+    mDepth1.resize(size);
+    mMask.resize(size);
+    Clear();
+}
+
+void MaskedOcclusionBuffer::Clear()
+{
+    std::fill(mDepth0.begin(), mDepth0.end(), 1.0f);
+    std::fill(mDepth1.begin(), mDepth1.end(), 0.0f);
+    std::fill(mMask.begin(), mMask.end(), 0u);
+}
+
+void MaskedOcclusionBuffer::TransformVertices(const void* positions, std::uint32_t stride, std::uint32_t count,
+    const Float4x4& m, Float4* clipVertices)
+{
+    const std::uint8_t* src = static_cast<const std::uint8_t*>(positions);
+    for (std::uint32_t i = 0; i < count; ++i, src += stride)
+    {
+        float p[3];
+        std::memcpy(p, src, sizeof(p));
+        clipVertices[i] = Transform({ p[0], p[1], p[2], 1.0f }, m);
+    }
+}
+
+bool MaskedOcclusionBuffer::SetupTriangle(const Float4& v0, const Float4& v1, const Float4& v2, Triangle& tri)const
+{
+    if (!(v0.w > 0.0f && v1.w > 0.0f && v2.w > 0.0f))
+        return false;
+
+    const Float4* v[3] = { &v0, &v1, &v2 };
+    float x[3], y[3], z[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        const float invW = 1.0f / v[k]->w;
+        x[k] = (v[k]->x * invW * 0.5f + 0.5f) * mWidth;
+        y[k] = (0.5f - v[k]->y * invW * 0.5f) * mHeight;
+        z[k] = v[k]->z * invW;
+    }
+
+    // Nothing is gained from a triangle past the far plane.
+    if (z[0] > 1.0f && z[1] > 1.0f && z[2] > 1.0f)
+        return false;
+
+    const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area != 0.0f) || !std::isfinite(area))
+        return false;
+
+    // Edge k runs from vertex k to k + 1; the opposite vertex gives it the
+    // sign of area, so the sign flip makes inside positive for both windings.
+    const float sign = area > 0.0f ? 1.0f : -1.0f;
+    for (int k = 0; k < 3; ++k)
+    {
+        const int next = (k + 1) % 3;
+        tri.A[k] = sign * (y[k] - y[next]);
+        tri.B[k] = sign * (x[next] - x[k]);
+        tri.C[k] = -(tri.A[k] * x[k] + tri.B[k] * y[k]);
+    }
+
+    tri.MinX = std::min({ x[0], x[1], x[2] });
+    tri.MaxX = std::max({ x[0], x[1], x[2] });
+    tri.MinY = std::min({ y[0], y[1], y[2] });
+    tri.MaxY = std::max({ y[0], y[1], y[2] });
+
+    const float dx1 = x[1] - x[0], dy1 = y[1] - y[0], dz1 = z[1] - z[0];
+    const float dx2 = x[2] - x[0], dy2 = y[2] - y[0], dz2 = z[2] - z[0];
+    tri.DepthX = (dz1 * dy2 - dy1 * dz2) / area;
+    tri.DepthY = (dx1 * dz2 - dz1 * dx2) / area;
+    tri.DepthC = z[0] - tri.DepthX * x[0] - tri.DepthY * y[0];
+    tri.MaxDepth = std::max({ z[0], z[1], z[2] });
+    return true;
+}
+
+std::uint32_t MaskedOcclusionBuffer::TileCoverageScalar(const Triangle& tri, float x, float y)
+{
+    std::uint32_t mask = 0;
+    for (std::uint32_t row = 0; row < TileHeight; ++row)
+    {
+        const float py = y + (float)row + 0.5f;
+        for (std::uint32_t column = 0; column < TileWidth; ++column)
+        {
+            const float px = x + (float)column + 0.5f;
+            bool inside = true;
+            for (int k = 0; k < 3; ++k)
+                inside = inside && (tri.A[k] * px + tri.B[k] * py) + tri.C[k] >= 0.0f;
+            if (inside)
+                mask |= 1u << (row * TileWidth + column);
+        }
+    }
+    return mask;
+}
+
+std::uint32_t MaskedOcclusionBuffer::TileCoverage(const Triangle& tri, float x, float y)
+{
+#if defined(__AVX2__)
+    const __m256 px = _mm256_add_ps(_mm256_set1_ps(x),
+        _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+
+    __m256 ax[3];
+    for (int k = 0; k < 3; ++k)
+        ax[k] = _mm256_mul_ps(_mm256_set1_ps(tri.A[k]), px);
+
+    std::uint32_t mask = 0;
+    for (std::uint32_t row = 0; row < TileHeight; ++row)
+    {
+        const float py = y + (float)row + 0.5f;
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int k = 0; k < 3; ++k)
+        {
+            const __m256 e = _mm256_add_ps(_mm256_add_ps(ax[k], _mm256_set1_ps(tri.B[k] * py)), _mm256_set1_ps(tri.C[k]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(e, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        mask |= (std::uint32_t)_mm256_movemask_ps(inside) << (row * TileWidth);
+    }
+    return mask;
+#else
+    return TileCoverageScalar(tri, x, y);
+#endif
+}
+
+void MaskedOcclusionBuffer::UpdateTile(std::uint32_t tile, std::uint32_t mask, float depth)
+{
+    float& depth0 = mDepth0[tile];
+    float& depth1 = mDepth1[tile];
+    std::uint32_t& layerMask = mMask[tile];
+
+    // Behind the full layer, the tile already hides it.
+    if (depth >= depth0)
+        return;
+
+    // A triangle much nearer than the working layer starts a new one; the
+    // old coverage is dropped, which only loses culling.
+    if (depth1 - depth > depth0 - depth1)
+    {
+        depth1 = 0.0f;
+        layerMask = 0;
+    }
+
+    depth1 = std::max(depth1, depth);
+    layerMask |= mask;
+    if (layerMask == FullMask)
+    {
+        depth0 = std::min(depth0, depth1);
+        depth1 = 0.0f;
+        layerMask = 0;
+    }
+}
+
+void MaskedOcclusionBuffer::RenderTriangle(const Triangle& tri)
+{
+    const int px0 = std::max(0, (int)std::floor(tri.MinX));
+    const int py0 = std::max(0, (int)std::floor(tri.MinY));
+    const int px1 = std::min((int)mWidth - 1, (int)std::ceil(tri.MaxX));
+    const int py1 = std::min((int)mHeight - 1, (int)std::ceil(tri.MaxY));
+    if (px0 > px1 || py0 > py1)
+        return;
+
+    for (std::uint32_t ty = py0 / TileHeight; ty <= py1 / TileHeight; ++ty)
+    {
+        const float y = (float)(ty * TileHeight);
+        // The plane's farthest point over the tile, which lies at a corner.
+        const float depthY = std::max(tri.DepthY * y, tri.DepthY * (y + TileHeight)) + tri.DepthC;
+
+        for (std::uint32_t tx = px0 / TileWidth; tx <= px1 / TileWidth; ++tx)
+        {
+            const float x = (float)(tx * TileWidth);
+            const std::uint32_t mask = TileCoverage(tri, x, y);
+            if (mask == 0)
+                continue;
+
+            const float depth = std::min(tri.MaxDepth, std::max(tri.DepthX * x, tri.DepthX * (x + TileWidth)) + depthY);
+            UpdateTile(ty * mTileStride + tx, mask, depth);
+        }
+    }
+}
+
+template<typename Index>
+void MaskedOcclusionBuffer::RenderIndexed(const Float4* clipVertices, const Index* indices, std::uint32_t triangleCount)
+{
+    Triangle tri;
+    for (std::uint32_t t = 0; t < triangleCount; ++t)
+    {
+        const Index* i = indices + 3 * t;
+        if (SetupTriangle(clipVertices[i[0]], clipVertices[i[1]], clipVertices[i[2]], tri))
+            RenderTriangle(tri);
+    }
+}
+
+void MaskedOcclusionBuffer::RenderTriangles(const Float4* clipVertices, const std::uint16_t* indices, std::uint32_t triangleCount)
+{
+    RenderIndexed(clipVertices, indices, triangleCount);
+}
+
+void MaskedOcclusionBuffer::RenderTriangles(const Float4* clipVertices, const std::uint32_t* indices, std::uint32_t triangleCount)
+{
+    RenderIndexed(clipVertices, indices, triangleCount);
+}
+
+void MaskedOcclusionBuffer::Reproject(const MaskedOcclusionBuffer& previous, const Float4x4& previousInvViewProj, const Float4x4& viewProj)
+{
+    // Previous screen position and depth back to the world, then into this
+    // frame's clip space.
+    auto reproject = [&](std::uint32_t px, std::uint32_t py, float depth)
+    {
+        const Float4 ndc = { (float)px / previous.mWidth * 2.0f - 1.0f, 1.0f - (float)py / previous.mHeight * 2.0f, depth, 1.0f };
+        Float4 world = Transform(ndc, previousInvViewProj);
+        const float invW = 1.0f / world.w;
+        world = { world.x * invW, world.y * invW, world.z * invW, 1.0f };
+        return Transform(world, viewProj);
+    };
+
+    const std::uint16_t quad[6] = { 0, 1, 2, 2, 1, 3 };
+    for (std::uint32_t ty = 0; ty < previous.mTilesY; ++ty)
+    {
+        // Runs of tiles at the same depth go as one quad.
+        for (std::uint32_t tx = 0; tx < previous.mTilesX;)
+        {
+            const float depth = previous.TileDepth(tx, ty);
+            std::uint32_t end = tx + 1;
+            while (end < previous.mTilesX && previous.TileDepth(end, ty) == depth)
+                ++end;
+
+            if (depth < 1.0f)
+            {
+                const Float4 corners[4] =
+                {
+                    reproject(tx * TileWidth, ty * TileHeight, depth),
+                    reproject(end * TileWidth, ty * TileHeight, depth),
+                    reproject(tx * TileWidth, (ty + 1) * TileHeight, depth),
+                    reproject(end * TileWidth, (ty + 1) * TileHeight, depth),
+                };
+                RenderTriangles(corners, quad, 2);
+            }
+            tx = end;
+        }
+    }
+}
+
+bool MaskedOcclusionBuffer::IsRectVisible(float minX, float minY, float maxX, float maxY, float nearestDepth)const
+{
+    // Only the part on screen can be seen.
+    const int px0 = std::max(0, (int)std::floor(minX));
+    const int py0 = std::max(0, (int)std::floor(minY));
+    const int px1 = std::min((int)mWidth - 1, (int)std::floor(maxX));
+    const int py1 = std::min((int)mHeight - 1, (int)std::floor(maxY));
+    if (px0 > px1 || py0 > py1)
+        return true;
+
+    const std::uint32_t tx0 = px0 / TileWidth, tx1 = px1 / TileWidth;
+    for (std::uint32_t ty = py0 / TileHeight; ty <= (std::uint32_t)py1 / TileHeight; ++ty)
+    {
+        const float* row = mDepth0.data() + ty * mTileStride;
+#if defined(__AVX2__)
+        const __m256 nearest = _mm256_set1_ps(nearestDepth);
+        for (std::uint32_t tx = tx0; tx <= tx1; tx += 8)
+        {
+            std::uint32_t mask = (std::uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(row + tx), nearest, _CMP_GT_OQ));
+            if (tx1 - tx < 7)
+                mask &= (1u << (tx1 - tx + 1)) - 1;
+            if (mask != 0)
+                return true;
+        }
+#else
+        for (std::uint32_t tx = tx0; tx <= tx1; ++tx)
+        {
+            if (row[tx] > nearestDepth)
+                return true;
+        }
+#endif
+    }
+    return false;
+}
+
+bool MaskedOcclusionBuffer::IsBoxVisible(const Float3& center, const Float3& extents, const Float4x4& viewProj)const
+{
+    ScreenRect rect;
+    if (!ProjectBox(center, extents, viewProj, rect))
+        return true;
+    return IsRectVisible(rect.MinX, rect.MinY, rect.MaxX, rect.MaxY, rect.NearestDepth);
+}
+
+bool MaskedOcclusionBuffer::ProjectBox(const Float3& center, const Float3& extents, const Float4x4& viewProj, ScreenRect& rect)const
+{
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    float nearestDepth = 1.0f;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const Float4 p = {
+            center.x + ((corner & 1) ? extents.x : -extents.x),
+            center.y + ((corner & 2) ? extents.y : -extents.y),
+            center.z + ((corner & 4) ? extents.z : -extents.z), 1.0f };
+        const Float4 clip = Transform(p, viewProj);
+        if (!(clip.z > 0.0f))
+            return false;
+
+        const float invW = 1.0f / clip.w;
+        const float x = (clip.x * invW * 0.5f + 0.5f) * mWidth;
+        const float y = (0.5f - clip.y * invW * 0.5f) * mHeight;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearestDepth = std::min(nearestDepth, clip.z * invW);
+    }
+    rect = { minX, minY, maxX, maxY, nearestDepth };
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "SimdMath.h"
+
+#include <cstdint>
+#include <vector>
+
+// Coarse CPU depth buffer for occlusion culling, after masked software
+// occlusion culling (Andersson et al.).  The screen is split into tiles of
+// 8x4 pixels; instead of per-pixel depth each tile keeps
+//  - Depth0, a depth every pixel of the tile is known to be in front of,
+//  - a working layer: a 32-bit coverage mask and Depth1, the farthest
+//    depth of the triangles that set the mask.
+// When the mask fills up the working layer becomes the new Depth0.  Depths
+// are D3D clip z / w, 0 at the near plane and 1 at the far plane.
+//
+// Occluders are rasterized with their depth rounded away from the camera,
+// so a box the buffer calls hidden is hidden in a full depth buffer too.
+class MaskedOcclusionBuffer
+{
+public:
+    static constexpr std::uint32_t TileWidth = 8;
+    static constexpr std::uint32_t TileHeight = 4;
+
+    // Edge functions A * x + B * y + C of a screen space triangle, positive
+    // inside, and the farthest depth it can have.
+    struct Triangle
+    {
+        float A[3], B[3], C[3];
+        float MinX, MinY, MaxX, MaxY;
+        // Depth plane z = DepthX * x + DepthY * y + DepthC.
+        float DepthX, DepthY, DepthC;
+        float MaxDepth;
+    };
+
+    // Pixel rectangle and nearest depth of a projected box.
+    struct ScreenRect
+    {
+        float MinX, MinY, MaxX, MaxY;
+        float NearestDepth;
+    };
+
+    // width must be a multiple of TileWidth, height of TileHeight.
+    explicit MaskedOcclusionBuffer(std::uint32_t width = 256, std::uint32_t height = 128);
+
+    std::uint32_t Width()const { return mWidth; }
+    std::uint32_t Height()const { return mHeight; }
+    std::uint32_t TilesX()const { return mTilesX; }
+    std::uint32_t TilesY()const { return mTilesY; }
+
+    void Clear();
+
+    // Clip space positions of count vertices whose first three floats,
+    // every stride bytes, are a position; m is world * view * projection.
+    static void TransformVertices(const void* positions, std::uint32_t stride, std::uint32_t count,
+        const Float4x4& m, Float4* clipVertices);
+
+    // Rasterizes occluder triangles given by clip space vertices (row
+    // vector position times world * view * projection).  Triangles with a
+    // vertex behind the near plane are skipped, which only loses culling.
+    void RenderTriangles(const Float4* clipVertices, const std::uint16_t* indices, std::uint32_t triangleCount);
+    void RenderTriangles(const Float4* clipVertices, const std::uint32_t* indices, std::uint32_t triangleCount);
+
+    // Adds previous, a buffer rendered with previousViewProj, as occluders
+    // for viewProj: every tile becomes a quad at its Depth0.  Exact while
+    // the camera only rotates; after it moves, geometry close to it can
+    // uncover a little of what the quads hide, until the next frame.
+    void Reproject(const MaskedOcclusionBuffer& previous, const Float4x4& previousInvViewProj, const Float4x4& viewProj);
+
+    // Whether anything inside the pixel rectangle could be nearer than what
+    // the buffer holds.  Only the part on screen is tested; a rectangle
+    // entirely off screen counts as visible.
+    bool IsRectVisible(float minX, float minY, float maxX, float maxY, float nearestDepth)const;
+
+    // Same for a world space box seen through viewProj.  Boxes crossing the
+    // near plane are visible.
+    bool IsBoxVisible(const Float3& center, const Float3& extents, const Float4x4& viewProj)const;
+
+    // Projects a world space box into this buffer's pixels.  False if the
+    // box crosses the near plane, which leaves rect undefined.
+    bool ProjectBox(const Float3& center, const Float3& extents, const Float4x4& viewProj, ScreenRect& rect)const;
+
+    float TileDepth(std::uint32_t tileX, std::uint32_t tileY)const { return mDepth0[tileY * mTileStride + tileX]; }
+    std::uint32_t TileMask(std::uint32_t tileX, std::uint32_t tileY)const { return mMask[tileY * mTileStride + tileX]; }
+
+    // Screen space setup of a clip space triangle; false if it is skipped.
+    bool SetupTriangle(const Float4& v0, const Float4& v1, const Float4& v2, Triangle& tri)const;
+
+    // Pixel centers of the tile at pixel (x, y) inside tri, bit
+    // row * TileWidth + column.  Eight pixels per instruction with AVX2.
+    static std::uint32_t TileCoverage(const Triangle& tri, float x, float y);
+    // Same one pixel at a time, the reference for TileCoverage.
+    static std::uint32_t TileCoverageScalar(const Triangle& tri, float x, float y);
+
+private:
+    void RenderTriangle(const Triangle& tri);
+    void UpdateTile(std::uint32_t tile, std::uint32_t mask, float depth);
+
+    template<typename Index>
+    void RenderIndexed(const Float4* clipVertices, const Index* indices, std::uint32_t triangleCount);
+
+    std::uint32_t mWidth, mHeight;
+    std::uint32_t mTilesX, mTilesY;
+    // Rows padded to a multiple of eight tiles for the AVX2 depth test.
+    std::uint32_t mTileStride;
+
+    std::vector<float> mDepth0;
+    std::vector<float> mDepth1;
+    std::vector<std::uint32_t> mMask;
+};
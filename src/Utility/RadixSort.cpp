@@ -0,0 +1,110 @@
+#include "RadixSort.h"
+
+#include "ThreadPool.h"
+
+#include <cstring>
+#include <utility>
+
+void RadixSorter::Sort(std::uint64_t* keys, std::uint32_t* values, std::size_t count, ThreadPool* pool)
+{
+    if (count < 2)
+        return;
+
+    std::uint32_t blockCount = 1;
+    if (pool != nullptr && count >= ParallelThreshold)
+        blockCount = pool->ExecutorCount();
+
+    const std::size_t blockSize = (count + blockCount - 1) / blockCount;
+    auto forEachBlock = [&](auto&& fn)
+    {
+        auto run = [&](std::uint32_t block, std::uint32_t)
+        {
+            const std::size_t begin = block * blockSize;
+            const std::size_t end = begin + blockSize < count ? begin + blockSize : count;
+            if (begin < end)
+                fn(block, begin, end);
+        };
+
+        if (blockCount == 1)
+            run(0, 0);
+        else
+            pool->ParallelFor(blockCount, run);
+    };
+
+    mKeys.resize(count);
+    mValues.resize(count);
+    mHistograms.resize(blockCount * 256);
+    mBlockDiffs.assign(blockCount, 0);
+
+    // Bits that differ from the first key; a digit with none of them set
+    // would leave the order unchanged.
+    const std::uint64_t first = keys[0];
+    forEachBlock([&](std::uint32_t block, std::size_t begin, std::size_t end)
+    {
+        std::uint64_t diff = 0;
+        for (std::size_t i = begin; i < end; ++i)
+            diff |= keys[i] ^ first;
+        mBlockDiffs[block] = diff;
+    });
+
+    std::uint64_t diff = 0;
+    for (std::uint64_t blockDiff : mBlockDiffs)
+        diff |= blockDiff;
+
+    std::uint64_t* srcKeys = keys;
+    std::uint32_t* srcValues = values;
+    std::uint64_t* dstKeys = mKeys.data();
+    std::uint32_t* dstValues = mValues.data();
+
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        if (((diff >> shift) & 0xff) == 0)
+            continue;
+
+        forEachBlock([&](std::uint32_t block, std::size_t begin, std::size_t end)
+        {
+            std::size_t* histogram = &mHistograms[block * 256];
+            std::memset(histogram, 0, 256 * sizeof(std::size_t));
+            for (std::size_t i = begin; i < end; ++i)
+                ++histogram[(srcKeys[i] >> shift) & 0xff];
+        });
+
+        // Digit-major, block-minor prefix sum: block b writes its keys with
+        // digit d after those of every smaller digit and of blocks before b.
+        std::size_t offset = 0;
+        for (std::size_t digit = 0; digit < 256; ++digit)
+        {
+            for (std::uint32_t block = 0; block < blockCount; ++block)
+            {
+                std::size_t& slot = mHistograms[block * 256 + digit];
+                const std::size_t n = slot;
+                slot = offset;
+                offset += n;
+            }
+        }
+
+        forEachBlock([&](std::uint32_t block, std::size_t begin, std::size_t end)
+        {
+            std::size_t* offsets = &mHistograms[block * 256];
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                const std::size_t dst = offsets[(srcKeys[i] >> shift) & 0xff]++;
+                dstKeys[dst] = srcKeys[i];
+                dstValues[dst] = srcValues[i];
+            }
+        });
+
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcValues, dstValues);
+    }
+
+    // An odd number of passes leaves the result in the scratch buffers.
+    if (srcKeys != keys)
+    {
+        forEachBlock([&](std::uint32_t, std::size_t begin, std::size_t end)
+        {
+            std::memcpy(keys + begin, srcKeys + begin, (end - begin) * sizeof(std::uint64_t));
+            std::memcpy(values + begin, srcValues + begin, (end - begin) * sizeof(std::uint32_t));
+        });
+    }
+}
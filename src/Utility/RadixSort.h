@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// LSD radix sort of 64-bit keys with a 32-bit payload, eight bits per pass.
+// Passes over digits that are the same in every key are skipped, so keys
+// that only use a few fields cost a few passes.  Large inputs are split into
+// one contiguous block per executor: histograms and scatters run in
+// parallel and the block order keeps the sort stable.  Scratch memory is
+// kept between calls.
+class RadixSorter
+{
+public:
+    static constexpr std::size_t ParallelThreshold = 64 * 1024;
+
+    // Sorts keys ascending and moves values along with them.
+    void Sort(std::uint64_t* keys, std::uint32_t* values, std::size_t count, ThreadPool* pool = nullptr);
+
+private:
+    std::vector<std::uint64_t> mKeys;
+    std::vector<std::uint32_t> mValues;
+
+    // 256 counters per block, turned into scatter offsets in place.
+    std::vector<std::size_t> mHistograms;
+    std::vector<std::uint64_t> mBlockDiffs;
+};
@@ -0,0 +1,468 @@
+#include "SceneBvh.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+    float Axis(const Float3& v, int axis)
+    {
+        return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+    }
+
+    Float3 Min(const Float3& a, const Float3& b)
+    {
+        return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) };
+    }
+
+    Float3 Max(const Float3& a, const Float3& b)
+    {
+        return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) };
+    }
+
+    float SurfaceArea(const Float3& min, const Float3& max)
+    {
+        const float x = max.x - min.x, y = max.y - min.y, z = max.z - min.z;
+        return 2.0f * (x * y + y * z + z * x);
+    }
+
+    bool Equal(const Float3& a, const Float3& b)
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+
+    constexpr float Infinity = std::numeric_limits<float>::infinity();
+    const Float3 EmptyMin = { Infinity, Infinity, Infinity };
+    const Float3 EmptyMax = { -Infinity, -Infinity, -Infinity };
+
+    // Distance of the box center from the plane and the box's reach
+    // towards it.
+    void PlaneDistance(const Float4& p, const Float3& min, const Float3& max, float& distance, float& radius)
+    {
+        const float cx = (min.x + max.x) * 0.5f, cy = (min.y + max.y) * 0.5f, cz = (min.z + max.z) * 0.5f;
+        const float ex = (max.x - min.x) * 0.5f, ey = (max.y - min.y) * 0.5f, ez = (max.z - min.z) * 0.5f;
+        distance = cx * p.x + cy * p.y + cz * p.z + p.w;
+        radius = ex * std::fabs(p.x) + ey * std::fabs(p.y) + ez * std::fabs(p.z);
+    }
+}
+
+void SceneBvh::Build(const BoundsSoA& bounds, ThreadPool* pool)
+{
+    const std::uint32_t count = bounds.Count();
+    mItemMin.resize(count);
+    mItemMax.resize(count);
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        const Float3 c = bounds.Center(i), e = bounds.Extents(i);
+        mItemMin[i] = { c.x - e.x, c.y - e.y, c.z - e.z };
+        mItemMax[i] = { c.x + e.x, c.y + e.y, c.z + e.z };
+    }
+
+    mItems.resize(count);
+    std::iota(mItems.begin(), mItems.end(), 0u);
+    mItemLeaf.assign(count, InvalidNode);
+
+    BuildRoot(pool);
+}
+
+void SceneBvh::BuildRoot(ThreadPool* pool)
+{
+    const std::uint32_t count = ItemCount();
+
+    // A binary tree over n items has at most 2n - 1 nodes, so nodes never
+    // move while subtrees build in parallel.
+    mNodes.assign(count > 0 ? 2 * count - 1 : 1, Node{});
+    mNodeFlags.assign(mNodes.size(), 0);
+    mNodeCount = 1;
+    mDeadCount = 0;
+    mDirtyNodes.clear();
+
+    mNodes[0].Parent = InvalidNode;
+    mNodes[0].First = 0;
+    mNodes[0].Count = count;
+    if (count > 0)
+        BuildRange(0, pool);
+
+    mNodes.resize(mNodeCount);
+    mNodeFlags.resize(mNodeCount);
+}
+
+void SceneBvh::ComputeBounds(Node& node)const
+{
+    if (node.Left != 0)
+    {
+        const Node& left = mNodes[node.Left];
+        const Node& right = mNodes[node.Left + 1];
+        node.Min = Min(left.Min, right.Min);
+        node.Max = Max(left.Max, right.Max);
+        return;
+    }
+
+    node.Min = EmptyMin;
+    node.Max = EmptyMax;
+    for (std::uint32_t i = node.First; i < node.First + node.Count; ++i)
+    {
+        node.Min = Min(node.Min, mItemMin[mItems[i]]);
+        node.Max = Max(node.Max, mItemMax[mItems[i]]);
+    }
+}
+
+void SceneBvh::BuildNode(std::uint32_t index, ThreadPool* pool)
+{
+    Node& node = mNodes[index];
+    const std::uint32_t first = node.First, end = node.First + node.Count;
+
+    Float3 boundsMin = EmptyMin, boundsMax = EmptyMax;
+    Float3 centroidMin = EmptyMin, centroidMax = EmptyMax;
+    for (std::uint32_t i = first; i < end; ++i)
+    {
+        const BuildRef& ref = mRefs[i];
+        boundsMin = Min(boundsMin, ref.Min);
+        boundsMax = Max(boundsMax, ref.Max);
+        centroidMin = Min(centroidMin, Centroid(ref));
+        centroidMax = Max(centroidMax, Centroid(ref));
+    }
+    node.Left = 0;
+    node.Min = boundsMin;
+    node.Max = boundsMax;
+    node.BuildArea = SurfaceArea(boundsMin, boundsMax);
+
+    // Splitting the few items of a small node would save less than the
+    // nodes cost to visit.
+    if (node.Count <= MaxLeafSize)
+    {
+        for (std::uint32_t i = first; i < end; ++i)
+            mItemLeaf[mRefs[i].Item] = index;
+        return;
+    }
+
+    // Small nodes, most of the tree, get no more bins than items.
+    const std::uint32_t binCount = std::min(BinCount, node.Count);
+    const float origin[3] = { centroidMin.x, centroidMin.y, centroidMin.z };
+    float scale[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const float extent = Axis(centroidMax, axis) - origin[axis];
+        scale[axis] = extent > 0.0f ? binCount / extent : 0.0f;
+    }
+
+    auto binOf = [&](float centroid, int axis)
+    {
+        const int bin = (int)((centroid - origin[axis]) * scale[axis]);
+        return std::min((std::uint32_t)bin, binCount - 1);
+    };
+
+    struct Bin
+    {
+        std::uint32_t Count;
+        Float3 Min;
+        Float3 Max;
+    };
+
+    // All three axes are binned in one pass over the items.
+    Bin bins[3][BinCount];
+    for (int axis = 0; axis < 3; ++axis)
+        std::fill_n(bins[axis], binCount, Bin{ 0, EmptyMin, EmptyMax });
+    for (std::uint32_t i = first; i < end; ++i)
+    {
+        const BuildRef& ref = mRefs[i];
+        const Float3 c = Centroid(ref);
+        const float centroid[3] = { c.x, c.y, c.z };
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            Bin& bin = bins[axis][binOf(centroid[axis], axis)];
+            ++bin.Count;
+            bin.Min = Min(bin.Min, ref.Min);
+            bin.Max = Max(bin.Max, ref.Max);
+        }
+    }
+
+    float bestCost = Infinity;
+    int bestAxis = -1;
+    std::uint32_t bestSplit = 0;
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (scale[axis] == 0.0f)
+            continue;
+
+        // Cost of everything right of each split, then sweep from the left.
+        float rightCost[BinCount];
+        Bin right = { 0, EmptyMin, EmptyMax };
+        for (std::uint32_t b = binCount - 1; b > 0; --b)
+        {
+            right.Count += bins[axis][b].Count;
+            right.Min = Min(right.Min, bins[axis][b].Min);
+            right.Max = Max(right.Max, bins[axis][b].Max);
+            rightCost[b] = right.Count > 0 ? right.Count * SurfaceArea(right.Min, right.Max) : 0.0f;
+        }
+
+        Bin left = { 0, EmptyMin, EmptyMax };
+        for (std::uint32_t split = 1; split < binCount; ++split)
+        {
+            left.Count += bins[axis][split - 1].Count;
+            left.Min = Min(left.Min, bins[axis][split - 1].Min);
+            left.Max = Max(left.Max, bins[axis][split - 1].Max);
+            if (left.Count == 0 || left.Count == node.Count)
+                continue;
+
+            const float cost = left.Count * SurfaceArea(left.Min, left.Max) + rightCost[split];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    // Without a usable axis all centroids coincide and any split will do.
+    std::uint32_t mid = first + node.Count / 2;
+    if (bestAxis >= 0)
+    {
+        mid = (std::uint32_t)(std::partition(mRefs.begin() + first, mRefs.begin() + end,
+            [&](const BuildRef& ref) { return binOf(Axis(Centroid(ref), bestAxis), bestAxis) < bestSplit; }) - mRefs.begin());
+    }
+
+    const std::uint32_t left = mNodeCount.fetch_add(2);
+    mNodes[left].Parent = index;
+    mNodes[left].First = first;
+    mNodes[left].Count = mid - first;
+    mNodes[left + 1].Parent = index;
+    mNodes[left + 1].First = mid;
+    mNodes[left + 1].Count = end - mid;
+    mNodeFlags[left] = 0;
+    mNodeFlags[left + 1] = 0;
+    node.Left = left;
+
+    if (pool != nullptr && node.Count > ParallelThreshold)
+    {
+        pool->ParallelFor(2, [&](std::uint32_t child, std::uint32_t)
+        {
+            BuildNode(left + child, pool);
+        });
+    }
+    else
+    {
+        BuildNode(left, pool);
+        BuildNode(left + 1, pool);
+    }
+}
+
+void SceneBvh::BuildRange(std::uint32_t node, ThreadPool* pool)
+{
+    // The builder partitions copies of the boxes instead of chasing item
+    // indices around memory.
+    const std::uint32_t first = mNodes[node].First, end = first + mNodes[node].Count;
+    mRefs.resize(mItems.size());
+    for (std::uint32_t i = first; i < end; ++i)
+        mRefs[i] = { mItemMin[mItems[i]], mItems[i], mItemMax[mItems[i]] };
+
+    BuildNode(node, pool);
+
+    for (std::uint32_t i = first; i < end; ++i)
+        mItems[i] = mRefs[i].Item;
+}
+
+bool SceneBvh::SetBounds(std::uint32_t item, const Float3& center, const Float3& extents)
+{
+    const Float3 min = { center.x - extents.x, center.y - extents.y, center.z - extents.z };
+    const Float3 max = { center.x + extents.x, center.y + extents.y, center.z + extents.z };
+    if (Equal(min, mItemMin[item]) && Equal(max, mItemMax[item]))
+        return false;
+
+    mItemMin[item] = min;
+    mItemMax[item] = max;
+    MarkDirty(mItemLeaf[item]);
+    return true;
+}
+
+void SceneBvh::MarkDirty(std::uint32_t node)
+{
+    while (node != InvalidNode && !(mNodeFlags[node] & Dirty))
+    {
+        mNodeFlags[node] |= Dirty;
+        mDirtyNodes.push_back(node);
+        node = mNodes[node].Parent;
+    }
+}
+
+SceneBvh::RefitStats SceneBvh::Refit(ThreadPool* pool)
+{
+    RefitStats stats;
+    if (mDirtyNodes.empty())
+        return stats;
+
+    // Children always come after their parent, so going down the indices
+    // refits bottom up.
+    std::sort(mDirtyNodes.begin(), mDirtyNodes.end(), std::greater<std::uint32_t>());
+    for (std::uint32_t node : mDirtyNodes)
+        ComputeBounds(mNodes[node]);
+    stats.NodesRefitted = (std::uint32_t)mDirtyNodes.size();
+
+    // Top down, so a rebuilt subtree takes the loose nodes below it along.
+    for (auto it = mDirtyNodes.rbegin(); it != mDirtyNodes.rend(); ++it)
+    {
+        const Node& node = mNodes[*it];
+        if ((mNodeFlags[*it] & Dead) || node.Left == 0)
+            continue;
+        if (!(SurfaceArea(node.Min, node.Max) > RebuildRatio * node.BuildArea))
+            continue;
+
+        // Rebuilt subtrees leave their old nodes behind; once those would
+        // outnumber the live ones everything is rebuilt instead.
+        if (mDeadCount + 2 * node.Count > NodeCount())
+        {
+            BuildRoot(pool);
+            stats.FullRebuild = true;
+            return stats;
+        }
+        RebuildSubtree(*it, pool);
+        ++stats.SubtreesRebuilt;
+    }
+
+    for (std::uint32_t node : mDirtyNodes)
+        mNodeFlags[node] &= ~Dirty;
+    mDirtyNodes.clear();
+    return stats;
+}
+
+void SceneBvh::RebuildSubtree(std::uint32_t index, ThreadPool* pool)
+{
+    std::vector<std::uint32_t> stack = { mNodes[index].Left, mNodes[index].Left + 1 };
+    while (!stack.empty())
+    {
+        const std::uint32_t node = stack.back();
+        stack.pop_back();
+        mNodeFlags[node] |= Dead;
+        ++mDeadCount;
+        if (mNodes[node].Left != 0)
+        {
+            stack.push_back(mNodes[node].Left);
+            stack.push_back(mNodes[node].Left + 1);
+        }
+    }
+
+    // The new nodes go at the end, after the subtree root they hang off.
+    mNodes.resize(mNodeCount + 2 * mNodes[index].Count);
+    mNodeFlags.resize(mNodes.size());
+    BuildRange(index, pool);
+    mNodes.resize(mNodeCount);
+    mNodeFlags.resize(mNodeCount);
+}
+
+bool SceneBvh::Bounds(Float3& min, Float3& max)const
+{
+    if (mItems.empty())
+        return false;
+    min = mNodes[0].Min;
+    max = mNodes[0].Max;
+    return true;
+}
+
+void SceneBvh::Query(const Frustum& frustum, std::vector<std::uint32_t>& visible, QueryStats* stats)const
+{
+    if (mItems.empty())
+        return;
+
+    // Bit p set while plane p still has to be tested: a node entirely
+    // inside a plane passes that plane for its whole subtree.
+    struct Entry
+    {
+        std::uint32_t Node;
+        std::uint32_t Planes;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({ 0, 0x3f });
+
+    QueryStats counts;
+    while (!stack.empty())
+    {
+        const Entry entry = stack.back();
+        stack.pop_back();
+        ++counts.NodesVisited;
+
+        const Node& node = mNodes[entry.Node];
+        std::uint32_t planes = entry.Planes;
+        bool outside = false;
+        for (std::uint32_t remaining = planes; remaining != 0; remaining &= remaining - 1)
+        {
+            const int p = std::countr_zero(remaining);
+            float distance, radius;
+            PlaneDistance(frustum.Planes[p], node.Min, node.Max, distance, radius);
+            if (!(distance + radius >= 0.0f))
+            {
+                outside = true;
+                break;
+            }
+            if (distance - radius >= 0.0f)
+                planes &= ~(1u << p);
+        }
+        if (outside)
+            continue;
+
+        if (planes == 0)
+        {
+            visible.insert(visible.end(), mItems.begin() + node.First, mItems.begin() + node.First + node.Count);
+            ++counts.SubtreesAccepted;
+            continue;
+        }
+
+        if (node.Left != 0)
+        {
+            stack.push_back({ node.Left + 1, planes });
+            stack.push_back({ node.Left, planes });
+            continue;
+        }
+
+        for (std::uint32_t i = node.First; i < node.First + node.Count; ++i)
+        {
+            const std::uint32_t item = mItems[i];
+            bool inside = true;
+            for (std::uint32_t remaining = planes; remaining != 0 && inside; remaining &= remaining - 1)
+            {
+                float distance, radius;
+                PlaneDistance(frustum.Planes[std::countr_zero(remaining)], mItemMin[item], mItemMax[item], distance, radius);
+                inside = distance + radius >= 0.0f;
+            }
+            if (inside)
+                visible.push_back(item);
+        }
+    }
+
+    if (stats != nullptr)
+        *stats = counts;
+}
+
+float SceneBvh::Cost()const
+{
+    if (mItems.empty())
+        return 0.0f;
+
+    const float rootArea = SurfaceArea(mNodes[0].Min, mNodes[0].Max);
+    double cost = 0.0;
+    std::vector<std::uint32_t> stack = { 0 };
+    while (!stack.empty())
+    {
+        const Node& node = mNodes[stack.back()];
+        stack.pop_back();
+        const float area = SurfaceArea(node.Min, node.Max);
+        if (node.Left != 0)
+        {
+            cost += area;
+            stack.push_back(node.Left);
+            stack.push_back(node.Left + 1);
+        }
+        else
+        {
+            cost += (double)area * node.Count;
+        }
+    }
+    return rootArea > 0.0f ? (float)(cost / rootArea) : 0.0f;
+}
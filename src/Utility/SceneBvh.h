@@ -0,0 +1,123 @@
+#pragma once
+
+#include "FrustumCull.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Bounding volume hierarchy over the world boxes of a set of items, for
+// culling scenes too large to test item by item.  Built top-down with a
+// binned surface area heuristic, large subtrees in parallel.  Moving items
+// only refits the nodes above them; a refitted subtree whose surface area
+// grew past RebuildRatio times its area at build time is rebuilt in place.
+//
+// Every node covers a contiguous range of the item list, so a subtree
+// found entirely inside the frustum is accepted without visiting it.
+class SceneBvh
+{
+public:
+    static constexpr std::uint32_t MaxLeafSize = 4;
+    static constexpr std::uint32_t BinCount = 16;
+    // Subtrees with more items than this build on the thread pool.
+    static constexpr std::uint32_t ParallelThreshold = 4096;
+    static constexpr float RebuildRatio = 2.0f;
+
+    struct RefitStats
+    {
+        std::uint32_t NodesRefitted = 0;
+        std::uint32_t SubtreesRebuilt = 0;
+        bool FullRebuild = false;
+    };
+
+    struct QueryStats
+    {
+        std::uint32_t NodesVisited = 0;
+        std::uint32_t SubtreesAccepted = 0;
+    };
+
+    // Items are the boxes of bounds, by index.  pool may be null.
+    void Build(const BoundsSoA& bounds, ThreadPool* pool);
+
+    std::uint32_t ItemCount()const { return (std::uint32_t)mItemMin.size(); }
+    std::uint32_t NodeCount()const { return mNodeCount - mDeadCount; }
+
+    // Box around every item as of the last Build or Refit, false if there
+    // are no items.
+    bool Bounds(Float3& min, Float3& max)const;
+
+    // Moves an item.  Returns false, and changes nothing, if the box is
+    // the one it already had.
+    bool SetBounds(std::uint32_t item, const Float3& center, const Float3& extents);
+
+    // Brings the nodes above the items moved since the last call up to
+    // date and rebuilds the subtrees that got too loose.  pool may be null.
+    RefitStats Refit(ThreadPool* pool);
+
+    // Appends the items whose boxes pass FrustumCull::IsVisible, in no
+    // particular order.
+    void Query(const Frustum& frustum, std::vector<std::uint32_t>& visible, QueryStats* stats = nullptr)const;
+
+    // Surface area heuristic cost relative to the root box, the quality
+    // measure the builder minimizes.
+    float Cost()const;
+
+private:
+    static constexpr std::uint32_t InvalidNode = ~0u;
+
+    enum NodeFlags : std::uint8_t
+    {
+        Dirty = 1,
+        Dead = 2,
+    };
+
+    struct Node
+    {
+        Float3 Min;
+        // First of the two children, 0 for a leaf.
+        std::uint32_t Left;
+        Float3 Max;
+        std::uint32_t Parent;
+        // Range of mItems below the node.
+        std::uint32_t First;
+        std::uint32_t Count;
+        float BuildArea;
+    };
+
+    // An item's box while building, the nodes' ranges of mItems are
+    // sorted as these.
+    struct BuildRef
+    {
+        Float3 Min;
+        std::uint32_t Item;
+        Float3 Max;
+    };
+
+    // Centroids are kept doubled, min + max, which bins the same.
+    static Float3 Centroid(const BuildRef& ref)
+    {
+        return { ref.Min.x + ref.Max.x, ref.Min.y + ref.Max.y, ref.Min.z + ref.Max.z };
+    }
+
+    void BuildRoot(ThreadPool* pool);
+    void BuildRange(std::uint32_t node, ThreadPool* pool);
+    void BuildNode(std::uint32_t node, ThreadPool* pool);
+    void ComputeBounds(Node& node)const;
+    void RebuildSubtree(std::uint32_t node, ThreadPool* pool);
+    void MarkDirty(std::uint32_t node);
+
+    std::vector<Node> mNodes;
+    std::vector<std::uint8_t> mNodeFlags;
+    std::atomic<std::uint32_t> mNodeCount{ 0 };
+    std::uint32_t mDeadCount = 0;
+
+    // Item order the nodes' ranges refer to.
+    std::vector<std::uint32_t> mItems;
+    std::vector<std::uint32_t> mItemLeaf;
+    std::vector<Float3> mItemMin, mItemMax;
+
+    std::vector<std::uint32_t> mDirtyNodes;
+    std::vector<BuildRef> mRefs;
+};
@@ -0,0 +1,183 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    Float4x4 Multiply(const Float4x4& a, const Float4x4& b)
+    {
+        Float4x4 r;
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+                r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+        }
+        return r;
+    }
+
+    float Dot(const Float3& a, const Float3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    Float3 Cross(const Float3& a, const Float3& b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    Float3 Normalize(const Float3& v)
+    {
+        const float length = std::sqrt(Dot(v, v));
+        return { v.x / length, v.y / length, v.z / length };
+    }
+}
+
+void ShadowCascades::SplitDistances(float nearZ, float farZ, std::uint32_t count, float lambda, float* splitFar)
+{
+    for (std::uint32_t i = 1; i <= count; ++i)
+    {
+        const float p = (float)i / (float)count;
+        const float logSplit = nearZ * std::pow(farZ / nearZ, p);
+        const float uniformSplit = nearZ + (farZ - nearZ) * p;
+        splitFar[i - 1] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+    }
+    // Exactly farZ, whatever pow rounded to.
+    splitFar[count - 1] = farZ;
+}
+
+ShadowCascade ShadowCascades::FitCascade(const ShadowCamera& camera, float splitNear, float splitFar,
+    const Float3& lightDir, std::uint32_t resolution, const Float3& sceneMin, const Float3& sceneMax)
+{
+    // Bounding sphere of the slice.  Its center is on the view axis, where
+    // the near and far corners are equally far, unless that is past the far
+    // plane; only the fov and split distances go in, so the radius is the
+    // same every frame.
+    const float a2 = camera.TanHalfFovX * camera.TanHalfFovX + camera.TanHalfFovY * camera.TanHalfFovY;
+    const float centerDepth = std::min(0.5f * (splitNear + splitFar) * (1.0f + a2), splitFar);
+    const float nearDistance = std::sqrt(splitNear * splitNear * a2 + (centerDepth - splitNear) * (centerDepth - splitNear));
+    const float farDistance = std::sqrt(splitFar * splitFar * a2 + (splitFar - centerDepth) * (splitFar - centerDepth));
+    const float radius = std::max(nearDistance, farDistance);
+
+    const Float4x4& inv = camera.InvView;
+    const Float3 center = { inv.m[3][0] + centerDepth * inv.m[2][0], inv.m[3][1] + centerDepth * inv.m[2][1],
+        inv.m[3][2] + centerDepth * inv.m[2][2] };
+
+    // Light space axes; the origin stays at the world origin so snapping
+    // to texels in light space is snapping to a fixed grid.
+    const Float3 zAxis = Normalize(lightDir);
+    const Float3 up = std::fabs(zAxis.y) > 0.99f ? Float3{ 0.0f, 0.0f, 1.0f } : Float3{ 0.0f, 1.0f, 0.0f };
+    const Float3 xAxis = Normalize(Cross(up, zAxis));
+    const Float3 yAxis = Cross(zAxis, xAxis);
+
+    // Snapping moves the center by up to a texel, which one texel of
+    // margin on every side makes up for.
+    const float halfSize = radius * (float)resolution / (float)(resolution - 2);
+    const float texel = 2.0f * halfSize / (float)resolution;
+    const float cx = std::floor(Dot(center, xAxis) / texel) * texel;
+    const float cy = std::floor(Dot(center, yAxis) / texel) * texel;
+    const float cz = std::floor(Dot(center, zAxis) / texel) * texel;
+
+    // Depth starts at whatever in the scene is nearest the light, so every
+    // caster between the light and the slice is drawn, and ends where the
+    // slice or the scene does.
+    float zNear = cz - halfSize;
+    float zFar = cz + halfSize;
+    if (sceneMin.x <= sceneMax.x && sceneMin.y <= sceneMax.y && sceneMin.z <= sceneMax.z)
+    {
+        const Float3 sceneCenter = { 0.5f * (sceneMin.x + sceneMax.x), 0.5f * (sceneMin.y + sceneMax.y), 0.5f * (sceneMin.z + sceneMax.z) };
+        const Float3 sceneExtents = { 0.5f * (sceneMax.x - sceneMin.x), 0.5f * (sceneMax.y - sceneMin.y), 0.5f * (sceneMax.z - sceneMin.z) };
+        const float sceneDepth = Dot(sceneCenter, zAxis);
+        const float sceneRadius = sceneExtents.x * std::fabs(zAxis.x) + sceneExtents.y * std::fabs(zAxis.y) + sceneExtents.z * std::fabs(zAxis.z);
+        zNear = std::min(zNear, sceneDepth - sceneRadius);
+        zFar = std::max(std::min(zFar, sceneDepth + sceneRadius), zNear + texel);
+    }
+    // Coarse steps, so a caster moving a little does not change the depth
+    // range, and with it every cascade's matrix.
+    const float depthStep = 0.25f * halfSize;
+    zNear = std::floor(zNear / depthStep) * depthStep;
+    zFar = std::ceil(zFar / depthStep) * depthStep;
+
+    ShadowCascade cascade;
+    cascade.SplitNear = splitNear;
+    cascade.SplitFar = splitFar;
+
+    cascade.View = Float4x4::Identity();
+    const Float3 axes[3] = { xAxis, yAxis, zAxis };
+    for (int j = 0; j < 3; ++j)
+    {
+        cascade.View.m[0][j] = axes[j].x;
+        cascade.View.m[1][j] = axes[j].y;
+        cascade.View.m[2][j] = axes[j].z;
+    }
+
+    // XMMatrixOrthographicOffCenterLH.
+    const float left = cx - halfSize, right = cx + halfSize;
+    const float bottom = cy - halfSize, top = cy + halfSize;
+    cascade.Proj = Float4x4::Identity();
+    cascade.Proj.m[0][0] = 2.0f / (right - left);
+    cascade.Proj.m[1][1] = 2.0f / (top - bottom);
+    cascade.Proj.m[2][2] = 1.0f / (zFar - zNear);
+    cascade.Proj.m[3][0] = (left + right) / (left - right);
+    cascade.Proj.m[3][1] = (top + bottom) / (bottom - top);
+    cascade.Proj.m[3][2] = zNear / (zNear - zFar);
+
+    cascade.ViewProj = Multiply(cascade.View, cascade.Proj);
+
+    // NDC [-1, 1] to texture [0, 1], y down.
+    const Float4x4 toTexture = { { { 0.5f, 0.0f, 0.0f, 0.0f },
+                                   { 0.0f, -0.5f, 0.0f, 0.0f },
+                                   { 0.0f, 0.0f, 1.0f, 0.0f },
+                                   { 0.5f, 0.5f, 0.0f, 1.0f } } };
+    cascade.ShadowTransform = Multiply(cascade.ViewProj, toTexture);
+    cascade.CasterVolume = FrustumCull::ExtractFrustum(cascade.ViewProj);
+    return cascade;
+}
+
+void ShadowCache::Reset(std::uint32_t sliceCount)
+{
+    mKeys.assign(sliceCount, Hash128());
+    mValid.assign(sliceCount, 0);
+}
+
+void ShadowCache::Invalidate(std::uint32_t slice)
+{
+    mValid[slice] = 0;
+}
+
+bool ShadowCache::NeedsRender(std::uint32_t slice, const ShadowCascade& cascade,
+    const std::uint32_t* casters, std::uint32_t casterCount, const BoundsSoA& bounds)
+{
+    const Hash128 key = Key(cascade, casters, casterCount, bounds);
+    if (mValid[slice] && mKeys[slice] == key)
+        return false;
+    mKeys[slice] = key;
+    mValid[slice] = 1;
+    return true;
+}
+
+Hash128 ShadowCache::Key(const ShadowCascade& cascade, const std::uint32_t* casters, std::uint32_t casterCount, const BoundsSoA& bounds)
+{
+    // Casters come out of the BVH in no particular order, so their hashes
+    // are summed instead of chained.
+    Hash128 casterSum;
+    for (std::uint32_t i = 0; i < casterCount; ++i)
+    {
+        const std::uint32_t caster = casters[i];
+        const float box[6] = { bounds.CenterX()[caster], bounds.CenterY()[caster], bounds.CenterZ()[caster],
+            bounds.ExtentX()[caster], bounds.ExtentY()[caster], bounds.ExtentZ()[caster] };
+        StableHasher hasher;
+        hasher.Add(caster);
+        hasher.AddBytes(box, sizeof(box));
+        const Hash128 h = hasher.Finish();
+        casterSum.Lo += h.Lo;
+        casterSum.Hi += h.Hi;
+    }
+
+    StableHasher hasher;
+    hasher.AddBytes(cascade.ViewProj.m, sizeof(cascade.ViewProj.m));
+    hasher.Add(casterCount);
+    hasher.Add(casterSum.Lo);
+    hasher.Add(casterSum.Hi);
+    return hasher.Finish();
+}
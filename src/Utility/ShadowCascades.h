@@ -0,0 +1,74 @@
+#pragma once
+
+#include "FrustumCull.h"
+#include "StableHash.h"
+
+#include <cstdint>
+#include <vector>
+
+// One cascade of a directional light's shadow map.  Matrices are row
+// vector like XMMATRIX; depth is D3D style, 0 nearest to the light.
+struct ShadowCascade
+{
+    Float4x4 View;
+    Float4x4 Proj;
+    Float4x4 ViewProj;
+    // World to shadow map texture coordinates in xy and depth in z.
+    Float4x4 ShadowTransform;
+    // Planes of ViewProj.  Its near plane is pulled back to the scene
+    // bounds, so casters outside the camera's view that throw a shadow into
+    // the cascade are inside.
+    Frustum CasterVolume;
+    // View space depth range of the camera the cascade covers.
+    float SplitNear = 0.0f;
+    float SplitFar = 0.0f;
+};
+
+// Perspective camera the cascades are fitted to.
+struct ShadowCamera
+{
+    // View to world, row vector.
+    Float4x4 InvView;
+    float TanHalfFovX = 1.0f;
+    float TanHalfFovY = 1.0f;
+};
+
+namespace ShadowCascades
+{
+    // View space far distance of each of count cascades between nearZ and
+    // farZ.  lambda blends logarithmic (1) with uniform (0) splits.
+    void SplitDistances(float nearZ, float farZ, std::uint32_t count, float lambda, float* splitFar);
+
+    // Fits a cascade to the camera between splitNear and splitFar.  The
+    // cascade covers the bounding sphere of that slice, whose size does not
+    // change as the camera turns, and its origin is snapped to whole texels
+    // of a resolution x resolution map, so it does not swim as the camera
+    // moves and only changes when the camera crosses a texel.  lightDir is
+    // the direction the light travels in.
+    ShadowCascade FitCascade(const ShadowCamera& camera, float splitNear, float splitFar,
+        const Float3& lightDir, std::uint32_t resolution, const Float3& sceneMin, const Float3& sceneMax);
+}
+
+// Remembers what every slice of a shadow map was last drawn with, so a
+// slice is only drawn again when its matrix or one of its casters changed.
+// Static casters cost nothing after the first frame.
+class ShadowCache
+{
+public:
+    // Forgets all slices, which will all be drawn again.
+    void Reset(std::uint32_t sliceCount);
+    void Invalidate(std::uint32_t slice);
+
+    // Whether slice has to be drawn for cascade with the casters given by
+    // index into bounds.  The order of casters does not matter.  Returns
+    // true at most once for the same content, the caller has to draw it or
+    // call Invalidate.
+    bool NeedsRender(std::uint32_t slice, const ShadowCascade& cascade,
+        const std::uint32_t* casters, std::uint32_t casterCount, const BoundsSoA& bounds);
+
+    static Hash128 Key(const ShadowCascade& cascade, const std::uint32_t* casters, std::uint32_t casterCount, const BoundsSoA& bounds);
+
+private:
+    std::vector<Hash128> mKeys;
+    std::vector<std::uint8_t> mValid;
+};
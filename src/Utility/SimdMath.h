@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+// Plain float types shared by the CPU-side systems that must not pull in
+// DirectXMath or Windows headers.  They have the same layout as the
+// matching XMFLOAT types, see MathHelper for the conversions.
+
+struct Float3
+{
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+};
+
+struct Float4
+{
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 0.0f;
+};
+
+// Row-major, row vectors are multiplied from the left like XMMATRIX.
+struct Float4x4
+{
+    float m[4][4];
+
+    static Float4x4 Identity()
+    {
+        return { { { 1.0f, 0.0f, 0.0f, 0.0f },
+                   { 0.0f, 1.0f, 0.0f, 0.0f },
+                   { 0.0f, 0.0f, 1.0f, 0.0f },
+                   { 0.0f, 0.0f, 0.0f, 1.0f } } };
+    }
+};
@@ -0,0 +1,304 @@
+#include "SpecularPrefilter.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr float Pi = 3.14159265358979f;
+
+    // Rows of one face of one mip handed to a task.
+    constexpr std::uint32_t RowBand = 8;
+
+    float RadicalInverse(std::uint32_t bits)
+    {
+        bits = (bits << 16) | (bits >> 16);
+        bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+        bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+        bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+        bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+        return (float)bits * 2.3283064365386963e-10f;
+    }
+
+    // Trilinear: bilinear in the two source mips around lod.
+    Float3 SampleLod(const std::vector<CubeMapImage>& chain, float lod, std::uint32_t face, float u, float v)
+    {
+        const float maxLod = (float)(chain.size() - 1);
+        lod = std::min(lod, maxLod);
+        const std::uint32_t level = (std::uint32_t)lod;
+        const float t = lod - (float)level;
+        Float3 c = chain[level].Sample(face, u, v);
+        if (t > 0.0f)
+        {
+            const Float3 next = chain[level + 1].Sample(face, u, v);
+            c = { c.x + (next.x - c.x) * t, c.y + (next.y - c.y) * t, c.z + (next.z - c.z) * t };
+        }
+        return c;
+    }
+
+    // Orthonormal frame around n.
+    void TangentFrame(const Float3& n, Float3& tangentX, Float3& tangentY)
+    {
+        const Float3 up = std::fabs(n.z) < 0.999f ? Float3{ 0.0f, 0.0f, 1.0f } : Float3{ 1.0f, 0.0f, 0.0f };
+        Float3 x = { up.y * n.z - up.z * n.y, up.z * n.x - up.x * n.z, up.x * n.y - up.y * n.x };
+        const float length = std::sqrt(x.x * x.x + x.y * x.y + x.z * x.z);
+        tangentX = { x.x / length, x.y / length, x.z / length };
+        tangentY = { n.y * tangentX.z - n.z * tangentX.y, n.z * tangentX.x - n.x * tangentX.z, n.x * tangentX.y - n.y * tangentX.x };
+    }
+
+    Float3 TexelNormal(std::uint32_t face, std::uint32_t x, std::uint32_t y, std::uint32_t size)
+    {
+        const float u = ((float)x + 0.5f) * 2.0f / (float)size - 1.0f;
+        const float v = ((float)y + 0.5f) * 2.0f / (float)size - 1.0f;
+        const Float3 d = CubeMapImage::Direction(face, u, v);
+        const float length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+        return { d.x / length, d.y / length, d.z / length };
+    }
+
+    Float3 FilterTexel(const std::vector<CubeMapImage>& chain, const SpecularPrefilter::SampleSet& samples, const Float3& n)
+    {
+#if defined(__AVX2__)
+        Float3 tx, ty;
+        TangentFrame(n, tx, ty);
+        const __m256 txX = _mm256_set1_ps(tx.x), txY = _mm256_set1_ps(tx.y), txZ = _mm256_set1_ps(tx.z);
+        const __m256 tyX = _mm256_set1_ps(ty.x), tyY = _mm256_set1_ps(ty.y), tyZ = _mm256_set1_ps(ty.z);
+        const __m256 nX = _mm256_set1_ps(n.x), nY = _mm256_set1_ps(n.y), nZ = _mm256_set1_ps(n.z);
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        const __m256 zero = _mm256_setzero_ps();
+
+        // Same operations as FaceCoordinates, eight samples at a time; the
+        // texel reads stay scalar.
+        Float3 sum;
+        const std::size_t count = samples.X.size();
+        for (std::size_t s = 0; s < count; s += 8)
+        {
+            const __m256 lx = _mm256_loadu_ps(samples.X.data() + s);
+            const __m256 ly = _mm256_loadu_ps(samples.Y.data() + s);
+            const __m256 lz = _mm256_loadu_ps(samples.Z.data() + s);
+            const __m256 x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(txX, lx), _mm256_mul_ps(tyX, ly)), _mm256_mul_ps(nX, lz));
+            const __m256 y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(txY, lx), _mm256_mul_ps(tyY, ly)), _mm256_mul_ps(nY, lz));
+            const __m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(txZ, lx), _mm256_mul_ps(tyZ, ly)), _mm256_mul_ps(nZ, lz));
+
+            const __m256 ax = _mm256_andnot_ps(signMask, x);
+            const __m256 ay = _mm256_andnot_ps(signMask, y);
+            const __m256 az = _mm256_andnot_ps(signMask, z);
+            const __m256 xMajor = _mm256_and_ps(_mm256_cmp_ps(ax, ay, _CMP_GE_OQ), _mm256_cmp_ps(ax, az, _CMP_GE_OQ));
+            const __m256 yMajor = _mm256_andnot_ps(xMajor, _mm256_cmp_ps(ay, az, _CMP_GE_OQ));
+            const __m256 xPositive = _mm256_cmp_ps(x, zero, _CMP_GT_OQ);
+            const __m256 yPositive = _mm256_cmp_ps(y, zero, _CMP_GT_OQ);
+            const __m256 zPositive = _mm256_cmp_ps(z, zero, _CMP_GT_OQ);
+            const __m256 negX = _mm256_xor_ps(x, signMask), negY = _mm256_xor_ps(y, signMask), negZ = _mm256_xor_ps(z, signMask);
+
+            // z major first, then overridden by y and x major.
+            __m256 major = az;
+            __m256 uNum = _mm256_blendv_ps(negX, x, zPositive);
+            __m256 vNum = negY;
+            __m256 face = _mm256_blendv_ps(_mm256_set1_ps(5.0f), _mm256_set1_ps(4.0f), zPositive);
+
+            major = _mm256_blendv_ps(major, ay, yMajor);
+            uNum = _mm256_blendv_ps(uNum, x, yMajor);
+            vNum = _mm256_blendv_ps(vNum, _mm256_blendv_ps(negZ, z, yPositive), yMajor);
+            face = _mm256_blendv_ps(face, _mm256_blendv_ps(_mm256_set1_ps(3.0f), _mm256_set1_ps(2.0f), yPositive), yMajor);
+
+            major = _mm256_blendv_ps(major, ax, xMajor);
+            uNum = _mm256_blendv_ps(uNum, _mm256_blendv_ps(z, negZ, xPositive), xMajor);
+            vNum = _mm256_blendv_ps(vNum, negY, xMajor);
+            face = _mm256_blendv_ps(face, _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_set1_ps(0.0f), xPositive), xMajor);
+
+            alignas(32) float u[8], v[8], faces[8];
+            _mm256_store_ps(u, _mm256_div_ps(uNum, major));
+            _mm256_store_ps(v, _mm256_div_ps(vNum, major));
+            _mm256_store_ps(faces, face);
+
+            const std::size_t lanes = std::min<std::size_t>(8, count - s);
+            for (std::size_t lane = 0; lane < lanes; ++lane)
+            {
+                const float w = samples.Weight[s + lane];
+                if (w <= 0.0f)
+                    continue;
+                const Float3 c = SampleLod(chain, samples.Lod[s + lane], (std::uint32_t)faces[lane], u[lane], v[lane]);
+                sum = { sum.x + c.x * w, sum.y + c.y * w, sum.z + c.z * w };
+            }
+        }
+        return { sum.x / samples.WeightSum, sum.y / samples.WeightSum, sum.z / samples.WeightSum };
+#else
+        return SpecularPrefilter::FilterDirection(chain, samples, n);
+#endif
+    }
+}
+
+float SpecularPrefilter::MipRoughness(std::uint32_t mip, std::uint32_t mipCount)
+{
+    return mipCount > 1 ? (float)mip / (float)(mipCount - 1) : 0.0f;
+}
+
+SpecularPrefilter::SampleSet SpecularPrefilter::BuildSamples(float roughness, std::uint32_t sampleCount, std::uint32_t sourceSize)
+{
+    SampleSet set;
+    auto add = [&](float x, float y, float z, float weight, float lod)
+    {
+        set.X.push_back(x);
+        set.Y.push_back(y);
+        set.Z.push_back(z);
+        set.Weight.push_back(weight);
+        set.Lod.push_back(lod);
+        set.WeightSum += weight;
+    };
+
+    if (roughness <= 0.0f || sampleCount == 0)
+    {
+        // A mirror, the lobe is the reflection vector.
+        add(0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
+    }
+    else
+    {
+        const float alpha = roughness * roughness;
+        const float alpha2 = alpha * alpha;
+        const float texelSolidAngle = 4.0f * Pi / (6.0f * (float)sourceSize * (float)sourceSize);
+        for (std::uint32_t i = 0; i < sampleCount; ++i)
+        {
+            const float phi = 2.0f * Pi * (float)i / (float)sampleCount;
+            const float xi = RadicalInverse(i);
+            const float cosTheta = std::sqrt((1.0f - xi) / (1.0f + (alpha2 - 1.0f) * xi));
+            const float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+
+            // Half vector, reflected about it with v = n = +z.
+            const float hx = sinTheta * std::cos(phi), hy = sinTheta * std::sin(phi);
+            const float lz = 2.0f * cosTheta * cosTheta - 1.0f;
+            if (lz <= 0.0f)
+                continue;
+
+            // pdf of l is D(h) (n.h) / (4 (v.h)), D / 4 when n = v.
+            const float d = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+            const float pdf = alpha2 / (Pi * d * d) * 0.25f;
+            // The mip whose texels cover the sample's share of the lobe.  No
+            // +1 bias on top: it doubles the footprint and, at 64 samples,
+            // puts rough lobes over 10% off the GGX integral.
+            const float sampleSolidAngle = 1.0f / ((float)sampleCount * pdf);
+            const float lod = std::max(0.5f * std::log2(sampleSolidAngle / texelSolidAngle), 0.0f);
+            add(2.0f * cosTheta * hx, 2.0f * cosTheta * hy, lz, lz, lod);
+        }
+    }
+
+    // Padding for the eight wide loads, weightless.
+    while (set.X.size() % 8 != 0)
+    {
+        set.X.push_back(0.0f);
+        set.Y.push_back(0.0f);
+        set.Z.push_back(1.0f);
+        set.Weight.push_back(0.0f);
+        set.Lod.push_back(0.0f);
+    }
+    return set;
+}
+
+Float3 SpecularPrefilter::FilterDirection(const std::vector<CubeMapImage>& sourceChain, const SampleSet& samples, const Float3& dir)
+{
+    Float3 tx, ty;
+    TangentFrame(dir, tx, ty);
+
+    Float3 sum;
+    for (std::size_t s = 0; s < samples.X.size(); ++s)
+    {
+        const float w = samples.Weight[s];
+        if (w <= 0.0f)
+            continue;
+        const float lx = samples.X[s], ly = samples.Y[s], lz = samples.Z[s];
+        const Float3 l = { tx.x * lx + ty.x * ly + dir.x * lz, tx.y * lx + ty.y * ly + dir.y * lz, tx.z * lx + ty.z * ly + dir.z * lz };
+
+        std::uint32_t face;
+        float u, v;
+        CubeMapImage::FaceCoordinates(l, face, u, v);
+        const Float3 c = SampleLod(sourceChain, samples.Lod[s], face, u, v);
+        sum = { sum.x + c.x * w, sum.y + c.y * w, sum.z + c.z * w };
+    }
+    return { sum.x / samples.WeightSum, sum.y / samples.WeightSum, sum.z / samples.WeightSum };
+}
+
+std::vector<CubeMapImage> SpecularPrefilter::Prefilter(const CubeMapImage& source, const Settings& settings, ThreadPool* pool)
+{
+    const std::vector<CubeMapImage> chain = source.MipChain();
+    std::size_t base = 0;
+    while (chain[base].Size() > settings.MaxSize && base + 1 < chain.size())
+        ++base;
+
+    // As many mips as fit, each half the size of the one before.
+    const std::uint32_t mipCount = std::min<std::uint32_t>(std::max(settings.MipCount, 1u), (std::uint32_t)(chain.size() - base));
+    std::vector<CubeMapImage> mips;
+    mips.push_back(chain[base]);
+    std::vector<SampleSet> samples(mipCount);
+    for (std::uint32_t mip = 1; mip < mipCount; ++mip)
+    {
+        mips.emplace_back(chain[base + mip].Size());
+        samples[mip] = BuildSamples(MipRoughness(mip, mipCount), settings.SampleCount, source.Size());
+    }
+
+    struct Task
+    {
+        std::uint32_t Mip, Face, Begin, End;
+    };
+    std::vector<Task> tasks;
+    for (std::uint32_t mip = 1; mip < mipCount; ++mip)
+    {
+        const std::uint32_t size = mips[mip].Size();
+        for (std::uint32_t face = 0; face < 6; ++face)
+        {
+            for (std::uint32_t begin = 0; begin < size; begin += RowBand)
+                tasks.push_back({ mip, face, begin, std::min(begin + RowBand, size) });
+        }
+    }
+
+    auto filterBand = [&](std::uint32_t index, std::uint32_t)
+    {
+        const Task& task = tasks[index];
+        CubeMapImage& mip = mips[task.Mip];
+        CubeMapImage::Face& out = mip.GetFace(task.Face);
+        const std::uint32_t size = mip.Size();
+        for (std::uint32_t y = task.Begin; y < task.End; ++y)
+        {
+            for (std::uint32_t x = 0; x < size; ++x)
+            {
+                const Float3 c = FilterTexel(chain, samples[task.Mip], TexelNormal(task.Face, x, y, size));
+                const std::size_t i = (std::size_t)y * size + x;
+                out.R[i] = c.x;
+                out.G[i] = c.y;
+                out.B[i] = c.z;
+            }
+        }
+    };
+
+    if (pool == nullptr)
+    {
+        for (std::uint32_t i = 0; i < (std::uint32_t)tasks.size(); ++i)
+            filterBand(i, 0);
+    }
+    else
+    {
+        pool->ParallelFor((std::uint32_t)tasks.size(), filterBand);
+    }
+    return mips;
+}
+
+Hash128 SpecularPrefilter::Key(const CubeMapImage& source, const Settings& settings)
+{
+    StableHasher hasher;
+    hasher.AddString("GGX prefilter 2");
+    hasher.Add(settings.MaxSize);
+    hasher.Add(settings.MipCount);
+    hasher.Add(settings.SampleCount);
+    hasher.Add(source.Size());
+    for (std::uint32_t face = 0; face < 6; ++face)
+    {
+        const CubeMapImage::Face& f = source.GetFace(face);
+        hasher.AddBytes(f.R.data(), f.R.size() * sizeof(float));
+        hasher.AddBytes(f.G.data(), f.G.size() * sizeof(float));
+        hasher.AddBytes(f.B.data(), f.B.size() * sizeof(float));
+    }
+    return hasher.Finish();
+}
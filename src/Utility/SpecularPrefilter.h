@@ -0,0 +1,48 @@
+#pragma once
+
+#include "CubeMapImage.h"
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Prefiltered specular cube map for the split sum approximation (Karis):
+// mip m holds the environment convolved with a GGX lobe of roughness
+// m / (MipCount - 1) around the reflection vector, taking n = v = r.  Samples
+// are importance sampled and read from a mip of the source that matches
+// their solid angle (Colbert and Krivanek), so few of them stay smooth.
+namespace SpecularPrefilter
+{
+    struct Settings
+    {
+        // Mip 0 is the source, downsampled to at most this size.
+        std::uint32_t MaxSize = 512;
+        std::uint32_t MipCount = 6;
+        std::uint32_t SampleCount = 64;
+    };
+
+    float MipRoughness(std::uint32_t mip, std::uint32_t mipCount);
+
+    // GGX samples around +z for one roughness: the light direction, its
+    // n dot l weight and the source mip to read it from, for a source whose
+    // mip 0 is sourceSize.  Samples below the horizon are left out.
+    struct SampleSet
+    {
+        std::vector<float> X, Y, Z, Weight, Lod;
+        float WeightSum = 0.0f;
+    };
+    SampleSet BuildSamples(float roughness, std::uint32_t sampleCount, std::uint32_t sourceSize);
+
+    // The mips of the prefiltered cube map, largest first.  Every mip and
+    // face is split into bands of rows on pool; eight samples of a texel are
+    // turned into face coordinates per instruction with AVX2.
+    std::vector<CubeMapImage> Prefilter(const CubeMapImage& source, const Settings& settings, ThreadPool* pool);
+
+    // One direction of one roughness in scalar code, from the mip chain
+    // of the source; the reference for Prefilter.
+    Float3 FilterDirection(const std::vector<CubeMapImage>& sourceChain, const SampleSet& samples, const Float3& dir);
+
+    // Cache key of the prefiltered cube map of source with settings.
+    Hash128 Key(const CubeMapImage& source, const Settings& settings);
+}
@@ -0,0 +1,272 @@
+#include "SphericalHarmonics.h"
+
+#include "CubeMapImage.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr float K0 = 0.282095f;  // 1 / (2 sqrt(pi))
+    constexpr float K1 = 0.488603f;  // sqrt(3) / (2 sqrt(pi))
+    constexpr float K2 = 1.092548f;  // sqrt(15) / (2 sqrt(pi))
+    constexpr float K20 = 0.315392f; // sqrt(5) / (4 sqrt(pi))
+    constexpr float K22 = 0.546274f; // sqrt(15) / (4 sqrt(pi))
+    constexpr double Pi = 3.14159265358979323846;
+
+    // Rows of one face handed to a task.
+    constexpr std::uint32_t RowBand = 16;
+
+    // Solid angle weighted sums of a band of rows, 3 channels per
+    // coefficient, and the sum of the weights.
+    struct Partial
+    {
+        double Sum[27] = {};
+        double Weight = 0.0;
+    };
+
+    // Solid angle of a texel at (u, v) on a face, dA / (1 + u^2 + v^2)^1.5.
+    // The weights are normalized to 4 pi afterwards, which makes up for
+    // the approximation.
+    void AddTexel(const CubeMapImage::FaceBasis& basis, double u, double v, double texelArea,
+        double r, double g, double b, Partial& partial)
+    {
+        double x = basis.U.x * u + basis.V.x * v + basis.Normal.x;
+        double y = basis.U.y * u + basis.V.y * v + basis.Normal.y;
+        double z = basis.U.z * u + basis.V.z * v + basis.Normal.z;
+        const double lengthSq = u * u + v * v + 1.0;
+        const double invLength = 1.0 / std::sqrt(lengthSq);
+        x *= invLength;
+        y *= invLength;
+        z *= invLength;
+        const double w = texelArea * invLength * invLength * invLength;
+
+        const double basisValues[9] = { K0, K1 * y, K1 * z, K1 * x, K2 * x * y, K2 * y * z,
+            K20 * (3.0 * z * z - 1.0), K2 * x * z, K22 * (x * x - y * y) };
+        for (int k = 0; k < 9; ++k)
+        {
+            partial.Sum[3 * k + 0] += basisValues[k] * w * r;
+            partial.Sum[3 * k + 1] += basisValues[k] * w * g;
+            partial.Sum[3 * k + 2] += basisValues[k] * w * b;
+        }
+        partial.Weight += w;
+    }
+
+    void ProjectRowsScalar(const CubeMapImage& image, std::uint32_t face, std::uint32_t begin, std::uint32_t end, Partial& partial)
+    {
+        const std::uint32_t size = image.Size();
+        const double step = 2.0 / size;
+        const CubeMapImage::FaceBasis& basis = CubeMapImage::Basis(face);
+        const CubeMapImage::Face& texels = image.GetFace(face);
+        for (std::uint32_t y = begin; y < end; ++y)
+        {
+            const double v = (y + 0.5) * step - 1.0;
+            for (std::uint32_t x = 0; x < size; ++x)
+            {
+                const std::size_t i = (std::size_t)y * size + x;
+                AddTexel(basis, (x + 0.5) * step - 1.0, v, step * step, texels.R[i], texels.G[i], texels.B[i], partial);
+            }
+        }
+    }
+
+    void ProjectRows(const CubeMapImage& image, std::uint32_t face, std::uint32_t begin, std::uint32_t end, Partial& partial)
+    {
+#if defined(__AVX2__)
+        const std::uint32_t size = image.Size();
+        const float step = 2.0f / (float)size;
+        const CubeMapImage::FaceBasis& basis = CubeMapImage::Basis(face);
+        const CubeMapImage::Face& texels = image.GetFace(face);
+
+        const __m256 laneOffset = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 stepV = _mm256_set1_ps(step);
+        const __m256 texelArea = _mm256_set1_ps(step * step);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 three = _mm256_set1_ps(3.0f);
+        const __m256 uX = _mm256_set1_ps(basis.U.x), uY = _mm256_set1_ps(basis.U.y), uZ = _mm256_set1_ps(basis.U.z);
+        const __m256 k1 = _mm256_set1_ps(K1), k2 = _mm256_set1_ps(K2), k20 = _mm256_set1_ps(K20), k22 = _mm256_set1_ps(K22);
+
+        const std::uint32_t simdEnd = size & ~7u;
+        for (std::uint32_t y = begin; y < end; ++y)
+        {
+            const float v = ((float)y + 0.5f) * step - 1.0f;
+            const __m256 rowX = _mm256_set1_ps(basis.V.x * v + basis.Normal.x);
+            const __m256 rowY = _mm256_set1_ps(basis.V.y * v + basis.Normal.y);
+            const __m256 rowZ = _mm256_set1_ps(basis.V.z * v + basis.Normal.z);
+            const __m256 rowLengthSq = _mm256_set1_ps(v * v + 1.0f);
+
+            // One row in float, added to the double sums at its end.
+            __m256 sum[27];
+            for (__m256& s : sum)
+                s = _mm256_setzero_ps();
+            __m256 weightSum = _mm256_setzero_ps();
+
+            const std::size_t rowStart = (std::size_t)y * size;
+            for (std::uint32_t x = 0; x < simdEnd; x += 8)
+            {
+                const __m256 u = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)x), laneOffset), stepV), one);
+                const __m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(u, u), rowLengthSq)));
+                const __m256 dx = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(uX, u), rowX), invLength);
+                const __m256 dy = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(uY, u), rowY), invLength);
+                const __m256 dz = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(uZ, u), rowZ), invLength);
+                const __m256 w = _mm256_mul_ps(texelArea, _mm256_mul_ps(invLength, _mm256_mul_ps(invLength, invLength)));
+
+                const __m256 basisValues[9] =
+                {
+                    _mm256_set1_ps(K0),
+                    _mm256_mul_ps(k1, dy),
+                    _mm256_mul_ps(k1, dz),
+                    _mm256_mul_ps(k1, dx),
+                    _mm256_mul_ps(k2, _mm256_mul_ps(dx, dy)),
+                    _mm256_mul_ps(k2, _mm256_mul_ps(dy, dz)),
+                    _mm256_mul_ps(k20, _mm256_sub_ps(_mm256_mul_ps(three, _mm256_mul_ps(dz, dz)), one)),
+                    _mm256_mul_ps(k2, _mm256_mul_ps(dx, dz)),
+                    _mm256_mul_ps(k22, _mm256_sub_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy))),
+                };
+                const __m256 color[3] =
+                {
+                    _mm256_mul_ps(w, _mm256_loadu_ps(texels.R.data() + rowStart + x)),
+                    _mm256_mul_ps(w, _mm256_loadu_ps(texels.G.data() + rowStart + x)),
+                    _mm256_mul_ps(w, _mm256_loadu_ps(texels.B.data() + rowStart + x)),
+                };
+                for (int k = 0; k < 9; ++k)
+                {
+                    for (int c = 0; c < 3; ++c)
+                        sum[3 * k + c] = _mm256_add_ps(sum[3 * k + c], _mm256_mul_ps(basisValues[k], color[c]));
+                }
+                weightSum = _mm256_add_ps(weightSum, w);
+            }
+
+            alignas(32) float lanes[8];
+            for (int k = 0; k < 27; ++k)
+            {
+                _mm256_store_ps(lanes, sum[k]);
+                for (float lane : lanes)
+                    partial.Sum[k] += lane;
+            }
+            _mm256_store_ps(lanes, weightSum);
+            for (float lane : lanes)
+                partial.Weight += lane;
+
+            for (std::uint32_t x = simdEnd; x < size; ++x)
+            {
+                const std::size_t i = rowStart + x;
+                AddTexel(basis, ((double)x + 0.5) * step - 1.0, v, (double)step * step, texels.R[i], texels.G[i], texels.B[i], partial);
+            }
+        }
+#else
+        ProjectRowsScalar(image, face, begin, end, partial);
+#endif
+    }
+
+    SH9Color Finish(const Partial* partials, std::size_t count)
+    {
+        Partial total;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            for (int k = 0; k < 27; ++k)
+                total.Sum[k] += partials[i].Sum[k];
+            total.Weight += partials[i].Weight;
+        }
+
+        SH9Color sh;
+        if (total.Weight <= 0.0)
+            return sh;
+        const double scale = 4.0 * Pi / total.Weight;
+        for (int k = 0; k < 9; ++k)
+            sh.C[k] = { (float)(total.Sum[3 * k] * scale), (float)(total.Sum[3 * k + 1] * scale), (float)(total.Sum[3 * k + 2] * scale) };
+        return sh;
+    }
+}
+
+void SphericalHarmonics::EvaluateBasis(const Float3& dir, float basis[9])
+{
+    const float x = dir.x, y = dir.y, z = dir.z;
+    basis[0] = K0;
+    basis[1] = K1 * y;
+    basis[2] = K1 * z;
+    basis[3] = K1 * x;
+    basis[4] = K2 * x * y;
+    basis[5] = K2 * y * z;
+    basis[6] = K20 * (3.0f * z * z - 1.0f);
+    basis[7] = K2 * x * z;
+    basis[8] = K22 * (x * x - y * y);
+}
+
+Float3 SphericalHarmonics::Evaluate(const SH9Color& sh, const Float3& dir)
+{
+    float basis[9];
+    EvaluateBasis(dir, basis);
+    Float3 result;
+    for (int k = 0; k < 9; ++k)
+    {
+        result.x += sh.C[k].x * basis[k];
+        result.y += sh.C[k].y * basis[k];
+        result.z += sh.C[k].z * basis[k];
+    }
+    return result;
+}
+
+SH9Color SphericalHarmonics::ProjectCubeMap(const CubeMapImage& image, ThreadPool* pool)
+{
+    const std::uint32_t bands = (image.Size() + RowBand - 1) / RowBand;
+    std::vector<Partial> partials(6 * (std::size_t)bands);
+    auto projectBand = [&](std::uint32_t task, std::uint32_t)
+    {
+        const std::uint32_t face = task / bands;
+        const std::uint32_t begin = (task % bands) * RowBand;
+        const std::uint32_t end = std::min(begin + RowBand, image.Size());
+        ProjectRows(image, face, begin, end, partials[task]);
+    };
+
+    if (pool == nullptr)
+    {
+        for (std::uint32_t task = 0; task < (std::uint32_t)partials.size(); ++task)
+            projectBand(task, 0);
+    }
+    else
+    {
+        pool->ParallelFor((std::uint32_t)partials.size(), projectBand);
+    }
+    return Finish(partials.data(), partials.size());
+}
+
+SH9Color SphericalHarmonics::ProjectCubeMapScalar(const CubeMapImage& image)
+{
+    Partial partial;
+    for (std::uint32_t face = 0; face < 6; ++face)
+        ProjectRowsScalar(image, face, 0, image.Size(), partial);
+    return Finish(&partial, 1);
+}
+
+SH9Color SphericalHarmonics::IrradianceFromRadiance(const SH9Color& radiance)
+{
+    // Cosine lobe per band, pi, 2 pi / 3 and pi / 4, over pi.
+    const float bandScale[3] = { 1.0f, 2.0f / 3.0f, 0.25f };
+    SH9Color irradiance;
+    for (int k = 0; k < 9; ++k)
+    {
+        const float s = bandScale[k == 0 ? 0 : (k < 4 ? 1 : 2)];
+        irradiance.C[k] = { radiance.C[k].x * s, radiance.C[k].y * s, radiance.C[k].z * s };
+    }
+    return irradiance;
+}
+
+SH9Color SphericalHarmonics::Constant(const Float3& value)
+{
+    SH9Color sh;
+    sh.C[0] = { value.x / K0, value.y / K0, value.z / K0 };
+    return sh;
+}
+
+void SphericalHarmonics::ToShaderConstants(const SH9Color& sh, Float4 constants[9])
+{
+    const float scale[9] = { K0, K1, K1, K1, K2, K2, K20, K2, K22 };
+    for (int k = 0; k < 9; ++k)
+        constants[k] = { sh.C[k].x * scale[k], sh.C[k].y * scale[k], sh.C[k].z * scale[k], 0.0f };
+}
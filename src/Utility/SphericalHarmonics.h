@@ -0,0 +1,43 @@
+#pragma once
+
+#include "SimdMath.h"
+
+#include <cstdint>
+
+class CubeMapImage;
+class ThreadPool;
+
+// RGB function on the sphere in the real spherical harmonics of bands 0 to
+// 2, coefficients in the order Y00, Y1-1, Y10, Y11, Y2-2, Y2-1, Y20, Y21,
+// Y22.
+struct SH9Color
+{
+    Float3 C[9];
+};
+
+namespace SphericalHarmonics
+{
+    void EvaluateBasis(const Float3& dir, float basis[9]);
+    Float3 Evaluate(const SH9Color& sh, const Float3& dir);
+
+    // Projects the radiance of a cube map, every texel weighted by the
+    // solid angle it covers.  Rows of all faces are spread over pool and
+    // summed in a fixed order, so the result does not depend on it; eight
+    // texels per instruction with AVX2.
+    SH9Color ProjectCubeMap(const CubeMapImage& image, ThreadPool* pool);
+    // Same one texel at a time in double, the reference for ProjectCubeMap.
+    SH9Color ProjectCubeMapScalar(const CubeMapImage& image);
+
+    // Radiance convolved with the clamped cosine and divided by pi
+    // (Ramamoorthi and Hanrahan): Evaluate of the result at n is the light
+    // a white Lambertian surface facing n reflects.
+    SH9Color IrradianceFromRadiance(const SH9Color& radiance);
+
+    // The same value in every direction.
+    SH9Color Constant(const Float3& value);
+
+    // Coefficients with the basis constants folded in, for shaders: the
+    // value at unit n is c0 + c1 n.y + c2 n.z + c3 n.x + c4 n.x n.y +
+    // c5 n.y n.z + c6 (3 n.z^2 - 1) + c7 n.x n.z + c8 (n.x^2 - n.y^2).
+    void ToShaderConstants(const SH9Color& sh, Float4 constants[9]);
+}
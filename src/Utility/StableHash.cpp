@@ -0,0 +1,116 @@
+#include "StableHash.h"
+
+namespace
+{
+    constexpr std::uint64_t Prime1 = 0x9e3779b185ebca87ull;
+    constexpr std::uint64_t Prime2 = 0xc2b2ae3d27d4eb4full;
+    constexpr std::uint64_t Prime3 = 0x165667b19e3779f9ull;
+
+    std::uint64_t Rotl(std::uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    // MurmurHash3 finalizer.
+    std::uint64_t Avalanche(std::uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+}
+
+std::string Hash128::ToHex()const
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(32, '0');
+    for (int i = 0; i < 16; ++i)
+    {
+        hex[15 - i] = digits[(Hi >> (i * 4)) & 0xf];
+        hex[31 - i] = digits[(Lo >> (i * 4)) & 0xf];
+    }
+    return hex;
+}
+
+StableHasher::StableHasher(std::uint64_t seed)
+{
+    mState[0] = seed + Prime1;
+    mState[1] = Rotl(seed, 32) ^ Prime2;
+}
+
+void StableHasher::AddBytes(const void* data, std::size_t size)
+{
+    auto bytes = static_cast<const std::uint8_t*>(data);
+    mLength += size;
+
+    // Top up a partial word first so word boundaries do not depend on how
+    // the input was split.
+    while (size > 0 && mTailBytes != 0)
+    {
+        mTail |= std::uint64_t(*bytes++) << (mTailBytes * 8);
+        --size;
+        if (++mTailBytes == 8)
+        {
+            Consume(mTail);
+            mTail = 0;
+            mTailBytes = 0;
+        }
+    }
+
+    for (; size >= 8; size -= 8, bytes += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        Consume(word);
+    }
+
+    for (; size > 0; --size)
+        mTail |= std::uint64_t(*bytes++) << (mTailBytes++ * 8);
+}
+
+void StableHasher::AddString(const char* str)
+{
+    if (!str)
+    {
+        Add(~0ull);
+        return;
+    }
+
+    const std::uint64_t length = std::strlen(str);
+    Add(length);
+    AddBytes(str, (std::size_t)length);
+}
+
+void StableHasher::AddString(const std::string& str)
+{
+    const std::uint64_t length = str.size();
+    Add(length);
+    AddBytes(str.data(), str.size());
+}
+
+Hash128 StableHasher::Finish()const
+{
+    std::uint64_t a = mState[0];
+    std::uint64_t b = mState[1];
+
+    // The tail and the length go in last, so inputs that only differ in
+    // trailing zero bytes still hash apart.
+    a ^= Avalanche(mTail + Prime3);
+    b += Avalanche(mLength ^ Prime1);
+    a = Avalanche(a + Rotl(b, 17));
+    b = Avalanche(b ^ Rotl(a, 41));
+
+    Hash128 h;
+    h.Lo = a;
+    h.Hi = b;
+    return h;
+}
+
+void StableHasher::Consume(std::uint64_t word)
+{
+    mState[0] = Rotl(mState[0] ^ Avalanche(word + Prime2), 27) * Prime1 + Prime3;
+    mState[1] = Rotl(mState[1] + word * Prime3, 31) * Prime2 ^ mState[0];
+}
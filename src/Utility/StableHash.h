@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// 128-bit content hash.  Used as a cache key, so it has to be the same on
+// every run and every machine: only values are hashed, never addresses.
+struct Hash128
+{
+    std::uint64_t Lo = 0;
+    std::uint64_t Hi = 0;
+
+    bool operator==(const Hash128& rhs)const = default;
+
+    // 32 lowercase hex digits, Hi first.
+    std::string ToHex()const;
+};
+
+struct Hash128Hasher
+{
+    std::size_t operator()(const Hash128& h)const { return (std::size_t)h.Lo; }
+};
+
+// Streaming hasher.  Feeding the same values in the same order gives the
+// same hash regardless of how they were split into calls.  Values are read
+// in memory order, which is little endian on every platform we build for.
+class StableHasher
+{
+public:
+    explicit StableHasher(std::uint64_t seed = 0);
+
+    void AddBytes(const void* data, std::size_t size);
+
+    // Scalars and structs without padding only; anything with padding or
+    // pointers must be added field by field.
+    template<typename T>
+    void Add(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T>,
+            "Add field by field, T has padding or is not plain data.");
+        AddBytes(&value, sizeof(T));
+    }
+
+    // Length prefixed, so ("ab", "c") and ("a", "bc") differ.  A null
+    // string hashes differently from an empty one.
+    void AddString(const char* str);
+    void AddString(const std::string& str);
+
+    Hash128 Finish()const;
+
+private:
+    void Consume(std::uint64_t word);
+
+    std::uint64_t mState[2];
+    std::uint64_t mTail = 0;
+    std::uint32_t mTailBytes = 0;
+    std::uint64_t mLength = 0;
+};
+
+inline Hash128 HashBytes(const void* data, std::size_t size, std::uint64_t seed = 0)
+{
+    StableHasher hasher(seed);
+    hasher.AddBytes(data, size);
+    return hasher.Finish();
+}
@@ -0,0 +1,37 @@
+#include "TempFile.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    unsigned long ProcessId()
+    {
+#if defined(_WIN32)
+        return (unsigned long)_getpid();
+#else
+        return (unsigned long)getpid();
+#endif
+    }
+}
+
+std::string TempFile::UniquePath(const std::string& path)
+{
+    // The counter tells apart calls of one thread, for a writer that keeps
+    // a temp file open while it writes another.
+    static std::atomic<std::uint32_t> counter{ 0 };
+    const std::size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    char suffix[64];
+    std::snprintf(suffix, sizeof(suffix), ".%lu-%llx-%u.tmp", ProcessId(), (unsigned long long)thread,
+        (unsigned)counter.fetch_add(1, std::memory_order_relaxed));
+    return path + suffix;
+}
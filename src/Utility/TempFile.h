@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+// Files that are written in full beside their target and then renamed over
+// it, so a reader never sees half of one.
+namespace TempFile
+{
+    // path.<pid>-<thread>-<n>.tmp, different for every call of every
+    // process, so writers racing on the same path (the -bakeshaders build
+    // step and a running app, or two bakes) each fill their own file and
+    // the last rename wins with a whole one.
+    std::string UniquePath(const std::string& path);
+}
@@ -0,0 +1,193 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+
+namespace
+{
+    // Executor index of pool threads; threads outside any pool share the
+    // last index, which is only known per pool.
+    thread_local const ThreadPool* tCurrentPool = nullptr;
+    thread_local std::uint32_t tCurrentWorker = 0;
+}
+
+ThreadPool::ThreadPool(std::uint32_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        const std::uint32_t hardware = std::thread::hardware_concurrency();
+        threadCount = hardware > 1 ? hardware - 1 : 1;
+    }
+
+    mThreads.reserve(threadCount);
+    for (std::uint32_t i = 0; i < threadCount; ++i)
+        mThreads.emplace_back(&ThreadPool::WorkerMain, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWorkAvailable.notify_all();
+
+    for (auto& thread : mThreads)
+        thread.join();
+}
+
+std::uint32_t ThreadPool::CurrentExecutor()const
+{
+    return tCurrentPool == this ? tCurrentWorker : WorkerCount();
+}
+
+void ThreadPool::ParallelFor(std::uint32_t count, const std::function<void(std::uint32_t index, std::uint32_t executor)>& fn)
+{
+    ParallelForRange(count, 1, [&fn](std::uint32_t begin, std::uint32_t end, std::uint32_t executor)
+    {
+        for (std::uint32_t i = begin; i < end; ++i)
+            fn(i, executor);
+    });
+}
+
+void ThreadPool::ParallelForRange(std::uint32_t count, std::uint32_t grainSize,
+    const std::function<void(std::uint32_t begin, std::uint32_t end, std::uint32_t executor)>& fn)
+{
+    if (count == 0)
+        return;
+    if (grainSize == 0)
+        grainSize = 1;
+
+    const std::uint32_t rangeCount = (count + grainSize - 1) / grainSize;
+    if (rangeCount == 1 || mThreads.empty())
+    {
+        fn(0, count, CurrentExecutor());
+        return;
+    }
+
+    // Shared by the caller and the helpers, which may outlive the loop
+    // itself if they start after all ranges were taken.
+    struct Loop
+    {
+        std::atomic<std::uint32_t> Next{ 0 };
+        std::atomic<std::uint32_t> Pending{ 0 };
+    };
+    auto loop = std::make_shared<Loop>();
+
+    auto runRanges = [loop, &fn, count, grainSize, rangeCount, this]()
+    {
+        const std::uint32_t executor = CurrentExecutor();
+        for (std::uint32_t range = loop->Next++; range < rangeCount; range = loop->Next++)
+        {
+            const std::uint32_t begin = range * grainSize;
+            const std::uint32_t end = begin + grainSize < count ? begin + grainSize : count;
+            fn(begin, end, executor);
+        }
+    };
+
+    const std::uint32_t helpers = rangeCount - 1 < WorkerCount() ? rangeCount - 1 : WorkerCount();
+    loop->Pending = helpers;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (std::uint32_t i = 0; i < helpers; ++i)
+        {
+            mTasks.push_front({ [loop, runRanges, this]()
+            {
+                runRanges();
+                if (--loop->Pending == 0)
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mWorkDone.notify_all();
+                }
+            }, loop.get() });
+        }
+    }
+    mWorkAvailable.notify_all();
+
+    runRanges();
+
+    // Every range is taken, so helpers no worker has picked up yet would
+    // find nothing to do; drop them and wait for the ones running.
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (auto it = mTasks.begin(); it != mTasks.end();)
+    {
+        if (it->Loop == loop.get())
+        {
+            it = mTasks.erase(it);
+            --loop->Pending;
+        }
+        else
+            ++it;
+    }
+    mWorkDone.wait(lock, [&]() { return loop->Pending == 0; });
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push_back({ std::move(task) });
+    }
+    mWorkAvailable.notify_one();
+}
+
+void ThreadPool::WaitIdle()
+{
+    while (true)
+    {
+        if (TryRunOne())
+            continue;
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mTasks.empty() && mBusyWorkers == 0)
+            return;
+        mWorkDone.wait(lock, [&]() { return !mTasks.empty() || mBusyWorkers == 0; });
+    }
+}
+
+void ThreadPool::WorkerMain(std::uint32_t index)
+{
+    tCurrentPool = this;
+    tCurrentWorker = index;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        mWorkAvailable.wait(lock, [&]() { return mStopping || !mTasks.empty(); });
+        if (mStopping && mTasks.empty())
+            return;
+
+        auto task = std::move(mTasks.front().Run);
+        mTasks.pop_front();
+        ++mBusyWorkers;
+        lock.unlock();
+
+        task();
+
+        lock.lock();
+        --mBusyWorkers;
+        mWorkDone.notify_all();
+    }
+}
+
+bool ThreadPool::TryRunOne()
+{
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mTasks.empty())
+            return false;
+        task = std::move(mTasks.front().Run);
+        mTasks.pop_front();
+        ++mBusyWorkers;
+    }
+
+    task();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        --mBusyWorkers;
+    }
+    mWorkDone.notify_all();
+    return true;
+}
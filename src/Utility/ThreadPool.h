@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads shared by the CPU-side systems.  ParallelFor
+// is the main entry point; the calling thread takes part in the loop and,
+// once no ranges are left, only waits for helpers already running it.
+// Helpers still queued are dropped rather than run, so a loop never ends
+// up running someone else's task, and nested loops cannot deadlock.
+class ThreadPool
+{
+public:
+    // threadCount == 0 picks one worker per hardware thread minus the caller.
+    explicit ThreadPool(std::uint32_t threadCount = 0);
+    ThreadPool(const ThreadPool& rhs) = delete;
+    ThreadPool& operator=(const ThreadPool& rhs) = delete;
+    ~ThreadPool();
+
+    std::uint32_t WorkerCount()const { return (std::uint32_t)mThreads.size(); }
+
+    // Number of distinct worker indices ParallelFor hands out: one per
+    // worker thread plus one shared by every thread outside the pool.
+    // Per-thread resources are sized with this.
+    std::uint32_t ExecutorCount()const { return WorkerCount() + 1; }
+
+    // Index of the calling thread in [0, ExecutorCount()).
+    std::uint32_t CurrentExecutor()const;
+
+    // Calls fn(index, executor) for every index in [0, count) and returns
+    // once all calls are done.  Only one thread outside the pool may call
+    // this at a time since they share an executor index.
+    void ParallelFor(std::uint32_t count, const std::function<void(std::uint32_t index, std::uint32_t executor)>& fn);
+
+    // Same, but hands out contiguous ranges of at most grainSize indices as
+    // fn(begin, end, executor).
+    void ParallelForRange(std::uint32_t count, std::uint32_t grainSize,
+        const std::function<void(std::uint32_t begin, std::uint32_t end, std::uint32_t executor)>& fn);
+
+    // Queues a task without waiting for it.  Loop helpers are queued ahead
+    // of these, so long tasks such as pipeline builds only slow a loop down
+    // by the workers they occupy.
+    void Submit(std::function<void()> task);
+
+    // Runs queued tasks on the calling thread until none are left and every
+    // worker is idle.
+    void WaitIdle();
+
+private:
+    struct Task
+    {
+        std::function<void()> Run;
+        // The loop a helper belongs to, null for submitted tasks.
+        const void* Loop = nullptr;
+    };
+
+    void WorkerMain(std::uint32_t index);
+    bool TryRunOne();
+
+    std::vector<std::thread> mThreads;
+    std::deque<Task> mTasks;
+    std::uint32_t mBusyWorkers = 0;
+    bool mStopping = false;
+
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkDone;
+};
@@ -0,0 +1,214 @@
+#include "TransformStore.h"
+
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Transposed element p of a matrix is element TransposeSource[p] of the original.
+    constexpr int TransposeSource[16] =
+    {
+        0, 4,  8, 12,
+        1, 5,  9, 13,
+        2, 6, 10, 14,
+        3, 7, 11, 15
+    };
+
+#if defined(__AVX2__)
+    // r[j] ends up holding lane j of every input register.
+    inline void Transpose8x8(__m256 r[8])
+    {
+        __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+        __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+        __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+        __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+        __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+        __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+        __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+        __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+        __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+        r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+        r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+        r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+        r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+        r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+        r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+        r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+        r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+    }
+#endif
+}
+
+void MatrixKernels::StreamInstances8(const MatrixLanes& world, const MatrixLanes& texTransform,
+    const std::uint32_t* materialIndex, std::uint8_t* dst)
+{
+#if defined(__AVX2__)
+    // Each half of a transposed matrix is one 8x8 transpose: loading the
+    // source rows in TransposeSource order makes the 4x4 transpose free.
+    __m256 r[4][8];
+    for (int half = 0; half < 4; ++half)
+    {
+        const MatrixLanes& src = half < 2 ? world : texTransform;
+        for (int k = 0; k < 8; ++k)
+            r[half][k] = _mm256_load_ps(src[TransposeSource[(half % 2) * 8 + k]]);
+
+        Transpose8x8(r[half]);
+    }
+
+    // Write each record front to back so write-combining sees whole lines.
+    for (int lane = 0; lane < 8; ++lane)
+    {
+        float* out = reinterpret_cast<float*>(dst + lane * TransformStore::InstanceByteSize);
+        _mm256_stream_ps(out + 0, r[0][lane]);
+        _mm256_stream_ps(out + 8, r[1][lane]);
+        _mm256_stream_ps(out + 16, r[2][lane]);
+        _mm256_stream_ps(out + 24, r[3][lane]);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(out + 32),
+            _mm256_setr_epi32((int)materialIndex[lane], 0, 0, 0, 0, 0, 0, 0));
+    }
+#else
+    StoreInstances(world, texTransform, materialIndex, 0xffu, dst);
+#endif
+}
+
+void MatrixKernels::StoreInstances(const MatrixLanes& world, const MatrixLanes& texTransform,
+    const std::uint32_t* materialIndex, std::uint32_t laneMask, std::uint8_t* dst)
+{
+    for (; laneMask != 0; laneMask &= laneMask - 1)
+    {
+        const int lane = std::countr_zero(laneMask);
+        float record[TransformStore::InstanceByteSize / sizeof(float)] = {};
+        for (int p = 0; p < 16; ++p)
+        {
+            record[p] = world[TransposeSource[p]][lane];
+            record[16 + p] = texTransform[TransposeSource[p]][lane];
+        }
+        std::memcpy(&record[32], &materialIndex[lane], sizeof(std::uint32_t));
+        std::memcpy(dst + lane * TransformStore::InstanceByteSize, record, sizeof(record));
+    }
+}
+
+TransformStore::TransformStore(std::uint32_t numFrameResources) :
+    mDirty(numFrameResources)
+{
+}
+
+std::uint32_t TransformStore::Add(const Float4x4& world, const Float4x4& texTransform, std::uint32_t materialIndex)
+{
+    std::uint32_t id = mCount++;
+    if (id % BlockSize == 0)
+        mBlocks.emplace_back();
+
+    mMaterialIndex.push_back(materialIndex);
+    mDirty.Resize(mCount);
+
+    SetWorld(id, world);
+    SetTexTransform(id, texTransform);
+    return id;
+}
+
+void TransformStore::Clear()
+{
+    mBlocks.clear();
+    mMaterialIndex.clear();
+    mDirty.Clear();
+    mCount = 0;
+}
+
+Float4x4 TransformStore::GetWorld(std::uint32_t id)const
+{
+    const Block& block = mBlocks[id / BlockSize];
+    Float4x4 m;
+    for (int e = 0; e < 16; ++e)
+        m.m[e / 4][e % 4] = block.World[e][id % BlockSize];
+    return m;
+}
+
+Float4x4 TransformStore::GetTexTransform(std::uint32_t id)const
+{
+    const Block& block = mBlocks[id / BlockSize];
+    Float4x4 m;
+    for (int e = 0; e < 16; ++e)
+        m.m[e / 4][e % 4] = block.TexTransform[e][id % BlockSize];
+    return m;
+}
+
+Float3 TransformStore::GetTranslation(std::uint32_t id)const
+{
+    // Row 3 of the world matrix, elements 12 to 14.
+    const Block& block = mBlocks[id / BlockSize];
+    return { block.World[12][id % BlockSize], block.World[13][id % BlockSize], block.World[14][id % BlockSize] };
+}
+
+void TransformStore::SetWorld(std::uint32_t id, const Float4x4& world)
+{
+    Block& block = mBlocks[id / BlockSize];
+    for (int e = 0; e < 16; ++e)
+        block.World[e][id % BlockSize] = world.m[e / 4][e % 4];
+    MarkDirty(id);
+}
+
+void TransformStore::SetTexTransform(std::uint32_t id, const Float4x4& texTransform)
+{
+    Block& block = mBlocks[id / BlockSize];
+    for (int e = 0; e < 16; ++e)
+        block.TexTransform[e][id % BlockSize] = texTransform.m[e / 4][e % 4];
+    MarkDirty(id);
+}
+
+void TransformStore::SetMaterialIndex(std::uint32_t id, std::uint32_t materialIndex)
+{
+    mMaterialIndex[id] = materialIndex;
+    MarkDirty(id);
+}
+
+std::size_t TransformStore::Upload(std::uint32_t frame, std::uint8_t* dst, bool writeAll)
+{
+    std::size_t written = 0;
+
+    mDirty.ConsumeWords(frame, writeAll, [&](std::uint32_t word, std::uint64_t bits)
+    {
+        for (std::uint32_t first = word * 64; bits != 0; bits >>= BlockSize, first += BlockSize)
+        {
+            const std::uint32_t lanes = std::uint32_t(bits & 0xffu);
+            if (lanes == 0)
+                continue;
+
+            const Block& block = mBlocks[first / BlockSize];
+            std::uint8_t* base = dst + first * InstanceByteSize;
+
+            // Mostly dirty full blocks are cheaper to stream whole, clean
+            // lanes are rewritten with their current values.
+            if (first + BlockSize <= mCount && std::popcount(lanes) > (int)BlockSize / 2)
+            {
+                MatrixKernels::StreamInstances8(block.World, block.TexTransform, &mMaterialIndex[first], base);
+                written += BlockSize * InstanceByteSize;
+            }
+            else
+            {
+                MatrixKernels::StoreInstances(block.World, block.TexTransform, &mMaterialIndex[first], lanes, base);
+                written += std::popcount(lanes) * InstanceByteSize;
+            }
+        }
+    });
+
+#if defined(__AVX2__)
+    // Streaming stores are weakly ordered, make them visible before the
+    // command list that reads them is submitted.
+    _mm_sfence();
+#endif
+    return written;
+}
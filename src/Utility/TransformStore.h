@@ -0,0 +1,85 @@
+#pragma once
+
+#include "SimdMath.h"
+#include "Structure/ChangeTracker.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Structure-of-arrays storage for per-object transforms.  Matrices are kept
+// in blocks of eight with element k of all eight objects side by side, which
+// is the layout the AVX2 upload kernel wants.  Objects are addressed by the
+// id returned from Add, which is also their slot in the GPU instance buffer.
+class TransformStore
+{
+public:
+    static constexpr std::uint32_t BlockSize = 8;
+
+    // Layout of one destination element, see InstanceData in FrameResource.h.
+    // The whole element is written so the streaming stores fill complete lines.
+    static constexpr std::size_t WorldOffset = 0;
+    static constexpr std::size_t TexTransformOffset = 64;
+    static constexpr std::size_t MaterialIndexOffset = 128;
+    static constexpr std::size_t InstanceByteSize = 160;
+
+    explicit TransformStore(std::uint32_t numFrameResources = 3);
+
+    std::uint32_t Add(const Float4x4& world, const Float4x4& texTransform, std::uint32_t materialIndex);
+    void Clear();
+
+    std::uint32_t Count()const { return mCount; }
+
+    Float4x4 GetWorld(std::uint32_t id)const;
+    Float4x4 GetTexTransform(std::uint32_t id)const;
+    Float3 GetTranslation(std::uint32_t id)const;
+    std::uint32_t GetMaterialIndex(std::uint32_t id)const { return mMaterialIndex[id]; }
+
+    void SetWorld(std::uint32_t id, const Float4x4& world);
+    void SetTexTransform(std::uint32_t id, const Float4x4& texTransform);
+    void SetMaterialIndex(std::uint32_t id, std::uint32_t materialIndex);
+
+    // Every object has to reach each frame resource once more.
+    void MarkAllDirty() { mDirty.MarkAllDirty(); }
+    void SetNumFrameResources(std::uint32_t numFrameResources) { mDirty.SetNumFrameResources(numFrameResources); }
+
+    // Writes the instance data of the objects frame has not seen yet (or all
+    // of them) to dst + id * InstanceByteSize.  dst must be 32-byte aligned
+    // for the streaming stores.  Returns the number of bytes written.
+    std::size_t Upload(std::uint32_t frame, std::uint8_t* dst, bool writeAll);
+
+    std::uint32_t DirtyCount(std::uint32_t frame)const { return mDirty.DirtyCount(frame); }
+
+private:
+    struct alignas(32) Block
+    {
+        float World[16][BlockSize];
+        float TexTransform[16][BlockSize];
+    };
+
+    void MarkDirty(std::uint32_t id) { mDirty.MarkDirty(id); }
+
+    std::vector<Block> mBlocks;
+    std::vector<std::uint32_t> mMaterialIndex;
+
+    // One bit per object and frame resource; each byte of a word is a block.
+    DirtyTracker mDirty;
+
+    std::uint32_t mCount = 0;
+};
+
+namespace MatrixKernels
+{
+    using MatrixLanes = float[16][TransformStore::BlockSize];
+
+    // Transposes the world and texture matrices of eight objects, given as 16
+    // element rows of BlockSize lanes, and streams each object's complete
+    // InstanceByteSize record to dst + lane * InstanceByteSize.
+    void StreamInstances8(const MatrixLanes& world, const MatrixLanes& texTransform,
+        const std::uint32_t* materialIndex, std::uint8_t* dst);
+
+    // Scalar version for the lanes set in laneMask, used for sparse or
+    // partial blocks and CPUs built without AVX2.
+    void StoreInstances(const MatrixLanes& world, const MatrixLanes& texTransform,
+        const std::uint32_t* materialIndex, std::uint32_t laneMask, std::uint8_t* dst);
+}
@@ -0,0 +1,590 @@
+#include "TriangleBvh.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    float Axis(const Float3& v, int axis)
+    {
+        return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+    }
+
+    Float3 Min(const Float3& a, const Float3& b)
+    {
+        return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) };
+    }
+
+    Float3 Max(const Float3& a, const Float3& b)
+    {
+        return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) };
+    }
+
+    Float3 Sub(const Float3& a, const Float3& b)
+    {
+        return { a.x - b.x, a.y - b.y, a.z - b.z };
+    }
+
+    Float3 Cross(const Float3& a, const Float3& b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    float Dot(const Float3& a, const Float3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    float SurfaceArea(const Float3& min, const Float3& max)
+    {
+        const float x = max.x - min.x, y = max.y - min.y, z = max.z - min.z;
+        return 2.0f * (x * y + y * z + z * x);
+    }
+
+    constexpr float Infinity = std::numeric_limits<float>::infinity();
+    const Float3 EmptyMin = { Infinity, Infinity, Infinity };
+    const Float3 EmptyMax = { -Infinity, -Infinity, -Infinity };
+
+    // Enough for any sane tree; the walks move to the heap for deeper ones.
+    constexpr std::uint32_t StackSize = 64;
+
+    // Far slab distances are pushed out by a few rounding errors so flat
+    // boxes, of axis aligned triangles, are not missed (Ize 2013).
+    constexpr float FarScale = 1.0000004f;
+
+    // Direction components of zero would make the slab test multiply zero
+    // by infinity; a tiny one keeps it ordered.
+    float SafeInverse(float d)
+    {
+        return 1.0f / (std::fabs(d) > 1e-30f ? d : std::copysign(1e-30f, d));
+    }
+
+    Float3 Centroid(const Float3& min, const Float3& max)
+    {
+        return { min.x + max.x, min.y + max.y, min.z + max.z };
+    }
+
+    struct Bin
+    {
+        std::uint32_t Count;
+        Float3 Min;
+        Float3 Max;
+    };
+
+    // Bounds of a node's triangles and of their centroids.
+    struct Extents
+    {
+        Float3 Min = EmptyMin, Max = EmptyMax;
+        Float3 CentroidMin = EmptyMin, CentroidMax = EmptyMax;
+    };
+
+    // fn(begin, end, chunk) over [first, first + count) in chunks of
+    // chunkSize, on pool when there is more than one chunk.
+    template <typename Fn>
+    void ForChunks(ThreadPool* pool, std::uint32_t first, std::uint32_t count, std::uint32_t chunkSize, const Fn& fn)
+    {
+        const std::uint32_t chunks = (count + chunkSize - 1) / chunkSize;
+        if (pool == nullptr || chunks <= 1)
+        {
+            fn(first, first + count, 0u);
+            return;
+        }
+        pool->ParallelFor(chunks, [&](std::uint32_t chunk, std::uint32_t)
+        {
+            const std::uint32_t begin = first + chunk * chunkSize;
+            fn(begin, std::min(begin + chunkSize, first + count), chunk);
+        });
+    }
+
+    // Stack of a traversal, on the heap only for trees deeper than usual.
+    class TraversalStack
+    {
+    public:
+        explicit TraversalStack(std::size_t nodeCount) : mNodeCount(nodeCount) {}
+
+        bool Empty()const { return mSize == 0; }
+        std::uint32_t Pop() { return mData[--mSize]; }
+
+        void Push(std::uint32_t node)
+        {
+            if (mSize == StackSize && mData == mFixed)
+            {
+                mHeap.assign(mFixed, mFixed + mSize);
+                mHeap.resize(mNodeCount);
+                mData = mHeap.data();
+            }
+            mData[mSize++] = node;
+        }
+
+    private:
+        std::uint32_t mFixed[StackSize];
+        std::vector<std::uint32_t> mHeap;
+        std::uint32_t* mData = mFixed;
+        std::uint32_t mSize = 0;
+        std::size_t mNodeCount;
+    };
+}
+
+void TriangleBvh::Build(const Float3* positions, const std::uint32_t* indices, std::uint32_t triangleCount, ThreadPool* pool)
+{
+    mRefs.resize(triangleCount);
+    std::vector<Triangle> source(triangleCount);
+    ForChunks(pool, 0, triangleCount, ParallelBinThreshold, [&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+    {
+        for (std::uint32_t i = begin; i < end; ++i)
+        {
+            const Float3& a = positions[indices[3 * i + 0]];
+            const Float3& b = positions[indices[3 * i + 1]];
+            const Float3& c = positions[indices[3 * i + 2]];
+            source[i] = { a, Sub(b, a), Sub(c, a) };
+            mRefs[i] = { Min(a, Min(b, c)), i, Max(a, Max(b, c)) };
+        }
+    });
+
+    // A binary tree over n triangles has at most 2n - 1 nodes, so nodes
+    // never move while subtrees build in parallel.
+    mNodes.assign(triangleCount > 0 ? 2 * triangleCount - 1 : 1, Node{ EmptyMin, 0, EmptyMax, 0 });
+    mNodeCount = 1;
+    if (triangleCount > 0)
+        BuildNode(0, 0, triangleCount, pool);
+    mNodes.resize(mNodeCount);
+
+    // Leaves reference the triangles in the order the builder left them.
+    mTriangles.resize(triangleCount);
+    mTriangleIds.resize(triangleCount);
+    ForChunks(pool, 0, triangleCount, ParallelBinThreshold, [&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+    {
+        for (std::uint32_t i = begin; i < end; ++i)
+        {
+            mTriangles[i] = source[mRefs[i].Triangle];
+            mTriangleIds[i] = mRefs[i].Triangle;
+        }
+    });
+    mRefs.clear();
+    mRefs.shrink_to_fit();
+}
+
+void TriangleBvh::BuildNode(std::uint32_t index, std::uint32_t first, std::uint32_t count, ThreadPool* pool)
+{
+    const std::uint32_t end = first + count;
+    const std::uint32_t chunks = (count + ParallelBinThreshold - 1) / ParallelBinThreshold;
+
+    // The top nodes hold most of the triangles, they are scanned in chunks
+    // on the pool and the partial results merged in chunk order.  Only
+    // those need heap storage for the partials.
+    Extents localExtents[1];
+    std::vector<Extents> heapExtents(chunks > 1 ? chunks : 0);
+    Extents* partialExtents = chunks > 1 ? heapExtents.data() : localExtents;
+    ForChunks(pool, first, count, ParallelBinThreshold, [&](std::uint32_t begin, std::uint32_t stop, std::uint32_t chunk)
+    {
+        Extents e;
+        for (std::uint32_t i = begin; i < stop; ++i)
+        {
+            const BuildRef& ref = mRefs[i];
+            e.Min = Min(e.Min, ref.Min);
+            e.Max = Max(e.Max, ref.Max);
+            e.CentroidMin = Min(e.CentroidMin, Centroid(ref.Min, ref.Max));
+            e.CentroidMax = Max(e.CentroidMax, Centroid(ref.Min, ref.Max));
+        }
+        partialExtents[chunk] = e;
+    });
+    Extents extents;
+    for (std::uint32_t chunk = 0; chunk < std::max(chunks, 1u); ++chunk)
+    {
+        const Extents& e = partialExtents[chunk];
+        extents.Min = Min(extents.Min, e.Min);
+        extents.Max = Max(extents.Max, e.Max);
+        extents.CentroidMin = Min(extents.CentroidMin, e.CentroidMin);
+        extents.CentroidMax = Max(extents.CentroidMax, e.CentroidMax);
+    }
+    mNodes[index] = { extents.Min, first, extents.Max, count };
+
+    if (count <= MaxLeafSize)
+        return;
+
+    const std::uint32_t binCount = std::min(BinCount, count);
+    const float origin[3] = { extents.CentroidMin.x, extents.CentroidMin.y, extents.CentroidMin.z };
+    float scale[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const float extent = Axis(extents.CentroidMax, axis) - origin[axis];
+        scale[axis] = extent > 0.0f ? binCount / extent : 0.0f;
+    }
+
+    auto binOf = [&](float centroid, int axis)
+    {
+        const int bin = (int)((centroid - origin[axis]) * scale[axis]);
+        return std::min((std::uint32_t)bin, binCount - 1);
+    };
+
+    // All three axes are binned in one pass over the triangles.
+    Bin localBins[3 * BinCount];
+    std::vector<Bin> heapBins(chunks > 1 ? chunks * 3 * BinCount : 0, Bin{ 0, EmptyMin, EmptyMax });
+    Bin* partialBins = chunks > 1 ? heapBins.data() : localBins;
+    if (chunks <= 1)
+        std::fill_n(localBins, 3 * BinCount, Bin{ 0, EmptyMin, EmptyMax });
+    ForChunks(pool, first, count, ParallelBinThreshold, [&](std::uint32_t begin, std::uint32_t stop, std::uint32_t chunk)
+    {
+        Bin* bins = &partialBins[chunk * 3 * BinCount];
+        for (std::uint32_t i = begin; i < stop; ++i)
+        {
+            const BuildRef& ref = mRefs[i];
+            const Float3 c = Centroid(ref.Min, ref.Max);
+            const float centroid[3] = { c.x, c.y, c.z };
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                Bin& bin = bins[axis * BinCount + binOf(centroid[axis], axis)];
+                ++bin.Count;
+                bin.Min = Min(bin.Min, ref.Min);
+                bin.Max = Max(bin.Max, ref.Max);
+            }
+        }
+    });
+    Bin bins[3][BinCount];
+    for (int axis = 0; axis < 3; ++axis)
+        std::fill_n(bins[axis], BinCount, Bin{ 0, EmptyMin, EmptyMax });
+    for (std::uint32_t chunk = 0; chunk < std::max(chunks, 1u); ++chunk)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            for (std::uint32_t b = 0; b < binCount; ++b)
+            {
+                const Bin& partial = partialBins[(chunk * 3 + axis) * BinCount + b];
+                bins[axis][b].Count += partial.Count;
+                bins[axis][b].Min = Min(bins[axis][b].Min, partial.Min);
+                bins[axis][b].Max = Max(bins[axis][b].Max, partial.Max);
+            }
+        }
+    }
+
+    float bestCost = Infinity;
+    int bestAxis = -1;
+    std::uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (scale[axis] == 0.0f)
+            continue;
+
+        float rightCost[BinCount];
+        Bin right = { 0, EmptyMin, EmptyMax };
+        for (std::uint32_t b = binCount - 1; b > 0; --b)
+        {
+            right.Count += bins[axis][b].Count;
+            right.Min = Min(right.Min, bins[axis][b].Min);
+            right.Max = Max(right.Max, bins[axis][b].Max);
+            rightCost[b] = right.Count > 0 ? right.Count * SurfaceArea(right.Min, right.Max) : 0.0f;
+        }
+
+        Bin left = { 0, EmptyMin, EmptyMax };
+        for (std::uint32_t split = 1; split < binCount; ++split)
+        {
+            left.Count += bins[axis][split - 1].Count;
+            left.Min = Min(left.Min, bins[axis][split - 1].Min);
+            left.Max = Max(left.Max, bins[axis][split - 1].Max);
+            if (left.Count == 0 || left.Count == count)
+                continue;
+
+            const float cost = left.Count * SurfaceArea(left.Min, left.Max) + rightCost[split];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    // A leaf of up to twice the usual size beats a split that costs more
+    // than its triangles, counting a box test as much as a triangle test.
+    const float area = SurfaceArea(extents.Min, extents.Max);
+    if (count <= 2 * MaxLeafSize && bestCost + area >= count * area)
+        return;
+
+    std::uint32_t mid = first + count / 2;
+    if (bestAxis >= 0)
+    {
+        mid = (std::uint32_t)(std::partition(mRefs.begin() + first, mRefs.begin() + end,
+            [&](const BuildRef& ref) { return binOf(Axis(Centroid(ref.Min, ref.Max), bestAxis), bestAxis) < bestSplit; }) - mRefs.begin());
+    }
+
+    const std::uint32_t left = mNodeCount.fetch_add(2);
+    mNodes[index].Index = left;
+    mNodes[index].Count = 0;
+
+    if (pool != nullptr && count > ParallelThreshold)
+    {
+        pool->ParallelFor(2, [&](std::uint32_t child, std::uint32_t)
+        {
+            if (child == 0)
+                BuildNode(left, first, mid - first, pool);
+            else
+                BuildNode(left + 1, mid, end - mid, pool);
+        });
+    }
+    else
+    {
+        BuildNode(left, first, mid - first, pool);
+        BuildNode(left + 1, mid, end - mid, pool);
+    }
+}
+
+template <bool AnyHit>
+bool TriangleBvh::Trace(const Float3& origin, const Float3& dir, float tMax, Hit* hit)const
+{
+    if (mTriangles.empty())
+        return false;
+
+    const Float3 inv = { SafeInverse(dir.x), SafeInverse(dir.y), SafeInverse(dir.z) };
+    bool found = false;
+
+    TraversalStack stack(mNodes.size());
+    stack.Push(0);
+    while (!stack.Empty())
+    {
+        const Node& node = mNodes[stack.Pop()];
+
+        const float tx0 = (node.Min.x - origin.x) * inv.x, tx1 = (node.Max.x - origin.x) * inv.x;
+        const float ty0 = (node.Min.y - origin.y) * inv.y, ty1 = (node.Max.y - origin.y) * inv.y;
+        const float tz0 = (node.Min.z - origin.z) * inv.z, tz1 = (node.Max.z - origin.z) * inv.z;
+        const float tNear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::min(tz0, tz1));
+        const float tFar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::max(tz0, tz1)) * FarScale;
+        if (tNear > tFar || tFar <= 0.0f || tNear >= tMax)
+            continue;
+
+        if (node.Count == 0)
+        {
+            // The child on the side the ray comes from goes first, so
+            // closest hits shorten the ray early.
+            const Node& left = mNodes[node.Index];
+            const Node& right = mNodes[node.Index + 1];
+            const Float3 toRight = Sub(Centroid(right.Min, right.Max), Centroid(left.Min, left.Max));
+            const bool leftFirst = Dot(dir, toRight) >= 0.0f;
+            stack.Push(leftFirst ? node.Index + 1 : node.Index);
+            stack.Push(leftFirst ? node.Index : node.Index + 1);
+            continue;
+        }
+
+        for (std::uint32_t i = node.Index; i < node.Index + node.Count; ++i)
+        {
+            const Triangle& tri = mTriangles[i];
+            const Float3 p = Cross(dir, tri.E2);
+            const float invDet = 1.0f / Dot(tri.E1, p);
+            const Float3 s = Sub(origin, tri.V0);
+            const float u = Dot(s, p) * invDet;
+            const Float3 q = Cross(s, tri.E1);
+            const float v = Dot(dir, q) * invDet;
+            const float t = Dot(tri.E2, q) * invDet;
+            if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < tMax)
+            {
+                if (AnyHit)
+                    return true;
+                tMax = t;
+                *hit = { t, mTriangleIds[i], u, v };
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+template <bool AnyHit>
+std::uint32_t TriangleBvh::TracePacket(const RayPacket& rays, std::uint32_t active, Hit* hits)const
+{
+    active &= 0xffu;
+    if (mTriangles.empty() || active == 0)
+        return 0;
+
+#if defined(__AVX2__) && defined(__FMA__)
+    const __m256 ox = _mm256_loadu_ps(rays.OriginX), oy = _mm256_loadu_ps(rays.OriginY), oz = _mm256_loadu_ps(rays.OriginZ);
+    const __m256 dx = _mm256_loadu_ps(rays.DirX), dy = _mm256_loadu_ps(rays.DirY), dz = _mm256_loadu_ps(rays.DirZ);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), farScale = _mm256_set1_ps(FarScale);
+    const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+    alignas(32) float inverse[3][8];
+    for (int lane = 0; lane < 8; ++lane)
+    {
+        inverse[0][lane] = SafeInverse(rays.DirX[lane]);
+        inverse[1][lane] = SafeInverse(rays.DirY[lane]);
+        inverse[2][lane] = SafeInverse(rays.DirZ[lane]);
+    }
+    const __m256 ix = _mm256_load_ps(inverse[0]), iy = _mm256_load_ps(inverse[1]), iz = _mm256_load_ps(inverse[2]);
+    // Slab distances as box * inverse - origin * inverse, one FMA each.
+    const __m256 oix = _mm256_mul_ps(ox, ix), oiy = _mm256_mul_ps(oy, iy), oiz = _mm256_mul_ps(oz, iz);
+
+    // Closest hits so far; tMax shrinks to them.
+    __m256 tMax = _mm256_loadu_ps(rays.TMax);
+    __m256 bestU = zero, bestV = zero;
+    __m256i bestTriangle = _mm256_setzero_si256();
+
+    std::uint32_t hit = 0;
+    TraversalStack stack(mNodes.size());
+    stack.Push(0);
+    while (!stack.Empty())
+    {
+        const Node& node = mNodes[stack.Pop()];
+
+        // For any hit, rays already blocked are done.
+        const std::uint32_t pending = AnyHit ? active & ~hit : active;
+        const __m256 tx0 = _mm256_fmsub_ps(_mm256_set1_ps(node.Min.x), ix, oix);
+        const __m256 tx1 = _mm256_fmsub_ps(_mm256_set1_ps(node.Max.x), ix, oix);
+        const __m256 ty0 = _mm256_fmsub_ps(_mm256_set1_ps(node.Min.y), iy, oiy);
+        const __m256 ty1 = _mm256_fmsub_ps(_mm256_set1_ps(node.Max.y), iy, oiy);
+        const __m256 tz0 = _mm256_fmsub_ps(_mm256_set1_ps(node.Min.z), iz, oiz);
+        const __m256 tz1 = _mm256_fmsub_ps(_mm256_set1_ps(node.Max.z), iz, oiz);
+        const __m256 tNear = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx0, tx1), _mm256_min_ps(ty0, ty1)), _mm256_min_ps(tz0, tz1));
+        const __m256 tFar = _mm256_mul_ps(_mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx0, tx1), _mm256_max_ps(ty0, ty1)), _mm256_max_ps(tz0, tz1)), farScale);
+        const __m256 boxHit = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ), _mm256_cmp_ps(tFar, zero, _CMP_GT_OQ)),
+            _mm256_cmp_ps(tNear, tMax, _CMP_LT_OQ));
+        const std::uint32_t lanes = (std::uint32_t)_mm256_movemask_ps(boxHit) & pending;
+        if (lanes == 0)
+            continue;
+
+        if (node.Count == 0)
+        {
+            // Ordered for the first ray still in the box, the others mostly
+            // point the same way.
+            const std::uint32_t lane = (std::uint32_t)std::countr_zero(lanes);
+            const Float3 dir = { rays.DirX[lane], rays.DirY[lane], rays.DirZ[lane] };
+            const Node& left = mNodes[node.Index];
+            const Node& right = mNodes[node.Index + 1];
+            const Float3 toRight = Sub(Centroid(right.Min, right.Max), Centroid(left.Min, left.Max));
+            const bool leftFirst = Dot(dir, toRight) >= 0.0f;
+            stack.Push(leftFirst ? node.Index + 1 : node.Index);
+            stack.Push(leftFirst ? node.Index : node.Index + 1);
+            continue;
+        }
+
+        const __m256 laneMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+            _mm256_and_si256(_mm256_set1_epi32((int)lanes), laneBits), laneBits));
+        for (std::uint32_t i = node.Index; i < node.Index + node.Count; ++i)
+        {
+            const Triangle& tri = mTriangles[i];
+            const __m256 e1x = _mm256_set1_ps(tri.E1.x), e1y = _mm256_set1_ps(tri.E1.y), e1z = _mm256_set1_ps(tri.E1.z);
+            const __m256 e2x = _mm256_set1_ps(tri.E2.x), e2y = _mm256_set1_ps(tri.E2.y), e2z = _mm256_set1_ps(tri.E2.z);
+
+            // p = dir x e2
+            const __m256 px = _mm256_fmsub_ps(dy, e2z, _mm256_mul_ps(dz, e2y));
+            const __m256 py = _mm256_fmsub_ps(dz, e2x, _mm256_mul_ps(dx, e2z));
+            const __m256 pz = _mm256_fmsub_ps(dx, e2y, _mm256_mul_ps(dy, e2x));
+            const __m256 det = _mm256_fmadd_ps(e1x, px, _mm256_fmadd_ps(e1y, py, _mm256_mul_ps(e1z, pz)));
+            const __m256 invDet = _mm256_div_ps(one, det);
+
+            const __m256 sx = _mm256_sub_ps(ox, _mm256_set1_ps(tri.V0.x));
+            const __m256 sy = _mm256_sub_ps(oy, _mm256_set1_ps(tri.V0.y));
+            const __m256 sz = _mm256_sub_ps(oz, _mm256_set1_ps(tri.V0.z));
+            const __m256 u = _mm256_mul_ps(_mm256_fmadd_ps(sx, px, _mm256_fmadd_ps(sy, py, _mm256_mul_ps(sz, pz))), invDet);
+
+            // q = s x e1
+            const __m256 qx = _mm256_fmsub_ps(sy, e1z, _mm256_mul_ps(sz, e1y));
+            const __m256 qy = _mm256_fmsub_ps(sz, e1x, _mm256_mul_ps(sx, e1z));
+            const __m256 qz = _mm256_fmsub_ps(sx, e1y, _mm256_mul_ps(sy, e1x));
+            const __m256 v = _mm256_mul_ps(_mm256_fmadd_ps(dx, qx, _mm256_fmadd_ps(dy, qy, _mm256_mul_ps(dz, qz))), invDet);
+            const __m256 t = _mm256_mul_ps(_mm256_fmadd_ps(e2x, qx, _mm256_fmadd_ps(e2y, qy, _mm256_mul_ps(e2z, qz))), invDet);
+
+            __m256 inside = _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(t, zero, _CMP_GT_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(t, tMax, _CMP_LT_OQ));
+            inside = _mm256_and_ps(inside, laneMask);
+            const std::uint32_t hitLanes = (std::uint32_t)_mm256_movemask_ps(inside);
+            if (hitLanes == 0)
+                continue;
+
+            hit |= hitLanes;
+            if (!AnyHit)
+            {
+                tMax = _mm256_blendv_ps(tMax, t, inside);
+                bestU = _mm256_blendv_ps(bestU, u, inside);
+                bestV = _mm256_blendv_ps(bestV, v, inside);
+                bestTriangle = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestTriangle),
+                    _mm256_castsi256_ps(_mm256_set1_epi32((int)mTriangleIds[i])), inside));
+            }
+        }
+        if (AnyHit && (active & ~hit) == 0)
+            break;
+    }
+
+    if (!AnyHit && hit != 0)
+    {
+        alignas(32) float t[8], u[8], v[8];
+        alignas(32) std::uint32_t triangle[8];
+        _mm256_store_ps(t, tMax);
+        _mm256_store_ps(u, bestU);
+        _mm256_store_ps(v, bestV);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(triangle), bestTriangle);
+        for (std::uint32_t lanes = hit; lanes != 0; lanes &= lanes - 1)
+        {
+            const std::uint32_t lane = (std::uint32_t)std::countr_zero(lanes);
+            hits[lane] = { t[lane], triangle[lane], u[lane], v[lane] };
+        }
+    }
+    return hit;
+#else
+    std::uint32_t hit = 0;
+    for (std::uint32_t lane = 0; lane < 8; ++lane)
+    {
+        if ((active & (1u << lane)) == 0)
+            continue;
+        const Float3 origin = { rays.OriginX[lane], rays.OriginY[lane], rays.OriginZ[lane] };
+        const Float3 dir = { rays.DirX[lane], rays.DirY[lane], rays.DirZ[lane] };
+        if (Trace<AnyHit>(origin, dir, rays.TMax[lane], AnyHit ? nullptr : &hits[lane]))
+            hit |= 1u << lane;
+    }
+    return hit;
+#endif
+}
+
+bool TriangleBvh::Occluded(const Float3& origin, const Float3& dir, float tMax)const
+{
+    return Trace<true>(origin, dir, tMax, nullptr);
+}
+
+std::uint32_t TriangleBvh::Occluded(const RayPacket& rays, std::uint32_t active)const
+{
+    return TracePacket<true>(rays, active, nullptr);
+}
+
+bool TriangleBvh::Intersect(const Float3& origin, const Float3& dir, float tMax, Hit& hit)const
+{
+    return Trace<false>(origin, dir, tMax, &hit);
+}
+
+std::uint32_t TriangleBvh::Intersect(const RayPacket& rays, Hit hits[8], std::uint32_t active)const
+{
+    return TracePacket<false>(rays, active, hits);
+}
+
+float TriangleBvh::Cost()const
+{
+    if (mTriangles.empty())
+        return 0.0f;
+
+    const float rootArea = SurfaceArea(mNodes[0].Min, mNodes[0].Max);
+    double cost = 0.0;
+    std::vector<std::uint32_t> stack = { 0 };
+    while (!stack.empty())
+    {
+        const Node& node = mNodes[stack.back()];
+        stack.pop_back();
+        const float area = SurfaceArea(node.Min, node.Max);
+        if (node.Count == 0)
+        {
+            cost += area;
+            stack.push_back(node.Index);
+            stack.push_back(node.Index + 1);
+        }
+        else
+        {
+            cost += (double)area * node.Count;
+        }
+    }
+    return rootArea > 0.0f ? (float)(cost / rootArea) : 0.0f;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "SimdMath.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Bounding volume hierarchy over the triangles of one mesh, for ray queries
+// on the CPU.  Built top-down with a binned surface area heuristic; large
+// nodes are binned in parallel and large subtrees build on the thread pool.
+// Nodes are 32 bytes, two to a cache line, and leaves keep copies of their
+// triangles in the order they reference them.
+class TriangleBvh
+{
+public:
+    static constexpr std::uint32_t MaxLeafSize = 4;
+    static constexpr std::uint32_t BinCount = 16;
+    // Subtrees with more triangles than this build on the thread pool, and
+    // nodes with more than ParallelBinThreshold bin in chunks of that size.
+    static constexpr std::uint32_t ParallelThreshold = 4096;
+    static constexpr std::uint32_t ParallelBinThreshold = 65536;
+
+    struct Node
+    {
+        Float3 Min;
+        // First triangle of a leaf, or first of the two children.
+        std::uint32_t Index;
+        Float3 Max;
+        // Triangles of a leaf, 0 for an inner node.
+        std::uint32_t Count;
+    };
+    static_assert(sizeof(Node) == 32, "two nodes per cache line");
+
+    // Eight rays, one per lane, for the packet queries.
+    struct RayPacket
+    {
+        float OriginX[8], OriginY[8], OriginZ[8];
+        float DirX[8], DirY[8], DirZ[8];
+        float TMax[8];
+    };
+
+    // Closest hit: the distance in multiples of the ray direction, the
+    // triangle as passed to Build and the barycentrics of its second and
+    // third corners.
+    struct Hit
+    {
+        float T = 0.0f;
+        std::uint32_t Triangle = 0;
+        float U = 0.0f;
+        float V = 0.0f;
+    };
+
+    // Triangle i is indices[3i .. 3i + 2].  pool may be null.
+    void Build(const Float3* positions, const std::uint32_t* indices, std::uint32_t triangleCount, ThreadPool* pool = nullptr);
+
+    std::uint32_t TriangleCount()const { return (std::uint32_t)mTriangles.size(); }
+    std::uint32_t NodeCount()const { return (std::uint32_t)mNodes.size(); }
+    const std::vector<Node>& Nodes()const { return mNodes; }
+
+    // True if the ray hits any triangle at a distance in (0, tMax), in
+    // multiples of dir.  Both faces count.
+    bool Occluded(const Float3& origin, const Float3& dir, float tMax)const;
+
+    // Occluded for the lanes of active, the packet traverses together.
+    // Returns the lanes that hit something.
+    std::uint32_t Occluded(const RayPacket& rays, std::uint32_t active = 0xffu)const;
+
+    // The nearest hit in (0, tMax); false, and hit unchanged, if there is
+    // none.
+    bool Intersect(const Float3& origin, const Float3& dir, float tMax, Hit& hit)const;
+
+    // Intersect for the lanes of active; hits[lane] is written for the
+    // lanes that hit, which are returned.
+    std::uint32_t Intersect(const RayPacket& rays, Hit hits[8], std::uint32_t active = 0xffu)const;
+
+    // Surface area heuristic cost relative to the root box, the quality
+    // measure the builder minimizes.
+    float Cost()const;
+
+private:
+    // Edges from V0, as Moller-Trumbore wants them.
+    struct Triangle
+    {
+        Float3 V0, E1, E2;
+    };
+
+    struct BuildRef
+    {
+        Float3 Min;
+        std::uint32_t Triangle;
+        Float3 Max;
+    };
+
+    void BuildNode(std::uint32_t node, std::uint32_t first, std::uint32_t count, ThreadPool* pool);
+
+    template <bool AnyHit>
+    bool Trace(const Float3& origin, const Float3& dir, float tMax, Hit* hit)const;
+    template <bool AnyHit>
+    std::uint32_t TracePacket(const RayPacket& rays, std::uint32_t active, Hit* hits)const;
+
+    std::vector<Node> mNodes;
+    std::atomic<std::uint32_t> mNodeCount{ 0 };
+    std::vector<Triangle> mTriangles;
+    // The triangle of Build each of mTriangles is.
+    std::vector<std::uint32_t> mTriangleIds;
+    std::vector<BuildRef> mRefs;
+};
@@ -11,6 +11,8 @@ BuildProject({
 })
 add_defines("NOMINMAX", "UNICODE", "m128_f32=vector4_f32", "m128_u32=vector4_u32")
 add_files("**.cpp")
+-- TransformStore's upload kernels are written for AVX2.
+add_vectorexts("avx2")
 add_includedirs("./","./assimp")
 add_linkdirs("../dll")
 add_syslinks("User32", "kernel32", "Gdi32", "Shell32", "DXGI", "D3D12", "D3DCompiler","assimp-vc143-mtd")
@@ -20,4 +22,7 @@ after_build(function(target)
     os.cp("dll/" .. "*", target:targetdir() .. "/")
     os.cp("model/" .. "*", target:targetdir() .. "/model/")
     os.cp("texture/" .. "*", target:targetdir() .. "/texture/")
+    -- Compile every shader into shader/cache next to the binary, so the
+    -- first launch only loads bytecode.  See BakeShaders in CreepApp.cpp.
+    os.execv(target:targetfile(), {"-bakeshaders"}, {curdir = target:targetdir()})
 end)
\ No newline at end of file
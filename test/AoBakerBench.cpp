@@ -0,0 +1,69 @@
+#include "Benchmark.h"
+
+#include "Utility/AoBaker.h"
+#include "Utility/ThreadPool.h"
+#include "Utility/TriangleBvh.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+BENCHMARK(BakeVertexAo)
+{
+    // Rolling terrain, 256 x 256 quads: 131k triangles, 66k vertices.
+    const std::uint32_t size = 256;
+    auto height = [](float x, float z) { return 3.0f * std::sin(x * 0.35f) * std::cos(z * 0.25f) + std::sin(x * 1.1f + z * 0.7f); };
+    std::vector<Float3> positions, normals;
+    for (std::uint32_t z = 0; z <= size; ++z)
+    {
+        for (std::uint32_t x = 0; x <= size; ++x)
+        {
+            const float fx = (float)x * 0.5f, fz = (float)z * 0.5f;
+            positions.push_back({ fx, height(fx, fz), fz });
+            const float dx = (height(fx + 0.01f, fz) - height(fx - 0.01f, fz)) * 50.0f;
+            const float dz = (height(fx, fz + 0.01f) - height(fx, fz - 0.01f)) * 50.0f;
+            const float length = std::sqrt(dx * dx + 1.0f + dz * dz);
+            normals.push_back({ -dx / length, 1.0f / length, -dz / length });
+        }
+    }
+    std::vector<std::uint32_t> indices;
+    for (std::uint32_t z = 0; z < size; ++z)
+    {
+        for (std::uint32_t x = 0; x < size; ++x)
+        {
+            const std::uint32_t i = z * (size + 1) + x;
+            indices.insert(indices.end(), { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+        }
+    }
+    const std::uint32_t vertexCount = (std::uint32_t)positions.size();
+
+    ThreadPool pool;
+    TriangleBvh bvh;
+    bvh.Build(positions.data(), indices.data(), (std::uint32_t)indices.size() / 3, &pool);
+
+    // The app's settings: rays a quarter of the terrain long.
+    const AoBaker::Settings settings;
+    float maxDistance, bias;
+    AoBaker::RayExtents(positions.data(), vertexCount, settings, maxDistance, bias);
+    const double rays = (double)vertexCount * settings.RayCount;
+
+    float open = 0.0f;
+    const double single = Bench::Time([&]
+    {
+        for (std::uint32_t v = 0; v < vertexCount; ++v)
+            open += AoBaker::BakeVertex(bvh, positions[v], normals[v], v, maxDistance, bias, settings);
+    }, 1);
+    Bench::Consume(&open);
+
+    std::vector<std::uint8_t> occlusion;
+    const double packets = Bench::Time([&] { occlusion = AoBaker::Bake(bvh, positions.data(), normals.data(), vertexCount, settings, nullptr); }, 3);
+    const double pooled = Bench::Time([&] { occlusion = AoBaker::Bake(bvh, positions.data(), normals.data(), vertexCount, settings, &pool); }, 3);
+    Bench::Consume(occlusion.data());
+
+    char label[96];
+    std::snprintf(label, sizeof(label), "%uk vertices x %u rays, one at a time", vertexCount / 1000, settings.RayCount);
+    Bench::Report(label, single, rays, "rays");
+    Bench::Report("packets of eight", packets, rays, "rays");
+    std::snprintf(label, sizeof(label), "packets of eight on %u threads", pool.WorkerCount() + 1);
+    Bench::Report(label, pooled, rays, "rays");
+}
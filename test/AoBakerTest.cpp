@@ -0,0 +1,218 @@
+#include "TestFramework.h"
+#include "FileCheck.h"
+
+#include "Utility/AoBaker.h"
+#include "Utility/ThreadPool.h"
+#include "Utility/TriangleBvh.h"
+
+#include <cmath>
+#include <filesystem>
+#include <vector>
+
+namespace
+{
+    struct Mesh
+    {
+        std::vector<Float3> Positions;
+        std::vector<Float3> Normals;
+        std::vector<std::uint32_t> Indices;
+
+        std::uint32_t TriangleCount()const { return (std::uint32_t)Indices.size() / 3; }
+
+        void AddQuad(const Float3& a, const Float3& b, const Float3& c, const Float3& d)
+        {
+            const std::uint32_t base = (std::uint32_t)Positions.size();
+            Positions.insert(Positions.end(), { a, b, c, d });
+            Normals.insert(Normals.end(), 4, Float3{});
+            Indices.insert(Indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+        }
+    };
+
+    // Bumpy ground, size x size quads, normals from the height gradient:
+    // valleys are occluded by their slopes, peaks are not.
+    Mesh MakeTerrain(std::uint32_t size)
+    {
+        Mesh mesh;
+        auto height = [](float x, float z) { return 1.5f * std::sin(x * 0.7f) * std::cos(z * 0.5f) + 0.5f * std::sin(x * 2.1f + z * 1.3f); };
+        for (std::uint32_t z = 0; z <= size; ++z)
+        {
+            for (std::uint32_t x = 0; x <= size; ++x)
+            {
+                const float fx = (float)x * 0.25f, fz = (float)z * 0.25f;
+                mesh.Positions.push_back({ fx, height(fx, fz), fz });
+                const float e = 0.01f;
+                const float dx = (height(fx + e, fz) - height(fx - e, fz)) / (2.0f * e);
+                const float dz = (height(fx, fz + e) - height(fx, fz - e)) / (2.0f * e);
+                const float length = std::sqrt(dx * dx + 1.0f + dz * dz);
+                mesh.Normals.push_back({ -dx / length, 1.0f / length, -dz / length });
+            }
+        }
+        for (std::uint32_t z = 0; z < size; ++z)
+        {
+            for (std::uint32_t x = 0; x < size; ++x)
+            {
+                const std::uint32_t i = z * (size + 1) + x;
+                mesh.Indices.insert(mesh.Indices.end(), { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+            }
+        }
+        return mesh;
+    }
+}
+
+TEST_CASE(CeilingMatchesTheCosineIntegral)
+{
+    // A ceiling at height h over a point on the ground: a cosine weighted
+    // ray at angle theta to the normal reaches it at h / cos(theta), so
+    // with rays of length d the open share is the share with
+    // cos(theta) < h / d, which is (h / d)^2.
+    Mesh mesh;
+    mesh.AddQuad({ -1000.0f, 1.0f, -1000.0f }, { 1000.0f, 1.0f, -1000.0f }, { 1000.0f, 1.0f, 1000.0f }, { -1000.0f, 1.0f, 1000.0f });
+    TriangleBvh bvh;
+    bvh.Build(mesh.Positions.data(), mesh.Indices.data(), mesh.TriangleCount());
+
+    AoBaker::Settings settings;
+    settings.RayCount = 256;
+    for (float distance : { 0.5f, 1.25f, 2.0f, 4.0f })
+    {
+        const float expected = distance <= 1.0f ? 1.0f : 1.0f / (distance * distance);
+        float mean = 0.0f;
+        for (std::uint32_t vertex = 0; vertex < 16; ++vertex)
+        {
+            const float open = AoBaker::BakeVertex(bvh, { (float)vertex, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, vertex, distance, 1e-4f, settings);
+            CHECK_NEAR(open, expected, 0.04);
+            mean += open / 16.0f;
+        }
+        CHECK_NEAR(mean, expected, 0.01);
+    }
+}
+
+TEST_CASE(WallHalvesTheCorner)
+{
+    // A point on the ground just off a wall, normal up: the wall cuts the
+    // hemisphere in two.
+    Mesh mesh;
+    mesh.AddQuad({ 0.0f, -1000.0f, -1000.0f }, { 0.0f, 1000.0f, -1000.0f }, { 0.0f, 1000.0f, 1000.0f }, { 0.0f, -1000.0f, 1000.0f });
+    TriangleBvh bvh;
+    bvh.Build(mesh.Positions.data(), mesh.Indices.data(), mesh.TriangleCount());
+
+    AoBaker::Settings settings;
+    settings.RayCount = 256;
+    float mean = 0.0f;
+    for (std::uint32_t vertex = 0; vertex < 32; ++vertex)
+        mean += AoBaker::BakeVertex(bvh, { 1e-3f, 0.0f, (float)vertex }, { 0.0f, 1.0f, 0.0f }, vertex, 100.0f, 1e-4f, settings) / 32.0f;
+    CHECK_NEAR(mean, 0.5f, 0.02);
+
+    // Inside a closed box every ray is blocked.
+    Mesh box;
+    const float s = 1.0f;
+    box.AddQuad({ -s, -s, -s }, { s, -s, -s }, { s, -s, s }, { -s, -s, s });
+    box.AddQuad({ -s, s, -s }, { -s, s, s }, { s, s, s }, { s, s, -s });
+    box.AddQuad({ -s, -s, -s }, { -s, s, -s }, { s, s, -s }, { s, -s, -s });
+    box.AddQuad({ -s, -s, s }, { s, -s, s }, { s, s, s }, { -s, s, s });
+    box.AddQuad({ -s, -s, -s }, { -s, -s, s }, { -s, s, s }, { -s, s, -s });
+    box.AddQuad({ s, -s, -s }, { s, s, -s }, { s, s, s }, { s, -s, s });
+    TriangleBvh boxBvh;
+    boxBvh.Build(box.Positions.data(), box.Indices.data(), box.TriangleCount());
+    CHECK(AoBaker::BakeVertex(boxBvh, { 0.2f, -0.9f, 0.1f }, { 0.0f, 1.0f, 0.0f }, 0, 10.0f, 1e-4f, settings) == 0.0f);
+}
+
+TEST_CASE(PacketsMatchSingleRays)
+{
+    const Mesh terrain = MakeTerrain(48);
+    TriangleBvh bvh;
+    bvh.Build(terrain.Positions.data(), terrain.Indices.data(), terrain.TriangleCount());
+    const std::uint32_t vertexCount = (std::uint32_t)terrain.Positions.size();
+    ThreadPool pool(3);
+
+    // Counts that fill the last packet and ones that do not.
+    for (std::uint32_t rayCount : { 1u, 20u, 64u })
+    {
+        AoBaker::Settings settings;
+        settings.RayCount = rayCount;
+        float maxDistance, bias;
+        AoBaker::RayExtents(terrain.Positions.data(), vertexCount, settings, maxDistance, bias);
+
+        AoBaker::Stats stats;
+        const std::vector<std::uint8_t> single = AoBaker::Bake(bvh, terrain.Positions.data(), terrain.Normals.data(), vertexCount, settings, nullptr, &stats);
+        const std::vector<std::uint8_t> pooled = AoBaker::Bake(bvh, terrain.Positions.data(), terrain.Normals.data(), vertexCount, settings, &pool);
+        CHECK(single == pooled);
+        CHECK(stats.Rays == (std::uint64_t)vertexCount * rayCount);
+        CHECK(stats.RaysPerSecond() > 0.0);
+
+        std::uint32_t occluded = 0;
+        for (std::uint32_t v = 0; v < vertexCount; ++v)
+        {
+            const float open = AoBaker::BakeVertex(bvh, terrain.Positions[v], terrain.Normals[v], v, maxDistance, bias, settings);
+            CHECK(single[v] == (std::uint8_t)std::lround(open * 255.0f));
+            occluded += single[v] < 255;
+        }
+        // The valleys are there; a single ray goes straight along the
+        // normal and sees nothing.
+        CHECK(rayCount == 1 || occluded > vertexCount / 2);
+    }
+}
+
+TEST_CASE(ZeroNormalsStayOpen)
+{
+    Mesh mesh = MakeTerrain(8);
+    for (std::size_t v = 0; v < mesh.Normals.size(); v += 3)
+        mesh.Normals[v] = {};
+    TriangleBvh bvh;
+    bvh.Build(mesh.Positions.data(), mesh.Indices.data(), mesh.TriangleCount());
+    const std::uint32_t vertexCount = (std::uint32_t)mesh.Positions.size();
+
+    AoBaker::Stats stats;
+    const std::vector<std::uint8_t> occlusion = AoBaker::Bake(bvh, mesh.Positions.data(), mesh.Normals.data(), vertexCount, {}, nullptr, &stats);
+    std::uint64_t baked = 0;
+    for (std::uint32_t v = 0; v < vertexCount; ++v)
+    {
+        if (v % 3 == 0)
+            CHECK(occlusion[v] == 255);
+        else
+            ++baked;
+    }
+    CHECK(stats.Rays == baked * AoBaker::Settings().RayCount);
+
+    AoBaker::Settings noRays;
+    noRays.RayCount = 0;
+    for (std::uint8_t o : AoBaker::Bake(bvh, mesh.Positions.data(), mesh.Normals.data(), vertexCount, noRays, nullptr))
+        CHECK(o == 255);
+}
+
+TEST_CASE(BakesRoundTripThroughTheCache)
+{
+    const Mesh terrain = MakeTerrain(4);
+    const std::uint32_t vertexCount = (std::uint32_t)terrain.Positions.size();
+    const AoBaker::Settings settings;
+    const Hash128 key = AoBaker::Key(terrain.Positions.data(), terrain.Normals.data(), vertexCount,
+        terrain.Indices.data(), (std::uint32_t)terrain.Indices.size(), settings);
+
+    AoBaker::Settings longer = settings;
+    longer.MaxDistance *= 2.0f;
+    CHECK(!(key == AoBaker::Key(terrain.Positions.data(), terrain.Normals.data(), vertexCount,
+        terrain.Indices.data(), (std::uint32_t)terrain.Indices.size(), longer)));
+    CHECK(!(key == AoBaker::Key(terrain.Positions.data(), terrain.Normals.data(), vertexCount,
+        terrain.Indices.data(), (std::uint32_t)terrain.Indices.size() - 3, settings)));
+
+    const std::filesystem::path root = std::filesystem::temp_directory_path() / "CreepEngineTests" / "AoBaker";
+    std::filesystem::remove_all(root);
+    const std::string path = (root / "cache" / "mesh.ao").generic_string();
+
+    std::vector<std::uint8_t> occlusion(vertexCount);
+    for (std::uint32_t v = 0; v < vertexCount; ++v)
+        occlusion[v] = (std::uint8_t)(v * 7);
+    CHECK(AoBaker::Save(path, key, occlusion));
+    CHECK(!FileCheck::HasTempFiles(path));
+
+    std::vector<std::uint8_t> loaded;
+    CHECK(AoBaker::Load(path, key, loaded));
+    CHECK(loaded == occlusion);
+
+    Hash128 other = key;
+    other.Lo ^= 1;
+    CHECK(!AoBaker::Load(path, other, loaded));
+    CHECK(!AoBaker::Load((root / "missing.ao").generic_string(), key, loaded));
+
+    std::error_code ec;
+    std::filesystem::remove_all(root, ec);
+}
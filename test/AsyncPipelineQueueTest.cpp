@@ -0,0 +1,224 @@
+#include "TestFramework.h"
+
+#include "Structure/AsyncPipelineQueue.h"
+#include "Utility/ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    void* Pipeline(std::uintptr_t id) { return reinterpret_cast<void*>(0x100 * id); }
+
+    // Create functions that block until released, standing in for a driver
+    // compile that takes far longer than a frame.  They give up after a
+    // while so a broken scheduler fails the test instead of hanging it.
+    class SlowCompiles
+    {
+    public:
+        AsyncPipelineQueue::CreateFn Create(void* pipeline)
+        {
+            return [this, pipeline]()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if (std::this_thread::get_id() == mFrameThread)
+                        mRanOnFrameThread = true;
+                    ++mStarted;
+                }
+                mChanged.notify_all();
+
+                std::unique_lock<std::mutex> lock(mMutex);
+                mChanged.wait_for(lock, std::chrono::seconds(2), [this]() { return mReleased; });
+                return pipeline;
+            };
+        }
+
+        void WaitStarted(int count)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mChanged.wait_for(lock, std::chrono::seconds(2), [&]() { return mStarted >= count; });
+        }
+
+        void Release()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mReleased = true;
+            }
+            mChanged.notify_all();
+        }
+
+        bool RanOnFrameThread()
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mRanOnFrameThread;
+        }
+
+        const std::thread::id mFrameThread = std::this_thread::get_id();
+
+    private:
+        std::mutex mMutex;
+        std::condition_variable mChanged;
+        int mStarted = 0;
+        bool mReleased = false;
+        bool mRanOnFrameThread = false;
+    };
+}
+
+TEST_CASE(FrameLoopsDoNotWaitForPipelineBuilds)
+{
+    ThreadPool pool(2);
+    SlowCompiles compiles;
+    {
+        AsyncPipelineQueue queue(&pool);
+
+        // Both workers busy compiling and more compiles queued behind them.
+        AsyncPipelineQueue::Handle handles[6];
+        for (std::uintptr_t i = 0; i < 6; ++i)
+            handles[i] = queue.Request(compiles.Create(Pipeline(i + 1)));
+        compiles.WaitStarted(2);
+
+        // A frame's worth of loops: the calling thread does all the work
+        // itself, but must not pick up a queued compile while it waits.
+        const auto start = std::chrono::steady_clock::now();
+        std::atomic<std::uint64_t> sum{ 0 };
+        for (int loop = 0; loop < 20; ++loop)
+        {
+            pool.ParallelFor(64, [&](std::uint32_t index, std::uint32_t) { sum += index; });
+            pool.ParallelForRange(1000, 16, [&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+            {
+                for (std::uint32_t i = begin; i < end; ++i)
+                    sum += i;
+            });
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK(sum == 20ull * (63 * 64 / 2 + 999 * 1000 / 2));
+        CHECK(!compiles.RanOnFrameThread());
+        CHECK(seconds < 1.0);
+        CHECK(queue.PendingCount() == 6);
+        CHECK(queue.Get(handles[0]) == nullptr);
+
+        compiles.Release();
+        queue.WaitIdle();
+        for (std::uintptr_t i = 0; i < 6; ++i)
+            CHECK(queue.Get(handles[i]) == Pipeline(i + 1));
+    }
+}
+
+TEST_CASE(LoopHelpersGoAheadOfQueuedBuilds)
+{
+    // The only worker is in a compile with another queued behind it.  When
+    // the first compile ends, the worker has to take the loop's helper
+    // rather than the next compile.
+    ThreadPool pool(1);
+    SlowCompiles compiles;
+    AsyncPipelineQueue queue(&pool);
+
+    std::atomic<bool> started{ false };
+    std::atomic<bool> finish{ false };
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    queue.Request([&]()
+    {
+        started = true;
+        while (!finish && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        return Pipeline(1);
+    });
+    queue.Request(compiles.Create(Pipeline(2)));
+    while (!started && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+
+    // Both iterations wait for each other, which only works if the worker
+    // runs one of them.
+    std::atomic<bool> onWorker{ false };
+    std::atomic<int> waiting{ 0 };
+    pool.ParallelFor(2, [&](std::uint32_t, std::uint32_t executor)
+    {
+        if (executor == pool.WorkerCount())
+            finish = true;
+        else
+            onWorker = true;
+        ++waiting;
+        while (waiting < 2 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+    });
+    CHECK(onWorker);
+    CHECK(waiting == 2);
+    CHECK(queue.IsReady(0));
+
+    compiles.Release();
+    queue.WaitIdle();
+}
+
+TEST_CASE(FallbacksCoverPipelinesInFlight)
+{
+    ThreadPool pool(1);
+    SlowCompiles compiles;
+    AsyncPipelineQueue queue(&pool);
+
+    const AsyncPipelineQueue::Handle base = queue.Request([] { return Pipeline(1); });
+    queue.WaitIdle();
+    const AsyncPipelineQueue::Handle variant = queue.Request(compiles.Create(Pipeline(2)), base);
+    const AsyncPipelineQueue::Handle orphan = queue.Request(compiles.Create(Pipeline(3)));
+
+    CHECK(queue.IsReady(base));
+    CHECK(!queue.IsReady(variant));
+    CHECK(queue.Get(variant) == Pipeline(1));
+    CHECK(queue.Get(orphan) == nullptr);
+    CHECK(queue.Get(AsyncPipelineQueue::NoPipeline) == nullptr);
+
+    bool threw = false;
+    try
+    {
+        queue.Request([] { return Pipeline(4); }, 10);
+    }
+    catch (const std::invalid_argument&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+
+    compiles.Release();
+    queue.WaitIdle();
+    CHECK(queue.Get(variant) == Pipeline(2));
+    CHECK(queue.Get(orphan) == Pipeline(3));
+}
+
+TEST_CASE(RebuildsPublishNewestAndKeepOldOnFailure)
+{
+    ThreadPool pool(2);
+    AsyncPipelineQueue queue(&pool);
+    const AsyncPipelineQueue::Handle h = queue.Request([] { return Pipeline(1); });
+    queue.WaitIdle();
+
+    // An old rebuild finishing after a newer one does not win.
+    std::mutex gate;
+    std::unique_lock<std::mutex> hold(gate);
+    queue.Rebuild(h, [&]() { std::lock_guard<std::mutex> wait(gate); return Pipeline(2); });
+    queue.Rebuild(h, [] { return Pipeline(3); });
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (queue.PendingCount() > 1 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+    CHECK(queue.Get(h) == Pipeline(3));
+    hold.unlock();
+    queue.WaitIdle();
+    CHECK(queue.Get(h) == Pipeline(3));
+    CHECK(!queue.Failed(h));
+
+    // A failed rebuild leaves the last good pipeline in place.
+    queue.Rebuild(h, []() -> void* { throw std::runtime_error("compile error"); });
+    queue.WaitIdle();
+    CHECK(queue.Failed(h));
+    CHECK(queue.Get(h) == Pipeline(3));
+
+    queue.Rebuild(h, [] { return Pipeline(4); });
+    queue.WaitIdle();
+    CHECK(!queue.Failed(h));
+    CHECK(queue.Get(h) == Pipeline(4));
+}
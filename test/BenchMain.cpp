@@ -0,0 +1,44 @@
+#include "Benchmark.h"
+
+#include <cstdio>
+#include <cstring>
+
+std::vector<Bench::Case>& Bench::Registry()
+{
+    static std::vector<Case> cases;
+    return cases;
+}
+
+void Bench::Report(const char* label, double seconds, double count, const char* unit)
+{
+    std::printf("  %-40s %10.3f ms  %14.0f %s/s\n", label, seconds * 1000.0, seconds > 0.0 ? count / seconds : 0.0, unit);
+}
+
+void Bench::Consume(const void* p)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    // No inline asm on x64 MSVC; reading the volatile back keeps the store.
+    static const void* volatile sink;
+    sink = p;
+    (void)sink;
+#else
+    // p escapes into asm that may read any memory, so the stores behind it
+    // have to happen, and nothing is left for -Wall to call unused.
+    asm volatile("" : : "r"(p) : "memory");
+#endif
+}
+
+// benchmarks [filter]: runs the benchmarks whose source file name contains
+// filter, all of them without one.
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    for (const Bench::Case& c : Bench::Registry())
+    {
+        if (filter != nullptr && std::strstr(c.File, filter) == nullptr)
+            continue;
+        std::printf("%s\n", c.Name);
+        c.Run();
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+// Benchmarks of the portable parts of the engine, the counterpart of
+// TestFramework.h.  They print timings and are not run by ctest.
+namespace Bench
+{
+    struct Case
+    {
+        const char* File;
+        const char* Name;
+        void (*Run)();
+    };
+
+    std::vector<Case>& Registry();
+
+    struct Registration
+    {
+        Registration(const char* file, const char* name, void (*run)())
+        {
+            Registry().push_back({ file, name, run });
+        }
+    };
+
+    // Fastest of repeat runs of fn, in seconds.
+    template <typename Fn>
+    double Time(Fn&& fn, int repeat = 5)
+    {
+        double best = 0.0;
+        for (int i = 0; i < repeat; ++i)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            fn();
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (i == 0 || seconds < best)
+                best = seconds;
+        }
+        return best;
+    }
+
+    // Prints "label: x ms, y unit/s" for count units done in seconds.
+    void Report(const char* label, double seconds, double count, const char* unit);
+
+    // Keeps the compiler from dropping work whose result is unused.
+    void Consume(const void* p);
+}
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static Bench::Registration name##Registration(__FILE__, #name, name); \
+    static void name()
@@ -0,0 +1,134 @@
+#include "TestFramework.h"
+
+#include "Structure/ChangeTracker.h"
+
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> Ranges(DirtyTracker& tracker, std::uint32_t frame, bool writeAll = false)
+    {
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+        tracker.ConsumeRanges(frame, writeAll, [&](std::uint32_t first, std::uint32_t count) { ranges.push_back({ first, count }); });
+        return ranges;
+    }
+
+    using RangeList = std::vector<std::pair<std::uint32_t, std::uint32_t>>;
+}
+
+TEST_CASE(NewSlotsAreDirtyForEveryFrameResource)
+{
+    DirtyTracker tracker(3);
+    tracker.Resize(100);
+    for (std::uint32_t frame = 0; frame < 3; ++frame)
+    {
+        CHECK(tracker.DirtyCount(frame) == 100);
+        CHECK(Ranges(tracker, frame) == (RangeList{ { 0, 100 } }));
+        CHECK(tracker.DirtyCount(frame) == 0);
+    }
+}
+
+TEST_CASE(AChangeReachesEachFrameResourceOnce)
+{
+    DirtyTracker tracker(3);
+    tracker.Resize(10000);
+    for (std::uint32_t frame = 0; frame < 3; ++frame)
+        Ranges(tracker, frame);
+
+    tracker.MarkDirty(5);
+    tracker.MarkDirty(4100);
+    CHECK(Ranges(tracker, 0) == (RangeList{ { 5, 1 }, { 4100, 1 } }));
+    CHECK(Ranges(tracker, 0).empty());
+    CHECK(tracker.IsDirty(1, 5) && tracker.IsDirty(2, 4100));
+    CHECK(Ranges(tracker, 2) == (RangeList{ { 5, 1 }, { 4100, 1 } }));
+    CHECK(tracker.DirtyCount(1) == 2);
+}
+
+TEST_CASE(RunsJoinAcrossWords)
+{
+    DirtyTracker tracker(1);
+    tracker.Resize(300);
+    Ranges(tracker, 0);
+
+    for (std::uint32_t slot = 60; slot < 200; ++slot)
+        tracker.MarkDirty(slot);
+    tracker.MarkDirty(202);
+    tracker.MarkDirty(299);
+    CHECK(Ranges(tracker, 0) == (RangeList{ { 60, 140 }, { 202, 1 }, { 299, 1 } }));
+}
+
+TEST_CASE(ShrinkingDropsBitsPastTheEnd)
+{
+    DirtyTracker tracker(2);
+    tracker.Resize(200);
+    tracker.Resize(70);
+    CHECK(tracker.DirtyCount(0) == 70);
+    CHECK(Ranges(tracker, 0) == (RangeList{ { 0, 70 } }));
+
+    // Growing again marks only the new slots.
+    tracker.Resize(80);
+    CHECK(Ranges(tracker, 0) == (RangeList{ { 70, 10 } }));
+    CHECK(tracker.DirtyCount(1) == 80);
+}
+
+TEST_CASE(NewFrameResourceCountStartsOver)
+{
+    DirtyTracker tracker(3);
+    tracker.Resize(50);
+    Ranges(tracker, 0);
+    tracker.SetNumFrameResources(2);
+    CHECK(tracker.NumFrameResources() == 2);
+    CHECK(tracker.DirtyCount(0) == 50 && tracker.DirtyCount(1) == 50);
+    CHECK(Ranges(tracker, 1, true) == (RangeList{ { 0, 50 } }));
+    CHECK(tracker.DirtyCount(1) == 0);
+}
+
+TEST_CASE(StaticBlockUploadsNothing)
+{
+    float pass[37] = {};
+    for (int i = 0; i < 37; ++i)
+        pass[i] = (float)i;
+
+    TrackedBlock block(sizeof(pass), 3);
+    CHECK(block.Update(pass));
+
+    std::uint8_t copies[3][sizeof(pass)] = {};
+    for (std::uint32_t frame = 0; frame < 3; ++frame)
+    {
+        CHECK(block.Upload(frame, copies[frame], false) == sizeof(pass));
+        CHECK(std::memcmp(copies[frame], pass, sizeof(pass)) == 0);
+    }
+
+    // A static camera: the same contents every frame cost no bytes.
+    std::uint64_t bytes = 0;
+    for (int f = 0; f < 30; ++f)
+    {
+        CHECK(!block.Update(pass));
+        bytes += block.Upload(f % 3, copies[f % 3], false);
+    }
+    CHECK(bytes == 0);
+}
+
+TEST_CASE(ChangedChunksUploadOncePerFrameResource)
+{
+    float pass[37] = {};
+    TrackedBlock block(sizeof(pass), 3);
+    std::uint8_t copies[3][sizeof(pass)] = {};
+    for (std::uint32_t frame = 0; frame < 3; ++frame)
+        block.Upload(frame, copies[frame], false);
+
+    // One float in chunk 2 and the 4 byte tail chunk.
+    pass[9] = 1.0f;
+    pass[36] = 2.0f;
+    const std::uint64_t generation = block.Generation();
+    CHECK(block.Update(pass));
+    CHECK(block.Generation() == generation + 1);
+
+    for (std::uint32_t frame = 0; frame < 3; ++frame)
+    {
+        CHECK(block.Upload(frame, copies[frame], false) == TrackedBlock::ChunkSize + 4);
+        CHECK(std::memcmp(copies[frame], pass, sizeof(pass)) == 0);
+        CHECK(block.Upload(frame, copies[frame], false) == 0);
+    }
+}
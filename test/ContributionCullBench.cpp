@@ -0,0 +1,50 @@
+#include "Benchmark.h"
+
+#include "Utility/ContributionCull.h"
+#include "Utility/ThreadPool.h"
+
+#include <cstdio>
+#include <vector>
+
+BENCHMARK(ProjectedAreas)
+{
+    const ContributionLens lens = ContributionCull::MakeLens({ 0.0f, 10.0f, -300.0f }, 1.0f, 0.5f, 1080.0f);
+    ContributionCuller::Settings settings;
+    settings.MinPixelArea = 16.0f;
+    settings.FadePixelArea = 64.0f;
+    ThreadPool pool;
+    ContributionCuller culler;
+
+    for (std::uint32_t count : { 100000u, 1000000u })
+    {
+        // Boxes over a 1 km square, the far ones a few pixels across.
+        BoundsSoA bounds;
+        bounds.Resize(count);
+        std::uint32_t state = 12345;
+        auto next = [&]() { state = state * 1664525u + 1013904223u; return (float)(state >> 8) * (1.0f / 16777216.0f); };
+        for (std::uint32_t i = 0; i < count; ++i)
+            bounds.Set(i, { next() * 1000.0f - 500.0f, next() * 40.0f, next() * 1000.0f - 500.0f }, { 0.2f + next(), 0.2f + next(), 0.2f + next() });
+
+        std::vector<float> areas(count);
+        std::vector<std::uint32_t> all(count), visible, culled;
+        for (std::uint32_t i = 0; i < count; ++i)
+            all[i] = i;
+        const double scalar = Bench::Time([&] { ContributionCull::ProjectedAreaRangeScalar(lens, bounds, 0, count, areas.data()); });
+        const double simd = Bench::Time([&] { ContributionCull::ProjectedAreaRange(lens, bounds, 0, count, areas.data()); });
+        const double pooled = Bench::Time([&]
+        {
+            visible = all;
+            culled.clear();
+            culler.Cull(lens, bounds, settings, &pool, visible, culled);
+        });
+        Bench::Consume(areas.data());
+
+        char label[96];
+        std::snprintf(label, sizeof(label), "%uk boxes, scalar areas", count / 1000);
+        Bench::Report(label, scalar, (double)count, "boxes");
+        std::snprintf(label, sizeof(label), "%uk boxes, AVX2 areas", count / 1000);
+        Bench::Report(label, simd, (double)count, "boxes");
+        std::snprintf(label, sizeof(label), "%uk boxes (%zu culled), cull and compact on %u threads", count / 1000, culled.size(), pool.WorkerCount() + 1);
+        Bench::Report(label, pooled, (double)count, "boxes");
+    }
+}
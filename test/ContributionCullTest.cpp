@@ -0,0 +1,276 @@
+#include "TestFramework.h"
+
+#include "Utility/ContributionCull.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    constexpr double Pi = 3.14159265358979323846;
+
+    void FillBoxes(BoundsSoA& bounds, std::uint32_t count, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        bounds.Resize(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            const Float3 center = { random.Float(-300.0f, 300.0f), random.Float(-20.0f, 20.0f), random.Float(-300.0f, 300.0f) };
+            const float size = random.Float(0.0f, 1.0f) < 0.05f ? 30.0f : 2.0f;
+            bounds.Set(i, center, { random.Float(0.0f, size), random.Float(0.0f, size), random.Float(0.0f, size) });
+        }
+    }
+
+    // A sphere of radius r on the x axis at distance d from an eye at the
+    // origin, as a cube of half size r / sqrt(3).
+    void SetSphere(BoundsSoA& bounds, std::uint32_t i, float distance, float radius)
+    {
+        const float half = radius / std::sqrt(3.0f);
+        bounds.Set(i, { distance, 0.0f, 0.0f }, { half, half, half });
+    }
+
+    std::vector<std::uint32_t> AllItems(std::uint32_t count)
+    {
+        std::vector<std::uint32_t> items(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+            items[i] = i;
+        return items;
+    }
+}
+
+TEST_CASE(AreaMatchesTheSphere)
+{
+    const ContributionLens lens = ContributionCull::MakeLens({}, 1.0f, 0.5f, 1080.0f);
+    CHECK_NEAR(lens.PixelScale, 540.0 / std::tan(0.5), 1e-2);
+    CHECK(lens.NearZ == 0.5f);
+
+    // pi * (scale * r)^2 / (d^2 - r^2): at tan(angle) small it is the disc
+    // of radius scale * r / d.
+    BoundsSoA bounds;
+    bounds.Resize(1);
+    for (float distance : { 2.0f, 10.0f, 100.0f, 1000.0f })
+    {
+        for (float radius : { 0.1f, 1.0f, 1.5f })
+        {
+            SetSphere(bounds, 0, distance, radius);
+            const double expected = Pi * lens.PixelScale * lens.PixelScale * radius * radius
+                / ((double)distance * distance - (double)radius * radius);
+            const float area = ContributionCull::ProjectedArea(lens, bounds.Center(0), bounds.Extents(0));
+            CHECK_NEAR(area / expected, 1.0, 1e-4);
+        }
+    }
+
+    // Twice as far, a quarter of the area.
+    SetSphere(bounds, 0, 400.0f, 1.0f);
+    const float near = ContributionCull::ProjectedArea(lens, bounds.Center(0), bounds.Extents(0));
+    SetSphere(bounds, 0, 800.0f, 1.0f);
+    CHECK_NEAR(ContributionCull::ProjectedArea(lens, bounds.Center(0), bounds.Extents(0)) * 4.0f / near, 1.0, 1e-4);
+
+    // An eye inside the sphere, or nearer its silhouette than the near
+    // plane, clamps to the near plane instead of going negative.
+    const double clamped = Pi * lens.PixelScale * lens.PixelScale * 4.0 / 0.25;
+    for (float distance : { 0.0f, 1.0f, 2.05f })
+    {
+        SetSphere(bounds, 0, distance, 2.0f);
+        CHECK_NEAR(ContributionCull::ProjectedArea(lens, bounds.Center(0), bounds.Extents(0)) / clamped, 1.0, 1e-4);
+    }
+}
+
+TEST_CASE(SimdMatchesScalar)
+{
+    BoundsSoA bounds;
+    FillBoxes(bounds, 1000, 1);
+    const ContributionLens lens = ContributionCull::MakeLens({ 5.0f, 2.0f, -3.0f }, 1.0f, 0.5f, 1080.0f);
+
+    // Begins are multiples of eight; ends leave every tail length.
+    for (std::uint32_t begin : { 0u, 8u, 64u, 992u })
+    {
+        for (std::uint32_t end = begin; end <= std::min(begin + 20u, 1000u); ++end)
+        {
+            std::vector<float> simd(end - begin + 8, -1.0f), scalar(end - begin);
+            ContributionCull::ProjectedAreaRange(lens, bounds, begin, end, simd.data());
+            ContributionCull::ProjectedAreaRangeScalar(lens, bounds, begin, end, scalar.data());
+            for (std::uint32_t i = 0; i < end - begin; ++i)
+                CHECK_NEAR(simd[i], scalar[i], 1e-5 * scalar[i]);
+            // The masked store leaves the rest alone.
+            for (std::size_t i = end - begin; i < simd.size(); ++i)
+                CHECK(simd[i] == -1.0f);
+        }
+    }
+
+    std::vector<float> simd(1000), scalar(1000);
+    ContributionCull::ProjectedAreaRange(lens, bounds, 0, 1000, simd.data());
+    ContributionCull::ProjectedAreaRangeScalar(lens, bounds, 0, 1000, scalar.data());
+    for (std::uint32_t i = 0; i < 1000; ++i)
+        CHECK_NEAR(simd[i], scalar[i], 1e-5 * scalar[i]);
+}
+
+TEST_CASE(HysteresisKeepsItemsSteady)
+{
+    // One item walking away from the eye and back.
+    BoundsSoA bounds;
+    bounds.Resize(1);
+    const ContributionLens lens = ContributionCull::MakeLens({}, 1.0f, 0.1f, 1000.0f);
+    ContributionCuller::Settings settings;
+    settings.MinPixelArea = 100.0f;
+    settings.Hysteresis = 0.5f;
+
+    // Distance where the item covers area pixels.
+    auto distanceFor = [&](float area)
+    {
+        return std::sqrt(Pi * lens.PixelScale * lens.PixelScale / area + 1.0);
+    };
+
+    ContributionCuller culler;
+    auto cullAt = [&](float area)
+    {
+        SetSphere(bounds, 0, (float)distanceFor(area), 1.0f);
+        std::vector<std::uint32_t> visible = { 0 }, culled;
+        culler.Cull(lens, bounds, settings, nullptr, visible, culled);
+        CHECK(visible.size() + culled.size() == 1);
+        CHECK(culler.IsCulled(0) == !culled.empty());
+        return culler.IsCulled(0);
+    };
+
+    CHECK(!cullAt(200.0f));
+    CHECK(!cullAt(101.0f));
+    CHECK(cullAt(99.0f));
+    // Back over the threshold but not over it by the hysteresis.
+    CHECK(cullAt(120.0f));
+    CHECK(cullAt(149.0f));
+    CHECK(!cullAt(151.0f));
+    // Once back it stays until it drops under the threshold itself.
+    CHECK(!cullAt(110.0f));
+    CHECK(cullAt(90.0f));
+
+    // No hysteresis: in and out at the threshold.
+    settings.Hysteresis = 0.0f;
+    CHECK(!cullAt(101.0f));
+    CHECK(culler.Fade(0) == 1.0f);
+}
+
+TEST_CASE(FadesFollowTheArea)
+{
+    // Items at known areas from 10 to 400 pixels.
+    const ContributionLens lens = ContributionCull::MakeLens({}, 1.0f, 0.1f, 1000.0f);
+    std::vector<float> areas;
+    for (float area = 10.0f; area <= 400.0f; area += 10.0f)
+        areas.push_back(area);
+    BoundsSoA bounds;
+    bounds.Resize((std::uint32_t)areas.size());
+    for (std::uint32_t i = 0; i < bounds.Count(); ++i)
+        SetSphere(bounds, i, (float)std::sqrt(Pi * lens.PixelScale * lens.PixelScale / areas[i] + 1.0), 1.0f);
+
+    ContributionCuller::Settings settings;
+    settings.MinPixelArea = 100.0f;
+    settings.FadePixelArea = 300.0f;
+    ContributionCuller culler;
+    std::vector<std::uint32_t> visible = AllItems(bounds.Count()), culled;
+    culler.Cull(lens, bounds, settings, nullptr, visible, culled);
+    for (std::uint32_t i = 0; i < bounds.Count(); ++i)
+    {
+        const float area = areas[i];
+        if (area < 99.0f)
+        {
+            CHECK(culler.IsCulled(i));
+            CHECK(culler.Fade(i) == 0.0f);
+        }
+        else if (area > 101.0f && area < 299.0f)
+        {
+            CHECK(!culler.IsCulled(i));
+            CHECK_NEAR(culler.Fade(i), (area - 100.0f) / 200.0f, 1e-3);
+        }
+        else if (area > 301.0f)
+            CHECK(culler.Fade(i) == 1.0f);
+    }
+
+    // A fade area at or under the threshold: opaque until culled.
+    settings.FadePixelArea = 50.0f;
+    visible = AllItems(bounds.Count());
+    culled.clear();
+    culler.Cull(lens, bounds, settings, nullptr, visible, culled);
+    for (std::uint32_t i : visible)
+        CHECK(culler.Fade(i) == 1.0f);
+    CHECK(!visible.empty() && !culled.empty());
+
+    // No threshold: nothing culled, everything opaque.
+    settings = {};
+    visible = AllItems(bounds.Count());
+    culled.clear();
+    culler.Cull(lens, bounds, settings, nullptr, visible, culled);
+    CHECK(visible.size() == bounds.Count() && culled.empty());
+    for (std::uint32_t i = 0; i < bounds.Count(); ++i)
+        CHECK(culler.Fade(i) == 1.0f);
+}
+
+TEST_CASE(CullKeepsTheOrder)
+{
+    BoundsSoA bounds;
+    FillBoxes(bounds, 5000, 2);
+    const ContributionLens lens = ContributionCull::MakeLens({ 0.0f, 1.0f, 0.0f }, 1.0f, 0.5f, 1080.0f);
+    ContributionCuller::Settings settings;
+    settings.MinPixelArea = 400.0f;
+    settings.FadePixelArea = 1600.0f;
+
+    // Every other item, out of order, to check that only the listed ones
+    // move and keep their order.
+    std::vector<std::uint32_t> listed;
+    for (std::uint32_t i = 1; i < bounds.Count(); i += 2)
+        listed.push_back(bounds.Count() - i);
+
+    ContributionCuller single, pooled;
+    ThreadPool pool(3);
+    std::vector<std::uint32_t> visible = listed, culled = { 12345 };
+    single.Cull(lens, bounds, settings, nullptr, visible, culled);
+    std::vector<std::uint32_t> pooledVisible = listed, pooledCulled = { 12345 };
+    pooled.Cull(lens, bounds, settings, &pool, pooledVisible, pooledCulled);
+    CHECK(visible == pooledVisible && culled == pooledCulled);
+    for (std::uint32_t i = 0; i < bounds.Count(); ++i)
+        CHECK(single.Fade(i) == pooled.Fade(i) && single.IsCulled(i) == pooled.IsCulled(i));
+
+    std::vector<std::uint32_t> expectedVisible, expectedCulled = { 12345 };
+    for (std::uint32_t i : listed)
+    {
+        const float area = ContributionCull::ProjectedArea(lens, bounds.Center(i), bounds.Extents(i));
+        CHECK(single.IsCulled(i) == (area < settings.MinPixelArea));
+        (single.IsCulled(i) ? expectedCulled : expectedVisible).push_back(i);
+    }
+    CHECK(visible == expectedVisible);
+    CHECK(culled == expectedCulled);
+    CHECK(visible.size() > 100 && culled.size() > 100);
+}
+
+TEST_CASE(NewItemCountStartsOver)
+{
+    // An item culled and brought back within the hysteresis stays culled,
+    // until the bounds change size and the state is dropped.
+    BoundsSoA bounds;
+    bounds.Resize(1);
+    const ContributionLens lens = ContributionCull::MakeLens({}, 1.0f, 0.1f, 1000.0f);
+    const float lowDistance = (float)std::sqrt(Pi * lens.PixelScale * lens.PixelScale / 50.0 + 1.0);
+    const float midDistance = (float)std::sqrt(Pi * lens.PixelScale * lens.PixelScale / 110.0 + 1.0);
+    ContributionCuller::Settings settings;
+    settings.MinPixelArea = 100.0f;
+
+    ContributionCuller culler;
+    std::vector<std::uint32_t> visible = { 0 }, culled;
+    SetSphere(bounds, 0, lowDistance, 1.0f);
+    culler.Cull(lens, bounds, settings, nullptr, visible, culled);
+    CHECK(culler.IsCulled(0));
+
+    SetSphere(bounds, 0, midDistance, 1.0f);
+    visible = { 0 };
+    culler.Cull(lens, bounds, settings, nullptr, visible, culled);
+    CHECK(culler.IsCulled(0));
+
+    bounds.Resize(2);
+    SetSphere(bounds, 0, midDistance, 1.0f);
+    SetSphere(bounds, 1, midDistance, 1.0f);
+    visible = { 0, 1 };
+    culled.clear();
+    culler.Cull(lens, bounds, settings, nullptr, visible, culled);
+    CHECK(!culler.IsCulled(0) && !culler.IsCulled(1));
+    CHECK(visible.size() == 2 && culled.empty());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Utility/SimdMath.h"
+
+#include <cmath>
+
+// Camera matrices for the culling tests and benchmarks, built the way
+// DirectXMath builds them (row vectors, left handed, D3D clip space) so
+// the tests see the same planes the engine does.
+namespace CullMath
+{
+    inline Float4x4 Multiply(const Float4x4& a, const Float4x4& b)
+    {
+        Float4x4 r = {};
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                for (int k = 0; k < 4; ++k)
+                    r.m[i][j] += a.m[i][k] * b.m[k][j];
+        return r;
+    }
+
+    // XMMatrixPerspectiveFovLH.
+    inline Float4x4 Perspective(float fovY, float aspect, float nearZ, float farZ)
+    {
+        const float yScale = 1.0f / std::tan(0.5f * fovY);
+        const float range = farZ / (farZ - nearZ);
+        Float4x4 r = {};
+        r.m[0][0] = yScale / aspect;
+        r.m[1][1] = yScale;
+        r.m[2][2] = range;
+        r.m[2][3] = 1.0f;
+        r.m[3][2] = -range * nearZ;
+        return r;
+    }
+
+    // View from eye turned by yaw around +y and pitch around +x, the
+    // inverse of the camera's world matrix.
+    inline Float4x4 View(const Float3& eye, float yaw, float pitch)
+    {
+        const float cy = std::cos(yaw), sy = std::sin(yaw);
+        const float cp = std::cos(pitch), sp = std::sin(pitch);
+        // Camera axes in world space.
+        const Float3 right = { cy, 0.0f, -sy };
+        const Float3 up = { sy * sp, cp, cy * sp };
+        const Float3 look = { sy * cp, -sp, cy * cp };
+
+        auto dot = [](const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; };
+        Float4x4 r = Float4x4::Identity();
+        r.m[0][0] = right.x; r.m[1][0] = right.y; r.m[2][0] = right.z;
+        r.m[0][1] = up.x;    r.m[1][1] = up.y;    r.m[2][1] = up.z;
+        r.m[0][2] = look.x;  r.m[1][2] = look.y;  r.m[2][2] = look.z;
+        r.m[3][0] = -dot(right, eye);
+        r.m[3][1] = -dot(up, eye);
+        r.m[3][2] = -dot(look, eye);
+        return r;
+    }
+
+    inline Float4 Transform(const Float3& p, const Float4x4& m)
+    {
+        return { p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+                 p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+                 p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2],
+                 p.x * m.m[0][3] + p.y * m.m[1][3] + p.z * m.m[2][3] + m.m[3][3] };
+    }
+}
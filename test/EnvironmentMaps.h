@@ -0,0 +1,70 @@
+#pragma once
+
+#include "TestFramework.h"
+
+#include "Utility/CubeMapImage.h"
+
+#include <cmath>
+#include <functional>
+
+// Cube map environments for the lighting tests: filled from a radiance
+// function of direction, or with noise.
+namespace EnvironmentMaps
+{
+    constexpr double Pi = 3.14159265358979323846;
+
+    using Radiance = std::function<Float3(const Float3&)>;
+
+    inline Float3 Normalize(const Float3& v)
+    {
+        const float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+        return { v.x / length, v.y / length, v.z / length };
+    }
+
+    // Direction through the center of texel (x, y) of a face size texels
+    // wide.
+    inline Float3 TexelNormal(std::uint32_t face, std::uint32_t x, std::uint32_t y, std::uint32_t size)
+    {
+        return Normalize(CubeMapImage::Direction(face, (x + 0.5f) * 2.0f / size - 1.0f, (y + 0.5f) * 2.0f / size - 1.0f));
+    }
+
+    // radiance sampled at every texel center.
+    inline CubeMapImage Make(std::uint32_t size, const Radiance& radiance)
+    {
+        CubeMapImage image(size);
+        for (std::uint32_t face = 0; face < 6; ++face)
+        {
+            CubeMapImage::Face& texels = image.GetFace(face);
+            for (std::uint32_t y = 0; y < size; ++y)
+            {
+                for (std::uint32_t x = 0; x < size; ++x)
+                {
+                    const Float3 value = radiance(TexelNormal(face, x, y, size));
+                    const std::size_t i = (std::size_t)y * size + x;
+                    texels.R[i] = value.x;
+                    texels.G[i] = value.y;
+                    texels.B[i] = value.z;
+                }
+            }
+        }
+        return image;
+    }
+
+    // Uncorrelated texels, red up to 4, green up to 1, blue up to 2.
+    inline CubeMapImage Random(std::uint32_t size, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        CubeMapImage image(size);
+        for (std::uint32_t face = 0; face < 6; ++face)
+        {
+            CubeMapImage::Face& texels = image.GetFace(face);
+            for (std::size_t i = 0; i < texels.R.size(); ++i)
+            {
+                texels.R[i] = random.Float(0.0f, 4.0f);
+                texels.G[i] = random.Float(0.0f, 1.0f);
+                texels.B[i] = random.Float(0.0f, 2.0f);
+            }
+        }
+        return image;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+// Checks on what the cache writers leave on disk.
+namespace FileCheck
+{
+    // Whether a write to path left a temporary file beside it.  Every
+    // writer names its own through TempFile::UniquePath, so this looks for
+    // any path.*.tmp rather than one name.
+    inline bool HasTempFiles(const std::string& path)
+    {
+        const std::filesystem::path target(path);
+        const std::string prefix = target.filename().string() + ".";
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(target.parent_path(), ec))
+        {
+            const std::string name = entry.path().filename().string();
+            if (name.size() > prefix.size() + 4 && name.compare(0, prefix.size(), prefix) == 0
+                && name.compare(name.size() - 4, 4, ".tmp") == 0)
+                return true;
+        }
+        return false;
+    }
+}
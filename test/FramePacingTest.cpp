@@ -0,0 +1,76 @@
+#include "TestFramework.h"
+
+#include "Structure/FramePacing.h"
+
+TEST_CASE(RingStartsAtZeroAndWraps)
+{
+    for (std::uint32_t frames = 1; frames <= 4; ++frames)
+    {
+        FramePacing pacing({ frames, LatencyMode::Throughput });
+        CHECK(pacing.FrameResourceCount() == frames);
+        for (std::uint32_t i = 0; i < 3 * frames; ++i)
+            CHECK(pacing.Advance() == i % frames);
+        CHECK(pacing.FrameCount() == 3 * frames);
+        CHECK(pacing.CurrentFrame() == frames - 1);
+    }
+}
+
+TEST_CASE(FramesInFlightAreClamped)
+{
+    FramePacing pacing({ 0, LatencyMode::Throughput });
+    CHECK(pacing.Settings().FramesInFlight == FramePacing::MinFramesInFlight);
+    pacing.Request({ 9, LatencyMode::Throughput });
+    pacing.ApplyPending();
+    CHECK(pacing.Settings().FramesInFlight == FramePacing::MaxFramesInFlight);
+    CHECK(pacing.SwapChainBufferCount() <= FramePacing::MaxSwapChainBufferCount);
+}
+
+TEST_CASE(SwapChainAndLatencyFollowTheMode)
+{
+    struct Expected
+    {
+        FramePacingSettings Settings;
+        std::uint32_t FrameResources, SwapChainBuffers, Latency;
+    };
+    const Expected table[] =
+    {
+        { { 1, LatencyMode::Throughput }, 1, 2, 1 },
+        { { 2, LatencyMode::Throughput }, 2, 3, 2 },
+        { { 3, LatencyMode::Throughput }, 3, 4, 3 },
+        { { 4, LatencyMode::Throughput }, 4, 5, 4 },
+        { { 1, LatencyMode::LowLatency }, 1, 2, 1 },
+        { { 2, LatencyMode::LowLatency }, 2, 2, 1 },
+        { { 4, LatencyMode::LowLatency }, 2, 2, 1 },
+    };
+    for (const Expected& e : table)
+    {
+        FramePacing pacing(e.Settings);
+        CHECK(pacing.FrameResourceCount() == e.FrameResources);
+        CHECK(pacing.SwapChainBufferCount() == e.SwapChainBuffers);
+        CHECK(pacing.MaxFrameLatency() == e.Latency);
+    }
+}
+
+TEST_CASE(RequestsWaitForApplyPending)
+{
+    FramePacing pacing({ 3, LatencyMode::Throughput });
+    pacing.Advance();
+    pacing.Advance();
+    CHECK(!pacing.HasPendingChange());
+
+    pacing.Request({ 3, LatencyMode::Throughput });
+    CHECK(!pacing.HasPendingChange());
+
+    pacing.Request({ 2, LatencyMode::LowLatency });
+    CHECK(pacing.HasPendingChange());
+    CHECK(pacing.FrameResourceCount() == 3);
+    CHECK(pacing.Advance() == 2);
+
+    // The ring restarts on the new frame resources.
+    pacing.ApplyPending();
+    CHECK(!pacing.HasPendingChange());
+    CHECK(pacing.FrameCount() == 0);
+    CHECK(pacing.Advance() == 0);
+    CHECK(pacing.Advance() == 1);
+    CHECK(pacing.Advance() == 0);
+}
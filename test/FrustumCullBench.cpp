@@ -0,0 +1,42 @@
+#include "Benchmark.h"
+#include "CullMath.h"
+
+#include "Utility/FrustumCull.h"
+#include "Utility/ThreadPool.h"
+
+#include <cstdio>
+#include <vector>
+
+BENCHMARK(CullBoxes)
+{
+    const Frustum frustum = FrustumCull::ExtractFrustum(CullMath::Multiply(
+        CullMath::View({ 0.0f, 10.0f, -300.0f }, 0.3f, 0.1f), CullMath::Perspective(1.0f, 16.0f / 9.0f, 0.5f, 1000.0f)));
+    ThreadPool pool;
+    FrustumCuller culler;
+
+    for (std::uint32_t count : { 100000u, 1000000u })
+    {
+        // Boxes over a 1 km square, about half of them in view.
+        BoundsSoA bounds;
+        bounds.Resize(count);
+        std::uint32_t state = 12345;
+        auto next = [&]() { state = state * 1664525u + 1013904223u; return (float)(state >> 8) * (1.0f / 16777216.0f); };
+        for (std::uint32_t i = 0; i < count; ++i)
+            bounds.Set(i, { next() * 1000.0f - 500.0f, next() * 40.0f, next() * 1000.0f - 500.0f }, { 1.0f + next(), 1.0f + next(), 1.0f + next() });
+
+        std::vector<std::uint32_t> visible(count);
+        std::uint32_t visibleCount = 0;
+        const double scalar = Bench::Time([&] { visibleCount = FrustumCull::CullRangeScalar(frustum, bounds, 0, count, visible.data()); });
+        const double simd = Bench::Time([&] { FrustumCull::CullRange(frustum, bounds, 0, count, visible.data()); });
+        const double pooled = Bench::Time([&] { culler.Cull(frustum, bounds, &pool, visible); });
+        Bench::Consume(visible.data());
+
+        char label[96];
+        std::snprintf(label, sizeof(label), "%uk boxes (%u visible), scalar", count / 1000, visibleCount);
+        Bench::Report(label, scalar, (double)count, "boxes");
+        std::snprintf(label, sizeof(label), "%uk boxes, AVX2", count / 1000);
+        Bench::Report(label, simd, (double)count, "boxes");
+        std::snprintf(label, sizeof(label), "%uk boxes, AVX2 on %u threads", count / 1000, pool.WorkerCount() + 1);
+        Bench::Report(label, pooled, (double)count, "boxes");
+    }
+}
@@ -0,0 +1,224 @@
+#include "TestFramework.h"
+#include "CullMath.h"
+
+#include "Utility/FrustumCull.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    enum class Expect { Visible, Culled, Either };
+
+    // The clip space test on the eight corners, apart from the planes: a box
+    // is outside when all corners fail the same one of -w <= x <= w,
+    // -w <= y <= w, 0 <= z <= w.  Boxes within margin of deciding either way
+    // are left to rounding.
+    Expect Reference(const Float4x4& viewProj, const Float3& center, const Float3& extents, float margin)
+    {
+        float nearest[6];
+        for (float& n : nearest)
+            n = -1e30f;
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            const Float3 p = {
+                center.x + (corner & 1 ? extents.x : -extents.x),
+                center.y + (corner & 2 ? extents.y : -extents.y),
+                center.z + (corner & 4 ? extents.z : -extents.z) };
+            const Float4 c = CullMath::Transform(p, viewProj);
+            const float inside[6] = { c.w + c.x, c.w - c.x, c.w + c.y, c.w - c.y, c.z, c.w - c.z };
+            for (int k = 0; k < 6; ++k)
+                nearest[k] = std::max(nearest[k], inside[k]);
+        }
+
+        bool clear = true;
+        for (int k = 0; k < 6; ++k)
+        {
+            if (nearest[k] < -margin)
+                return Expect::Culled;
+            clear = clear && nearest[k] > margin;
+        }
+        return clear ? Expect::Visible : Expect::Either;
+    }
+
+    Float4x4 Camera(float yaw, float pitch, const Float3& eye)
+    {
+        return CullMath::Multiply(CullMath::View(eye, yaw, pitch), CullMath::Perspective(1.0f, 16.0f / 9.0f, 0.5f, 200.0f));
+    }
+
+    void FillBoxes(BoundsSoA& bounds, std::uint32_t count, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        bounds.Resize(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            const Float3 center = { random.Float(-250.0f, 250.0f), random.Float(-60.0f, 60.0f), random.Float(-250.0f, 250.0f) };
+            const float size = random.Float(0.0f, 1.0f) < 0.1f ? 40.0f : 3.0f;
+            bounds.Set(i, center, { random.Float(0.0f, size), random.Float(0.0f, size), random.Float(0.0f, size) });
+        }
+    }
+}
+
+TEST_CASE(PlanesMatchTheClipSpaceTest)
+{
+    Test::Random random(1);
+    for (int camera = 0; camera < 20; ++camera)
+    {
+        const Float4x4 viewProj = Camera(random.Float(-3.2f, 3.2f), random.Float(-1.2f, 1.2f),
+            { random.Float(-50.0f, 50.0f), random.Float(-10.0f, 10.0f), random.Float(-50.0f, 50.0f) });
+        const Frustum frustum = FrustumCull::ExtractFrustum(viewProj);
+
+        BoundsSoA bounds;
+        FillBoxes(bounds, 2000, 100 + camera);
+        int visible = 0, culled = 0;
+        for (std::uint32_t i = 0; i < bounds.Count(); ++i)
+        {
+            const bool result = FrustumCull::IsVisible(frustum, bounds.Center(i), bounds.Extents(i));
+            switch (Reference(viewProj, bounds.Center(i), bounds.Extents(i), 1e-3f))
+            {
+            case Expect::Visible: CHECK(result); ++visible; break;
+            case Expect::Culled:  CHECK(!result); ++culled; break;
+            case Expect::Either:  break;
+            }
+        }
+        // The cameras see something and cull something.
+        CHECK(visible > 0 && culled > 0);
+    }
+}
+
+TEST_CASE(PointsInsideAreVisible)
+{
+    // Points picked in view space and carried to the world along the camera
+    // axes, so no inverse projection is needed: a point at view depth d is
+    // inside when |x| <= d * tan(fov / 2) * aspect and so on.
+    const Float3 eye = { 3.0f, 2.0f, -7.0f };
+    const float yaw = 0.7f, pitch = -0.3f;
+    const Float4x4 viewProj = Camera(yaw, pitch, eye);
+    const Frustum frustum = FrustumCull::ExtractFrustum(viewProj);
+
+    const float cy = std::cos(yaw), sy = std::sin(yaw), cp = std::cos(pitch), sp = std::sin(pitch);
+    const Float3 right = { cy, 0.0f, -sy }, up = { sy * sp, cp, cy * sp }, look = { sy * cp, -sp, cy * cp };
+    const float tanY = std::tan(0.5f), tanX = tanY * 16.0f / 9.0f;
+
+    Test::Random random(2);
+    for (int i = 0; i < 10000; ++i)
+    {
+        const float depth = random.Float(0.5f, 200.0f) * 0.999f + 0.001f;
+        const float x = random.Float(-1.0f, 1.0f) * depth * tanX * 0.999f;
+        const float y = random.Float(-1.0f, 1.0f) * depth * tanY * 0.999f;
+        const Float3 p = {
+            eye.x + right.x * x + up.x * y + look.x * depth,
+            eye.y + right.y * x + up.y * y + look.y * depth,
+            eye.z + right.z * x + up.z * y + look.z * depth };
+        CHECK(FrustumCull::IsVisible(frustum, p, { 0.0f, 0.0f, 0.0f }));
+
+        // And just behind the camera, never.
+        const Float3 behind = { eye.x - look.x, eye.y - look.y, eye.z - look.z };
+        CHECK(!FrustumCull::IsVisible(frustum, behind, { 0.0f, 0.0f, 0.0f }));
+    }
+}
+
+TEST_CASE(SimdMatchesScalarOnEveryTail)
+{
+    const Frustum frustum = FrustumCull::ExtractFrustum(Camera(0.4f, 0.1f, { 0.0f, 0.0f, -20.0f }));
+    BoundsSoA bounds;
+    std::vector<std::uint32_t> simd, scalar;
+
+    // Counts around the vector width, and ranges starting on any multiple
+    // of eight with any end.
+    for (std::uint32_t count : { 0u, 1u, 7u, 8u, 9u, 15u, 16u, 17u, 1000u, 1023u })
+    {
+        FillBoxes(bounds, count, count);
+        simd.resize(count);
+        scalar.resize(count);
+        for (std::uint32_t begin = 0; begin <= count; begin += 8)
+        {
+            for (std::uint32_t end = begin; end <= count; end += (count > 64 ? 61 : 1))
+            {
+                const std::uint32_t n = FrustumCull::CullRange(frustum, bounds, begin, end, simd.data());
+                const std::uint32_t m = FrustumCull::CullRangeScalar(frustum, bounds, begin, end, scalar.data());
+                CHECK(n == m);
+                CHECK(std::equal(simd.begin(), simd.begin() + std::min(n, m), scalar.begin()));
+            }
+        }
+    }
+}
+
+TEST_CASE(PooledCullKeepsIndexOrder)
+{
+    const Frustum frustum = FrustumCull::ExtractFrustum(Camera(-1.1f, 0.2f, { 10.0f, 5.0f, 10.0f }));
+    ThreadPool pool(3);
+    FrustumCuller culler;
+    BoundsSoA bounds;
+    std::vector<std::uint32_t> pooled, single, scalar;
+
+    for (std::uint32_t count : { 0u, 5u, FrustumCuller::GrainSize, FrustumCuller::GrainSize + 1, 50000u })
+    {
+        FillBoxes(bounds, count, 7 + count);
+        culler.Cull(frustum, bounds, &pool, pooled);
+        culler.Cull(frustum, bounds, nullptr, single);
+        scalar.resize(count);
+        scalar.resize(FrustumCull::CullRangeScalar(frustum, bounds, 0, count, scalar.data()));
+
+        CHECK(pooled == scalar);
+        CHECK(single == scalar);
+        CHECK(std::is_sorted(pooled.begin(), pooled.end()));
+    }
+}
+
+TEST_CASE(TransformedBoxesAreTight)
+{
+    Test::Random random(3);
+    for (int i = 0; i < 1000; ++i)
+    {
+        // Rotation about a random axis, non-uniform scale, translation.
+        const float angle = random.Float(-3.2f, 3.2f);
+        float ax = random.Float(-1.0f, 1.0f), ay = random.Float(-1.0f, 1.0f), az = random.Float(-1.0f, 1.0f);
+        const float length = std::sqrt(ax * ax + ay * ay + az * az) + 1e-6f;
+        ax /= length; ay /= length; az /= length;
+        const float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+        const float scale[3] = { random.Float(0.1f, 4.0f), random.Float(0.1f, 4.0f), random.Float(0.1f, 4.0f) };
+        const float rotation[3][3] = {
+            { t * ax * ax + c,      t * ax * ay + s * az, t * ax * az - s * ay },
+            { t * ax * ay - s * az, t * ay * ay + c,      t * ay * az + s * ax },
+            { t * ax * az + s * ay, t * ay * az - s * ax, t * az * az + c } };
+        Float4x4 world = Float4x4::Identity();
+        for (int r = 0; r < 3; ++r)
+            for (int k = 0; k < 3; ++k)
+                world.m[r][k] = scale[r] * rotation[r][k];
+        world.m[3][0] = random.Float(-100.0f, 100.0f);
+        world.m[3][1] = random.Float(-100.0f, 100.0f);
+        world.m[3][2] = random.Float(-100.0f, 100.0f);
+
+        const Float3 center = { random.Float(-5.0f, 5.0f), random.Float(-5.0f, 5.0f), random.Float(-5.0f, 5.0f) };
+        const Float3 extents = { random.Float(0.0f, 3.0f), random.Float(0.0f, 3.0f), random.Float(0.0f, 3.0f) };
+        Float3 worldCenter, worldExtents;
+        FrustumCull::TransformBox(center, extents, world, worldCenter, worldExtents);
+
+        // Every corner inside, and some corner on each face.
+        float low[3] = { 1e30f, 1e30f, 1e30f }, high[3] = { -1e30f, -1e30f, -1e30f };
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            const Float3 p = {
+                center.x + (corner & 1 ? extents.x : -extents.x),
+                center.y + (corner & 2 ? extents.y : -extents.y),
+                center.z + (corner & 4 ? extents.z : -extents.z) };
+            const Float4 q = CullMath::Transform(p, world);
+            const float v[3] = { q.x, q.y, q.z };
+            for (int k = 0; k < 3; ++k)
+            {
+                low[k] = std::min(low[k], v[k]);
+                high[k] = std::max(high[k], v[k]);
+            }
+        }
+        const float wc[3] = { worldCenter.x, worldCenter.y, worldCenter.z };
+        const float we[3] = { worldExtents.x, worldExtents.y, worldExtents.z };
+        for (int k = 0; k < 3; ++k)
+        {
+            CHECK_NEAR(low[k], wc[k] - we[k], 1e-3);
+            CHECK_NEAR(high[k], wc[k] + we[k], 1e-3);
+        }
+    }
+}
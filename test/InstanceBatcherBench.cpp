@@ -0,0 +1,46 @@
+#include "Benchmark.h"
+
+#include "Utility/InstanceBatcher.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    // count items over meshes * materials combinations, in a scrambled
+    // order like a visible list before sorting.
+    std::vector<BatchItem> MakeItems(std::uint32_t count, std::uint32_t meshes, std::uint32_t materials)
+    {
+        std::vector<BatchItem> items(count);
+        std::uint32_t state = 12345;
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            state = state * 1664525u + 1013904223u;
+            const std::uint32_t mesh = (state >> 8) % meshes;
+            const std::uint32_t material = (state >> 20) % materials;
+            BatchItem& item = items[i];
+            item.Geometry = reinterpret_cast<const void*>(std::uintptr_t(0x1000 + 64 * mesh));
+            item.Material = reinterpret_cast<const void*>(std::uintptr_t(0x100000 + 64 * material));
+            item.IndexCount = 36;
+            item.StartIndexLocation = 36 * mesh;
+            item.InstanceIndex = i;
+        }
+        return items;
+    }
+}
+
+BENCHMARK(Batch100kItems)
+{
+    InstanceBatcher batcher;
+    for (std::uint32_t combinations : { 1u, 64u, 4096u })
+    {
+        auto items = MakeItems(100000, combinations, combinations >= 64 ? 64 : 1);
+        const double seconds = Bench::Time([&] { batcher.Build(items.data(), items.size()); });
+        Bench::Consume(batcher.InstanceIndices().data());
+
+        char label[64];
+        std::snprintf(label, sizeof(label), "100k items, %zu batches", batcher.Batches().size());
+        Bench::Report(label, seconds, (double)items.size(), "items");
+    }
+}
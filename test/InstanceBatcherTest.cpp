@@ -0,0 +1,130 @@
+#include "TestFramework.h"
+
+#include "Utility/InstanceBatcher.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace
+{
+    // Fake geometry and material addresses, only compared.
+    const void* Pointer(std::uint32_t id) { return reinterpret_cast<const void*>(std::uintptr_t(0x1000 + 16 * id)); }
+
+    std::vector<BatchItem> RandomItems(std::uint32_t count, std::uint32_t meshes, std::uint32_t materials, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        std::vector<BatchItem> items(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            BatchItem& item = items[i];
+            const std::uint32_t mesh = random.Next32() % meshes;
+            item.Geometry = Pointer(mesh % 3);
+            item.Material = Pointer(100 + random.Next32() % materials);
+            item.PipelineState = random.Next32() % 2;
+            item.PrimitiveTopology = 4;
+            item.IndexCount = 36 + 3 * mesh;
+            item.StartIndexLocation = 100 * mesh;
+            item.BaseVertexLocation = (std::int32_t)(10 * mesh);
+            item.InstanceIndex = i;
+        }
+        return items;
+    }
+
+    using BatchKey = std::tuple<const void*, const void*, std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t, std::int32_t>;
+
+    BatchKey KeyOf(const BatchItem& item)
+    {
+        return { item.Geometry, item.Material, item.PipelineState, item.PrimitiveTopology,
+            item.IndexCount, item.StartIndexLocation, item.BaseVertexLocation };
+    }
+
+    BatchKey KeyOf(const InstanceBatch& batch)
+    {
+        return { batch.Geometry, batch.Material, batch.PipelineState, batch.PrimitiveTopology,
+            batch.IndexCount, batch.StartIndexLocation, batch.BaseVertexLocation };
+    }
+
+    // The grouping the batcher should produce, the simple way.
+    void CheckAgainstReference(const InstanceBatcher& batcher, const std::vector<BatchItem>& items)
+    {
+        std::map<BatchKey, std::size_t> batchOf;
+        std::vector<BatchKey> order;
+        std::vector<std::vector<std::uint32_t>> instances;
+        for (const BatchItem& item : items)
+        {
+            auto inserted = batchOf.emplace(KeyOf(item), order.size());
+            if (inserted.second)
+            {
+                order.push_back(KeyOf(item));
+                instances.emplace_back();
+            }
+            instances[inserted.first->second].push_back(item.InstanceIndex);
+        }
+
+        const auto& batches = batcher.Batches();
+        const auto& indices = batcher.InstanceIndices();
+        CHECK(batches.size() == order.size());
+        CHECK(indices.size() == items.size());
+        if (batches.size() != order.size())
+            return;
+
+        std::uint32_t next = 0;
+        for (std::size_t b = 0; b < batches.size(); ++b)
+        {
+            CHECK(KeyOf(batches[b]) == order[b]);
+            CHECK(batches[b].FirstInstance == next);
+            CHECK(batches[b].InstanceCount == instances[b].size());
+            for (std::uint32_t i = 0; i < batches[b].InstanceCount && i < instances[b].size(); ++i)
+                CHECK(indices[batches[b].FirstInstance + i] == instances[b][i]);
+            next += batches[b].InstanceCount;
+        }
+    }
+}
+
+TEST_CASE(GroupsMatchTheReference)
+{
+    InstanceBatcher batcher;
+    for (std::uint64_t seed = 1; seed <= 4; ++seed)
+    {
+        auto items = RandomItems(5000, 7, 5, seed);
+        batcher.Build(items.data(), items.size());
+        CheckAgainstReference(batcher, items);
+    }
+}
+
+TEST_CASE(TableGrowsPastItsFirstSize)
+{
+    // More batches than the initial 64 slots hold at half load.
+    InstanceBatcher batcher;
+    auto items = RandomItems(20000, 200, 40, 7);
+    batcher.Build(items.data(), items.size());
+    CHECK(batcher.Batches().size() > 1000);
+    CheckAgainstReference(batcher, items);
+
+    // A smaller build after a large one starts from clean state.
+    auto few = RandomItems(50, 2, 1, 8);
+    batcher.Build(few.data(), few.size());
+    CheckAgainstReference(batcher, few);
+}
+
+TEST_CASE(SortedRunsStaySorted)
+{
+    auto items = RandomItems(1000, 4, 2, 9);
+    std::stable_sort(items.begin(), items.end(), [](const BatchItem& a, const BatchItem& b) { return KeyOf(a) < KeyOf(b); });
+
+    InstanceBatcher batcher;
+    batcher.Build(items.data(), items.size());
+    CheckAgainstReference(batcher, items);
+    const auto& batches = batcher.Batches();
+    for (std::size_t b = 1; b < batches.size(); ++b)
+        CHECK(KeyOf(batches[b - 1]) < KeyOf(batches[b]));
+}
+
+TEST_CASE(EmptyInput)
+{
+    InstanceBatcher batcher;
+    batcher.Build(nullptr, 0);
+    CHECK(batcher.Batches().empty());
+    CHECK(batcher.InstanceIndices().empty());
+}
@@ -0,0 +1,258 @@
+#include "TestFramework.h"
+#include "CullMath.h"
+
+#include "Utility/LightClusters.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    LightClusters::Config MakeConfig()
+    {
+        LightClusters::Config config;
+        config.TilesX = 16;
+        config.TilesY = 9;
+        config.Slices = 24;
+        config.TanHalfFovY = std::tan(0.5f);
+        config.TanHalfFovX = config.TanHalfFovY * 16.0f / 9.0f;
+        config.NearZ = 0.5f;
+        config.FarZ = 200.0f;
+        return config;
+    }
+
+    struct TestLight
+    {
+        Float3 Position;
+        float Range;
+        Float3 Direction;
+        float CosAngle;
+    };
+
+    // Point and spot lights scattered around the camera at the origin.
+    std::vector<TestLight> AddLights(LightClusters& clusters, std::uint32_t count, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        std::vector<TestLight> lights;
+        clusters.ClearLights();
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            TestLight light;
+            light.Position = { random.Float(-60.0f, 60.0f), random.Float(-10.0f, 20.0f), random.Float(-30.0f, 120.0f) };
+            light.Range = random.Float(1.0f, 15.0f);
+            if (i % 3 == 2)
+            {
+                light.Direction = { random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f) };
+                light.CosAngle = random.Float(0.3f, 0.98f);
+                clusters.AddSpotLight(light.Position, light.Range, light.Direction, light.CosAngle);
+            }
+            else
+            {
+                light.Direction = {};
+                light.CosAngle = -1.0f;
+                clusters.AddPointLight(light.Position, light.Range);
+            }
+            lights.push_back(light);
+        }
+        return lights;
+    }
+
+    // Whether the light reaches world point p.
+    bool Lights(const TestLight& light, const Float3& p)
+    {
+        const float dx = p.x - light.Position.x, dy = p.y - light.Position.y, dz = p.z - light.Position.z;
+        const float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (distance > light.Range)
+            return false;
+        if (light.CosAngle <= -1.0f)
+            return true;
+        const Float3& d = light.Direction;
+        const float length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+        return dx * d.x + dy * d.y + dz * d.z >= light.CosAngle * distance * length;
+    }
+
+    bool Listed(const LightClusters& clusters, std::uint32_t cluster, std::uint32_t light)
+    {
+        const LightClusters::Range range = clusters.Ranges()[cluster];
+        const std::uint32_t* first = clusters.Indices().data() + range.Offset;
+        return std::find(first, first + range.Count, light) != first + range.Count;
+    }
+}
+
+TEST_CASE(EveryLitPointFindsItsLight)
+{
+    // Brute force: points all over the view volume, the cluster the shader
+    // would pick for each, and every light that reaches the point.
+    LightClusters clusters;
+    const LightClusters::Config config = MakeConfig();
+    clusters.Configure(config);
+    ThreadPool pool(3);
+
+    Test::Random random(1);
+    for (int frame = 0; frame < 4; ++frame)
+    {
+        const Float3 eye = { random.Float(-10.0f, 10.0f), random.Float(0.0f, 5.0f), random.Float(-10.0f, 10.0f) };
+        const float yaw = random.Float(-0.5f, 0.5f), pitch = random.Float(-0.3f, 0.3f);
+        const Float4x4 view = CullMath::View(eye, yaw, pitch);
+        const std::vector<TestLight> lights = AddLights(clusters, 300, 10 + frame);
+        clusters.Assign(view, frame % 2 ? &pool : nullptr);
+
+        const float cy = std::cos(yaw), sy = std::sin(yaw), cp = std::cos(pitch), sp = std::sin(pitch);
+        const Float3 right = { cy, 0.0f, -sy }, up = { sy * sp, cp, cy * sp }, look = { sy * cp, -sp, cy * cp };
+
+        int lit = 0;
+        for (int i = 0; i < 20000; ++i)
+        {
+            // The pixel the point lands on, in [0, 1) over the screen.
+            const float u = random.Float(0.0f, 1.0f), v = random.Float(0.0f, 1.0f);
+            const float depth = config.NearZ * std::pow(config.FarZ / config.NearZ, random.Float(0.0f, 0.8f));
+            const float vx = (2.0f * u - 1.0f) * config.TanHalfFovX * depth;
+            const float vy = (1.0f - 2.0f * v) * config.TanHalfFovY * depth;
+            const Float3 p = {
+                eye.x + right.x * vx + up.x * vy + look.x * depth,
+                eye.y + right.y * vx + up.y * vy + look.y * depth,
+                eye.z + right.z * vx + up.z * vy + look.z * depth };
+
+            const std::uint32_t x = std::min((std::uint32_t)(u * config.TilesX), config.TilesX - 1);
+            const std::uint32_t y = std::min((std::uint32_t)(v * config.TilesY), config.TilesY - 1);
+            const float slice = std::floor(std::log(depth) * clusters.SliceScale() + clusters.SliceBias());
+            const std::uint32_t s = (std::uint32_t)std::clamp(slice, 0.0f, (float)config.Slices - 1.0f);
+            const std::uint32_t cluster = clusters.ClusterIndex(x, y, s);
+
+            for (std::uint32_t light = 0; light < lights.size(); ++light)
+            {
+                if (!Lights(lights[light], p))
+                    continue;
+                ++lit;
+                CHECK(Listed(clusters, cluster, light));
+            }
+        }
+        CHECK(lit > 1000);
+    }
+}
+
+TEST_CASE(AssignMatchesTheReference)
+{
+    LightClusters fast, reference;
+    fast.Configure(MakeConfig());
+    reference.Configure(MakeConfig());
+    ThreadPool pool(3);
+
+    for (std::uint32_t count : { 0u, 1u, 7u, 9u, 100u, 1000u })
+    {
+        AddLights(fast, count, count);
+        AddLights(reference, count, count);
+        const Float4x4 view = CullMath::View({ 1.0f, 2.0f, -3.0f }, 0.2f, 0.1f);
+        reference.AssignReference(view);
+
+        for (ThreadPool* p : { (ThreadPool*)nullptr, &pool })
+        {
+            fast.Assign(view, p);
+            CHECK(fast.Indices() == reference.Indices());
+            CHECK(fast.Ranges().size() == reference.Ranges().size());
+            bool same = true;
+            for (std::size_t c = 0; c < fast.Ranges().size() && c < reference.Ranges().size(); ++c)
+                same = same && fast.Ranges()[c].Offset == reference.Ranges()[c].Offset && fast.Ranges()[c].Count == reference.Ranges()[c].Count;
+            CHECK(same);
+        }
+    }
+}
+
+TEST_CASE(ClustersTileTheFrustum)
+{
+    LightClusters clusters;
+    const LightClusters::Config config = MakeConfig();
+    clusters.Configure(config);
+    CHECK(clusters.ClusterCount() == 16 * 9 * 24);
+
+    // Slice edges follow the exponential spacing.
+    for (std::uint32_t s = 0; s <= config.Slices; ++s)
+    {
+        const float z = config.NearZ * std::pow(config.FarZ / config.NearZ, (float)s / config.Slices);
+        CHECK_NEAR(std::log(z) * clusters.SliceScale() + clusters.SliceBias(), (float)s, 1e-3);
+    }
+
+    // Each cluster's box holds the corners of its piece of the frustum.
+    for (std::uint32_t s = 0; s < config.Slices; ++s)
+    {
+        const float zNear = config.NearZ * std::pow(config.FarZ / config.NearZ, (float)s / config.Slices);
+        const float zFar = config.NearZ * std::pow(config.FarZ / config.NearZ, (float)(s + 1) / config.Slices);
+        for (std::uint32_t y = 0; y < config.TilesY; ++y)
+        {
+            for (std::uint32_t x = 0; x < config.TilesX; ++x)
+            {
+                const LightClusters::Bounds& b = clusters.ClusterBounds(clusters.ClusterIndex(x, y, s));
+                for (int corner = 0; corner < 8; ++corner)
+                {
+                    const float z = corner & 4 ? zFar : zNear;
+                    const float ndcX = -1.0f + 2.0f * (float)(x + (corner & 1)) / config.TilesX;
+                    const float ndcY = 1.0f - 2.0f * (float)(y + ((corner >> 1) & 1)) / config.TilesY;
+                    const float px = ndcX * config.TanHalfFovX * z, py = ndcY * config.TanHalfFovY * z;
+                    CHECK(px >= b.Min.x - 1e-4f && px <= b.Max.x + 1e-4f);
+                    CHECK(py >= b.Min.y - 1e-4f && py <= b.Max.y + 1e-4f);
+                    CHECK(z >= b.Min.z && z <= b.Max.z);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE(LightsOutOfViewAreInNoCluster)
+{
+    LightClusters clusters;
+    clusters.Configure(MakeConfig());
+    const Float4x4 view = CullMath::View({ 0.0f, 0.0f, 0.0f }, 0.0f, 0.0f);
+
+    // Behind the camera, past the far plane, and a spot just behind the
+    // camera facing away, whose range alone would reach into view.
+    clusters.ClearLights();
+    clusters.AddPointLight({ 0.0f, 0.0f, -20.0f }, 5.0f);
+    clusters.AddPointLight({ 0.0f, 0.0f, 260.0f }, 5.0f);
+    clusters.AddSpotLight({ 0.0f, 0.0f, -1.0f }, 30.0f, { 0.0f, 0.0f, -1.0f }, 0.9f);
+    const std::uint32_t seen = clusters.AddSpotLight({ 0.0f, 0.0f, -1.0f }, 30.0f, { 0.0f, 0.0f, 1.0f }, 0.9f);
+    clusters.Assign(view, nullptr);
+
+    CHECK(!clusters.Indices().empty());
+    for (std::uint32_t light : clusters.Indices())
+        CHECK(light == seen);
+}
+
+TEST_CASE(CullLightsMatchesScalar)
+{
+    LightClusters clusters;
+    clusters.Configure(MakeConfig());
+    Test::Random random(5);
+    for (std::uint32_t count : { 0u, 1u, 7u, 8u, 9u, 31u, 500u })
+    {
+        LightClusters::LightSoA lights;
+        lights.Resize(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            lights.X[i] = random.Float(-40.0f, 40.0f);
+            lights.Y[i] = random.Float(-20.0f, 20.0f);
+            lights.Z[i] = random.Float(-10.0f, 100.0f);
+            lights.Radius[i] = random.Float(1.0f, 20.0f);
+            const bool spot = i % 2 == 1;
+            const float dx = random.Float(-1.0f, 1.0f), dy = random.Float(-1.0f, 1.0f), dz = random.Float(-1.0f, 1.0f);
+            const float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+            lights.DirX[i] = spot ? dx / length : 0.0f;
+            lights.DirY[i] = spot ? dy / length : 0.0f;
+            lights.DirZ[i] = spot ? dz / length : 0.0f;
+            lights.Cos[i] = spot ? random.Float(0.3f, 0.95f) : -1.0f;
+            lights.Sin[i] = spot ? std::sqrt(1.0f - lights.Cos[i] * lights.Cos[i]) : 0.0f;
+            lights.Id[i] = i;
+        }
+
+        std::vector<std::uint32_t> simd(count), scalar(count);
+        for (std::uint32_t cluster = 0; cluster < clusters.ClusterCount(); cluster += 37)
+        {
+            const LightClusters::Bounds& b = clusters.ClusterBounds(cluster);
+            const std::uint32_t n = LightClusters::CullLights(b, lights, count, simd.data());
+            const std::uint32_t m = LightClusters::CullLightsScalar(b, lights, count, scalar.data());
+            CHECK(n == m);
+            CHECK(std::equal(simd.begin(), simd.begin() + std::min(n, m), scalar.begin()));
+        }
+    }
+}
@@ -0,0 +1,183 @@
+#include "TestFramework.h"
+
+#include "Structure/LinearAllocator.h"
+
+#include <cstdlib>
+#include <memory>
+
+namespace
+{
+    // Pages from the heap, with fake GPU addresses far from the CPU ones
+    // so mixing them up shows.
+    class HeapPageProvider : public LinearPageProvider
+    {
+    public:
+        LinearAllocPage CreatePage(std::uint64_t byteSize) override
+        {
+            LinearAllocPage page;
+            page.CpuAddress = static_cast<std::uint8_t*>(std::malloc(byteSize));
+            page.GpuAddress = 0x100000000ull * ++mCreated;
+            page.Size = byteSize;
+            page.Handle = page.CpuAddress;
+            ++mLive;
+            return page;
+        }
+
+        void DestroyPage(LinearAllocPage& page) override
+        {
+            std::free(page.Handle);
+            page = {};
+            --mLive;
+        }
+
+        int mCreated = 0;
+        int mLive = 0;
+    };
+
+    constexpr std::uint64_t PageSize = 4096;
+}
+
+TEST_CASE(AllocationsAreAlignedAndBumpThroughAPage)
+{
+    HeapPageProvider provider;
+    LinearPagePool pool(&provider, PageSize);
+    LinearAllocator alloc(&pool);
+
+    LinearAllocation a = alloc.Allocate(100);
+    LinearAllocation b = alloc.Allocate(1);
+    LinearAllocation c = alloc.Allocate(16, 16);
+    CHECK(a && b && c);
+    CHECK(a.Size == 256 && b.Size == 256 && c.Size == 16);
+    CHECK(b.CpuAddress == a.CpuAddress + 256);
+    CHECK(c.CpuAddress == b.CpuAddress + 256);
+    CHECK(b.GpuAddress - a.GpuAddress == 256);
+    CHECK(!a.Retained);
+    CHECK(alloc.PageCount() == 1);
+    CHECK(alloc.BytesAllocated() == 528);
+    CHECK(!alloc.Allocate(0));
+}
+
+TEST_CASE(FullPageMovesToANewPage)
+{
+    HeapPageProvider provider;
+    LinearPagePool pool(&provider, PageSize);
+    LinearAllocator alloc(&pool);
+
+    alloc.Allocate(PageSize - 256);
+    LinearAllocation last = alloc.Allocate(256);
+    LinearAllocation spill = alloc.Allocate(512);
+    CHECK(alloc.PageCount() == 2);
+    CHECK(spill.GpuAddress != last.GpuAddress + 256);
+    CHECK(provider.mCreated == 2);
+
+    // Oversized requests get a page of their own, rounded to whole pages.
+    LinearAllocation large = alloc.Allocate(3 * PageSize + 1);
+    CHECK(large.Size == 3 * PageSize + 256);
+    CHECK(alloc.BytesReserved() == 2 * PageSize + 4 * PageSize);
+}
+
+TEST_CASE(ResetKeepsPagesAndAddresses)
+{
+    HeapPageProvider provider;
+    LinearPagePool pool(&provider, PageSize);
+    LinearAllocator alloc(&pool);
+
+    LinearAllocation first[3];
+    for (auto& a : first)
+        a = alloc.Allocate(PageSize / 2);
+    first[2].CpuAddress[0] = 42;
+
+    alloc.Reset(1);
+    LinearAllocation second[3];
+    for (auto& a : second)
+        a = alloc.Allocate(PageSize / 2);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK(second[i].CpuAddress == first[i].CpuAddress);
+        CHECK(second[i].GpuAddress == first[i].GpuAddress);
+        CHECK(second[i].Retained);
+    }
+    CHECK(second[2].CpuAddress[0] == 42);
+    CHECK(provider.mCreated == 2);
+}
+
+TEST_CASE(SurplusPagesWaitForTheirFence)
+{
+    HeapPageProvider provider;
+    LinearPagePool pool(&provider, PageSize);
+    LinearAllocator busy(&pool);
+    LinearAllocator other(&pool);
+
+    for (int i = 0; i < 4; ++i)
+        busy.Allocate(PageSize);
+    CHECK(busy.PageCount() == 4);
+
+    // The next frame only needs one page: three go back to the pool, fenced
+    // with the completed value Reset was given.
+    busy.Reset(5);
+    busy.Allocate(PageSize);
+    busy.Reset(5);
+    CHECK(busy.PageCount() == 1);
+    CHECK(pool.FreePageCount() == 3);
+
+    // Another allocator whose fence is behind cannot take them yet.
+    other.Reset(4);
+    other.Allocate(16);
+    CHECK(provider.mCreated == 5);
+    other.Release(4);
+
+    other.Reset(5);
+    other.Allocate(16);
+    CHECK(provider.mCreated == 5);
+}
+
+TEST_CASE(DiscardedPagesStayInFenceOrder)
+{
+    HeapPageProvider provider;
+    LinearPagePool pool(&provider, PageSize);
+
+    LinearAllocPage pages[3];
+    for (auto& page : pages)
+        page = pool.RequestPage(PageSize, 0);
+
+    // A resize hands back a page with a lower fence after a higher one.
+    pool.DiscardPages(10, &pages[0], 1);
+    pool.DiscardPages(20, &pages[1], 1);
+    pool.DiscardPages(15, &pages[2], 1);
+
+    CHECK(pool.RequestPage(PageSize, 10).CpuAddress == pages[0].CpuAddress);
+    CHECK(pool.RequestPage(PageSize, 15).CpuAddress == pages[2].CpuAddress);
+    LinearAllocPage fresh = pool.RequestPage(PageSize, 15);
+    CHECK(fresh.CpuAddress != pages[1].CpuAddress);
+    CHECK(pool.RequestPage(PageSize, 20).CpuAddress == pages[1].CpuAddress);
+
+    LinearAllocPage back[4] = { pages[0], pages[1], pages[2], fresh };
+    pool.DiscardPages(20, back, 4);
+}
+
+TEST_CASE(TrimFreesCompletedPages)
+{
+    HeapPageProvider provider;
+    {
+        LinearPagePool pool(&provider, PageSize);
+        LinearAllocator alloc(&pool);
+        for (int i = 0; i < 4; ++i)
+            alloc.Allocate(PageSize);
+        alloc.Allocate(8 * PageSize);
+        alloc.Release(3);
+        CHECK(pool.PageCount() == 5);
+        CHECK(pool.ResidentBytes() == 12 * PageSize);
+
+        // Nothing has completed yet.
+        pool.Trim(2, 1);
+        CHECK(provider.mLive == 5);
+
+        pool.Trim(3, 1);
+        CHECK(provider.mLive == 1);
+        CHECK(pool.FreePageCount() == 1);
+        CHECK(pool.ResidentBytes() == PageSize);
+    }
+    // The pool destroys whatever is left.
+    CHECK(provider.mLive == 0);
+}
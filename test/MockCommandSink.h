@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Structure/ResourceStateTracker.h"
+#include "Structure/StateCache.h"
+
+#include <vector>
+
+// A command list that only counts what reaches it, per StateCall, and
+// keeps every barrier in recording order.
+class MockCommandSink : public CommandSink
+{
+public:
+    void SetPipelineState(void*) override { Count(StateCall::PipelineState); }
+    void SetGraphicsRootSignature(void*) override { Count(StateCall::RootSignature); }
+    void SetDescriptorHeaps(std::uint32_t, void* const*) override { Count(StateCall::DescriptorHeaps); }
+    void SetVertexBuffer(std::uint32_t, const VertexBufferBinding&) override { Count(StateCall::VertexBuffer); }
+    void SetIndexBuffer(const IndexBufferBinding&) override { Count(StateCall::IndexBuffer); }
+    void SetPrimitiveTopology(std::uint32_t) override { Count(StateCall::PrimitiveTopology); }
+    void SetGraphicsRoot32BitConstant(std::uint32_t, std::uint32_t, std::uint32_t) override { Count(StateCall::RootConstant); }
+    void SetGraphicsRootConstantBufferView(std::uint32_t, std::uint64_t) override { Count(StateCall::RootConstantBufferView); }
+    void SetGraphicsRootShaderResourceView(std::uint32_t, std::uint64_t) override { Count(StateCall::RootShaderResourceView); }
+    void SetGraphicsRootDescriptorTable(std::uint32_t, std::uint64_t) override { Count(StateCall::RootDescriptorTable); }
+    void DrawIndexedInstanced(std::uint32_t, std::uint32_t, std::uint32_t, std::int32_t, std::uint32_t) override
+    {
+        Count(StateCall::Draw);
+        mBarriersBeforeDraw.push_back((std::uint32_t)Barriers.size());
+    }
+
+    void ResourceBarrier(std::uint32_t count, const ResourceBarrierDesc* barriers) override
+    {
+        ++BarrierCalls;
+        Barriers.insert(Barriers.end(), barriers, barriers + count);
+    }
+
+    std::uint32_t Calls(StateCall call)const { return mCalls[(int)call]; }
+    std::uint32_t TotalCalls()const
+    {
+        std::uint32_t total = 0;
+        for (std::uint32_t n : mCalls)
+            total += n;
+        return total;
+    }
+
+    // Barriers recorded before each draw, cumulative.
+    const std::vector<std::uint32_t>& BarriersBeforeDraw()const { return mBarriersBeforeDraw; }
+
+    std::vector<ResourceBarrierDesc> Barriers;
+    std::uint32_t BarrierCalls = 0;
+
+private:
+    void Count(StateCall call) { ++mCalls[(int)call]; }
+
+    std::uint32_t mCalls[(int)StateCall::Count] = {};
+    std::vector<std::uint32_t> mBarriersBeforeDraw;
+};
@@ -0,0 +1,69 @@
+#include "Benchmark.h"
+#include "CullMath.h"
+
+#include "Utility/OcclusionBuffer.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    std::uint32_t gState = 12345;
+    float Next()
+    {
+        gState = gState * 1664525u + 1013904223u;
+        return (float)(gState >> 8) * (1.0f / 16777216.0f);
+    }
+}
+
+BENCHMARK(OcclusionBuffer)
+{
+    const Float4x4 viewProj = CullMath::Multiply(CullMath::View({ 0.0f, 2.0f, 0.0f }, 0.0f, 0.05f),
+        CullMath::Perspective(1.2f, 2.0f, 0.5f, 500.0f));
+
+    // A town's worth of building sized boxes ahead of the camera, twelve
+    // triangles each, well inside the app's occluder triangle budget.
+    const std::uint32_t buildings = 2000;
+    const std::uint16_t box[36] = { 0,2,1, 1,2,3, 4,5,6, 5,7,6, 0,1,4, 1,5,4, 2,6,3, 3,6,7, 0,4,2, 2,4,6, 1,3,5, 3,7,5 };
+    std::vector<std::vector<Float3>> meshes(buildings);
+    for (std::vector<Float3>& mesh : meshes)
+    {
+        const float cx = Next() * 400.0f - 200.0f, cz = 10.0f + Next() * 300.0f;
+        const float ex = 2.0f + Next() * 8.0f, ey = 3.0f + Next() * 15.0f, ez = 2.0f + Next() * 8.0f;
+        for (int corner = 0; corner < 8; ++corner)
+            mesh.push_back({ cx + (corner & 1 ? ex : -ex), (corner & 2 ? ey : 0.0f), cz + (corner & 4 ? ez : -ez) });
+    }
+
+    MaskedOcclusionBuffer buffer(256, 128);
+    Float4 vertices[8];
+    const double render = Bench::Time([&]
+    {
+        buffer.Clear();
+        for (const std::vector<Float3>& mesh : meshes)
+        {
+            MaskedOcclusionBuffer::TransformVertices(mesh.data(), sizeof(Float3), 8, viewProj, vertices);
+            buffer.RenderTriangles(vertices, box, 12);
+        }
+    });
+    Bench::Report("2000 box occluders, 256x128", render, 12.0 * buildings, "triangles");
+
+    // Small objects among the buildings.
+    const std::uint32_t count = 100000;
+    std::vector<Float3> centers(count), extents(count);
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        centers[i] = { Next() * 400.0f - 200.0f, Next() * 5.0f, 10.0f + Next() * 300.0f };
+        extents[i] = { 0.3f + Next(), 0.3f + Next(), 0.3f + Next() };
+    }
+    std::uint32_t visible = 0;
+    const double test = Bench::Time([&]
+    {
+        visible = 0;
+        for (std::uint32_t i = 0; i < count; ++i)
+            visible += buffer.IsBoxVisible(centers[i], extents[i], viewProj);
+    });
+
+    char label[96];
+    std::snprintf(label, sizeof(label), "100k occludees, %u visible, %.0f/ms", visible, count / (test * 1000.0));
+    Bench::Report(label, test, (double)count, "occludees");
+}
@@ -0,0 +1,281 @@
+#include "TestFramework.h"
+#include "CullMath.h"
+
+#include "Utility/OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // Per pixel depth buffer drawn one pixel center at a time, in doubles,
+    // the reference the coarse buffer has to stay conservative against.
+    class ReferenceDepth
+    {
+    public:
+        ReferenceDepth(std::uint32_t width, std::uint32_t height) :
+            mWidth(width), mHeight(height), mDepth((std::size_t)width * height, 1.0) {}
+
+        void Draw(const Float4& a, const Float4& b, const Float4& c)
+        {
+            // The buffer skips these too.
+            if (!(a.w > 0.0f && b.w > 0.0f && c.w > 0.0f))
+                return;
+            const Float4* v[3] = { &a, &b, &c };
+            double x[3], y[3], z[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                x[k] = ((double)v[k]->x / v[k]->w * 0.5 + 0.5) * mWidth;
+                y[k] = (0.5 - (double)v[k]->y / v[k]->w * 0.5) * mHeight;
+                z[k] = (double)v[k]->z / v[k]->w;
+            }
+            const double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            if (area == 0.0)
+                return;
+
+            for (std::uint32_t py = 0; py < mHeight; ++py)
+            {
+                for (std::uint32_t px = 0; px < mWidth; ++px)
+                {
+                    const double sx = px + 0.5, sy = py + 0.5;
+                    const double w0 = ((x[1] - sx) * (y[2] - sy) - (x[2] - sx) * (y[1] - sy)) / area;
+                    const double w1 = ((x[2] - sx) * (y[0] - sy) - (x[0] - sx) * (y[2] - sy)) / area;
+                    const double w2 = 1.0 - w0 - w1;
+                    if (w0 < 0.0 || w1 < 0.0 || w2 < 0.0)
+                        continue;
+                    double& depth = mDepth[py * mWidth + px];
+                    depth = std::min(depth, w0 * z[0] + w1 * z[1] + w2 * z[2]);
+                }
+            }
+        }
+
+        // Hidden when every pixel center of the rectangle on screen has
+        // something at least as near as the box.
+        bool IsRectHidden(const MaskedOcclusionBuffer::ScreenRect& rect)const
+        {
+            const int px0 = std::max(0, (int)std::floor(rect.MinX)), px1 = std::min((int)mWidth - 1, (int)std::floor(rect.MaxX));
+            const int py0 = std::max(0, (int)std::floor(rect.MinY)), py1 = std::min((int)mHeight - 1, (int)std::floor(rect.MaxY));
+            if (px0 > px1 || py0 > py1)
+                return false;
+            for (int py = py0; py <= py1; ++py)
+                for (int px = px0; px <= px1; ++px)
+                    if (mDepth[py * mWidth + px] > rect.NearestDepth + 1e-6)
+                        return false;
+            return true;
+        }
+
+    private:
+        std::uint32_t mWidth, mHeight;
+        std::vector<double> mDepth;
+    };
+
+    Float4x4 Camera(float yaw, float pitch)
+    {
+        return CullMath::Multiply(CullMath::View({ 0.0f, 2.0f, 0.0f }, yaw, pitch), CullMath::Perspective(1.2f, 2.0f, 0.5f, 300.0f));
+    }
+
+    // Walls standing around the camera at random, as triangles.
+    struct Occluders
+    {
+        std::vector<Float3> Positions;
+        std::vector<std::uint32_t> Indices;
+
+        explicit Occluders(std::uint64_t seed, int walls)
+        {
+            Test::Random random(seed);
+            for (int w = 0; w < walls; ++w)
+            {
+                const float angle = random.Float(-3.2f, 3.2f), distance = random.Float(5.0f, 40.0f);
+                const float cx = std::sin(angle) * distance, cz = std::cos(angle) * distance;
+                const float facing = angle + random.Float(-0.6f, 0.6f);
+                const float half = random.Float(2.0f, 12.0f), height = random.Float(2.0f, 10.0f);
+                const float dx = std::cos(facing) * half, dz = -std::sin(facing) * half;
+                const std::uint32_t base = (std::uint32_t)Positions.size();
+                Positions.push_back({ cx - dx, -1.0f, cz - dz });
+                Positions.push_back({ cx + dx, -1.0f, cz + dz });
+                Positions.push_back({ cx - dx, height, cz - dz });
+                Positions.push_back({ cx + dx, height, cz + dz });
+                for (std::uint32_t i : { 0u, 1u, 2u, 2u, 1u, 3u })
+                    Indices.push_back(base + i);
+            }
+        }
+
+        void Render(const Float4x4& viewProj, MaskedOcclusionBuffer& buffer, ReferenceDepth& reference)const
+        {
+            std::vector<Float4> clip(Positions.size());
+            MaskedOcclusionBuffer::TransformVertices(Positions.data(), sizeof(Float3), (std::uint32_t)Positions.size(), viewProj, clip.data());
+            buffer.RenderTriangles(clip.data(), Indices.data(), (std::uint32_t)Indices.size() / 3);
+            for (std::size_t t = 0; t < Indices.size(); t += 3)
+                reference.Draw(clip[Indices[t]], clip[Indices[t + 1]], clip[Indices[t + 2]]);
+        }
+    };
+
+    struct Counts
+    {
+        int Culled = 0;
+        int Hidden = 0;
+        int Wrong = 0;
+    };
+
+    // Boxes scattered around the camera, tested against both.
+    Counts TestBoxes(const MaskedOcclusionBuffer& buffer, const ReferenceDepth& reference, const Float4x4& viewProj, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        Counts counts;
+        for (int i = 0; i < 4000; ++i)
+        {
+            const float angle = random.Float(-3.2f, 3.2f), distance = random.Float(3.0f, 80.0f);
+            const Float3 center = { std::sin(angle) * distance, random.Float(-1.0f, 6.0f), std::cos(angle) * distance };
+            const Float3 extents = { random.Float(0.1f, 2.0f), random.Float(0.1f, 2.0f), random.Float(0.1f, 2.0f) };
+
+            MaskedOcclusionBuffer::ScreenRect rect;
+            const bool projected = buffer.ProjectBox(center, extents, viewProj, rect);
+            const bool hidden = projected && reference.IsRectHidden(rect);
+            const bool visible = buffer.IsBoxVisible(center, extents, viewProj);
+            counts.Hidden += hidden;
+            counts.Culled += !visible;
+            counts.Wrong += !visible && !hidden;
+        }
+        return counts;
+    }
+}
+
+TEST_CASE(CoverageMatchesScalar)
+{
+    MaskedOcclusionBuffer buffer(64, 32);
+    Test::Random random(1);
+    int covered = 0;
+    for (int i = 0; i < 5000; ++i)
+    {
+        Float4 v[3];
+        for (Float4& p : v)
+            p = { random.Float(-1.5f, 1.5f), random.Float(-1.5f, 1.5f), random.Float(0.1f, 0.9f), 1.0f };
+        MaskedOcclusionBuffer::Triangle tri;
+        if (!buffer.SetupTriangle(v[0], v[1], v[2], tri))
+            continue;
+        for (float y = 0.0f; y < 32.0f; y += 4.0f)
+        {
+            for (float x = 0.0f; x < 64.0f; x += 8.0f)
+            {
+                const std::uint32_t mask = MaskedOcclusionBuffer::TileCoverage(tri, x, y);
+                CHECK(mask == MaskedOcclusionBuffer::TileCoverageScalar(tri, x, y));
+                covered += mask != 0;
+            }
+        }
+    }
+    CHECK(covered > 0);
+
+    // Both windings cover the bottom left tile, degenerate and
+    // behind-the-camera triangles are skipped.
+    MaskedOcclusionBuffer::Triangle tri;
+    const Float4 a = { -1, -1, 0.5f, 1 }, b = { 1, -1, 0.5f, 1 }, c = { -1, 1, 0.5f, 1 };
+    CHECK(buffer.SetupTriangle(a, b, c, tri) && MaskedOcclusionBuffer::TileCoverage(tri, 0, 28) == 0xffffffffu);
+    CHECK(buffer.SetupTriangle(a, c, b, tri) && MaskedOcclusionBuffer::TileCoverage(tri, 0, 28) == 0xffffffffu);
+    CHECK(!buffer.SetupTriangle(a, b, a, tri));
+    CHECK(!buffer.SetupTriangle(a, b, { -1, 1, 0.5f, -1 }, tri));
+}
+
+TEST_CASE(HiddenBoxesAreHiddenPerPixel)
+{
+    int culled = 0, hidden = 0;
+    for (int scene = 0; scene < 6; ++scene)
+    {
+        const Float4x4 viewProj = Camera(1.1f * scene, 0.1f);
+        MaskedOcclusionBuffer buffer(256, 128);
+        ReferenceDepth reference(256, 128);
+        Occluders(scene, 40).Render(viewProj, buffer, reference);
+
+        const Counts counts = TestBoxes(buffer, reference, viewProj, 100 + scene);
+        CHECK(counts.Wrong == 0);
+        culled += counts.Culled;
+        hidden += counts.Hidden;
+    }
+
+    // The tiles give up some culling, not most of it.
+    CHECK(culled > 0);
+    CHECK(culled * 10 >= hidden * 6);
+}
+
+TEST_CASE(TileDepthIsBehindEveryPixel)
+{
+    // A single wall rising away from the camera, so depth varies over tiles.
+    MaskedOcclusionBuffer buffer(64, 32);
+    ReferenceDepth reference(64, 32);
+    const Float4x4 viewProj = Camera(0.0f, 0.5f);
+    const Float3 floor[4] = { { -30, 0, 1 }, { 30, 0, 1 }, { -30, 0, 60 }, { 30, 0, 60 } };
+    Float4 clip[4];
+    MaskedOcclusionBuffer::TransformVertices(floor, sizeof(Float3), 4, viewProj, clip);
+    const std::uint32_t quad[6] = { 0, 1, 2, 2, 1, 3 };
+    buffer.RenderTriangles(clip, quad, 2);
+    reference.Draw(clip[0], clip[1], clip[2]);
+    reference.Draw(clip[2], clip[1], clip[3]);
+
+    int full = 0;
+    for (std::uint32_t ty = 0; ty < buffer.TilesY(); ++ty)
+    {
+        for (std::uint32_t tx = 0; tx < buffer.TilesX(); ++tx)
+        {
+            const float depth = buffer.TileDepth(tx, ty);
+            if (depth >= 1.0f)
+                continue;
+            ++full;
+            const MaskedOcclusionBuffer::ScreenRect tile = {
+                (float)(tx * 8), (float)(ty * 4), (float)(tx * 8 + 7), (float)(ty * 4 + 3), depth };
+            CHECK(reference.IsRectHidden(tile));
+        }
+    }
+    CHECK(full > 0);
+
+    buffer.Clear();
+    CHECK(buffer.TileDepth(0, 0) == 1.0f && buffer.TileMask(0, 0) == 0);
+}
+
+TEST_CASE(ReprojectionAfterTurningStaysConservative)
+{
+    const Occluders occluders(7, 40);
+    const Float4x4 previousViewProj = Camera(0.3f, 0.05f);
+    MaskedOcclusionBuffer previous(256, 128);
+    ReferenceDepth unused(256, 128);
+    occluders.Render(previousViewProj, previous, unused);
+
+    // The camera turned a little; the inverse of the old matrix is built
+    // from its parts.
+    const Float4x4 viewProj = Camera(0.38f, 0.02f);
+    Float4x4 invProj = {};
+    {
+        const float nearZ = 0.5f, farZ = 300.0f;
+        const float yScale = 1.0f / std::tan(0.6f), xScale = yScale / 2.0f;
+        const float range = farZ / (farZ - nearZ);
+        invProj.m[0][0] = 1.0f / xScale;
+        invProj.m[1][1] = 1.0f / yScale;
+        invProj.m[2][3] = -1.0f / (range * nearZ);
+        invProj.m[3][2] = 1.0f;
+        invProj.m[3][3] = 1.0f / nearZ;
+    }
+    const Float4x4 view = CullMath::View({ 0.0f, 2.0f, 0.0f }, 0.3f, 0.05f);
+    Float4x4 invView = Float4x4::Identity();
+    for (int r = 0; r < 3; ++r)
+        for (int k = 0; k < 3; ++k)
+            invView.m[r][k] = view.m[k][r];
+    invView.m[3][0] = 0.0f;
+    invView.m[3][1] = 2.0f;
+    invView.m[3][2] = 0.0f;
+    const Float4x4 previousInv = CullMath::Multiply(invProj, invView);
+
+    // The inverse really is one.
+    const Float4x4 identity = CullMath::Multiply(previousViewProj, previousInv);
+    for (int r = 0; r < 4; ++r)
+        for (int k = 0; k < 4; ++k)
+            CHECK_NEAR(identity.m[r][k], r == k ? 1.0f : 0.0f, 1e-3);
+
+    MaskedOcclusionBuffer current(256, 128);
+    current.Reproject(previous, previousInv, viewProj);
+    ReferenceDepth reference(256, 128);
+    MaskedOcclusionBuffer rendered(256, 128);
+    occluders.Render(viewProj, rendered, reference);
+
+    const Counts counts = TestBoxes(current, reference, viewProj, 8);
+    CHECK(counts.Wrong == 0);
+    CHECK(counts.Culled > 0);
+}
@@ -0,0 +1,111 @@
+#include "TestFramework.h"
+
+#include "Structure/ParallelRecorder.h"
+#include "Utility/ThreadPool.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace
+{
+    // Stands in for the D3D12 command lists: every chunk "records" the
+    // items it was given into its own list, submission concatenates them.
+    class RecordingBackend : public CommandRecordBackend
+    {
+    public:
+        explicit RecordingBackend(std::uint32_t executorCount) : mExecutorBusy(executorCount) {}
+
+        void RecordItems(std::uint32_t chunkIndex, const RecordChunk& chunk, std::uint32_t executor) override
+        {
+            // Two chunks at once on one executor would share its allocator.
+            if (mExecutorBusy[executor]++ != 0)
+                mSharedExecutor = true;
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (mLists.size() <= chunkIndex)
+                    mLists.resize(chunkIndex + 1);
+            }
+            std::vector<std::uint32_t> list;
+            for (std::uint32_t i = 0; i < chunk.Count; ++i)
+                list.push_back(chunk.First + i);
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mLists[chunkIndex] = std::move(list);
+            }
+            ++mRecorded;
+            --mExecutorBusy[executor];
+        }
+
+        void SubmitChunks(std::uint32_t chunkCount) override
+        {
+            mRecordedAtSubmit = mRecorded;
+            ++mSubmits;
+            for (std::uint32_t i = 0; i < chunkCount; ++i)
+                mSubmitted.insert(mSubmitted.end(), mLists[i].begin(), mLists[i].end());
+        }
+
+        std::vector<std::uint32_t> mSubmitted;
+        std::atomic<std::uint32_t> mRecorded{ 0 };
+        std::uint32_t mRecordedAtSubmit = 0;
+        int mSubmits = 0;
+        bool mSharedExecutor = false;
+
+    private:
+        std::mutex mMutex;
+        std::vector<std::vector<std::uint32_t>> mLists;
+        std::vector<std::atomic<int>> mExecutorBusy;
+    };
+}
+
+TEST_CASE(SplitMakesEqualContiguousChunks)
+{
+    ParallelRecorder recorder(nullptr, 100);
+    struct Expected { std::uint32_t Items, MaxChunks, Chunks; };
+    const Expected table[] = { { 0, 8, 1 }, { 99, 8, 1 }, { 250, 8, 2 }, { 1000, 8, 8 }, { 50001, 8, 8 }, { 1000, 3, 3 } };
+    for (const Expected& e : table)
+    {
+        CHECK(recorder.Split(e.Items, e.MaxChunks) == e.Chunks);
+        const auto& chunks = recorder.Chunks();
+        std::uint32_t next = 0;
+        for (const RecordChunk& chunk : chunks)
+        {
+            CHECK(chunk.First == next);
+            CHECK(chunk.Count + 1 >= e.Items / e.Chunks && chunk.Count <= e.Items / e.Chunks + 1);
+            next += chunk.Count;
+        }
+        CHECK(next == e.Items);
+    }
+}
+
+TEST_CASE(ChunksSubmitInDrawOrder)
+{
+    ThreadPool pool(3);
+    ParallelRecorder recorder(&pool, 16);
+    for (std::uint32_t items : { 0u, 1u, 17u, 1000u, 50000u })
+    {
+        RecordingBackend backend(pool.ExecutorCount());
+        const std::uint32_t chunks = recorder.Split(items, 4 * recorder.MaxUsefulChunks());
+        recorder.Record(backend);
+
+        CHECK(backend.mSubmits == 1);
+        CHECK(backend.mRecordedAtSubmit == chunks);
+        CHECK(!backend.mSharedExecutor);
+        CHECK(backend.mSubmitted.size() == items);
+        bool inOrder = true;
+        for (std::uint32_t i = 0; i < backend.mSubmitted.size(); ++i)
+            inOrder = inOrder && backend.mSubmitted[i] == i;
+        CHECK(inOrder);
+    }
+}
+
+TEST_CASE(WithoutAPoolEverythingRecordsInline)
+{
+    ParallelRecorder recorder(nullptr, 1);
+    CHECK(recorder.MaxUsefulChunks() == 1);
+    RecordingBackend backend(1);
+    recorder.Split(10, 4);
+    recorder.Record(backend);
+    CHECK(backend.mSubmitted.size() == 10);
+    CHECK(backend.mRecordedAtSubmit == 4);
+}
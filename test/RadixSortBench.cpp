@@ -0,0 +1,79 @@
+#include "Benchmark.h"
+
+#include "Utility/RadixSort.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    std::vector<std::uint64_t> RandomKeys(std::size_t count, std::uint64_t mask)
+    {
+        std::vector<std::uint64_t> keys(count);
+        std::uint64_t state = 88172645463325252ull;
+        for (auto& key : keys)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            key = state & mask;
+        }
+        return keys;
+    }
+
+    void Run(const char* name, std::uint64_t mask, ThreadPool& pool)
+    {
+        const std::size_t count = 1000000;
+        const std::vector<std::uint64_t> source = RandomKeys(count, mask);
+        std::vector<std::uint64_t> keys;
+        std::vector<std::uint32_t> values(count);
+        RadixSorter sorter;
+
+        auto reset = [&] { keys = source; std::iota(values.begin(), values.end(), 0u); };
+        char label[80];
+
+        double best = 0.0;
+        for (int i = 0; i < 5; ++i)
+        {
+            reset();
+            const double t = Bench::Time([&] { sorter.Sort(keys.data(), values.data(), count); }, 1);
+            best = i == 0 || t < best ? t : best;
+        }
+        std::snprintf(label, sizeof(label), "1M %s, radix", name);
+        Bench::Report(label, best, count, "keys");
+
+        for (int i = 0; i < 5; ++i)
+        {
+            reset();
+            const double t = Bench::Time([&] { sorter.Sort(keys.data(), values.data(), count, &pool); }, 1);
+            best = i == 0 || t < best ? t : best;
+        }
+        std::snprintf(label, sizeof(label), "1M %s, radix, %u executors", name, pool.ExecutorCount());
+        Bench::Report(label, best, count, "keys");
+
+        std::vector<std::pair<std::uint64_t, std::uint32_t>> pairs(count);
+        for (int i = 0; i < 3; ++i)
+        {
+            for (std::size_t k = 0; k < count; ++k)
+                pairs[k] = { source[k], (std::uint32_t)k };
+            const double t = Bench::Time([&] { std::sort(pairs.begin(), pairs.end()); }, 1);
+            best = i == 0 || t < best ? t : best;
+        }
+        std::snprintf(label, sizeof(label), "1M %s, std::sort", name);
+        Bench::Report(label, best, count, "keys");
+        Bench::Consume(keys.data());
+        Bench::Consume(pairs.data());
+    }
+}
+
+BENCHMARK(Sort1MKeys)
+{
+    ThreadPool pool;
+    Run("random keys", ~0ull, pool);
+    // Draw keys use layer, pso, material, mesh and depth: about five digits.
+    Run("draw keys", 0x0003'ff00'ffff'ffffull, pool);
+}
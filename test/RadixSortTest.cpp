@@ -0,0 +1,102 @@
+#include "TestFramework.h"
+
+#include "Utility/DrawKey.h"
+#include "Utility/RadixSort.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+namespace
+{
+    // Radix sorts keys with their indices as values and compares with
+    // std::stable_sort, which pins down stability as well.
+    bool SortsLikeStdSort(std::vector<std::uint64_t> keys, ThreadPool* pool, RadixSorter& sorter)
+    {
+        std::vector<std::pair<std::uint64_t, std::uint32_t>> expected(keys.size());
+        for (std::size_t i = 0; i < keys.size(); ++i)
+            expected[i] = { keys[i], (std::uint32_t)i };
+        std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        std::vector<std::uint32_t> values(keys.size());
+        std::iota(values.begin(), values.end(), 0u);
+        sorter.Sort(keys.data(), values.data(), keys.size(), pool);
+
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            if (keys[i] != expected[i].first || values[i] != expected[i].second)
+                return false;
+        }
+        return true;
+    }
+
+    std::vector<std::uint64_t> RandomKeys(std::size_t count, std::uint64_t mask, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        std::vector<std::uint64_t> keys(count);
+        for (auto& key : keys)
+            key = random.Next64() & mask;
+        return keys;
+    }
+}
+
+TEST_CASE(MatchesStdSortSerial)
+{
+    RadixSorter sorter;
+    for (std::size_t count : { 0u, 1u, 2u, 255u, 1000u, 20000u })
+    {
+        CHECK(SortsLikeStdSort(RandomKeys(count, ~0ull, count), nullptr, sorter));
+        // Few distinct values: many equal keys, most passes skipped.
+        CHECK(SortsLikeStdSort(RandomKeys(count, 0x0300'0000'0000'00f0ull, count + 1), nullptr, sorter));
+    }
+}
+
+TEST_CASE(MatchesStdSortParallel)
+{
+    ThreadPool pool(3);
+    RadixSorter sorter;
+    for (std::size_t count : { RadixSorter::ParallelThreshold - 1, RadixSorter::ParallelThreshold, (std::size_t)300001 })
+    {
+        CHECK(SortsLikeStdSort(RandomKeys(count, ~0ull, 7), &pool, sorter));
+        CHECK(SortsLikeStdSort(RandomKeys(count, 0xffff'0000'0000'ffffull, 8), &pool, sorter));
+        CHECK(SortsLikeStdSort(RandomKeys(count, 0, 9), &pool, sorter));
+    }
+}
+
+TEST_CASE(SortedAndReversedInput)
+{
+    ThreadPool pool(2);
+    RadixSorter sorter;
+    std::vector<std::uint64_t> keys(200000);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        keys[i] = i * 0x9E3779B97Full;
+    CHECK(SortsLikeStdSort(keys, &pool, sorter));
+    std::reverse(keys.begin(), keys.end());
+    CHECK(SortsLikeStdSort(keys, &pool, sorter));
+}
+
+TEST_CASE(OpaqueKeysGroupByStateThenFrontToBack)
+{
+    const std::uint32_t nearDepth = DrawKey::QuantizeDepth(2.0f, 1.0f, 1000.0f);
+    const std::uint32_t farDepth = DrawKey::QuantizeDepth(500.0f, 1.0f, 1000.0f);
+    CHECK(nearDepth < farDepth);
+    CHECK(DrawKey::QuantizeDepth(0.5f, 1.0f, 1000.0f) == 0);
+    CHECK(DrawKey::QuantizeDepth(2000.0f, 1.0f, 1000.0f) == 0xffff);
+
+    // Depth only orders draws with the same state.
+    CHECK(DrawKey::MakeOpaque(0, 0, 1, 5, 9, nearDepth) < DrawKey::MakeOpaque(0, 0, 1, 5, 9, farDepth));
+    CHECK(DrawKey::MakeOpaque(0, 0, 1, 5, 9, farDepth) < DrawKey::MakeOpaque(0, 0, 1, 6, 0, nearDepth));
+    CHECK(DrawKey::MakeOpaque(0, 0, 2, 0, 0, 0) > DrawKey::MakeOpaque(0, 0, 1, 16383, 65535, 65535));
+    CHECK(DrawKey::MakeOpaque(1, 0, 0, 0, 0, 0) > DrawKey::MakeOpaque(0, 15, 1023, 16383, 65535, 65535));
+    CHECK(DrawKey::Layer(DrawKey::MakeOpaque(7, 1, 2, 3, 4, 5)) == 7);
+}
+
+TEST_CASE(TransparentKeysGoBackToFront)
+{
+    const std::uint32_t nearDepth = DrawKey::QuantizeDepth(2.0f, 1.0f, 1000.0f);
+    const std::uint32_t farDepth = DrawKey::QuantizeDepth(500.0f, 1.0f, 1000.0f);
+    CHECK(DrawKey::MakeTransparent(2, 0, 9, 9, 9, farDepth) < DrawKey::MakeTransparent(2, 0, 0, 0, 0, nearDepth));
+    CHECK(DrawKey::Layer(DrawKey::MakeTransparent(2, 0, 9, 9, 9, farDepth)) == 2);
+    CHECK(DrawKey::MeshId(&nearDepth, 36) == DrawKey::MeshId(&nearDepth, 36));
+}
@@ -0,0 +1,356 @@
+#include "TestFramework.h"
+
+#include "Structure/RenderGraph.h"
+
+#include <string>
+
+namespace
+{
+    constexpr std::uint64_t MiB = 1024 * 1024;
+
+    RenderGraphTextureDesc Texture(std::uint64_t size)
+    {
+        RenderGraphTextureDesc desc;
+        desc.Width = 256;
+        desc.Height = 256;
+        desc.Flags = RenderGraphTextureRenderTarget;
+        desc.SizeInBytes = size;
+        return desc;
+    }
+
+    const RenderGraphPlacement* PlacementOf(const RenderGraph& graph, std::uint32_t resource)
+    {
+        for (const RenderGraphPlacement& p : graph.Placements())
+        {
+            if (p.Resource == resource)
+                return &p;
+        }
+        return nullptr;
+    }
+
+    bool Overlaps(const RenderGraph& graph, const RenderGraphPlacement& a, const RenderGraphPlacement& b)
+    {
+        return a.Offset < b.Offset + graph.TextureDesc(b.Resource).SizeInBytes &&
+            b.Offset < a.Offset + graph.TextureDesc(a.Resource).SizeInBytes;
+    }
+
+    // Plays the barriers of a few frames the way the GPU sees them: a
+    // transient only holds its memory between its aliasing barrier and the
+    // next one of a resource sharing that memory, transitions must start
+    // from the state the resource is really in and only touch resources
+    // holding their memory, and every transient ends the frame in its
+    // InitialState.  Returns false at the first violation.
+    bool PlaysBack(const RenderGraph& graph, int frames = 3)
+    {
+        const std::uint32_t count = graph.ResourceCount();
+        std::vector<ResourceState> state(count, ResourceState::Common);
+        std::vector<bool> known(count, false);
+        std::vector<bool> active(count, true);
+
+        for (const RenderGraphPlacement& p : graph.Placements())
+        {
+            state[p.Resource] = p.InitialState;
+            known[p.Resource] = true;
+            for (const RenderGraphPlacement& q : graph.Placements())
+            {
+                if (&p != &q && Overlaps(graph, p, q))
+                    active[p.Resource] = false;
+            }
+        }
+
+        auto play = [&](const std::vector<RenderGraphBarrier>& barriers)
+        {
+            for (const RenderGraphBarrier& b : barriers)
+            {
+                if (b.Kind == RenderGraphBarrier::Type::Aliasing)
+                {
+                    const RenderGraphPlacement* p = PlacementOf(graph, b.Resource);
+                    if (p == nullptr)
+                        return false;
+                    for (const RenderGraphPlacement& q : graph.Placements())
+                    {
+                        if (q.Resource != p->Resource && Overlaps(graph, *p, q))
+                            active[q.Resource] = false;
+                    }
+                    active[b.Resource] = true;
+                    continue;
+                }
+                if (!active[b.Resource])
+                    return false;
+                if (b.Kind == RenderGraphBarrier::Type::UnorderedAccess)
+                    continue;
+                if (known[b.Resource] && state[b.Resource] != b.Before)
+                    return false;
+                state[b.Resource] = b.After;
+                known[b.Resource] = true;
+            }
+            return true;
+        };
+
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            for (RenderGraphPass pass = 0; pass < graph.PassCount(); ++pass)
+            {
+                if (!graph.IsCulled(pass) && !play(graph.Barriers(pass)))
+                    return false;
+            }
+            if (!play(graph.FinalBarriers()))
+                return false;
+
+            for (const RenderGraphPlacement& p : graph.Placements())
+            {
+                if (state[p.Resource] != p.InitialState)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Live transients whose lifetimes overlap never share memory.
+    bool PlacementsDisjoint(const RenderGraph& graph)
+    {
+        const auto& placements = graph.Placements();
+        for (std::size_t i = 0; i < placements.size(); ++i)
+        {
+            const RenderGraphPlacement& a = placements[i];
+            if (a.Offset + graph.TextureDesc(a.Resource).SizeInBytes > graph.HeapSize() ||
+                a.Offset % graph.TextureDesc(a.Resource).Alignment != 0)
+                return false;
+            for (std::size_t j = i + 1; j < placements.size(); ++j)
+            {
+                const RenderGraphPlacement& b = placements[j];
+                if (a.FirstPass <= b.LastPass && b.FirstPass <= a.LastPass && Overlaps(graph, a, b))
+                    return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST_CASE(UnconsumedPassesAreCulled)
+{
+    RenderGraph graph;
+    RenderGraphResource backBuffer = graph.Import("BackBuffer", ResourceState::Present, ResourceState::Present);
+    RenderGraphResource unused = graph.CreateTexture("Unused", Texture(MiB));
+    RenderGraphResource color = graph.CreateTexture("Color", Texture(MiB));
+
+    RenderGraphPass deadPass = graph.AddPass("Dead");
+    graph.Write(deadPass, unused, ResourceState::RenderTarget);
+
+    RenderGraphPass drawPass = graph.AddPass("Draw");
+    color = graph.Write(drawPass, color, ResourceState::RenderTarget);
+    RenderGraphPass copyPass = graph.AddPass("Copy");
+    graph.Read(copyPass, color, ResourceState::CopySource);
+    graph.Write(copyPass, backBuffer, ResourceState::CopyDest);
+
+    RenderGraphPass debugPass = graph.AddPass("Debug");
+    graph.Read(debugPass, color, ResourceState::PixelShaderResource);
+    graph.SetSideEffect(debugPass);
+
+    graph.Compile();
+    CHECK(graph.IsCulled(deadPass));
+    CHECK(!graph.IsCulled(drawPass));
+    CHECK(!graph.IsCulled(copyPass));
+    CHECK(!graph.IsCulled(debugPass));
+
+    // The culled pass's texture gets no memory.
+    CHECK(PlacementOf(graph, graph.ResourceOf(unused)) == nullptr);
+    CHECK(graph.Placements().size() == 1);
+    CHECK(PlaysBack(graph));
+}
+
+TEST_CASE(CullingFollowsChainsBack)
+{
+    RenderGraph graph;
+    RenderGraphResource a = graph.CreateTexture("A", Texture(MiB));
+    RenderGraphResource b = graph.CreateTexture("B", Texture(MiB));
+
+    RenderGraphPass first = graph.AddPass("First");
+    a = graph.Write(first, a, ResourceState::RenderTarget);
+    RenderGraphPass second = graph.AddPass("Second");
+    graph.Read(second, a, ResourceState::PixelShaderResource);
+    graph.Write(second, b, ResourceState::RenderTarget);
+
+    graph.Compile();
+    CHECK(graph.IsCulled(first) && graph.IsCulled(second));
+    CHECK(graph.Placements().empty());
+    CHECK(graph.HeapSize() == 0);
+}
+
+TEST_CASE(ReadRunsTransitionOnce)
+{
+    RenderGraph graph;
+    RenderGraphResource backBuffer = graph.Import("BackBuffer", ResourceState::Present, ResourceState::Present);
+    RenderGraphResource shadow = graph.CreateTexture("Shadow", Texture(MiB));
+
+    RenderGraphPass draw = graph.AddPass("Draw");
+    shadow = graph.Write(draw, shadow, ResourceState::DepthWrite);
+    RenderGraphPass readPs = graph.AddPass("ReadPs");
+    graph.Read(readPs, shadow, ResourceState::PixelShaderResource);
+    graph.SetSideEffect(readPs);
+    RenderGraphPass readCs = graph.AddPass("ReadCs");
+    graph.Read(readCs, shadow, ResourceState::NonPixelShaderResource);
+    backBuffer = graph.Write(readCs, backBuffer, ResourceState::RenderTarget);
+
+    graph.Compile();
+    const std::uint32_t s = graph.ResourceOf(shadow);
+    const std::uint32_t bb = graph.ResourceOf(backBuffer);
+
+    CHECK(graph.Barriers(draw).empty());
+    CHECK(graph.Barriers(readPs).size() == 1);
+    RenderGraphBarrier both;
+    both.Resource = s;
+    both.Before = ResourceState::DepthWrite;
+    both.After = ResourceState::PixelShaderResource | ResourceState::NonPixelShaderResource;
+    CHECK(graph.Barriers(readPs)[0] == both);
+
+    // Only the import moves in the second reader.
+    CHECK(graph.Barriers(readCs).size() == 1);
+    CHECK(graph.Barriers(readCs)[0].Resource == bb);
+    CHECK(graph.Barriers(readCs)[0].After == ResourceState::RenderTarget);
+
+    // Both resources go back for the next frame.
+    CHECK(graph.FinalBarriers().size() == 2);
+    CHECK(PlaysBack(graph));
+}
+
+TEST_CASE(BackToBackUnorderedAccessIsOrdered)
+{
+    RenderGraph graph;
+    RenderGraphResource buffer = graph.Import("Buffer", ResourceState::UnorderedAccess, ResourceState::UnorderedAccess);
+
+    RenderGraphPass first = graph.AddPass("First");
+    buffer = graph.Write(first, buffer, ResourceState::UnorderedAccess);
+    RenderGraphPass second = graph.AddPass("Second");
+    buffer = graph.Write(second, buffer, ResourceState::UnorderedAccess);
+
+    graph.Compile();
+    CHECK(graph.Barriers(first).empty());
+    CHECK(graph.Barriers(second).size() == 1);
+    CHECK(graph.Barriers(second)[0].Kind == RenderGraphBarrier::Type::UnorderedAccess);
+    CHECK(graph.FinalBarriers().empty());
+}
+
+TEST_CASE(ChainSharesMemoryWithoutTouchingInactiveAliases)
+{
+    // A -> B -> C -> back buffer: C starts after A's last use and takes its
+    // memory, B overlaps both.
+    RenderGraph graph;
+    RenderGraphResource backBuffer = graph.Import("BackBuffer", ResourceState::Present, ResourceState::Present);
+    RenderGraphResource a = graph.CreateTexture("A", Texture(MiB));
+    RenderGraphResource b = graph.CreateTexture("B", Texture(MiB));
+    RenderGraphResource c = graph.CreateTexture("C", Texture(MiB));
+
+    RenderGraphPass passA = graph.AddPass("WriteA");
+    a = graph.Write(passA, a, ResourceState::RenderTarget);
+    RenderGraphPass passB = graph.AddPass("AToB");
+    graph.Read(passB, a, ResourceState::PixelShaderResource);
+    b = graph.Write(passB, b, ResourceState::RenderTarget);
+    RenderGraphPass passC = graph.AddPass("BToC");
+    graph.Read(passC, b, ResourceState::PixelShaderResource);
+    c = graph.Write(passC, c, ResourceState::RenderTarget);
+    RenderGraphPass present = graph.AddPass("CToBackBuffer");
+    graph.Read(present, c, ResourceState::PixelShaderResource);
+    graph.Write(present, backBuffer, ResourceState::RenderTarget);
+
+    graph.Compile();
+    const std::uint32_t ra = graph.ResourceOf(a), rb = graph.ResourceOf(b), rc = graph.ResourceOf(c);
+    const RenderGraphPlacement* pa = PlacementOf(graph, ra);
+    const RenderGraphPlacement* pb = PlacementOf(graph, rb);
+    const RenderGraphPlacement* pc = PlacementOf(graph, rc);
+    CHECK(pa && pb && pc);
+    if (!pa || !pb || !pc)
+        return;
+
+    CHECK(pa->Offset == pc->Offset);
+    CHECK(pb->Offset != pa->Offset);
+    CHECK(graph.HeapSize() == 2 * MiB);
+    CHECK(PlacementsDisjoint(graph));
+
+    // A is back in its first state before C takes the memory, and the
+    // frame does not end with a barrier on it.
+    const auto& handOver = graph.Barriers(passC);
+    CHECK(handOver.size() >= 2);
+    CHECK(handOver[0].Kind == RenderGraphBarrier::Type::Transition && handOver[0].Resource == ra);
+    CHECK(handOver[0].Before == ResourceState::PixelShaderResource && handOver[0].After == ResourceState::RenderTarget);
+    CHECK(handOver[1].Kind == RenderGraphBarrier::Type::Aliasing && handOver[1].Resource == rc && handOver[1].AliasBefore == ra);
+    for (const RenderGraphBarrier& barrier : graph.FinalBarriers())
+        CHECK(barrier.Resource != ra);
+    for (RenderGraphPass pass = passC + 1; pass < graph.PassCount(); ++pass)
+    {
+        for (const RenderGraphBarrier& barrier : graph.Barriers(pass))
+            CHECK(barrier.Resource != ra);
+    }
+
+    // Each alias is flagged in the pass that takes the memory over; B never
+    // shares, so it keeps its contents.
+    CHECK(graph.NeedsDiscard(passA, ra));
+    CHECK(graph.NeedsDiscard(passC, rc));
+    CHECK(!graph.NeedsDiscard(passB, rb));
+    CHECK(!graph.NeedsDiscard(passB, ra));
+    CHECK(graph.Discards(present).empty());
+
+    CHECK(PlaysBack(graph));
+}
+
+TEST_CASE(RandomGraphsPlayBack)
+{
+    Test::Random random(34);
+    for (int graphIndex = 0; graphIndex < 300; ++graphIndex)
+    {
+        RenderGraph graph;
+        std::vector<RenderGraphResource> handles;
+        handles.push_back(graph.Import("Output", ResourceState::Present, ResourceState::Present));
+
+        const ResourceState writeStates[] = { ResourceState::RenderTarget, ResourceState::DepthWrite, ResourceState::UnorderedAccess };
+        const ResourceState readStates[] = { ResourceState::PixelShaderResource, ResourceState::NonPixelShaderResource,
+            ResourceState::CopySource, ResourceState::DepthRead };
+
+        const std::uint32_t passCount = 2 + random.Next32() % 10;
+        for (std::uint32_t p = 0; p < passCount; ++p)
+        {
+            RenderGraphPass pass = graph.AddPass("Pass" + std::to_string(p));
+            if (handles.size() < 2 || random.Next32() % 3 == 0)
+            {
+                RenderGraphTextureDesc desc = Texture((1 + random.Next32() % 4) * MiB);
+                if (random.Next32() % 4 == 0)
+                    desc.Alignment = 4 * MiB;
+                handles.push_back(graph.CreateTexture("T" + std::to_string(handles.size()), desc));
+            }
+
+            // Reads of a few resources, then one write; a pass touches each
+            // resource once.
+            std::vector<bool> touched(handles.size(), false);
+            const std::uint32_t reads = random.Next32() % 3;
+            for (std::uint32_t i = 0; i < reads; ++i)
+            {
+                const std::size_t h = 1 + random.Next32() % (handles.size() - 1);
+                if (touched[h])
+                    continue;
+                touched[h] = true;
+                graph.Read(pass, handles[h], readStates[random.Next32() % 4]);
+            }
+
+            std::size_t w = random.Next32() % handles.size();
+            if (p + 1 == passCount)
+                w = 0;
+            if (!touched[w])
+                handles[w] = graph.Write(pass, handles[w], w == 0 ? ResourceState::RenderTarget : writeStates[random.Next32() % 3]);
+            if (random.Next32() % 8 == 0)
+                graph.SetSideEffect(pass);
+        }
+
+        graph.Compile();
+        CHECK(PlacementsDisjoint(graph));
+        CHECK(PlaysBack(graph));
+
+        // Every transient that shares memory is flagged where it starts.
+        for (const RenderGraphPlacement& p : graph.Placements())
+        {
+            bool shares = false;
+            for (const RenderGraphPlacement& q : graph.Placements())
+                shares = shares || (&p != &q && Overlaps(graph, p, q));
+            CHECK(graph.NeedsDiscard(p.FirstPass, p.Resource) == shares);
+        }
+    }
+}
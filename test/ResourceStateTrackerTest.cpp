@@ -0,0 +1,291 @@
+#include "TestFramework.h"
+
+#include "MockCommandSink.h"
+
+#include <stdexcept>
+
+namespace
+{
+    const void* Resource(std::uintptr_t id) { return reinterpret_cast<const void*>(0x1000 * id); }
+
+    ResourceBarrierDesc Transition(const void* resource, ResourceState before, ResourceState after,
+        std::uint32_t subresource = AllSubresources, ResourceBarrierDesc::Split flags = ResourceBarrierDesc::Split::None)
+    {
+        return { ResourceBarrierDesc::Type::Transition, flags, resource, subresource, before, after };
+    }
+
+    // Starts a list on which resource is already known to be in state.
+    void Use(ResourceStateTracker& tracker, const void* resource, ResourceState state)
+    {
+        tracker.Transition(resource, state);
+    }
+}
+
+TEST_CASE(TransitionsWaitForOneFlush)
+{
+    GlobalResourceStates global;
+    const void* a = Resource(1);
+    const void* b = Resource(2);
+    global.Register(a, 1, ResourceState::RenderTarget, false);
+    global.Register(b, 1, ResourceState::DepthWrite, false);
+
+    ResourceStateTracker tracker(&global);
+    Use(tracker, a, ResourceState::RenderTarget);
+    Use(tracker, b, ResourceState::DepthWrite);
+    tracker.Transition(a, ResourceState::PixelShaderResource);
+    tracker.Transition(b, ResourceState::DepthRead);
+    tracker.Transition(a, ResourceState::PixelShaderResource);
+    CHECK(tracker.QueuedCount() == 2);
+
+    MockCommandSink sink;
+    tracker.Flush(sink);
+    CHECK(sink.BarrierCalls == 1);
+    CHECK(sink.Barriers.size() == 2);
+    CHECK(sink.Barriers[0] == Transition(a, ResourceState::RenderTarget, ResourceState::PixelShaderResource));
+    CHECK(sink.Barriers[1] == Transition(b, ResourceState::DepthWrite, ResourceState::DepthRead));
+
+    // Nothing queued, nothing recorded.
+    tracker.Flush(sink);
+    CHECK(sink.BarrierCalls == 1);
+
+    const ResourceStateTrackerStats& stats = tracker.Stats();
+    CHECK(stats.Requested == 5);
+    CHECK(stats.Elided == 3);
+    CHECK(stats.Barriers == 2);
+    CHECK(stats.Flushes == 1);
+}
+
+TEST_CASE(QueuedTransitionsFoldAndCancel)
+{
+    GlobalResourceStates global;
+    const void* r = Resource(1);
+    global.Register(r, 1, ResourceState::RenderTarget, false);
+
+    ResourceStateTracker tracker(&global);
+    Use(tracker, r, ResourceState::RenderTarget);
+    tracker.Transition(r, ResourceState::PixelShaderResource);
+    // Reads combine with the state they come from.
+    tracker.Transition(r, ResourceState::CopySource);
+    CHECK(tracker.QueuedCount() == 1);
+
+    MockCommandSink sink;
+    tracker.Flush(sink);
+    CHECK(sink.Barriers.size() == 1);
+    CHECK(sink.Barriers[0] == Transition(r, ResourceState::RenderTarget,
+        ResourceState::PixelShaderResource | ResourceState::CopySource));
+
+    // There and back before a flush is no barrier at all.
+    tracker.Transition(r, ResourceState::CopyDest);
+    tracker.Transition(r, ResourceState::PixelShaderResource | ResourceState::CopySource);
+    CHECK(tracker.QueuedCount() == 0);
+    tracker.Flush(sink);
+    CHECK(sink.BarrierCalls == 1);
+    CHECK(tracker.Stats().Merged == 2);
+
+    // Unordered access barriers in a row are one.
+    tracker.UAVBarrier(r);
+    tracker.UAVBarrier(r);
+    tracker.Flush(sink);
+    CHECK(sink.Barriers.size() == 2);
+    CHECK(sink.Barriers[1].Kind == ResourceBarrierDesc::Type::UnorderedAccess);
+}
+
+TEST_CASE(FirstUseIsResolvedAtSubmit)
+{
+    GlobalResourceStates global;
+    const void* r = Resource(1);
+    global.Register(r, 1, ResourceState::CopyDest, false);
+
+    ResourceStateTracker tracker(&global);
+    tracker.Transition(r, ResourceState::PixelShaderResource);
+    tracker.Transition(r, ResourceState::RenderTarget);
+
+    MockCommandSink sink;
+    tracker.Close(sink);
+    // The first use records nothing, the second is an ordinary barrier.
+    CHECK(sink.Barriers.size() == 1);
+    CHECK(sink.Barriers[0] == Transition(r, ResourceState::PixelShaderResource, ResourceState::RenderTarget));
+
+    std::vector<ResourceBarrierDesc> fixups;
+    tracker.ResolvePending(fixups);
+    CHECK(fixups.size() == 1);
+    CHECK(fixups[0] == Transition(r, ResourceState::CopyDest, ResourceState::PixelShaderResource, 0));
+    CHECK(global.State(r, 0) == ResourceState::RenderTarget);
+    CHECK(tracker.Stats().Fixups == 1);
+}
+
+TEST_CASE(ListsResolveInSubmissionOrder)
+{
+    GlobalResourceStates global;
+    const void* r = Resource(1);
+    global.Register(r, 1, ResourceState::RenderTarget, false);
+
+    ResourceStateTracker first(&global);
+    ResourceStateTracker second(&global);
+    MockCommandSink sink;
+
+    Use(first, r, ResourceState::RenderTarget);
+    first.Transition(r, ResourceState::PixelShaderResource);
+    first.Close(sink);
+    second.Transition(r, ResourceState::CopySource);
+    second.Close(sink);
+
+    std::vector<ResourceBarrierDesc> fixups;
+    first.ResolvePending(fixups);
+    CHECK(fixups.empty());
+    CHECK(global.State(r, 0) == ResourceState::PixelShaderResource);
+
+    second.ResolvePending(fixups);
+    CHECK(fixups.size() == 1);
+    CHECK(fixups[0] == Transition(r, ResourceState::PixelShaderResource, ResourceState::CopySource, 0));
+    CHECK(global.State(r, 0) == ResourceState::CopySource);
+}
+
+TEST_CASE(CommonPromotesAndDecays)
+{
+    GlobalResourceStates global;
+    const void* texture = Resource(1);
+    const void* target = Resource(2);
+    const void* buffer = Resource(3);
+    global.Register(texture, 1, ResourceState::Common, false);
+    global.Register(target, 1, ResourceState::Common, false);
+    global.Register(buffer, 1, ResourceState::Common, true);
+
+    ResourceStateTracker tracker(&global);
+    tracker.Transition(texture, ResourceState::PixelShaderResource);
+    tracker.Transition(target, ResourceState::RenderTarget);
+    tracker.Transition(buffer, ResourceState::UnorderedAccess);
+
+    std::vector<ResourceBarrierDesc> fixups;
+    tracker.ResolvePending(fixups);
+
+    // Render targets are never promoted.
+    CHECK(fixups.size() == 1);
+    CHECK(fixups[0] == Transition(target, ResourceState::Common, ResourceState::RenderTarget, 0));
+
+    // A texture only read, and any buffer, are back in Common after the list.
+    CHECK(global.State(texture, 0) == ResourceState::Common);
+    CHECK(global.State(target, 0) == ResourceState::RenderTarget);
+    CHECK(global.State(buffer, 0) == ResourceState::Common);
+
+    // A texture promoted to a write state keeps it.
+    tracker.Reset();
+    global.Register(texture, 1, ResourceState::Common, false);
+    tracker.Transition(texture, ResourceState::CopyDest);
+    fixups.clear();
+    tracker.ResolvePending(fixups);
+    CHECK(fixups.empty());
+    CHECK(global.State(texture, 0) == ResourceState::CopyDest);
+}
+
+TEST_CASE(SubresourcesAreTrackedApart)
+{
+    GlobalResourceStates global;
+    const void* r = Resource(1);
+    global.Register(r, 4, ResourceState::PixelShaderResource, false);
+
+    ResourceStateTracker tracker(&global);
+    MockCommandSink sink;
+    Use(tracker, r, ResourceState::PixelShaderResource);
+
+    tracker.Transition(r, ResourceState::RenderTarget, 2);
+    tracker.Flush(sink);
+    CHECK(sink.Barriers.size() == 1);
+    CHECK(sink.Barriers[0] == Transition(r, ResourceState::PixelShaderResource, ResourceState::RenderTarget, 2));
+
+    // Only the odd subresource moves back.
+    tracker.Transition(r, ResourceState::PixelShaderResource);
+    tracker.Flush(sink);
+    CHECK(sink.Barriers.size() == 2);
+    CHECK(sink.Barriers[1] == Transition(r, ResourceState::RenderTarget, ResourceState::PixelShaderResource, 2));
+
+    // Uniform again, so the whole resource moves in one barrier.
+    tracker.Transition(r, ResourceState::CopyDest);
+    tracker.Close(sink);
+    CHECK(sink.Barriers.size() == 3);
+    CHECK(sink.Barriers[2] == Transition(r, ResourceState::PixelShaderResource, ResourceState::CopyDest));
+
+    std::vector<ResourceBarrierDesc> fixups;
+    tracker.ResolvePending(fixups);
+    CHECK(fixups.empty());
+    for (std::uint32_t s = 0; s < 4; ++s)
+        CHECK(global.State(r, s) == ResourceState::CopyDest);
+
+    // Every subresource making the same fixup is one barrier.
+    ResourceStateTracker next(&global);
+    next.Transition(r, ResourceState::PixelShaderResource);
+    next.ResolvePending(fixups);
+    CHECK(fixups.size() == 1);
+    CHECK(fixups[0] == Transition(r, ResourceState::CopyDest, ResourceState::PixelShaderResource));
+}
+
+TEST_CASE(SplitBarriersEndAtUseOrClose)
+{
+    GlobalResourceStates global;
+    const void* a = Resource(1);
+    const void* b = Resource(2);
+    global.Register(a, 1, ResourceState::RenderTarget, false);
+    global.Register(b, 1, ResourceState::RenderTarget, false);
+
+    ResourceStateTracker tracker(&global);
+    MockCommandSink sink;
+    Use(tracker, a, ResourceState::RenderTarget);
+    Use(tracker, b, ResourceState::RenderTarget);
+
+    tracker.BeginTransition(a, ResourceState::PixelShaderResource);
+    tracker.BeginTransition(b, ResourceState::CopySource);
+    tracker.Flush(sink);
+    CHECK(sink.Barriers.size() == 2);
+    CHECK(sink.Barriers[0] == Transition(a, ResourceState::RenderTarget, ResourceState::PixelShaderResource,
+        AllSubresources, ResourceBarrierDesc::Split::BeginOnly));
+
+    // Using a reaches the state the split was going to.
+    tracker.Transition(a, ResourceState::PixelShaderResource);
+    tracker.Flush(sink);
+    CHECK(sink.Barriers.size() == 3);
+    CHECK(sink.Barriers[2] == Transition(a, ResourceState::RenderTarget, ResourceState::PixelShaderResource,
+        AllSubresources, ResourceBarrierDesc::Split::EndOnly));
+
+    // b is never used again, Close ends it.
+    tracker.Close(sink);
+    CHECK(sink.Barriers.size() == 4);
+    CHECK(sink.Barriers[3] == Transition(b, ResourceState::RenderTarget, ResourceState::CopySource,
+        AllSubresources, ResourceBarrierDesc::Split::EndOnly));
+
+    // A split cannot start on a resource the list has not used yet.
+    ResourceStateTracker fresh(&global);
+    bool threw = false;
+    try
+    {
+        fresh.BeginTransition(a, ResourceState::CopyDest);
+    }
+    catch (const std::logic_error&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST_CASE(UnregisteredResourcesAreRejected)
+{
+    GlobalResourceStates global;
+    const void* r = Resource(1);
+    global.Register(r, 2, ResourceState::Common, false);
+    CHECK(global.IsRegistered(r));
+    CHECK(global.SubresourceCount(r) == 2);
+
+    global.Unregister(r);
+    CHECK(!global.IsRegistered(r));
+
+    ResourceStateTracker tracker(&global);
+    bool threw = false;
+    try
+    {
+        tracker.Transition(r, ResourceState::CopyDest);
+    }
+    catch (const std::invalid_argument&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
@@ -0,0 +1,112 @@
+#include "Benchmark.h"
+#include "CullMath.h"
+
+#include "Utility/SceneBvh.h"
+#include "Utility/ThreadPool.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    // count objects over a 2 km square in clumps of 64.
+    void FillScene(BoundsSoA& bounds, std::uint32_t count)
+    {
+        bounds.Resize(count);
+        std::uint32_t state = 12345;
+        auto next = [&]() { state = state * 1664525u + 1013904223u; return (float)(state >> 8) * (1.0f / 16777216.0f); };
+        Float3 clump = {};
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            if (i % 64 == 0)
+                clump = { next() * 2000.0f - 1000.0f, next() * 20.0f, next() * 2000.0f - 1000.0f };
+            bounds.Set(i, { clump.x + next() * 30.0f, clump.y + next() * 6.0f, clump.z + next() * 30.0f }, { 1.0f + next(), 1.0f + next(), 1.0f + next() });
+        }
+    }
+}
+
+BENCHMARK(BuildSceneBvh)
+{
+    ThreadPool pool;
+    for (std::uint32_t count : { 100000u, 1000000u })
+    {
+        BoundsSoA bounds;
+        FillScene(bounds, count);
+        SceneBvh bvh;
+        const double serial = Bench::Time([&] { bvh.Build(bounds, nullptr); }, 3);
+        const double parallel = Bench::Time([&] { bvh.Build(bounds, &pool); }, 3);
+
+        char label[96];
+        std::snprintf(label, sizeof(label), "%uk items, %u nodes, cost %.1f", count / 1000, bvh.NodeCount(), bvh.Cost());
+        Bench::Report(label, serial, (double)count, "items");
+        std::snprintf(label, sizeof(label), "%uk items on %u threads", count / 1000, pool.WorkerCount() + 1);
+        Bench::Report(label, parallel, (double)count, "items");
+    }
+}
+
+BENCHMARK(RefitSceneBvh)
+{
+    const std::uint32_t count = 1000000;
+    BoundsSoA bounds;
+    FillScene(bounds, count);
+    SceneBvh bvh;
+    bvh.Build(bounds, nullptr);
+
+    // A share of the items nudged every frame, back and forth so the tree
+    // never loosens enough to rebuild.
+    for (std::uint32_t stride : { 1000u, 100u, 10u })
+    {
+        float offset = 0.25f;
+        std::uint32_t refitted = 0;
+        const double seconds = Bench::Time([&]
+        {
+            offset = -offset;
+            for (std::uint32_t i = 0; i < count; i += stride)
+            {
+                const Float3 c = bounds.Center(i);
+                bvh.SetBounds(i, { c.x + offset, c.y, c.z }, bounds.Extents(i));
+            }
+            refitted = bvh.Refit(nullptr).NodesRefitted;
+        });
+
+        char label[96];
+        std::snprintf(label, sizeof(label), "1M items, %uk moved, %u nodes refitted", count / stride / 1000, refitted);
+        Bench::Report(label, seconds, (double)(count / stride), "moves");
+    }
+}
+
+BENCHMARK(QuerySceneBvh)
+{
+    const std::uint32_t count = 1000000;
+    BoundsSoA bounds;
+    FillScene(bounds, count);
+    SceneBvh bvh;
+    bvh.Build(bounds, nullptr);
+    FrustumCuller culler;
+    std::vector<std::uint32_t> visible;
+
+    // Near cameras see a small part of the scene, the far one most of it.
+    const struct { const char* Name; Float3 Eye; float Pitch; float Far; } cameras[] = {
+        { "street level", { 0.0f, 5.0f, 0.0f }, 0.0f, 200.0f },
+        { "above", { 0.0f, 300.0f, -400.0f }, 0.6f, 1000.0f },
+        { "whole scene", { 0.0f, 800.0f, -2500.0f }, 0.3f, 5000.0f },
+    };
+    for (const auto& camera : cameras)
+    {
+        const Frustum frustum = FrustumCull::ExtractFrustum(CullMath::Multiply(
+            CullMath::View(camera.Eye, 0.0f, camera.Pitch), CullMath::Perspective(1.0f, 16.0f / 9.0f, 0.5f, camera.Far)));
+
+        SceneBvh::QueryStats stats;
+        const double tree = Bench::Time([&] { visible.clear(); bvh.Query(frustum, visible, &stats); });
+        const std::size_t found = visible.size();
+        const double flat = Bench::Time([&] { culler.Cull(frustum, bounds, nullptr, visible); });
+        Bench::Consume(visible.data());
+
+        char label[128];
+        std::snprintf(label, sizeof(label), "%s, %zu visible, %u nodes visited, %u accepted", camera.Name, found,
+            stats.NodesVisited, stats.SubtreesAccepted);
+        Bench::Report(label, tree, (double)count, "items");
+        std::snprintf(label, sizeof(label), "%s, every box with AVX2", camera.Name);
+        Bench::Report(label, flat, (double)count, "items");
+    }
+}
@@ -0,0 +1,239 @@
+#include "TestFramework.h"
+#include "CullMath.h"
+
+#include "Utility/SceneBvh.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    Frustum CameraFrustum(float yaw, const Float3& eye, float farZ = 150.0f)
+    {
+        return FrustumCull::ExtractFrustum(CullMath::Multiply(
+            CullMath::View(eye, yaw, 0.15f), CullMath::Perspective(1.0f, 16.0f / 9.0f, 0.5f, farZ)));
+    }
+
+    // A scene of small objects in clumps, with some large ones across them.
+    void FillScene(BoundsSoA& bounds, std::uint32_t count, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        bounds.Resize(count);
+        Float3 clump = {};
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            if (i % 64 == 0)
+                clump = { random.Float(-300.0f, 300.0f), random.Float(0.0f, 20.0f), random.Float(-300.0f, 300.0f) };
+            const float size = random.Float(0.0f, 1.0f) < 0.02f ? 30.0f : 2.0f;
+            bounds.Set(i, { clump.x + random.Float(-15.0f, 15.0f), clump.y + random.Float(-3.0f, 3.0f), clump.z + random.Float(-15.0f, 15.0f) },
+                { random.Float(0.1f, size), random.Float(0.1f, size), random.Float(0.1f, size) });
+        }
+    }
+
+    // True when the box is within rounding distance of one of the planes,
+    // where the tree's min / max form and the center / extents form may
+    // decide differently.
+    bool OnAPlane(const Frustum& frustum, const Float3& center, const Float3& extents)
+    {
+        for (const Float4& p : frustum.Planes)
+        {
+            const float distance = center.x * p.x + center.y * p.y + center.z * p.z + p.w;
+            const float radius = extents.x * std::fabs(p.x) + extents.y * std::fabs(p.y) + extents.z * std::fabs(p.z);
+            if (std::fabs(distance + radius) < 1e-3f)
+                return true;
+        }
+        return false;
+    }
+
+    // The tree's answer is the item by item test, give or take boxes on a
+    // plane, with no item twice.
+    bool MatchesBruteForce(const SceneBvh& bvh, const BoundsSoA& bounds, const Frustum& frustum)
+    {
+        std::vector<std::uint32_t> visible;
+        bvh.Query(frustum, visible);
+        std::sort(visible.begin(), visible.end());
+        if (std::adjacent_find(visible.begin(), visible.end()) != visible.end())
+            return false;
+
+        for (std::uint32_t i = 0; i < bounds.Count(); ++i)
+        {
+            const bool expected = FrustumCull::IsVisible(frustum, bounds.Center(i), bounds.Extents(i));
+            const bool found = std::binary_search(visible.begin(), visible.end(), i);
+            if (expected != found && !OnAPlane(frustum, bounds.Center(i), bounds.Extents(i)))
+                return false;
+        }
+        return true;
+    }
+
+    // Everything, for checking the tree still holds each item once.
+    Frustum Everything()
+    {
+        Frustum f;
+        const Float4 planes[6] = { { 1, 0, 0, 1e6f }, { -1, 0, 0, 1e6f }, { 0, 1, 0, 1e6f }, { 0, -1, 0, 1e6f }, { 0, 0, 1, 1e6f }, { 0, 0, -1, 1e6f } };
+        std::copy(planes, planes + 6, f.Planes);
+        return f;
+    }
+}
+
+TEST_CASE(QueriesMatchBruteForce)
+{
+    ThreadPool pool(3);
+    for (std::uint32_t count : { 1u, 4u, 5u, 100u, 20000u })
+    {
+        BoundsSoA bounds;
+        FillScene(bounds, count, count);
+        SceneBvh serial, parallel;
+        serial.Build(bounds, nullptr);
+        parallel.Build(bounds, &pool);
+        CHECK(serial.ItemCount() == count);
+
+        // The pool only changes who builds which subtree.
+        CHECK(serial.NodeCount() == parallel.NodeCount());
+        CHECK_NEAR(serial.Cost(), parallel.Cost(), 1e-3 * serial.Cost());
+
+        Test::Random random(count);
+        for (int camera = 0; camera < 10; ++camera)
+        {
+            const Frustum frustum = CameraFrustum(random.Float(-3.2f, 3.2f),
+                { random.Float(-200.0f, 200.0f), random.Float(0.0f, 30.0f), random.Float(-200.0f, 200.0f) });
+            CHECK(MatchesBruteForce(serial, bounds, frustum));
+            CHECK(MatchesBruteForce(parallel, bounds, frustum));
+        }
+
+        std::vector<std::uint32_t> all;
+        serial.Query(Everything(), all);
+        std::sort(all.begin(), all.end());
+        CHECK(all.size() == count);
+        for (std::uint32_t i = 0; i < all.size(); ++i)
+            CHECK(all[i] == i);
+    }
+}
+
+TEST_CASE(RootBoxesTheScene)
+{
+    BoundsSoA bounds;
+    FillScene(bounds, 1000, 5);
+    SceneBvh bvh;
+    bvh.Build(bounds, nullptr);
+
+    Float3 lo = { 1e30f, 1e30f, 1e30f }, hi = { -1e30f, -1e30f, -1e30f };
+    for (std::uint32_t i = 0; i < bounds.Count(); ++i)
+    {
+        const Float3 c = bounds.Center(i), e = bounds.Extents(i);
+        lo = { std::min(lo.x, c.x - e.x), std::min(lo.y, c.y - e.y), std::min(lo.z, c.z - e.z) };
+        hi = { std::max(hi.x, c.x + e.x), std::max(hi.y, c.y + e.y), std::max(hi.z, c.z + e.z) };
+    }
+    Float3 min, max;
+    CHECK(bvh.Bounds(min, max));
+    CHECK(min.x == lo.x && min.y == lo.y && min.z == lo.z);
+    CHECK(max.x == hi.x && max.y == hi.y && max.z == hi.z);
+
+    // A camera looking at the whole scene from far away takes subtrees
+    // whole instead of walking down to every leaf.
+    SceneBvh::QueryStats stats;
+    std::vector<std::uint32_t> visible;
+    bvh.Query(CameraFrustum(0.0f, { 0.0f, 200.0f, -2000.0f }, 5000.0f), visible, &stats);
+    CHECK(visible.size() == bounds.Count());
+    CHECK(stats.SubtreesAccepted > 0);
+    CHECK(stats.NodesVisited < bvh.NodeCount());
+
+    // No items, no bounds.
+    SceneBvh empty;
+    BoundsSoA none;
+    empty.Build(none, nullptr);
+    CHECK(!empty.Bounds(min, max));
+    visible.clear();
+    empty.Query(Everything(), visible);
+    CHECK(visible.empty());
+    CHECK(empty.Cost() == 0.0f);
+    CHECK(empty.Refit(nullptr).NodesRefitted == 0);
+}
+
+TEST_CASE(CoincidentItemsStillSplit)
+{
+    // Centroids that never separate leave the builder no axis to bin on.
+    BoundsSoA bounds;
+    bounds.Resize(100);
+    for (std::uint32_t i = 0; i < 100; ++i)
+        bounds.Set(i, { 1.0f, 2.0f, 3.0f }, { 0.5f, 0.5f, 0.5f });
+    SceneBvh bvh;
+    bvh.Build(bounds, nullptr);
+
+    std::vector<std::uint32_t> visible;
+    bvh.Query(Everything(), visible);
+    CHECK(visible.size() == 100);
+    CHECK(bvh.NodeCount() < 2 * 100);
+}
+
+TEST_CASE(SmallMovesOnlyRefit)
+{
+    BoundsSoA bounds;
+    FillScene(bounds, 5000, 9);
+    SceneBvh bvh;
+    bvh.Build(bounds, nullptr);
+    const std::uint32_t nodes = bvh.NodeCount();
+
+    // Putting an item where it is changes nothing.
+    CHECK(!bvh.SetBounds(7, bounds.Center(7), bounds.Extents(7)));
+    CHECK(bvh.Refit(nullptr).NodesRefitted == 0);
+
+    // Every tenth item nudged: refits, no rebuilds.
+    Test::Random random(10);
+    for (std::uint32_t i = 0; i < bounds.Count(); i += 10)
+    {
+        const Float3 c = bounds.Center(i);
+        bounds.Set(i, { c.x + random.Float(-0.5f, 0.5f), c.y, c.z + random.Float(-0.5f, 0.5f) }, bounds.Extents(i));
+        CHECK(bvh.SetBounds(i, bounds.Center(i), bounds.Extents(i)));
+    }
+    const SceneBvh::RefitStats stats = bvh.Refit(nullptr);
+    CHECK(stats.NodesRefitted > 0);
+    CHECK(stats.SubtreesRebuilt == 0 && !stats.FullRebuild);
+    CHECK(bvh.NodeCount() == nodes);
+    CHECK(bvh.Refit(nullptr).NodesRefitted == 0);
+
+    for (int camera = 0; camera < 10; ++camera)
+        CHECK(MatchesBruteForce(bvh, bounds, CameraFrustum(0.6f * camera, { 0.0f, 10.0f, 0.0f })));
+}
+
+TEST_CASE(LooseSubtreesRebuild)
+{
+    ThreadPool pool(2);
+    BoundsSoA bounds;
+    FillScene(bounds, 20000, 11);
+    SceneBvh bvh;
+    bvh.Build(bounds, &pool);
+
+    // One clump scattered over the scene stretches the nodes above it far
+    // past the rebuild ratio.
+    Test::Random random(12);
+    for (std::uint32_t i = 640; i < 704; ++i)
+    {
+        bounds.Set(i, { random.Float(-300.0f, 300.0f), 5.0f, random.Float(-300.0f, 300.0f) }, bounds.Extents(i));
+        bvh.SetBounds(i, bounds.Center(i), bounds.Extents(i));
+    }
+    const SceneBvh::RefitStats stats = bvh.Refit(&pool);
+    CHECK(stats.SubtreesRebuilt > 0 || stats.FullRebuild);
+    for (int camera = 0; camera < 10; ++camera)
+        CHECK(MatchesBruteForce(bvh, bounds, CameraFrustum(0.6f * camera, { 0.0f, 10.0f, 0.0f })));
+
+    // Refitted and rebuilt, the tree stays close to a fresh build.
+    SceneBvh fresh;
+    fresh.Build(bounds, nullptr);
+    CHECK(bvh.Cost() < 1.5f * fresh.Cost());
+
+    // Moving everything rebuilds everything.
+    for (std::uint32_t i = 0; i < bounds.Count(); ++i)
+    {
+        const Float3 c = bounds.Center(i);
+        bounds.Set(i, { -c.z * 3.0f, c.y, c.x * 3.0f }, bounds.Extents(i));
+        bvh.SetBounds(i, bounds.Center(i), bounds.Extents(i));
+    }
+    CHECK(bvh.Refit(&pool).FullRebuild);
+    std::vector<std::uint32_t> all;
+    bvh.Query(Everything(), all);
+    CHECK(all.size() == bounds.Count());
+    for (int camera = 0; camera < 10; ++camera)
+        CHECK(MatchesBruteForce(bvh, bounds, CameraFrustum(0.6f * camera, { 0.0f, 10.0f, 0.0f })));
+}
@@ -0,0 +1,160 @@
+#include "TestFramework.h"
+#include "FileCheck.h"
+
+#include "Structure/ShaderCache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace
+{
+    // A scratch shader tree, removed again with the object.
+    class ShaderTree
+    {
+    public:
+        explicit ShaderTree(const char* name) :
+            mRoot(std::filesystem::temp_directory_path() / "CreepEngineTests" / name)
+        {
+            std::filesystem::remove_all(mRoot);
+            std::filesystem::create_directories(mRoot);
+        }
+        ~ShaderTree()
+        {
+            std::error_code ec;
+            std::filesystem::remove_all(mRoot, ec);
+        }
+
+        std::string Write(const std::string& file, const std::string& text)
+        {
+            const std::filesystem::path path = mRoot / file;
+            std::filesystem::create_directories(path.parent_path());
+            std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+            return Path(file);
+        }
+        std::string Path(const std::string& file)const { return (mRoot / file).lexically_normal().generic_string(); }
+        std::string Dir()const { return mRoot.generic_string(); }
+
+    private:
+        std::filesystem::path mRoot;
+    };
+
+    Hash128 KeyOf(const std::string& path, const std::vector<ShaderDefine>& defines = {},
+        const std::string& entry = "PS", const std::string& target = "ps_5_1", std::uint32_t flags = 0)
+    {
+        ShaderSource source;
+        std::string error;
+        ShaderCache::ExpandIncludes(path, source, error);
+        return ShaderCache::Key(source, defines, entry, target, flags);
+    }
+}
+
+TEST_CASE(IncludesArePastedWithLineDirectives)
+{
+    ShaderTree tree("ShaderCacheExpand");
+    tree.Write("Common.hlsl", "float4 Common;\n");
+    tree.Write("Lighting/Light.hlsl", "#include \"../Common.hlsl\"\nfloat Light;\n");
+    const std::string main = tree.Write("Default.hlsl",
+        "// Default\r\n  #  include <Common.hlsl>\r\n#include \"Lighting/Light.hlsl\"\r\nfloat4 PS() : SV_Target;\r\n");
+
+    ShaderSource source;
+    std::string error;
+    CHECK(ShaderCache::ExpandIncludes(main, source, error));
+    CHECK(error.empty());
+
+    // Each file listed once, in the order met.
+    CHECK(source.Files.size() == 3);
+    if (source.Files.size() == 3)
+    {
+        CHECK(source.Files[0] == tree.Path("Default.hlsl"));
+        CHECK(source.Files[1] == tree.Path("Common.hlsl"));
+        CHECK(source.Files[2] == tree.Path("Lighting/Light.hlsl"));
+    }
+
+    const std::string mainName = tree.Path("Default.hlsl");
+    const std::string commonName = tree.Path("Common.hlsl");
+    const std::string lightName = tree.Path("Lighting/Light.hlsl");
+    const std::string expected =
+        "#line 1 \"" + mainName + "\"\n// Default\n"
+        "#line 1 \"" + commonName + "\"\nfloat4 Common;\n"
+        "#line 3 \"" + mainName + "\"\n"
+        "#line 1 \"" + lightName + "\"\n"
+        "#line 1 \"" + commonName + "\"\nfloat4 Common;\n"
+        "#line 2 \"" + lightName + "\"\nfloat Light;\n"
+        "#line 4 \"" + mainName + "\"\n"
+        "float4 PS() : SV_Target;\n";
+    CHECK(source.Text == expected);
+}
+
+TEST_CASE(BrokenIncludesFail)
+{
+    ShaderTree tree("ShaderCacheBroken");
+    const std::string missing = tree.Write("Missing.hlsl", "#include \"Nowhere.hlsl\"\n");
+    const std::string cycle = tree.Write("A.hlsl", "#include \"B.hlsl\"\n");
+    tree.Write("B.hlsl", "#include \"A.hlsl\"\n");
+
+    ShaderSource source;
+    std::string error;
+    CHECK(!ShaderCache::ExpandIncludes(missing, source, error));
+    CHECK(error.find("Nowhere.hlsl") != std::string::npos);
+
+    CHECK(!ShaderCache::ExpandIncludes(cycle, source, error));
+    CHECK(error.find("too deep") != std::string::npos);
+
+    CHECK(!ShaderCache::ExpandIncludes(tree.Path("NotThere.hlsl"), source, error));
+}
+
+TEST_CASE(KeyCoversEveryCompilerInput)
+{
+    ShaderTree tree("ShaderCacheKey");
+    tree.Write("Common.hlsl", "float4 Common;\n");
+    const std::string main = tree.Write("Default.hlsl", "#include \"Common.hlsl\"\nfloat4 PS() : SV_Target;\n");
+
+    const std::vector<ShaderDefine> defines = { { "SHADOW", "1" }, { "FOG", "1" } };
+    const Hash128 base = KeyOf(main, defines);
+
+    // Same inputs, same key.
+    CHECK(KeyOf(main, defines) == base);
+
+    // Every input on its own changes it.
+    CHECK(!(KeyOf(main, { { "SHADOW", "1" }, { "FOG", "0" } }) == base));
+    CHECK(!(KeyOf(main, { { "FOG", "1" }, { "SHADOW", "1" } }) == base));
+    CHECK(!(KeyOf(main, { { "SHADOW", "1" } }) == base));
+    CHECK(!(KeyOf(main, { { "SHADOW", "1F" }, { "OG", "1" } }) == base));
+    CHECK(!(KeyOf(main, defines, "VS") == base));
+    CHECK(!(KeyOf(main, defines, "PS", "ps_6_0") == base));
+    CHECK(!(KeyOf(main, defines, "PS", "ps_5_1", 1) == base));
+
+    // Editing an included file is a new key, and putting it back the old one.
+    tree.Write("Common.hlsl", "float4 Common; // edited\n");
+    CHECK(!(KeyOf(main, defines) == base));
+    tree.Write("Common.hlsl", "float4 Common;\n");
+    CHECK(KeyOf(main, defines) == base);
+
+    // Line endings are not an input.
+    tree.Write("Common.hlsl", "float4 Common;\r\n");
+    CHECK(KeyOf(main, defines) == base);
+}
+
+TEST_CASE(CacheFilesAreNamedByKey)
+{
+    ShaderTree a("ShaderCacheShareA");
+    ShaderTree b("ShaderCacheShareB");
+    const std::string text = "float4 PS() : SV_Target { return 1; }\n";
+
+    // The #line directives carry the path, so only the same file at the
+    // same path shares a key; a copy elsewhere compiles on its own.
+    const std::string first = a.Write("Shader.hlsl", text);
+    const std::string second = b.Write("Shader.hlsl", text);
+    CHECK(KeyOf(first) == KeyOf(first));
+    CHECK(!(KeyOf(first) == KeyOf(second)));
+
+    const Hash128 key = KeyOf(first);
+    const std::string path = ShaderCache::CachePath(a.Dir() + "/cache", key);
+    CHECK(path == a.Dir() + "/cache/" + key.ToHex() + ".cso");
+
+    const char bytecode[] = "DXBC....";
+    CHECK(ShaderCache::WriteFile(path, bytecode, sizeof(bytecode)));
+    CHECK(std::filesystem::file_size(path) == sizeof(bytecode));
+    CHECK(!FileCheck::HasTempFiles(path));
+}
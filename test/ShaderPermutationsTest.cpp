@@ -0,0 +1,270 @@
+#include "TestFramework.h"
+
+#include "Structure/ShaderPermutations.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+    // Shaped like the scene shader: a VS that only knows about skinning and
+    // a PS that sees every keyword.
+    struct SceneShader
+    {
+        ShaderPermutationSet Set{ "Shaders/Default.hlsl" };
+        std::uint32_t Shadow, Lights, Skinned;
+        std::uint32_t VS, PS;
+
+        SceneShader()
+        {
+            Shadow = Set.AddKeyword("SHADOW", { "", "1" });
+            Lights = Set.AddKeyword("NUM_LIGHTS", { "0", "4", "16" });
+            Skinned = Set.AddKeyword("SKINNED", { "", "1" });
+            VS = Set.AddStage("VS", "VS", "vs_5_1", { Skinned });
+            PS = Set.AddStage("PS", "PS", "ps_5_1", { Shadow, Lights, Skinned });
+        }
+    };
+}
+
+TEST_CASE(PermutationsAreMixedRadixNumbers)
+{
+    SceneShader shader;
+    const ShaderPermutationSet& set = shader.Set;
+    CHECK(set.PermutationCount() == 12);
+    CHECK(set.FindKeyword("NUM_LIGHTS") == shader.Lights);
+    CHECK(set.FindStage("PS") == shader.PS);
+
+    // The first keyword is the lowest digit.
+    const std::uint32_t values[3] = { 1, 2, 1 };
+    const ShaderPermutationSet::Permutation p = set.Compose(values);
+    CHECK(p == 1 + 2 * 2 + 1 * 6);
+    for (ShaderPermutationSet::Permutation q = 0; q < set.PermutationCount(); ++q)
+    {
+        const std::uint32_t digits[3] = { set.ValueIndex(q, 0), set.ValueIndex(q, 1), set.ValueIndex(q, 2) };
+        CHECK(set.Compose(digits) == q);
+    }
+    CHECK(set.Value(p, shader.Lights) == "16");
+
+    const std::vector<ShaderPermutationSet::Permutation> all = set.Enumerate();
+    CHECK(all.size() == 12);
+    for (std::uint32_t i = 0; i < all.size(); ++i)
+        CHECK(all[i] == i);
+    CHECK(!set.IsReachable(12));
+
+    bool threw = false;
+    try
+    {
+        set.FindKeyword("FOG");
+    }
+    catch (const std::out_of_range&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST_CASE(DefinesFollowTheStage)
+{
+    SceneShader shader;
+    const ShaderPermutationSet& set = shader.Set;
+    const std::uint32_t values[3] = { 1, 1, 0 };
+    const ShaderPermutationSet::Permutation p = set.Compose(values);
+
+    // Empty values stay undefined, keywords a stage does not use are left out.
+    const std::vector<ShaderDefine> ps = set.Defines(p, shader.PS);
+    CHECK(ps.size() == 2);
+    if (ps.size() == 2)
+    {
+        CHECK(ps[0].Name == "SHADOW" && ps[0].Value == "1");
+        CHECK(ps[1].Name == "NUM_LIGHTS" && ps[1].Value == "4");
+    }
+    CHECK(set.Defines(p, shader.VS).empty());
+
+    CHECK(set.ValueAtLeast(shader.Lights, 0) == 0);
+    CHECK(set.ValueAtLeast(shader.Lights, 3) == 1);
+    CHECK(set.ValueAtLeast(shader.Lights, 16) == 2);
+    CHECK(set.ValueAtLeast(shader.Lights, 17) == 3);
+    CHECK(set.ValueAtLeast(shader.Shadow, 1) == 1);
+}
+
+TEST_CASE(FilteredPermutationsAreNeverSelected)
+{
+    SceneShader shader;
+    ShaderPermutationSet& set = shader.Set;
+    // No shadows on skinned meshes, and at most four lights with shadows.
+    set.SetFilter([&](const ShaderPermutationSet& s, ShaderPermutationSet::Permutation p)
+    {
+        const bool shadow = s.ValueIndex(p, shader.Shadow) != 0;
+        return !(shadow && s.ValueIndex(p, shader.Skinned) != 0) && !(shadow && s.ValueIndex(p, shader.Lights) == 2);
+    });
+
+    const std::vector<ShaderPermutationSet::Permutation> reachable = set.Enumerate();
+    CHECK(reachable.size() == 12 - 3 - 1);
+    for (ShaderPermutationSet::Permutation p : reachable)
+        CHECK(set.IsReachable(p));
+
+    // Select against a brute force search over every request.
+    for (std::uint32_t shadow = 0; shadow < 3; ++shadow)
+    {
+        for (std::uint32_t lights = 0; lights < 4; ++lights)
+        {
+            for (std::uint32_t skinned = 0; skinned < 3; ++skinned)
+            {
+                const std::uint32_t minimum[3] = { shadow, lights, skinned };
+                std::uint32_t bestCost = ~0u;
+                for (ShaderPermutationSet::Permutation p : reachable)
+                {
+                    std::uint32_t cost = 0;
+                    bool ok = true;
+                    for (std::uint32_t k = 0; k < 3; ++k)
+                    {
+                        ok = ok && set.ValueIndex(p, k) >= minimum[k];
+                        cost += set.ValueIndex(p, k);
+                    }
+                    if (ok)
+                        bestCost = std::min(bestCost, cost);
+                }
+
+                ShaderPermutationSet::Permutation selected = ~0u;
+                const bool found = set.Select(minimum, selected);
+                CHECK(found == (bestCost != ~0u));
+                if (found)
+                {
+                    CHECK(set.IsReachable(selected));
+                    const std::uint32_t cost = set.ValueIndex(selected, 0) + set.ValueIndex(selected, 1) + set.ValueIndex(selected, 2);
+                    CHECK(cost == bestCost);
+                    for (std::uint32_t k = 0; k < 3; ++k)
+                        CHECK(set.ValueIndex(selected, k) >= minimum[k]);
+                }
+            }
+        }
+    }
+
+    // Shadows with sixteen lights is filtered out, sixteen lights alone is not.
+    const std::uint32_t wanted[3] = { 1, 2, 0 };
+    ShaderPermutationSet::Permutation selected;
+    CHECK(!set.Select(wanted, selected));
+}
+
+TEST_CASE(StagesShareJobsAcrossPermutations)
+{
+    SceneShader shader;
+    ShaderPermutationSet other("Shaders/Sky.hlsl");
+    other.AddKeyword("SKINNED", { "", "1" });
+    other.AddStage("VS", "VS", "vs_5_1", { 0 });
+    other.AddStage("PS", "PS", "ps_5_1");
+
+    ShaderPermutationCompiler compiler;
+    const std::uint32_t scene = compiler.Add(shader.Set);
+    const std::uint32_t sky = compiler.Add(other);
+
+    // Two VS and twelve PS for the scene; the sky is another file, so its
+    // two VS and one PS are jobs of their own.
+    CHECK(compiler.Jobs().size() == 2 + 12 + 2 + 1);
+
+    for (ShaderPermutationSet::Permutation p = 0; p < shader.Set.PermutationCount(); ++p)
+    {
+        const std::uint32_t vs = compiler.JobIndex(scene, p, shader.VS);
+        const std::uint32_t ps = compiler.JobIndex(scene, p, shader.PS);
+        CHECK(vs < compiler.Jobs().size() && ps < compiler.Jobs().size());
+        if (vs >= compiler.Jobs().size() || ps >= compiler.Jobs().size())
+            continue;
+
+        // The VS job only depends on SKINNED.
+        const std::uint32_t base[3] = { 0, 0, shader.Set.ValueIndex(p, shader.Skinned) };
+        CHECK(vs == compiler.JobIndex(scene, shader.Set.Compose(base), shader.VS));
+
+        const ShaderCompileJob& job = compiler.Jobs()[ps];
+        CHECK(job.Set == &shader.Set && job.Stage == shader.PS);
+        const std::vector<ShaderDefine> defines = shader.Set.Defines(p, shader.PS);
+        CHECK(job.Defines.size() == defines.size());
+    }
+    CHECK(compiler.JobIndex(sky, 0, 1) == compiler.JobIndex(sky, 1, 1));
+    CHECK(compiler.JobIndex(scene, 12, shader.PS) == ShaderPermutationCompiler::NoJob);
+
+    // Filtered permutations get no job.
+    ShaderPermutationSet filtered("Shaders/Default.hlsl");
+    filtered.AddKeyword("SHADOW", { "", "1" });
+    filtered.AddStage("PS", "PS", "ps_5_1", { 0 });
+    filtered.SetFilter([](const ShaderPermutationSet&, ShaderPermutationSet::Permutation p) { return p == 0; });
+    compiler.Clear();
+    const std::uint32_t index = compiler.Add(filtered);
+    CHECK(compiler.Jobs().size() == 1);
+    CHECK(compiler.JobIndex(index, 1, 0) == ShaderPermutationCompiler::NoJob);
+}
+
+TEST_CASE(PinnedKeywordsCompileOnlyTheSwitch)
+{
+    // As the app declares its shaders: the light count pinned to what the
+    // scene needs and skinning off, so only SHADOW is left to vary.
+    SceneShader shader;
+    ShaderPermutationSet& set = shader.Set;
+    const std::uint32_t lights = set.ValueAtLeast(shader.Lights, 3);
+    set.SetFilter([&](const ShaderPermutationSet& s, ShaderPermutationSet::Permutation p)
+    {
+        return s.ValueIndex(p, shader.Lights) == lights && s.ValueIndex(p, shader.Skinned) == 0;
+    });
+    CHECK(set.Enumerate().size() == 2);
+
+    ShaderPermutationCompiler compiler;
+    compiler.Add(set);
+    CHECK(compiler.Jobs().size() == 1 + 2);
+
+    // Fewer lights than pinned still selects the pinned count; more, or
+    // skinning, has no variant.
+    std::uint32_t minimum[3] = { 0, 0, 0 };
+    ShaderPermutationSet::Permutation plain, shadowed;
+    CHECK(set.Select(minimum, plain));
+    CHECK(set.ValueIndex(plain, shader.Lights) == lights && set.ValueIndex(plain, shader.Shadow) == 0);
+    minimum[shader.Shadow] = 1;
+    CHECK(set.Select(minimum, shadowed));
+    CHECK(set.ValueIndex(shadowed, shader.Lights) == lights && set.ValueIndex(shadowed, shader.Shadow) == 1);
+    minimum[shader.Lights] = lights + 1;
+    CHECK(!set.Select(minimum, shadowed));
+    minimum[shader.Lights] = 0;
+    minimum[shader.Skinned] = 1;
+    CHECK(!set.Select(minimum, shadowed));
+}
+
+TEST_CASE(RunCompilesEveryJobOnceAndRethrows)
+{
+    SceneShader shader;
+    ShaderPermutationCompiler compiler;
+    compiler.Add(shader.Set);
+    const std::uint32_t jobCount = (std::uint32_t)compiler.Jobs().size();
+
+    ThreadPool pool(3);
+    std::unique_ptr<std::atomic<int>[]> runs(new std::atomic<int>[jobCount]);
+    for (std::uint32_t i = 0; i < jobCount; ++i)
+        runs[i] = 0;
+
+    compiler.Run(pool, [&](const ShaderCompileJob& job, std::uint32_t index)
+    {
+        if (&job == &compiler.Jobs()[index])
+            ++runs[index];
+    });
+    for (std::uint32_t i = 0; i < jobCount; ++i)
+        CHECK(runs[i] == 1);
+
+    // A failing job does not stop the others, and its error comes back.
+    std::atomic<int> finished{ 0 };
+    bool threw = false;
+    try
+    {
+        compiler.Run(pool, [&](const ShaderCompileJob&, std::uint32_t index)
+        {
+            if (index == 3)
+                throw std::runtime_error("compile error");
+            ++finished;
+        });
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(finished == (int)jobCount - 1);
+}
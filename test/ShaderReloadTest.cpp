@@ -0,0 +1,160 @@
+#include "TestFramework.h"
+
+#include "Structure/FileWatcher.h"
+#include "Structure/ShaderReloadTracker.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    using Clock = ShaderReloadTracker::Clock;
+    using std::chrono::milliseconds;
+
+    std::filesystem::path ScratchDir(const char* name)
+    {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "CreepEngineTests" / name;
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        return dir;
+    }
+
+    void Save(const std::filesystem::path& path, const char* text)
+    {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+    }
+
+    std::size_t Count(const std::vector<std::string>& list, const std::string& value)
+    {
+        return (std::size_t)std::count(list.begin(), list.end(), value);
+    }
+}
+
+TEST_CASE(BurstsSettleIntoOneReload)
+{
+    ShaderReloadTracker tracker(milliseconds(200));
+    tracker.SetDependencies("Shaders/Default.hlsl", { "Shaders/Default.hlsl", "Shaders/Common.hlsl" });
+    const Clock::time_point t0;
+
+    // One save reported three times in quick succession.
+    CHECK(tracker.OnFileChanged("Shaders/Default.hlsl", t0));
+    CHECK(tracker.OnFileChanged("Shaders/Default.hlsl", t0 + milliseconds(5)));
+    CHECK(tracker.OnFileChanged("Shaders/Default.hlsl", t0 + milliseconds(150)));
+    CHECK(tracker.HasPending());
+
+    // The interval counts from the last change.
+    CHECK(tracker.TakeReady(t0 + milliseconds(300)).empty());
+    const std::vector<std::string> ready = tracker.TakeReady(t0 + milliseconds(350));
+    CHECK(ready.size() == 1 && ready[0] == "Shaders/Default.hlsl");
+    CHECK(!tracker.HasPending());
+    CHECK(tracker.TakeReady(t0 + milliseconds(1000)).empty());
+
+    // Files nobody includes are ignored.
+    CHECK(!tracker.OnFileChanged("Shaders/Unused.hlsl", t0));
+    CHECK(!tracker.HasPending());
+}
+
+TEST_CASE(SharedIncludesReloadEveryRoot)
+{
+    ShaderReloadTracker tracker(milliseconds(100));
+    tracker.SetDependencies("Shaders/Sky.hlsl", { "Shaders/Sky.hlsl", "Shaders/Common.hlsl" });
+    tracker.SetDependencies("Shaders/Default.hlsl", { "Shaders/Default.hlsl", "Shaders/Common.hlsl", "Shaders/Lighting/Light.hlsl" });
+    const Clock::time_point t0;
+
+    // Roots come out in the order they were first changed.
+    tracker.OnFileChanged("Shaders/Default.hlsl", t0);
+    tracker.OnFileChanged("Shaders/Common.hlsl", t0 + milliseconds(10));
+    std::vector<std::string> ready = tracker.TakeReady(t0 + milliseconds(110));
+    CHECK(ready.size() == 2);
+    if (ready.size() == 2)
+        CHECK(ready[0] == "Shaders/Default.hlsl" && ready[1] == "Shaders/Sky.hlsl");
+
+    // Only the settled root is taken.
+    tracker.OnFileChanged("Shaders/Sky.hlsl", t0 + milliseconds(200));
+    tracker.OnFileChanged("Shaders/Lighting/Light.hlsl", t0 + milliseconds(280));
+    ready = tracker.TakeReady(t0 + milliseconds(300));
+    CHECK(ready.size() == 1 && ready[0] == "Shaders/Sky.hlsl");
+    CHECK(tracker.HasPending());
+
+    // A shader that stops including a file no longer reloads for it.
+    tracker.TakeReady(t0 + milliseconds(1000));
+    tracker.SetDependencies("Shaders/Default.hlsl", { "Shaders/Default.hlsl", "Shaders/Common.hlsl" });
+    CHECK(!tracker.OnFileChanged("Shaders/Lighting/Light.hlsl", t0 + milliseconds(1000)));
+
+    const std::vector<std::string> dirs = tracker.Directories();
+    CHECK(dirs.size() == 1 && dirs[0] == "Shaders");
+}
+
+TEST_CASE(WatcherReportsSavesAndRenames)
+{
+    const std::filesystem::path dir = ScratchDir("FileWatcher");
+    const std::filesystem::path sub = dir / "Lighting";
+    std::filesystem::create_directories(sub);
+    Save(dir / "Default.hlsl", "old");
+
+    FileWatcher watcher;
+    CHECK(watcher.Watch(dir.string()));
+    CHECK(watcher.Watch(dir.string()));
+    CHECK(!watcher.Watch((dir / "Missing").string()));
+
+    std::vector<std::string> changed;
+    watcher.Poll(changed);
+    CHECK(changed.empty());
+
+    const std::string name = dir.lexically_normal().generic_string() + "/Default.hlsl";
+
+    // Saving in place.
+    Save(dir / "Default.hlsl", "new");
+    watcher.Poll(changed);
+    CHECK(Count(changed, name) >= 1);
+
+    // Saving through a temporary renamed over the file.
+    changed.clear();
+    Save(dir / "Default.hlsl.tmp", "newer");
+    std::filesystem::rename(dir / "Default.hlsl.tmp", dir / "Default.hlsl");
+    watcher.Poll(changed);
+    CHECK(Count(changed, name) >= 1);
+
+    // Subdirectories are not watched.
+    changed.clear();
+    Save(sub / "Light.hlsl", "light");
+    watcher.Poll(changed);
+    CHECK(changed.empty());
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE(WatchedSavesReloadOnce)
+{
+    const std::filesystem::path dir = ScratchDir("ShaderReload");
+    const std::string root = dir.lexically_normal().generic_string() + "/Default.hlsl";
+    const std::string common = dir.lexically_normal().generic_string() + "/Common.hlsl";
+    Save(root, "#include \"Common.hlsl\"");
+    Save(common, "float4 Common;");
+
+    ShaderReloadTracker tracker(milliseconds(200));
+    tracker.SetDependencies(root, { root, common });
+    FileWatcher watcher;
+    for (const std::string& watched : tracker.Directories())
+        CHECK(watcher.Watch(watched));
+
+    // Each save shows up as several events (create, close, rename), all
+    // within the interval.
+    const Clock::time_point t0;
+    std::vector<std::string> changed;
+    Save(common, "float4 Common; // a");
+    Save(dir / "Common.hlsl.tmp", "float4 Common; // b");
+    std::filesystem::rename(dir / "Common.hlsl.tmp", common);
+    Save(dir / "Scratch.txt", "not a shader");
+    watcher.Poll(changed);
+    CHECK(changed.size() >= 3);
+
+    for (const std::string& file : changed)
+        tracker.OnFileChanged(file, t0);
+    CHECK(tracker.TakeReady(t0 + milliseconds(100)).empty());
+    const std::vector<std::string> ready = tracker.TakeReady(t0 + milliseconds(200));
+    CHECK(ready.size() == 1 && ready[0] == root);
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,215 @@
+#include "TestFramework.h"
+#include "CullMath.h"
+
+#include "Utility/ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const Float3 SceneMin = { -500.0f, -10.0f, -500.0f };
+    const Float3 SceneMax = { 500.0f, 80.0f, 500.0f };
+    const Float3 LightDir = { 0.3f, -0.8f, 0.5f };
+    constexpr std::uint32_t Resolution = 2048;
+
+    // Camera at eye turned by yaw and pitch, the world matrix the view
+    // in CullMath inverts.
+    ShadowCamera MakeCamera(const Float3& eye, float yaw, float pitch)
+    {
+        const float cy = std::cos(yaw), sy = std::sin(yaw), cp = std::cos(pitch), sp = std::sin(pitch);
+        ShadowCamera camera;
+        camera.InvView = { { { cy, 0.0f, -sy, 0.0f },
+                             { sy * sp, cp, cy * sp, 0.0f },
+                             { sy * cp, -sp, cy * cp, 0.0f },
+                             { eye.x, eye.y, eye.z, 1.0f } } };
+        camera.TanHalfFovY = std::tan(0.5f);
+        camera.TanHalfFovX = camera.TanHalfFovY * 16.0f / 9.0f;
+        return camera;
+    }
+
+    // World position of view space (x, y) * depth at depth.
+    Float3 SlicePoint(const ShadowCamera& camera, float x, float y, float depth)
+    {
+        const Float3 view = { x * camera.TanHalfFovX * depth, y * camera.TanHalfFovY * depth, depth };
+        const Float4 world = CullMath::Transform(view, camera.InvView);
+        return { world.x, world.y, world.z };
+    }
+
+    bool InsideCascade(const ShadowCascade& cascade, const Float3& p, float tolerance)
+    {
+        const Float4 c = CullMath::Transform(p, cascade.ViewProj);
+        return std::fabs(c.x) <= 1.0f + tolerance && std::fabs(c.y) <= 1.0f + tolerance &&
+            c.z >= -tolerance && c.z <= 1.0f + tolerance;
+    }
+}
+
+TEST_CASE(SplitsBlendLogAndUniform)
+{
+    float splits[4];
+    ShadowCascades::SplitDistances(1.0f, 1000.0f, 4, 0.0f, splits);
+    CHECK_NEAR(splits[0], 250.75f, 1e-3);
+    CHECK_NEAR(splits[1], 500.5f, 1e-3);
+    CHECK(splits[3] == 1000.0f);
+
+    // Logarithmic splits grow by the same ratio.
+    ShadowCascades::SplitDistances(1.0f, 1000.0f, 3, 1.0f, splits);
+    CHECK_NEAR(splits[0], 10.0f, 1e-3);
+    CHECK_NEAR(splits[1], 100.0f, 1e-2);
+    CHECK(splits[2] == 1000.0f);
+
+    Test::Random random(1);
+    for (int i = 0; i < 100; ++i)
+    {
+        const float nearZ = random.Float(0.05f, 2.0f), farZ = random.Float(50.0f, 5000.0f);
+        ShadowCascades::SplitDistances(nearZ, farZ, 4, random.Float(0.0f, 1.0f), splits);
+        CHECK(nearZ < splits[0] && splits[0] < splits[1] && splits[1] < splits[2] && splits[2] < splits[3]);
+        CHECK(splits[3] == farZ);
+    }
+}
+
+TEST_CASE(CascadesContainTheirSlice)
+{
+    Test::Random random(2);
+    for (int i = 0; i < 200; ++i)
+    {
+        const ShadowCamera camera = MakeCamera({ random.Float(-300.0f, 300.0f), random.Float(0.0f, 40.0f), random.Float(-300.0f, 300.0f) },
+            random.Float(-3.2f, 3.2f), random.Float(-1.2f, 1.2f));
+        const float splitNear = random.Float(0.1f, 50.0f), splitFar = splitNear + random.Float(5.0f, 200.0f);
+        const ShadowCascade cascade = ShadowCascades::FitCascade(camera, splitNear, splitFar, LightDir, Resolution, SceneMin, SceneMax);
+        CHECK(cascade.SplitNear == splitNear && cascade.SplitFar == splitFar);
+
+        // Every corner of the slice, and points inside it, land in the map
+        // at least a texel from its edge.
+        const float edge = 1.0f - 2.0f / Resolution;
+        for (int k = 0; k < 40; ++k)
+        {
+            const float x = k < 8 ? (k & 1 ? 1.0f : -1.0f) : random.Float(-1.0f, 1.0f);
+            const float y = k < 8 ? (k & 2 ? 1.0f : -1.0f) : random.Float(-1.0f, 1.0f);
+            const float depth = k < 8 ? (k & 4 ? splitFar : splitNear) : random.Float(splitNear, splitFar);
+            const Float4 c = CullMath::Transform(SlicePoint(camera, x, y, depth), cascade.ViewProj);
+            CHECK(std::fabs(c.x) <= edge + 1e-4f && std::fabs(c.y) <= edge + 1e-4f);
+            CHECK(c.z >= 0.0f && c.z <= 1.0f);
+        }
+
+        // The texture transform is the same point in [0, 1], y down.
+        const Float3 p = SlicePoint(camera, 0.2f, -0.4f, 0.5f * (splitNear + splitFar));
+        const Float4 ndc = CullMath::Transform(p, cascade.ViewProj);
+        const Float4 uv = CullMath::Transform(p, cascade.ShadowTransform);
+        CHECK_NEAR(uv.x, 0.5f * ndc.x + 0.5f, 1e-5);
+        CHECK_NEAR(uv.y, 0.5f - 0.5f * ndc.y, 1e-5);
+        CHECK_NEAR(uv.z, ndc.z, 1e-5);
+    }
+}
+
+TEST_CASE(CascadesHoldStillAsTheCameraMoves)
+{
+    const float splitNear = 5.0f, splitFar = 60.0f;
+    const ShadowCascade base = ShadowCascades::FitCascade(MakeCamera({ 10.0f, 5.0f, 10.0f }, 0.3f, 0.1f),
+        splitNear, splitFar, LightDir, Resolution, SceneMin, SceneMax);
+    const float texelNdc = 2.0f / Resolution;
+
+    Test::Random random(3);
+    for (int i = 0; i < 200; ++i)
+    {
+        // Turning keeps the size, up to rounding of left and right; moving
+        // keeps the map on whole texels.  The depth range follows the scene.
+        const Float3 eye = { 10.0f + random.Float(-20.0f, 20.0f), 5.0f + random.Float(-2.0f, 2.0f), 10.0f + random.Float(-20.0f, 20.0f) };
+        const ShadowCascade cascade = ShadowCascades::FitCascade(MakeCamera(eye, random.Float(-3.2f, 3.2f), random.Float(-1.2f, 1.2f)),
+            splitNear, splitFar, LightDir, Resolution, SceneMin, SceneMax);
+        CHECK_NEAR(cascade.Proj.m[0][0], base.Proj.m[0][0], 1e-5 * base.Proj.m[0][0]);
+        CHECK_NEAR(cascade.Proj.m[1][1], base.Proj.m[1][1], 1e-5 * base.Proj.m[1][1]);
+
+        const float shiftX = (cascade.Proj.m[3][0] - base.Proj.m[3][0]) / texelNdc;
+        const float shiftY = (cascade.Proj.m[3][1] - base.Proj.m[3][1]) / texelNdc;
+        CHECK_NEAR(shiftX, std::round(shiftX), 1e-2);
+        CHECK_NEAR(shiftY, std::round(shiftY), 1e-2);
+    }
+
+    // A step smaller than a texel usually changes nothing.
+    int same = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        const ShadowCascade a = ShadowCascades::FitCascade(MakeCamera({ 0.01f * i, 5.0f, 0.0f }, 0.0f, 0.0f),
+            splitNear, splitFar, LightDir, Resolution, SceneMin, SceneMax);
+        const ShadowCascade b = ShadowCascades::FitCascade(MakeCamera({ 0.01f * i + 0.001f, 5.0f, 0.0f }, 0.0f, 0.0f),
+            splitNear, splitFar, LightDir, Resolution, SceneMin, SceneMax);
+        same += std::equal(&a.ViewProj.m[0][0], &a.ViewProj.m[0][0] + 16, &b.ViewProj.m[0][0]);
+    }
+    CHECK(same >= 90);
+}
+
+TEST_CASE(CasterVolumeReachesBackToTheLight)
+{
+    Test::Random random(4);
+    const float lightLength = std::sqrt(LightDir.x * LightDir.x + LightDir.y * LightDir.y + LightDir.z * LightDir.z);
+    const Float3 toLight = { -LightDir.x / lightLength, -LightDir.y / lightLength, -LightDir.z / lightLength };
+    int culled = 0;
+
+    for (int i = 0; i < 50; ++i)
+    {
+        const ShadowCamera camera = MakeCamera({ random.Float(-200.0f, 200.0f), random.Float(0.0f, 20.0f), random.Float(-200.0f, 200.0f) },
+            random.Float(-3.2f, 3.2f), random.Float(-0.5f, 0.5f));
+        const ShadowCascade cascade = ShadowCascades::FitCascade(camera, 10.0f, 80.0f, LightDir, Resolution, SceneMin, SceneMax);
+
+        // A caster anywhere between a point of the slice and the light,
+        // inside the scene, can shadow that point and must be kept.
+        for (int k = 0; k < 200; ++k)
+        {
+            const Float3 receiver = SlicePoint(camera, random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(10.0f, 80.0f));
+            const float t = random.Float(0.0f, 300.0f);
+            const Float3 caster = { receiver.x + toLight.x * t, receiver.y + toLight.y * t, receiver.z + toLight.z * t };
+            if (caster.y > SceneMax.y || caster.y < SceneMin.y)
+                continue;
+            CHECK(FrustumCull::IsVisible(cascade.CasterVolume, caster, { 0.5f, 0.5f, 0.5f }));
+            CHECK(InsideCascade(cascade, caster, 1e-3f));
+        }
+
+        // Casters well to the side of the cascade are dropped.
+        const Float3 center = SlicePoint(camera, 0.0f, 0.0f, 45.0f);
+        const Float3 side = { center.x + 500.0f * (LightDir.z), center.y, center.z - 500.0f * (LightDir.x) };
+        culled += !FrustumCull::IsVisible(cascade.CasterVolume, side, { 1.0f, 1.0f, 1.0f });
+    }
+    CHECK(culled == 50);
+
+    // Without scene bounds the depth range is the slice's sphere alone.
+    const ShadowCamera camera = MakeCamera({ 0.0f, 5.0f, 0.0f }, 0.0f, 0.0f);
+    const Float3 noMin = { 1.0f, 1.0f, 1.0f }, noMax = { -1.0f, -1.0f, -1.0f };
+    const ShadowCascade alone = ShadowCascades::FitCascade(camera, 10.0f, 80.0f, LightDir, Resolution, noMin, noMax);
+    const ShadowCascade withScene = ShadowCascades::FitCascade(camera, 10.0f, 80.0f, LightDir, Resolution, SceneMin, SceneMax);
+    CHECK(alone.Proj.m[2][2] > withScene.Proj.m[2][2]);
+}
+
+TEST_CASE(ShadowCacheRedrawsOnlyOnChange)
+{
+    BoundsSoA bounds;
+    bounds.Resize(4);
+    for (std::uint32_t i = 0; i < 4; ++i)
+        bounds.Set(i, { (float)i, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f });
+    const ShadowCascade cascade = ShadowCascades::FitCascade(MakeCamera({ 0.0f, 5.0f, 0.0f }, 0.0f, 0.0f),
+        1.0f, 30.0f, LightDir, Resolution, SceneMin, SceneMax);
+    const ShadowCascade moved = ShadowCascades::FitCascade(MakeCamera({ 20.0f, 5.0f, 0.0f }, 0.0f, 0.0f),
+        1.0f, 30.0f, LightDir, Resolution, SceneMin, SceneMax);
+
+    ShadowCache cache;
+    cache.Reset(2);
+    const std::uint32_t casters[3] = { 0, 2, 3 };
+    const std::uint32_t shuffled[3] = { 3, 0, 2 };
+    CHECK(cache.NeedsRender(0, cascade, casters, 3, bounds));
+    CHECK(!cache.NeedsRender(0, cascade, shuffled, 3, bounds));
+    // Slices are independent.
+    CHECK(cache.NeedsRender(1, cascade, casters, 3, bounds));
+
+    // A caster more, a caster moved, a new matrix: each is a redraw.
+    CHECK(cache.NeedsRender(0, cascade, casters, 2, bounds));
+    CHECK(cache.NeedsRender(0, cascade, casters, 3, bounds));
+    bounds.Set(2, { 2.0f, 0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f });
+    CHECK(cache.NeedsRender(0, cascade, casters, 3, bounds));
+    CHECK(!cache.NeedsRender(0, cascade, casters, 3, bounds));
+    CHECK(cache.NeedsRender(0, moved, casters, 3, bounds));
+
+    cache.Invalidate(0);
+    CHECK(cache.NeedsRender(0, moved, casters, 3, bounds));
+    // Slice 1 was drawn before the caster moved.
+    CHECK(cache.NeedsRender(1, cascade, casters, 3, bounds));
+}
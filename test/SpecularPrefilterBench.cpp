@@ -0,0 +1,76 @@
+#include "Benchmark.h"
+
+#include "Utility/SpecularPrefilter.h"
+#include "Utility/ThreadPool.h"
+
+#include <cmath>
+#include <cstdio>
+
+BENCHMARK(PrefilterGgx)
+{
+    // The app's settings on a 256 source: mips 1 to 5 are filtered.
+    const std::uint32_t sourceSize = 256;
+    CubeMapImage source(sourceSize);
+    std::uint32_t state = 12345;
+    auto next = [&]() { state = state * 1664525u + 1013904223u; return (float)(state >> 8) * (1.0f / 16777216.0f); };
+    for (std::uint32_t face = 0; face < 6; ++face)
+    {
+        CubeMapImage::Face& texels = source.GetFace(face);
+        for (std::size_t i = 0; i < texels.R.size(); ++i)
+        {
+            texels.R[i] = next() * 4.0f;
+            texels.G[i] = next() * 4.0f;
+            texels.B[i] = next() * 4.0f;
+        }
+    }
+    const SpecularPrefilter::Settings settings;
+
+    double texels = 0.0, samples = 0.0;
+    for (std::uint32_t mip = 1; mip < settings.MipCount; ++mip)
+    {
+        const double size = sourceSize >> mip;
+        texels += 6.0 * size * size;
+        samples += 6.0 * size * size * SpecularPrefilter::BuildSamples(
+            SpecularPrefilter::MipRoughness(mip, settings.MipCount), settings.SampleCount, sourceSize).X.size();
+    }
+
+    // The scalar reference, one direction at a time, on the same mips.
+    const std::vector<CubeMapImage> chain = source.MipChain();
+    const double scalar = Bench::Time([&]
+    {
+        Float3 sum;
+        for (std::uint32_t mip = 1; mip < settings.MipCount; ++mip)
+        {
+            const SpecularPrefilter::SampleSet set = SpecularPrefilter::BuildSamples(
+                SpecularPrefilter::MipRoughness(mip, settings.MipCount), settings.SampleCount, sourceSize);
+            const std::uint32_t size = sourceSize >> mip;
+            for (std::uint32_t face = 0; face < 6; ++face)
+            {
+                for (std::uint32_t y = 0; y < size; ++y)
+                {
+                    for (std::uint32_t x = 0; x < size; ++x)
+                    {
+                        const Float3 d = CubeMapImage::Direction(face, (x + 0.5f) * 2.0f / size - 1.0f, (y + 0.5f) * 2.0f / size - 1.0f);
+                        const float length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+                        const Float3 c = SpecularPrefilter::FilterDirection(chain, set, { d.x / length, d.y / length, d.z / length });
+                        sum = { sum.x + c.x, sum.y + c.y, sum.z + c.z };
+                    }
+                }
+            }
+        }
+        Bench::Consume(&sum);
+    }, 3);
+
+    ThreadPool pool;
+    std::vector<CubeMapImage> mips;
+    const double simd = Bench::Time([&] { mips = SpecularPrefilter::Prefilter(source, settings, nullptr); }, 3);
+    const double pooled = Bench::Time([&] { mips = SpecularPrefilter::Prefilter(source, settings, &pool); }, 3);
+    Bench::Consume(mips.data());
+
+    char label[96];
+    std::snprintf(label, sizeof(label), "256 source, %.0fk texels, scalar", texels / 1000.0);
+    Bench::Report(label, scalar, samples, "samples");
+    Bench::Report("256 source, AVX2", simd, samples, "samples");
+    std::snprintf(label, sizeof(label), "256 source, AVX2 on %u threads", pool.WorkerCount() + 1);
+    Bench::Report(label, pooled, samples, "samples");
+}
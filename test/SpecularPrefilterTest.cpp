@@ -0,0 +1,222 @@
+#include "TestFramework.h"
+#include "EnvironmentMaps.h"
+
+#include "Utility/SpecularPrefilter.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    using EnvironmentMaps::Pi;
+    using EnvironmentMaps::Radiance;
+    using EnvironmentMaps::Normalize;
+    using EnvironmentMaps::TexelNormal;
+
+    // The integral the importance sampled sum estimates: radiance around
+    // n weighted by n.l times the GGX pdf of l, with n = v, by quadrature
+    // over the hemisphere around n.  Rows crowd towards n, where narrow
+    // lobes have all their weight.
+    Float3 GgxReference(const Radiance& radiance, const Float3& n, float roughness)
+    {
+        const double alpha2 = std::pow((double)roughness, 4.0);
+        const Float3 up = std::fabs(n.z) < 0.999f ? Float3{ 0.0f, 0.0f, 1.0f } : Float3{ 1.0f, 0.0f, 0.0f };
+        const Float3 tx = Normalize({ up.y * n.z - up.z * n.y, up.z * n.x - up.x * n.z, up.x * n.y - up.y * n.x });
+        const Float3 ty = { n.y * tx.z - n.z * tx.y, n.z * tx.x - n.x * tx.z, n.x * tx.y - n.y * tx.x };
+
+        const int rows = 1024, columns = 128;
+        double sum[3] = {}, weightSum = 0.0;
+        for (int i = 0; i < rows; ++i)
+        {
+            // theta = s^2 pi / 2, so d theta = s pi ds.
+            const double s = (i + 0.5) / rows;
+            const double theta = s * s * Pi * 0.5;
+            const double cosTheta = std::cos(theta), sinTheta = std::sin(theta);
+            // n.h for the half vector between n and l.
+            const double nh = std::cos(theta * 0.5);
+            const double d = nh * nh * (alpha2 - 1.0) + 1.0;
+            const double ggx = alpha2 / (Pi * d * d);
+            const double weight = cosTheta * ggx * sinTheta * s * Pi / rows * (2.0 * Pi / columns);
+            for (int j = 0; j < columns; ++j)
+            {
+                const double phi = (j + 0.5) * 2.0 * Pi / columns;
+                const float a = (float)(sinTheta * std::cos(phi)), b = (float)(sinTheta * std::sin(phi)), c = (float)cosTheta;
+                const Float3 l = radiance({ tx.x * a + ty.x * b + n.x * c, tx.y * a + ty.y * b + n.y * c, tx.z * a + ty.z * b + n.z * c });
+                sum[0] += l.x * weight;
+                sum[1] += l.y * weight;
+                sum[2] += l.z * weight;
+                weightSum += weight;
+            }
+        }
+        return { (float)(sum[0] / weightSum), (float)(sum[1] / weightSum), (float)(sum[2] / weightSum) };
+    }
+
+    float RelativeError(const Float3& value, const Float3& reference)
+    {
+        return std::max({ std::fabs(value.x - reference.x) / reference.x, std::fabs(value.y - reference.y) / reference.y,
+            std::fabs(value.z - reference.z) / reference.z });
+    }
+}
+
+TEST_CASE(SamplesFollowTheLobe)
+{
+    CHECK_NEAR(SpecularPrefilter::MipRoughness(0, 6), 0.0f, 0.0f);
+    CHECK_NEAR(SpecularPrefilter::MipRoughness(5, 6), 1.0f, 0.0f);
+    CHECK_NEAR(SpecularPrefilter::MipRoughness(0, 1), 0.0f, 0.0f);
+
+    // A mirror reads the reflection vector from mip 0.
+    const SpecularPrefilter::SampleSet mirror = SpecularPrefilter::BuildSamples(0.0f, 64, 128);
+    CHECK(mirror.X.size() == 8);
+    CHECK(mirror.Z[0] == 1.0f && mirror.Weight[0] == 1.0f && mirror.Lod[0] == 0.0f);
+    CHECK(mirror.WeightSum == 1.0f);
+
+    float previousSpread = 0.0f, previousLod = 0.0f;
+    for (float roughness : { 0.2f, 0.4f, 0.6f, 0.8f, 1.0f })
+    {
+        const SpecularPrefilter::SampleSet set = SpecularPrefilter::BuildSamples(roughness, 64, 128);
+        CHECK(set.X.size() % 8 == 0);
+        CHECK(set.X.size() <= 64);
+
+        float weightSum = 0.0f, spread = 0.0f, lod = 0.0f;
+        int used = 0;
+        for (std::size_t s = 0; s < set.X.size(); ++s)
+        {
+            if (set.Weight[s] <= 0.0f)
+                continue;
+            ++used;
+            CHECK_NEAR(set.X[s] * set.X[s] + set.Y[s] * set.Y[s] + set.Z[s] * set.Z[s], 1.0f, 1e-5);
+            CHECK(set.Z[s] > 0.0f);
+            CHECK(set.Weight[s] == set.Z[s]);
+            weightSum += set.Weight[s];
+            spread += 1.0f - set.Z[s];
+            lod += set.Lod[s];
+        }
+        CHECK_NEAR(weightSum, set.WeightSum, 1e-4);
+
+        // Rougher lobes are wider and read blurrier mips.
+        spread /= used;
+        lod /= used;
+        CHECK(spread > previousSpread);
+        CHECK(lod > previousLod);
+        previousSpread = spread;
+        previousLod = lod;
+    }
+}
+
+TEST_CASE(PrefilterMatchesTheGgxIntegral)
+{
+    // A smooth sky: a bright band overhead over a coloured gradient.
+    const Radiance sky = [](const Float3& w)
+    {
+        const float up = std::max(w.y, 0.0f);
+        return Float3{ 1.0f + 0.5f * w.x + 2.0f * up * up, 0.6f + 0.3f * w.z + up, 0.8f - 0.4f * w.x * w.z + 0.5f * up };
+    };
+    SpecularPrefilter::Settings settings;
+    settings.MaxSize = 64;
+    const std::vector<CubeMapImage> mips = SpecularPrefilter::Prefilter(EnvironmentMaps::Make(64, sky), settings, nullptr);
+    CHECK(mips.size() == settings.MipCount);
+
+    // 64 samples leave a few percent of noise at roughness 1; the mip
+    // reads must not add much more bias on top of it.
+    Test::Random random(1);
+    for (std::uint32_t mip = 1; mip < mips.size(); ++mip)
+    {
+        const float roughness = SpecularPrefilter::MipRoughness(mip, settings.MipCount);
+        const std::uint32_t size = mips[mip].Size();
+        CHECK(size == 64u >> mip);
+        float worst = 0.0f;
+        for (int i = 0; i < 12; ++i)
+        {
+            const std::uint32_t face = random.Next32() % 6, x = random.Next32() % size, y = random.Next32() % size;
+            const CubeMapImage::Face& texels = mips[mip].GetFace(face);
+            const std::size_t t = (std::size_t)y * size + x;
+            const Float3 reference = GgxReference(sky, TexelNormal(face, x, y, size), roughness);
+            worst = std::max(worst, RelativeError({ texels.R[t], texels.G[t], texels.B[t] }, reference));
+        }
+        CHECK(worst < 0.06f);
+    }
+}
+
+TEST_CASE(ConstantSkyStaysConstant)
+{
+    const Float3 color = { 0.25f, 1.0f, 3.0f };
+    SpecularPrefilter::Settings settings;
+    settings.MaxSize = 32;
+    const std::vector<CubeMapImage> mips = SpecularPrefilter::Prefilter(EnvironmentMaps::Make(64, [&](const Float3&) { return color; }), settings, nullptr);
+    CHECK(mips[0].Size() == 32);
+    for (const CubeMapImage& mip : mips)
+    {
+        for (std::uint32_t face = 0; face < 6; ++face)
+        {
+            const CubeMapImage::Face& texels = mip.GetFace(face);
+            for (std::size_t i = 0; i < texels.R.size(); ++i)
+            {
+                CHECK_NEAR(texels.R[i], color.x, 1e-5);
+                CHECK_NEAR(texels.G[i], color.y, 1e-5);
+                CHECK_NEAR(texels.B[i], color.z, 1e-5);
+            }
+        }
+    }
+}
+
+TEST_CASE(SimdMatchesScalar)
+{
+    const CubeMapImage source = EnvironmentMaps::Random(32, 2);
+    SpecularPrefilter::Settings settings;
+    settings.MipCount = 5;
+    settings.SampleCount = 37;
+    const std::vector<CubeMapImage> chain = source.MipChain();
+
+    ThreadPool pool(3);
+    const std::vector<CubeMapImage> single = SpecularPrefilter::Prefilter(source, settings, nullptr);
+    const std::vector<CubeMapImage> pooled = SpecularPrefilter::Prefilter(source, settings, &pool);
+    CHECK(single.size() == 5 && pooled.size() == 5);
+
+    for (std::uint32_t mip = 0; mip < single.size(); ++mip)
+    {
+        const std::uint32_t size = single[mip].Size();
+        const SpecularPrefilter::SampleSet samples = SpecularPrefilter::BuildSamples(
+            SpecularPrefilter::MipRoughness(mip, settings.MipCount), settings.SampleCount, source.Size());
+        for (std::uint32_t face = 0; face < 6; ++face)
+        {
+            const CubeMapImage::Face& a = single[mip].GetFace(face);
+            const CubeMapImage::Face& b = pooled[mip].GetFace(face);
+            CHECK(a.R == b.R && a.G == b.G && a.B == b.B);
+            if (mip == 0)
+            {
+                const CubeMapImage::Face& c = chain[0].GetFace(face);
+                CHECK(a.R == c.R && a.G == c.G && a.B == c.B);
+                continue;
+            }
+
+            for (std::uint32_t y = 0; y < size; ++y)
+            {
+                for (std::uint32_t x = 0; x < size; ++x)
+                {
+                    const std::size_t t = (std::size_t)y * size + x;
+                    const Float3 reference = SpecularPrefilter::FilterDirection(chain, samples, TexelNormal(face, x, y, size));
+                    CHECK_NEAR(a.R[t], reference.x, 1e-4);
+                    CHECK_NEAR(a.G[t], reference.y, 1e-4);
+                    CHECK_NEAR(a.B[t], reference.z, 1e-4);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE(KeyFollowsSourceAndSettings)
+{
+    const CubeMapImage source = EnvironmentMaps::Random(8, 3);
+    const SpecularPrefilter::Settings settings;
+    const Hash128 key = SpecularPrefilter::Key(source, settings);
+    CHECK(key == SpecularPrefilter::Key(source, settings));
+
+    SpecularPrefilter::Settings moreSamples = settings;
+    moreSamples.SampleCount *= 2;
+    CHECK(!(key == SpecularPrefilter::Key(source, moreSamples)));
+
+    CubeMapImage changed = source;
+    changed.GetFace(3).G[5] += 1.0f;
+    CHECK(!(key == SpecularPrefilter::Key(changed, settings)));
+}
@@ -0,0 +1,43 @@
+#include "Benchmark.h"
+
+#include "Utility/CubeMapImage.h"
+#include "Utility/SphericalHarmonics.h"
+#include "Utility/ThreadPool.h"
+
+#include <cstdio>
+
+BENCHMARK(ProjectCubeMap)
+{
+    ThreadPool pool;
+    for (std::uint32_t size : { 64u, 256u })
+    {
+        CubeMapImage image(size);
+        std::uint32_t state = 12345;
+        auto next = [&]() { state = state * 1664525u + 1013904223u; return (float)(state >> 8) * (1.0f / 16777216.0f); };
+        for (std::uint32_t face = 0; face < 6; ++face)
+        {
+            CubeMapImage::Face& texels = image.GetFace(face);
+            for (std::size_t i = 0; i < texels.R.size(); ++i)
+            {
+                texels.R[i] = next() * 4.0f;
+                texels.G[i] = next() * 4.0f;
+                texels.B[i] = next() * 4.0f;
+            }
+        }
+
+        SH9Color sh;
+        const double texels = 6.0 * size * size;
+        const double scalar = Bench::Time([&] { sh = SphericalHarmonics::ProjectCubeMapScalar(image); });
+        const double simd = Bench::Time([&] { sh = SphericalHarmonics::ProjectCubeMap(image, nullptr); });
+        const double pooled = Bench::Time([&] { sh = SphericalHarmonics::ProjectCubeMap(image, &pool); });
+        Bench::Consume(&sh);
+
+        char label[96];
+        std::snprintf(label, sizeof(label), "%u^2 x 6 faces, scalar", size);
+        Bench::Report(label, scalar, texels, "texels");
+        std::snprintf(label, sizeof(label), "%u^2 x 6 faces, AVX2", size);
+        Bench::Report(label, simd, texels, "texels");
+        std::snprintf(label, sizeof(label), "%u^2 x 6 faces, AVX2 on %u threads", size, pool.WorkerCount() + 1);
+        Bench::Report(label, pooled, texels, "texels");
+    }
+}
@@ -0,0 +1,206 @@
+#include "TestFramework.h"
+#include "EnvironmentMaps.h"
+
+#include "Utility/CubeMapImage.h"
+#include "Utility/SphericalHarmonics.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    using EnvironmentMaps::Pi;
+    using EnvironmentMaps::Radiance;
+    using EnvironmentMaps::Normalize;
+
+    // What a white Lambertian surface facing n reflects, the cosine
+    // weighted integral of the radiance over pi, by brute force over a
+    // latitude-longitude grid.
+    Float3 IrradianceByQuadrature(const Radiance& radiance, const Float3& n)
+    {
+        const int rows = 256, columns = 512;
+        double sum[3] = {};
+        for (int i = 0; i < rows; ++i)
+        {
+            const double theta = (i + 0.5) * Pi / rows;
+            const double solidAngle = std::sin(theta) * (Pi / rows) * (2.0 * Pi / columns);
+            for (int j = 0; j < columns; ++j)
+            {
+                const double phi = (j + 0.5) * 2.0 * Pi / columns;
+                const Float3 w = { (float)(std::sin(theta) * std::cos(phi)), (float)std::cos(theta), (float)(std::sin(theta) * std::sin(phi)) };
+                const double cosine = w.x * n.x + w.y * n.y + w.z * n.z;
+                if (cosine <= 0.0)
+                    continue;
+                const Float3 l = radiance(w);
+                sum[0] += l.x * cosine * solidAngle;
+                sum[1] += l.y * cosine * solidAngle;
+                sum[2] += l.z * cosine * solidAngle;
+            }
+        }
+        return { (float)(sum[0] / Pi), (float)(sum[1] / Pi), (float)(sum[2] / Pi) };
+    }
+
+    Float3 RandomDirection(Test::Random& random)
+    {
+        for (;;)
+        {
+            const Float3 d = { random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f) };
+            const float lengthSq = d.x * d.x + d.y * d.y + d.z * d.z;
+            if (lengthSq > 0.01f && lengthSq <= 1.0f)
+                return Normalize(d);
+        }
+    }
+
+    bool Equal(const SH9Color& a, const SH9Color& b)
+    {
+        for (int k = 0; k < 9; ++k)
+        {
+            if (a.C[k].x != b.C[k].x || a.C[k].y != b.C[k].y || a.C[k].z != b.C[k].z)
+                return false;
+        }
+        return true;
+    }
+}
+
+TEST_CASE(ConstantSkyGivesItsValue)
+{
+    const Float3 color = { 0.2f, 0.5f, 1.5f };
+    const SH9Color radiance = SphericalHarmonics::ProjectCubeMap(EnvironmentMaps::Make(32, [&](const Float3&) { return color; }), nullptr);
+    const SH9Color constant = SphericalHarmonics::Constant(color);
+    for (int k = 0; k < 9; ++k)
+    {
+        CHECK_NEAR(radiance.C[k].x, constant.C[k].x, 1e-4);
+        CHECK_NEAR(radiance.C[k].y, constant.C[k].y, 1e-4);
+        CHECK_NEAR(radiance.C[k].z, constant.C[k].z, 1e-4);
+    }
+
+    // A white surface under a uniform sky reflects the sky, whichever way
+    // it faces.
+    const SH9Color irradiance = SphericalHarmonics::IrradianceFromRadiance(radiance);
+    Test::Random random(1);
+    for (int i = 0; i < 100; ++i)
+    {
+        const Float3 e = SphericalHarmonics::Evaluate(irradiance, RandomDirection(random));
+        CHECK_NEAR(e.x, color.x, 1e-4);
+        CHECK_NEAR(e.y, color.y, 1e-4);
+        CHECK_NEAR(e.z, color.z, 1e-4);
+    }
+}
+
+TEST_CASE(LowOrderSkiesAreExact)
+{
+    // Radiance made of bands 0 to 2 only: projection and the cosine
+    // convolution are exact, up to the cube map's sampling.
+    const Radiance sky = [](const Float3& w)
+    {
+        const float v = 1.0f + 0.6f * w.y - 0.3f * w.x + 0.5f * w.z * w.z + 0.4f * w.x * w.y;
+        return Float3{ v, 0.5f * v, 2.0f - w.y };
+    };
+    const CubeMapImage image = EnvironmentMaps::Make(64, sky);
+    const SH9Color radiance = SphericalHarmonics::ProjectCubeMap(image, nullptr);
+    const SH9Color irradiance = SphericalHarmonics::IrradianceFromRadiance(radiance);
+
+    Test::Random random(2);
+    for (int i = 0; i < 40; ++i)
+    {
+        const Float3 n = RandomDirection(random);
+        // The radiance comes back as it was.
+        const Float3 l = SphericalHarmonics::Evaluate(radiance, n), expected = sky(n);
+        CHECK_NEAR(l.x, expected.x, 2e-3);
+        CHECK_NEAR(l.y, expected.y, 2e-3);
+        CHECK_NEAR(l.z, expected.z, 2e-3);
+
+        const Float3 e = SphericalHarmonics::Evaluate(irradiance, n), reference = IrradianceByQuadrature(sky, n);
+        CHECK_NEAR(e.x, reference.x, 2e-3);
+        CHECK_NEAR(e.y, reference.y, 2e-3);
+        CHECK_NEAR(e.z, reference.z, 2e-3);
+    }
+
+    // Closed forms: L = z gives E = 2 z / 3, L = z^2 gives 1/4 z^2 + 1/4.
+    const SH9Color linear = SphericalHarmonics::IrradianceFromRadiance(SphericalHarmonics::ProjectCubeMap(
+        EnvironmentMaps::Make(64, [](const Float3& w) { return Float3{ w.z, w.z * w.z, 0.0f }; }), nullptr));
+    for (int i = 0; i < 40; ++i)
+    {
+        const Float3 n = RandomDirection(random);
+        const Float3 e = SphericalHarmonics::Evaluate(linear, n);
+        CHECK_NEAR(e.x, 2.0f / 3.0f * n.z, 1e-3);
+        CHECK_NEAR(e.y, 0.25f * n.z * n.z + 0.25f, 1e-3);
+    }
+}
+
+TEST_CASE(SunAndSkyIrradianceIsClose)
+{
+    // A bright sky above a dark ground with a sun lobe: not band limited,
+    // so nine coefficients only approximate the irradiance, to a few
+    // percent of the brightest value for smooth lighting like this.
+    const Float3 sun = Normalize({ 0.4f, 0.7f, 0.3f });
+    const Radiance sky = [&](const Float3& w)
+    {
+        const float up = std::max(w.y, 0.0f);
+        const float lobe = std::pow(std::max(w.x * sun.x + w.y * sun.y + w.z * sun.z, 0.0f), 8.0f);
+        return Float3{ 0.1f + 0.8f * up + 3.0f * lobe, 0.1f + 0.9f * up + 2.5f * lobe, 0.1f + 1.2f * up + 2.0f * lobe };
+    };
+    const SH9Color irradiance = SphericalHarmonics::IrradianceFromRadiance(
+        SphericalHarmonics::ProjectCubeMap(EnvironmentMaps::Make(64, sky), nullptr));
+
+    Test::Random random(3);
+    float brightest = 0.0f, worst = 0.0f;
+    for (int i = 0; i < 30; ++i)
+    {
+        const Float3 n = RandomDirection(random);
+        const Float3 e = SphericalHarmonics::Evaluate(irradiance, n), reference = IrradianceByQuadrature(sky, n);
+        brightest = std::max({ brightest, reference.x, reference.y, reference.z });
+        worst = std::max({ worst, std::fabs(e.x - reference.x), std::fabs(e.y - reference.y), std::fabs(e.z - reference.z) });
+    }
+    CHECK(worst < 0.05f * brightest);
+}
+
+TEST_CASE(ProjectionIsTheSameEveryWay)
+{
+    // A size that is not a multiple of eight runs the scalar tail too.
+    for (std::uint32_t size : { 16u, 37u })
+    {
+        const CubeMapImage image = EnvironmentMaps::Random(size, size);
+
+        ThreadPool pool(3);
+        const SH9Color single = SphericalHarmonics::ProjectCubeMap(image, nullptr);
+        CHECK(Equal(single, SphericalHarmonics::ProjectCubeMap(image, &pool)));
+        CHECK(Equal(single, SphericalHarmonics::ProjectCubeMap(image, &pool)));
+
+        const SH9Color scalar = SphericalHarmonics::ProjectCubeMapScalar(image);
+        for (int k = 0; k < 9; ++k)
+        {
+            CHECK_NEAR(single.C[k].x, scalar.C[k].x, 1e-4);
+            CHECK_NEAR(single.C[k].y, scalar.C[k].y, 1e-4);
+            CHECK_NEAR(single.C[k].z, scalar.C[k].z, 1e-4);
+        }
+    }
+}
+
+TEST_CASE(ShaderConstantsEvaluateTheSame)
+{
+    Test::Random random(4);
+    SH9Color sh;
+    for (Float3& c : sh.C)
+        c = { random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f) };
+    Float4 c[9];
+    SphericalHarmonics::ToShaderConstants(sh, c);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        const Float3 n = RandomDirection(random);
+        // The polynomial Common.hlsl evaluates.
+        float value[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            auto at = [&](int j) { return k == 0 ? c[j].x : k == 1 ? c[j].y : c[j].z; };
+            value[k] = at(0) + at(1) * n.y + at(2) * n.z + at(3) * n.x + at(4) * n.x * n.y + at(5) * n.y * n.z +
+                at(6) * (3.0f * n.z * n.z - 1.0f) + at(7) * n.x * n.z + at(8) * (n.x * n.x - n.y * n.y);
+        }
+        const Float3 expected = SphericalHarmonics::Evaluate(sh, n);
+        CHECK_NEAR(value[0], expected.x, 1e-5);
+        CHECK_NEAR(value[1], expected.y, 1e-5);
+        CHECK_NEAR(value[2], expected.z, 1e-5);
+    }
+}
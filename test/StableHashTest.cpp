@@ -0,0 +1,190 @@
+#include "TestFramework.h"
+#include "FileCheck.h"
+
+#include "Structure/PipelineCacheFile.h"
+#include "Utility/StableHash.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_set>
+
+namespace
+{
+    std::string TempPath(const char* name)
+    {
+        return (std::filesystem::temp_directory_path() / "CreepEngineTests" / name).string();
+    }
+
+    std::vector<std::uint8_t> Blob(std::size_t size, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        std::vector<std::uint8_t> blob(size);
+        for (std::uint8_t& b : blob)
+            b = (std::uint8_t)random.Next32();
+        return blob;
+    }
+}
+
+TEST_CASE(HashesMatchPinnedValues)
+{
+    // Cache files written by earlier builds are looked up with these, so a
+    // change here throws every pipeline library away.
+    CHECK(HashBytes(nullptr, 0).ToHex() == "7782146a9d6f6b737423d0ef17e9d50f");
+    CHECK(HashBytes("abc", 3).ToHex() == "e310447eba0a9a64673f597c20b39e4c");
+    CHECK(HashBytes("The quick brown fox jumps over the lazy dog", 43).ToHex() == "b09cced6b7cc5748f4ac1aa31079fa77");
+    CHECK(HashBytes("abc", 3, 42).ToHex() == "9d1bc5ebbeee00430781fba5db4d8cba");
+
+    StableHasher hasher;
+    hasher.AddString("PSO");
+    hasher.Add(std::uint32_t(7));
+    CHECK(hasher.Finish().ToHex() == "2b22b2844eab41a0c03aa8e0f8c6d071");
+}
+
+TEST_CASE(SplittingTheInputDoesNotMatter)
+{
+    const std::vector<std::uint8_t> data = Blob(257, 36);
+    const Hash128 whole = HashBytes(data.data(), data.size());
+
+    Test::Random random(7);
+    for (int attempt = 0; attempt < 200; ++attempt)
+    {
+        StableHasher hasher;
+        std::size_t offset = 0;
+        while (offset < data.size())
+        {
+            const std::size_t size = std::min<std::size_t>(random.Next32() % 20, data.size() - offset);
+            hasher.AddBytes(data.data() + offset, size);
+            offset += size;
+        }
+        CHECK(hasher.Finish() == whole);
+    }
+}
+
+TEST_CASE(NearInputsHashApart)
+{
+    // Trailing zeros, string boundaries, null against empty and the seed
+    // all change the hash.
+    const std::uint8_t zeros[16] = {};
+    std::unordered_set<std::string> seen;
+    for (std::size_t size = 0; size <= 16; ++size)
+        CHECK(seen.insert(HashBytes(zeros, size).ToHex()).second);
+
+    StableHasher ab, a;
+    ab.AddString("ab");
+    ab.AddString("c");
+    a.AddString("a");
+    a.AddString("bc");
+    CHECK(!(ab.Finish() == a.Finish()));
+
+    StableHasher null, empty;
+    null.AddString((const char*)nullptr);
+    empty.AddString("");
+    CHECK(!(null.Finish() == empty.Finish()));
+
+    StableHasher fromPointer, fromString;
+    fromPointer.AddString("shader");
+    fromString.AddString(std::string("shader"));
+    CHECK(fromPointer.Finish() == fromString.Finish());
+
+    CHECK(!(HashBytes("abc", 3, 1) == HashBytes("abc", 3, 2)));
+}
+
+TEST_CASE(NoCollisionsInAMillionKeys)
+{
+    // Pipeline descriptions mostly differ in a few bits of a few fields:
+    // counters and single bit flips of a fixed record.  Either half of the
+    // hash alone should keep them apart.
+    std::vector<std::uint64_t> lo, hi;
+    lo.reserve(1 << 20);
+    hi.reserve(1 << 20);
+
+    for (std::uint32_t i = 0; i < (1u << 19); ++i)
+    {
+        const Hash128 h = HashBytes(&i, sizeof(i));
+        lo.push_back(h.Lo);
+        hi.push_back(h.Hi);
+    }
+
+    std::vector<std::uint8_t> record = Blob(64, 99);
+    for (std::uint32_t bit = 0; bit < 64 * 8; ++bit)
+    {
+        record[bit / 8] ^= std::uint8_t(1u << (bit % 8));
+        for (std::uint32_t value = 0; value < 1024; ++value)
+        {
+            StableHasher hasher;
+            hasher.AddBytes(record.data(), record.size());
+            hasher.Add(value);
+            const Hash128 h = hasher.Finish();
+            lo.push_back(h.Lo);
+            hi.push_back(h.Hi);
+        }
+        record[bit / 8] ^= std::uint8_t(1u << (bit % 8));
+    }
+
+    for (std::vector<std::uint64_t>* halves : { &lo, &hi })
+    {
+        std::sort(halves->begin(), halves->end());
+        CHECK(std::adjacent_find(halves->begin(), halves->end()) == halves->end());
+    }
+}
+
+TEST_CASE(CacheFileRoundTrips)
+{
+    const std::string path = TempPath("RoundTrip.bin");
+    const std::vector<std::uint8_t> blob = Blob(5000, 1);
+
+    CHECK(PipelineCacheFile::Write(path, 17, blob.data(), blob.size()));
+    CHECK(!FileCheck::HasTempFiles(path));
+
+    std::vector<std::uint8_t> read;
+    CHECK(PipelineCacheFile::Read(path, 17, read));
+    CHECK(read == blob);
+
+    // Another content key is a different cache.
+    CHECK(!PipelineCacheFile::Read(path, 18, read));
+    CHECK(read.empty());
+
+    // An empty library is still a valid file.
+    CHECK(PipelineCacheFile::Write(path, 17, nullptr, 0));
+    CHECK(PipelineCacheFile::Read(path, 17, read));
+    CHECK(read.empty());
+
+    std::filesystem::remove(path);
+    CHECK(!PipelineCacheFile::Read(path, 17, read));
+}
+
+TEST_CASE(DamagedCacheFilesAreMissing)
+{
+    const std::string path = TempPath("Damaged.bin");
+    const std::vector<std::uint8_t> blob = Blob(1000, 2);
+    std::vector<std::uint8_t> read;
+
+    // One flipped bit in the blob.
+    CHECK(PipelineCacheFile::Write(path, 5, blob.data(), blob.size()));
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(24 + 500);
+        file.put((char)(blob[500] ^ 0x10));
+    }
+    CHECK(!PipelineCacheFile::Read(path, 5, read));
+    CHECK(read.empty());
+
+    // Cut short.
+    CHECK(PipelineCacheFile::Write(path, 5, blob.data(), blob.size()));
+    std::filesystem::resize_file(path, 24 + 600);
+    CHECK(!PipelineCacheFile::Read(path, 5, read));
+
+    // Header only, claiming a huge blob.
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        const std::uint32_t words[2] = { PipelineCacheFile::Magic, PipelineCacheFile::FormatVersion };
+        const std::uint64_t rest[2] = { 5, ~0ull };
+        file.write(reinterpret_cast<const char*>(words), sizeof(words));
+        file.write(reinterpret_cast<const char*>(rest), sizeof(rest));
+    }
+    CHECK(!PipelineCacheFile::Read(path, 5, read));
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,128 @@
+#include "TestFramework.h"
+
+#include "MockCommandSink.h"
+
+namespace
+{
+    void* Object(std::uintptr_t id) { return reinterpret_cast<void*>(0x1000 * id); }
+
+    // What DrawBatches records per batch.
+    void DrawBatch(CommandStateCache& cache, std::uintptr_t pso, std::uint64_t vb, std::uint32_t baseInstance, std::uint64_t material)
+    {
+        cache.SetPipelineState(Object(pso));
+        cache.SetVertexBuffer(0, { vb, 1024, 32 });
+        cache.SetIndexBuffer({ vb + 4096, 512, 42 });
+        cache.SetPrimitiveTopology(4);
+        cache.SetGraphicsRoot32BitConstant(0, baseInstance, 0);
+        cache.SetGraphicsRootConstantBufferView(2, material);
+        cache.DrawIndexedInstanced(36, 10, 0, 0, 0);
+    }
+}
+
+TEST_CASE(RepeatedStateIsDroppedAndCounted)
+{
+    MockCommandSink sink;
+    CommandStateCache cache(&sink);
+    void* heaps[1] = { Object(9) };
+
+    cache.SetGraphicsRootSignature(Object(1));
+    cache.SetDescriptorHeaps(1, heaps);
+    for (std::uint32_t batch = 0; batch < 100; ++batch)
+        DrawBatch(cache, 2, 0x10000, batch * 10, 0x20000);
+
+    // Only the base instance changes between batches.
+    CHECK(sink.Calls(StateCall::PipelineState) == 1);
+    CHECK(sink.Calls(StateCall::VertexBuffer) == 1);
+    CHECK(sink.Calls(StateCall::IndexBuffer) == 1);
+    CHECK(sink.Calls(StateCall::PrimitiveTopology) == 1);
+    CHECK(sink.Calls(StateCall::RootConstantBufferView) == 1);
+    CHECK(sink.Calls(StateCall::RootConstant) == 100);
+    CHECK(sink.Calls(StateCall::Draw) == 100);
+
+    const StateCacheStats& stats = cache.Stats();
+    CHECK(stats.TotalIssued() == sink.TotalCalls());
+    CHECK(stats.Elided[(int)StateCall::PipelineState] == 99);
+    CHECK(stats.TotalElided() == 5 * 99);
+
+    // Same base instance twice in a row is dropped too.
+    cache.SetGraphicsRoot32BitConstant(0, 990, 0);
+    CHECK(sink.Calls(StateCall::RootConstant) == 100);
+}
+
+TEST_CASE(NewRootSignatureForgetsRootArguments)
+{
+    MockCommandSink sink;
+    CommandStateCache cache(&sink);
+    cache.SetGraphicsRootSignature(Object(1));
+    cache.SetGraphicsRootConstantBufferView(1, 0x100);
+    cache.SetGraphicsRootShaderResourceView(5, 0x200);
+    cache.SetGraphicsRoot32BitConstant(0, 7, 0);
+
+    cache.SetGraphicsRootSignature(Object(1));
+    cache.SetGraphicsRootConstantBufferView(1, 0x100);
+    CHECK(sink.Calls(StateCall::RootSignature) == 1);
+    CHECK(sink.Calls(StateCall::RootConstantBufferView) == 1);
+
+    cache.SetGraphicsRootSignature(Object(2));
+    cache.SetGraphicsRootConstantBufferView(1, 0x100);
+    cache.SetGraphicsRootShaderResourceView(5, 0x200);
+    cache.SetGraphicsRoot32BitConstant(0, 7, 0);
+    CHECK(sink.Calls(StateCall::RootConstantBufferView) == 2);
+    CHECK(sink.Calls(StateCall::RootShaderResourceView) == 2);
+    CHECK(sink.Calls(StateCall::RootConstant) == 2);
+
+    // A parameter switching kind is never taken for the same binding.
+    cache.SetGraphicsRootShaderResourceView(1, 0x100);
+    CHECK(sink.Calls(StateCall::RootShaderResourceView) == 3);
+}
+
+TEST_CASE(NewHeapsForgetDescriptorTablesOnly)
+{
+    MockCommandSink sink;
+    CommandStateCache cache(&sink);
+    void* heapsA[2] = { Object(1), Object(2) };
+    void* heapsB[2] = { Object(3), Object(2) };
+
+    cache.SetDescriptorHeaps(2, heapsA);
+    cache.SetGraphicsRootDescriptorTable(3, 0x40);
+    cache.SetGraphicsRootConstantBufferView(1, 0x100);
+    cache.SetDescriptorHeaps(2, heapsA);
+    cache.SetGraphicsRootDescriptorTable(3, 0x40);
+    CHECK(sink.Calls(StateCall::DescriptorHeaps) == 1);
+    CHECK(sink.Calls(StateCall::RootDescriptorTable) == 1);
+
+    cache.SetDescriptorHeaps(2, heapsB);
+    cache.SetGraphicsRootDescriptorTable(3, 0x40);
+    cache.SetGraphicsRootConstantBufferView(1, 0x100);
+    CHECK(sink.Calls(StateCall::DescriptorHeaps) == 2);
+    CHECK(sink.Calls(StateCall::RootDescriptorTable) == 2);
+    CHECK(sink.Calls(StateCall::RootConstantBufferView) == 1);
+}
+
+TEST_CASE(ResetForgetsEverything)
+{
+    MockCommandSink sink;
+    CommandStateCache cache(&sink);
+    DrawBatch(cache, 2, 0x10000, 0, 0x20000);
+    const std::uint32_t before = sink.TotalCalls();
+    cache.Reset();
+    DrawBatch(cache, 2, 0x10000, 0, 0x20000);
+    CHECK(sink.TotalCalls() == 2 * before);
+
+    // Slots and parameters beyond what the cache shadows always go through.
+    cache.SetVertexBuffer(CommandStateCache::MaxVertexBuffers, { 1, 2, 3 });
+    cache.SetVertexBuffer(CommandStateCache::MaxVertexBuffers, { 1, 2, 3 });
+    cache.SetGraphicsRootConstantBufferView(CommandStateCache::MaxRootParameters, 5);
+    cache.SetGraphicsRootConstantBufferView(CommandStateCache::MaxRootParameters, 5);
+    CHECK(sink.Calls(StateCall::VertexBuffer) == 4);
+    CHECK(sink.Calls(StateCall::RootConstantBufferView) == 4);
+}
+
+TEST_CASE(NullPipelineIsNeverElided)
+{
+    MockCommandSink sink;
+    CommandStateCache cache(&sink);
+    cache.SetPipelineState(nullptr);
+    cache.SetPipelineState(nullptr);
+    CHECK(sink.Calls(StateCall::PipelineState) == 2);
+}
@@ -0,0 +1,91 @@
+#include "TestFramework.h"
+#include "FileCheck.h"
+
+#include "Structure/PipelineCacheFile.h"
+#include "Structure/ShaderCache.h"
+#include "Utility/TempFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE(PathsAreUniquePerCall)
+{
+    const std::string path = "cache/ab.cso";
+    std::mutex mutex;
+    std::set<std::string> paths;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&]
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                const std::string temp = TempFile::UniquePath(path);
+                std::lock_guard<std::mutex> lock(mutex);
+                paths.insert(temp);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    CHECK(paths.size() == 400);
+
+    // Beside the target, so the rename stays on one volume.
+    for (const std::string& temp : paths)
+    {
+        CHECK(temp.compare(0, path.size() + 1, path + ".") == 0);
+        CHECK(temp.compare(temp.size() - 4, 4, ".tmp") == 0);
+    }
+}
+
+TEST_CASE(RacingWritersLeaveAWholeFile)
+{
+    // Writers of the same key at once, as the bake step and a running app
+    // can be: whichever rename lands last, the file is one writer's whole.
+    const std::filesystem::path root = std::filesystem::temp_directory_path() / "CreepEngineTests" / "TempFile";
+    std::filesystem::remove_all(root);
+    const std::string shaderPath = (root / "shader.cso").generic_string();
+    const std::string pipelinePath = (root / "pipeline.bin").generic_string();
+
+    const int writerCount = 4;
+    std::vector<std::vector<char>> contents(writerCount);
+    for (int w = 0; w < writerCount; ++w)
+        contents[w].assign(200000 + w * 1000, (char)('a' + w));
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writerCount; ++w)
+    {
+        threads.emplace_back([&, w]
+        {
+            for (int i = 0; i < 20; ++i)
+            {
+                ShaderCache::WriteFile(shaderPath, contents[w].data(), contents[w].size());
+                PipelineCacheFile::Write(pipelinePath, 1, contents[w].data(), contents[w].size());
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    std::ifstream fin(shaderPath, std::ios::binary);
+    const std::vector<char> written((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+    bool whole = false;
+    for (const std::vector<char>& content : contents)
+        whole = whole || written == content;
+    CHECK(whole);
+    CHECK(!FileCheck::HasTempFiles(shaderPath));
+
+    std::vector<std::uint8_t> blob;
+    CHECK(PipelineCacheFile::Read(pipelinePath, 1, blob));
+    CHECK(!FileCheck::HasTempFiles(pipelinePath));
+
+    fin.close();
+    std::error_code ec;
+    std::filesystem::remove_all(root, ec);
+}
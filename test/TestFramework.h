@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Just enough of a test runner for the portable parts of the engine.  A
+// TEST_CASE registers itself at static initialization; CHECK records a
+// failure and carries on, so one run reports every broken check.
+namespace Test
+{
+    struct Case
+    {
+        const char* File;
+        const char* Name;
+        void (*Run)();
+    };
+
+    std::vector<Case>& Registry();
+    void Fail(const char* file, int line, const char* expression);
+
+    struct Registration
+    {
+        Registration(const char* file, const char* name, void (*run)())
+        {
+            Registry().push_back({ file, name, run });
+        }
+    };
+
+    // Deterministic numbers for test data, the same on every platform.
+    class Random
+    {
+    public:
+        explicit Random(std::uint64_t seed) : mState(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+        std::uint64_t Next64()
+        {
+            mState ^= mState << 13;
+            mState ^= mState >> 7;
+            mState ^= mState << 17;
+            return mState;
+        }
+        std::uint32_t Next32() { return (std::uint32_t)(Next64() >> 32); }
+        // Uniform in [min, max).
+        float Float(float min, float max) { return min + (max - min) * (float)(Next64() >> 40) * (1.0f / 16777216.0f); }
+
+    private:
+        std::uint64_t mState;
+    };
+}
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static Test::Registration name##Registration(__FILE__, #name, name); \
+    static void name()
+
+#define CHECK(expression) \
+    do { if (!(expression)) Test::Fail(__FILE__, __LINE__, #expression); } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+    do { if (!(std::fabs((double)(a) - (double)(b)) <= (double)(tolerance))) \
+        Test::Fail(__FILE__, __LINE__, #a " near " #b); } while (0)
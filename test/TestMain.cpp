@@ -0,0 +1,50 @@
+#include "TestFramework.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    int gFailures = 0;
+}
+
+std::vector<Test::Case>& Test::Registry()
+{
+    static std::vector<Case> cases;
+    return cases;
+}
+
+void Test::Fail(const char* file, int line, const char* expression)
+{
+    std::printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+    ++gFailures;
+}
+
+// tests [filter]: runs the cases whose source file name contains filter,
+// all of them without one.  Exits non-zero if any check failed.
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    int run = 0;
+    int failedCases = 0;
+    for (const Test::Case& c : Test::Registry())
+    {
+        if (filter != nullptr && std::strstr(c.File, filter) == nullptr)
+            continue;
+
+        const int failuresBefore = gFailures;
+        c.Run();
+        ++run;
+        if (gFailures != failuresBefore)
+        {
+            ++failedCases;
+            std::printf("FAIL %s\n", c.Name);
+        }
+        else
+            std::printf("ok   %s\n", c.Name);
+    }
+
+    std::printf("%d of %d cases passed\n", run - failedCases, run);
+    return run == 0 || failedCases != 0 ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+#include "TestFramework.h"
+
+#include "Utility/ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+
+TEST_CASE(ParallelForVisitsEveryIndexOnce)
+{
+    ThreadPool pool(3);
+    for (std::uint32_t count : { 1u, 2u, 7u, 1000u })
+    {
+        std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[count]);
+        for (std::uint32_t i = 0; i < count; ++i)
+            visits[i] = 0;
+
+        std::atomic<bool> badExecutor{ false };
+        pool.ParallelFor(count, [&](std::uint32_t index, std::uint32_t executor)
+        {
+            ++visits[index];
+            if (executor >= pool.ExecutorCount())
+                badExecutor = true;
+        });
+
+        bool once = true;
+        for (std::uint32_t i = 0; i < count; ++i)
+            once = once && visits[i] == 1;
+        CHECK(once);
+        CHECK(!badExecutor);
+    }
+}
+
+TEST_CASE(RangesCoverTheLoop)
+{
+    ThreadPool pool(2);
+    std::atomic<std::uint64_t> sum{ 0 };
+    std::atomic<bool> oversized{ false };
+    pool.ParallelForRange(10007, 64, [&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+    {
+        if (end - begin > 64)
+            oversized = true;
+        for (std::uint32_t i = begin; i < end; ++i)
+            sum += i;
+    });
+    CHECK(sum == 10006ull * 10007ull / 2);
+    CHECK(!oversized);
+}
+
+TEST_CASE(NestedLoopsFinish)
+{
+    ThreadPool pool(2);
+    std::atomic<int> inner{ 0 };
+    pool.ParallelFor(8, [&](std::uint32_t, std::uint32_t)
+    {
+        pool.ParallelFor(8, [&](std::uint32_t, std::uint32_t) { ++inner; });
+    });
+    CHECK(inner == 64);
+}
+
+TEST_CASE(SubmittedTasksRunBeforeWaitIdleReturns)
+{
+    ThreadPool pool(2);
+    std::atomic<int> done{ 0 };
+    for (int i = 0; i < 100; ++i)
+        pool.Submit([&] { ++done; });
+    pool.WaitIdle();
+    CHECK(done == 100);
+    CHECK(pool.CurrentExecutor() == pool.WorkerCount());
+}
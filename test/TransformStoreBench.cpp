@@ -0,0 +1,45 @@
+#include "Benchmark.h"
+
+#include "Utility/TransformStore.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    struct alignas(32) InstanceRecord
+    {
+        std::uint8_t Bytes[TransformStore::InstanceByteSize];
+    };
+}
+
+BENCHMARK(UploadTransforms)
+{
+    for (std::uint32_t count : { 100000u, 1000000u })
+    {
+        TransformStore store(1);
+        Float4x4 world = Float4x4::Identity();
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            world.m[3][0] = (float)i;
+            store.Add(world, Float4x4::Identity(), i);
+        }
+        std::vector<InstanceRecord> buffer(count);
+
+        // Every object moved, then one in sixteen.
+        const double all = Bench::Time([&] { store.Upload(0, buffer[0].Bytes, true); });
+        const double sparse = Bench::Time([&]
+        {
+            for (std::uint32_t i = 0; i < count; i += 16)
+                store.SetMaterialIndex(i, i);
+            store.Upload(0, buffer[0].Bytes, false);
+        });
+        Bench::Consume(buffer.data());
+
+        char label[64];
+        std::snprintf(label, sizeof(label), "%uk objects, all dirty", count / 1000);
+        Bench::Report(label, all, count, "objects");
+        std::snprintf(label, sizeof(label), "%uk objects, 1/16 dirty", count / 1000);
+        Bench::Report(label, sparse, count / 16, "objects");
+    }
+}
@@ -0,0 +1,138 @@
+#include "TestFramework.h"
+
+#include "Utility/TransformStore.h"
+
+#include <cstring>
+
+namespace
+{
+    // Instance records need 32 byte alignment for the streaming stores.
+    struct alignas(32) InstanceRecord
+    {
+        std::uint8_t Bytes[TransformStore::InstanceByteSize];
+    };
+
+    Float4x4 RandomMatrix(Test::Random& random)
+    {
+        Float4x4 m;
+        for (auto& row : m.m)
+            for (float& e : row)
+                e = random.Float(-10.0f, 10.0f);
+        return m;
+    }
+
+    // The record the shader expects for one object: both matrices
+    // transposed for HLSL, then the material index.
+    bool RecordMatches(const std::uint8_t* record, const Float4x4& world, const Float4x4& texTransform, std::uint32_t material)
+    {
+        float floats[32];
+        std::uint32_t index;
+        std::memcpy(floats, record, sizeof(floats));
+        std::memcpy(&index, record + TransformStore::MaterialIndexOffset, sizeof(index));
+        for (int r = 0; r < 4; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                if (floats[c * 4 + r] != world.m[r][c] || floats[16 + c * 4 + r] != texTransform.m[r][c])
+                    return false;
+            }
+        }
+        return index == material;
+    }
+}
+
+TEST_CASE(StreamedAndScalarKernelsAgree)
+{
+    Test::Random random(1);
+    MatrixKernels::MatrixLanes world, texTransform;
+    std::uint32_t material[8];
+    for (int e = 0; e < 16; ++e)
+    {
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            world[e][lane] = random.Float(-1.0f, 1.0f);
+            texTransform[e][lane] = random.Float(-1.0f, 1.0f);
+        }
+    }
+    for (auto& m : material)
+        m = random.Next32();
+
+    std::vector<InstanceRecord> streamed(8), stored(8);
+    std::memset(streamed.data(), 0xcd, 8 * sizeof(InstanceRecord));
+    std::memset(stored.data(), 0xab, 8 * sizeof(InstanceRecord));
+    MatrixKernels::StreamInstances8(world, texTransform, material, streamed[0].Bytes);
+    MatrixKernels::StoreInstances(world, texTransform, material, 0xffu, stored[0].Bytes);
+    CHECK(std::memcmp(streamed.data(), stored.data(), 8 * sizeof(InstanceRecord)) == 0);
+
+    // Lanes outside the mask are left alone.
+    std::vector<InstanceRecord> partial(8);
+    std::memset(partial.data(), 0xab, 8 * sizeof(InstanceRecord));
+    MatrixKernels::StoreInstances(world, texTransform, material, 0x05u, partial[0].Bytes);
+    CHECK(std::memcmp(partial[0].Bytes, stored[0].Bytes, sizeof(InstanceRecord)) == 0);
+    CHECK(partial[1].Bytes[0] == 0xab && partial[1].Bytes[159] == 0xab);
+    CHECK(std::memcmp(partial[2].Bytes, stored[2].Bytes, sizeof(InstanceRecord)) == 0);
+}
+
+TEST_CASE(GettersReturnWhatWasSet)
+{
+    Test::Random random(2);
+    TransformStore store;
+    std::vector<Float4x4> worlds;
+    for (int i = 0; i < 19; ++i)
+    {
+        worlds.push_back(RandomMatrix(random));
+        CHECK(store.Add(worlds.back(), RandomMatrix(random), i) == (std::uint32_t)i);
+    }
+    CHECK(store.Count() == 19);
+
+    for (int i = 0; i < 19; ++i)
+    {
+        const Float4x4 w = store.GetWorld(i);
+        CHECK(std::memcmp(&w, &worlds[i], sizeof(Float4x4)) == 0);
+        const Float3 t = store.GetTranslation(i);
+        CHECK(t.x == worlds[i].m[3][0] && t.y == worlds[i].m[3][1] && t.z == worlds[i].m[3][2]);
+        CHECK(store.GetMaterialIndex(i) == (std::uint32_t)i);
+    }
+}
+
+TEST_CASE(UploadWritesEveryObjectOncePerFrameResource)
+{
+    Test::Random random(3);
+    const std::uint32_t count = 1000;
+    TransformStore store(2);
+    std::vector<Float4x4> worlds, texTransforms;
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        worlds.push_back(RandomMatrix(random));
+        texTransforms.push_back(RandomMatrix(random));
+        store.Add(worlds[i], texTransforms[i], i * 7);
+    }
+
+    std::vector<InstanceRecord> frames[2] = { std::vector<InstanceRecord>(count), std::vector<InstanceRecord>(count) };
+    for (std::uint32_t frame = 0; frame < 2; ++frame)
+    {
+        CHECK(store.DirtyCount(frame) == count);
+        CHECK(store.Upload(frame, frames[frame][0].Bytes, false) == count * TransformStore::InstanceByteSize);
+        CHECK(store.Upload(frame, frames[frame][0].Bytes, false) == 0);
+    }
+    for (std::uint32_t i = 0; i < count; ++i)
+        CHECK(RecordMatches(frames[1][i].Bytes, worlds[i], texTransforms[i], i * 7));
+
+    // A sparse change goes through the scalar kernel and only touches its
+    // own record; a mostly dirty block is streamed whole.
+    worlds[500] = RandomMatrix(random);
+    store.SetWorld(500, worlds[500]);
+    for (std::uint32_t i = 16; i < 23; ++i)
+        store.SetMaterialIndex(i, i * 7);
+    std::memset(frames[0][501].Bytes, 0, sizeof(InstanceRecord));
+    CHECK(store.Upload(0, frames[0][0].Bytes, false) == 9 * TransformStore::InstanceByteSize);
+    CHECK(RecordMatches(frames[0][500].Bytes, worlds[500], texTransforms[500], 3500));
+    CHECK(frames[0][501].Bytes[0] == 0);
+    CHECK(store.DirtyCount(1) == 8);
+
+    // The whole buffer can be rewritten, the partial last block included.
+    CHECK(store.Upload(1, frames[1][0].Bytes, true) == count * TransformStore::InstanceByteSize);
+    CHECK(store.DirtyCount(1) == 0);
+    for (std::uint32_t i = 0; i < count; ++i)
+        CHECK(RecordMatches(frames[1][i].Bytes, worlds[i], texTransforms[i], i * 7));
+}
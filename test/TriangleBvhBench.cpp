@@ -0,0 +1,140 @@
+#include "Benchmark.h"
+
+#include "Utility/ThreadPool.h"
+#include "Utility/TriangleBvh.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    std::uint32_t gState = 12345;
+    float Next()
+    {
+        gState = gState * 1664525u + 1013904223u;
+        return (float)(gState >> 8) * (1.0f / 16777216.0f);
+    }
+}
+
+BENCHMARK(BuildAndTraverse)
+{
+    // Rolling terrain of 512 x 512 quads, 524k triangles.
+    const std::uint32_t size = 512;
+    auto height = [](float x, float z) { return 3.0f * std::sin(x * 0.35f) * std::cos(z * 0.25f) + std::sin(x * 1.1f + z * 0.7f); };
+    std::vector<Float3> positions;
+    for (std::uint32_t z = 0; z <= size; ++z)
+    {
+        for (std::uint32_t x = 0; x <= size; ++x)
+            positions.push_back({ (float)x * 0.5f, height((float)x * 0.5f, (float)z * 0.5f), (float)z * 0.5f });
+    }
+    std::vector<std::uint32_t> indices;
+    for (std::uint32_t z = 0; z < size; ++z)
+    {
+        for (std::uint32_t x = 0; x < size; ++x)
+        {
+            const std::uint32_t i = z * (size + 1) + x;
+            indices.insert(indices.end(), { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+        }
+    }
+    const std::uint32_t triangleCount = (std::uint32_t)indices.size() / 3;
+
+    ThreadPool pool;
+    TriangleBvh bvh;
+    const double serialBuild = Bench::Time([&] { bvh.Build(positions.data(), indices.data(), triangleCount); }, 3);
+    const double pooledBuild = Bench::Time([&] { bvh.Build(positions.data(), indices.data(), triangleCount, &pool); }, 3);
+
+    char label[96];
+    std::snprintf(label, sizeof(label), "build %uk triangles, SAH cost %.1f", triangleCount / 1000, bvh.Cost());
+    Bench::Report(label, serialBuild, triangleCount, "triangles");
+    std::snprintf(label, sizeof(label), "build on %u threads", pool.WorkerCount() + 1);
+    Bench::Report(label, pooledBuild, triangleCount, "triangles");
+
+    // Coherent rays: a 512 x 256 camera grid looking across the terrain,
+    // neighbouring pixels packed together.  Incoherent rays: short AO
+    // style rays from random points on the surface in random upward
+    // directions.
+    const std::uint32_t width = 512, rows = 256, rayCount = width * rows;
+    std::vector<TriangleBvh::RayPacket> coherent(rayCount / 8), incoherent(rayCount / 8);
+    for (std::uint32_t i = 0; i < rayCount; ++i)
+    {
+        TriangleBvh::RayPacket& c = coherent[i / 8];
+        const std::uint32_t lane = i % 8;
+        const float px = (float)(i % width) / width - 0.5f, py = (float)(i / width) / rows - 0.5f;
+        const float dx = px * 1.6f, dy = -0.3f + py * 0.8f, dz = 1.0f;
+        const float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+        c.OriginX[lane] = 128.0f;
+        c.OriginY[lane] = 12.0f;
+        c.OriginZ[lane] = 1.0f;
+        c.DirX[lane] = dx / length;
+        c.DirY[lane] = dy / length;
+        c.DirZ[lane] = dz / length;
+        c.TMax[lane] = 1000.0f;
+
+        TriangleBvh::RayPacket& r = incoherent[i / 8];
+        const float x = Next() * size * 0.5f, z = Next() * size * 0.5f;
+        float ux, uy, uz, lengthSq;
+        do
+        {
+            ux = Next() * 2.0f - 1.0f;
+            uy = Next();
+            uz = Next() * 2.0f - 1.0f;
+            lengthSq = ux * ux + uy * uy + uz * uz;
+        } while (lengthSq > 1.0f || lengthSq < 0.01f);
+        const float inverse = 1.0f / std::sqrt(lengthSq);
+        r.OriginX[lane] = x;
+        r.OriginY[lane] = height(x, z) + 0.01f;
+        r.OriginZ[lane] = z;
+        r.DirX[lane] = ux * inverse;
+        r.DirY[lane] = uy * inverse;
+        r.DirZ[lane] = uz * inverse;
+        r.TMax[lane] = 20.0f;
+    }
+
+    auto traverse = [&](const char* name, const std::vector<TriangleBvh::RayPacket>& packets)
+    {
+        std::uint32_t hits = 0;
+        TriangleBvh::Hit hit, packetHits[8];
+        const double singleClosest = Bench::Time([&]
+        {
+            hits = 0;
+            for (const TriangleBvh::RayPacket& p : packets)
+            {
+                for (int lane = 0; lane < 8; ++lane)
+                    hits += bvh.Intersect({ p.OriginX[lane], p.OriginY[lane], p.OriginZ[lane] }, { p.DirX[lane], p.DirY[lane], p.DirZ[lane] }, p.TMax[lane], hit);
+            }
+        }, 3);
+        std::uint32_t lanes = 0;
+        const double packetClosest = Bench::Time([&]
+        {
+            for (const TriangleBvh::RayPacket& p : packets)
+                lanes |= bvh.Intersect(p, packetHits);
+        }, 3);
+        const double singleAny = Bench::Time([&]
+        {
+            for (const TriangleBvh::RayPacket& p : packets)
+            {
+                for (int lane = 0; lane < 8; ++lane)
+                    lanes += bvh.Occluded({ p.OriginX[lane], p.OriginY[lane], p.OriginZ[lane] }, { p.DirX[lane], p.DirY[lane], p.DirZ[lane] }, p.TMax[lane]);
+            }
+        }, 3);
+        const double packetAny = Bench::Time([&]
+        {
+            for (const TriangleBvh::RayPacket& p : packets)
+                lanes |= bvh.Occluded(p);
+        }, 3);
+        Bench::Consume(&lanes);
+        Bench::Consume(packetHits);
+
+        std::snprintf(label, sizeof(label), "%s closest hit (%u%% hit), single", name, hits * 100 / rayCount);
+        Bench::Report(label, singleClosest, rayCount, "rays");
+        std::snprintf(label, sizeof(label), "%s closest hit, packets", name);
+        Bench::Report(label, packetClosest, rayCount, "rays");
+        std::snprintf(label, sizeof(label), "%s any hit, single", name);
+        Bench::Report(label, singleAny, rayCount, "rays");
+        std::snprintf(label, sizeof(label), "%s any hit, packets", name);
+        Bench::Report(label, packetAny, rayCount, "rays");
+    };
+    traverse("coherent", coherent);
+    traverse("incoherent", incoherent);
+}
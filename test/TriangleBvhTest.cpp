@@ -0,0 +1,363 @@
+#include "TestFramework.h"
+
+#include "Utility/ThreadPool.h"
+#include "Utility/TriangleBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    struct Soup
+    {
+        std::vector<Float3> Positions;
+        std::vector<std::uint32_t> Indices;
+
+        std::uint32_t TriangleCount()const { return (std::uint32_t)Indices.size() / 3; }
+    };
+
+    // Small triangles of mixed sizes scattered through a box, some long
+    // and thin, the hard case for the splits.
+    Soup MakeSoup(std::uint32_t count, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        Soup soup;
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            const Float3 c = { random.Float(-50.0f, 50.0f), random.Float(-10.0f, 10.0f), random.Float(-50.0f, 50.0f) };
+            const float size = i % 7 == 0 ? 8.0f : random.Float(0.2f, 2.0f);
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                soup.Positions.push_back({ c.x + random.Float(-size, size), c.y + random.Float(-size, size), c.z + random.Float(-size, size) });
+                soup.Indices.push_back(3 * i + corner);
+            }
+        }
+        return soup;
+    }
+
+    // Double precision Moller-Trumbore over every triangle.  Near is set
+    // when the ray passes within a rounding error of an edge, or two hits
+    // are too close to order, where float traversal may go either way.
+    struct Reference
+    {
+        bool Found = false;
+        bool Near = false;
+        double T = 0.0;
+        std::uint32_t Triangle = 0;
+    };
+
+    Reference BruteForce(const Soup& soup, const Float3& origin, const Float3& dir, float tMax)
+    {
+        Reference best;
+        best.T = tMax;
+        for (std::uint32_t i = 0; i < soup.TriangleCount(); ++i)
+        {
+            const Float3& a = soup.Positions[soup.Indices[3 * i]];
+            const Float3& b = soup.Positions[soup.Indices[3 * i + 1]];
+            const Float3& c = soup.Positions[soup.Indices[3 * i + 2]];
+            const double e1[3] = { (double)b.x - a.x, (double)b.y - a.y, (double)b.z - a.z };
+            const double e2[3] = { (double)c.x - a.x, (double)c.y - a.y, (double)c.z - a.z };
+            const double d[3] = { dir.x, dir.y, dir.z };
+            const double s[3] = { (double)origin.x - a.x, (double)origin.y - a.y, (double)origin.z - a.z };
+            const double p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+            const double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+            if (det == 0.0)
+                continue;
+            const double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+            const double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+            const double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+            const double t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+
+            const double eps = 1e-4;
+            const bool inside = u >= 0.0 && v >= 0.0 && u + v <= 1.0 && t > 0.0 && t < tMax;
+            const bool close = u > -eps && v > -eps && u + v < 1.0 + eps && t > -eps && t < tMax + eps;
+            if (close && (!inside || u < eps || v < eps || u + v > 1.0 - eps || std::fabs(t - tMax) < eps))
+                best.Near = true;
+            if (!inside)
+                continue;
+            if (best.Found && std::fabs(t - best.T) < eps * std::max(1.0, t))
+                best.Near = true;
+            if (t < best.T)
+            {
+                if (best.Found && best.T - t < eps * std::max(1.0, t))
+                    best.Near = true;
+                best.Found = true;
+                best.T = t;
+                best.Triangle = i;
+            }
+        }
+        return best;
+    }
+
+    Float3 RandomDirection(Test::Random& random)
+    {
+        for (;;)
+        {
+            const Float3 d = { random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f) };
+            const float lengthSq = d.x * d.x + d.y * d.y + d.z * d.z;
+            if (lengthSq > 0.01f && lengthSq <= 1.0f)
+            {
+                const float length = std::sqrt(lengthSq);
+                return { d.x / length, d.y / length, d.z / length };
+            }
+        }
+    }
+
+    // Checks a BVH of soup against brute force on count random rays,
+    // one at a time and in packets.  Returns how many rays hit.
+    std::uint32_t MatchesBruteForce(const TriangleBvh& bvh, const Soup& soup, std::uint32_t count, std::uint64_t seed)
+    {
+        Test::Random random(seed);
+        std::uint32_t hits = 0;
+        for (std::uint32_t first = 0; first < count; first += 8)
+        {
+            TriangleBvh::RayPacket packet;
+            Reference expected[8];
+            for (int lane = 0; lane < 8; ++lane)
+            {
+                const Float3 origin = { random.Float(-60.0f, 60.0f), random.Float(-15.0f, 15.0f), random.Float(-60.0f, 60.0f) };
+                Float3 dir = RandomDirection(random);
+                if (lane % 2 == 0)
+                {
+                    // Aimed at a point inside a random triangle, so there
+                    // are plenty of hits; the closest may be another one.
+                    const std::uint32_t* tri = &soup.Indices[3 * (random.Next32() % soup.TriangleCount())];
+                    const float u = random.Float(0.0f, 0.5f), v = random.Float(0.0f, 0.5f);
+                    const Float3& a = soup.Positions[tri[0]];
+                    const Float3& b = soup.Positions[tri[1]];
+                    const Float3& c = soup.Positions[tri[2]];
+                    const Float3 target = { a.x + (b.x - a.x) * u + (c.x - a.x) * v, a.y + (b.y - a.y) * u + (c.y - a.y) * v, a.z + (b.z - a.z) * u + (c.z - a.z) * v };
+                    const Float3 to = { target.x - origin.x, target.y - origin.y, target.z - origin.z };
+                    const float length = std::sqrt(to.x * to.x + to.y * to.y + to.z * to.z);
+                    dir = { to.x / length, to.y / length, to.z / length };
+                }
+                // Some rays are cut short, and some directions have zero
+                // components.
+                const float tMax = lane % 3 == 0 ? random.Float(1.0f, 20.0f) : 1000.0f;
+                const Float3 d = lane == 7 ? Float3{ 0.0f, dir.y < 0.0f ? -1.0f : 1.0f, 0.0f } : dir;
+                packet.OriginX[lane] = origin.x;
+                packet.OriginY[lane] = origin.y;
+                packet.OriginZ[lane] = origin.z;
+                packet.DirX[lane] = d.x;
+                packet.DirY[lane] = d.y;
+                packet.DirZ[lane] = d.z;
+                packet.TMax[lane] = tMax;
+                expected[lane] = BruteForce(soup, origin, d, tMax);
+            }
+
+            TriangleBvh::Hit packetHits[8];
+            const std::uint32_t packetHit = bvh.Intersect(packet, packetHits);
+            const std::uint32_t packetOccluded = bvh.Occluded(packet);
+            for (int lane = 0; lane < 8; ++lane)
+            {
+                const Reference& e = expected[lane];
+                if (e.Near)
+                    continue;
+                const Float3 origin = { packet.OriginX[lane], packet.OriginY[lane], packet.OriginZ[lane] };
+                const Float3 dir = { packet.DirX[lane], packet.DirY[lane], packet.DirZ[lane] };
+
+                TriangleBvh::Hit hit;
+                CHECK(bvh.Intersect(origin, dir, packet.TMax[lane], hit) == e.Found);
+                CHECK(bvh.Occluded(origin, dir, packet.TMax[lane]) == e.Found);
+                CHECK(((packetHit >> lane) & 1) == (std::uint32_t)e.Found);
+                CHECK(((packetOccluded >> lane) & 1) == (std::uint32_t)e.Found);
+                if (!e.Found)
+                    continue;
+                ++hits;
+                CHECK(hit.Triangle == e.Triangle);
+                CHECK_NEAR(hit.T, e.T, 1e-3 * std::max(1.0, e.T));
+                CHECK(packetHits[lane].Triangle == e.Triangle);
+                CHECK_NEAR(packetHits[lane].T, e.T, 1e-3 * std::max(1.0, e.T));
+                CHECK_NEAR(packetHits[lane].U, hit.U, 1e-3);
+                CHECK_NEAR(packetHits[lane].V, hit.V, 1e-3);
+            }
+        }
+        return hits;
+    }
+
+    bool Contains(const TriangleBvh::Node& outer, const TriangleBvh::Node& inner)
+    {
+        return outer.Min.x <= inner.Min.x && outer.Min.y <= inner.Min.y && outer.Min.z <= inner.Min.z &&
+            outer.Max.x >= inner.Max.x && outer.Max.y >= inner.Max.y && outer.Max.z >= inner.Max.z;
+    }
+}
+
+TEST_CASE(QueriesMatchBruteForce)
+{
+    ThreadPool pool(3);
+    for (std::uint32_t count : { 1u, 5u, 300u, 5000u })
+    {
+        const Soup soup = MakeSoup(count, count);
+        TriangleBvh bvh;
+        bvh.Build(soup.Positions.data(), soup.Indices.data(), soup.TriangleCount());
+        const std::uint32_t hits = MatchesBruteForce(bvh, soup, 400, 7);
+        CHECK(hits > 100);
+
+        TriangleBvh pooled;
+        pooled.Build(soup.Positions.data(), soup.Indices.data(), soup.TriangleCount(), &pool);
+        CHECK(MatchesBruteForce(pooled, soup, 400, 7) == hits);
+    }
+}
+
+TEST_CASE(ParallelBuildIsAsGood)
+{
+    // Enough triangles for the top nodes to bin in chunks and the big
+    // subtrees to build on the pool.
+    const Soup soup = MakeSoup(2 * TriangleBvh::ParallelBinThreshold + 1000, 11);
+    ThreadPool pool(3);
+    TriangleBvh serial, pooled;
+    serial.Build(soup.Positions.data(), soup.Indices.data(), soup.TriangleCount());
+    pooled.Build(soup.Positions.data(), soup.Indices.data(), soup.TriangleCount(), &pool);
+
+    // Subtrees claim their nodes in a different order, the tree is the same.
+    CHECK(pooled.NodeCount() == serial.NodeCount());
+    CHECK_NEAR(pooled.Cost(), serial.Cost(), 1e-3 * serial.Cost());
+    CHECK(pooled.TriangleCount() == soup.TriangleCount());
+
+    Test::Random random(12);
+    for (int i = 0; i < 2000; ++i)
+    {
+        const Float3 origin = { random.Float(-60.0f, 60.0f), random.Float(-15.0f, 15.0f), random.Float(-60.0f, 60.0f) };
+        const Float3 dir = RandomDirection(random);
+        TriangleBvh::Hit a, b;
+        const bool hitA = serial.Intersect(origin, dir, 1000.0f, a), hitB = pooled.Intersect(origin, dir, 1000.0f, b);
+        CHECK(hitA == hitB);
+        CHECK(!hitA || (a.Triangle == b.Triangle && a.T == b.T));
+    }
+}
+
+TEST_CASE(NodesBoundTheirChildren)
+{
+    const Soup soup = MakeSoup(3000, 21);
+    TriangleBvh bvh;
+    bvh.Build(soup.Positions.data(), soup.Indices.data(), soup.TriangleCount());
+    const std::vector<TriangleBvh::Node>& nodes = bvh.Nodes();
+    CHECK(bvh.NodeCount() <= 2 * soup.TriangleCount() - 1);
+
+    // Every triangle sits in exactly one leaf, and leaves stay small.
+    std::vector<std::uint32_t> covered(soup.TriangleCount(), 0);
+    std::vector<std::uint32_t> stack = { 0 };
+    std::uint32_t leaves = 0;
+    while (!stack.empty())
+    {
+        const TriangleBvh::Node& node = nodes[stack.back()];
+        stack.pop_back();
+        if (node.Count == 0)
+        {
+            CHECK(node.Index + 1 < nodes.size());
+            CHECK(Contains(node, nodes[node.Index]));
+            CHECK(Contains(node, nodes[node.Index + 1]));
+            stack.push_back(node.Index);
+            stack.push_back(node.Index + 1);
+            continue;
+        }
+        ++leaves;
+        CHECK(node.Count <= 2 * TriangleBvh::MaxLeafSize);
+        for (std::uint32_t i = node.Index; i < node.Index + node.Count && i < covered.size(); ++i)
+            ++covered[i];
+    }
+    CHECK(std::all_of(covered.begin(), covered.end(), [](std::uint32_t c) { return c == 1; }));
+    CHECK(bvh.NodeCount() == 2 * leaves - 1);
+
+    // The root holds every corner.
+    const TriangleBvh::Node& root = nodes[0];
+    for (const Float3& p : soup.Positions)
+        CHECK(p.x >= root.Min.x && p.y >= root.Min.y && p.z >= root.Min.z && p.x <= root.Max.x && p.y <= root.Max.y && p.z <= root.Max.z);
+
+    // A split tree is far cheaper than testing every triangle, which
+    // costs the triangle count.
+    CHECK(bvh.Cost() < soup.TriangleCount() * 0.05f);
+}
+
+TEST_CASE(FlatAndDegenerateInput)
+{
+    // An axis aligned floor: every node box is flat in y, and rays
+    // straight down have two zero direction components.
+    Soup floor;
+    const std::uint32_t size = 32;
+    for (std::uint32_t z = 0; z <= size; ++z)
+    {
+        for (std::uint32_t x = 0; x <= size; ++x)
+            floor.Positions.push_back({ (float)x, 0.0f, (float)z });
+    }
+    for (std::uint32_t z = 0; z < size; ++z)
+    {
+        for (std::uint32_t x = 0; x < size; ++x)
+        {
+            const std::uint32_t i = z * (size + 1) + x;
+            floor.Indices.insert(floor.Indices.end(), { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+        }
+    }
+    TriangleBvh bvh;
+    bvh.Build(floor.Positions.data(), floor.Indices.data(), floor.TriangleCount());
+
+    Test::Random random(31);
+    for (int i = 0; i < 500; ++i)
+    {
+        const Float3 origin = { random.Float(0.01f, size - 0.01f), random.Float(0.5f, 5.0f), random.Float(0.01f, size - 0.01f) };
+        TriangleBvh::Hit hit;
+        CHECK(bvh.Intersect(origin, { 0.0f, -1.0f, 0.0f }, 100.0f, hit));
+        CHECK_NEAR(hit.T, origin.y, 1e-4);
+        CHECK(!bvh.Occluded(origin, { 0.0f, 1.0f, 0.0f }, 100.0f));
+        // Too short to reach the floor.
+        CHECK(!bvh.Occluded(origin, { 0.0f, -1.0f, 0.0f }, origin.y * 0.99f));
+    }
+
+    // Many copies of one triangle cannot be split by position.
+    Soup stack;
+    for (std::uint32_t i = 0; i < 100; ++i)
+    {
+        stack.Positions.insert(stack.Positions.end(), { { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 1.0f } });
+        stack.Indices.insert(stack.Indices.end(), { 3 * i, 3 * i + 1, 3 * i + 2 });
+    }
+    TriangleBvh copies;
+    copies.Build(stack.Positions.data(), stack.Indices.data(), stack.TriangleCount());
+    TriangleBvh::Hit hit;
+    CHECK(copies.Intersect({ 0.25f, 0.25f, 0.0f }, { 0.0f, 0.0f, 1.0f }, 10.0f, hit));
+    CHECK_NEAR(hit.T, 1.0f, 1e-6);
+    CHECK(hit.Triangle < 100);
+
+    // And nothing at all.
+    TriangleBvh empty;
+    empty.Build(nullptr, nullptr, 0);
+    CHECK(empty.TriangleCount() == 0);
+    CHECK(!empty.Occluded({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, 10.0f));
+    CHECK(empty.Cost() == 0.0f);
+}
+
+TEST_CASE(InactiveLanesAreLeftAlone)
+{
+    const Soup soup = MakeSoup(500, 41);
+    TriangleBvh bvh;
+    bvh.Build(soup.Positions.data(), soup.Indices.data(), soup.TriangleCount());
+
+    // Every lane aims at the middle of a triangle.
+    TriangleBvh::RayPacket packet;
+    for (int lane = 0; lane < 8; ++lane)
+    {
+        const std::uint32_t* tri = &soup.Indices[3 * (lane * 37)];
+        const Float3& a = soup.Positions[tri[0]];
+        const Float3& b = soup.Positions[tri[1]];
+        const Float3& c = soup.Positions[tri[2]];
+        const Float3 target = { (a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f };
+        packet.OriginX[lane] = target.x;
+        packet.OriginY[lane] = target.y + 30.0f;
+        packet.OriginZ[lane] = target.z;
+        packet.DirX[lane] = 0.0f;
+        packet.DirY[lane] = -1.0f;
+        packet.DirZ[lane] = 0.0f;
+        packet.TMax[lane] = 100.0f;
+    }
+    CHECK(bvh.Occluded(packet) == 0xffu);
+
+    const std::uint32_t active = 0x5au;
+    TriangleBvh::Hit hits[8];
+    for (TriangleBvh::Hit& hit : hits)
+        hit.Triangle = 0xdeadu;
+    CHECK(bvh.Intersect(packet, hits, active) == active);
+    CHECK(bvh.Occluded(packet, active) == active);
+    for (int lane = 0; lane < 8; ++lane)
+        CHECK(((active >> lane) & 1) != 0 ? hits[lane].Triangle != 0xdeadu : hits[lane].Triangle == 0xdeadu);
+    CHECK(bvh.Intersect(packet, hits, 0) == 0);
+}